@@ -34,6 +34,7 @@
 #pragma once
 
 #include <DXBC2GLSL/Shader.hpp>
+#include <DXBC2GLSL/TextWriter.hpp>
 #include <map>
 
 enum GLSLVersion
@@ -97,8 +98,8 @@ struct RegisterDesc
 struct HSForkPhase
 {
 	uint32_t fork_instance_count;
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 	
 	HSForkPhase()
 		: fork_instance_count(0)
@@ -109,8 +110,8 @@ struct HSForkPhase
 struct HSJoinPhase
 {
 	uint32_t join_instance_count;
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 	
 	HSJoinPhase()
 		: join_instance_count(0)
@@ -120,8 +121,8 @@ struct HSJoinPhase
 
 struct HSControlPointPhase
 {
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 };
 
 class GLSLGen
@@ -132,45 +133,45 @@ public:
 	void FeedDXBC(std::shared_ptr<ShaderProgram> const & program,
 		bool has_gs, bool has_ps, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive,
 		GLSLVersion version, uint32_t glsl_rules);
-	void ToGLSL(std::ostream& out);
-	void ToHSControlPointPhase(std::ostream& out);
-	void ToHSForkPhases(std::ostream& out);
-	void ToHSJoinPhases(std::ostream& out);
+	void ToGLSL(TextWriter& out);
+	void ToHSControlPointPhase(TextWriter& out);
+	void ToHSForkPhases(TextWriter& out);
+	void ToHSJoinPhases(TextWriter& out);
 
 private:
-	void ToDeclarations(std::ostream& out);
-	void ToDclInterShaderInputRecords(std::ostream& out);
-	void ToDclInterShaderOutputRecords(std::ostream& out);
-	void ToDclInterShaderPatchConstantRecords(std::ostream& out);
-	void ToDeclInterShaderInputRegisters(std::ostream& out) const;
-	void ToCopyToInterShaderInputRegisters(std::ostream& out) const;
-	void ToDeclInterShaderOutputRegisters(std::ostream& out) const;
-	void ToCopyToInterShaderOutputRecords(std::ostream& out) const;
-	void ToDclInterShaderPatchConstantRegisters(std::ostream& out);
-	void ToCopyToInterShaderPatchConstantRecords(std::ostream& out)const;
-	void ToCopyToInterShaderPatchConstantRegisters(std::ostream& out)const;
-	void ToDefaultHSControlPointPhase(std::ostream& out)const;
-	void ToDeclaration(std::ostream& out, ShaderDecl const & dcl);
-	void ToInstruction(std::ostream& out, ShaderInstruction const & insn) const;
-	void ToOperands(std::ostream& out, ShaderOperand const & op, uint32_t imm_as_type,
+	void ToDeclarations(TextWriter& out);
+	void ToDclInterShaderInputRecords(TextWriter& out);
+	void ToDclInterShaderOutputRecords(TextWriter& out);
+	void ToDclInterShaderPatchConstantRecords(TextWriter& out);
+	void ToDeclInterShaderInputRegisters(TextWriter& out) const;
+	void ToCopyToInterShaderInputRegisters(TextWriter& out) const;
+	void ToDeclInterShaderOutputRegisters(TextWriter& out) const;
+	void ToCopyToInterShaderOutputRecords(TextWriter& out) const;
+	void ToDclInterShaderPatchConstantRegisters(TextWriter& out);
+	void ToCopyToInterShaderPatchConstantRecords(TextWriter& out)const;
+	void ToCopyToInterShaderPatchConstantRegisters(TextWriter& out)const;
+	void ToDefaultHSControlPointPhase(TextWriter& out)const;
+	void ToDeclaration(TextWriter& out, ShaderDecl const & dcl);
+	void ToInstruction(TextWriter& out, ShaderInstruction const & insn) const;
+	void ToOperands(TextWriter& out, ShaderOperand const & op, uint32_t imm_as_type,
 		bool mask = true, bool dcl_array = false, bool no_swizzle = false, bool no_idx = false, bool no_cast = false,
 		ShaderInputType const & sit = SIT_UNDEFINED) const;
 	ShaderImmType OperandAsType(ShaderOperand const & op, uint32_t imm_as_type) const;
-	int ToSingleComponentSelector(std::ostream& out, ShaderOperand const & op, int i, bool dot = true) const;
-	void ToOperandName(std::ostream& out, ShaderOperand const & op, ShaderImmType as_type,
+	int ToSingleComponentSelector(TextWriter& out, ShaderOperand const & op, int i, bool dot = true) const;
+	void ToOperandName(TextWriter& out, ShaderOperand const & op, ShaderImmType as_type,
 		bool* need_idx, bool* need_comps, bool no_swizzle = false, bool no_idx = false,
 		ShaderInputType const & sit = SIT_UNDEFINED) const;
-	void ToComponentSelectors(std::ostream& out, ShaderOperand const & op, bool dot = true, uint32_t offset = 0) const;
-	void ToTemps(std::ostream& out, ShaderDecl const & dcl);
-	void ToImmConstBuffer(std::ostream& out, ShaderDecl const & dcl);
-	void ToDefaultValue(std::ostream& out, DXBCShaderVariable const & var);
-	void ToDefaultValue(std::ostream& out, DXBCShaderVariable const & var, uint32_t offset);
-	void ToDefaultValue(std::ostream& out, char const * value, ShaderVariableType type);
+	void ToComponentSelectors(TextWriter& out, ShaderOperand const & op, bool dot = true, uint32_t offset = 0) const;
+	void ToTemps(TextWriter& out, ShaderDecl const & dcl);
+	void ToImmConstBuffer(TextWriter& out, ShaderDecl const & dcl);
+	void ToDefaultValue(TextWriter& out, DXBCShaderVariable const & var);
+	void ToDefaultValue(TextWriter& out, DXBCShaderVariable const & var, uint32_t offset);
+	void ToDefaultValue(TextWriter& out, char const * value, ShaderVariableType type);
 	uint32_t ComponentSelectorFromMask(uint32_t mask, uint32_t comps) const;
 	uint32_t ComponentSelectorFromSwizzle(uint8_t const swizzle[4], uint32_t comps) const;
 	uint32_t ComponentSelectorFromScalar(uint8_t scalar) const;
 	uint32_t ComponentSelectorFromCount(uint32_t count) const;
-	void ToComponentSelector(std::ostream& out, uint32_t comps, uint32_t offset = 0) const;
+	void ToComponentSelector(TextWriter& out, uint32_t comps, uint32_t offset = 0) const;
 	bool IsImmediateNumber(ShaderOperand const & op) const;
 	// param i:the component selector to get
 	// return:the idx of selector:0 1 2 3 stand for x y z w
@@ -35,11 +35,37 @@
 
 #include <KFL/KFL.hpp>
 #include <vector>
+#include <memory>
+#include <new>
 #include <cstring>
+#include <type_traits>
 #include <DXBC2GLSL/DXBC.hpp>
 #include <DXBC2GLSL/Utils.hpp>
 #include <DXBC2GLSL/ShaderDefs.hpp>
 
+// Bump allocator of the shader IR. Nodes are never freed one by one, the whole arena goes with its program.
+class ShaderArena
+{
+public:
+	ShaderArena();
+	ShaderArena(ShaderArena const & rhs) = delete;
+	ShaderArena& operator=(ShaderArena const & rhs) = delete;
+
+	void* Allocate(size_t size, size_t alignment);
+
+	template <typename T>
+	T* New()
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Destructors of arena nodes are never called.");
+		return new (this->Allocate(sizeof(T), alignof(T))) T;
+	}
+
+private:
+	std::vector<std::unique_ptr<uint8_t[]>> blocks_;
+	uint8_t* cur_;
+	size_t left_;
+};
+
 // store texture-sampler pairs, in glsl, texture must bind with sampler
 struct SamplerInfo
 {
@@ -277,7 +303,7 @@ struct ShaderOperand
 	struct
 	{
 		int64_t disp;
-		std::shared_ptr<ShaderOperand> reg;
+		ShaderOperand* reg;
 	} indices[3];
 
 	bool IsIndexSimple(uint32_t i) const
@@ -298,6 +324,7 @@ struct ShaderOperand
 		memset(swizzle, 0, sizeof(swizzle));
 		memset(imm_values, 0, sizeof(imm_values));
 		indices[0].disp = indices[1].disp = indices[2].disp = 0;
+		indices[0].reg = indices[1].reg = indices[2].reg = nullptr;
 	}
 };
 
@@ -312,19 +339,20 @@ struct ShaderInstruction : public TokenizedShaderInstruction
 
 	uint32_t num;
 	uint32_t num_ops;
-	std::shared_ptr<ShaderOperand> ops[SM_MAX_OPS];
+	ShaderOperand* ops[SM_MAX_OPS];
 
 	ShaderInstruction()
 		: resource_target(0), num(0), num_ops(0)
 	{
 		memset(sample_offset, 0, sizeof(sample_offset));
 		memset(resource_return_type, 0, sizeof(resource_return_type));
+		memset(ops, 0, sizeof(ops));
 	}
 };
 
 struct ShaderDecl : public TokenizedShaderInstruction
 {
-	std::shared_ptr<ShaderOperand> op;
+	ShaderOperand* op;
 	union
 	{
 		uint32_t num;
@@ -351,9 +379,11 @@ struct ShaderDecl : public TokenizedShaderInstruction
 		} structured;
 	};
 
-	std::vector<uint8_t> data;
+	// Immediate constant buffers and function tables, in the arena
+	uint8_t* data;
 
 	ShaderDecl()
+		: op(nullptr), data(nullptr)
 	{
 		memset(&insn, 0, sizeof(insn));
 		memset(&intf, 0, sizeof(intf));
@@ -369,8 +399,9 @@ struct LabelInfo
 struct ShaderProgram
 {
 	TokenizedShaderVersion version;//program version
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;//declarations
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	ShaderArena arena;//owns all the nodes below
+	std::vector<ShaderDecl*> dcls;//declarations
+	std::vector<ShaderInstruction*> insns;//instructions
 
 	std::vector<DXBCSignatureParamDesc> params_in; //input signature
 	std::vector<DXBCSignatureParamDesc> params_out;//output signature
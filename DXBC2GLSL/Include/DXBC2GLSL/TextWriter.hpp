@@ -0,0 +1,144 @@
+/**
+ * @file TextWriter.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _DXBC2GLSL_TEXTWRITER_HPP
+#define _DXBC2GLSL_TEXTWRITER_HPP
+
+#pragma once
+
+#include <DXBC2GLSL/Utils.hpp>
+#include <cstring>
+#include <string>
+
+// Appends text to a string. It takes the place of std::ostream in code generation, without the sentries and the
+// locale. Numbers come out as a std::ostream in the classic locale writes them, with the default precision.
+class TextWriter
+{
+public:
+	explicit TextWriter(std::string& str)
+		: str_(str), show_point_(false)
+	{
+	}
+
+	// Same as std::ios::showpoint. Floats keep their decimal point and trailing zeros.
+	void ShowPoint(bool show)
+	{
+		show_point_ = show;
+	}
+
+	std::string& Str()
+	{
+		return str_;
+	}
+
+	TextWriter& operator<<(char c)
+	{
+		str_.push_back(c);
+		return *this;
+	}
+	TextWriter& operator<<(signed char c)
+	{
+		str_.push_back(static_cast<char>(c));
+		return *this;
+	}
+	TextWriter& operator<<(unsigned char c)
+	{
+		str_.push_back(static_cast<char>(c));
+		return *this;
+	}
+	TextWriter& operator<<(char const * s)
+	{
+		str_.append(s, strlen(s));
+		return *this;
+	}
+	TextWriter& operator<<(std::string const & s)
+	{
+		str_.append(s);
+		return *this;
+	}
+	TextWriter& operator<<(bool b)
+	{
+		str_.push_back(b ? '1' : '0');
+		return *this;
+	}
+
+	TextWriter& operator<<(short v)
+	{
+		return this->WriteSigned(v);
+	}
+	TextWriter& operator<<(int v)
+	{
+		return this->WriteSigned(v);
+	}
+	TextWriter& operator<<(long v)
+	{
+		return this->WriteSigned(v);
+	}
+	TextWriter& operator<<(long long v)
+	{
+		return this->WriteSigned(v);
+	}
+	TextWriter& operator<<(unsigned short v)
+	{
+		return this->WriteUnsigned(v);
+	}
+	TextWriter& operator<<(unsigned int v)
+	{
+		return this->WriteUnsigned(v);
+	}
+	TextWriter& operator<<(unsigned long v)
+	{
+		return this->WriteUnsigned(v);
+	}
+	TextWriter& operator<<(unsigned long long v)
+	{
+		return this->WriteUnsigned(v);
+	}
+
+	TextWriter& operator<<(float v)
+	{
+		return this->WriteDouble(v);
+	}
+	TextWriter& operator<<(double v)
+	{
+		return this->WriteDouble(v);
+	}
+
+private:
+	TextWriter& WriteSigned(long long v);
+	TextWriter& WriteUnsigned(unsigned long long v);
+	TextWriter& WriteDouble(double v);
+
+private:
+	std::string& str_;
+	bool show_point_;
+};
+
+#endif		// _DXBC2GLSL_TEXTWRITER_HPP
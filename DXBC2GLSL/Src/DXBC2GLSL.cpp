@@ -31,7 +31,12 @@
 #include <DXBC2GLSL/DXBC2GLSL.hpp>
 #include <DXBC2GLSL/DXBC.hpp>
 #include <DXBC2GLSL/GLSLGen.hpp>
-#include <sstream>
+#include <DXBC2GLSL/TextWriter.hpp>
+
+namespace
+{
+	size_t const GLSL_INIT_CAPACITY = 16 * 1024;
+}
 
 namespace DXBC2GLSL
 {
@@ -58,13 +63,14 @@ namespace DXBC2GLSL
 			{
 				shader_ = ShaderParse(*dxbc_);
 
-				std::stringstream ss;
+				// The capacity stays for the next shader fed to this object
+				glsl_.clear();
+				glsl_.reserve(GLSL_INIT_CAPACITY);
+				TextWriter out(glsl_);
 
 				GLSLGen converter;
 				converter.FeedDXBC(shader_, has_gs, has_ps, ds_partitioning, ds_output_primitive, version, glsl_rules);
-				converter.ToGLSL(ss);
-
-				glsl_ = ss.str();
+				converter.ToGLSL(out);
 			}
 		}
 	}
@@ -30,6 +30,7 @@
 
 #include <DXBC2GLSL/Shader.hpp>
 #include <DXBC2GLSL/Utils.hpp>
+#include <algorithm>
 
 namespace
 {
@@ -82,6 +83,38 @@ namespace
 	{
 		return lh.var_desc.start_offset < rh.var_desc.start_offset;
 	}
+
+	size_t const ARENA_BLOCK_SIZE = 64 * 1024;
+}
+
+ShaderArena::ShaderArena()
+	: cur_(nullptr), left_(0)
+{
+}
+
+void* ShaderArena::Allocate(size_t size, size_t alignment)
+{
+	size_t padding = (alignment - reinterpret_cast<uintptr_t>(cur_) % alignment) % alignment;
+	if (padding + size > left_)
+	{
+		// Large allocations get a block of their own, and leave the current one usable
+		size_t const block_size = std::max(size + alignment, ARENA_BLOCK_SIZE);
+		blocks_.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[block_size]));
+		uint8_t* block = blocks_.back().get();
+		padding = (alignment - reinterpret_cast<uintptr_t>(block) % alignment) % alignment;
+		if (block_size > ARENA_BLOCK_SIZE)
+		{
+			return block + padding;
+		}
+
+		cur_ = block;
+		left_ = block_size;
+	}
+
+	void* ret = cur_ + padding;
+	cur_ += padding + size;
+	left_ -= padding + size;
+	return ret;
 }
 
 struct ShaderParser
@@ -114,6 +147,11 @@ struct ShaderParser
 		return cur_token;
 	}
 
+	uint8_t* AllocateData(size_t size)
+	{
+		return static_cast<uint8_t*>(program->arena.Allocate(std::max<size_t>(size, 1), sizeof(uint32_t)));
+	}
+
 	template <typename T>
 	void ReadToken(T* tok)
 	{
@@ -237,19 +275,19 @@ struct ShaderParser
 				break;
 
 			case SOIP_RELATIVE:
-				op.indices[i].reg = KlayGE::MakeSharedPtr<ShaderOperand>();
+				op.indices[i].reg = program->arena.New<ShaderOperand>();
 				this->ReadOp(*op.indices[i].reg);
 				break;
 
 			case SOIP_IMM32_PLUS_RELATIVE:
 				op.indices[i].disp = static_cast<int32_t>(this->Read32());
-				op.indices[i].reg = KlayGE::MakeSharedPtr<ShaderOperand>();
+				op.indices[i].reg = program->arena.New<ShaderOperand>();
 				this->ReadOp(*op.indices[i].reg);
 				break;
 
 			case SOIP_IMM64_PLUS_RELATIVE:
 				op.indices[i].disp = this->Read64();
-				op.indices[i].reg = KlayGE::MakeSharedPtr<ShaderOperand>();
+				op.indices[i].reg = program->arena.New<ShaderOperand>();
 				this->ReadOp(*op.indices[i].reg);
 				break;
 			}
@@ -293,12 +331,12 @@ struct ShaderParser
 				// immediate constant buffer data
 				uint32_t customlen = this->Read32() - 2;
 
-				std::shared_ptr<ShaderDecl> dcl = KlayGE::MakeSharedPtr<ShaderDecl>();
+				ShaderDecl* dcl = program->arena.New<ShaderDecl>();
 				program->dcls.push_back(dcl);
 
 				dcl->opcode = SO_IMMEDIATE_CONSTANT_BUFFER;
 				dcl->num = customlen;
-				dcl->data.resize(customlen * sizeof(tokens[0]));
+				dcl->data = this->AllocateData(customlen * sizeof(tokens[0]));
 
 				memcpy(&dcl->data[0], &tokens[0], customlen * sizeof(tokens[0]));
 
@@ -310,7 +348,7 @@ struct ShaderParser
 			{
 				// need to interleave these with the declarations or we cannot
 				// assign fork/join phase instance counts to phases
-				std::shared_ptr<ShaderDecl> dcl = KlayGE::MakeSharedPtr<ShaderDecl>();
+				ShaderDecl* dcl = program->arena.New<ShaderDecl>();
 				program->dcls.push_back(dcl);
 				dcl->opcode = opcode;
 			}
@@ -319,7 +357,7 @@ struct ShaderParser
 				|| ((opcode >= SO_DCL_STREAM) && (opcode <= SO_DCL_RESOURCE_STRUCTURED))
 				|| (SO_DCL_GS_INSTANCE_COUNT == opcode))
 			{
-				std::shared_ptr<ShaderDecl> dcl = KlayGE::MakeSharedPtr<ShaderDecl>();
+				ShaderDecl* dcl = program->arena.New<ShaderDecl>();
 				program->dcls.push_back(dcl);
 				reinterpret_cast<TokenizedShaderInstruction&>(*dcl) = insntok;
 
@@ -330,7 +368,7 @@ struct ShaderParser
 					this->ReadToken(&exttok);
 				}
 
-#define READ_OP_ANY dcl->op = KlayGE::MakeSharedPtr<ShaderOperand>(); this->ReadOp(*dcl->op);
+#define READ_OP_ANY dcl->op = program->arena.New<ShaderOperand>(); this->ReadOp(*dcl->op);
 #define READ_OP(FILE) READ_OP_ANY
 				//check(dcl->op->file == SOT_##FILE);
 
@@ -382,7 +420,7 @@ struct ShaderParser
 					break;
 
 				case SO_DCL_INDEXABLE_TEMP:
-					dcl->op = KlayGE::MakeSharedPtr<ShaderOperand>();
+					dcl->op = program->arena.New<ShaderOperand>();
 					dcl->op->indices[0].disp = this->Read32();
 					dcl->indexable_temp.num = this->Read32();
 					dcl->indexable_temp.comps = this->Read32();
@@ -447,7 +485,7 @@ struct ShaderParser
 
 				case SO_DCL_FUNCTION_TABLE:
 					dcl->num = this->Read32();
-					dcl->data.resize(dcl->num * sizeof(uint32_t));
+					dcl->data = this->AllocateData(dcl->num * sizeof(uint32_t));
 					for (uint32_t i = 0; i < dcl->num; ++ i)
 					{
 						(reinterpret_cast<uint32_t*>(&dcl->data[0]))[i] = this->Read32();
@@ -462,7 +500,7 @@ struct ShaderParser
 						dcl->intf.table_length = v & 0xffff;
 						dcl->intf.array_length = v >> 16;
 					}
-					dcl->data.resize(dcl->intf.table_length * sizeof(uint32_t));
+					dcl->data = this->AllocateData(dcl->intf.table_length * sizeof(uint32_t));
 					for (uint32_t i = 0; i < dcl->intf.table_length; ++ i)
 					{
 						(reinterpret_cast<uint32_t*>(&dcl->data[0]))[i] = this->Read32();
@@ -531,7 +569,7 @@ struct ShaderParser
 				{
 					continue;
 				}
-				std::shared_ptr<ShaderInstruction> insn = KlayGE::MakeSharedPtr<ShaderInstruction>();
+				ShaderInstruction* insn = program->arena.New<ShaderInstruction>();
 				program->insns.push_back(insn);
 				reinterpret_cast<TokenizedShaderInstruction&>(*insn) = insntok;
 
@@ -574,7 +612,7 @@ struct ShaderParser
 				{
 					BOOST_ASSERT(tokens < insn_end);
 					BOOST_ASSERT(op_num < SM_MAX_OPS);
-					insn->ops[op_num] = KlayGE::MakeSharedPtr<ShaderOperand>();
+					insn->ops[op_num] = program->arena.New<ShaderOperand>();
 					this->ReadOp(*insn->ops[op_num]);
 					++ op_num;
 				}
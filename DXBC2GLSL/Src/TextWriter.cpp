@@ -0,0 +1,223 @@
+/**
+ * @file TextWriter.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <DXBC2GLSL/TextWriter.hpp>
+#include <cmath>
+#include <locale>
+#include <sstream>
+
+namespace
+{
+	// The default precision of std::ostream
+	int const PRECISION = 6;
+
+	double const POW10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	double Scale10(double v, int exp)
+	{
+		while (exp > 22)
+		{
+			v *= POW10[22];
+			exp -= 22;
+		}
+		while (exp < -22)
+		{
+			v /= POW10[22];
+			exp += 22;
+		}
+		return (exp >= 0) ? v * POW10[exp] : v / POW10[-exp];
+	}
+
+	void WriteWithStream(std::string& str, double v, bool show_point)
+	{
+		std::ostringstream ss;
+		ss.imbue(std::locale::classic());
+		if (show_point)
+		{
+			ss.setf(std::ios::showpoint);
+		}
+		ss << v;
+		str.append(ss.str());
+	}
+}
+
+TextWriter& TextWriter::WriteSigned(long long v)
+{
+	if (v < 0)
+	{
+		str_.push_back('-');
+		return this->WriteUnsigned(0ULL - static_cast<unsigned long long>(v));
+	}
+	else
+	{
+		return this->WriteUnsigned(static_cast<unsigned long long>(v));
+	}
+}
+
+TextWriter& TextWriter::WriteUnsigned(unsigned long long v)
+{
+	char buf[20];
+	char* p = buf + sizeof(buf);
+	do
+	{
+		*-- p = static_cast<char>('0' + v % 10);
+		v /= 10;
+	} while (v != 0);
+	str_.append(p, buf + sizeof(buf));
+	return *this;
+}
+
+// Same as %g, or %#g with showpoint, with the default precision. The digits are rounded in double. When that
+// can't be trusted, too close to a tie or out of the usual range, it goes to std::ostream in the classic locale.
+TextWriter& TextWriter::WriteDouble(double v)
+{
+	double const a = std::abs(v);
+	if ((a != 0) && !((a >= 1e-30) && (a < 1e30)))
+	{
+		WriteWithStream(str_, v, show_point_);
+		return *this;
+	}
+
+	uint32_t digits = 0;
+	int exp = 0;
+	if (a != 0)
+	{
+		exp = static_cast<int>(std::floor(std::log10(a)));
+		double scaled = Scale10(a, PRECISION - 1 - exp);
+		if (scaled < POW10[PRECISION - 1])
+		{
+			-- exp;
+			scaled = Scale10(a, PRECISION - 1 - exp);
+		}
+		else if (scaled >= POW10[PRECISION])
+		{
+			++ exp;
+			scaled = Scale10(a, PRECISION - 1 - exp);
+		}
+
+		double const integer = std::floor(scaled);
+		double const frac = scaled - integer;
+		if (std::abs(frac - 0.5) < 1e-6)
+		{
+			WriteWithStream(str_, v, show_point_);
+			return *this;
+		}
+
+		digits = static_cast<uint32_t>(integer) + (frac > 0.5 ? 1 : 0);
+		if (digits >= POW10[PRECISION])
+		{
+			digits /= 10;
+			++ exp;
+		}
+	}
+
+	char digit_str[PRECISION];
+	for (int i = PRECISION - 1; i >= 0; -- i)
+	{
+		digit_str[i] = static_cast<char>('0' + digits % 10);
+		digits /= 10;
+	}
+
+	if (std::signbit(v))
+	{
+		str_.push_back('-');
+	}
+
+	char buf[32];
+	char* p = buf;
+	bool const scientific = (exp < -4) || (exp >= PRECISION);
+	int num_frac_digits;
+	if (scientific)
+	{
+		*p ++ = digit_str[0];
+		*p ++ = '.';
+		memcpy(p, &digit_str[1], PRECISION - 1);
+		p += PRECISION - 1;
+		num_frac_digits = PRECISION - 1;
+	}
+	else if (exp >= 0)
+	{
+		memcpy(p, digit_str, exp + 1);
+		p += exp + 1;
+		*p ++ = '.';
+		memcpy(p, &digit_str[exp + 1], PRECISION - 1 - exp);
+		p += PRECISION - 1 - exp;
+		num_frac_digits = PRECISION - 1 - exp;
+	}
+	else
+	{
+		*p ++ = '0';
+		*p ++ = '.';
+		for (int i = 0; i < -exp - 1; ++ i)
+		{
+			*p ++ = '0';
+		}
+		memcpy(p, digit_str, PRECISION);
+		p += PRECISION;
+		num_frac_digits = PRECISION - exp - 1;
+	}
+
+	if (!show_point_)
+	{
+		while ((num_frac_digits > 0) && ('0' == p[-1]))
+		{
+			-- p;
+			-- num_frac_digits;
+		}
+		if (0 == num_frac_digits)
+		{
+			-- p;
+		}
+	}
+
+	if (scientific)
+	{
+		*p ++ = 'e';
+		int abs_exp = exp;
+		if (exp < 0)
+		{
+			*p ++ = '-';
+			abs_exp = -exp;
+		}
+		else
+		{
+			*p ++ = '+';
+		}
+		*p ++ = static_cast<char>('0' + abs_exp / 10);
+		*p ++ = static_cast<char>('0' + abs_exp % 10);
+	}
+
+	str_.append(buf, p);
+	return *this;
+}
@@ -29,9 +29,15 @@
  */
 
 #include <DXBC2GLSL/DXBC2GLSL.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 void usage()
 {
@@ -41,9 +47,116 @@ void usage()
 	std::cerr << "Latest version available from http://www.klayge.org/\n";
 	std::cerr << "\n";
 	std::cerr << "Usage: DXBC2GLSLCmd FILE [OUTPUT]\n";
+	std::cerr << "       DXBC2GLSLCmd -batch DIR [OUTPUT_DIR] [NUM_THREADS]\n";
+	std::cerr << "The batch mode converts all files in DIR in parallel, and reports the throughput.\n";
 	std::cerr << std::endl;
 }
 
+std::vector<char> ReadFile(std::string const & name)
+{
+	std::vector<char> data;
+	std::ifstream in(name, std::ios_base::in | std::ios_base::binary);
+	char c;
+	in >> std::noskipws;
+	while (in >> c)
+	{
+		data.push_back(c);
+	}
+	return data;
+}
+
+int BatchConvert(std::string const & input_dir, std::string const & output_dir, uint32_t num_threads)
+{
+	struct Shader
+	{
+		std::string name;
+		std::vector<char> dxbc;
+		std::string glsl;
+		std::string error;
+	};
+
+	if (!std::filesystem::is_directory(input_dir))
+	{
+		std::cerr << input_dir << " is not a directory" << std::endl;
+		return 1;
+	}
+
+	// Everything is loaded first, only the conversion is timed
+	std::vector<Shader> shaders;
+	for (std::filesystem::directory_iterator iter(input_dir), end; iter != end; ++ iter)
+	{
+		if (std::filesystem::is_regular_file(iter->status()))
+		{
+			Shader shader;
+			shader.name = iter->path().filename().string();
+			shader.dxbc = ReadFile(iter->path().string());
+			if (!shader.dxbc.empty())
+			{
+				shaders.push_back(std::move(shader));
+			}
+		}
+	}
+	if (shaders.empty())
+	{
+		std::cerr << "No file found in " << input_dir << std::endl;
+		return 1;
+	}
+
+	num_threads = std::min(num_threads, static_cast<uint32_t>(shaders.size()));
+	std::atomic<uint32_t> next_shader(0);
+	auto worker = [&shaders, &next_shader]
+		{
+			// One converter per thread. Its buffers are reused from shader to shader.
+			DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+			for (uint32_t i = next_shader ++; i < shaders.size(); i = next_shader ++)
+			{
+				try
+				{
+					dxbc2glsl.FeedDXBC(&shaders[i].dxbc[0], true, true, STP_Fractional_Odd, STOP_Triangle_CW, GSV_430);
+					shaders[i].glsl = dxbc2glsl.GLSLString();
+				}
+				catch (std::exception& ex)
+				{
+					shaders[i].error = ex.what();
+				}
+			}
+		};
+
+	auto const start = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < num_threads; ++ i)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	double const seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	uint32_t num_failed = 0;
+	for (auto const & shader : shaders)
+	{
+		if (!shader.error.empty())
+		{
+			std::cout << "Error(s) in " << shader.name << ":" << std::endl;
+			std::cout << shader.error << std::endl;
+			++ num_failed;
+		}
+		else if (!output_dir.empty())
+		{
+			std::ofstream out((std::filesystem::path(output_dir) / (shader.name + ".glsl")).string());
+			out << shader.glsl;
+		}
+	}
+
+	std::cout << shaders.size() << " shaders, " << num_failed << " failed, " << num_threads << " threads" << std::endl;
+	std::cout << seconds * 1000 << " ms, " << shaders.size() / seconds << " shaders/sec" << std::endl;
+
+	return (num_failed > 0) ? 1 : 0;
+}
+
 int main(int argc, char** argv)
 {
 	if (argc < 2)
@@ -52,8 +165,20 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
-	std::vector<char> data;
-	std::ifstream in(argv[1], std::ios_base::in | std::ios_base::binary);
+	if (std::string("-batch") == argv[1])
+	{
+		if (argc < 3)
+		{
+			usage();
+			return 1;
+		}
+
+		std::string const output_dir = (argc > 3) ? argv[3] : "";
+		uint32_t num_threads = (argc > 4) ? static_cast<uint32_t>(std::stoul(argv[4])) : std::thread::hardware_concurrency();
+		return BatchConvert(argv[2], output_dir, std::max(num_threads, 1U));
+	}
+
+	std::vector<char> data = ReadFile(argv[1]);
 	std::ofstream out;
 	bool screen_only = false;
 	if (argc < 3)
@@ -65,14 +190,6 @@ int main(int argc, char** argv)
 		out.open(argv[2]);
 	}
 
-	char c;
-	in >> std::noskipws;
-	while (in >> c)
-	{
-		data.push_back(c);
-	}
-	in.close();
-
 	try
 	{
 		DXBC2GLSL::DXBC2GLSL dxbc2glsl;
@@ -67,6 +67,34 @@ namespace KlayGE
 			T tileable_turbulence(T x, T y, T z,
 				T w, T h, T d, int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
 
+			// Batch versions. Coordinates are separated arrays of num samples, results are the same as the single sample ones.
+			// Samples are evaluated 4 at a time with SIMD if available, and all octaves of one group are done in registers.
+			void noise(T const * x, T const * y, T* ret, uint32_t num) noexcept;
+			void noise(T const * x, T const * y, T const * z, T* ret, uint32_t num) noexcept;
+
+			void fBm(T const * x, T const * y, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+			void fBm(T const * x, T const * y, T const * z, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+
+			void turbulence(T const * x, T const * y, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+			void turbulence(T const * x, T const * y, T const * z, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+
+			void tileable_noise(T const * x, T const * y, T w, T h, T* ret, uint32_t num) noexcept;
+			void tileable_noise(T const * x, T const * y, T const * z, T w, T h, T d, T* ret, uint32_t num) noexcept;
+
+			void tileable_fBm(T const * x, T const * y, T w, T h, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+			void tileable_fBm(T const * x, T const * y, T const * z, T w, T h, T d, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+
+			void tileable_turbulence(T const * x, T const * y, T w, T h, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+			void tileable_turbulence(T const * x, T const * y, T const * z, T w, T h, T d, T* ret, uint32_t num,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) noexcept;
+
 		private:
 			SimplexNoise() noexcept;
 
@@ -0,0 +1,511 @@
+/**
+ * @file SIMDBatch.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_SIMDBATCH_HPP
+#define _KFL_SIMDBATCH_HPP
+
+#pragma once
+
+#include <KFL/SIMDMath.hpp>
+#include <KFL/ArrayRef.hpp>
+
+#include <array>
+
+#if defined(SIMD_MATH_SSE)
+	#if defined(KLAYGE_AVX_SUPPORT)
+		#define SIMD_BATCH_AVX
+		#include <immintrin.h>
+	#else
+		#include <emmintrin.h>
+	#endif
+#elif defined(KLAYGE_NEON_SUPPORT)
+	#define SIMD_BATCH_NEON
+	#include <arm_neon.h>
+#endif
+
+// SIMDBatchF<N> holds one float from each of N independent elements (SoA), so a kernel written against it
+// processes N vertices, planes or boxes per instruction. The instruction set is picked at compile time from
+// the KLAYGE_*_SUPPORT macros. SIMDBatchF<8> falls back to two 4 wide halves when AVX is not enabled.
+
+namespace KlayGE
+{
+	template <int N>
+	class SIMDBatchF;
+
+	template <>
+	class SIMDBatchF<4> final
+	{
+	public:
+#if defined(SIMD_MATH_SSE)
+		typedef __m128 NativeType;
+#elif defined(SIMD_BATCH_NEON)
+		typedef float32x4_t NativeType;
+#else
+		typedef std::array<float, 4> NativeType;
+#endif
+
+		static int const width = 4;
+
+	public:
+		SIMDBatchF()
+		{
+		}
+		explicit SIMDBatchF(NativeType const & v)
+			: v_(v)
+		{
+		}
+
+		static SIMDBatchF Set(float v)
+		{
+#if defined(SIMD_MATH_SSE)
+			return SIMDBatchF(_mm_set1_ps(v));
+#elif defined(SIMD_BATCH_NEON)
+			return SIMDBatchF(vdupq_n_f32(v));
+#else
+			return SIMDBatchF(NativeType{ { v, v, v, v } });
+#endif
+		}
+
+		// p doesn't need to be aligned
+		static SIMDBatchF Load(float const * p)
+		{
+#if defined(SIMD_MATH_SSE)
+			return SIMDBatchF(_mm_loadu_ps(p));
+#elif defined(SIMD_BATCH_NEON)
+			return SIMDBatchF(vld1q_f32(p));
+#else
+			return SIMDBatchF(NativeType{ { p[0], p[1], p[2], p[3] } });
+#endif
+		}
+		// Gathers p[0], p[stride], p[stride * 2], ... It's the AoS to SoA path, such as loading x of 4 float3s
+		static SIMDBatchF Load(float const * p, size_t stride)
+		{
+#if defined(SIMD_MATH_SSE)
+			return SIMDBatchF(_mm_setr_ps(p[0], p[stride], p[stride * 2], p[stride * 3]));
+#else
+			float const tmp[] = { p[0], p[stride], p[stride * 2], p[stride * 3] };
+			return Load(tmp);
+#endif
+		}
+
+		void Store(float* p) const
+		{
+#if defined(SIMD_MATH_SSE)
+			_mm_storeu_ps(p, v_);
+#elif defined(SIMD_BATCH_NEON)
+			vst1q_f32(p, v_);
+#else
+			for (int i = 0; i < width; ++ i)
+			{
+				p[i] = v_[i];
+			}
+#endif
+		}
+		void Store(float* p, size_t stride) const
+		{
+			float tmp[width];
+			this->Store(tmp);
+			for (int i = 0; i < width; ++ i)
+			{
+				p[i * stride] = tmp[i];
+			}
+		}
+
+		NativeType& Native()
+		{
+			return v_;
+		}
+		NativeType const & Native() const
+		{
+			return v_;
+		}
+
+	private:
+		NativeType v_;
+	};
+
+	template <>
+	class SIMDBatchF<8> final
+	{
+	public:
+#if defined(SIMD_BATCH_AVX)
+		typedef __m256 NativeType;
+#else
+		typedef std::array<SIMDBatchF<4>, 2> NativeType;
+#endif
+
+		static int const width = 8;
+
+	public:
+		SIMDBatchF()
+		{
+		}
+		explicit SIMDBatchF(NativeType const & v)
+			: v_(v)
+		{
+		}
+#if !defined(SIMD_BATCH_AVX)
+		SIMDBatchF(SIMDBatchF<4> const & lo, SIMDBatchF<4> const & hi)
+			: v_{ { lo, hi } }
+		{
+		}
+#endif
+
+		static SIMDBatchF Set(float v)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return SIMDBatchF(_mm256_set1_ps(v));
+#else
+			return SIMDBatchF(SIMDBatchF<4>::Set(v), SIMDBatchF<4>::Set(v));
+#endif
+		}
+
+		static SIMDBatchF Load(float const * p)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return SIMDBatchF(_mm256_loadu_ps(p));
+#else
+			return SIMDBatchF(SIMDBatchF<4>::Load(p), SIMDBatchF<4>::Load(p + 4));
+#endif
+		}
+		static SIMDBatchF Load(float const * p, size_t stride)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return SIMDBatchF(_mm256_setr_ps(p[0], p[stride], p[stride * 2], p[stride * 3],
+				p[stride * 4], p[stride * 5], p[stride * 6], p[stride * 7]));
+#else
+			return SIMDBatchF(SIMDBatchF<4>::Load(p, stride), SIMDBatchF<4>::Load(p + stride * 4, stride));
+#endif
+		}
+
+		void Store(float* p) const
+		{
+#if defined(SIMD_BATCH_AVX)
+			_mm256_storeu_ps(p, v_);
+#else
+			v_[0].Store(p);
+			v_[1].Store(p + 4);
+#endif
+		}
+		void Store(float* p, size_t stride) const
+		{
+			float tmp[width];
+			this->Store(tmp);
+			for (int i = 0; i < width; ++ i)
+			{
+				p[i * stride] = tmp[i];
+			}
+		}
+
+		NativeType& Native()
+		{
+			return v_;
+		}
+		NativeType const & Native() const
+		{
+			return v_;
+		}
+
+	private:
+		NativeType v_;
+	};
+
+#if defined(SIMD_BATCH_AVX)
+	typedef SIMDBatchF<8> SIMDBatchFNative;
+#else
+	typedef SIMDBatchF<4> SIMDBatchFNative;
+#endif
+
+	inline SIMDBatchF<4> operator+(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs)
+	{
+#if defined(SIMD_MATH_SSE)
+		return SIMDBatchF<4>(_mm_add_ps(lhs.Native(), rhs.Native()));
+#elif defined(SIMD_BATCH_NEON)
+		return SIMDBatchF<4>(vaddq_f32(lhs.Native(), rhs.Native()));
+#else
+		SIMDBatchF<4> ret;
+		for (int i = 0; i < 4; ++ i)
+		{
+			ret.Native()[i] = lhs.Native()[i] + rhs.Native()[i];
+		}
+		return ret;
+#endif
+	}
+	inline SIMDBatchF<4> operator-(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs)
+	{
+#if defined(SIMD_MATH_SSE)
+		return SIMDBatchF<4>(_mm_sub_ps(lhs.Native(), rhs.Native()));
+#elif defined(SIMD_BATCH_NEON)
+		return SIMDBatchF<4>(vsubq_f32(lhs.Native(), rhs.Native()));
+#else
+		SIMDBatchF<4> ret;
+		for (int i = 0; i < 4; ++ i)
+		{
+			ret.Native()[i] = lhs.Native()[i] - rhs.Native()[i];
+		}
+		return ret;
+#endif
+	}
+	inline SIMDBatchF<4> operator*(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs)
+	{
+#if defined(SIMD_MATH_SSE)
+		return SIMDBatchF<4>(_mm_mul_ps(lhs.Native(), rhs.Native()));
+#elif defined(SIMD_BATCH_NEON)
+		return SIMDBatchF<4>(vmulq_f32(lhs.Native(), rhs.Native()));
+#else
+		SIMDBatchF<4> ret;
+		for (int i = 0; i < 4; ++ i)
+		{
+			ret.Native()[i] = lhs.Native()[i] * rhs.Native()[i];
+		}
+		return ret;
+#endif
+	}
+	inline SIMDBatchF<4> operator/(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs)
+	{
+#if defined(SIMD_MATH_SSE)
+		return SIMDBatchF<4>(_mm_div_ps(lhs.Native(), rhs.Native()));
+#else
+		// vdivq_f32 is AArch64 only
+		float l[4];
+		float r[4];
+		lhs.Store(l);
+		rhs.Store(r);
+		for (int i = 0; i < 4; ++ i)
+		{
+			l[i] /= r[i];
+		}
+		return SIMDBatchF<4>::Load(l);
+#endif
+	}
+
+	inline SIMDBatchF<8> operator+(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs)
+	{
+#if defined(SIMD_BATCH_AVX)
+		return SIMDBatchF<8>(_mm256_add_ps(lhs.Native(), rhs.Native()));
+#else
+		return SIMDBatchF<8>(lhs.Native()[0] + rhs.Native()[0], lhs.Native()[1] + rhs.Native()[1]);
+#endif
+	}
+	inline SIMDBatchF<8> operator-(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs)
+	{
+#if defined(SIMD_BATCH_AVX)
+		return SIMDBatchF<8>(_mm256_sub_ps(lhs.Native(), rhs.Native()));
+#else
+		return SIMDBatchF<8>(lhs.Native()[0] - rhs.Native()[0], lhs.Native()[1] - rhs.Native()[1]);
+#endif
+	}
+	inline SIMDBatchF<8> operator*(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs)
+	{
+#if defined(SIMD_BATCH_AVX)
+		return SIMDBatchF<8>(_mm256_mul_ps(lhs.Native(), rhs.Native()));
+#else
+		return SIMDBatchF<8>(lhs.Native()[0] * rhs.Native()[0], lhs.Native()[1] * rhs.Native()[1]);
+#endif
+	}
+	inline SIMDBatchF<8> operator/(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs)
+	{
+#if defined(SIMD_BATCH_AVX)
+		return SIMDBatchF<8>(_mm256_div_ps(lhs.Native(), rhs.Native()));
+#else
+		return SIMDBatchF<8>(lhs.Native()[0] / rhs.Native()[0], lhs.Native()[1] / rhs.Native()[1]);
+#endif
+	}
+
+	// The 6 planes of a Frustum transposed to SoA, so that an AABB is tested against all of them at once.
+	// Rebuild it when the frustum changes, and test many boxes against it.
+	class SIMDFrustum final
+	{
+	public:
+		SIMDFrustum();
+		explicit SIMDFrustum(Frustum const & frustum);
+
+		void Planes(Frustum const & frustum);
+
+		BoundOverlap Intersect(AABBox const & aabb) const;
+
+	private:
+		static int const PLANE_LANES = (6 + SIMDBatchFNative::width - 1) / SIMDBatchFNative::width * SIMDBatchFNative::width;
+
+		float planes_[4][PLANE_LANES];
+	};
+
+	namespace SIMDMathLib
+	{
+		inline SIMDBatchF<4> Minimize(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			return SIMDBatchF<4>(_mm_min_ps(lhs.Native(), rhs.Native()));
+#elif defined(SIMD_BATCH_NEON)
+			return SIMDBatchF<4>(vminq_f32(lhs.Native(), rhs.Native()));
+#else
+			SIMDBatchF<4> ret;
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Native()[i] = std::min(lhs.Native()[i], rhs.Native()[i]);
+			}
+			return ret;
+#endif
+		}
+		inline SIMDBatchF<4> Maximize(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			return SIMDBatchF<4>(_mm_max_ps(lhs.Native(), rhs.Native()));
+#elif defined(SIMD_BATCH_NEON)
+			return SIMDBatchF<4>(vmaxq_f32(lhs.Native(), rhs.Native()));
+#else
+			SIMDBatchF<4> ret;
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Native()[i] = std::max(lhs.Native()[i], rhs.Native()[i]);
+			}
+			return ret;
+#endif
+		}
+		inline SIMDBatchF<4> Abs(SIMDBatchF<4> const & x)
+		{
+#if defined(SIMD_MATH_SSE)
+			return SIMDBatchF<4>(_mm_andnot_ps(_mm_set1_ps(-0.0f), x.Native()));
+#elif defined(SIMD_BATCH_NEON)
+			return SIMDBatchF<4>(vabsq_f32(x.Native()));
+#else
+			SIMDBatchF<4> ret;
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Native()[i] = MathLib::abs(x.Native()[i]);
+			}
+			return ret;
+#endif
+		}
+		// Lane i is (lhs[i] < rhs[i]) ? a[i] : b[i]
+		inline SIMDBatchF<4> SelectLess(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs,
+			SIMDBatchF<4> const & a, SIMDBatchF<4> const & b)
+		{
+#if defined(SIMD_MATH_SSE)
+			__m128 const mask = _mm_cmplt_ps(lhs.Native(), rhs.Native());
+			return SIMDBatchF<4>(_mm_or_ps(_mm_and_ps(mask, a.Native()), _mm_andnot_ps(mask, b.Native())));
+#elif defined(SIMD_BATCH_NEON)
+			return SIMDBatchF<4>(vbslq_f32(vcltq_f32(lhs.Native(), rhs.Native()), a.Native(), b.Native()));
+#else
+			SIMDBatchF<4> ret;
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Native()[i] = (lhs.Native()[i] < rhs.Native()[i]) ? a.Native()[i] : b.Native()[i];
+			}
+			return ret;
+#endif
+		}
+		// Bit i is set if lhs[i] < rhs[i]
+		inline uint32_t LessMask(SIMDBatchF<4> const & lhs, SIMDBatchF<4> const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(lhs.Native(), rhs.Native())));
+#elif defined(SIMD_BATCH_NEON)
+			static uint32_t const lane_bits[] = { 1, 2, 4, 8 };
+			uint32x4_t const bits = vandq_u32(vcltq_f32(lhs.Native(), rhs.Native()), vld1q_u32(lane_bits));
+			return vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) | vgetq_lane_u32(bits, 2) | vgetq_lane_u32(bits, 3);
+#else
+			uint32_t ret = 0;
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret |= (lhs.Native()[i] < rhs.Native()[i]) ? (1U << i) : 0;
+			}
+			return ret;
+#endif
+		}
+
+		inline SIMDBatchF<8> Minimize(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return SIMDBatchF<8>(_mm256_min_ps(lhs.Native(), rhs.Native()));
+#else
+			return SIMDBatchF<8>(Minimize(lhs.Native()[0], rhs.Native()[0]), Minimize(lhs.Native()[1], rhs.Native()[1]));
+#endif
+		}
+		inline SIMDBatchF<8> Maximize(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return SIMDBatchF<8>(_mm256_max_ps(lhs.Native(), rhs.Native()));
+#else
+			return SIMDBatchF<8>(Maximize(lhs.Native()[0], rhs.Native()[0]), Maximize(lhs.Native()[1], rhs.Native()[1]));
+#endif
+		}
+		inline SIMDBatchF<8> Abs(SIMDBatchF<8> const & x)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return SIMDBatchF<8>(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.Native()));
+#else
+			return SIMDBatchF<8>(Abs(x.Native()[0]), Abs(x.Native()[1]));
+#endif
+		}
+		inline SIMDBatchF<8> SelectLess(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs,
+			SIMDBatchF<8> const & a, SIMDBatchF<8> const & b)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return SIMDBatchF<8>(_mm256_blendv_ps(b.Native(), a.Native(), _mm256_cmp_ps(lhs.Native(), rhs.Native(), _CMP_LT_OQ)));
+#else
+			return SIMDBatchF<8>(SelectLess(lhs.Native()[0], rhs.Native()[0], a.Native()[0], b.Native()[0]),
+				SelectLess(lhs.Native()[1], rhs.Native()[1], a.Native()[1], b.Native()[1]));
+#endif
+		}
+		inline uint32_t LessMask(SIMDBatchF<8> const & lhs, SIMDBatchF<8> const & rhs)
+		{
+#if defined(SIMD_BATCH_AVX)
+			return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(lhs.Native(), rhs.Native(), _CMP_LT_OQ)));
+#else
+			return LessMask(lhs.Native()[0], rhs.Native()[0]) | (LessMask(lhs.Native()[1], rhs.Native()[1]) << 4);
+#endif
+		}
+
+		// Arvo's AABB transform on the center/half size form of a box, one box per register
+		inline void TransformAABB(SIMDVectorF4& out_center, SIMDVectorF4& out_half_size,
+			SIMDVectorF4 const & center, SIMDVectorF4 const & half_size, SIMDMatrixF4 const & mat)
+		{
+			out_center = TransformNormalVector3(center, mat) + mat.Row(3);
+			out_half_size = TransformNormalVector3(half_size, SIMDMatrixF4(Abs(mat.Row(0)), Abs(mat.Row(1)), Abs(mat.Row(2)), mat.Row(3)));
+		}
+
+		// Batched versions of MathLib functions. The results are the same as calling the scalar ones per element.
+		void TransformCoordVector3(float3* out, float3 const * in, size_t num, float4x4 const & mat);
+		void TransformNormalVector3(float3* out, float3 const * in, size_t num, float4x4 const & mat);
+
+		// MathLib::transform_aabb over arrays. mats has either one matrix per box, or a single matrix for all of them.
+		void TransformAABBs(AABBox* out, ArrayRef<AABBox> aabbs, ArrayRef<float4x4> mats);
+		void TransformAABBs(float3* out_centers, float3* out_half_sizes,
+			ArrayRef<float3> centers, ArrayRef<float3> half_sizes, ArrayRef<float4x4> mats);
+		// Takes the SoA frustum built once by the caller, transposing the planes costs about as much as one test
+		inline BoundOverlap IntersectAABBFrustum(AABBox const & aabb, SIMDFrustum const & frustum)
+		{
+			return frustum.Intersect(aabb);
+		}
+	}
+}
+
+#endif		// _KFL_SIMDBATCH_HPP
@@ -51,11 +51,11 @@ namespace KlayGE
 	{
 		// General Vector
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 Add(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Substract(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Multiply(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Divide(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Negative(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Add(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Substract(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Multiply(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Divide(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Negative(SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 BaryCentric(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2, SIMDVectorF4 const & v3,
 			float f, float g);
@@ -69,28 +69,30 @@ namespace KlayGE
 			SIMDVectorF4 const & v2, SIMDVectorF4 const & t2, float s);
 		SIMDVectorF4 Lerp(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs, float s);
 
-		SIMDVectorF4 Abs(SIMDVectorF4 const & x);
+		inline SIMDVectorF4 Abs(SIMDVectorF4 const & x);
 		SIMDVectorF4 Sgn(SIMDVectorF4 const & x);
 		SIMDVectorF4 Sqr(SIMDVectorF4 const & x);
 		SIMDVectorF4 Cube(SIMDVectorF4 const & x);
 
-		SIMDVectorF4 LoadVector1(float v);
-		SIMDVectorF4 LoadVector2(float2 const & v);
-		SIMDVectorF4 LoadVector3(float3 const & v);
-		SIMDVectorF4 LoadVector4(float4 const & v);
-		SIMDVectorF4 LoadVector2(float const * v);
-		SIMDVectorF4 LoadVector3(float const * v);
-		SIMDVectorF4 LoadVector4(float const * v);
-		void StoreVector1(float& fs, SIMDVectorF4 const & v);
-		void StoreVector2(float2& fs, SIMDVectorF4 const & v);
-		void StoreVector3(float3& fs, SIMDVectorF4 const & v);
-		void StoreVector4(float4& fs, SIMDVectorF4 const & v);
-		SIMDVectorF4 SetVector(float x, float y, float z, float w);
-		SIMDVectorF4 SetVector(float v);
-		float GetX(SIMDVectorF4 const & rhs);
-		float GetY(SIMDVectorF4 const & rhs);
-		float GetZ(SIMDVectorF4 const & rhs);
-		float GetW(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 LoadVector1(float v);
+		inline SIMDVectorF4 LoadVector2(float2 const & v);
+		inline SIMDVectorF4 LoadVector3(float3 const & v);
+		inline SIMDVectorF4 LoadVector4(float4 const & v);
+		inline SIMDVectorF4 LoadVector2(float const * v);
+		inline SIMDVectorF4 LoadVector3(float const * v);
+		inline SIMDVectorF4 LoadVector4(float const * v);
+		inline void StoreVector1(float& fs, SIMDVectorF4 const & v);
+		inline void StoreVector2(float2& fs, SIMDVectorF4 const & v);
+		inline void StoreVector3(float3& fs, SIMDVectorF4 const & v);
+		inline void StoreVector4(float4& fs, SIMDVectorF4 const & v);
+		inline SIMDVectorF4 LoadQuaternion(Quaternion const & q);
+		inline void StoreQuaternion(Quaternion& q, SIMDVectorF4 const & v);
+		inline SIMDVectorF4 SetVector(float x, float y, float z, float w);
+		inline SIMDVectorF4 SetVector(float v);
+		inline float GetX(SIMDVectorF4 const & rhs);
+		inline float GetY(SIMDVectorF4 const & rhs);
+		inline float GetZ(SIMDVectorF4 const & rhs);
+		inline float GetW(SIMDVectorF4 const & rhs);
 		float GetByIndex(SIMDVectorF4 const & rhs, size_t index);
 		SIMDVectorF4 SetX(SIMDVectorF4 const & rhs, float v);
 		SIMDVectorF4 SetY(SIMDVectorF4 const & rhs, float v);
@@ -98,8 +100,8 @@ namespace KlayGE
 		SIMDVectorF4 SetW(SIMDVectorF4 const & rhs, float v);
 		SIMDVectorF4 SetByIndex(SIMDVectorF4 const & rhs, float v, size_t index);
 
-		SIMDVectorF4 Maximize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Minimize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Maximize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Minimize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 Reflect(SIMDVectorF4 const & incident, SIMDVectorF4 const & normal);
 		SIMDVectorF4 Refract(SIMDVectorF4 const & incident, SIMDVectorF4 const & normal, float refraction_index);
@@ -117,14 +119,14 @@ namespace KlayGE
 		// 3D Vector
 		///////////////////////////////////////////////////////////////////////////////
 		SIMDVectorF4 Angle(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 CrossVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 DotVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthSqVector3(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 CrossVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 DotVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 LengthSqVector3(SIMDVectorF4 const & rhs);
 		SIMDVectorF4 LengthVector3(SIMDVectorF4 const & rhs);
 		SIMDVectorF4 NormalizeVector3(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 TransformCoordVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
-		SIMDVectorF4 TransformNormalVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
-		SIMDVectorF4 TransformQuat(SIMDVectorF4 const & v, SIMDVectorF4 const & quat);
+		inline SIMDVectorF4 TransformCoordVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		inline SIMDVectorF4 TransformNormalVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		inline SIMDVectorF4 TransformQuat(SIMDVectorF4 const & v, SIMDVectorF4 const & quat);
 		SIMDVectorF4 Project(SIMDVectorF4 const & vec,
 			SIMDMatrixF4 const & world, SIMDMatrixF4 const & view, SIMDMatrixF4 const & proj,
 			int const viewport[4], float near_plane, float far_plane);
@@ -135,18 +137,21 @@ namespace KlayGE
 		// 4D Vector
 		///////////////////////////////////////////////////////////////////////////////
 		SIMDVectorF4 CrossVector4(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2, SIMDVectorF4 const & v3);
-		SIMDVectorF4 DotVector4(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthSqVector4(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 DotVector4(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 LengthSqVector4(SIMDVectorF4 const & rhs);
 		SIMDVectorF4 LengthVector4(SIMDVectorF4 const & rhs);
 		SIMDVectorF4 NormalizeVector4(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 TransformVector4(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		inline SIMDVectorF4 TransformVector4(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
 
 		// 4D Matrix
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDMatrixF4 Add(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4 Substract(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, float rhs);
+		inline SIMDMatrixF4 Add(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
+		inline SIMDMatrixF4 Substract(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
+		inline SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
+		inline SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, float rhs);
+		inline SIMDMatrixF4 LoadMatrix(float4x4 const & m);
+		inline void StoreMatrix(float4x4& m, SIMDMatrixF4 const & v);
+		inline float4x4 Multiply(float4x4 const & lhs, float4x4 const & rhs);
 		SIMDVectorF4 Determinant(SIMDMatrixF4 const & rhs);
 		SIMDMatrixF4 Negative(SIMDMatrixF4 const & rhs);
 		SIMDMatrixF4 Inverse(SIMDMatrixF4 const & rhs);
@@ -191,7 +196,7 @@ namespace KlayGE
 		SIMDMatrixF4 Translation(float x, float y, float z);
 		SIMDMatrixF4 Translation(SIMDVectorF4 const & pos);
 
-		SIMDMatrixF4 Transpose(SIMDMatrixF4 const & rhs);
+		inline SIMDMatrixF4 Transpose(SIMDMatrixF4 const & rhs);
 
 		SIMDMatrixF4 LHToRH(SIMDMatrixF4 const & rhs);
 		SIMDMatrixF4 RHToLH(SIMDMatrixF4 const & rhs);
@@ -202,7 +207,7 @@ namespace KlayGE
 
 		// Quaternion
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 Conjugate(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 Conjugate(SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 AxisToAxis(SIMDVectorF4 const & from, SIMDVectorF4 const & to);
 		SIMDVectorF4 UnitAxisToUnitAxis(SIMDVectorF4 const & from, SIMDVectorF4 const & to);
@@ -215,7 +220,7 @@ namespace KlayGE
 
 		SIMDVectorF4 Inverse(SIMDVectorF4 const & rhs);
 
-		SIMDVectorF4 MultiplyQuat(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 MultiplyQuat(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 RotationAxis(SIMDVectorF4 const & v, float angle);
 		SIMDVectorF4 RotationQuatYawPitchRoll(float yaw, float pitch, float roll);
@@ -261,5 +266,6 @@ namespace KlayGE
 
 #include <KFL/SIMDVector.hpp>
 #include <KFL/SIMDMatrix.hpp>
+#include <KFL/Detail/SIMDMathInline.hpp>
 
 #endif		// _KFL_SIMDMATH_HPP
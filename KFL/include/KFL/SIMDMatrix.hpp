@@ -45,11 +45,22 @@ namespace KlayGE
 								boost::multipliable<SIMDMatrixF4>>>>>
 	{
 	public:
-		SIMDMatrixF4();
-		explicit SIMDMatrixF4(float const * rhs);
-		SIMDMatrixF4(SIMDMatrixF4 const & rhs);
+		SIMDMatrixF4()
+		{
+		}
+		inline explicit SIMDMatrixF4(float const * rhs);
+		SIMDMatrixF4(SIMDMatrixF4 const & rhs)
+			: m_(rhs.m_)
+		{
+		}
 		SIMDMatrixF4(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2,
-			SIMDVectorF4 const & v3, SIMDVectorF4 const & v4);
+			SIMDVectorF4 const & v3, SIMDVectorF4 const & v4)
+		{
+			m_[0] = v1;
+			m_[1] = v2;
+			m_[2] = v3;
+			m_[3] = v4;
+		}
 		SIMDMatrixF4(float f11, float f12, float f13, float f14,
 			float f21, float f22, float f23, float f24,
 			float f31, float f32, float f33, float f34,
@@ -63,28 +74,79 @@ namespace KlayGE
 		static SIMDMatrixF4 const & Zero();
 		static SIMDMatrixF4 const & Identity();
 
-		void Row(size_t index, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & Row(size_t index) const;
+		void Row(size_t index, SIMDVectorF4 const & rhs)
+		{
+			m_[index] = rhs;
+		}
+		SIMDVectorF4 const & Row(size_t index) const
+		{
+			return m_[index];
+		}
 		void Col(size_t index, SIMDVectorF4 const & rhs);
 		SIMDVectorF4 const Col(size_t index) const;
 
 		void Set(size_t row, size_t col, float v);
 		float operator()(size_t row, size_t col) const;
 
-		SIMDMatrixF4& operator+=(SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4& operator-=(SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4& operator*=(SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4& operator*=(float rhs);
-		SIMDMatrixF4& operator/=(float rhs);
+		inline SIMDMatrixF4& operator+=(SIMDMatrixF4 const & rhs);
+		inline SIMDMatrixF4& operator-=(SIMDMatrixF4 const & rhs);
+		inline SIMDMatrixF4& operator*=(SIMDMatrixF4 const & rhs);
+		inline SIMDMatrixF4& operator*=(float rhs);
+		inline SIMDMatrixF4& operator/=(float rhs);
 
-		SIMDMatrixF4& operator=(SIMDMatrixF4 const & rhs);
+		SIMDMatrixF4& operator=(SIMDMatrixF4 const & rhs)
+		{
+			m_ = rhs.m_;
+			return *this;
+		}
 
-		SIMDMatrixF4 const operator+() const;
+		SIMDMatrixF4 const operator+() const
+		{
+			return *this;
+		}
 		SIMDMatrixF4 const operator-() const;
 
 	private:
 		std::array<SIMDVectorF4, 4> m_;
 	};
+
+	SIMDMatrixF4::SIMDMatrixF4(float const * rhs)
+	{
+		m_[0] = SIMDMathLib::LoadVector4(rhs + 0);
+		m_[1] = SIMDMathLib::LoadVector4(rhs + 4);
+		m_[2] = SIMDMathLib::LoadVector4(rhs + 8);
+		m_[3] = SIMDMathLib::LoadVector4(rhs + 12);
+	}
+
+	SIMDMatrixF4& SIMDMatrixF4::operator+=(SIMDMatrixF4 const & rhs)
+	{
+		*this = SIMDMathLib::Add(*this, rhs);
+		return *this;
+	}
+
+	SIMDMatrixF4& SIMDMatrixF4::operator-=(SIMDMatrixF4 const & rhs)
+	{
+		*this = SIMDMathLib::Substract(*this, rhs);
+		return *this;
+	}
+
+	SIMDMatrixF4& SIMDMatrixF4::operator*=(SIMDMatrixF4 const & rhs)
+	{
+		*this = SIMDMathLib::Multiply(*this, rhs);
+		return *this;
+	}
+
+	SIMDMatrixF4& SIMDMatrixF4::operator*=(float rhs)
+	{
+		*this = SIMDMathLib::Multiply(*this, rhs);
+		return *this;
+	}
+
+	SIMDMatrixF4& SIMDMatrixF4::operator/=(float rhs)
+	{
+		*this = SIMDMathLib::Multiply(*this, 1.0f / rhs);
+		return *this;
+	}
 }
 
 #endif			// _KFL_SIMDMATRIX_HPP
@@ -56,7 +56,10 @@ namespace KlayGE
 		SIMDVectorF4()
 		{
 		}
-		SIMDVectorF4(SIMDVectorF4 const & rhs);
+		SIMDVectorF4(SIMDVectorF4 const & rhs)
+			: vec_(rhs.vec_)
+		{
+		}
 
 		static size_t size()
 		{
@@ -74,21 +77,31 @@ namespace KlayGE
 			return vec_;
 		}
 
-		SIMDVectorF4 const & operator+=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator+=(float rhs);
-		SIMDVectorF4 const & operator-=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator-=(float rhs);
-		SIMDVectorF4 const & operator*=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator*=(float rhs);
-		SIMDVectorF4 const & operator/=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator/=(float rhs);
+		inline SIMDVectorF4 const & operator+=(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 const & operator+=(float rhs);
+		inline SIMDVectorF4 const & operator-=(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 const & operator-=(float rhs);
+		inline SIMDVectorF4 const & operator*=(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 const & operator*=(float rhs);
+		inline SIMDVectorF4 const & operator/=(SIMDVectorF4 const & rhs);
+		inline SIMDVectorF4 const & operator/=(float rhs);
 
-		SIMDVectorF4& operator=(SIMDVectorF4 const & rhs);
+		SIMDVectorF4& operator=(SIMDVectorF4 const & rhs)
+		{
+			vec_ = rhs.vec_;
+			return *this;
+		}
 
-		SIMDVectorF4 const operator+() const;
-		SIMDVectorF4 const operator-() const;
+		SIMDVectorF4 const operator+() const
+		{
+			return *this;
+		}
+		inline SIMDVectorF4 const operator-() const;
 
-		void swap(SIMDVectorF4& rhs);
+		void swap(SIMDVectorF4& rhs)
+		{
+			std::swap(vec_, rhs.vec_);
+		}
 
 	private:
 		V4TYPE vec_;
@@ -98,6 +111,58 @@ namespace KlayGE
 	{
 		lhs.swap(rhs);
 	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator+=(SIMDVectorF4 const & rhs)
+	{
+		*this = SIMDMathLib::Add(*this, rhs);
+		return *this;
+	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator+=(float rhs)
+	{
+		*this += SIMDMathLib::SetVector(rhs);
+		return *this;
+	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator-=(SIMDVectorF4 const & rhs)
+	{
+		*this = SIMDMathLib::Substract(*this, rhs);
+		return *this;
+	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator-=(float rhs)
+	{
+		*this -= SIMDMathLib::SetVector(rhs);
+		return *this;
+	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator*=(SIMDVectorF4 const & rhs)
+	{
+		*this = SIMDMathLib::Multiply(*this, rhs);
+		return *this;
+	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator*=(float rhs)
+	{
+		*this = SIMDMathLib::Multiply(*this, SIMDMathLib::SetVector(rhs));
+		return *this;
+	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator/=(SIMDVectorF4 const & rhs)
+	{
+		*this = SIMDMathLib::Divide(*this, rhs);
+		return *this;
+	}
+
+	SIMDVectorF4 const & SIMDVectorF4::operator/=(float rhs)
+	{
+		return this->operator*=(1.0f / rhs);
+	}
+
+	SIMDVectorF4 const SIMDVectorF4::operator-() const
+	{
+		return SIMDMathLib::Negative(*this);
+	}
 }
 
 #endif			// _KFL_SIMDVECTOR_HPP
@@ -34,6 +34,8 @@
 #pragma once
 
 #include <boost/assert.hpp>
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <condition_variable>
 #include <mutex>
@@ -591,6 +593,72 @@ namespace KlayGE
 			return joiner_t(myjoiner_data);
 		}
 
+		// Calls func(i) for every i in [0, count), on at most max_workers threads including the calling one.
+		// Indices are taken from a shared counter, so items of very different costs still keep all workers busy.
+		// max_workers == 0 means hardware concurrency. Don't call it from inside func, each worker holds a pooled thread.
+		template <typename Func>
+		void parallel_for(uint32_t count, Func const & func, uint32_t max_workers = 0)
+		{
+			if (0 == max_workers)
+			{
+				max_workers = std::max(std::thread::hardware_concurrency(), 1U);
+			}
+			uint32_t const num_workers = std::min(count, max_workers);
+			if (num_workers <= 1)
+			{
+				for (uint32_t i = 0; i < count; ++ i)
+				{
+					func(i);
+				}
+			}
+			else
+			{
+				std::atomic<uint32_t> next(0);
+				auto worker = [&next, &func, count]
+					{
+						for (uint32_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+						{
+							func(i);
+						}
+					};
+
+				std::vector<joiner<void>> joiners;
+				joiners.reserve(num_workers - 1);
+				for (uint32_t i = 1; i < num_workers; ++ i)
+				{
+					joiners.push_back((*this)(worker));
+				}
+				worker();
+				for (auto& j : joiners)
+				{
+					j();
+				}
+			}
+		}
+
+		// Splits [0, count) into even contiguous bands, as many as have room for min_band_size items each, and calls
+		// func(begin, end) for every band through parallel_for. Jobs smaller than two bands, or max_workers == 1,
+		// run as one band on the calling thread.
+		template <typename Func>
+		void parallel_for_bands(uint32_t count, uint32_t min_band_size, Func const & func, uint32_t max_workers = 0)
+		{
+			if (0 == count)
+			{
+				return;
+			}
+
+			uint32_t num_bands = (1 == max_workers) ? 1 : count / std::max(min_band_size, 1U);
+			num_bands = std::max(num_bands, 1U);
+			uint32_t const band_size = (count + num_bands - 1) / num_bands;
+			num_bands = (count + band_size - 1) / band_size;
+
+			this->parallel_for(num_bands, [&func, count, band_size](uint32_t band)
+				{
+					uint32_t const begin = band * band_size;
+					func(begin, std::min(begin + band_size, count));
+				}, max_workers);
+		}
+
 		size_t num_min_cached_threads() const
 		{
 			return data_->num_min_cached_threads();
@@ -612,6 +680,56 @@ namespace KlayGE
 	private:
 		std::shared_ptr<thread_pool_common_data_t> data_;
 	};
+
+	// Hands the newest of a stream of values from one producer thread to one consumer thread, without locks. Values
+	// live in 3 slots, one owned by the producer, one by the consumer, and one in between. publish() swaps the
+	// producer's slot with the middle one, acquire() swaps the consumer's slot with it if something new is there.
+	// Neither side ever waits. Values published faster than they're acquired replace each other.
+	class triple_buffer_index
+	{
+	public:
+		triple_buffer_index()
+			: ready_(1), write_(0), read_(2)
+		{
+		}
+
+		// The slot the producer fills
+		uint32_t write_index() const
+		{
+			return write_;
+		}
+		// Returns true if the value it replaced was never acquired
+		bool publish()
+		{
+			uint32_t const old = ready_.exchange(write_ | fresh_bit, std::memory_order_acq_rel);
+			write_ = old & slot_mask;
+			return (old & fresh_bit) != 0;
+		}
+
+		// The slot the consumer reads
+		uint32_t read_index() const
+		{
+			return read_;
+		}
+		// Returns false if nothing was published since the last acquire, and the read slot is kept
+		bool acquire()
+		{
+			if (ready_.load(std::memory_order_relaxed) & fresh_bit)
+			{
+				read_ = ready_.exchange(read_, std::memory_order_acq_rel) & slot_mask;
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		static uint32_t const slot_mask = 3;
+		static uint32_t const fresh_bit = 4;
+
+		std::atomic<uint32_t> ready_;
+		uint32_t write_;
+		uint32_t read_;
+	};
 }
 
 #endif		// _KFL_THREAD_HPP
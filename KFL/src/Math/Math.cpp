@@ -2319,11 +2319,19 @@ namespace KlayGE
 		template <typename T>
 		AABBox_T<T> transform_aabb(AABBox_T<T> const & aabb, Matrix4_T<T> const & mat) noexcept
 		{
-			Vector_T<T, 3> scale, trans;
-			Quaternion_T<T> rot;
-			decompose(scale, rot, trans, mat);
+			// Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems. The center goes through the affine part
+			// of mat, the half size goes through the absolute values of the 3x3 part. No decompose, and exact for shear.
+			Vector_T<T, 3> const center = aabb.Center();
+			Vector_T<T, 3> const half_size = aabb.HalfSize();
+
+			Vector_T<T, 3> new_center, new_half_size;
+			for (int j = 0; j < 3; ++ j)
+			{
+				new_center[j] = center.x() * mat(0, j) + center.y() * mat(1, j) + center.z() * mat(2, j) + mat(3, j);
+				new_half_size[j] = half_size.x() * abs(mat(0, j)) + half_size.y() * abs(mat(1, j)) + half_size.z() * abs(mat(2, j));
+			}
 
-			return transform_aabb(aabb, scale, rot, trans);
+			return AABBox_T<T>(new_center - new_half_size, new_center + new_half_size);
 		}
 
 		template AABBox transform_aabb(AABBox const & aabb, float3 const & scale, Quaternion const & rot, float3 const & trans) noexcept;
@@ -29,9 +29,334 @@
  */
 
 #include <KFL/KFL.hpp>
+#include <KFL/SIMDMath.hpp>
+
+#if defined(SIMD_MATH_SSE)
+#include <emmintrin.h>
+#endif
 
 #include <KFL/Noise.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	// Generic fallback, no sample is handled here. The caller evaluates all of them one by one.
+	template <typename T>
+	uint32_t SimplexFractal2DSIMD(int const * perm, T const * x, T const * y, T w, T h, bool tileable, T* ret, uint32_t num,
+		int octaves, T lacunarity, T gain, bool turbulence) noexcept
+	{
+		KFL_UNUSED(perm);
+		KFL_UNUSED(x);
+		KFL_UNUSED(y);
+		KFL_UNUSED(w);
+		KFL_UNUSED(h);
+		KFL_UNUSED(tileable);
+		KFL_UNUSED(ret);
+		KFL_UNUSED(num);
+		KFL_UNUSED(octaves);
+		KFL_UNUSED(lacunarity);
+		KFL_UNUSED(gain);
+		KFL_UNUSED(turbulence);
+		return 0;
+	}
+
+	template <typename T>
+	uint32_t SimplexFractal3DSIMD(int const * perm, T const * x, T const * y, T const * z, T w, T h, T d, bool tileable,
+		T* ret, uint32_t num, int octaves, T lacunarity, T gain, bool turbulence) noexcept
+	{
+		KFL_UNUSED(perm);
+		KFL_UNUSED(x);
+		KFL_UNUSED(y);
+		KFL_UNUSED(z);
+		KFL_UNUSED(w);
+		KFL_UNUSED(h);
+		KFL_UNUSED(d);
+		KFL_UNUSED(tileable);
+		KFL_UNUSED(ret);
+		KFL_UNUSED(num);
+		KFL_UNUSED(octaves);
+		KFL_UNUSED(lacunarity);
+		KFL_UNUSED(gain);
+		KFL_UNUSED(turbulence);
+		return 0;
+	}
+
+#if defined(SIMD_MATH_SSE)
+	// Same as SimplexNoise::g_
+	float const GRAD3[12][3] =
+	{
+		{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+		{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+		{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 }
+	};
+
+	// Same as MathLib::floor, used by the scalar version, to get the same simplex cells
+	__m128 Floor4(__m128 v) noexcept
+	{
+		v = _mm_sub_ps(v, _mm_and_ps(_mm_cmple_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+		return _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+	}
+
+	// t^4 * dot(g, v) for t > 0, 0 otherwise. There is no gather in SSE2, gradients are loaded lane by lane.
+	__m128 SimplexCorner4(__m128 t, int const * gi, __m128 x, __m128 y, __m128 z) noexcept
+	{
+		__m128 const gx = _mm_setr_ps(GRAD3[gi[0]][0], GRAD3[gi[1]][0], GRAD3[gi[2]][0], GRAD3[gi[3]][0]);
+		__m128 const gy = _mm_setr_ps(GRAD3[gi[0]][1], GRAD3[gi[1]][1], GRAD3[gi[2]][1], GRAD3[gi[3]][1]);
+		__m128 const gz = _mm_setr_ps(GRAD3[gi[0]][2], GRAD3[gi[1]][2], GRAD3[gi[2]][2], GRAD3[gi[3]][2]);
+		__m128 const dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, x), _mm_mul_ps(gy, y)), _mm_mul_ps(gz, z));
+
+		t = _mm_max_ps(t, _mm_setzero_ps());
+		t = _mm_mul_ps(t, t);
+		return _mm_mul_ps(_mm_mul_ps(t, t), dot);
+	}
+
+	__m128 SimplexNoise2D4(int const * perm, __m128 x, __m128 y) noexcept
+	{
+		__m128 const F2 = _mm_set1_ps(0.366025403784f);
+		__m128 const G2 = _mm_set1_ps(0.211324865405f);
+		__m128 const G2_2 = _mm_set1_ps(2 * 0.211324865405f);
+		__m128 const one = _mm_set1_ps(1.0f);
+		__m128 const half = _mm_set1_ps(0.5f);
+
+		__m128 const s = _mm_mul_ps(_mm_add_ps(x, y), F2);
+		__m128 const i = Floor4(_mm_add_ps(x, s));
+		__m128 const j = Floor4(_mm_add_ps(y, s));
+		__m128 const t = _mm_mul_ps(_mm_add_ps(i, j), G2);
+		__m128 const x0 = _mm_sub_ps(x, _mm_sub_ps(i, t));
+		__m128 const y0 = _mm_sub_ps(y, _mm_sub_ps(j, t));
+
+		__m128 const x_major = _mm_cmpgt_ps(x0, y0);
+		__m128 const i1 = _mm_and_ps(x_major, one);
+		__m128 const j1 = _mm_andnot_ps(x_major, one);
+
+		__m128 const x1 = _mm_add_ps(_mm_sub_ps(x0, i1), G2);
+		__m128 const y1 = _mm_add_ps(_mm_sub_ps(y0, j1), G2);
+		__m128 const x2 = _mm_add_ps(_mm_sub_ps(x0, one), G2_2);
+		__m128 const y2 = _mm_add_ps(_mm_sub_ps(y0, one), G2_2);
+
+		__m128i const mask = _mm_set1_epi32(255);
+		alignas(16) int32_t ii[4];
+		alignas(16) int32_t jj[4];
+		alignas(16) int32_t ii1[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(ii), _mm_and_si128(_mm_cvttps_epi32(i), mask));
+		_mm_store_si128(reinterpret_cast<__m128i*>(jj), _mm_and_si128(_mm_cvttps_epi32(j), mask));
+		_mm_store_si128(reinterpret_cast<__m128i*>(ii1), _mm_cvttps_epi32(i1));
+
+		int gi0[4];
+		int gi1[4];
+		int gi2[4];
+		for (int l = 0; l < 4; ++ l)
+		{
+			gi0[l] = perm[ii[l] + perm[jj[l]]] % 12;
+			gi1[l] = perm[ii[l] + ii1[l] + perm[jj[l] + 1 - ii1[l]]] % 12;
+			gi2[l] = perm[ii[l] + 1 + perm[jj[l] + 1]] % 12;
+		}
+
+		__m128 const zero = _mm_setzero_ps();
+		__m128 n = SimplexCorner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), gi0, x0, y0, zero);
+		n = _mm_add_ps(n,
+			SimplexCorner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), gi1, x1, y1, zero));
+		n = _mm_add_ps(n,
+			SimplexCorner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), gi2, x2, y2, zero));
+
+		return _mm_mul_ps(_mm_set1_ps(70.0f), n);
+	}
+
+	__m128 SimplexNoise3D4(int const * perm, __m128 x, __m128 y, __m128 z) noexcept
+	{
+		__m128 const F3 = _mm_set1_ps(1 / 3.0f);
+		__m128 const G3 = _mm_set1_ps(1 / 6.0f);
+		__m128 const G3_2 = _mm_set1_ps(2 * (1 / 6.0f));
+		__m128 const G3_3 = _mm_set1_ps(3 * (1 / 6.0f));
+		__m128 const one = _mm_set1_ps(1.0f);
+		__m128 const two = _mm_set1_ps(2.0f);
+		__m128 const r2 = _mm_set1_ps(0.6f);
+
+		__m128 const s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), F3);
+		__m128 const i = Floor4(_mm_add_ps(x, s));
+		__m128 const j = Floor4(_mm_add_ps(y, s));
+		__m128 const k = Floor4(_mm_add_ps(z, s));
+		__m128 const t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(i, j), k), G3);
+		__m128 const x0 = _mm_sub_ps(x, _mm_sub_ps(i, t));
+		__m128 const y0 = _mm_sub_ps(y, _mm_sub_ps(j, t));
+		__m128 const z0 = _mm_sub_ps(z, _mm_sub_ps(k, t));
+
+		// Branchless form of the corner ordering in the scalar version.
+		// i1 + j1 + k1 is always 1, and i2 + j2 + k2 is always 2.
+		__m128 const xy = _mm_cmpge_ps(x0, y0);
+		__m128 const yz = _mm_cmpge_ps(y0, z0);
+		__m128 const xz = _mm_cmpge_ps(x0, z0);
+		__m128 const i1 = _mm_and_ps(_mm_and_ps(xy, xz), one);
+		__m128 const j1 = _mm_and_ps(_mm_andnot_ps(xy, yz), one);
+		__m128 const k1 = _mm_sub_ps(_mm_sub_ps(one, i1), j1);
+		__m128 const i2 = _mm_and_ps(_mm_or_ps(xy, _mm_and_ps(yz, xz)), one);
+		__m128 const j2 = _mm_or_ps(_mm_andnot_ps(xy, one), _mm_and_ps(yz, one));
+		__m128 const k2 = _mm_sub_ps(_mm_sub_ps(two, i2), j2);
+
+		__m128 const x1 = _mm_add_ps(_mm_sub_ps(x0, i1), G3);
+		__m128 const y1 = _mm_add_ps(_mm_sub_ps(y0, j1), G3);
+		__m128 const z1 = _mm_add_ps(_mm_sub_ps(z0, k1), G3);
+		__m128 const x2 = _mm_add_ps(_mm_sub_ps(x0, i2), G3_2);
+		__m128 const y2 = _mm_add_ps(_mm_sub_ps(y0, j2), G3_2);
+		__m128 const z2 = _mm_add_ps(_mm_sub_ps(z0, k2), G3_2);
+		__m128 const x3 = _mm_add_ps(_mm_sub_ps(x0, one), G3_3);
+		__m128 const y3 = _mm_add_ps(_mm_sub_ps(y0, one), G3_3);
+		__m128 const z3 = _mm_add_ps(_mm_sub_ps(z0, one), G3_3);
+
+		__m128i const mask = _mm_set1_epi32(255);
+		alignas(16) int32_t ii[4];
+		alignas(16) int32_t jj[4];
+		alignas(16) int32_t kk[4];
+		alignas(16) int32_t offsets[6][4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(ii), _mm_and_si128(_mm_cvttps_epi32(i), mask));
+		_mm_store_si128(reinterpret_cast<__m128i*>(jj), _mm_and_si128(_mm_cvttps_epi32(j), mask));
+		_mm_store_si128(reinterpret_cast<__m128i*>(kk), _mm_and_si128(_mm_cvttps_epi32(k), mask));
+		_mm_store_si128(reinterpret_cast<__m128i*>(offsets[0]), _mm_cvttps_epi32(i1));
+		_mm_store_si128(reinterpret_cast<__m128i*>(offsets[1]), _mm_cvttps_epi32(j1));
+		_mm_store_si128(reinterpret_cast<__m128i*>(offsets[2]), _mm_cvttps_epi32(k1));
+		_mm_store_si128(reinterpret_cast<__m128i*>(offsets[3]), _mm_cvttps_epi32(i2));
+		_mm_store_si128(reinterpret_cast<__m128i*>(offsets[4]), _mm_cvttps_epi32(j2));
+		_mm_store_si128(reinterpret_cast<__m128i*>(offsets[5]), _mm_cvttps_epi32(k2));
+
+		int gi0[4];
+		int gi1[4];
+		int gi2[4];
+		int gi3[4];
+		for (int l = 0; l < 4; ++ l)
+		{
+			gi0[l] = perm[ii[l] + perm[jj[l] + perm[kk[l]]]] % 12;
+			gi1[l] = perm[ii[l] + offsets[0][l] + perm[jj[l] + offsets[1][l] + perm[kk[l] + offsets[2][l]]]] % 12;
+			gi2[l] = perm[ii[l] + offsets[3][l] + perm[jj[l] + offsets[4][l] + perm[kk[l] + offsets[5][l]]]] % 12;
+			gi3[l] = perm[ii[l] + 1 + perm[jj[l] + 1 + perm[kk[l] + 1]]] % 12;
+		}
+
+		__m128 n = SimplexCorner4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)),
+			_mm_mul_ps(z0, z0)), gi0, x0, y0, z0);
+		n = _mm_add_ps(n, SimplexCorner4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)),
+			_mm_mul_ps(z1, z1)), gi1, x1, y1, z1));
+		n = _mm_add_ps(n, SimplexCorner4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)),
+			_mm_mul_ps(z2, z2)), gi2, x2, y2, z2));
+		n = _mm_add_ps(n, SimplexCorner4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x3, x3)), _mm_mul_ps(y3, y3)),
+			_mm_mul_ps(z3, z3)), gi3, x3, y3, z3));
+
+		return _mm_mul_ps(_mm_set1_ps(32.0f), n);
+	}
+
+	__m128 TileableSimplexNoise2D4(int const * perm, __m128 x, __m128 y, __m128 w, __m128 h) noexcept
+	{
+		__m128 const x_w = _mm_sub_ps(x, w);
+		__m128 const y_h = _mm_sub_ps(y, h);
+		__m128 const wx = _mm_sub_ps(w, x);
+		__m128 const hy = _mm_sub_ps(h, y);
+
+		__m128 n = _mm_mul_ps(_mm_mul_ps(SimplexNoise2D4(perm, x, y), wx), hy);
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(SimplexNoise2D4(perm, x_w, y), x), hy));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(SimplexNoise2D4(perm, x, y_h), wx), y));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(SimplexNoise2D4(perm, x_w, y_h), x), y));
+		return _mm_div_ps(n, _mm_mul_ps(w, h));
+	}
+
+	__m128 TileableSimplexNoise3D4(int const * perm, __m128 x, __m128 y, __m128 z, __m128 w, __m128 h, __m128 d) noexcept
+	{
+		__m128 const x_w = _mm_sub_ps(x, w);
+		__m128 const y_h = _mm_sub_ps(y, h);
+		__m128 const z_d = _mm_sub_ps(z, d);
+		__m128 const wx = _mm_sub_ps(w, x);
+		__m128 const hy = _mm_sub_ps(h, y);
+		__m128 const dz = _mm_sub_ps(d, z);
+
+		__m128 n = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x, y, z), wx), hy), dz);
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x_w, y, z), x), hy), dz));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x, y_h, z), wx), y), dz));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x_w, y_h, z), x), y), dz));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x, y, z_d), wx), hy), z));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x_w, y, z_d), x), hy), z));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x, y_h, z_d), wx), y), z));
+		n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(SimplexNoise3D4(perm, x_w, y_h, z_d), x), y), z));
+		return _mm_div_ps(n, _mm_mul_ps(_mm_mul_ps(w, h), d));
+	}
+
+	// Returns the number of samples handled, a multiple of 4. The rest is left to the scalar code.
+	uint32_t SimplexFractal2DSIMD(int const * perm, float const * x, float const * y, float w, float h, bool tileable,
+		float* ret, uint32_t num, int octaves, float lacunarity, float gain, bool turbulence) noexcept
+	{
+		__m128 const abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 const lac = _mm_set1_ps(lacunarity);
+
+		uint32_t const simd_num = num & ~3U;
+		for (uint32_t i = 0; i < simd_num; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i);
+			__m128 vy = _mm_loadu_ps(y + i);
+			__m128 vw = _mm_set1_ps(w);
+			__m128 vh = _mm_set1_ps(h);
+			__m128 sum = _mm_setzero_ps();
+			float amp = 1;
+			float amp_sum = 0;
+			for (int o = 0; o < octaves; ++ o)
+			{
+				__m128 n = tileable ? TileableSimplexNoise2D4(perm, vx, vy, vw, vh) : SimplexNoise2D4(perm, vx, vy);
+				if (turbulence)
+				{
+					n = _mm_and_ps(n, abs_mask);
+				}
+				sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amp)));
+				amp_sum += amp;
+				vx = _mm_mul_ps(vx, lac);
+				vy = _mm_mul_ps(vy, lac);
+				vw = _mm_mul_ps(vw, lac);
+				vh = _mm_mul_ps(vh, lac);
+				amp *= gain;
+			}
+			_mm_storeu_ps(ret + i, _mm_div_ps(sum, _mm_set1_ps(amp_sum)));
+		}
+		return simd_num;
+	}
+
+	uint32_t SimplexFractal3DSIMD(int const * perm, float const * x, float const * y, float const * z,
+		float w, float h, float d, bool tileable,
+		float* ret, uint32_t num, int octaves, float lacunarity, float gain, bool turbulence) noexcept
+	{
+		__m128 const abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 const lac = _mm_set1_ps(lacunarity);
+
+		uint32_t const simd_num = num & ~3U;
+		for (uint32_t i = 0; i < simd_num; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i);
+			__m128 vy = _mm_loadu_ps(y + i);
+			__m128 vz = _mm_loadu_ps(z + i);
+			__m128 vw = _mm_set1_ps(w);
+			__m128 vh = _mm_set1_ps(h);
+			__m128 vd = _mm_set1_ps(d);
+			__m128 sum = _mm_setzero_ps();
+			float amp = 1;
+			float amp_sum = 0;
+			for (int o = 0; o < octaves; ++ o)
+			{
+				__m128 n = tileable ? TileableSimplexNoise3D4(perm, vx, vy, vz, vw, vh, vd) : SimplexNoise3D4(perm, vx, vy, vz);
+				if (turbulence)
+				{
+					n = _mm_and_ps(n, abs_mask);
+				}
+				sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amp)));
+				amp_sum += amp;
+				vx = _mm_mul_ps(vx, lac);
+				vy = _mm_mul_ps(vy, lac);
+				vz = _mm_mul_ps(vz, lac);
+				vw = _mm_mul_ps(vw, lac);
+				vh = _mm_mul_ps(vh, lac);
+				vd = _mm_mul_ps(vd, lac);
+				amp *= gain;
+			}
+			_mm_storeu_ps(ret + i, _mm_div_ps(sum, _mm_set1_ps(amp_sum)));
+		}
+		return simd_num;
+	}
+#endif
+}
+
 namespace KlayGE
 {
 	namespace MathLib
@@ -56,6 +381,29 @@ namespace KlayGE
 				float w, float h, int octaves, float lacunarity, float gain) noexcept;
 		template float SimplexNoise<float>::tileable_turbulence(float x, float y, float z,
 				float w, float h, float d, int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::noise(float const * x, float const * y, float* ret, uint32_t num) noexcept;
+		template void SimplexNoise<float>::noise(float const * x, float const * y, float const * z,
+				float* ret, uint32_t num) noexcept;
+		template void SimplexNoise<float>::fBm(float const * x, float const * y, float* ret, uint32_t num,
+				int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::fBm(float const * x, float const * y, float const * z, float* ret, uint32_t num,
+				int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::turbulence(float const * x, float const * y, float* ret, uint32_t num,
+				int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::turbulence(float const * x, float const * y, float const * z, float* ret, uint32_t num,
+				int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::tileable_noise(float const * x, float const * y, float w, float h,
+				float* ret, uint32_t num) noexcept;
+		template void SimplexNoise<float>::tileable_noise(float const * x, float const * y, float const * z,
+				float w, float h, float d, float* ret, uint32_t num) noexcept;
+		template void SimplexNoise<float>::tileable_fBm(float const * x, float const * y, float w, float h,
+				float* ret, uint32_t num, int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::tileable_fBm(float const * x, float const * y, float const * z,
+				float w, float h, float d, float* ret, uint32_t num, int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::tileable_turbulence(float const * x, float const * y, float w, float h,
+				float* ret, uint32_t num, int octaves, float lacunarity, float gain) noexcept;
+		template void SimplexNoise<float>::tileable_turbulence(float const * x, float const * y, float const * z,
+				float w, float h, float d, float* ret, uint32_t num, int octaves, float lacunarity, float gain) noexcept;
 
 
 		template <typename T>
@@ -468,5 +816,133 @@ namespace KlayGE
 			}
 			return sum / amp_sum;
 		}
+
+		template <typename T>
+		void SimplexNoise<T>::noise(T const * x, T const * y, T* ret, uint32_t num) noexcept
+		{
+			uint32_t i = SimplexFractal2DSIMD(p_, x, y, T(0), T(0), false, ret, num, 1, T(2), T(0.5), false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->noise(x[i], y[i]);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::noise(T const * x, T const * y, T const * z, T* ret, uint32_t num) noexcept
+		{
+			uint32_t i = SimplexFractal3DSIMD(p_, x, y, z, T(0), T(0), T(0), false, ret, num, 1, T(2), T(0.5), false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->noise(x[i], y[i], z[i]);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::fBm(T const * x, T const * y, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal2DSIMD(p_, x, y, T(0), T(0), false, ret, num, octaves, lacunarity, gain, false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->fBm(x[i], y[i], octaves, lacunarity, gain);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::fBm(T const * x, T const * y, T const * z, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal3DSIMD(p_, x, y, z, T(0), T(0), T(0), false, ret, num, octaves, lacunarity, gain, false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->fBm(x[i], y[i], z[i], octaves, lacunarity, gain);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::turbulence(T const * x, T const * y, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal2DSIMD(p_, x, y, T(0), T(0), false, ret, num, octaves, lacunarity, gain, true);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->turbulence(x[i], y[i], octaves, lacunarity, gain);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::turbulence(T const * x, T const * y, T const * z, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal3DSIMD(p_, x, y, z, T(0), T(0), T(0), false, ret, num, octaves, lacunarity, gain, true);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->turbulence(x[i], y[i], z[i], octaves, lacunarity, gain);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_noise(T const * x, T const * y, T w, T h, T* ret, uint32_t num) noexcept
+		{
+			uint32_t i = SimplexFractal2DSIMD(p_, x, y, w, h, true, ret, num, 1, T(2), T(0.5), false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->tileable_noise(x[i], y[i], w, h);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_noise(T const * x, T const * y, T const * z, T w, T h, T d, T* ret, uint32_t num) noexcept
+		{
+			uint32_t i = SimplexFractal3DSIMD(p_, x, y, z, w, h, d, true, ret, num, 1, T(2), T(0.5), false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->tileable_noise(x[i], y[i], z[i], w, h, d);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_fBm(T const * x, T const * y, T w, T h, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal2DSIMD(p_, x, y, w, h, true, ret, num, octaves, lacunarity, gain, false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->tileable_fBm(x[i], y[i], w, h, octaves, lacunarity, gain);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_fBm(T const * x, T const * y, T const * z, T w, T h, T d, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal3DSIMD(p_, x, y, z, w, h, d, true, ret, num, octaves, lacunarity, gain, false);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->tileable_fBm(x[i], y[i], z[i], w, h, d, octaves, lacunarity, gain);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_turbulence(T const * x, T const * y, T w, T h, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal2DSIMD(p_, x, y, w, h, true, ret, num, octaves, lacunarity, gain, true);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->tileable_turbulence(x[i], y[i], w, h, octaves, lacunarity, gain);
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_turbulence(T const * x, T const * y, T const * z, T w, T h, T d, T* ret, uint32_t num,
+			int octaves, T lacunarity, T gain) noexcept
+		{
+			uint32_t i = SimplexFractal3DSIMD(p_, x, y, z, w, h, d, true, ret, num, octaves, lacunarity, gain, true);
+			for (; i < num; ++ i)
+			{
+				ret[i] = this->tileable_turbulence(x[i], y[i], z[i], w, h, d, octaves, lacunarity, gain);
+			}
+		}
 	}
 }
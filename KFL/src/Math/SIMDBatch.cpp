@@ -0,0 +1,251 @@
+/**
+ * @file SIMDBatch.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/SIMDBatch.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// The matrix rows broadcast to all lanes
+	template <typename Batch>
+	struct BatchMatrix
+	{
+		Batch m[4][4];
+
+		explicit BatchMatrix(float4x4 const & mat)
+		{
+			for (int r = 0; r < 4; ++ r)
+			{
+				for (int c = 0; c < 4; ++ c)
+				{
+					m[r][c] = Batch::Set(mat(r, c));
+				}
+			}
+		}
+	};
+
+	template <typename Batch>
+	size_t TransformCoordVector3Batch(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+	{
+		BatchMatrix<Batch> const bm(mat);
+		Batch const zero = Batch::Set(0);
+		Batch const one = Batch::Set(1);
+		Batch const epsilon = Batch::Set(std::numeric_limits<float>::epsilon());
+
+		size_t i = 0;
+		for (; i + Batch::width <= num; i += Batch::width)
+		{
+			Batch const x = Batch::Load(&in[i].x(), 3);
+			Batch const y = Batch::Load(&in[i].y(), 3);
+			Batch const z = Batch::Load(&in[i].z(), 3);
+
+			// Same operation order as MathLib::transform_coord, so the results match bit by bit
+			Batch const tw = x * bm.m[0][3] + y * bm.m[1][3] + z * bm.m[2][3] + bm.m[3][3];
+			Batch const inv_w = SIMDMathLib::SelectLess(epsilon, SIMDMathLib::Abs(tw), one / tw, zero);
+			((x * bm.m[0][0] + y * bm.m[1][0] + z * bm.m[2][0] + bm.m[3][0]) * inv_w).Store(&out[i].x(), 3);
+			((x * bm.m[0][1] + y * bm.m[1][1] + z * bm.m[2][1] + bm.m[3][1]) * inv_w).Store(&out[i].y(), 3);
+			((x * bm.m[0][2] + y * bm.m[1][2] + z * bm.m[2][2] + bm.m[3][2]) * inv_w).Store(&out[i].z(), 3);
+		}
+		return i;
+	}
+
+	template <typename Batch>
+	size_t TransformNormalVector3Batch(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+	{
+		BatchMatrix<Batch> const bm(mat);
+		Batch const zero = Batch::Set(0);
+
+		size_t i = 0;
+		for (; i + Batch::width <= num; i += Batch::width)
+		{
+			Batch const x = Batch::Load(&in[i].x(), 3);
+			Batch const y = Batch::Load(&in[i].y(), 3);
+			Batch const z = Batch::Load(&in[i].z(), 3);
+
+			// MathLib::transform_normal goes through the 4D transform with w = 0
+			(x * bm.m[0][0] + y * bm.m[1][0] + z * bm.m[2][0] + zero * bm.m[3][0]).Store(&out[i].x(), 3);
+			(x * bm.m[0][1] + y * bm.m[1][1] + z * bm.m[2][1] + zero * bm.m[3][1]).Store(&out[i].y(), 3);
+			(x * bm.m[0][2] + y * bm.m[1][2] + z * bm.m[2][2] + zero * bm.m[3][2]).Store(&out[i].z(), 3);
+		}
+		return i;
+	}
+}
+
+namespace KlayGE
+{
+	SIMDFrustum::SIMDFrustum()
+	{
+	}
+
+	SIMDFrustum::SIMDFrustum(Frustum const & frustum)
+	{
+		this->Planes(frustum);
+	}
+
+	void SIMDFrustum::Planes(Frustum const & frustum)
+	{
+		// Unused lanes get (0, 0, 0, 1), which never rejects
+		for (int i = 0; i < PLANE_LANES; ++ i)
+		{
+			Plane const plane = (i < 6) ? frustum.FrustumPlane(i) : Plane(0, 0, 0, 1);
+			for (int j = 0; j < 4; ++ j)
+			{
+				planes_[j][i] = plane[j];
+			}
+		}
+	}
+
+	// Same tests as MathLib::intersect_aabb_frustum, one plane per lane
+	BoundOverlap SIMDFrustum::Intersect(AABBox const & aabb) const
+	{
+		SIMDBatchFNative const zero = SIMDBatchFNative::Set(0);
+		SIMDBatchFNative const min_x = SIMDBatchFNative::Set(aabb.Min().x());
+		SIMDBatchFNative const min_y = SIMDBatchFNative::Set(aabb.Min().y());
+		SIMDBatchFNative const min_z = SIMDBatchFNative::Set(aabb.Min().z());
+		SIMDBatchFNative const max_x = SIMDBatchFNative::Set(aabb.Max().x());
+		SIMDBatchFNative const max_y = SIMDBatchFNative::Set(aabb.Max().y());
+		SIMDBatchFNative const max_z = SIMDBatchFNative::Set(aabb.Max().z());
+
+		uint32_t intersect = 0;
+		for (int i = 0; i < PLANE_LANES; i += SIMDBatchFNative::width)
+		{
+			SIMDBatchFNative const a = SIMDBatchFNative::Load(&planes_[0][i]);
+			SIMDBatchFNative const b = SIMDBatchFNative::Load(&planes_[1][i]);
+			SIMDBatchFNative const c = SIMDBatchFNative::Load(&planes_[2][i]);
+			SIMDBatchFNative const d = SIMDBatchFNative::Load(&planes_[3][i]);
+
+			// v0 is the corner farthest along the plane normal, v1 is diagonally opposed to v0
+			SIMDBatchFNative const v0_x = SIMDMathLib::SelectLess(a, zero, min_x, max_x);
+			SIMDBatchFNative const v0_y = SIMDMathLib::SelectLess(b, zero, min_y, max_y);
+			SIMDBatchFNative const v0_z = SIMDMathLib::SelectLess(c, zero, min_z, max_z);
+			if (SIMDMathLib::LessMask(a * v0_x + b * v0_y + c * v0_z + d, zero))
+			{
+				return BO_No;
+			}
+
+			SIMDBatchFNative const v1_x = SIMDMathLib::SelectLess(a, zero, max_x, min_x);
+			SIMDBatchFNative const v1_y = SIMDMathLib::SelectLess(b, zero, max_y, min_y);
+			SIMDBatchFNative const v1_z = SIMDMathLib::SelectLess(c, zero, max_z, min_z);
+			intersect |= SIMDMathLib::LessMask(a * v1_x + b * v1_y + c * v1_z + d, zero);
+		}
+
+		return intersect ? BO_Partial : BO_Yes;
+	}
+
+	namespace SIMDMathLib
+	{
+		void TransformCoordVector3(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+		{
+			for (size_t i = TransformCoordVector3Batch<SIMDBatchFNative>(out, in, num, mat); i < num; ++ i)
+			{
+				out[i] = MathLib::transform_coord(in[i], mat);
+			}
+		}
+
+		void TransformNormalVector3(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+		{
+			for (size_t i = TransformNormalVector3Batch<SIMDBatchFNative>(out, in, num, mat); i < num; ++ i)
+			{
+				out[i] = MathLib::transform_normal(in[i], mat);
+			}
+		}
+
+		void TransformAABBs(AABBox* out, ArrayRef<AABBox> aabbs, ArrayRef<float4x4> mats)
+		{
+			BOOST_ASSERT((mats.size() == aabbs.size()) || (mats.size() == 1));
+
+			SIMDVectorF4 const half = SetVector(0.5f);
+			if (aabbs.empty())
+			{
+				return;
+			}
+			BOOST_ASSERT(&aabbs[0].Max()[0] == &aabbs[0].Min()[0] + 3);
+
+			size_t const mat_step = (mats.size() == 1) ? 0 : 1;
+			for (size_t i = 0; i < aabbs.size(); ++ i)
+			{
+				SIMDMatrixF4 const mat = LoadMatrix(mats[i * mat_step]);
+
+#if defined(SIMD_MATH_SSE)
+				// min and max are 6 contiguous floats, 2 overlapping loads and stores cover them
+				float const * src = &aabbs[i].Min()[0];
+				SIMDVectorF4 min_pt;
+				min_pt.Vec() = _mm_loadu_ps(src);
+				SIMDVectorF4 max_pt;
+				max_pt.Vec() = _mm_loadu_ps(src + 2);
+				max_pt.Vec() = _mm_shuffle_ps(max_pt.Vec(), max_pt.Vec(), _MM_SHUFFLE(0, 3, 2, 1));
+#else
+				SIMDVectorF4 const min_pt = LoadVector3(aabbs[i].Min());
+				SIMDVectorF4 const max_pt = LoadVector3(aabbs[i].Max());
+#endif
+				SIMDVectorF4 center, half_size;
+				TransformAABB(center, half_size, (min_pt + max_pt) * half, (max_pt - min_pt) * half, mat);
+
+#if defined(SIMD_MATH_SSE)
+				float* dst = &out[i].Min()[0];
+				__m128 const new_min = (center - half_size).Vec();
+				__m128 const new_max = (center + half_size).Vec();
+				__m128 const min_z_max_x = _mm_shuffle_ps(new_max, new_min, _MM_SHUFFLE(2, 2, 0, 0));
+				_mm_storeu_ps(dst, new_min);
+				_mm_storeu_ps(dst + 2, _mm_shuffle_ps(min_z_max_x, new_max, _MM_SHUFFLE(2, 1, 0, 2)));
+#else
+				StoreVector3(out[i].Min(), center - half_size);
+				StoreVector3(out[i].Max(), center + half_size);
+#endif
+			}
+		}
+
+		void TransformAABBs(float3* out_centers, float3* out_half_sizes,
+			ArrayRef<float3> centers, ArrayRef<float3> half_sizes, ArrayRef<float4x4> mats)
+		{
+			BOOST_ASSERT(centers.size() == half_sizes.size());
+			BOOST_ASSERT((mats.size() == centers.size()) || (mats.size() == 1));
+
+			if (centers.empty())
+			{
+				return;
+			}
+
+			size_t const mat_step = (mats.size() == 1) ? 0 : 1;
+			for (size_t i = 0; i < centers.size(); ++ i)
+			{
+				SIMDMatrixF4 const mat = LoadMatrix(mats[i * mat_step]);
+
+				SIMDVectorF4 center, half_size;
+				TransformAABB(center, half_size, LoadVector3(centers[i]), LoadVector3(half_sizes[i]), mat);
+
+				StoreVector3(out_centers[i], center);
+				StoreVector3(out_half_sizes[i], half_size);
+			}
+		}
+	}
+}
@@ -33,32 +33,6 @@
 
 namespace KlayGE
 {
-	SIMDMatrixF4::SIMDMatrixF4()
-	{
-	}
-	
-	SIMDMatrixF4::SIMDMatrixF4(float const * rhs)
-	{
-		m_[0] = SIMDMathLib::LoadVector4(rhs + 0);
-		m_[1] = SIMDMathLib::LoadVector4(rhs + 4);
-		m_[2] = SIMDMathLib::LoadVector4(rhs + 8);
-		m_[3] = SIMDMathLib::LoadVector4(rhs + 12);
-	}
-
-	SIMDMatrixF4::SIMDMatrixF4(SIMDMatrixF4 const & rhs)
-		: m_(rhs.m_)
-	{
-	}
-
-	SIMDMatrixF4::SIMDMatrixF4(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2,
-		SIMDVectorF4 const & v3, SIMDVectorF4 const & v4)
-	{
-		m_[0] = v1;
-		m_[1] = v2;
-		m_[2] = v3;
-		m_[3] = v4;
-	}
-
 	SIMDMatrixF4::SIMDMatrixF4(float f11, float f12, float f13, float f14,
 		float f21, float f22, float f23, float f24,
 		float f31, float f32, float f33, float f34,
@@ -90,16 +64,6 @@ namespace KlayGE
 		return out;
 	}
 
-	void SIMDMatrixF4::Row(size_t index, SIMDVectorF4 const & rhs)
-	{
-		m_[index] = rhs;
-	}
-
-	SIMDVectorF4 const & SIMDMatrixF4::Row(size_t index) const
-	{
-		return m_[index];
-	}
-
 	void SIMDMatrixF4::Col(size_t index, SIMDVectorF4 const & rhs)
 	{
 		m_[0] = SIMDMathLib::SetByIndex(m_[0], SIMDMathLib::GetByIndex(rhs, index), index);
@@ -126,50 +90,6 @@ namespace KlayGE
 		return SIMDMathLib::GetByIndex(this->Row(row), col);
 	}
 
-	SIMDMatrixF4& SIMDMatrixF4::operator+=(SIMDMatrixF4 const & rhs)
-	{
-		*this = SIMDMathLib::Add(*this, rhs);
-		return *this;
-	}
-
-	SIMDMatrixF4& SIMDMatrixF4::operator-=(SIMDMatrixF4 const & rhs)
-	{
-		*this = SIMDMathLib::Substract(*this, rhs);
-		return *this;
-	}
-
-	SIMDMatrixF4& SIMDMatrixF4::operator*=(SIMDMatrixF4 const & rhs)
-	{
-		*this = SIMDMathLib::Multiply(*this, rhs);
-		return *this;
-	}
-
-	SIMDMatrixF4& SIMDMatrixF4::operator*=(float rhs)
-	{
-		*this = SIMDMathLib::Multiply(*this, rhs);
-		return *this;
-	}
-
-	SIMDMatrixF4& SIMDMatrixF4::operator/=(float rhs)
-	{
-		*this = SIMDMathLib::Multiply(*this, 1.0f / rhs);
-		return *this;
-	}
-
-	SIMDMatrixF4& SIMDMatrixF4::operator=(SIMDMatrixF4 const & rhs)
-	{
-		if (this != &rhs)
-		{
-			m_ = rhs.m_;
-		}
-		return *this;
-	}
-
-	SIMDMatrixF4 const SIMDMatrixF4::operator+() const
-	{
-		return *this;
-	}
-
 	SIMDMatrixF4 const SIMDMatrixF4::operator-() const
 	{
 		return SIMDMathLib::Negative(*this);
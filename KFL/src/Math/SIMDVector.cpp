@@ -33,84 +33,9 @@
 
 namespace KlayGE
 {
-	SIMDVectorF4::SIMDVectorF4(SIMDVectorF4 const & rhs)
-		: vec_(rhs.vec_)
-	{
-	}
-
 	SIMDVectorF4 const & SIMDVectorF4::Zero()
 	{
 		static SIMDVectorF4 const zero = SIMDMathLib::SetVector(0.0f);
 		return zero;
 	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator+=(SIMDVectorF4 const & rhs)
-	{
-		*this = SIMDMathLib::Add(*this, rhs);
-		return *this;
-	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator+=(float rhs)
-	{
-		*this += SIMDMathLib::SetVector(rhs);
-		return *this;
-	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator-=(SIMDVectorF4 const & rhs)
-	{
-		*this = SIMDMathLib::Substract(*this, rhs);
-		return *this;
-	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator-=(float rhs)
-	{
-		*this -= SIMDMathLib::SetVector(rhs);
-		return *this;
-	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator*=(SIMDVectorF4 const & rhs)
-	{
-		*this = SIMDMathLib::Multiply(*this, rhs);
-		return *this;
-	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator*=(float rhs)
-	{
-		*this = SIMDMathLib::Multiply(*this, SIMDMathLib::SetVector(rhs));
-		return *this;
-	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator/=(SIMDVectorF4 const & rhs)
-	{
-		*this = SIMDMathLib::Divide(*this, rhs);
-		return *this;
-	}
-
-	SIMDVectorF4 const & SIMDVectorF4::operator/=(float rhs)
-	{
-		return this->operator*=(1.0f / rhs);
-	}
-
-	SIMDVectorF4& SIMDVectorF4::operator=(SIMDVectorF4 const & rhs)
-	{
-		if (this != &rhs)
-		{
-			vec_ = rhs.vec_;
-		}
-		return *this;
-	}
-
-	SIMDVectorF4 const SIMDVectorF4::operator+() const
-	{
-		return *this;
-	}
-	SIMDVectorF4 const SIMDVectorF4::operator-() const
-	{
-		return SIMDMathLib::Negative(*this);
-	}
-
-	void SIMDVectorF4::swap(SIMDVectorF4& rhs)
-	{
-		std::swap(vec_, rhs.vec_);
-	}
 }
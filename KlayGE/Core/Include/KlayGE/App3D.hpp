@@ -38,6 +38,8 @@
 
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Timer.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/FrameScheduler.hpp>
 
 namespace KlayGE
 {
@@ -104,6 +106,20 @@ namespace KlayGE
 		float AppTime() const;
 		float FrameTime() const;
 
+		FrameScheduler& Scheduler()
+		{
+			return frame_scheduler_;
+		}
+		FrameScheduler const & Scheduler() const
+		{
+			return frame_scheduler_;
+		}
+		// Where the rendered time is between the 2 published simulation states
+		float SimAlpha() const
+		{
+			return sim_alpha_;
+		}
+
 		void Run();
 		void Quit();
 
@@ -118,6 +134,12 @@ namespace KlayGE
 		uint32_t Update(uint32_t pass);
 		void UpdateStats();
 
+	private:
+		void Simulate();
+		void SimulateSteps(uint32_t num_steps, float step_time);
+		void WaitForSimulation();
+		void ReportFrameTimes() const;
+
 	private:
 		virtual void OnCreate()
 		{
@@ -132,6 +154,18 @@ namespace KlayGE
 		{
 		}
 
+		// Fixed step simulation, set up by frame_pacing in KlayGE.cfg. Called 0 or more times a frame. In pipelined
+		// mode it runs on a worker thread, together with the rendering of the last frame, so it must only touch
+		// the simulation state.
+		virtual void DoSimulate(float /*sim_time*/, float /*step_time*/)
+		{
+		}
+		// Called on the main thread when neither the simulation nor the rendering is running. Hand the
+		// simulation state to rendering here.
+		virtual void DoPublishSimulation()
+		{
+		}
+
 		virtual void DoUpdateOverlay() = 0;
 		virtual uint32_t DoUpdate(uint32_t pass) = 0;
 
@@ -150,6 +184,14 @@ namespace KlayGE
 
 		WindowPtr main_wnd_;
 
+		FrameScheduler frame_scheduler_;
+		bool pipelined_sim_;
+		std::unique_ptr<joiner<void>> sim_job_;
+		float sim_time_;
+		float sim_job_time_;
+		float sim_alpha_;
+		float pending_sim_alpha_;
+
 #if defined KLAYGE_PLATFORM_WINDOWS_STORE
 	public:
 		void MetroCreate();
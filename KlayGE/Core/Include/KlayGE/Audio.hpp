@@ -35,8 +35,14 @@
 
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Vector.hpp>
+#include <KFL/Thread.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <vector>
 
 #include <KlayGE/AudioDataSource.hpp>
 
@@ -92,6 +98,8 @@ namespace KlayGE
 
 	class KLAYGE_CORE_API MusicBuffer : public AudioBuffer
 	{
+		friend class AudioEngine;
+
 	public:
 		explicit MusicBuffer(AudioDataSourcePtr const & data_source);
 		~MusicBuffer() override;
@@ -107,7 +115,36 @@ namespace KlayGE
 		virtual void DoPlay(bool loop) = 0;
 		virtual void DoStop() = 0;
 
+		// Called on the streaming thread of the audio engine to move decoded data into the free parts of the
+		//   backend's buffers. Returns false when the data has run out and nothing is left to refill.
+		virtual bool RefillBuffers() = 0;
+
+		// Registers the buffer to the streaming thread. It's refilled right away, then every time it's notified or polled.
+		void StartStreaming();
+		void StopStreaming();
+		// For backends that know when a buffer is consumed. Can be called from any thread.
+		void NotifyStreaming();
+
+		// The next block of 1 / BUFFERS_PER_SECOND second of PCM. It's empty at the end of the data.
+		//   Valid until the next call. Blocks are decoded ahead on the streaming thread, and reused.
+		std::vector<uint8_t> const & ReadBlock();
+		// Resets the data source, and drops the blocks decoded ahead.
+		void RewindData();
+
 		static uint32_t constexpr BUFFERS_PER_SECOND = 2;
+
+	private:
+		void DecodeAhead();
+		void DecodeBlock(std::vector<uint8_t>& block);
+
+	private:
+		std::atomic<AudioEngine*> streaming_engine_;
+
+		size_t block_size_;
+		bool data_end_;
+		std::vector<uint8_t> curr_block_;
+		std::deque<std::vector<uint8_t>> decoded_blocks_;
+		std::vector<std::vector<uint8_t>> free_blocks_;
 	};
 
 	class KLAYGE_CORE_API AudioEngine : boost::noncopyable
@@ -143,15 +180,39 @@ namespace KlayGE
 		virtual void GetListenerOri(float3& face, float3& up) const = 0;
 		virtual void SetListenerOri(float3 const & face, float3 const & up) = 0;
 
+		// All the music buffers are refilled on one streaming thread, instead of one thread each
+		void StartStreaming(MusicBuffer& buffer);
+		void StopStreaming(MusicBuffer& buffer);
+		void NotifyStreaming(MusicBuffer& buffer);
+
+	protected:
+		// Backends call it before destroying their device, so no buffer is refilled after that
+		void ShutdownStreaming();
+
 	private:
 		virtual void DoSuspend() = 0;
 		virtual void DoResume() = 0;
 
+		void StreamingThreadFunc();
+
 	protected:
 		std::map<size_t, AudioBufferPtr> audio_buffs_;
 
 		float sound_vol_;
 		float music_vol_;
+
+	private:
+		// Guards the list only. Refills run unlocked, and a buffer stops streaming only after its refill is done.
+		std::mutex streaming_mutex_;
+		std::vector<MusicBuffer*> streaming_buffers_;
+		MusicBuffer* refilling_buffer_;
+		std::condition_variable refill_cond_;
+
+		std::mutex ready_mutex_;
+		std::condition_variable ready_cond_;
+		std::vector<MusicBuffer*> ready_buffers_;
+		bool quit_streaming_;
+		std::unique_ptr<joiner<void>> streaming_thread_;
 	};
 }
 
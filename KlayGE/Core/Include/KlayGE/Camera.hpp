@@ -22,6 +22,7 @@
 #include <boost/circular_buffer.hpp>
 
 #include <KFL/Frustum.hpp>
+#include <KFL/SIMDBatch.hpp>
 #include <KFL/Vector.hpp>
 #include <KFL/Matrix.hpp>
 
@@ -85,6 +86,7 @@ namespace KlayGE
 		float4x4 const & PrevProjMatrix() const;
 
 		Frustum const & ViewFrustum() const;
+		SIMDFrustum const & ViewFrustumSIMD() const;
 
 		bool OmniDirectionalMode() const;
 		void OmniDirectionalMode(bool omni);
@@ -116,6 +118,7 @@ namespace KlayGE
 		mutable bool		view_proj_mat_wo_adjust_dirty_;
 
 		mutable Frustum	frustum_;
+		mutable SIMDFrustum simd_frustum_;
 		mutable bool	frustum_dirty_;
 
 		uint32_t	mode_;
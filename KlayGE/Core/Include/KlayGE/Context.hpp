@@ -57,6 +57,12 @@ namespace KlayGE
 
 		bool perf_profiler;
 		bool location_sensor;
+
+		// Frame pacing, see FrameScheduler. A max_fps of 0 is uncapped, a sim_step of 0 is a variable step.
+		float max_fps;
+		float sim_step;
+		uint32_t max_sim_steps;
+		bool pipelined_sim;
 	};
 
 	class KLAYGE_CORE_API Context : boost::noncopyable
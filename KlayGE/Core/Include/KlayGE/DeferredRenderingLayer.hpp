@@ -214,6 +214,10 @@ namespace KlayGE
 		{
 			return g_buffer_skinning_effect_;
 		}
+		RenderEffectPtr const & GBufferInstancingEffect() const
+		{
+			return g_buffer_instancing_effect_;
+		}
 
 #if DEFAULT_DEFERRED == TRIDITIONAL_DEFERRED
 		TexturePtr const & LightingTex(uint32_t vp) const
@@ -422,6 +426,7 @@ namespace KlayGE
 
 		RenderEffectPtr g_buffer_effect_;
 		RenderEffectPtr g_buffer_skinning_effect_;
+		RenderEffectPtr g_buffer_instancing_effect_;
 		RenderEffectPtr dr_effect_;
 #if DEFAULT_DEFERRED == LIGHT_INDEXED_DEFERRED
 		uint32_t light_batch_;
@@ -685,7 +685,9 @@ namespace KlayGE
 		EAH_Raw = 1UL << 8,
 		EAH_Append = 1UL << 9,
 		EAH_Counter = 1UL << 10,
-		EAH_DrawIndirectArgs = 1UL << 11
+		EAH_DrawIndirectArgs = 1UL << 11,
+		// Models only, not passed to the buffers. Keeps the triangles on CPU for SceneManager::RayCast.
+		EAH_CPU_RayCast = 1UL << 12
 	};
 
 	struct ElementInitData
@@ -0,0 +1,243 @@
+/**
+* @file FrameScheduler.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_FRAMESCHEDULER_HPP
+#define _KLAYGE_FRAMESCHEDULER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Timer.hpp>
+
+#include <array>
+#include <vector>
+
+namespace KlayGE
+{
+	// Counts of durations in 0.1 ms bins up to 100 ms. The longer ones share the last bin.
+	class KLAYGE_CORE_API FrameTimeHistogram
+	{
+	public:
+		static uint32_t const NUM_BINS = 1001;
+		static float const BIN_WIDTH;
+
+	public:
+		FrameTimeHistogram();
+
+		void Add(float seconds);
+		void Reset();
+
+		uint32_t NumSamples() const
+		{
+			return num_samples_;
+		}
+		float Mean() const;
+		float Max() const
+		{
+			return max_;
+		}
+		// The duration p of the samples are under, p in [0, 1]. It's the upper edge of a bin, except for the
+		//   last bin, which reports Max().
+		float Percentile(float p) const;
+
+		uint32_t BinCount(uint32_t bin) const
+		{
+			return bins_[bin];
+		}
+
+	private:
+		std::vector<uint32_t> bins_;
+		uint32_t num_samples_;
+		double sum_;
+		float max_;
+	};
+
+	// Paces the main loop, and splits the time into simulation steps.
+	//
+	// With a sim step, the simulation runs in fixed steps. The real time accumulates, each frame takes as many
+	//   steps as fit in it, and the rest carries to the next frame. SimAlpha is where the current time is between
+	//   the last two simulated states, so rendering can interpolate them. When a frame takes too long, the time
+	//   beyond max_sim_steps is dropped instead of piling up on the next frames.
+	// Without a sim step, every frame is 1 step of the frame time.
+	//
+	// With a frame cap, BeginFrame waits until 1 / max_fps has passed since the last frame started. It sleeps most
+	//   of the wait and spins the last millisecond, since a sleep can overshoot by a whole scheduler tick.
+	class KLAYGE_CORE_API FrameScheduler : boost::noncopyable
+	{
+	public:
+		FrameScheduler();
+
+		// 0 is uncapped
+		void MaxFPS(float fps);
+		float MaxFPS() const
+		{
+			return max_fps_;
+		}
+		// 0 is a variable step
+		void SimStep(float step);
+		float SimStep() const
+		{
+			return sim_step_;
+		}
+		void MaxSimSteps(uint32_t steps);
+		uint32_t MaxSimSteps() const
+		{
+			return max_sim_steps_;
+		}
+
+		// Waits for the frame cap, starts a frame and returns the time since the last one
+		float BeginFrame();
+		// Starts a frame of the given length, without waiting. BeginFrame measures the time and calls it.
+		void Advance(float frame_time);
+
+		float FrameTime() const
+		{
+			return frame_time_;
+		}
+		// Steps due in this frame, and the length of each
+		uint32_t NumSimSteps() const
+		{
+			return num_sim_steps_;
+		}
+		float StepTime() const
+		{
+			return step_time_;
+		}
+		float SimAlpha() const
+		{
+			return sim_alpha_;
+		}
+		// The time dropped by the max_sim_steps clamp so far
+		float DroppedTime() const
+		{
+			return static_cast<float>(dropped_time_);
+		}
+
+		void RecordSimTime(float seconds);
+		void RecordRenderTime(float seconds);
+		// Times between the starts of frames, including the waits for the cap
+		FrameTimeHistogram const & FrameTimes() const
+		{
+			return frame_times_;
+		}
+		FrameTimeHistogram const & SimTimes() const
+		{
+			return sim_times_;
+		}
+		FrameTimeHistogram const & RenderTimes() const
+		{
+			return render_times_;
+		}
+		void ResetStats();
+
+	private:
+		float max_fps_;
+		float sim_step_;
+		uint32_t max_sim_steps_;
+
+		Timer timer_;
+		bool first_frame_;
+		float frame_time_;
+		double accumulator_;
+		double dropped_time_;
+		uint32_t num_sim_steps_;
+		float step_time_;
+		float sim_alpha_;
+
+		FrameTimeHistogram frame_times_;
+		FrameTimeHistogram sim_times_;
+		FrameTimeHistogram render_times_;
+	};
+
+	// The simulation state of an app, double buffered between the simulation and rendering. The simulation steps
+	//   SimState(), and rendering reads the last published pair of states, so the two can run at the same time.
+	//
+	//   DoSimulate:				state.BeginStep(); Step(state.SimState(), step);
+	//   DoPublishSimulation:	state.Publish();
+	//   Rendering:				lerp(state.RenderPrevious(), state.RenderCurrent(), app.SimAlpha())
+	template <typename T>
+	class SimStateBuffer
+	{
+	public:
+		explicit SimStateBuffer(T const & init = T())
+			: sim_prev_(0), sim_cur_(1), render_prev_(2), render_cur_(3), stepped_(false)
+		{
+			states_.fill(init);
+		}
+
+		T& SimState()
+		{
+			return states_[sim_cur_];
+		}
+		T const & SimState() const
+		{
+			return states_[sim_cur_];
+		}
+
+		// Keeps the state before a step, to interpolate from
+		void BeginStep()
+		{
+			states_[sim_prev_] = states_[sim_cur_];
+			stepped_ = true;
+		}
+
+		// Hands the last 2 simulated states to rendering. Only call it when neither side is running. Without any
+		//   step since the last Publish, the rendering keeps its states.
+		void Publish()
+		{
+			if (stepped_)
+			{
+				std::swap(sim_prev_, render_prev_);
+				std::swap(sim_cur_, render_cur_);
+				states_[sim_cur_] = states_[render_cur_];
+				stepped_ = false;
+			}
+		}
+
+		T const & RenderPrevious() const
+		{
+			return states_[render_prev_];
+		}
+		T const & RenderCurrent() const
+		{
+			return states_[render_cur_];
+		}
+
+	private:
+		std::array<T, 4> states_;
+		uint32_t sim_prev_;
+		uint32_t sim_cur_;
+		uint32_t render_prev_;
+		uint32_t render_cur_;
+		bool stepped_;
+	};
+}
+
+#endif		// _KLAYGE_FRAMESCHEDULER_HPP
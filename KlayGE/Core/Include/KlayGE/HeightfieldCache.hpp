@@ -0,0 +1,168 @@
+/**
+* @file HeightfieldCache.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_HEIGHTFIELDCACHE_HPP
+#define _KLAYGE_HEIGHTFIELDCACHE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Thread.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <KlayGE/SceneQuery.hpp>
+
+namespace KlayGE
+{
+	// A CPU copy of a procedural terrain, for height, normal and ray queries of the gameplay code. The world is
+	//   cut into square tiles of samples of the height function, the same HeightFunc(x, z) as HeightMap. Tiles
+	//   are generated on first use, or ahead of time on the thread pool with Prefetch, and the least recently
+	//   used ones are dropped when there are more than max_tiles.
+	//
+	// Cells are split into 2 triangles along the diagonal from (x, z) to (x + 1, z + 1), as HeightMap does, and
+	//   all queries are on that surface. Each tile has a min-max quadtree of its heights, so a ray skips the
+	//   empty parts of a tile in O(log n) instead of visiting every cell.
+	//
+	// All methods are thread safe.
+	class KLAYGE_CORE_API HeightfieldCache : boost::noncopyable
+	{
+	public:
+		typedef std::function<float(float, float)> HeightFuncType;
+
+	public:
+		// spacing is the distance between samples in world space. tile_size is the number of cells on a tile
+		//   edge, must be a power of 2.
+		HeightfieldCache(HeightFuncType const & height_func, float spacing, uint32_t tile_size = 64,
+			uint32_t max_tiles = 1024);
+		~HeightfieldCache();
+
+		float Spacing() const
+		{
+			return spacing_;
+		}
+		uint32_t TileSize() const
+		{
+			return tile_size_;
+		}
+
+		// Queues the tiles covering the area to the thread pool. Queries on them wait for the workers instead
+		//   of generating the tiles again.
+		void Prefetch(float min_x, float min_z, float max_x, float max_z);
+		// Blocks until all queued tiles are generated
+		void WaitForPrefetch();
+		// Drops all generated and queued tiles
+		void Clear();
+
+		float Height(float x, float z);
+		float3 Normal(float x, float z);
+		// Hits in [0, max_dist), in units of the length of dir, like SceneRay. Every tile the ray passes is
+		//   generated, so keep max_dist finite.
+		bool RayCast(float3 const & orig, float3 const & dir, float max_dist, float& dist);
+
+		// Batch versions. The tile lookup is shared between neighboring queries, so it's faster than one by
+		//   one when the queries are sorted by area.
+		void Height(ArrayRef<float2> xz, float* heights);
+		void Normal(ArrayRef<float2> xz, float3* normals);
+		// Missed rays get a negative dist. Returns the number of hits.
+		uint32_t RayCast(ArrayRef<SceneRay> rays, float* dists);
+
+		uint32_t NumTiles() const;
+		uint32_t NumGeneratedTiles() const
+		{
+			return num_generated_;
+		}
+
+	private:
+		enum TileState
+		{
+			TS_Queued,
+			TS_Generating,
+			TS_Ready
+		};
+
+		struct Tile
+		{
+			int32_t tx;
+			int32_t tz;
+			TileState state;
+			uint64_t last_used;
+
+			// (tile_size + 1)^2 samples. The last row and column are the first ones of the next tiles.
+			std::vector<float> heights;
+			// Min and max of the cells, then of each 2x2 block of the level below, up to the whole tile
+			std::vector<float2> min_max;
+		};
+		typedef std::shared_ptr<Tile> TilePtr;
+
+		// cursor keeps the last tile of a batch, so the cache is locked only when a query moves to another tile.
+		Tile const & AcquireTile(TilePtr& cursor, int32_t tx, int32_t tz);
+		void GenerateTile(Tile& tile);
+		void EvictLocked();
+		void WorkerFunc();
+
+		Tile const & LocateCell(TilePtr& cursor, float x, float z, uint32_t& cx, uint32_t& cz, float& fx, float& fz);
+		float SampleHeight(TilePtr& cursor, float x, float z);
+		float3 SampleNormal(TilePtr& cursor, float x, float z);
+		bool TraceRay(TilePtr& cursor, float3 const & orig, float3 const & dir, float max_dist, float& dist);
+		bool TraceTile(Tile const & tile, float3 const & orig, float3 const & dir, float3 const & inv_dir,
+			float t_max, float& dist) const;
+
+	private:
+		HeightFuncType height_func_;
+		float spacing_;
+		uint32_t tile_size_;
+		uint32_t tile_levels_;
+		uint32_t max_tiles_;
+		std::vector<uint32_t> level_offsets_;
+
+		mutable std::mutex mutex_;
+		std::condition_variable ready_cond_;
+		std::unordered_map<uint64_t, TilePtr> tiles_;
+		uint64_t tick_;
+
+		std::deque<TilePtr> queue_;
+		std::vector<joiner<void>> workers_;
+		uint32_t num_workers_;
+		uint32_t max_workers_;
+
+		std::atomic<uint32_t> num_generated_;
+	};
+}
+
+#endif		// _KLAYGE_HEIGHTFIELDCACHE_HPP
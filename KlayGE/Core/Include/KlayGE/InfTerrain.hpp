@@ -182,6 +182,16 @@ namespace KlayGE
 		void TextureLayer(uint32_t layer, TexturePtr const & tex);
 		void TextureScale(uint32_t layer, float2 const & scale);
 
+		// With a CPU copy of the terrain, GetHeight reads it instead of mapping the height map
+		void HeightCache(HeightfieldCachePtr const & cache)
+		{
+			height_cache_ = cache;
+		}
+		HeightfieldCachePtr const & HeightCache() const
+		{
+			return height_cache_;
+		}
+
 		float GetHeight(float x, float z);
 
 	protected:
@@ -245,6 +255,8 @@ namespace KlayGE
 		TexturePtr height_map_cpu_tex_;
 		TexturePtr gradient_map_cpu_tex_;
 		TexturePtr mask_map_cpu_tex_;
+
+		HeightfieldCachePtr height_cache_;
 	};
 
 	class KLAYGE_CORE_API HQTerrainSceneObject : public SceneObjectHelper
@@ -265,6 +277,9 @@ namespace KlayGE
 		void TextureLayer(uint32_t layer, TexturePtr const & tex);
 		void TextureScale(uint32_t layer, float2 const & scale);
 
+		void HeightCache(HeightfieldCachePtr const & cache);
+		HeightfieldCachePtr const & HeightCache() const;
+
 		float GetHeight(float x, float z);
 
 	private:
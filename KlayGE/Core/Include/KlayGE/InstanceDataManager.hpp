@@ -0,0 +1,100 @@
+/**
+ * @file InstanceDataManager.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _INSTANCEDATAMANAGER_HPP
+#define _INSTANCEDATAMANAGER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
+#include <KlayGE/RenderLayout.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace KlayGE
+{
+	// Packs the instance data of all rendered instances into one vertex buffer per frame.
+	// An instance list is packed only once a frame, other passes rendering the same list get the same range back.
+	// Data is appended and never overwritten inside a frame, so the GPU can keep reading ranges of earlier passes.
+	class KLAYGE_CORE_API InstanceDataManager : boost::noncopyable
+	{
+		struct InstanceRange
+		{
+			uint32_t first_obj;
+			uint32_t num_objs;
+			uint32_t instance_size;
+			uint32_t start_location;
+			bool world;
+		};
+
+	public:
+		InstanceDataManager();
+
+		void BeginFrame();
+
+		// Returns the location of the first instance, in the unit of instance_size.
+		uint32_t Allocate(ArrayRef<SceneObject const *> instances, uint32_t instance_size);
+		// Packs the first 3 columns of the absolute model matrix of every instance, in WorldMatrixFormat.
+		uint32_t AllocateWorldMatrices(ArrayRef<SceneObject const *> instances);
+		// Uploads everything allocated since the last commit.
+		void Commit();
+
+		static std::vector<VertexElement> const & WorldMatrixFormat();
+
+		GraphicsBufferPtr const & Buffer() const
+		{
+			return buffer_;
+		}
+
+		uint32_t NumBytesUploaded() const
+		{
+			return num_bytes_uploaded_;
+		}
+
+	private:
+		uint32_t DoAllocate(ArrayRef<SceneObject const *> instances, uint32_t instance_size, bool world);
+
+	private:
+		GraphicsBufferPtr buffer_;
+		bool use_no_overwrite_;
+
+		std::vector<uint8_t> staging_;
+		uint32_t committed_size_;
+
+		std::vector<SceneObject const *> packed_objs_;
+		std::unordered_multimap<size_t, InstanceRange> ranges_;
+
+		uint32_t num_bytes_uploaded_;
+	};
+}
+
+#endif		// _INSTANCEDATAMANAGER_HPP
@@ -19,7 +19,10 @@
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/RenderStateObject.hpp>
 #include <KlayGE/TexCompressionBC.hpp>
+#include <KFL/Thread.hpp>
 
+#include <atomic>
+#include <mutex>
 #include <vector>
 #include <deque>
 #include <unordered_map>
@@ -38,18 +41,18 @@ namespace KlayGE
 
 	private:
 		static uint32_t const EMPTY_DATA_INDEX = static_cast<uint32_t>(-1);
+		static uint32_t const EMPTY_NODE_INDEX = static_cast<uint32_t>(-1);
 
-		struct quadtree_node;
-		typedef std::shared_ptr<quadtree_node> quadtree_node_ptr;
-
+		// Nodes live in one array. The existing children of a node are stored contiguously in branch order,
+		//   and the array is laid out level by level, the same as in the file. So each level is in Morton order.
 		struct quadtree_node
 		{
-			quadtree_node_ptr children[4];
+			uint32_t children;		// Index of the first child << 4 | the mask of existing branches
 			uint32_t data_index;
 			uint32_t attr;
 
 			quadtree_node()
-				: data_index(EMPTY_DATA_INDEX)
+				: children(0), data_index(EMPTY_DATA_INDEX), attr(0xFFFFFFFF)
 			{
 			}
 		};
@@ -64,6 +67,7 @@ namespace KlayGE
 
 	public:
 		JudaTexture(uint32_t num_tiles, uint32_t tile_size, ElementFormat format);
+		~JudaTexture();
 
 		uint32_t EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const;
 		void DecodeTileID(uint32_t& level, uint32_t& tile_x, uint32_t& tile_y, uint32_t tile_id) const;
@@ -88,17 +92,37 @@ namespace KlayGE
 
 		void SetParams(RenderEffect const & effect);
 
+		// Missing tiles are decoded on the thread pool, at most DecodeBudget() of them at a time.
+		//   Coarser tiles are decoded first. A tile shows up in the cache a few frames after it's requested.
 		void UpdateCache(std::vector<uint32_t> const & tile_ids);
+		uint32_t DecodeBudget() const;
+		void DecodeBudget(uint32_t num_tiles);
 
 	private:
+		struct CacheTileData
+		{
+			uint32_t tile_id;
+			uint32_t attr;
+			std::vector<std::vector<uint8_t>> mip_data;
+			std::vector<uint32_t> mip_row_pitches;
+		};
+
 		void DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps);
-		uint32_t DecodeAAttr(uint32_t shuff);
+		uint32_t DecodeAAttr(uint32_t shuff) const;
 		uint8_t* RetriveATile(uint32_t data_index);
 
-		uint32_t NumNonEmptySubNodes(quadtree_node_ptr const & node) const;
-		quadtree_node_ptr const & GetNode(uint32_t shuff);
-		quadtree_node_ptr const & AddNode(uint32_t shuff);
+		void BuildCacheTiles(std::vector<CacheTileData>& tiles, std::vector<uint32_t> const & tile_ids);
+		void UploadCacheTiles(std::vector<CacheTileData> const & tiles);
+		void WaitForCacheTiles();
+		void DiscardCacheTiles();
+		uint32_t TileSlotIndex(uint32_t tile_id) const;
+
+		uint32_t NumNonEmptySubNodes(uint32_t node) const;
+		uint32_t ChildNode(uint32_t node, uint32_t branch) const;
+		uint32_t GetNode(uint32_t shuff) const;
+		uint32_t AddNode(uint32_t shuff);
 		void CompactNode(uint32_t shuff);
+		void LayoutNodes();
 
 		uint32_t ShuffLevel(uint32_t shuff) const;
 		uint32_t ShuffLevel(uint32_t shuff, uint32_t level) const;
@@ -118,7 +142,7 @@ namespace KlayGE
 		void DeallocateDataBlock(uint32_t index);
 
 	private:
-		quadtree_node_ptr root_;
+		std::vector<quadtree_node> nodes_;
 
 		uint32_t num_tiles_;
 		uint32_t tree_levels_;
@@ -182,6 +206,7 @@ namespace KlayGE
 		};
 		std::unordered_map<uint32_t, DecodedBlockInfo> decoded_block_cache_;
 		uint64_t decode_tick_;
+		std::mutex decode_mutex_;
 
 	private:
 		// Cache
@@ -194,13 +219,21 @@ namespace KlayGE
 
 		struct TileInfo
 		{
-			uint32_t x, y, z;
+			uint32_t tile_id;
 			uint32_t attr;
 			uint64_t tick;
 		};
-		std::unordered_map<uint32_t, TileInfo> tile_info_map_;
-		std::deque<std::pair<uint32_t, uint32_t>> tile_free_list_;
+		std::vector<TileInfo> cache_slots_;
+		// Slot of every tile of every level, see TileSlotIndex
+		std::vector<uint32_t> tile_slots_;
 		uint64_t tile_tick_;
+
+		uint32_t decode_budget_;
+		std::vector<uint32_t> tile_requests_;
+		std::vector<uint32_t> decoding_tile_ids_;
+		std::vector<CacheTileData> decoded_tiles_;
+		std::unique_ptr<joiner<void>> decode_thread_;
+		std::atomic<bool> decode_finished_;
 	};
 }
 
@@ -37,6 +37,8 @@
 
 namespace KlayGE
 {
+	// Inputs bigger than 1MB are split into independently compressed blocks, encoded and decoded on the thread pool.
+	//   Decoding from a ResIdentifier into a stream works on a few blocks at a time. Smaller inputs are one LZMA stream.
 	class KLAYGE_CORE_API LZMACodec : boost::noncopyable
 	{
 	public:
@@ -19,14 +19,17 @@
 #pragma once
 
 #include <vector>
-#include <list>
+#include <KFL/Timer.hpp>
 #include <KlayGE/Socket.hpp>
+#include <KlayGE/NetChannel.hpp>
 
 #ifndef KLAYGE_PLATFORM_WINDOWS_STORE
 
 namespace KlayGE
 {
 	uint32_t const Max_Buffer(64);
+	// Sockets wait for at most this many milliseconds, acks and retransmits go out at this rate
+	uint32_t const Net_Tick_Time(10);
 
 	class Processor : boost::noncopyable
 	{
@@ -53,9 +56,10 @@ namespace KlayGE
 		std::string		name;
 		sockaddr_in		addr;
 
-		uint32_t		time;
+		// Seconds since the lobby was created, when the last packet came
+		double			time;
 
-		std::list<std::vector<char>> msgs;
+		std::shared_ptr<NetChannel> channel;
 	};
 
 	class KLAYGE_CORE_API Lobby : boost::noncopyable
@@ -67,6 +71,7 @@ namespace KlayGE
 		Lobby();
 		~Lobby();
 
+		// Runs the lobby. Players that have joined talk through reliable channels.
 		void Create(std::string const & Name, char maxPlayers, uint16_t port, Processor const & pro);
 		void Close();
 
@@ -79,7 +84,8 @@ namespace KlayGE
 		char MaxPlayers() const;
 
 		int Receive(void* buf, int maxSize, sockaddr_in& from);
-		int Send(void const * buf, int maxSize, sockaddr_in const & to);
+		// Goes through the channel of the player at the address if there is one, so call it on the lobby thread
+		int Send(void const * buf, int maxSize, sockaddr_in const & to, bool reliable = true);
 
 		void TimeOut(uint32_t timeOut)
 			{ this->socket_.TimeOut(timeOut); }
@@ -90,6 +96,8 @@ namespace KlayGE
 			{ return this->sockAddr_; }
 
 	private:
+		void OnMessage(PlayerAddrsIter iter, std::vector<uint8_t> const & msg, double now, Processor const & pro);
+
 		void OnJoin(char* revbuf, char* sendbuf, int& sendnum, sockaddr_in& From, Processor const & pro);
 		void OnQuit(PlayerAddrsIter iter, char* sendbuf, int& sendnum, Processor const & pro);
 
@@ -105,6 +113,8 @@ namespace KlayGE
 		sockaddr_in		sockAddr_;
 
 		std::string		name_;
+
+		Timer			timer_;
 	};
 }
 
@@ -0,0 +1,96 @@
+/**
+* @file LobbyServer.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_LOBBYSERVER_HPP
+#define _KLAYGE_LOBBYSERVER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KlayGE/Lobby.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef KLAYGE_PLATFORM_LINUX
+
+namespace KlayGE
+{
+	// A lobby for thousands of players, on Linux. It speaks the same protocol as Lobby, so Player can join it.
+	//
+	// Every shard has its own socket, epoll and thread. Datagrams are received and sent in batches through
+	//   recvmmsg and sendmmsg. Players are found by a hash map keyed by address, and are kept in slots allocated
+	//   up front. With more than one shard, the sockets share the port through SO_REUSEPORT, and the kernel
+	//   spreads the players over them by address.
+	class KLAYGE_CORE_API LobbyServer : boost::noncopyable
+	{
+	public:
+		LobbyServer();
+		~LobbyServer();
+
+		// Starts the shards and returns. A port of 0 picks a free one. The processor is called on the shard
+		//   threads, so it has to be thread safe with more than one shard. Player IDs have the shard in the top 8 bits.
+		void Create(std::string const & name, uint32_t max_players_per_shard, uint16_t port, uint32_t num_shards,
+			Processor const & pro);
+		void Close();
+
+		std::string const & LobbyName() const
+		{
+			return name_;
+		}
+		uint16_t Port() const
+		{
+			return port_;
+		}
+
+		uint32_t NumPlayer() const;
+		uint32_t MaxPlayers() const;
+
+		// Sends a message to a player, or to all of them, through their channels. They can be called on any thread,
+		//   the messages go out on the shard threads. Send returns false for an ID that no shard has.
+		bool Send(uint32_t id, void const * buf, uint32_t size, bool reliable = true);
+		void Broadcast(void const * buf, uint32_t size, bool reliable = true);
+
+		uint64_t NumPacketsReceived() const;
+		uint64_t NumPacketsSent() const;
+
+	private:
+		struct Shard;
+
+		std::string name_;
+		uint16_t port_;
+		std::vector<std::unique_ptr<Shard>> shards_;
+	};
+}
+
+#endif
+
+#endif		// _KLAYGE_LOBBYSERVER_HPP
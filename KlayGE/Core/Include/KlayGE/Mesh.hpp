@@ -38,6 +38,19 @@
 
 namespace KlayGE
 {
+	// A run of LOD 0 triangles with bounds in model space. It faces away from every eye with
+	// dot(center - eye, cone_axis) >= cone_cutoff * |center - eye| + radius.
+	struct KLAYGE_CORE_API MeshCluster
+	{
+		uint32_t start_index;
+		uint32_t num_indices;
+
+		float3 center;
+		float radius;
+		float3 cone_axis;
+		float cone_cutoff;
+	};
+
 	class KLAYGE_CORE_API StaticMesh : public Renderable
 	{
 	public:
@@ -80,7 +93,11 @@ namespace KlayGE
 
 		void NumIndices(uint32_t n)
 		{
-			rl_->NumIndices(n);
+			lod_num_indices_[0] = n;
+			if (0 == active_lod_)
+			{
+				rl_->NumIndices(n);
+			}
 		}
 		uint32_t NumIndices() const
 		{
@@ -103,13 +120,62 @@ namespace KlayGE
 
 		void StartIndexLocation(uint32_t location)
 		{
-			rl_->StartIndexLocation(location);
+			lod_start_indices_[0] = location;
+			if (0 == active_lod_)
+			{
+				rl_->StartIndexLocation(location);
+			}
 		}
 		uint32_t StartIndexLocation() const
 		{
 			return rl_->StartIndexLocation();
 		}
 
+		// LOD 0 is the range set by StartIndexLocation and NumIndices. Coarser LODs index the same vertices
+		// with other ranges of the index stream. NumIndices and StartIndexLocation return the active one.
+		uint32_t NumLods() const override
+		{
+			return static_cast<uint32_t>(lod_num_indices_.size());
+		}
+		void NumLods(uint32_t lods);
+		void LodIndexRange(uint32_t lod, uint32_t start_index, uint32_t num_indices);
+		uint32_t LodStartIndexLocation(uint32_t lod) const
+		{
+			return lod_start_indices_[lod];
+		}
+		uint32_t LodNumIndices(uint32_t lod) const
+		{
+			return lod_num_indices_[lod];
+		}
+		using Renderable::ActiveLod;
+		void ActiveLod(int32_t lod) override;
+
+		void Clusters(std::vector<MeshCluster> const & clusters)
+		{
+			clusters_ = clusters;
+		}
+		std::vector<MeshCluster> const & Clusters() const
+		{
+			return clusters_;
+		}
+		uint32_t NumClusters() const override
+		{
+			return static_cast<uint32_t>(clusters_.size());
+		}
+		void CullClusters(Frustum const & frustum, float3 const & eye_pos, float proj_scale, float small_cluster_threshold) override;
+
+		// LOD 0 triangles, built when the model is loaded with EAH_CPU_RayCast
+		void RayCastBVH(TriangleBVHPtr const & bvh)
+		{
+			ray_cast_bvh_ = bvh;
+		}
+		TriangleBVHPtr RayCastBVH() const override
+		{
+			return ray_cast_bvh_;
+		}
+
+		void Render() override;
+
 		void StartInstanceLocation(uint32_t location)
 		{
 			rl_->StartInstanceLocation(location);
@@ -144,6 +210,15 @@ namespace KlayGE
 		AABBox pos_aabb_;
 		AABBox tc_aabb_;
 
+		std::vector<uint32_t> lod_start_indices_;
+		std::vector<uint32_t> lod_num_indices_;
+
+		std::vector<MeshCluster> clusters_;
+		bool clusters_culled_;
+		std::vector<std::pair<uint32_t, uint32_t>> visible_cluster_ranges_;
+
+		TriangleBVHPtr ray_cast_bvh_;
+
 		int32_t mtl_id_;
 
 		std::weak_ptr<RenderModel> model_;
@@ -212,6 +287,10 @@ namespace KlayGE
 
 		void AddToRenderQueue();
 
+		uint32_t NumLods() const override;
+		using Renderable::ActiveLod;
+		void ActiveLod(int32_t lod) override;
+
 		virtual void Pass(PassType type);
 
 		virtual bool SpecialShading() const;
@@ -396,6 +475,12 @@ namespace KlayGE
 		{
 		}
 
+		// Clusters are bounded in the bind pose, they don't hold once the joints move
+		uint32_t NumClusters() const override
+		{
+			return 0;
+		}
+
 		virtual AABBox FramePosBound(uint32_t frame) const;
 		void AttachFramePosBounds(std::shared_ptr<AABBKeyFrames> const & frame_pos_aabbs);
 		std::shared_ptr<AABBKeyFrames> const & GetFramePosBounds() const
@@ -442,6 +527,8 @@ namespace KlayGE
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs,
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
 		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_base_indices,
+		std::vector<std::vector<uint32_t>>& mesh_lod_num_indices, std::vector<std::vector<uint32_t>>& mesh_lod_base_indices,
+		std::vector<std::vector<MeshCluster>>& mesh_clusters,
 		std::vector<Joint>& joints, std::shared_ptr<AnimationActionsType>& actions,
 		std::shared_ptr<KeyFramesType>& kfs, uint32_t& num_frames, uint32_t& frame_rate,
 		std::vector<std::shared_ptr<AABBKeyFrames>>& frame_pos_bbs);
@@ -0,0 +1,210 @@
+/**
+* @file NetChannel.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_NETCHANNEL_HPP
+#define _KLAYGE_NETCHANNEL_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace KlayGE
+{
+	// Recycles message and packet buffers, so a busy channel doesn't allocate per message
+	class KLAYGE_CORE_API NetBufferPool : boost::noncopyable
+	{
+	public:
+		std::vector<uint8_t> Allocate(size_t size);
+		// Takes the memory of the buffer back. The buffer is left empty.
+		void Free(std::vector<uint8_t>& buff);
+
+	private:
+		std::vector<std::vector<uint8_t>> free_buffs_;
+	};
+
+	// Reliable and unreliable messages over a datagram transport. The channel does no I/O itself. Packets
+	//   come in through ReceivePacket, and go out through the send function in Update.
+	//
+	// Every packet has a sequence number, and acks the last 33 packets received with an ack and a 32-bit
+	//   bitfield. Messages sent in the same Update are coalesced into packets of at most mtu bytes. Reliable
+	//   messages bigger than that are split into fragments. A reliable message or fragment stays queued until
+	//   a packet carrying it is acked, and is resent after the retransmit timeout, which follows the measured
+	//   round trip time. They are delivered in order, unreliable ones as they come.
+	//
+	// Not thread safe.
+	class KLAYGE_CORE_API NetChannel : boost::noncopyable
+	{
+	public:
+		// Reliable messages and fragments queued, but not acked yet. Sending more fails until some are acked.
+		static uint32_t constexpr SEND_WINDOW = 256;
+		static uint32_t constexpr DEFAULT_MTU = 1200;
+		// A packet is sent at least this often, even if there is nothing to send, to keep the other end alive
+		static double constexpr KEEP_ALIVE_TIME = 1.0;
+
+		typedef std::function<void(void const * packet, uint32_t size)> SendFunc;
+
+	public:
+		explicit NetChannel(SendFunc const & send_func, uint32_t mtu = DEFAULT_MTU);
+
+		// Queues a message. Fails when the message can't be sent, an unreliable one bigger than a packet,
+		//   or a reliable one when the send window is full.
+		bool Send(void const * data, uint32_t size, bool reliable);
+		// Sends all due messages and acks. Call it regularly, with the time in seconds.
+		void Update(double now);
+
+		// Returns false if the packet is malformed.
+		bool ReceivePacket(void const * packet, uint32_t size, double now);
+		// Pops the next message delivered. The previous content of msg is recycled.
+		bool Receive(std::vector<uint8_t>& msg);
+
+		uint32_t Mtu() const
+		{
+			return mtu_;
+		}
+		// Smoothed round trip time, in seconds
+		double RoundTripTime() const
+		{
+			return srtt_;
+		}
+		double RetransmitTimeout() const
+		{
+			return rto_;
+		}
+		uint32_t NumUnacked() const
+		{
+			return static_cast<uint32_t>(send_units_.size());
+		}
+		uint32_t NumDelivered() const
+		{
+			return static_cast<uint32_t>(delivered_.size());
+		}
+		double LastReceiveTime() const
+		{
+			return last_recv_time_;
+		}
+
+		uint64_t NumPacketsSent() const
+		{
+			return num_packets_sent_;
+		}
+		uint64_t NumPacketsReceived() const
+		{
+			return num_packets_received_;
+		}
+		uint64_t NumResent() const
+		{
+			return num_resent_;
+		}
+
+	private:
+		// A reliable message, or one fragment of it
+		struct SendUnit
+		{
+			uint16_t id;
+			uint16_t fragment;
+			uint16_t num_fragments;
+			bool acked;
+			double send_time;
+			std::vector<uint8_t> data;
+		};
+
+		struct RecvUnit
+		{
+			bool valid;
+			uint16_t fragment;
+			uint16_t num_fragments;
+			std::vector<uint8_t> data;
+		};
+
+		struct SentPacket
+		{
+			bool valid;
+			bool acked;
+			uint16_t seq;
+			double send_time;
+			std::vector<uint16_t> unit_ids;
+		};
+
+		static uint32_t constexpr PACKET_RING_SIZE = 256;
+
+	private:
+		uint32_t MaxFragmentSize() const;
+
+		void BeginPacket();
+		void EndPacket(double now);
+		bool AppendMessage(void const * data, uint32_t size, bool reliable, uint16_t id,
+			uint16_t fragment, uint16_t num_fragments);
+
+		void OnAcked(uint16_t seq, double now);
+		void OnReliable(uint16_t id, uint16_t fragment, uint16_t num_fragments, uint8_t const * data, uint32_t size);
+		void DeliverReliables();
+
+	private:
+		SendFunc send_func_;
+		uint32_t mtu_;
+
+		NetBufferPool pool_;
+
+		// Starts from 1. Packets sent before anything is received ack sequence 0, which can't be a real packet then.
+		uint16_t local_seq_;
+		uint16_t next_send_id_;
+		std::deque<SendUnit> send_units_;
+		std::vector<std::vector<uint8_t>> unreliables_;
+		std::array<SentPacket, PACKET_RING_SIZE> sent_packets_;
+
+		bool has_received_;
+		uint16_t remote_seq_;
+		uint32_t recv_bits_;
+		bool ack_pending_;
+		uint16_t next_recv_id_;
+		std::array<RecvUnit, SEND_WINDOW> recv_units_;
+		std::deque<std::vector<uint8_t>> delivered_;
+
+		std::vector<uint8_t> packet_;
+		SentPacket* curr_packet_;
+		double last_send_time_;
+		double last_recv_time_;
+
+		double srtt_;
+		double rttvar_;
+		double rto_;
+
+		uint64_t num_packets_sent_;
+		uint64_t num_packets_received_;
+		uint64_t num_resent_;
+	};
+}
+
+#endif		// _KLAYGE_NETCHANNEL_HPP
@@ -0,0 +1,272 @@
+/**
+* @file NetReplication.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_NETREPLICATION_HPP
+#define _KLAYGE_NETREPLICATION_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Vector.hpp>
+#include <KFL/Quaternion.hpp>
+
+#include <array>
+#include <vector>
+
+namespace KlayGE
+{
+	// Packs values into bytes, lowest bits first
+	class KLAYGE_CORE_API BitWriter
+	{
+	public:
+		BitWriter();
+
+		void Reset();
+		// Writes the low bits of value. bits is at most 32.
+		void Write(uint32_t value, uint32_t bits);
+		// Drops everything written after the first num_bits bits
+		void Rewind(uint32_t num_bits);
+
+		uint32_t NumBits() const
+		{
+			return num_bits_;
+		}
+		std::vector<uint8_t> const & Bytes() const
+		{
+			return bytes_;
+		}
+
+	private:
+		std::vector<uint8_t> bytes_;
+		uint32_t num_bits_;
+	};
+
+	class KLAYGE_CORE_API BitReader
+	{
+	public:
+		BitReader(void const * data, uint32_t size);
+
+		// Reading past the end returns 0, and sets the overflow flag
+		uint32_t Read(uint32_t bits);
+
+		bool Overflow() const
+		{
+			return overflow_;
+		}
+
+	private:
+		uint8_t const * data_;
+		uint32_t num_bits_;
+		uint32_t pos_;
+		bool overflow_;
+	};
+
+	enum ReplicatedFields
+	{
+		RF_Position = 1UL << 0,
+		RF_Rotation = 1UL << 1,
+		RF_Scale = 1UL << 2,
+
+		RF_Transform = RF_Position | RF_Rotation | RF_Scale
+	};
+
+	// A transform in the form it's replicated. Positions and scales are fixed point, rotations are smallest
+	//   three quaternions: the index of the largest component in the top 2 bits, and the other 3 components,
+	//   which are within +-1/sqrt(2), in 10 bits each. The largest one is made positive and left out.
+	struct QuantizedTransform
+	{
+		int32_t pos[3];
+		uint32_t rot;
+		int32_t scale[3];
+
+		bool operator==(QuantizedTransform const & rhs) const;
+		bool operator!=(QuantizedTransform const & rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	KLAYGE_CORE_API uint32_t PackQuaternion(Quaternion const & rot);
+	KLAYGE_CORE_API Quaternion UnpackQuaternion(uint32_t packed);
+
+	KLAYGE_CORE_API QuantizedTransform QuantizeTransform(float3 const & pos, Quaternion const & rot, float3 const & scale,
+		float position_precision);
+	KLAYGE_CORE_API void DequantizeTransform(float3& pos, Quaternion& rot, float3& scale, QuantizedTransform const & qt,
+		float position_precision);
+
+	// Replicates the transforms of scene objects to clients, as snapshots. The server does no I/O. Snapshots go
+	//   out as unreliable messages, through NetChannel or anything else, and the client acks them back.
+	//
+	// Every entry is delta encoded against the last state the client acked for that object, if it's recent
+	//   enough, and objects the client already has aren't sent at all. Objects compete for the bandwidth budget
+	//   of each client by priority, which accumulates while an object waits, scaled by its relevance to the view
+	//   point of the client.
+	class KLAYGE_CORE_API ReplicationServer : boost::noncopyable
+	{
+	public:
+		// Baselines older than this many snapshots aren't used, the entry is sent whole
+		static uint32_t constexpr BASELINE_WINDOW = 16;
+
+	public:
+		explicit ReplicationServer(float position_precision = 1.0f / 512);
+
+		// Returns the ID the object is replicated with. Clients bind it to their own objects.
+		uint32_t Register(SceneObjectPtr const & so, uint32_t fields = RF_Transform, float priority = 1);
+		void Unregister(uint32_t id);
+
+		uint32_t AddClient(uint32_t bytes_per_second);
+		void RemoveClient(uint32_t client);
+		void ClientViewPoint(uint32_t client, float3 const & pos);
+		void ClientBandwidth(uint32_t client, uint32_t bytes_per_second);
+
+		// Objects this far from the view point have half the priority
+		void RelevanceRadius(float radius);
+
+		// Quantizes the transforms of all objects. Call it once a tick, before writing the snapshots.
+		void Capture();
+		// Writes the next snapshot of a client. It's as big as the bandwidth left since the last one allows,
+		//   but never bigger than max_size.
+		void WriteSnapshot(uint32_t client, float elapsed_time, uint32_t max_size, std::vector<uint8_t>& snapshot);
+		// The client received a snapshot. What it carried becomes the baselines.
+		void OnAck(uint32_t client, uint16_t seq);
+
+	private:
+		struct Object
+		{
+			SceneObjectPtr so;
+			uint32_t fields;
+			float priority;
+			float3 pos;
+			QuantizedTransform state;
+		};
+
+		struct ClientObject
+		{
+			QuantizedTransform acked;
+			QuantizedTransform sent;
+			uint16_t acked_seq;
+			bool acked_valid;
+			// The acked state is recent enough to delta against
+			bool baseline_valid;
+			float accum_priority;
+		};
+
+		struct SentSnapshot
+		{
+			bool valid;
+			uint16_t seq;
+			std::vector<std::pair<uint32_t, QuantizedTransform>> entries;
+		};
+
+		static uint32_t constexpr SENT_RING_SIZE = 64;
+
+		struct Client
+		{
+			bool valid;
+			uint32_t bytes_per_second;
+			float credit;
+			float3 view_point;
+			uint16_t seq;
+			std::vector<ClientObject> objects;
+			std::array<SentSnapshot, SENT_RING_SIZE> sent;
+		};
+
+	private:
+		void ResetClientObject(ClientObject& co);
+		uint32_t IDBits() const;
+
+	private:
+		float position_precision_;
+		float relevance_radius_;
+
+		std::vector<Object> objects_;
+		std::vector<uint32_t> free_ids_;
+
+		std::vector<Client> clients_;
+
+		std::vector<std::pair<float, uint32_t>> candidates_;
+		BitWriter writer_;
+	};
+
+	// Decodes snapshots, and moves the bound scene objects
+	class KLAYGE_CORE_API ReplicationClient : boost::noncopyable
+	{
+	public:
+		// Snapshots with IDs from max_objects on are rejected
+		explicit ReplicationClient(uint32_t max_objects = 65536, float position_precision = 1.0f / 512);
+
+		void Bind(uint32_t id, SceneObjectPtr const & so);
+		void Unbind(uint32_t id);
+
+		// Returns false if the snapshot is malformed. Otherwise seq is the one to ack.
+		bool ReadSnapshot(void const * data, uint32_t size, uint16_t& seq);
+
+		// The newest transform received for the object
+		bool Transform(uint32_t id, float3& pos, Quaternion& rot, float3& scale) const;
+		bool Transform(uint32_t id, QuantizedTransform& qt) const;
+
+	private:
+		struct Baseline
+		{
+			bool valid;
+			uint16_t seq;
+			QuantizedTransform state;
+		};
+
+		struct Object
+		{
+			SceneObjectPtr so;
+			bool valid;
+			uint16_t seq;
+			QuantizedTransform state;
+			// The states of the last snapshots carrying this object, the baselines deltas refer to
+			std::array<Baseline, ReplicationServer::BASELINE_WINDOW> baselines;
+		};
+
+		struct Entry
+		{
+			uint32_t id;
+			bool decoded;
+			QuantizedTransform state;
+		};
+
+	private:
+		Object& GetObject(uint32_t id);
+
+	private:
+		uint32_t max_objects_;
+		float position_precision_;
+
+		std::vector<Object> objects_;
+		std::vector<Entry> entries_;
+	};
+}
+
+#endif		// _KLAYGE_NETREPLICATION_HPP
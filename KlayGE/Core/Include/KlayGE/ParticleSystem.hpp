@@ -38,6 +38,7 @@
 #include <KFL/Thread.hpp>
 #include <KlayGE/SceneObjectHelper.hpp>
 
+#include <array>
 #include <vector>
 #include <random>
 
@@ -292,10 +293,12 @@ namespace KlayGE
 		{
 			return static_cast<uint32_t>(particles_.size());
 		}
+		// The particles handed to rendering in the last main thread update
 		uint32_t NumActiveParticles() const
 		{
-			return static_cast<uint32_t>(active_particles_.size());
+			return static_cast<uint32_t>(active_particle_slots_[active_particle_index_.read_index()].particles.size());
 		}
+		// Of the last sub thread update. Only for the sub thread.
 		uint32_t GetActiveParticleIndex(uint32_t i) const
 		{
 			return active_particles_[i].first;
@@ -353,7 +356,15 @@ namespace KlayGE
 
 		bool gs_support_;
 
-		std::mutex update_mutex_;
+	private:
+		// Copies of the active particles, sorted back to front, handed from the sub thread to the main thread
+		struct ActiveParticles
+		{
+			std::vector<Particle> particles;
+			AABBox bound;
+		};
+		std::array<ActiveParticles, 3> active_particle_slots_;
+		triple_buffer_index active_particle_index_;
 	};
 
 	KLAYGE_CORE_API ParticleSystemPtr SyncLoadParticleSystem(std::string const & psml_name);
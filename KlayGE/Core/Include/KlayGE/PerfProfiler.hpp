@@ -36,12 +36,28 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Timer.hpp>
 
+#include <array>
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <string>
 #include <tuple>
 
 namespace KlayGE
 {
+	enum PerfCounterType
+	{
+		PCT_DrawCalls = 0,
+		PCT_Dispatches,
+		PCT_ResourceLoads,
+		PCT_GPUAllocations,
+		PCT_InstanceUploadBytes,
+		PCT_SceneLockWaits,
+		PCT_DroppedSubThreadFrames,
+
+		PCT_NumCounterTypes
+	};
+
 	class KLAYGE_CORE_API PerfRange : boost::noncopyable
 	{
 	public:
@@ -52,6 +68,7 @@ namespace KlayGE
 
 		void CollectData();
 
+		double CPUBeginTime() const;
 		double CPUTime() const;
 		double GPUTime() const;
 		bool Dirty() const;
@@ -60,35 +77,177 @@ namespace KlayGE
 		Timer cpu_timer_;
 		QueryPtr gpu_timer_query_;
 
+		double cpu_begin_time_;
 		double cpu_time_;
 		double gpu_time_;
 
 		bool dirty_;
 	};
 
+	// A CPU-only marker for the enclosing scope. Can be used from any thread and nested freely.
+	// The name must outlive the profiler, which is always true for string literals.
+	class KLAYGE_CORE_API PerfScope : boost::noncopyable
+	{
+	public:
+		explicit PerfScope(char const * name);
+		~PerfScope();
+
+	private:
+		// Latched at the beginning, so toggling the profiler inside the scope can't unbalance the depth
+		PerfProfiler* profiler_;
+	};
+
+	struct PerfScopeEvent
+	{
+		char const * name;
+		double begin_time;
+		double end_time;
+		uint32_t frame_id;
+		uint32_t depth;
+	};
+
+	struct PerfRangeSummary
+	{
+		int category;
+		std::string name;
+		double avg_cpu_time;
+		double max_cpu_time;
+		double avg_gpu_time;
+	};
+
+	struct PerfScopeSummary
+	{
+		std::string name;
+		uint32_t count;
+		double avg_time;
+		double max_time;
+	};
+
+	struct PerfFrameSummary
+	{
+		uint32_t num_frames;
+		double avg_frame_time;
+		double max_frame_time;
+		std::array<double, PCT_NumCounterTypes> avg_counters;
+		std::vector<PerfRangeSummary> ranges;
+		std::vector<PerfScopeSummary> scopes;
+	};
+
 	class KLAYGE_CORE_API PerfProfiler : boost::noncopyable
 	{
+		friend struct PerfThreadBufferOwner;
+
+		// Single-producer ring of finished scopes. Only the owning thread writes, and publishes by bumping head.
+		struct ThreadScopeBuffer
+		{
+			uint32_t thread_index;
+			std::vector<PerfScopeEvent> events;
+			std::atomic<uint64_t> head;
+
+			std::array<std::pair<char const *, double>, 64> stack;
+			uint32_t depth;
+
+			// Set when the owning thread exits. The buffer is freed once its events fall out of the kept frames.
+			bool retired;
+			uint32_t retired_frame;
+		};
+
+		struct PerfFrameRecord
+		{
+			uint32_t frame_id;
+			double begin_time;
+			double end_time;
+			std::array<uint32_t, PCT_NumCounterTypes> counters;
+		};
+
+		struct PerfRangeRecord
+		{
+			uint32_t frame_id;
+			double cpu_begin_time;
+			double cpu_time;
+			double gpu_time;
+		};
+
 	public:
+		static uint32_t const DEFAULT_FRAME_CAPACITY = 1800;
+		static uint32_t const SCOPE_EVENT_CAPACITY = 1UL << 16;
+
 		PerfProfiler();
+		~PerfProfiler();
 
 		static PerfProfiler& Instance();
+		// Doesn't create the profiler, so it's safe during shutdown. nullptr if there is none.
+		static PerfProfiler* ExistingInstance();
 		static void Destroy();
 
 		void Suspend();
 		void Resume();
 
+		// Number of most recent frames kept in memory. Older frames are overwritten.
+		void FrameCapacity(uint32_t num_frames);
+		uint32_t FrameCapacity() const
+		{
+			return frame_capacity_;
+		}
+
 		PerfRangePtr CreatePerfRange(int category, std::string const & name);
 		void CollectData();
 
+		// Always record. The perf_profiler config is checked by PerfScope.
+		void BeginScope(char const * name);
+		void EndScope();
+
+		void IncCounter(PerfCounterType type, uint32_t n = 1)
+		{
+			counters_[type].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		double TimeStamp() const;
+
+		PerfFrameSummary Summary(uint32_t num_frames) const;
+
+		// Scopes that began at or after since_time, with the index of their thread. A full ring drops its oldest
+		// event too, because the owning thread could be overwriting it.
+		void CollectScopeEvents(std::vector<std::pair<uint32_t, PerfScopeEvent>>& events, double since_time) const;
+
 		void ExportToCSV(std::string const & file_name) const;
+		// Writes the last window_seconds (0 means everything kept) in Chrome trace event format,
+		// which can be loaded by chrome://tracing and Perfetto.
+		void ExportToChromeTrace(std::string const & file_name, double window_seconds = 0) const;
+
+	private:
+		ThreadScopeBuffer& CurrentThreadBuffer();
+		void RetireThreadBuffer(ThreadScopeBuffer* buffer);
+		void ReleaseRetiredThreadBuffers();
+		uint32_t NumFramesKept() const;
 
 	private:
 		static std::unique_ptr<PerfProfiler> perf_profiler_instance_;
 
-		std::vector<std::tuple<int, std::string, PerfRangePtr,
-			std::vector<std::tuple<uint32_t, double, double>>>> perf_ranges_;
-		uint32_t frame_id_;
+		Timer timer_;
+		double start_time_;
+		uint32_t generation_;
+
+		uint32_t frame_capacity_;
+		std::vector<std::tuple<int, std::string, PerfRangePtr, std::vector<PerfRangeRecord>>> perf_ranges_;
+		std::vector<PerfFrameRecord> frames_;
+		std::atomic<uint32_t> frame_id_;
+		double frame_begin_time_;
+
+		std::array<std::atomic<uint32_t>, PCT_NumCounterTypes> counters_;
+
+		std::vector<std::unique_ptr<ThreadScopeBuffer>> thread_buffers_;
+		uint32_t next_thread_index_;
+		mutable std::mutex thread_buffers_mutex_;
 	};
 }
 
+#define KLAYGE_PERF_SCOPE_JOIN_IMPL(a, b) a##b
+#define KLAYGE_PERF_SCOPE_JOIN(a, b) KLAYGE_PERF_SCOPE_JOIN_IMPL(a, b)
+#ifndef KLAYGE_SHIP
+	#define KLAYGE_PERF_SCOPE(name) KlayGE::PerfScope KLAYGE_PERF_SCOPE_JOIN(klayge_perf_scope_, __LINE__)(name)
+#else
+	#define KLAYGE_PERF_SCOPE(name)
+#endif
+
 #endif			// _KLAYGE_PERFPROFILER_HPP
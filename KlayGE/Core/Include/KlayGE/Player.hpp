@@ -18,11 +18,14 @@
 
 #pragma once
 
-#include <list>
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 #include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
 #include <KlayGE/Socket.hpp>
+#include <KlayGE/NetChannel.hpp>
 
 #ifndef KLAYGE_PLATFORM_WINDOWS_STORE
 
@@ -47,25 +50,35 @@ namespace KlayGE
 		void Destroy();
 		LobbyDes LobbyInfo();
 
+		// 0 before joining
+		uint32_t PlayerID() const
+			{ return this->playerID_; }
+
 		void Name(std::string const & name);
 		std::string const & Name()
 			{ return this->name_; }
 
+		// Messages from the lobby, through the channel. Returns -1 if there is none.
 		int Receive(void* buf, int maxSize, sockaddr_in& from);
-		int Send(void const * buf, int size);
+		// Returns -1 if the message is too big, or the reliable send window is full.
+		int Send(void const * buf, int size, bool reliable = true);
 
 		void ReceiveFunc();
 
 	private:
 		Socket		socket_;
+		sockaddr_in	lobbyAddr_;
 
-		char		playerID_;
+		uint32_t	playerID_;
 		std::string	name_;
 
 		joiner<void>	receiveThread_;
-		bool			receiveLoop_;
+		std::atomic<bool>	receiveLoop_;
 
-		std::list<std::vector<char>> sendQueue_;
+		// Guards the channel, which is used by both the receiving thread and the caller
+		std::mutex		channelMutex_;
+		std::unique_ptr<NetChannel>	channel_;
+		Timer			timer_;
 	};
 }
 
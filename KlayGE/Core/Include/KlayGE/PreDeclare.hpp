@@ -58,6 +58,11 @@ namespace KlayGE
 	typedef std::shared_ptr<SceneObjectLightSourceProxy> SceneObjectLightSourceProxyPtr;
 	class SceneObjectCameraProxy;
 	typedef std::shared_ptr<SceneObjectCameraProxy> SceneObjectCameraProxyPtr;
+	struct SceneRay;
+	struct SceneRayHit;
+	class TriangleBVH;
+	typedef std::shared_ptr<TriangleBVH> TriangleBVHPtr;
+	class SceneBVH;
 
 	class Blitter;
 	typedef std::shared_ptr<Blitter> BlitterPtr;
@@ -120,6 +125,8 @@ namespace KlayGE
 	typedef std::shared_ptr<SamplerStateObject> SamplerStateObjectPtr;
 	class ShaderObject;
 	typedef std::shared_ptr<ShaderObject> ShaderObjectPtr;
+	class ShaderCache;
+	typedef std::shared_ptr<ShaderCache> ShaderCachePtr;
 	class Texture;
 	typedef std::shared_ptr<Texture> TexturePtr;
 	class TexCompression;
@@ -260,6 +267,8 @@ namespace KlayGE
 	typedef std::shared_ptr<HQTerrainRenderable> HQTerrainRenderablePtr;
 	class HQTerrainSceneObject;
 	typedef std::shared_ptr<HQTerrainSceneObject> HQTerrainSceneObjectPtr;
+	class HeightfieldCache;
+	typedef std::shared_ptr<HeightfieldCache> HeightfieldCachePtr;
 	class LensFlareRenderable;
 	typedef std::shared_ptr<LensFlareRenderable> LensFlareRenderablePtr;
 	class LensFlareSceneObject;
@@ -295,6 +304,7 @@ namespace KlayGE
 	typedef std::shared_ptr<LightShaftPostProcess> LightShaftPostProcessPtr;
 	class TransientBuffer;
 	typedef std::shared_ptr<TransientBuffer> TransientBufferPtr;
+	class InstanceDataManager;
 	class Fence;
 	typedef std::shared_ptr<Fence> FencePtr;
 	class Imposter;
@@ -347,6 +357,8 @@ namespace KlayGE
 	class AudioDataSourceFactory;
 
 	class App3DFramework;
+	class FrameTimeHistogram;
+	class FrameScheduler;
 	class Window;
 	typedef std::shared_ptr<Window> WindowPtr;
 
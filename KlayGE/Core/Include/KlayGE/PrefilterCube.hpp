@@ -0,0 +1,69 @@
+/**
+ * @file PrefilterCube.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_PREFILTER_CUBE_HPP
+#define _KLAYGE_PREFILTER_CUBE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KlayGE/ElementFormat.hpp>
+#include <KFL/ArrayRef.hpp>
+#include <KFL/Math.hpp>
+
+#include <array>
+#include <vector>
+
+namespace KlayGE
+{
+	// Same sample count and Hammersley sequence as the GPU PrefilterCube tool
+	uint32_t const PREFILTER_CUBE_NUM_SAMPLES = 1024;
+
+	// The cube maps here are 6 faces of width * width linear RGB texels, in Texture::CubeFaces order.
+
+	KLAYGE_CORE_API float3 SampleCubeMap(std::vector<float3> const & cube, uint32_t width, float3 const & dir);
+
+	KLAYGE_CORE_API void ProjectCubeMapToSH9(std::vector<float3> const & cube, uint32_t width, std::array<float3, 9>& sh);
+	// The cosine weighted average radiance around normal, E(n) / PI
+	KLAYGE_CORE_API float3 SH9Irradiance(std::array<float3, 9> const & sh, float3 const & normal);
+
+	KLAYGE_CORE_API void PrefilterCubeMapSpecular(std::vector<float3> const & cube, uint32_t width, float shininess,
+		std::vector<float3>& out_cube, uint32_t out_width);
+	KLAYGE_CORE_API void PrefilterCubeMapDiffuse(std::vector<float3> const & cube, uint32_t width,
+		std::vector<float3>& out_cube, uint32_t out_width);
+
+	// Builds the whole ABGR16F chain in the layout of the GPU PrefilterCube tool. Level 0 is the input, the middle levels are
+	// specular from glossy to rough, the last one is diffuse.
+	KLAYGE_CORE_API void PrefilterCubeMap(uint32_t width, uint32_t num_mipmaps, ElementFormat format,
+		ArrayRef<ElementInitData> init_data,
+		uint32_t& out_num_mipmaps, std::vector<ElementInitData>& out_init_data, std::vector<uint8_t>& out_data_block);
+}
+
+#endif		// _KLAYGE_PREFILTER_CUBE_HPP
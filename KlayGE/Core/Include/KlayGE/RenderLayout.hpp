@@ -21,6 +21,7 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/ArrayRef.hpp>
 
+#include <utility>
 #include <vector>
 
 #include <KlayGE/GraphicsBuffer.hpp>
@@ -230,6 +231,11 @@ namespace KlayGE
 		void StartIndexLocation(uint32_t location);
 		uint32_t StartIndexLocation() const;
 
+		// (start index, number of indices) ranges drawn instead of the one from StartIndexLocation and NumIndices.
+		// Every pass draws all of them. The ranges are copied, an empty one goes back to the single range.
+		void IndexRanges(ArrayRef<std::pair<uint32_t, uint32_t>> ranges);
+		ArrayRef<std::pair<uint32_t, uint32_t>> IndexRanges() const;
+
 		void StartInstanceLocation(uint32_t location);
 		uint32_t StartInstanceLocation() const;
 
@@ -266,6 +272,8 @@ namespace KlayGE
 		int32_t base_vertex_location_;
 		uint32_t start_instance_location_;
 
+		std::vector<std::pair<uint32_t, uint32_t>> index_ranges_;
+
 		GraphicsBufferPtr indirect_args_buff_;
 		uint32_t indirect_args_offset;
 
@@ -180,8 +180,44 @@ namespace KlayGE
 			return instances_[index];
 		}
 
+		// Packs the instance data into the frame's instance buffer. Returns the start instance location, or -1 without instance data.
+		uint32_t AllocateInstances();
+		// Same geometry, material, and technique. The instances of rhs can be drawn by this in one instanced draw call.
+		bool CanMergeInstances(Renderable const & rhs) const;
+		// Switches to the instancing G-buffer effect, which reads the world matrix of each instance from the instance stream.
+		void UseInstancedWorld();
+		bool InstancedWorld() const
+		{
+			return instanced_world_;
+		}
+
 		virtual void ModelMatrix(float4x4 const & mat);
 
+		// LOD 0 is the full detail one. Larger LODs are coarser.
+		virtual uint32_t NumLods() const
+		{
+			return 1;
+		}
+		virtual void ActiveLod(int32_t lod);
+		int32_t ActiveLod() const
+		{
+			return active_lod_;
+		}
+
+		// Renderables split into clusters can skip the ones outside the frustum, facing away, or covering less than
+		// small_cluster_threshold of the screen. The result is used by the next Render.
+		virtual uint32_t NumClusters() const
+		{
+			return 0;
+		}
+		virtual void CullClusters(Frustum const & frustum, float3 const & eye_pos, float proj_scale, float small_cluster_threshold);
+
+		// Triangles in model space for the CPU ray casts of SceneManager
+		virtual TriangleBVHPtr RayCastBVH() const
+		{
+			return TriangleBVHPtr();
+		}
+
 		template <typename ForwardIterator>
 		void AssignSubrenderables(ForwardIterator first, ForwardIterator last)
 		{
@@ -292,14 +328,18 @@ namespace KlayGE
 		RenderTechnique* vdm_tech_;
 
 		float4x4 model_mat_;
+		int32_t active_lod_;
 
 		PassType type_;
 		uint32_t effect_attrs_;
+		bool instanced_world_;
 
 		RenderMaterialPtr mtl_;
 
 		RenderEffectParameter* mvp_param_;
 		RenderEffectParameter* model_view_param_;
+		RenderEffectParameter* view_param_;
+		RenderEffectParameter* view_proj_param_;
 		RenderEffectParameter* forward_vec_param_;
 		RenderEffectParameter* frame_size_param_;
 		RenderEffectParameter* height_offset_scale_param_;
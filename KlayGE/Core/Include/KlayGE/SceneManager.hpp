@@ -24,9 +24,13 @@
 #include <KlayGE/PreDeclare.hpp>
 
 #include <KlayGE/Renderable.hpp>
+#include <KlayGE/InstanceDataManager.hpp>
+#include <KlayGE/SceneQuery.hpp>
 #include <KFL/Frustum.hpp>
+#include <KFL/SIMDBatch.hpp>
 #include <KFL/Thread.hpp>
 
+#include <atomic>
 #include <vector>
 #include <unordered_map>
 
@@ -42,7 +46,14 @@ namespace KlayGE
 		void Resume();
 
 		void SmallObjectThreshold(float area);
+		// Objects covering at least this fraction of the screen are drawn in LOD 0. Every halving of the area
+		// picks the next coarser LOD. 0 always draws LOD 0.
+		void LodThreshold(float area);
+		// Time between two sub thread updates. With a fixed simulation step in the frame scheduler, that step is used instead.
 		void SceneUpdateElapse(float elapse);
+		// Threads sharing the sub thread updates, 0 is all cores. 1 runs them in order, for updates that can't
+		// run in parallel, like the ones of a script engine.
+		void SubThreadUpdateWorkers(uint32_t num_workers);
 		virtual void ClipScene();
 
 		void AddCamera(CameraPtr const & camera);
@@ -74,6 +85,12 @@ namespace KlayGE
 		virtual BoundOverlap SphereVisible(Sphere const & sphere) const;
 		virtual BoundOverlap FrustumVisible(Frustum const & frustum) const;
 
+		// CPU queries on the scene objects, without reading anything back from GPU. Objects are hit at their
+		// triangles if their models are loaded with EAH_CPU_RayCast, otherwise at their world bounds.
+		bool RayCast(SceneRay const & ray, SceneRayHit& hit);
+		void RayCast(ArrayRef<SceneRay> rays, SceneRayHit* hits);
+		void OverlapQuery(AABBox const & aabb, std::vector<SceneObject*>& objs);
+
 		virtual void ClearCamera();
 		virtual void ClearLight();
 		virtual void ClearObject();
@@ -86,6 +103,16 @@ namespace KlayGE
 		uint32_t NumVerticesRendered() const;
 		uint32_t NumDrawCalls() const;
 		uint32_t NumDispatchCalls() const;
+		uint32_t NumInstanceBytesUploaded() const;
+		// Contention between the threads, since the start. Lock waits are the times a thread blocked on the
+		// scene lock. Dropped sub thread frames are the sweeps replaced by newer ones before rendering took them.
+		uint32_t NumLockWaits() const;
+		uint32_t NumDroppedSubThreadFrames() const;
+
+		InstanceDataManager& InstanceData()
+		{
+			return instance_data_;
+		}
 
 	protected:
 		void Flush(uint32_t urt);
@@ -100,13 +127,17 @@ namespace KlayGE
 		virtual void DoResume() = 0;
 
 		void UpdateThreadFunc();
+		void SweepSubThreadUpdates(float app_time, float frame_time);
 
 		BoundOverlap VisibleTestFromParent(SceneObject* obj, float3 const & view_dir, float3 const & eye_pos,
 			float4x4 const & view_proj);
+		void SelectLods();
+		int32_t SelectLod(SceneObject* obj, uint32_t num_lods, float3 const & eye_pos, float4x4 const & view_proj) const;
 
 	protected:
 		std::vector<CameraPtr> cameras_;
 		Frustum const * frustum_;
+		SIMDFrustum const * simd_frustum_;
 		std::vector<LightSourcePtr> lights_;
 		std::vector<SceneObjectPtr> scene_objs_;
 		std::vector<SceneObjectPtr> overlay_scene_objs_;
@@ -114,15 +145,20 @@ namespace KlayGE
 		std::unordered_map<size_t, std::shared_ptr<std::vector<BoundOverlap>>> visible_marks_map_;
 
 		float small_obj_threshold_;
+		float lod_threshold_;
 		float update_elapse_;
 
 	private:
 		void FlushScene();
+		void MergeInstances();
+		void CullClusters(Camera const & camera);
+		void UpdateSceneBVH();
 
 	private:
 		uint32_t urt_;
 
 		std::vector<std::pair<RenderTechnique const *, std::vector<Renderable*>>> render_queue_;
+		InstanceDataManager instance_data_;
 
 		uint32_t num_objects_rendered_;
 		uint32_t num_renderables_rendered_;
@@ -130,10 +166,32 @@ namespace KlayGE
 		uint32_t num_vertices_rendered_;
 		uint32_t num_draw_calls_;
 		uint32_t num_dispatch_calls_;
+		uint32_t num_instance_bytes_uploaded_;
+
+		SceneBVH scene_bvh_;
+		bool scene_bvh_dirty_;
+		bool scene_bvh_refit_;
+		std::vector<uint32_t> overlap_instances_;
 
 		std::mutex update_mutex_;
 		std::unique_ptr<joiner<void>> update_thread_;
 		volatile bool quit_;
+		// Time between two sweeps, the simulation's fixed step if there's one, or update_elapse_
+		std::atomic<float> sweep_elapse_;
+
+		// The sweep works on its own copy of scene_objs_, updated when the version changes, so it only takes
+		// update_mutex_ then. sweep_mutex_ is held during the sweep, for removals to wait on.
+		std::mutex sweep_mutex_;
+		std::vector<SceneObjectPtr> sweep_objs_;
+		std::atomic<uint32_t> scene_objs_version_;
+		uint32_t sweep_objs_version_;
+		uint32_t sub_thread_workers_;
+		uint32_t sub_thread_frame_;
+		// Slots of the model matrices published by the sweeps, see SceneObject::SubThreadUpdateAndPublish
+		triple_buffer_index sub_thread_slots_;
+
+		std::atomic<uint32_t> num_lock_waits_;
+		std::atomic<uint32_t> num_dropped_sub_thread_frames_;
 
 		bool deferred_mode_;
 	};
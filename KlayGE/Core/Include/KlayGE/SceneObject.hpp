@@ -22,6 +22,9 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KlayGE/RenderLayout.hpp>
 #include <KlayGE/Renderable.hpp>
+#include <KFL/Thread.hpp>
+
+#include <array>
 
 namespace KlayGE
 {
@@ -56,6 +59,9 @@ namespace KlayGE
 		void UpdateAbsModelMatrix();
 		void VisibleMark(BoundOverlap vm);
 		BoundOverlap VisibleMark() const;
+		// LOD selected from the main camera for this frame
+		void Lod(int32_t lod);
+		int32_t Lod() const;
 
 		virtual void OnAttachRenderable(bool add_to_scene);
 
@@ -70,6 +76,15 @@ namespace KlayGE
 		virtual void SubThreadUpdate(float app_time, float elapsed_time);
 		virtual bool MainThreadUpdate(float app_time, float elapsed_time);
 
+		// Sub thread updates of different objects run in parallel, and at the same time as rendering. Inside
+		// SubThreadUpdate, ModelMatrix of this object goes to a copy of the sub threads, so don't read other
+		// scene objects there. SceneManager publishes the copy to slot after the update, with the index of the
+		// sweep, and the main thread takes it with AcquireSubThreadState before its own update. A ModelMatrix set
+		// by the main thread goes the other way, the next sub thread update builds on it, and the sub thread
+		// results computed before it are dropped.
+		void SubThreadUpdateAndPublish(uint32_t frame, uint32_t slot, float app_time, float elapsed_time);
+		void AcquireSubThreadState(uint32_t slot);
+
 		uint32_t Attrib() const;
 		bool Visible() const;
 		void Visible(bool vis);
@@ -106,9 +121,27 @@ namespace KlayGE
 		float4x4 abs_model_;
 		std::unique_ptr<AABBox> pos_aabb_ws_;
 		BoundOverlap visible_mark_;
+		int32_t lod_;
 
 		std::function<void(SceneObject&, float, float)> sub_thread_update_func_;
 		std::function<void(SceneObject&, float, float)> main_thread_update_func_;
+
+	private:
+		// Written only by the sub threads. The version is the one of the main thread's matrix it started from.
+		float4x4 sub_model_;
+		uint32_t sub_model_frame_;
+		uint32_t sub_model_version_;
+		// Indexed by the slots of SceneManager's triple buffer
+		std::array<float4x4, 3> published_models_;
+		std::array<uint32_t, 3> published_model_frames_;
+		std::array<uint32_t, 3> published_model_versions_;
+		// Written only by the main thread. The version counts its ModelMatrix sets.
+		uint32_t acquired_model_frame_;
+		uint32_t main_model_version_;
+		// Matrices set by the main thread, handed to the sub threads
+		std::array<float4x4, 3> main_models_;
+		std::array<uint32_t, 3> main_model_versions_;
+		triple_buffer_index main_model_index_;
 	};
 }
 
@@ -0,0 +1,195 @@
+/**
+* @file SceneQuery.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_SCENEQUERY_HPP
+#define _KLAYGE_SCENEQUERY_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
+#include <KFL/AABBox.hpp>
+#include <KFL/Math.hpp>
+
+#include <vector>
+
+namespace KlayGE
+{
+	// A ray of a CPU scene query. It hits in [0, max_dist), in units of the length of dir.
+	struct KLAYGE_CORE_API SceneRay
+	{
+		float3 orig;
+		float3 dir;
+		float max_dist;
+	};
+
+	struct KLAYGE_CORE_API SceneRayHit
+	{
+		static uint32_t const INVALID_INDEX = 0xFFFFFFFFU;
+
+		// nullptr and INVALID_INDEX on a miss
+		SceneObject* obj;
+		uint32_t instance;
+		// The subrenderable and the triangle in it. Both are INVALID_INDEX when the object has no triangles to test,
+		// and its world bound is hit.
+		uint32_t mesh;
+		uint32_t triangle;
+		float dist;
+		// The hit point is v0 + u * (v1 - v0) + v * (v2 - v0)
+		float u;
+		float v;
+	};
+
+	// A node of the flattened BVHs. The left child of an inner node is the next node, the right one is first.
+	// Leaves have a count of primitives starting from first.
+	struct BVHNode
+	{
+		float bb_min[3];
+		uint32_t first;
+		float bb_max[3];
+		uint32_t count;
+	};
+
+	// A BVH over the triangles of a mesh, in its model space. It's built with binned SAH. A leaf holds up to 4
+	//   triangles, transposed so that a ray is tested against all of them at once.
+	class KLAYGE_CORE_API TriangleBVH : boost::noncopyable
+	{
+	public:
+		struct Hit
+		{
+			float dist;
+			uint32_t triangle;
+			float u;
+			float v;
+		};
+
+		// 4 rays in SoA. inv_dir never has a 0 in the denominator, so the slab tests have no NaN.
+		struct RayPacket
+		{
+			float orig[3][4];
+			float dir[3][4];
+			float inv_dir[3][4];
+		};
+
+	public:
+		// indices is a triangle list into positions
+		TriangleBVH(ArrayRef<float3> positions, ArrayRef<uint32_t> indices);
+
+		AABBox Bound() const;
+		uint32_t NumTriangles() const
+		{
+			return num_triangles_;
+		}
+		uint32_t NumNodes() const
+		{
+			return static_cast<uint32_t>(nodes_.size());
+		}
+
+		// Only hits closer than hit.dist count. hit is updated on a hit.
+		bool RayCast(float3 const & orig, float3 const & dir, Hit& hit) const;
+		// Same as above, with the inv_dir of a RayPacket lane
+		bool RayCast(float3 const & orig, float3 const & dir, float3 const & inv_dir, Hit& hit) const;
+		// Traverses the lanes in active_mask together. Returns the mask of lanes with a closer hit.
+		uint32_t RayCast(RayPacket const & packet, uint32_t active_mask, Hit* hits) const;
+
+	private:
+		struct TriangleQuad
+		{
+			float v0[3][4];
+			float e1[3][4];
+			float e2[3][4];
+			uint32_t triangles[4];
+		};
+
+		static bool IntersectQuad(TriangleQuad const & quad, float3 const & orig, float3 const & dir, Hit& hit);
+
+	private:
+		std::vector<BVHNode> nodes_;
+		std::vector<TriangleQuad> quads_;
+		uint32_t num_triangles_;
+	};
+
+	// The top level over scene objects, by their world bounds. Each object has the TriangleBVHs of its meshes.
+	//   Moving objects only need UpdateInstance and a Refit. Adding or removing objects needs a Build.
+	class KLAYGE_CORE_API SceneBVH : boost::noncopyable
+	{
+	public:
+		SceneBVH();
+
+		void Clear();
+		// meshes is indexed by the subrenderable, a nullptr skips it. An instance without any mesh BVH is hit at
+		// its bound.
+		uint32_t AddInstance(SceneObject* obj, AABBox const & bound_ws, float4x4 const & model,
+			ArrayRef<TriangleBVHPtr> meshes);
+		void UpdateInstance(uint32_t index, AABBox const & bound_ws, float4x4 const & model);
+		// Disabled instances are skipped by the queries
+		void EnableInstance(uint32_t index, bool enable);
+
+		uint32_t NumInstances() const
+		{
+			return static_cast<uint32_t>(instances_.size());
+		}
+		SceneObject* Object(uint32_t index) const
+		{
+			return instances_[index].obj;
+		}
+
+		void Build();
+		void Refit();
+
+		bool RayCast(SceneRay const & ray, SceneRayHit& hit) const;
+		// Rays are traversed 4 at a time. It's faster when the neighboring rays are coherent.
+		void RayCast(ArrayRef<SceneRay> rays, SceneRayHit* hits) const;
+		void Overlap(AABBox const & aabb, std::vector<uint32_t>& instances) const;
+
+	private:
+		struct Instance
+		{
+			SceneObject* obj;
+			AABBox bound_ws;
+			float4x4 inv_model;
+			uint32_t first_mesh;
+			uint32_t num_meshes;
+			bool has_triangles;
+			bool enabled;
+		};
+
+		void IntersectInstance(uint32_t index, SceneRay const & ray, float3 const & inv_dir, SceneRayHit& hit) const;
+
+	private:
+		std::vector<Instance> instances_;
+		std::vector<TriangleBVHPtr> meshes_;
+
+		std::vector<BVHNode> nodes_;
+		std::vector<uint32_t> leaf_instances_;
+	};
+}
+
+#endif		// _KLAYGE_SCENEQUERY_HPP
@@ -0,0 +1,136 @@
+/**
+* @file ShaderCache.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_SHADERCACHE_HPP
+#define _KLAYGE_SHADERCACHE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
+#include <KFL/CXX17/string_view.hpp>
+#include <KFL/Util.hpp>
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace KlayGE
+{
+	// Builds the 64-bit key of a shader cache entry, with FNV-1a over everything appended. Values are hashed
+	//   in little endian, so a key means the same on every platform.
+	class KLAYGE_CORE_API ShaderCacheKey
+	{
+	public:
+		ShaderCacheKey();
+
+		ShaderCacheKey& Append(void const * data, size_t size);
+		// The length goes in too, so "ab" + "c" is not the same key as "a" + "bc".
+		ShaderCacheKey& Append(std::string_view str);
+		ShaderCacheKey& Append(std::string const & str)
+		{
+			return this->Append(std::string_view(str));
+		}
+		ShaderCacheKey& Append(char const * str)
+		{
+			return this->Append(std::string_view(str));
+		}
+
+		template <typename T>
+		ShaderCacheKey& Append(T value)
+		{
+			static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "Only for arithmetic and enum types");
+
+			T const le = Native2LE(value);
+			return this->Append(&le, sizeof(le));
+		}
+
+		uint64_t Value() const
+		{
+			return hash_;
+		}
+
+	private:
+		uint64_t hash_;
+	};
+
+	// A persistent cache of compiled shaders. Each entry is a blob under a 64-bit key, in its own file in the
+	//   cache folder, with a header holding the key, the size and a checksum. Entries are written to a
+	//   temporary file and renamed into place, so an interrupted write never leaves a half file under a key.
+	//   A truncated or corrupt entry reads as a miss, and is removed.
+	//
+	// The cache doesn't know what's in the blobs. Everything an entry depends on, the source, the compiler
+	//   version, the options, the device, has to go into its key.
+	class KLAYGE_CORE_API ShaderCache : boost::noncopyable
+	{
+	public:
+		static uint32_t constexpr VERSION = 1;
+
+	public:
+		explicit ShaderCache(std::string const & folder);
+
+		std::string const & Folder() const
+		{
+			return folder_;
+		}
+
+		bool Load(uint64_t key, std::vector<uint8_t>& data);
+		bool Store(uint64_t key, ArrayRef<uint8_t> data);
+		void Remove(uint64_t key);
+		void Clear();
+
+		uint32_t NumHits() const
+		{
+			return num_hits_;
+		}
+		uint32_t NumMisses() const
+		{
+			return num_misses_;
+		}
+		uint32_t NumStores() const
+		{
+			return num_stores_;
+		}
+
+	private:
+		std::string EntryPath(uint64_t key) const;
+
+	private:
+		std::string folder_;
+
+		std::atomic<uint32_t> num_hits_;
+		std::atomic<uint32_t> num_misses_;
+		std::atomic<uint32_t> num_stores_;
+		std::atomic<uint32_t> tmp_index_;
+	};
+}
+
+#endif		// _KLAYGE_SHADERCACHE_HPP
@@ -339,6 +339,22 @@ namespace KlayGE
 		uint32_t src_width, uint32_t src_height, uint32_t src_depth,
 		bool linear);
 
+	enum MipmapFilter
+	{
+		MF_Box,
+		MF_Kaiser,
+		MF_Lanczos
+	};
+
+	// Build the mip chain of every array slice and cube face from its top level. Filtering is done in linear space, so sRGB
+	// formats are gamma-correct. If alpha_coverage_ref > 0, the alpha of each level is scaled to keep the alpha test coverage
+	// of the top level. num_mipmaps is 0 for a full chain, and returns the actual number of levels. dst_format can be
+	// a block compressed format.
+	KLAYGE_CORE_API void GenerateMipmaps(Texture::TextureType type, uint32_t width, uint32_t height, uint32_t depth,
+		uint32_t src_num_mipmaps, uint32_t array_size, ElementFormat src_format, ArrayRef<ElementInitData> src_init_data,
+		uint32_t& num_mipmaps, ElementFormat dst_format, MipmapFilter filter, float alpha_coverage_ref,
+		std::vector<ElementInitData>& dst_init_data, std::vector<uint8_t>& dst_data_block);
+
 	// return the lookat and up vector in cubemap view
 	//////////////////////////////////////////////////////////////////////////////////
 	template <typename T>
@@ -25,6 +25,7 @@
 #include <KlayGE/Input.hpp>
 
 #include <array>
+#include <unordered_map>
 
 #ifdef KLAYGE_COMPILER_MSVC
 #pragma warning(push)
@@ -150,7 +151,7 @@ namespace KlayGE
 					x_(0), y_(0), width_(0), height_(0),
 					dialog_(dialog), index_(0),
 					id_(0), type_(type), enabled_(true),
-					bounding_box_(0, 0, 0, 0)
+					bounding_box_(0, 0, 0, 0), dirty_(true)
 		{
 			BOOST_ASSERT(dialog);
 		}
@@ -167,11 +168,27 @@ namespace KlayGE
 			{
 				elements_[i]->Refresh();
 			}
+			this->SetDirty();
 		}
 
 
 		virtual void Render() = 0;
 
+		// A clean control isn't rendered, the UI manager replays what it drew last time.
+		// Anything changing the look of a control has to mark it dirty.
+		virtual bool Dirty() const
+		{
+			return dirty_;
+		}
+		void SetDirty()
+		{
+			dirty_ = true;
+		}
+		virtual void ClearDirty()
+		{
+			dirty_ = false;
+		}
+
 		virtual bool CanHaveFocus() const
 		{
 			return false;
@@ -183,18 +200,22 @@ namespace KlayGE
 		virtual void OnFocusIn()
 		{
 			has_focus_ = true;
+			this->SetDirty();
 		}
 		virtual void OnFocusOut()
 		{
 			has_focus_ = false;
+			this->SetDirty();
 		}
 		virtual void OnMouseEnter()
 		{
 			is_mouse_over_ = true;
+			this->SetDirty();
 		}
 		virtual void OnMouseLeave()
 		{
 			is_mouse_over_ = false;
+			this->SetDirty();
 		}
 		virtual void OnHotkey()
 		{
@@ -212,6 +233,7 @@ namespace KlayGE
 		virtual void SetEnabled(bool bEnabled)
 		{
 			enabled_ = bEnabled;
+			this->SetDirty();
 		}
 		virtual bool GetEnabled() const
 		{
@@ -220,6 +242,7 @@ namespace KlayGE
 		virtual void SetVisible(bool bVisible)
 		{
 			visible_ = bVisible;
+			this->SetDirty();
 		}
 		virtual bool GetVisible() const
 		{
@@ -269,6 +292,7 @@ namespace KlayGE
 			{
 				element->FontColor().States[UICS_Normal] = color;
 			}
+			this->SetDirty();
 		}
 		UIElement* GetElement(uint32_t iElement) const
 		{
@@ -284,6 +308,7 @@ namespace KlayGE
 
 			// Update the data
 			*elements_[iElement] = element;
+			this->SetDirty();
 		}
 
 		bool GetIsDefault() const
@@ -293,6 +318,7 @@ namespace KlayGE
 		void SetIsDefault(bool bIsDefault)
 		{
 			is_default_ = bIsDefault;
+			this->SetDirty();
 		}
 		uint32_t GetIndex() const
 		{
@@ -346,6 +372,7 @@ namespace KlayGE
 		virtual void UpdateRects()
 		{
 			bounding_box_ = IRect(x_, y_, x_ + width_, y_ + height_);
+			this->SetDirty();
 		}
 
 		int  id_;				// ID number
@@ -355,6 +382,8 @@ namespace KlayGE
 		bool enabled_;			// Enabled/disabled flag
 
 		IRect bounding_box_;		// Rectangle defining the active region of the control
+
+		bool dirty_;
 	};
 
 	class KLAYGE_CORE_API UIManager : boost::noncopyable, public std::enable_shared_from_this<UIManager>
@@ -423,6 +452,12 @@ namespace KlayGE
 		Size_T<float> CalcSize(std::wstring const & strText, uint32_t font_index,
 			IRect const & rc, uint32_t align);
 
+		// Everything drawn between BeginControl and EndControl is recorded for the control.
+		// ReplayControl draws the record of last frame again, without rendering the control.
+		void BeginControl();
+		void EndControl(UIControl& control, float depth_base);
+		bool ReplayControl(UIControl const & control, float depth_base);
+
 		IRect const & ElementTextureRect(uint32_t ctrl, uint32_t elem_index);
 		size_t NumElementTextureRect(uint32_t ctrl) const;
 
@@ -434,9 +469,17 @@ namespace KlayGE
 		}
 
 	private:
+		struct DrawCache;
+
 		void Init();
 		void InputHandler(InputEngine const & sender, InputAction const & action);
 
+		void AddToAtlas(TexturePtr const & texture);
+		std::vector<VertexFormat>& QuadBatch(TexturePtr const & texture, int2& atlas_offset);
+		void BeginDrawCache(DrawCache& cache);
+		void EndDrawCache(DrawCache& cache);
+		void SubmitDrawCache(DrawCache const & cache);
+
 	private:
 		static std::unique_ptr<UIManager> ui_mgr_instance_;
 
@@ -450,17 +493,53 @@ namespace KlayGE
 
 		std::array<std::vector<IRect >, UICT_Num_Control_Types> elem_texture_rcs_;
 
-		std::map<TexturePtr, RenderablePtr> rects_;
+		// Skin textures are packed into one atlas, so that a dialog is drawn in one batch.
+		TexturePtr atlas_tex_;
+		std::unordered_map<Texture const *, int2> atlas_offsets_;
+		uint32_t atlas_x_;
+		uint32_t atlas_y_;
+		uint32_t atlas_shelf_height_;
 
 		struct string_cache
 		{
+			size_t font_index;
 			Rect rc;
 			float depth;
 			Color clr;
 			std::wstring text;
 			uint32_t align;
 		};
-		std::map<size_t, std::vector<string_cache>> strings_;
+
+		struct QuadBatchCache
+		{
+			TexturePtr texture;
+			std::vector<VertexFormat> vertices;
+			std::vector<VertexFormat> recorded;
+			RenderablePtr renderable;
+		};
+
+		// Vertex range in each batch and string range a control drew
+		struct ControlRecord
+		{
+			std::vector<std::pair<size_t, size_t>> quads;
+			std::pair<size_t, size_t> strings;
+			float depth_base;
+		};
+
+		// What a dialog drew last frame, kept with its vertex buffers. Only the vertices that change get uploaded.
+		struct DrawCache
+		{
+			std::vector<QuadBatchCache> batches;
+			std::vector<string_cache> strings;
+
+			std::vector<string_cache> prev_strings;
+			std::unordered_map<UIControl const *, ControlRecord> controls;
+			std::unordered_map<UIControl const *, ControlRecord> prev_controls;
+		};
+		std::unordered_map<UIDialog const *, DrawCache> dialog_caches_;
+		DrawCache loose_cache_;		// Things drawn outside of UIDialog::Render
+		DrawCache* curr_cache_;
+		ControlRecord control_begin_;
 
 		bool mouse_on_ui_;
 		bool inited_;
@@ -518,6 +597,12 @@ namespace KlayGE
 
 		void ClearRadioButtonGroup(uint32_t nGroup);
 
+		// A dialog is rendered only if it or one of its controls is dirty
+		bool NeedsRender();
+		void SetDirty()
+		{
+			dirty_ = true;
+		}
 		void Render();
 
 		void RequestFocus(UIControl& control);
@@ -531,6 +616,7 @@ namespace KlayGE
 		void SetVisible(bool bVisible)
 		{
 			visible_ = bVisible;
+			this->SetDirty();
 		}
 		bool GetMinimized() const
 		{
@@ -539,6 +625,7 @@ namespace KlayGE
 		void SetMinimized(bool bMinimized)
 		{
 			minimized_ = bMinimized;
+			this->SetDirty();
 		}
 		void SetBackgroundColors(Color const & colorAllCorners);
 		void SetBackgroundColors(Color const & colorTopLeft, Color const & colorTopRight,
@@ -546,6 +633,7 @@ namespace KlayGE
 		void EnableCaption(bool bEnable)
 		{
 			show_caption_ = bEnable;
+			this->SetDirty();
 		}
 		bool IsCaptionEnabled() const
 		{
@@ -558,6 +646,7 @@ namespace KlayGE
 		void SetCaptionHeight(int nHeight)
 		{
 			caption_height_ = nHeight;
+			this->SetDirty();
 		}
 		void SetID(std::string const & id)
 		{
@@ -570,6 +659,7 @@ namespace KlayGE
 		void SetCaptionText(std::wstring const & strText)
 		{
 			caption_ = strText;
+			this->SetDirty();
 		}
 		int2 GetLocation() const
 		{
@@ -583,11 +673,13 @@ namespace KlayGE
 			bounding_box_.top() = y;
 			bounding_box_.right() = x + w;
 			bounding_box_.bottom() = y + h;
+			this->SetDirty();
 		}
 		void SetSize(int width, int height)
 		{
 			bounding_box_.right() = bounding_box_.left() + width;
 			bounding_box_.bottom() = bounding_box_.top() + height;
+			this->SetDirty();
 		}
 		int GetWidth() const
 		{
@@ -600,6 +692,7 @@ namespace KlayGE
 		void AlwaysInOpacity(bool opacity)
 		{
 			always_in_opacity_ = opacity;
+			this->SetDirty();
 		}
 		bool AlwaysInOpacity() const
 		{
@@ -663,6 +756,8 @@ namespace KlayGE
 		// Control events
 		bool OnCycleFocus(bool bForward);
 
+		void RenderControl(UIControl& control);
+
 		std::weak_ptr<UIControl> control_focus_;				// The control which has focus
 		std::weak_ptr<UIControl> control_mouse_over_;			// The control which is hovered over
 
@@ -691,6 +786,9 @@ namespace KlayGE
 		float depth_base_;
 		float opacity_;
 
+		bool dirty_;
+		float rendered_opacity_;
+
 		std::map<std::string, int> id_name_;
 		std::map<int, ControlLocation> id_location_;
 	};
@@ -1096,6 +1194,12 @@ namespace KlayGE
 		virtual void Render();
 		virtual void UpdateRects();
 
+		// Held arrows keep scrolling
+		virtual bool Dirty() const
+		{
+			return UIControl::Dirty() || (arrow_ != CLEAR);
+		}
+
 		void SetTrackRange(size_t nStart, size_t nEnd);
 		size_t GetTrackPos() const
 		{
@@ -1201,6 +1305,17 @@ namespace KlayGE
 		virtual void    Render();
 		virtual void    UpdateRects();
 
+		// The embedded scroll bar is rendered as a part of the list box
+		virtual bool Dirty() const
+		{
+			return UIControl::Dirty() || scroll_bar_.Dirty();
+		}
+		virtual void ClearDirty()
+		{
+			UIControl::ClearDirty();
+			scroll_bar_.ClearDirty();
+		}
+
 		STYLE GetStyle() const
 		{
 			return style_;
@@ -1212,6 +1327,7 @@ namespace KlayGE
 		void SetStyle(STYLE style)
 		{
 			style_ = style;
+			this->SetDirty();
 		}
 		int  GetScrollBarWidth() const
 		{
@@ -1226,6 +1342,7 @@ namespace KlayGE
 		{
 			border_ = border;
 			margin_ = margin;
+			this->SetDirty();
 		}
 		int AddItem(std::wstring const & strText);
 		void SetItemData(int nIndex, std::any const & data);
@@ -1317,6 +1434,17 @@ namespace KlayGE
 
 		virtual void UpdateRects();
 
+		// The embedded scroll bar is rendered as a part of the combo box
+		virtual bool Dirty() const
+		{
+			return UIControl::Dirty() || scroll_bar_.Dirty();
+		}
+		virtual void ClearDirty()
+		{
+			UIControl::ClearDirty();
+			scroll_bar_.ClearDirty();
+		}
+
 		int AddItem(std::wstring const & strText);
 		void SetItemData(int nIndex, std::any const & data);
 		int AddItem(std::wstring const & strText, std::any const & data);
@@ -1495,6 +1623,12 @@ namespace KlayGE
 		}
 		virtual void Render();
 
+		// The caret blinks while the edit box has focus
+		virtual bool Dirty() const
+		{
+			return UIControl::Dirty() || has_focus_;
+		}
+
 		void SetText(std::wstring const & wszText, bool bSelected = false);
 		std::wstring const & GetText() const
 		{
@@ -1508,18 +1642,22 @@ namespace KlayGE
 		virtual void SetTextColor(Color const & Color)
 		{
 			text_color_ = Color;	// Text color
+			this->SetDirty();
 		}
 		void SetSelectedTextColor(Color const & Color)
 		{
 			sel_text_color_ = Color;	// Selected text color
+			this->SetDirty();
 		}
 		void SetSelectedBackColor(Color const & Color)
 		{
 			sel_bk_color_ = Color;	// Selected background color
+			this->SetDirty();
 		}
 		void SetCaretColor(Color const & Color)
 		{
 			caret_color_ = Color;	// Caret color
+			this->SetDirty();
 		}
 		void SetBorderWidth(int nBorder)
 		{
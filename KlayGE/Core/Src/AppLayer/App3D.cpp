@@ -29,6 +29,7 @@
 #include <KFL/ErrorHandling.hpp>
 #include <KFL/Util.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/Log.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KlayGE/RenderEngine.hpp>
@@ -482,7 +483,8 @@ namespace KlayGE
 	App3DFramework::App3DFramework(std::string const & name)
 						: name_(name), total_num_frames_(0),
 							fps_(0), accumulate_time_(0), num_frames_(0),
-							app_time_(0), frame_time_(0)
+							app_time_(0), frame_time_(0),
+							pipelined_sim_(false), sim_time_(0), sim_job_time_(0), sim_alpha_(0), pending_sim_alpha_(0)
 	{
 		Context::Instance().AppInstance(*this);
 
@@ -500,7 +502,8 @@ namespace KlayGE
 	App3DFramework::App3DFramework(std::string const & name, void* native_wnd)
 						: name_(name), total_num_frames_(0),
 							fps_(0), accumulate_time_(0), num_frames_(0),
-							app_time_(0), frame_time_(0)
+							app_time_(0), frame_time_(0),
+							pipelined_sim_(false), sim_time_(0), sim_job_time_(0), sim_alpha_(0), pending_sim_alpha_(0)
 	{
 		Context::Instance().AppInstance(*this);
 
@@ -538,12 +541,19 @@ namespace KlayGE
 			cfg.graphics_cfg);
 		Context::Instance().Config(cfg);
 
+		frame_scheduler_.MaxFPS(cfg.max_fps);
+		frame_scheduler_.SimStep(cfg.sim_step);
+		frame_scheduler_.MaxSimSteps(cfg.max_sim_steps);
+		pipelined_sim_ = cfg.pipelined_sim;
+
 		this->OnCreate();
 		this->OnResize(cfg.graphics_cfg.width, cfg.graphics_cfg.height);
 	}
 
 	void App3DFramework::Destroy()
 	{
+		this->WaitForSimulation();
+
 		this->OnDestroy();
 		if (Context::Instance().RenderFactoryValid())
 		{
@@ -569,7 +579,86 @@ namespace KlayGE
 
 	void App3DFramework::Refresh()
 	{
+		frame_scheduler_.BeginFrame();
+		this->Simulate();
+
+		Timer render_timer;
 		Context::Instance().RenderFactoryInstance().RenderEngineInstance().Refresh();
+		frame_scheduler_.RecordRenderTime(static_cast<float>(render_timer.elapsed()));
+	}
+
+	void App3DFramework::Simulate()
+	{
+		uint32_t const num_steps = frame_scheduler_.NumSimSteps();
+		float const step_time = frame_scheduler_.StepTime();
+		if (pipelined_sim_)
+		{
+			// The steps started in the last frame ran together with its rendering. The rendering is a frame behind
+			// the simulation, and so is its alpha.
+			this->WaitForSimulation();
+			sim_alpha_ = pending_sim_alpha_;
+			pending_sim_alpha_ = frame_scheduler_.SimAlpha();
+
+			if (num_steps > 0)
+			{
+				sim_job_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+					[this, num_steps, step_time]
+					{
+						this->SimulateSteps(num_steps, step_time);
+					}));
+			}
+		}
+		else
+		{
+			this->SimulateSteps(num_steps, step_time);
+			frame_scheduler_.RecordSimTime(sim_job_time_);
+			sim_alpha_ = frame_scheduler_.SimAlpha();
+			this->DoPublishSimulation();
+		}
+	}
+
+	void App3DFramework::SimulateSteps(uint32_t num_steps, float step_time)
+	{
+		Timer timer;
+		for (uint32_t i = 0; i < num_steps; ++ i)
+		{
+			sim_time_ += step_time;
+			this->DoSimulate(sim_time_, step_time);
+		}
+		sim_job_time_ = static_cast<float>(timer.elapsed());
+	}
+
+	void App3DFramework::WaitForSimulation()
+	{
+		if (sim_job_)
+		{
+			(*sim_job_)();
+			sim_job_.reset();
+
+			frame_scheduler_.RecordSimTime(sim_job_time_);
+			this->DoPublishSimulation();
+		}
+	}
+
+	void App3DFramework::ReportFrameTimes() const
+	{
+		auto report = [](char const * name, FrameTimeHistogram const & histogram)
+			{
+				if (histogram.NumSamples() > 0)
+				{
+					LogInfo("%s times of %u frames (ms): mean %.2f, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f", name,
+						histogram.NumSamples(), histogram.Mean() * 1000, histogram.Percentile(0.5f) * 1000,
+						histogram.Percentile(0.95f) * 1000, histogram.Percentile(0.99f) * 1000, histogram.Max() * 1000);
+				}
+			};
+
+		report("Frame", frame_scheduler_.FrameTimes());
+		report("Simulation", frame_scheduler_.SimTimes());
+		report("Render", frame_scheduler_.RenderTimes());
+		if (frame_scheduler_.DroppedTime() > 0)
+		{
+			LogInfo("Simulation dropped %.2f s beyond max_sim_steps", frame_scheduler_.DroppedTime());
+		}
 	}
 
 	WindowPtr App3DFramework::MakeWindow(std::string const & name, RenderSettings const & settings)
@@ -612,8 +701,6 @@ namespace KlayGE
 	void App3DFramework::Run()
 #endif
 	{
-		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
-
 #if defined KLAYGE_PLATFORM_WINDOWS_DESKTOP
 		bool gotMsg;
 		MSG  msg;
@@ -640,7 +727,7 @@ namespace KlayGE
 			}
 			else
 			{
-				re.Refresh();
+				this->Refresh();
 			}
 		}
 #elif defined KLAYGE_PLATFORM_WINDOWS_STORE
@@ -659,7 +746,7 @@ namespace KlayGE
 			if (main_wnd_->Active())
 			{
 				dispatcher->ProcessEvents(CoreProcessEventsOption::CoreProcessEventsOption_ProcessAllIfPresent);
-				re.Refresh();
+				this->Refresh();
 			}
 			else
 			{
@@ -677,7 +764,7 @@ namespace KlayGE
 				main_wnd_->MsgProc(event);
 			} while(XPending(x_display));
 
-			re.Refresh();
+			this->Refresh();
 		}
 #elif defined KLAYGE_PLATFORM_ANDROID
 		while (!main_wnd_->Closed())
@@ -706,16 +793,22 @@ namespace KlayGE
 				}
 			} while (ident >= 0);
 
-			re.Refresh();
+			this->Refresh();
 		}
 #elif (defined KLAYGE_PLATFORM_DARWIN) || (defined KLAYGE_PLATFORM_IOS)
 		while (!main_wnd_->Closed())
 		{
 			Window::PumpEvents();
-			re.Refresh();
+			this->Refresh();
 		}
 #endif
 
+		this->WaitForSimulation();
+		if (Context::Instance().Config().perf_profiler)
+		{
+			this->ReportFrameTimes();
+		}
+
 		this->OnDestroy();
 	}
 
@@ -0,0 +1,204 @@
+/**
+* @file FrameScheduler.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <KlayGE/FrameScheduler.hpp>
+
+namespace
+{
+	// Sleeps can overshoot by a scheduler tick, so the last part of a wait spins
+	double const SPIN_TIME = 0.001;
+}
+
+namespace KlayGE
+{
+	uint32_t const FrameTimeHistogram::NUM_BINS;
+	float const FrameTimeHistogram::BIN_WIDTH = 1e-4f;
+
+	FrameTimeHistogram::FrameTimeHistogram()
+		: bins_(NUM_BINS, 0)
+	{
+		this->Reset();
+	}
+
+	void FrameTimeHistogram::Add(float seconds)
+	{
+		seconds = std::max(seconds, 0.0f);
+		uint32_t const bin = std::min(static_cast<uint32_t>(seconds / BIN_WIDTH), NUM_BINS - 1);
+		++ bins_[bin];
+		++ num_samples_;
+		sum_ += seconds;
+		max_ = std::max(max_, seconds);
+	}
+
+	void FrameTimeHistogram::Reset()
+	{
+		std::fill(bins_.begin(), bins_.end(), 0);
+		num_samples_ = 0;
+		sum_ = 0;
+		max_ = 0;
+	}
+
+	float FrameTimeHistogram::Mean() const
+	{
+		return (num_samples_ > 0) ? static_cast<float>(sum_ / num_samples_) : 0.0f;
+	}
+
+	float FrameTimeHistogram::Percentile(float p) const
+	{
+		if (0 == num_samples_)
+		{
+			return 0;
+		}
+
+		uint64_t const target = std::max<uint64_t>(static_cast<uint64_t>(MathLib::clamp(p, 0.0f, 1.0f) * num_samples_
+			+ 0.5f), 1);
+		uint64_t count = 0;
+		for (uint32_t i = 0; i < NUM_BINS - 1; ++ i)
+		{
+			count += bins_[i];
+			if (count >= target)
+			{
+				return std::min((i + 1) * BIN_WIDTH, max_);
+			}
+		}
+		return max_;
+	}
+
+
+	FrameScheduler::FrameScheduler()
+		: max_fps_(0), sim_step_(0), max_sim_steps_(8),
+			first_frame_(true), frame_time_(0), accumulator_(0), dropped_time_(0),
+			num_sim_steps_(0), step_time_(0), sim_alpha_(0)
+	{
+	}
+
+	void FrameScheduler::MaxFPS(float fps)
+	{
+		max_fps_ = std::max(fps, 0.0f);
+	}
+
+	void FrameScheduler::SimStep(float step)
+	{
+		sim_step_ = std::max(step, 0.0f);
+		accumulator_ = 0;
+	}
+
+	void FrameScheduler::MaxSimSteps(uint32_t steps)
+	{
+		max_sim_steps_ = std::max(steps, 1U);
+	}
+
+	float FrameScheduler::BeginFrame()
+	{
+		if (first_frame_)
+		{
+			first_frame_ = false;
+			timer_.restart();
+			this->Advance(0);
+			return 0;
+		}
+
+		if (max_fps_ > 0)
+		{
+			double const min_frame_time = 1.0 / max_fps_;
+			double const remaining = min_frame_time - timer_.elapsed();
+			if (remaining > SPIN_TIME)
+			{
+				Sleep(static_cast<uint32_t>((remaining - SPIN_TIME) * 1000));
+			}
+			while (timer_.elapsed() < min_frame_time)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		float const frame_time = static_cast<float>(timer_.elapsed());
+		timer_.restart();
+
+		frame_times_.Add(frame_time);
+		this->Advance(frame_time);
+
+		return frame_time;
+	}
+
+	void FrameScheduler::Advance(float frame_time)
+	{
+		frame_time_ = frame_time;
+
+		if (sim_step_ > 0)
+		{
+			accumulator_ += frame_time;
+
+			uint32_t const num_steps = static_cast<uint32_t>(accumulator_ / sim_step_);
+			num_sim_steps_ = std::min(num_steps, max_sim_steps_);
+			accumulator_ -= static_cast<double>(num_sim_steps_) * sim_step_;
+			if (num_steps > max_sim_steps_)
+			{
+				double const dropped = accumulator_ - std::fmod(accumulator_, static_cast<double>(sim_step_));
+				dropped_time_ += dropped;
+				accumulator_ -= dropped;
+			}
+
+			step_time_ = sim_step_;
+			sim_alpha_ = static_cast<float>(accumulator_ / sim_step_);
+		}
+		else
+		{
+			num_sim_steps_ = 1;
+			step_time_ = frame_time;
+			sim_alpha_ = 0;
+		}
+	}
+
+	void FrameScheduler::RecordSimTime(float seconds)
+	{
+		sim_times_.Add(seconds);
+	}
+
+	void FrameScheduler::RecordRenderTime(float seconds)
+	{
+		render_times_.Add(seconds);
+	}
+
+	void FrameScheduler::ResetStats()
+	{
+		frame_times_.Reset();
+		sim_times_.Reset();
+		render_times_.Reset();
+		dropped_time_ = 0;
+	}
+}
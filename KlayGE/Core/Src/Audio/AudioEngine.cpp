@@ -30,19 +30,25 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ErrorHandling.hpp>
+#include <KlayGE/Context.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
+#include <algorithm>
+#include <chrono>
+
 #include <KlayGE/Audio.hpp>
 
 namespace KlayGE
 {
 	AudioEngine::AudioEngine()
-		: sound_vol_(1), music_vol_(1)
+		: sound_vol_(1), music_vol_(1),
+			refilling_buffer_(nullptr), quit_streaming_(false)
 	{
 	}
 
 	AudioEngine::~AudioEngine()
 	{
+		this->ShutdownStreaming();
 	}
 
 	void AudioEngine::Suspend()
@@ -145,4 +151,142 @@ namespace KlayGE
 	{
 		return music_vol_;
 	}
+
+	void AudioEngine::StartStreaming(MusicBuffer& buffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(streaming_mutex_);
+
+			if (!streaming_thread_)
+			{
+				{
+					std::lock_guard<std::mutex> ready_lock(ready_mutex_);
+					quit_streaming_ = false;
+				}
+				streaming_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+					[this] { this->StreamingThreadFunc(); }));
+			}
+
+			if (std::find(streaming_buffers_.begin(), streaming_buffers_.end(), &buffer) == streaming_buffers_.end())
+			{
+				streaming_buffers_.push_back(&buffer);
+			}
+			buffer.streaming_engine_ = this;
+		}
+
+		this->NotifyStreaming(buffer);
+	}
+
+	void AudioEngine::StopStreaming(MusicBuffer& buffer)
+	{
+		std::unique_lock<std::mutex> lock(streaming_mutex_);
+
+		streaming_buffers_.erase(std::remove(streaming_buffers_.begin(), streaming_buffers_.end(), &buffer),
+			streaming_buffers_.end());
+		buffer.streaming_engine_ = nullptr;
+
+		// The buffer can be destroyed right after it stops, so its refill in flight has to finish first
+		refill_cond_.wait(lock, [this, &buffer] { return refilling_buffer_ != &buffer; });
+
+		std::lock_guard<std::mutex> ready_lock(ready_mutex_);
+		ready_buffers_.erase(std::remove(ready_buffers_.begin(), ready_buffers_.end(), &buffer), ready_buffers_.end());
+	}
+
+	void AudioEngine::NotifyStreaming(MusicBuffer& buffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(ready_mutex_);
+			if (std::find(ready_buffers_.begin(), ready_buffers_.end(), &buffer) == ready_buffers_.end())
+			{
+				ready_buffers_.push_back(&buffer);
+			}
+		}
+		ready_cond_.notify_one();
+	}
+
+	void AudioEngine::ShutdownStreaming()
+	{
+		{
+			std::lock_guard<std::mutex> lock(ready_mutex_);
+			quit_streaming_ = true;
+			ready_buffers_.clear();
+		}
+		ready_cond_.notify_one();
+
+		if (streaming_thread_)
+		{
+			(*streaming_thread_)();
+			streaming_thread_.reset();
+		}
+
+		std::lock_guard<std::mutex> lock(streaming_mutex_);
+		for (auto buffer : streaming_buffers_)
+		{
+			buffer->streaming_engine_ = nullptr;
+		}
+		streaming_buffers_.clear();
+	}
+
+	void AudioEngine::StreamingThreadFunc()
+	{
+		// Backends without a notification are polled twice per block, the same rate as their old per buffer threads
+		std::chrono::milliseconds const poll_period(1000 / MusicBuffer::BUFFERS_PER_SECOND / 2);
+
+		std::vector<MusicBuffer*> buffers;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(ready_mutex_);
+				ready_cond_.wait_for(lock, poll_period,
+					[this] { return quit_streaming_ || !ready_buffers_.empty(); });
+				if (quit_streaming_)
+				{
+					break;
+				}
+
+				buffers.swap(ready_buffers_);
+			}
+
+			if (buffers.empty())
+			{
+				std::lock_guard<std::mutex> lock(streaming_mutex_);
+				buffers = streaming_buffers_;
+			}
+
+			// The list is locked only to claim a buffer, so refilling and decoding never block the other threads
+			for (auto buffer : buffers)
+			{
+				{
+					std::lock_guard<std::mutex> lock(streaming_mutex_);
+
+					// Skips the ones stopped since the snapshot
+					if (std::find(streaming_buffers_.begin(), streaming_buffers_.end(), buffer) == streaming_buffers_.end())
+					{
+						continue;
+					}
+					refilling_buffer_ = buffer;
+				}
+
+				bool const more_data = buffer->RefillBuffers();
+				if (more_data)
+				{
+					buffer->DecodeAhead();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(streaming_mutex_);
+
+					if (!more_data)
+					{
+						streaming_buffers_.erase(std::remove(streaming_buffers_.begin(), streaming_buffers_.end(), buffer),
+							streaming_buffers_.end());
+						buffer->streaming_engine_ = nullptr;
+					}
+					refilling_buffer_ = nullptr;
+				}
+				refill_cond_.notify_all();
+			}
+			buffers.clear();
+		}
+	}
 }
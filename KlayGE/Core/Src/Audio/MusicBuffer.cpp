@@ -29,14 +29,47 @@
  */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioFactory.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
 #include <KlayGE/Audio.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	// Blocks decoded ahead on the streaming thread, so refilling a backend buffer never waits for the decoder
+	size_t constexpr READ_AHEAD_BLOCKS = 2;
+
+	uint32_t FrameSize(AudioFormat format)
+	{
+		switch (format)
+		{
+		case AF_Mono8:
+			return 1;
+
+		case AF_Mono16:
+		case AF_Stereo8:
+			return 2;
+
+		case AF_Stereo16:
+			return 4;
+
+		default:
+			KFL_UNREACHABLE("Invalid format");
+		}
+	}
+}
+
 namespace KlayGE
 {
 	MusicBuffer::MusicBuffer(AudioDataSourcePtr const & data_source)
-		: AudioBuffer(data_source)
+		: AudioBuffer(data_source),
+			streaming_engine_(nullptr),
+			block_size_(freq_ * FrameSize(format_) / BUFFERS_PER_SECOND),
+			data_end_(false)
 	{
 	}
 
@@ -64,10 +97,95 @@ namespace KlayGE
 
 	void MusicBuffer::Stop()
 	{
-		if (this->IsPlaying())
+		bool const playing = this->IsPlaying();
+		// A buffer ended by the streaming thread isn't playing, but it still has to be stopped
+		this->DoStop();
+		if (playing)
+		{
+			this->RewindData();
+		}
+	}
+
+	void MusicBuffer::StartStreaming()
+	{
+		Context::Instance().AudioFactoryInstance().AudioEngineInstance().StartStreaming(*this);
+	}
+
+	void MusicBuffer::StopStreaming()
+	{
+		AudioEngine* engine = streaming_engine_;
+		if (engine != nullptr)
+		{
+			engine->StopStreaming(*this);
+		}
+	}
+
+	void MusicBuffer::NotifyStreaming()
+	{
+		AudioEngine* engine = streaming_engine_;
+		if (engine != nullptr)
+		{
+			engine->NotifyStreaming(*this);
+		}
+	}
+
+	std::vector<uint8_t> const & MusicBuffer::ReadBlock()
+	{
+		if (curr_block_.capacity() > 0)
+		{
+			free_blocks_.emplace_back();
+			free_blocks_.back().swap(curr_block_);
+		}
+
+		if (!decoded_blocks_.empty())
+		{
+			curr_block_.swap(decoded_blocks_.front());
+			decoded_blocks_.pop_front();
+		}
+		else if (!data_end_)
+		{
+			this->DecodeBlock(curr_block_);
+		}
+
+		return curr_block_;
+	}
+
+	void MusicBuffer::RewindData()
+	{
+		data_source_->Reset();
+		data_end_ = false;
+
+		for (auto& block : decoded_blocks_)
+		{
+			free_blocks_.emplace_back();
+			free_blocks_.back().swap(block);
+		}
+		decoded_blocks_.clear();
+		curr_block_.clear();
+	}
+
+	void MusicBuffer::DecodeAhead()
+	{
+		while (!data_end_ && (decoded_blocks_.size() < READ_AHEAD_BLOCKS))
+		{
+			decoded_blocks_.emplace_back();
+			this->DecodeBlock(decoded_blocks_.back());
+		}
+	}
+
+	void MusicBuffer::DecodeBlock(std::vector<uint8_t>& block)
+	{
+		if ((block.capacity() == 0) && !free_blocks_.empty())
+		{
+			block.swap(free_blocks_.back());
+			free_blocks_.pop_back();
+		}
+
+		block.resize(block_size_);
+		block.resize(data_source_->Read(block.data(), block.size()));
+		if (block.size() < block_size_)
 		{
-			this->DoStop();
-			data_source_->Reset();
+			data_end_ = true;
 		}
 	}
 }
@@ -259,6 +259,10 @@ namespace KlayGE
 		std::vector<std::pair<std::string, std::string>> graphics_options;
 		bool perf_profiler = false;
 		bool location_sensor = false;
+		float max_fps = 0;
+		float sim_step = 0;
+		uint32_t max_sim_steps = 8;
+		bool pipelined_sim = false;
 
 		std::string rf_name = "D3D11";
 		std::string af_name = "OpenAL";
@@ -331,6 +335,31 @@ namespace KlayGE
 				location_sensor = location_sensor_node->Attrib("enabled")->ValueInt() ? true : false;
 			}
 
+			XMLNodePtr frame_pacing_node = context_node->FirstNode("frame_pacing");
+			if (frame_pacing_node)
+			{
+				XMLAttributePtr attr = frame_pacing_node->Attrib("max_fps");
+				if (attr)
+				{
+					max_fps = attr->ValueFloat();
+				}
+				attr = frame_pacing_node->Attrib("sim_step");
+				if (attr)
+				{
+					sim_step = attr->ValueFloat();
+				}
+				attr = frame_pacing_node->Attrib("max_sim_steps");
+				if (attr)
+				{
+					max_sim_steps = attr->ValueUInt();
+				}
+				attr = frame_pacing_node->Attrib("pipelined");
+				if (attr)
+				{
+					pipelined_sim = attr->ValueInt() ? true : false;
+				}
+			}
+
 			XMLNodePtr frame_node = graphics_node->FirstNode("frame");
 			XMLAttributePtr attr;
 			attr = frame_node->Attrib("width");
@@ -705,6 +734,10 @@ namespace KlayGE
 		cfg_.deferred_rendering = false;
 		cfg_.perf_profiler = perf_profiler;
 		cfg_.location_sensor = location_sensor;
+		cfg_.max_fps = max_fps;
+		cfg_.sim_step = sim_step;
+		cfg_.max_sim_steps = max_sim_steps;
+		cfg_.pipelined_sim = pipelined_sim;
 	}
 
 	void Context::SaveCfg(std::string const & cfg_file)
@@ -750,6 +783,13 @@ namespace KlayGE
 			XMLNodePtr location_sensor_node = cfg_doc.AllocNode(XNT_Element, "location_sensor");
 			location_sensor_node->AppendAttrib(cfg_doc.AllocAttribInt("enabled", cfg_.location_sensor));
 			context_node->AppendNode(location_sensor_node);
+
+			XMLNodePtr frame_pacing_node = cfg_doc.AllocNode(XNT_Element, "frame_pacing");
+			frame_pacing_node->AppendAttrib(cfg_doc.AllocAttribFloat("max_fps", cfg_.max_fps));
+			frame_pacing_node->AppendAttrib(cfg_doc.AllocAttribFloat("sim_step", cfg_.sim_step));
+			frame_pacing_node->AppendAttrib(cfg_doc.AllocAttribUInt("max_sim_steps", cfg_.max_sim_steps));
+			frame_pacing_node->AppendAttrib(cfg_doc.AllocAttribInt("pipelined", cfg_.pipelined_sim));
+			context_node->AppendNode(frame_pacing_node);
 		}
 		root->AppendNode(context_node);
 
@@ -33,22 +33,92 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/Query.hpp>
 #include <KFL/Thread.hpp>
+#include <KFL/CXX17/iterator.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <iomanip>
+#include <unordered_map>
 
 #include <KlayGE/PerfProfiler.hpp>
 
 namespace
 {
+	using namespace KlayGE;
+
 	std::mutex singleton_mutex;
+	std::atomic<uint32_t> profiler_generation(0);
+
+	char const * counter_names[] =
+	{
+		"Draw calls",
+		"Dispatches",
+		"Resource loads",
+		"GPU allocations",
+		"Instance upload bytes",
+		"Scene lock waits",
+		"Dropped sub thread frames"
+	};
+	KLAYGE_STATIC_ASSERT(std::size(counter_names) == PCT_NumCounterTypes);
+
+	void WriteJsonString(std::ostream& os, std::string const & str)
+	{
+		os << '\"';
+		for (auto ch : str)
+		{
+			switch (ch)
+			{
+			case '\"':
+				os << "\\\"";
+				break;
+
+			case '\\':
+				os << "\\\\";
+				break;
+
+			default:
+				if (static_cast<unsigned char>(ch) < 0x20)
+				{
+					os << ' ';
+				}
+				else
+				{
+					os << ch;
+				}
+				break;
+			}
+		}
+		os << '\"';
+	}
 }
 
 namespace KlayGE
 {
+	// Retires the scope buffer of a thread when it exits
+	struct PerfThreadBufferOwner
+	{
+		uint32_t generation = ~0U;
+		PerfProfiler::ThreadScopeBuffer* buffer = nullptr;
+
+		~PerfThreadBufferOwner()
+		{
+			if (buffer != nullptr)
+			{
+				std::lock_guard<std::mutex> lock(singleton_mutex);
+				PerfProfiler* profiler = PerfProfiler::perf_profiler_instance_.get();
+				if (profiler && (profiler->generation_ == generation))
+				{
+					profiler->RetireThreadBuffer(buffer);
+				}
+			}
+		}
+	};
+	thread_local PerfThreadBufferOwner thread_buffer_owner;
+
 	std::unique_ptr<PerfProfiler> PerfProfiler::perf_profiler_instance_;
 
 	PerfRange::PerfRange()
-		: cpu_time_(0), gpu_time_(0), dirty_(false)
+		: cpu_begin_time_(0), cpu_time_(0), gpu_time_(0), dirty_(false)
 	{
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 		gpu_timer_query_ = rf.MakeTimerQuery();
@@ -60,6 +130,7 @@ namespace KlayGE
 		{
 			dirty_ = true;
 			cpu_timer_.restart();
+			cpu_begin_time_ = PerfProfiler::Instance().TimeStamp();
 			if (gpu_timer_query_)
 			{
 				gpu_timer_query_->Begin();
@@ -91,6 +162,11 @@ namespace KlayGE
 		}
 	}
 
+	double PerfRange::CPUBeginTime() const
+	{
+		return cpu_begin_time_;
+	}
+
 	double PerfRange::CPUTime() const
 	{
 		return cpu_time_;
@@ -107,8 +183,39 @@ namespace KlayGE
 	}
 
 
+	PerfScope::PerfScope(char const * name)
+		: profiler_(Context::Instance().Config().perf_profiler ? &PerfProfiler::Instance() : nullptr)
+	{
+		if (profiler_)
+		{
+			profiler_->BeginScope(name);
+		}
+	}
+
+	PerfScope::~PerfScope()
+	{
+		if (profiler_)
+		{
+			profiler_->EndScope();
+		}
+	}
+
+
 	PerfProfiler::PerfProfiler()
-		: frame_id_(0)
+		: generation_(++ profiler_generation),
+			frame_capacity_(DEFAULT_FRAME_CAPACITY), frame_id_(0),
+			next_thread_index_(0)
+	{
+		start_time_ = timer_.current_time();
+		frame_begin_time_ = 0;
+		frames_.resize(frame_capacity_);
+		for (auto& counter : counters_)
+		{
+			counter = 0;
+		}
+	}
+
+	PerfProfiler::~PerfProfiler()
 	{
 	}
 
@@ -125,6 +232,11 @@ namespace KlayGE
 		return *perf_profiler_instance_;
 	}
 
+	PerfProfiler* PerfProfiler::ExistingInstance()
+	{
+		return perf_profiler_instance_.get();
+	}
+
 	void PerfProfiler::Destroy()
 	{
 		std::lock_guard<std::mutex> lock(singleton_mutex);
@@ -139,11 +251,28 @@ namespace KlayGE
 	{
 	}
 
+	void PerfProfiler::FrameCapacity(uint32_t num_frames)
+	{
+		BOOST_ASSERT(num_frames > 0);
+
+		frame_capacity_ = num_frames;
+		frame_id_ = 0;
+		frames_.assign(frame_capacity_, PerfFrameRecord());
+
+		PerfRangeRecord empty_record;
+		empty_record.frame_id = ~0U;
+		for (auto& range : perf_ranges_)
+		{
+			std::get<3>(range).assign(frame_capacity_, empty_record);
+		}
+	}
+
 	PerfRangePtr PerfProfiler::CreatePerfRange(int category, std::string const & name)
 	{
 		PerfRangePtr range = MakeSharedPtr<PerfRange>();
-		typedef std::remove_reference<decltype(std::get<3>(perf_ranges_[0]))>::type PerfDataType;
-		perf_ranges_.push_back(std::make_tuple(category, name, range, PerfDataType()));
+		PerfRangeRecord empty_record;
+		empty_record.frame_id = ~0U;
+		perf_ranges_.push_back(std::make_tuple(category, name, range, std::vector<PerfRangeRecord>(frame_capacity_, empty_record)));
 		return range;
 	}
 
@@ -155,20 +284,253 @@ namespace KlayGE
 			RenderEngine& re = rf.RenderEngineInstance();
 			re.UpdateGPUTimestampsFrequency();
 
+			uint32_t const frame_id = frame_id_;
+			uint32_t const slot = frame_id % frame_capacity_;
+
 			for (auto& range : perf_ranges_)
 			{
+				auto& record = std::get<3>(range)[slot];
 				if (std::get<2>(range)->Dirty())
 				{
 					std::get<2>(range)->CollectData();
-					std::get<3>(range).push_back(std::make_tuple(frame_id_,
-						std::get<2>(range)->CPUTime(), std::get<2>(range)->GPUTime()));
+					record.frame_id = frame_id;
+					record.cpu_begin_time = std::get<2>(range)->CPUBeginTime();
+					record.cpu_time = std::get<2>(range)->CPUTime();
+					record.gpu_time = std::get<2>(range)->GPUTime();
+				}
+				else
+				{
+					record.frame_id = ~0U;
 				}
 			}
 
+			double const now = this->TimeStamp();
+
+			auto& frame = frames_[slot];
+			frame.frame_id = frame_id;
+			frame.begin_time = frame_begin_time_;
+			frame.end_time = now;
+			for (uint32_t i = 0; i < PCT_NumCounterTypes; ++ i)
+			{
+				frame.counters[i] = counters_[i].exchange(0, std::memory_order_relaxed);
+			}
+
+			frame_begin_time_ = now;
 			++ frame_id_;
+
+			this->ReleaseRetiredThreadBuffers();
+		}
+	}
+
+	void PerfProfiler::BeginScope(char const * name)
+	{
+		auto& buffer = this->CurrentThreadBuffer();
+		if (buffer.depth < buffer.stack.size())
+		{
+			buffer.stack[buffer.depth] = std::make_pair(name, this->TimeStamp());
+		}
+		++ buffer.depth;
+	}
+
+	void PerfProfiler::EndScope()
+	{
+		auto& buffer = this->CurrentThreadBuffer();
+		if (buffer.depth > 0)
+		{
+			-- buffer.depth;
+			if (buffer.depth < buffer.stack.size())
+			{
+				uint64_t const head = buffer.head.load(std::memory_order_relaxed);
+				auto& event = buffer.events[head & (SCOPE_EVENT_CAPACITY - 1)];
+				event.name = buffer.stack[buffer.depth].first;
+				event.begin_time = buffer.stack[buffer.depth].second;
+				event.end_time = this->TimeStamp();
+				event.frame_id = frame_id_.load(std::memory_order_relaxed);
+				event.depth = buffer.depth;
+				buffer.head.store(head + 1, std::memory_order_release);
+			}
 		}
 	}
 
+	double PerfProfiler::TimeStamp() const
+	{
+		return timer_.current_time() - start_time_;
+	}
+
+	PerfProfiler::ThreadScopeBuffer& PerfProfiler::CurrentThreadBuffer()
+	{
+		if ((thread_buffer_owner.generation != generation_) || !thread_buffer_owner.buffer)
+		{
+			auto buffer = MakeUniquePtr<ThreadScopeBuffer>();
+			buffer->events.resize(SCOPE_EVENT_CAPACITY);
+			buffer->head = 0;
+			buffer->depth = 0;
+			buffer->retired = false;
+			buffer->retired_frame = 0;
+
+			std::lock_guard<std::mutex> lock(thread_buffers_mutex_);
+			buffer->thread_index = next_thread_index_;
+			++ next_thread_index_;
+			thread_buffer_owner.generation = generation_;
+			thread_buffer_owner.buffer = buffer.get();
+			thread_buffers_.push_back(std::move(buffer));
+		}
+		return *thread_buffer_owner.buffer;
+	}
+
+	void PerfProfiler::RetireThreadBuffer(ThreadScopeBuffer* buffer)
+	{
+		std::lock_guard<std::mutex> lock(thread_buffers_mutex_);
+		buffer->retired = true;
+		buffer->retired_frame = frame_id_;
+	}
+
+	void PerfProfiler::ReleaseRetiredThreadBuffers()
+	{
+		uint32_t const frame_id = frame_id_;
+
+		std::lock_guard<std::mutex> lock(thread_buffers_mutex_);
+		thread_buffers_.erase(std::remove_if(thread_buffers_.begin(), thread_buffers_.end(),
+			[this, frame_id](std::unique_ptr<ThreadScopeBuffer> const & buffer)
+			{
+				return buffer->retired && (frame_id - buffer->retired_frame >= frame_capacity_);
+			}), thread_buffers_.end());
+	}
+
+	uint32_t PerfProfiler::NumFramesKept() const
+	{
+		return std::min(frame_id_.load(), frame_capacity_);
+	}
+
+	void PerfProfiler::CollectScopeEvents(std::vector<std::pair<uint32_t, PerfScopeEvent>>& events, double since_time) const
+	{
+		std::vector<PerfScopeEvent> thread_events;
+
+		std::lock_guard<std::mutex> lock(thread_buffers_mutex_);
+		for (auto const & buffer : thread_buffers_)
+		{
+			uint64_t const head = buffer->head.load(std::memory_order_acquire);
+			uint64_t const tail = (head > SCOPE_EVENT_CAPACITY) ? head - SCOPE_EVENT_CAPACITY : 0;
+			thread_events.clear();
+			for (uint64_t i = tail; i < head; ++ i)
+			{
+				thread_events.push_back(buffer->events[i & (SCOPE_EVENT_CAPACITY - 1)]);
+			}
+
+			// The owning thread may have lapped the ring while copying. Drop anything it could have overwritten,
+			// including the slot at new_head, which it could be writing right now.
+			uint64_t const new_head = buffer->head.load(std::memory_order_acquire);
+			size_t first = 0;
+			if (new_head - tail >= SCOPE_EVENT_CAPACITY)
+			{
+				first = static_cast<size_t>(std::min<uint64_t>(new_head - tail - SCOPE_EVENT_CAPACITY + 1, thread_events.size()));
+			}
+
+			for (size_t i = first; i < thread_events.size(); ++ i)
+			{
+				if (thread_events[i].begin_time >= since_time)
+				{
+					events.emplace_back(buffer->thread_index, thread_events[i]);
+				}
+			}
+		}
+	}
+
+	PerfFrameSummary PerfProfiler::Summary(uint32_t num_frames) const
+	{
+		PerfFrameSummary summary;
+		summary.num_frames = std::min(num_frames, this->NumFramesKept());
+		summary.avg_frame_time = 0;
+		summary.max_frame_time = 0;
+		summary.avg_counters.fill(0);
+
+		uint32_t const last_frame = frame_id_;
+		uint32_t const first_frame = last_frame - summary.num_frames;
+		double since_time = std::numeric_limits<double>::max();
+		for (uint32_t f = first_frame; f != last_frame; ++ f)
+		{
+			auto const & frame = frames_[f % frame_capacity_];
+			double const frame_time = frame.end_time - frame.begin_time;
+			summary.avg_frame_time += frame_time;
+			summary.max_frame_time = std::max(summary.max_frame_time, frame_time);
+			for (uint32_t i = 0; i < PCT_NumCounterTypes; ++ i)
+			{
+				summary.avg_counters[i] += frame.counters[i];
+			}
+			since_time = std::min(since_time, frame.begin_time);
+		}
+
+		for (auto const & range : perf_ranges_)
+		{
+			PerfRangeSummary range_summary;
+			range_summary.category = std::get<0>(range);
+			range_summary.name = std::get<1>(range);
+			range_summary.avg_cpu_time = 0;
+			range_summary.max_cpu_time = 0;
+			range_summary.avg_gpu_time = 0;
+
+			uint32_t count = 0;
+			for (uint32_t f = first_frame; f != last_frame; ++ f)
+			{
+				auto const & record = std::get<3>(range)[f % frame_capacity_];
+				if (record.frame_id == f)
+				{
+					range_summary.avg_cpu_time += record.cpu_time;
+					range_summary.max_cpu_time = std::max(range_summary.max_cpu_time, record.cpu_time);
+					range_summary.avg_gpu_time += record.gpu_time;
+					++ count;
+				}
+			}
+			if (count > 0)
+			{
+				range_summary.avg_cpu_time /= count;
+				range_summary.avg_gpu_time /= count;
+				summary.ranges.push_back(range_summary);
+			}
+		}
+
+		if (summary.num_frames > 0)
+		{
+			summary.avg_frame_time /= summary.num_frames;
+			for (auto& counter : summary.avg_counters)
+			{
+				counter /= summary.num_frames;
+			}
+
+			std::vector<std::pair<uint32_t, PerfScopeEvent>> events;
+			this->CollectScopeEvents(events, since_time);
+
+			std::unordered_map<std::string, size_t> scope_indices;
+			for (auto const & event : events)
+			{
+				std::string name = event.second.name;
+				auto iter = scope_indices.find(name);
+				if (iter == scope_indices.end())
+				{
+					iter = scope_indices.emplace(name, summary.scopes.size()).first;
+					PerfScopeSummary scope_summary;
+					scope_summary.name = std::move(name);
+					scope_summary.count = 0;
+					scope_summary.avg_time = 0;
+					scope_summary.max_time = 0;
+					summary.scopes.push_back(scope_summary);
+				}
+
+				auto& scope_summary = summary.scopes[iter->second];
+				double const time = event.second.end_time - event.second.begin_time;
+				++ scope_summary.count;
+				scope_summary.avg_time += time;
+				scope_summary.max_time = std::max(scope_summary.max_time, time);
+			}
+			for (auto& scope_summary : summary.scopes)
+			{
+				scope_summary.avg_time /= scope_summary.count;
+			}
+		}
+
+		return summary;
+	}
+
 	void PerfProfiler::ExportToCSV(std::string const & file_name) const
 	{
 		if (Context::Instance().Config().perf_profiler)
@@ -177,15 +539,23 @@ namespace KlayGE
 			ofs << "Frame" << ',' << "Category" << ',' << "Name" << ','
 				<< "CPU Timing (ms)" << ',' << "GPU Timing (ms)" << std::endl;
 
+			uint32_t const last_frame = frame_id_;
+			uint32_t const first_frame = last_frame - this->NumFramesKept();
 			for (auto const & range : perf_ranges_)
 			{
-				for (auto const & data : std::get<3>(range))
+				for (uint32_t f = first_frame; f != last_frame; ++ f)
 				{
-					ofs << std::get<0>(data) << ',' << std::get<0>(range) << ',' << std::get<1>(range) << ','
-						<< std::get<1>(data) * 1000 << ',';
-					if (std::get<2>(data) >= 0)
+					auto const & data = std::get<3>(range)[f % frame_capacity_];
+					if (data.frame_id != f)
+					{
+						continue;
+					}
+
+					ofs << data.frame_id << ',' << std::get<0>(range) << ',' << std::get<1>(range) << ','
+						<< data.cpu_time * 1000 << ',';
+					if (data.gpu_time >= 0)
 					{
-						ofs << std::get<2>(data) * 1000;
+						ofs << data.gpu_time * 1000;
 					}
 					ofs << std::endl;
 				}
@@ -194,4 +564,95 @@ namespace KlayGE
 			ofs << std::endl;
 		}
 	}
+
+	void PerfProfiler::ExportToChromeTrace(std::string const & file_name, double window_seconds) const
+	{
+		if (!Context::Instance().Config().perf_profiler)
+		{
+			return;
+		}
+
+		uint32_t const last_frame = frame_id_;
+		uint32_t first_frame = last_frame - this->NumFramesKept();
+		if (window_seconds > 0)
+		{
+			double const window_begin = this->TimeStamp() - window_seconds;
+			while ((first_frame != last_frame) && (frames_[first_frame % frame_capacity_].begin_time < window_begin))
+			{
+				++ first_frame;
+			}
+		}
+		double const since_time = (first_frame != last_frame) ? frames_[first_frame % frame_capacity_].begin_time : 0;
+
+		std::vector<std::pair<uint32_t, PerfScopeEvent>> events;
+		this->CollectScopeEvents(events, since_time);
+
+		// Timestamps are in microseconds, with nanoseconds kept. Track 0 is the GPU, track 1 holds frames and perf ranges,
+		// and threads with scopes start from track 2.
+		std::ofstream ofs(file_name.c_str());
+		ofs << std::fixed << std::setprecision(3);
+		ofs << "{\"traceEvents\":[" << std::endl;
+		ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+		ofs << ',' << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"Frames\"}}";
+		{
+			std::lock_guard<std::mutex> lock(thread_buffers_mutex_);
+			for (auto const & buffer : thread_buffers_)
+			{
+				ofs << ',' << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->thread_index + 2
+					<< ",\"args\":{\"name\":\"Thread " << buffer->thread_index << "\"}}";
+			}
+		}
+
+		for (uint32_t f = first_frame; f != last_frame; ++ f)
+		{
+			auto const & frame = frames_[f % frame_capacity_];
+			ofs << ',' << std::endl << "{\"name\":\"Frame " << frame.frame_id << "\",\"cat\":\"Frame\",\"ph\":\"X\",\"pid\":0,\"tid\":1"
+				<< ",\"ts\":" << frame.begin_time * 1e6 << ",\"dur\":" << (frame.end_time - frame.begin_time) * 1e6 << '}';
+
+			ofs << ',' << std::endl << "{\"name\":\"Counters\",\"ph\":\"C\",\"pid\":0,\"ts\":" << frame.begin_time * 1e6 << ",\"args\":{";
+			for (uint32_t i = 0; i < PCT_NumCounterTypes; ++ i)
+			{
+				if (i != 0)
+				{
+					ofs << ',';
+				}
+				ofs << '\"' << counter_names[i] << "\":" << frame.counters[i];
+			}
+			ofs << "}}";
+
+			for (auto const & range : perf_ranges_)
+			{
+				auto const & data = std::get<3>(range)[f % frame_capacity_];
+				if (data.frame_id != f)
+				{
+					continue;
+				}
+
+				ofs << ',' << std::endl << "{\"name\":";
+				WriteJsonString(ofs, std::get<1>(range));
+				ofs << ",\"cat\":\"" << std::get<0>(range) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":1"
+					<< ",\"ts\":" << data.cpu_begin_time * 1e6 << ",\"dur\":" << data.cpu_time * 1e6 << '}';
+				if (data.gpu_time >= 0)
+				{
+					// GPU timer queries only give durations, so they are placed at the CPU submission time.
+					ofs << ',' << std::endl << "{\"name\":";
+					WriteJsonString(ofs, std::get<1>(range));
+					ofs << ",\"cat\":\"" << std::get<0>(range) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+						<< ",\"ts\":" << data.cpu_begin_time * 1e6 << ",\"dur\":" << data.gpu_time * 1e6 << '}';
+				}
+			}
+		}
+
+		for (auto const & event : events)
+		{
+			ofs << ',' << std::endl << "{\"name\":";
+			WriteJsonString(ofs, event.second.name);
+			ofs << ",\"cat\":\"Scope\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.first + 2
+				<< ",\"ts\":" << event.second.begin_time * 1e6
+				<< ",\"dur\":" << (event.second.end_time - event.second.begin_time) * 1e6
+				<< ",\"args\":{\"frame\":" << event.second.frame_id << ",\"depth\":" << event.second.depth << "}}";
+		}
+
+		ofs << std::endl << "]}" << std::endl;
+	}
 }
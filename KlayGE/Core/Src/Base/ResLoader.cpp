@@ -63,6 +63,7 @@
 #include <CoreFoundation/CoreFoundation.h>
 #endif
 
+#include <KlayGE/PerfProfiler.hpp>
 #include <KlayGE/ResLoader.hpp>
 
 namespace
@@ -506,6 +507,13 @@ namespace KlayGE
 			else
 			{
 				res = res_desc->CreateResource();
+
+#ifndef KLAYGE_SHIP
+				if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+				{
+					profiler->IncCounter(PCT_ResourceLoads);
+				}
+#endif
 			}
 
 			if (res_desc->HasSubThreadStage())
@@ -572,6 +580,13 @@ namespace KlayGE
 			}
 			else
 			{
+#ifndef KLAYGE_SHIP
+				if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+				{
+					profiler->IncCounter(PCT_ResourceLoads);
+				}
+#endif
+
 				if (res_desc->HasSubThreadStage())
 				{
 					res = res_desc->CreateResource();
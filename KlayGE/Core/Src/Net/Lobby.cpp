@@ -14,7 +14,6 @@
 #include <KlayGE/Player.hpp>
 
 #include <algorithm>
-#include <ctime>
 #include <cstring>
 
 #include <KlayGE/NetMsg.hpp>
@@ -22,6 +21,12 @@
 
 #ifndef KLAYGE_PLATFORM_WINDOWS_STORE
 
+namespace
+{
+	// Players not heard from for this many seconds are dropped
+	double const PLAYER_TIMEOUT = 20;
+}
+
 namespace KlayGE
 {
 	// 캯
@@ -42,7 +47,7 @@ namespace KlayGE
 	{
 		for (auto iter = players_.begin(); iter != players_.end(); ++ iter)
 		{
-			if (0 == std::memcmp(&addr, &(iter->second.addr), sizeof(addr)))
+			if ((iter->first != 0) && (0 == std::memcmp(&addr, &(iter->second.addr), sizeof(addr))))
 			{
 				return iter;
 			}
@@ -60,71 +65,122 @@ namespace KlayGE
 		this->MaxPlayers(maxPlayers);
 
 		this->socket_.Bind(TransAddr("", port));
+		// Wakes up at least every tick to send acks and retransmits
+		this->socket_.TimeOut(Net_Tick_Time);
+		timer_.restart();
 
 		sockaddr_in from;
-		char revBuf[Max_Buffer];
+		char revBuf[NetChannel::DEFAULT_MTU];
 		char sendBuf[Max_Buffer];
-		int numSend = 0;
+		std::vector<uint8_t> msg;
 		for (;;)
 		{
-			this->Receive(revBuf, sizeof(revBuf), from);
-
-			// ÿϢǰ涼1ֽڵϢ
-			char* revPtr(&revBuf[1]);
-			char* sendPtr(&sendBuf[1]);
-			sendBuf[0] = revBuf[0];
+			int const numRecv = this->Receive(revBuf, sizeof(revBuf), from);
+			double const now = timer_.elapsed();
+			if (numRecv > 0)
+			{
+				auto iter = this->ID(from);
+				if ((iter != players_.end()) && iter->second.channel->ReceivePacket(revBuf, numRecv, now))
+				{
+					iter->second.time = now;
+					// Quitting frees the slot, the rest of the messages are dropped
+					while ((iter->first != 0) && iter->second.channel->Receive(msg))
+					{
+						this->OnMessage(iter, msg, now, pro);
+					}
+				}
+				else
+				{
+					// ÿϢǰ涼1ֽڵϢ
+					// Before joining, and a join resent after its reply is lost, come as plain datagrams
+					int numSend = 0;
+					sendBuf[0] = revBuf[0];
+					switch (revBuf[0])
+					{
+					case MSG_JOIN:
+						this->OnJoin(&revBuf[1], &sendBuf[1], numSend, from, pro);
+						break;
+
+					case MSG_GETLOBBYINFO:
+						this->OnGetLobbyInfo(&sendBuf[1], numSend, pro);
+						break;
+
+					default:
+						pro.OnDefault(revBuf, Max_Buffer, sendBuf, numSend, from);
+						break;
+					}
+
+					if (numSend != 0)
+					{
+						socket_.SendTo(sendBuf, numSend + 1, from);
+					}
+				}
+			}
 
-			switch (revBuf[0])
+			// Ƿûʱ
+			for (auto iter = players_.begin(); iter != players_.end(); ++ iter)
 			{
-			case MSG_JOIN:
-				this->OnJoin(revPtr, sendPtr, numSend, from, pro);
-				break;
+				if (iter->first != 0)
+				{
+					if (now - iter->second.time >= PLAYER_TIMEOUT)
+					{
+						pro.OnQuit(iter->first);
+						iter->first = 0;
+						iter->second.channel.reset();
+					}
+					else
+					{
+						iter->second.channel->Update(now);
+					}
+				}
+			}
+		}
+	}
 
-			case MSG_QUIT:
-				this->OnQuit(this->ID(from), sendPtr, numSend, pro);
-				break;
+	void Lobby::OnMessage(PlayerAddrsIter iter, std::vector<uint8_t> const & msg, double now, Processor const & pro)
+	{
+		if (msg.empty())
+		{
+			return;
+		}
 
-			case MSG_GETLOBBYINFO:
-				this->OnGetLobbyInfo(sendPtr, numSend, pro);
-				break;
+		std::shared_ptr<NetChannel> channel = iter->second.channel;
 
-			case MSG_NOP:
-				this->OnNop(this->ID(from));
-				break;
+		char sendBuf[Max_Buffer];
+		int numSend = 0;
+		sendBuf[0] = msg[0];
+		switch (msg[0])
+		{
+		case MSG_QUIT:
+			this->OnQuit(iter, &sendBuf[1], numSend, pro);
+			break;
 
-			default:
-				pro.OnDefault(revBuf, sizeof(revBuf), sendBuf, numSend, from);
-				break;
-			}
+		case MSG_GETLOBBYINFO:
+			this->OnGetLobbyInfo(&sendBuf[1], numSend, pro);
+			break;
 
-			if (numSend != 0)
-			{
-				this->Send(sendBuf, numSend + 1, from);
-			}
+		case MSG_NOP:
+			this->OnNop(iter);
+			break;
 
-			// Ϣ
-			for (auto const & player : players_)
+		default:
 			{
-				auto const & msgs = player.second.msgs;
-				for (auto const & msg : msgs)
-				{
-					socket_.SendTo(&msg[0], static_cast<int>(msg.size()), player.second.addr);
-				}
+				char revBuf[Max_Buffer];
+				std::memset(revBuf, 0, sizeof(revBuf));
+				std::memcpy(revBuf, msg.data(), std::min(msg.size(), sizeof(revBuf)));
+				pro.OnDefault(revBuf, sizeof(revBuf), sendBuf, numSend, iter->second.addr);
 			}
+			break;
+		}
 
-			// Ƿûʱ
-			for (auto iter = players_.begin(); iter != players_.end();)
-			{
-				// 20
-				if (std::time(nullptr) - iter->second.time >= 20 * 1000)
-				{
-					iter = players_.erase(iter);
-				}
-				else
-				{
-					++ iter;
-				}
-			}
+		if (numSend != 0)
+		{
+			channel->Send(sendBuf, numSend + 1, true);
+		}
+		if (0 == iter->first)
+		{
+			// The slot is freed, acks the quit and sends the reply before dropping the channel
+			channel->Update(now);
 		}
 	}
 
@@ -201,9 +257,17 @@ namespace KlayGE
 
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
-	int Lobby::Send(void const * buf, int maxSize, sockaddr_in const & to)
+	int Lobby::Send(void const * buf, int maxSize, sockaddr_in const & to, bool reliable)
 	{
-		return this->socket_.SendTo(buf, maxSize, to);
+		auto iter = this->ID(to);
+		if (iter != players_.end())
+		{
+			return iter->second.channel->Send(buf, static_cast<uint32_t>(maxSize), reliable) ? maxSize : -1;
+		}
+		else
+		{
+			return this->socket_.SendTo(buf, maxSize, to);
+		}
 	}
 
 
@@ -213,8 +277,17 @@ namespace KlayGE
 		// ʽ:
 		//			Player		16 ֽ
 
+		// A join resent because the reply was lost gets the same slot
+		auto iter = this->ID(from);
+		if (iter != players_.end())
+		{
+			sendBuf[0] = static_cast<char>(iter->first);
+			numSend = 1;
+			return;
+		}
+
 		char id = 1;
-		auto iter = players_.begin();
+		iter = players_.begin();
 		for (; iter != this->players_.end(); ++ iter, ++ id)
 		{
 			if (0 == iter->first)
@@ -228,6 +301,11 @@ namespace KlayGE
 				iter->first			= id;
 				iter->second.name	= name;
 				iter->second.addr	= from;
+				iter->second.time	= timer_.elapsed();
+				iter->second.channel = MakeSharedPtr<NetChannel>([this, from](void const * packet, uint32_t size)
+					{
+						socket_.SendTo(packet, static_cast<int>(size), from);
+					});
 
 				pro.OnJoin(iter->first);
 				break;
@@ -235,16 +313,16 @@ namespace KlayGE
 		}
 
 		// ظʽ:
-		//			Player ID		1 ֽ
+		//			Player ID		1 ֽ, 0 ʾѾ
 
 		// Ѿ
 		if (iter == players_.end())
 		{
-			sendBuf[0] = 1;
+			sendBuf[0] = 0;
 		}
 		else
 		{
-			sendBuf[0] = 0;
+			sendBuf[0] = id;
 		}
 
 		numSend = 1;
@@ -285,7 +363,7 @@ namespace KlayGE
 	{
 		if (iter != this->players_.end())
 		{
-			iter->second.time = static_cast<uint32_t>(std::time(nullptr));
+			iter->second.time = timer_.elapsed();
 		}
 	}
 }
@@ -0,0 +1,676 @@
+/**
+* @file LobbyServer.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/NetChannel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include <KlayGE/NetMsg.hpp>
+#include <KlayGE/LobbyServer.hpp>
+
+#ifdef KLAYGE_PLATFORM_LINUX
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Datagrams received or sent by one system call
+	uint32_t constexpr BATCH_SIZE = 64;
+	uint32_t constexpr PACKET_SIZE = NetChannel::DEFAULT_MTU;
+	int constexpr SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+
+	// Players not heard from for this many seconds are dropped
+	double const PLAYER_TIMEOUT = 20;
+
+	uint64_t AddrKey(sockaddr_in const & addr)
+	{
+		return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+	}
+}
+
+namespace KlayGE
+{
+	struct LobbyServer::Shard
+	{
+		struct Slot
+		{
+			// 0 for a free slot
+			uint32_t id;
+			sockaddr_in addr;
+			double time;
+			bool touched;
+			std::unique_ptr<NetChannel> channel;
+		};
+
+		LobbyServer& server;
+		Processor const & pro;
+		uint32_t index;
+
+		int socket;
+		int epoll;
+		int wake_event;
+		std::atomic<bool> quit;
+		std::unique_ptr<joiner<void>> thread;
+
+		std::vector<Slot> slots;
+		std::vector<uint32_t> free_slots;
+		std::unordered_map<uint64_t, uint32_t> slot_of_addr;
+		// Slots that received packets or got messages to send in this round, their channels are updated right away
+		std::vector<uint32_t> touched_slots;
+		std::atomic<uint32_t> num_players;
+		std::vector<uint8_t> msg;
+
+		// Messages from LobbyServer::Send and Broadcast, on other threads. They are sent on the shard thread.
+		struct Outgoing
+		{
+			// 0 for all players
+			uint32_t id;
+			bool reliable;
+			std::vector<uint8_t> data;
+		};
+		std::mutex outgoing_mutex;
+		std::vector<Outgoing> outgoing;
+		std::vector<Outgoing> sending;
+
+		std::vector<uint8_t> recv_buffs;
+		std::array<mmsghdr, BATCH_SIZE> recv_msgs;
+		std::array<iovec, BATCH_SIZE> recv_iovs;
+		std::array<sockaddr_in, BATCH_SIZE> recv_addrs;
+
+		std::vector<uint8_t> send_buffs;
+		std::array<mmsghdr, BATCH_SIZE> send_msgs;
+		std::array<iovec, BATCH_SIZE> send_iovs;
+		std::array<sockaddr_in, BATCH_SIZE> send_addrs;
+		uint32_t num_sends;
+
+		std::atomic<uint64_t> num_packets_received;
+		std::atomic<uint64_t> num_packets_sent;
+
+		Timer timer;
+
+		Shard(LobbyServer& server, Processor const & pro, uint32_t index, uint32_t max_players,
+				uint16_t port, bool reuse_port)
+			: server(server), pro(pro), index(index), quit(false),
+				slots(max_players), num_players(0),
+				recv_buffs(BATCH_SIZE * PACKET_SIZE), send_buffs(BATCH_SIZE * PACKET_SIZE), num_sends(0),
+				num_packets_received(0), num_packets_sent(0)
+		{
+			free_slots.resize(max_players);
+			for (uint32_t i = 0; i < max_players; ++ i)
+			{
+				slots[i].id = 0;
+				slots[i].touched = false;
+				free_slots[i] = max_players - 1 - i;
+			}
+			slot_of_addr.reserve(max_players);
+			touched_slots.reserve(max_players);
+
+			std::memset(recv_msgs.data(), 0, sizeof(recv_msgs));
+			std::memset(send_msgs.data(), 0, sizeof(send_msgs));
+			for (uint32_t i = 0; i < BATCH_SIZE; ++ i)
+			{
+				recv_iovs[i].iov_base = &recv_buffs[i * PACKET_SIZE];
+				recv_iovs[i].iov_len = PACKET_SIZE;
+				recv_msgs[i].msg_hdr.msg_name = &recv_addrs[i];
+				recv_msgs[i].msg_hdr.msg_iov = &recv_iovs[i];
+				recv_msgs[i].msg_hdr.msg_iovlen = 1;
+
+				send_iovs[i].iov_base = &send_buffs[i * PACKET_SIZE];
+				send_msgs[i].msg_hdr.msg_name = &send_addrs[i];
+				send_msgs[i].msg_hdr.msg_namelen = sizeof(send_addrs[i]);
+				send_msgs[i].msg_hdr.msg_iov = &send_iovs[i];
+				send_msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+			Verify(socket != -1);
+			if (reuse_port)
+			{
+				int const on = 1;
+				Verify(setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != -1);
+			}
+			setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &SOCKET_BUFFER_SIZE, sizeof(SOCKET_BUFFER_SIZE));
+			setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &SOCKET_BUFFER_SIZE, sizeof(SOCKET_BUFFER_SIZE));
+			sockaddr_in const addr = TransAddr("", port);
+			Verify(::bind(socket, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) != -1);
+
+			wake_event = eventfd(0, EFD_NONBLOCK);
+			Verify(wake_event != -1);
+
+			epoll = epoll_create1(0);
+			Verify(epoll != -1);
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.fd = socket;
+			Verify(epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &ev) != -1);
+			ev.data.fd = wake_event;
+			Verify(epoll_ctl(epoll, EPOLL_CTL_ADD, wake_event, &ev) != -1);
+		}
+
+		~Shard()
+		{
+			this->Stop();
+
+			close(epoll);
+			close(wake_event);
+			close(socket);
+		}
+
+		uint16_t Port() const
+		{
+			sockaddr_in addr;
+			socklen_t len = sizeof(addr);
+			Verify(getsockname(socket, reinterpret_cast<sockaddr*>(&addr), &len) != -1);
+			return ntohs(addr.sin_port);
+		}
+
+		void Start()
+		{
+			thread = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+				[this] { this->Run(); }));
+		}
+
+		void Stop()
+		{
+			if (thread)
+			{
+				quit = true;
+				uint64_t const one = 1;
+				KFL_UNUSED(write(wake_event, &one, sizeof(one)));
+
+				(*thread)();
+				thread.reset();
+			}
+		}
+
+		void Run()
+		{
+			double const tick = Net_Tick_Time / 1000.0;
+			double last_tick = timer.elapsed();
+
+			std::array<epoll_event, 2> events;
+			while (!quit)
+			{
+				epoll_wait(epoll, events.data(), static_cast<int>(events.size()), Net_Tick_Time);
+				if (quit)
+				{
+					break;
+				}
+
+				this->ReceiveBatches();
+				this->SendOutgoing();
+
+				double const now = timer.elapsed();
+				for (auto const slot : touched_slots)
+				{
+					slots[slot].touched = false;
+					if (slots[slot].id != 0)
+					{
+						slots[slot].channel->Update(now);
+					}
+				}
+				touched_slots.clear();
+
+				if (now - last_tick >= tick)
+				{
+					this->Tick(now);
+					last_tick = now;
+				}
+
+				this->FlushSends();
+			}
+		}
+
+		void ReceiveBatches()
+		{
+			for (;;)
+			{
+				for (auto& recv_msg : recv_msgs)
+				{
+					recv_msg.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+				}
+
+				int const n = recvmmsg(socket, recv_msgs.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
+				if (n <= 0)
+				{
+					break;
+				}
+				num_packets_received += n;
+
+				double const now = timer.elapsed();
+				for (int i = 0; i < n; ++ i)
+				{
+					this->OnPacket(recv_addrs[i], &recv_buffs[i * PACKET_SIZE], recv_msgs[i].msg_len, now);
+				}
+
+				if (n < static_cast<int>(BATCH_SIZE))
+				{
+					break;
+				}
+			}
+		}
+
+		void QueueOutgoing(uint32_t id, void const * data, uint32_t size, bool reliable)
+		{
+			Outgoing out;
+			out.id = id;
+			out.reliable = reliable;
+			out.data.assign(static_cast<uint8_t const *>(data), static_cast<uint8_t const *>(data) + size);
+			{
+				std::lock_guard<std::mutex> lock(outgoing_mutex);
+				outgoing.push_back(std::move(out));
+			}
+
+			uint64_t const one = 1;
+			KFL_UNUSED(write(wake_event, &one, sizeof(one)));
+		}
+
+		void SendOutgoing()
+		{
+			uint64_t count;
+			KFL_UNUSED(read(wake_event, &count, sizeof(count)));
+
+			{
+				std::lock_guard<std::mutex> lock(outgoing_mutex);
+				sending.swap(outgoing);
+			}
+
+			for (auto const & out : sending)
+			{
+				if (0 == out.id)
+				{
+					for (uint32_t i = 0; i < slots.size(); ++ i)
+					{
+						this->SendToSlot(i, out);
+					}
+				}
+				else
+				{
+					// The player could have quit after the message was queued
+					uint32_t const slot_index = (out.id & 0xFFFFFF) - 1;
+					if ((slot_index < slots.size()) && (slots[slot_index].id == out.id))
+					{
+						this->SendToSlot(slot_index, out);
+					}
+				}
+			}
+			sending.clear();
+		}
+
+		void SendToSlot(uint32_t slot_index, Outgoing const & out)
+		{
+			Slot& slot = slots[slot_index];
+			if (slot.id != 0)
+			{
+				slot.channel->Send(out.data.data(), static_cast<uint32_t>(out.data.size()), out.reliable);
+				if (!slot.touched)
+				{
+					slot.touched = true;
+					touched_slots.push_back(slot_index);
+				}
+			}
+		}
+
+		void OnPacket(sockaddr_in const & from, uint8_t const * data, uint32_t size, double now)
+		{
+			auto iter = slot_of_addr.find(AddrKey(from));
+			if ((iter != slot_of_addr.end()) && slots[iter->second].channel->ReceivePacket(data, size, now))
+			{
+				uint32_t const slot_index = iter->second;
+				Slot& slot = slots[slot_index];
+				slot.time = now;
+
+				// Quitting frees the slot, the rest of the messages are dropped
+				while ((slot.id != 0) && slot.channel->Receive(msg))
+				{
+					this->OnMessage(slot_index, now);
+				}
+
+				if ((slot.id != 0) && !slot.touched)
+				{
+					slot.touched = true;
+					touched_slots.push_back(slot_index);
+				}
+			}
+			else if (size > 0)
+			{
+				// Before joining, and a join resent after its reply is lost, come as plain datagrams
+				switch (data[0])
+				{
+				case MSG_JOIN:
+					this->OnJoin(from, now);
+					break;
+
+				case MSG_GETLOBBYINFO:
+					{
+						char reply[19];
+						reply[0] = MSG_GETLOBBYINFO;
+						this->FillLobbyInfo(&reply[1]);
+						this->QueueSend(from, reply, sizeof(reply));
+					}
+					break;
+
+				default:
+					break;
+				}
+			}
+		}
+
+		void OnJoin(sockaddr_in const & from, double now)
+		{
+			// Reply:
+			//			MSG_JOIN		1 byte
+			//			Joined			1 byte, 0 for a full lobby
+			//			Player ID		4 bytes, little endian
+			// Lobby replies with the first 2 bytes only, Player tells them apart by the size.
+			char reply[6] = { MSG_JOIN, 0, 0, 0, 0, 0 };
+
+			uint64_t const key = AddrKey(from);
+			auto iter = slot_of_addr.find(key);
+			if (iter != slot_of_addr.end())
+			{
+				uint32_t const id = Native2LE(slots[iter->second].id);
+				reply[1] = 1;
+				std::memcpy(&reply[2], &id, sizeof(id));
+			}
+			else if (!free_slots.empty())
+			{
+				uint32_t const slot_index = free_slots.back();
+				free_slots.pop_back();
+
+				Slot& slot = slots[slot_index];
+				slot.id = (index << 24) | (slot_index + 1);
+				slot.addr = from;
+				slot.time = now;
+				slot.channel = MakeUniquePtr<NetChannel>([this, slot_index](void const * packet, uint32_t size)
+					{
+						this->QueueSend(slots[slot_index].addr, packet, size);
+					});
+				slot_of_addr.emplace(key, slot_index);
+				++ num_players;
+
+				pro.OnJoin(slot.id);
+
+				uint32_t const id = Native2LE(slot.id);
+				reply[1] = 1;
+				std::memcpy(&reply[2], &id, sizeof(id));
+			}
+
+			this->QueueSend(from, reply, sizeof(reply));
+		}
+
+		void OnMessage(uint32_t slot_index, double now)
+		{
+			if (msg.empty())
+			{
+				return;
+			}
+
+			Slot& slot = slots[slot_index];
+
+			char sendBuf[Max_Buffer];
+			int numSend = 0;
+			sendBuf[0] = msg[0];
+			switch (msg[0])
+			{
+			case MSG_QUIT:
+				sendBuf[1] = 0;
+				numSend = 1;
+				break;
+
+			case MSG_GETLOBBYINFO:
+				this->FillLobbyInfo(&sendBuf[1]);
+				numSend = 18;
+				break;
+
+			case MSG_NOP:
+				break;
+
+			default:
+				{
+					char revBuf[Max_Buffer];
+					std::memset(revBuf, 0, sizeof(revBuf));
+					std::memcpy(revBuf, msg.data(), std::min<size_t>(msg.size(), sizeof(revBuf)));
+					pro.OnDefault(revBuf, sizeof(revBuf), sendBuf, numSend, slot.addr);
+				}
+				break;
+			}
+
+			if (numSend != 0)
+			{
+				slot.channel->Send(sendBuf, numSend + 1, true);
+			}
+
+			if (MSG_QUIT == msg[0])
+			{
+				// Acks the quit and sends the reply before dropping the channel
+				slot.channel->Update(now);
+				pro.OnQuit(slot.id);
+				this->FreeSlot(slot_index);
+			}
+		}
+
+		void FillLobbyInfo(char* info)
+		{
+			// Lobby info:
+			//			Num players		1 byte
+			//			Max players		1 byte
+			//			Lobby name		16 bytes
+			std::memset(info, 0, 18);
+			info[0] = static_cast<char>(std::min(server.NumPlayer(), 127U));
+			info[1] = static_cast<char>(std::min(server.MaxPlayers(), 127U));
+			server.LobbyName().copy(&info[2], std::min<size_t>(server.LobbyName().length(), 16));
+		}
+
+		void Tick(double now)
+		{
+			for (uint32_t i = 0; i < slots.size(); ++ i)
+			{
+				Slot& slot = slots[i];
+				if (slot.id != 0)
+				{
+					if (now - slot.time >= PLAYER_TIMEOUT)
+					{
+						pro.OnQuit(slot.id);
+						this->FreeSlot(i);
+					}
+					else
+					{
+						slot.channel->Update(now);
+					}
+				}
+			}
+		}
+
+		void FreeSlot(uint32_t slot_index)
+		{
+			Slot& slot = slots[slot_index];
+			slot_of_addr.erase(AddrKey(slot.addr));
+			slot.channel.reset();
+			slot.id = 0;
+			free_slots.push_back(slot_index);
+			-- num_players;
+		}
+
+		void QueueSend(sockaddr_in const & to, void const * data, uint32_t size)
+		{
+			BOOST_ASSERT(size <= PACKET_SIZE);
+
+			if (num_sends == BATCH_SIZE)
+			{
+				this->FlushSends();
+			}
+
+			std::memcpy(&send_buffs[num_sends * PACKET_SIZE], data, size);
+			send_iovs[num_sends].iov_len = size;
+			send_addrs[num_sends] = to;
+			++ num_sends;
+		}
+
+		void FlushSends()
+		{
+			uint32_t sent = 0;
+			while (sent < num_sends)
+			{
+				int const n = sendmmsg(socket, &send_msgs[sent], num_sends - sent, MSG_DONTWAIT);
+				if (n <= 0)
+				{
+					// The socket buffer is full. They are datagrams, the channels resend what matters.
+					break;
+				}
+				sent += n;
+			}
+			num_packets_sent += sent;
+			num_sends = 0;
+		}
+	};
+
+
+	LobbyServer::LobbyServer()
+		: port_(0)
+	{
+	}
+
+	LobbyServer::~LobbyServer()
+	{
+		this->Close();
+	}
+
+	void LobbyServer::Create(std::string const & name, uint32_t max_players_per_shard, uint16_t port, uint32_t num_shards,
+		Processor const & pro)
+	{
+		BOOST_ASSERT((num_shards > 0) && (num_shards <= 256));
+		BOOST_ASSERT(max_players_per_shard < (1UL << 24));
+
+		this->Close();
+
+		name_ = name.substr(0, 16);
+
+		// All the shards bind to the port picked by the first one
+		bool const reuse_port = num_shards > 1;
+		shards_.push_back(MakeUniquePtr<Shard>(*this, pro, 0, max_players_per_shard, port, reuse_port));
+		port_ = shards_[0]->Port();
+		for (uint32_t i = 1; i < num_shards; ++ i)
+		{
+			shards_.push_back(MakeUniquePtr<Shard>(*this, pro, i, max_players_per_shard, port_, reuse_port));
+		}
+
+		for (auto const & shard : shards_)
+		{
+			shard->Start();
+		}
+	}
+
+	void LobbyServer::Close()
+	{
+		for (auto const & shard : shards_)
+		{
+			shard->Stop();
+		}
+		shards_.clear();
+		port_ = 0;
+	}
+
+	uint32_t LobbyServer::NumPlayer() const
+	{
+		uint32_t n = 0;
+		for (auto const & shard : shards_)
+		{
+			n += shard->num_players;
+		}
+		return n;
+	}
+
+	uint32_t LobbyServer::MaxPlayers() const
+	{
+		uint32_t n = 0;
+		for (auto const & shard : shards_)
+		{
+			n += static_cast<uint32_t>(shard->slots.size());
+		}
+		return n;
+	}
+
+	bool LobbyServer::Send(uint32_t id, void const * buf, uint32_t size, bool reliable)
+	{
+		uint32_t const shard = id >> 24;
+		if ((0 == (id & 0xFFFFFF)) || (shard >= shards_.size()))
+		{
+			return false;
+		}
+
+		shards_[shard]->QueueOutgoing(id, buf, size, reliable);
+		return true;
+	}
+
+	void LobbyServer::Broadcast(void const * buf, uint32_t size, bool reliable)
+	{
+		for (auto const & shard : shards_)
+		{
+			shard->QueueOutgoing(0, buf, size, reliable);
+		}
+	}
+
+	uint64_t LobbyServer::NumPacketsReceived() const
+	{
+		uint64_t n = 0;
+		for (auto const & shard : shards_)
+		{
+			n += shard->num_packets_received;
+		}
+		return n;
+	}
+
+	uint64_t LobbyServer::NumPacketsSent() const
+	{
+		uint64_t n = 0;
+		for (auto const & shard : shards_)
+		{
+			n += shard->num_packets_sent;
+		}
+		return n;
+	}
+}
+
+#endif
@@ -0,0 +1,576 @@
+/**
+* @file NetChannel.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <KlayGE/NetChannel.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Packet header:
+	//			Protocol ID		2 bytes
+	//			Sequence		2 bytes
+	//			Ack				2 bytes
+	//			Ack bits		4 bytes
+	// Followed by messages:
+	//			Flags			1 byte
+	//			Size			2 bytes
+	//			ID				2 bytes, reliable only
+	//			Fragment		2 bytes, fragmented only
+	//			Num fragments	2 bytes, fragmented only
+	//			Data			Size bytes
+	uint16_t constexpr PROTOCOL_ID = 0x4B47;
+	uint32_t constexpr PACKET_HEADER_SIZE = 10;
+
+	uint8_t constexpr MF_Reliable = 1UL << 0;
+	uint8_t constexpr MF_Fragmented = 1UL << 1;
+	uint32_t constexpr MAX_MESSAGE_HEADER_SIZE = 9;
+
+	// The other end acks at most 33 packets with each of its packets, more in one update would be resent
+	uint32_t constexpr MAX_PACKETS_PER_UPDATE = 32;
+
+	double constexpr MIN_RTO = 0.02;
+	double constexpr MAX_RTO = 2.0;
+
+	// Buffers kept for reuse, the rest are freed
+	size_t constexpr MAX_FREE_BUFFERS = 1024;
+
+	static_assert(65536 % NetChannel::SEND_WINDOW == 0, "Message IDs must wrap around at a multiple of the window.");
+
+	uint32_t MessageHeaderSize(bool reliable, bool fragmented)
+	{
+		return 3 + (reliable ? 2 : 0) + (fragmented ? 4 : 0);
+	}
+
+	// Headers are little endian on the wire
+	void Write16(uint8_t* p, uint16_t v)
+	{
+		v = Native2LE(v);
+		std::memcpy(p, &v, sizeof(v));
+	}
+	void Write32(uint8_t* p, uint32_t v)
+	{
+		v = Native2LE(v);
+		std::memcpy(p, &v, sizeof(v));
+	}
+	uint16_t Read16(uint8_t const * p)
+	{
+		uint16_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return LE2Native(v);
+	}
+	uint32_t Read32(uint8_t const * p)
+	{
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return LE2Native(v);
+	}
+
+	// Sequence numbers wrap around, a is newer than b if it's less than half the range ahead
+	bool SequenceGreater(uint16_t a, uint16_t b)
+	{
+		return (a != b) && (static_cast<uint16_t>(a - b) < 0x8000);
+	}
+}
+
+namespace KlayGE
+{
+	std::vector<uint8_t> NetBufferPool::Allocate(size_t size)
+	{
+		std::vector<uint8_t> ret;
+		if (!free_buffs_.empty())
+		{
+			ret.swap(free_buffs_.back());
+			free_buffs_.pop_back();
+		}
+		ret.resize(size);
+		return ret;
+	}
+
+	void NetBufferPool::Free(std::vector<uint8_t>& buff)
+	{
+		if ((buff.capacity() > 0) && (free_buffs_.size() < MAX_FREE_BUFFERS))
+		{
+			free_buffs_.emplace_back();
+			free_buffs_.back().swap(buff);
+			free_buffs_.back().clear();
+		}
+		else
+		{
+			std::vector<uint8_t>().swap(buff);
+		}
+	}
+
+
+	NetChannel::NetChannel(SendFunc const & send_func, uint32_t mtu)
+		: send_func_(send_func), mtu_(std::min(mtu, 0xFFFFU)),
+			local_seq_(1), next_send_id_(0),
+			has_received_(false), remote_seq_(0), recv_bits_(0), ack_pending_(false), next_recv_id_(0),
+			curr_packet_(nullptr), last_send_time_(0), last_recv_time_(0),
+			srtt_(0.1), rttvar_(0.05), rto_(0.3),
+			num_packets_sent_(0), num_packets_received_(0), num_resent_(0)
+	{
+		BOOST_ASSERT(mtu_ > PACKET_HEADER_SIZE + MAX_MESSAGE_HEADER_SIZE);
+
+		for (auto& packet : sent_packets_)
+		{
+			packet.valid = false;
+		}
+		for (auto& unit : recv_units_)
+		{
+			unit.valid = false;
+		}
+		packet_.reserve(mtu_);
+	}
+
+	uint32_t NetChannel::MaxFragmentSize() const
+	{
+		return mtu_ - PACKET_HEADER_SIZE - MAX_MESSAGE_HEADER_SIZE;
+	}
+
+	bool NetChannel::Send(void const * data, uint32_t size, bool reliable)
+	{
+		if (!reliable)
+		{
+			if (size > mtu_ - PACKET_HEADER_SIZE - MessageHeaderSize(false, false))
+			{
+				return false;
+			}
+
+			unreliables_.push_back(pool_.Allocate(size));
+			std::memcpy(unreliables_.back().data(), data, size);
+			return true;
+		}
+
+		uint32_t const max_fragment_size = this->MaxFragmentSize();
+		uint32_t const num_fragments = std::max((size + max_fragment_size - 1) / max_fragment_size, 1U);
+		if (send_units_.size() + num_fragments > SEND_WINDOW)
+		{
+			return false;
+		}
+
+		uint8_t const * src = static_cast<uint8_t const *>(data);
+		for (uint32_t i = 0; i < num_fragments; ++ i)
+		{
+			uint32_t const offset = i * max_fragment_size;
+			uint32_t const fragment_size = std::min(size - offset, max_fragment_size);
+
+			send_units_.emplace_back();
+			SendUnit& unit = send_units_.back();
+			unit.id = next_send_id_;
+			unit.fragment = static_cast<uint16_t>(i);
+			unit.num_fragments = static_cast<uint16_t>(num_fragments);
+			unit.acked = false;
+			unit.send_time = -1;
+			unit.data = pool_.Allocate(fragment_size);
+			std::memcpy(unit.data.data(), src + offset, fragment_size);
+
+			++ next_send_id_;
+		}
+
+		return true;
+	}
+
+	void NetChannel::Update(double now)
+	{
+		uint64_t const first_packet = num_packets_sent_;
+		for (auto& unit : send_units_)
+		{
+			if (!unit.acked && ((unit.send_time < 0) || (now - unit.send_time >= rto_)))
+			{
+				if (!this->AppendMessage(unit.data.data(), static_cast<uint32_t>(unit.data.size()), true, unit.id,
+					unit.fragment, unit.num_fragments))
+				{
+					// The rest waits for the next update
+					if (num_packets_sent_ - first_packet + 1 >= MAX_PACKETS_PER_UPDATE)
+					{
+						break;
+					}
+
+					this->EndPacket(now);
+					this->AppendMessage(unit.data.data(), static_cast<uint32_t>(unit.data.size()), true, unit.id,
+						unit.fragment, unit.num_fragments);
+				}
+				curr_packet_->unit_ids.push_back(unit.id);
+				if (unit.send_time >= 0)
+				{
+					++ num_resent_;
+				}
+				unit.send_time = now;
+			}
+		}
+
+		for (auto& msg : unreliables_)
+		{
+			if (!this->AppendMessage(msg.data(), static_cast<uint32_t>(msg.size()), false, 0, 0, 1))
+			{
+				this->EndPacket(now);
+				this->AppendMessage(msg.data(), static_cast<uint32_t>(msg.size()), false, 0, 0, 1);
+			}
+			pool_.Free(msg);
+		}
+		unreliables_.clear();
+
+		if ((curr_packet_ == nullptr) && (ack_pending_ || (now - last_send_time_ >= KEEP_ALIVE_TIME)))
+		{
+			this->BeginPacket();
+		}
+		if (curr_packet_ != nullptr)
+		{
+			this->EndPacket(now);
+		}
+	}
+
+	void NetChannel::BeginPacket()
+	{
+		BOOST_ASSERT(nullptr == curr_packet_);
+
+		packet_.resize(PACKET_HEADER_SIZE);
+		Write16(&packet_[0], PROTOCOL_ID);
+		Write16(&packet_[2], local_seq_);
+		Write16(&packet_[4], remote_seq_);
+		Write32(&packet_[6], recv_bits_);
+
+		curr_packet_ = &sent_packets_[local_seq_ % PACKET_RING_SIZE];
+		curr_packet_->valid = true;
+		curr_packet_->acked = false;
+		curr_packet_->seq = local_seq_;
+		curr_packet_->unit_ids.clear();
+	}
+
+	void NetChannel::EndPacket(double now)
+	{
+		BOOST_ASSERT(curr_packet_ != nullptr);
+
+		curr_packet_->send_time = now;
+		send_func_(packet_.data(), static_cast<uint32_t>(packet_.size()));
+
+		curr_packet_ = nullptr;
+		++ local_seq_;
+		++ num_packets_sent_;
+		last_send_time_ = now;
+		ack_pending_ = false;
+	}
+
+	bool NetChannel::AppendMessage(void const * data, uint32_t size, bool reliable, uint16_t id,
+		uint16_t fragment, uint16_t num_fragments)
+	{
+		if (nullptr == curr_packet_)
+		{
+			this->BeginPacket();
+		}
+
+		bool const fragmented = num_fragments > 1;
+		uint32_t const header_size = MessageHeaderSize(reliable, fragmented);
+		size_t const offset = packet_.size();
+		if (offset + header_size + size > mtu_)
+		{
+			return false;
+		}
+
+		packet_.resize(offset + header_size + size);
+		uint8_t* p = &packet_[offset];
+		*p = static_cast<uint8_t>((reliable ? MF_Reliable : 0) | (fragmented ? MF_Fragmented : 0));
+		Write16(p + 1, static_cast<uint16_t>(size));
+		p += 3;
+		if (reliable)
+		{
+			Write16(p, id);
+			p += 2;
+		}
+		if (fragmented)
+		{
+			Write16(p, fragment);
+			Write16(p + 2, num_fragments);
+			p += 4;
+		}
+		if (size > 0)
+		{
+			std::memcpy(p, data, size);
+		}
+
+		return true;
+	}
+
+	bool NetChannel::ReceivePacket(void const * packet, uint32_t size, double now)
+	{
+		uint8_t const * p = static_cast<uint8_t const *>(packet);
+		if ((size < PACKET_HEADER_SIZE) || (Read16(p) != PROTOCOL_ID))
+		{
+			return false;
+		}
+
+		// Validates all the messages before touching any state
+		for (uint32_t offset = PACKET_HEADER_SIZE; offset < size;)
+		{
+			uint8_t const flags = p[offset];
+			uint32_t const header_size = MessageHeaderSize((flags & MF_Reliable) != 0, (flags & MF_Fragmented) != 0);
+			if ((offset + header_size > size) || ((flags & MF_Fragmented) && !(flags & MF_Reliable)))
+			{
+				return false;
+			}
+			if (flags & MF_Fragmented)
+			{
+				uint16_t const fragment = Read16(p + offset + 5);
+				uint16_t const num_fragments = Read16(p + offset + 7);
+				if ((fragment >= num_fragments) || (num_fragments > SEND_WINDOW))
+				{
+					return false;
+				}
+			}
+			offset += header_size + Read16(p + offset + 1);
+			if (offset > size)
+			{
+				return false;
+			}
+		}
+
+		uint16_t const seq = Read16(p + 2);
+		bool stale = false;
+		if (!has_received_)
+		{
+			has_received_ = true;
+			remote_seq_ = seq;
+			recv_bits_ = 0;
+		}
+		else if (SequenceGreater(seq, remote_seq_))
+		{
+			uint16_t const diff = static_cast<uint16_t>(seq - remote_seq_);
+			if (diff < 32)
+			{
+				recv_bits_ = (recv_bits_ << diff) | (1UL << (diff - 1));
+			}
+			else
+			{
+				recv_bits_ = (32 == diff) ? (1UL << 31) : 0;
+			}
+			remote_seq_ = seq;
+		}
+		else
+		{
+			uint16_t const diff = static_cast<uint16_t>(remote_seq_ - seq);
+			if (diff <= 32)
+			{
+				uint32_t const bit = (0 == diff) ? 0 : (1UL << (diff - 1));
+				if ((0 == diff) || (recv_bits_ & bit))
+				{
+					return true;
+				}
+				recv_bits_ |= bit;
+			}
+			else
+			{
+				// Too old to be acked or checked for duplicates. Reliable messages are deduplicated by ID,
+				//   unreliable ones are dropped.
+				stale = true;
+			}
+		}
+
+		uint16_t const ack = Read16(p + 4);
+		uint32_t const ack_bits = Read32(p + 6);
+		this->OnAcked(ack, now);
+		for (uint32_t i = 0; i < 32; ++ i)
+		{
+			if (ack_bits & (1UL << i))
+			{
+				this->OnAcked(static_cast<uint16_t>(ack - i - 1), now);
+			}
+		}
+		while (!send_units_.empty() && send_units_.front().acked)
+		{
+			send_units_.pop_front();
+		}
+
+		for (uint32_t offset = PACKET_HEADER_SIZE; offset < size;)
+		{
+			uint8_t const flags = p[offset];
+			bool const reliable = (flags & MF_Reliable) != 0;
+			bool const fragmented = (flags & MF_Fragmented) != 0;
+			uint32_t const msg_size = Read16(p + offset + 1);
+			uint8_t const * data = p + offset + MessageHeaderSize(reliable, fragmented);
+
+			if (reliable)
+			{
+				uint16_t const id = Read16(p + offset + 3);
+				uint16_t fragment = 0;
+				uint16_t num_fragments = 1;
+				if (fragmented)
+				{
+					fragment = Read16(p + offset + 5);
+					num_fragments = Read16(p + offset + 7);
+				}
+				this->OnReliable(id, fragment, num_fragments, data, msg_size);
+			}
+			else if (!stale)
+			{
+				delivered_.push_back(pool_.Allocate(msg_size));
+				if (msg_size > 0)
+				{
+					std::memcpy(delivered_.back().data(), data, msg_size);
+				}
+			}
+
+			offset += MessageHeaderSize(reliable, fragmented) + msg_size;
+		}
+		this->DeliverReliables();
+
+		last_recv_time_ = now;
+		ack_pending_ = true;
+		++ num_packets_received_;
+
+		return true;
+	}
+
+	bool NetChannel::Receive(std::vector<uint8_t>& msg)
+	{
+		if (delivered_.empty())
+		{
+			return false;
+		}
+
+		pool_.Free(msg);
+		msg.swap(delivered_.front());
+		delivered_.pop_front();
+		return true;
+	}
+
+	void NetChannel::OnAcked(uint16_t seq, double now)
+	{
+		SentPacket& packet = sent_packets_[seq % PACKET_RING_SIZE];
+		if (!packet.valid || (packet.seq != seq) || packet.acked)
+		{
+			return;
+		}
+		packet.acked = true;
+
+		// Packets are never resent, so every ack gives an unambiguous round trip sample
+		double const sample = now - packet.send_time;
+		rttvar_ = 0.75 * rttvar_ + 0.25 * std::abs(srtt_ - sample);
+		srtt_ = 0.875 * srtt_ + 0.125 * sample;
+		rto_ = std::min(std::max(srtt_ + 4 * rttvar_, MIN_RTO), MAX_RTO);
+
+		if (!send_units_.empty())
+		{
+			uint16_t const first_id = send_units_.front().id;
+			for (auto const id : packet.unit_ids)
+			{
+				uint16_t const index = static_cast<uint16_t>(id - first_id);
+				if (index < send_units_.size())
+				{
+					SendUnit& unit = send_units_[index];
+					if (!unit.acked)
+					{
+						unit.acked = true;
+						pool_.Free(unit.data);
+					}
+				}
+			}
+		}
+	}
+
+	void NetChannel::OnReliable(uint16_t id, uint16_t fragment, uint16_t num_fragments,
+		uint8_t const * data, uint32_t size)
+	{
+		// Older ones are delivered already
+		if (static_cast<uint16_t>(id - next_recv_id_) >= SEND_WINDOW)
+		{
+			return;
+		}
+
+		RecvUnit& unit = recv_units_[id % SEND_WINDOW];
+		if (!unit.valid)
+		{
+			unit.valid = true;
+			unit.fragment = fragment;
+			unit.num_fragments = num_fragments;
+			unit.data = pool_.Allocate(size);
+			if (size > 0)
+			{
+				std::memcpy(unit.data.data(), data, size);
+			}
+		}
+	}
+
+	void NetChannel::DeliverReliables()
+	{
+		for (;;)
+		{
+			RecvUnit& first = recv_units_[next_recv_id_ % SEND_WINDOW];
+			if (!first.valid)
+			{
+				break;
+			}
+
+			if (first.num_fragments <= 1)
+			{
+				delivered_.emplace_back();
+				delivered_.back().swap(first.data);
+				first.valid = false;
+				++ next_recv_id_;
+				continue;
+			}
+
+			// Fragments of a message have consecutive IDs. It's delivered once all of them are here.
+			uint32_t const num_fragments = first.num_fragments;
+			size_t total_size = 0;
+			for (uint32_t i = 0; i < num_fragments; ++ i)
+			{
+				RecvUnit const & unit = recv_units_[(next_recv_id_ + i) % SEND_WINDOW];
+				if (!unit.valid)
+				{
+					return;
+				}
+				total_size += unit.data.size();
+			}
+
+			std::vector<uint8_t> msg = pool_.Allocate(total_size);
+			size_t offset = 0;
+			for (uint32_t i = 0; i < num_fragments; ++ i)
+			{
+				RecvUnit& unit = recv_units_[(next_recv_id_ + i) % SEND_WINDOW];
+				if (!unit.data.empty())
+				{
+					std::memcpy(&msg[offset], unit.data.data(), unit.data.size());
+					offset += unit.data.size();
+				}
+				pool_.Free(unit.data);
+				unit.valid = false;
+			}
+			delivered_.push_back(std::move(msg));
+			next_recv_id_ = static_cast<uint16_t>(next_recv_id_ + num_fragments);
+		}
+	}
+}
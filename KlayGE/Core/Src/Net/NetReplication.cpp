@@ -0,0 +1,811 @@
+/**
+* @file NetReplication.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/SceneObject.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include <KlayGE/NetReplication.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t constexpr ROTATION_COMPONENT_BITS = 10;
+	uint32_t constexpr ROTATION_COMPONENT_MAX = (1UL << ROTATION_COMPONENT_BITS) - 1;
+	uint32_t constexpr POSITION_BITS = 24;
+	uint32_t constexpr SCALE_BITS = 20;
+	float constexpr SCALE_PRECISION = 1.0f / 1024;
+	uint32_t constexpr SEQ_BITS = 16;
+	uint32_t constexpr ID_BITS_BITS = 5;
+	uint32_t constexpr AGE_BITS = 4;
+
+	// 2 bits for the width, then the zigzag encoded value
+	uint32_t constexpr DELTA_WIDTHS[] = { 0, 6, 12, 26 };
+
+	int32_t ClampSigned(float v, uint32_t bits)
+	{
+		float const max_value = static_cast<float>((1L << (bits - 1)) - 1);
+		return static_cast<int32_t>(MathLib::clamp(std::round(v), -max_value, max_value));
+	}
+
+	void WriteSigned(BitWriter& writer, int32_t value, uint32_t bits)
+	{
+		writer.Write(static_cast<uint32_t>(value) & ((1UL << bits) - 1), bits);
+	}
+
+	int32_t ReadSigned(BitReader& reader, uint32_t bits)
+	{
+		uint32_t const value = reader.Read(bits);
+		uint32_t const sign = 1UL << (bits - 1);
+		return static_cast<int32_t>((value ^ sign) - sign);
+	}
+
+	void WriteDelta(BitWriter& writer, int32_t delta)
+	{
+		uint32_t const zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+		uint32_t width = 0;
+		while ((DELTA_WIDTHS[width] < 32) && (zigzag >> DELTA_WIDTHS[width]) != 0)
+		{
+			++ width;
+		}
+		BOOST_ASSERT(width < std::size(DELTA_WIDTHS));
+
+		writer.Write(width, 2);
+		writer.Write(zigzag, DELTA_WIDTHS[width]);
+	}
+
+	int32_t ReadDelta(BitReader& reader)
+	{
+		uint32_t const zigzag = reader.Read(DELTA_WIDTHS[reader.Read(2)]);
+		return static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+	}
+
+	uint32_t RotationComponent(uint32_t packed, uint32_t index)
+	{
+		return (packed >> ((2 - index) * ROTATION_COMPONENT_BITS)) & ROTATION_COMPONENT_MAX;
+	}
+
+	QuantizedTransform IdentityTransform(float position_precision)
+	{
+		return QuantizeTransform(float3(0, 0, 0), Quaternion::Identity(), float3(1, 1, 1), position_precision);
+	}
+
+	bool SeqNewer(uint16_t lhs, uint16_t rhs)
+	{
+		return static_cast<int16_t>(lhs - rhs) > 0;
+	}
+}
+
+namespace KlayGE
+{
+	BitWriter::BitWriter()
+		: num_bits_(0)
+	{
+	}
+
+	void BitWriter::Reset()
+	{
+		bytes_.clear();
+		num_bits_ = 0;
+	}
+
+	void BitWriter::Write(uint32_t value, uint32_t bits)
+	{
+		BOOST_ASSERT(bits <= 32);
+
+		uint64_t v = value & ((1ULL << bits) - 1);
+		bytes_.resize((num_bits_ + bits + 7) / 8, 0);
+		while (bits > 0)
+		{
+			uint32_t const offset = num_bits_ & 7;
+			uint32_t const n = std::min(8 - offset, bits);
+			bytes_[num_bits_ / 8] |= static_cast<uint8_t>((v & ((1U << n) - 1)) << offset);
+			v >>= n;
+			bits -= n;
+			num_bits_ += n;
+		}
+	}
+
+	void BitWriter::Rewind(uint32_t num_bits)
+	{
+		BOOST_ASSERT(num_bits <= num_bits_);
+
+		num_bits_ = num_bits;
+		bytes_.resize((num_bits + 7) / 8);
+		if (num_bits & 7)
+		{
+			bytes_.back() &= static_cast<uint8_t>((1U << (num_bits & 7)) - 1);
+		}
+	}
+
+
+	BitReader::BitReader(void const * data, uint32_t size)
+		: data_(static_cast<uint8_t const *>(data)), num_bits_(size * 8), pos_(0), overflow_(false)
+	{
+	}
+
+	uint32_t BitReader::Read(uint32_t bits)
+	{
+		BOOST_ASSERT(bits <= 32);
+
+		if (pos_ + bits > num_bits_)
+		{
+			overflow_ = true;
+			pos_ = num_bits_;
+			return 0;
+		}
+
+		uint64_t value = 0;
+		uint32_t shift = 0;
+		while (shift < bits)
+		{
+			uint32_t const offset = pos_ & 7;
+			uint32_t const n = std::min(8 - offset, bits - shift);
+			value |= static_cast<uint64_t>((data_[pos_ / 8] >> offset) & ((1U << n) - 1)) << shift;
+			shift += n;
+			pos_ += n;
+		}
+		return static_cast<uint32_t>(value);
+	}
+
+
+	bool QuantizedTransform::operator==(QuantizedTransform const & rhs) const
+	{
+		return (pos[0] == rhs.pos[0]) && (pos[1] == rhs.pos[1]) && (pos[2] == rhs.pos[2])
+			&& (rot == rhs.rot)
+			&& (scale[0] == rhs.scale[0]) && (scale[1] == rhs.scale[1]) && (scale[2] == rhs.scale[2]);
+	}
+
+	uint32_t PackQuaternion(Quaternion const & rot)
+	{
+		Quaternion const q = MathLib::normalize(rot);
+
+		uint32_t largest = 0;
+		for (uint32_t i = 1; i < 4; ++ i)
+		{
+			if (std::abs(q[i]) > std::abs(q[largest]))
+			{
+				largest = i;
+			}
+		}
+
+		// q and -q are the same rotation
+		float const sign = (q[largest] < 0) ? -1.0f : 1.0f;
+		uint32_t packed = largest << (3 * ROTATION_COMPONENT_BITS);
+		uint32_t shift = 2 * ROTATION_COMPONENT_BITS;
+		for (uint32_t i = 0; i < 4; ++ i)
+		{
+			if (i != largest)
+			{
+				float const v = q[i] * sign * SQRT2 * 0.5f + 0.5f;
+				uint32_t const c = static_cast<uint32_t>(MathLib::clamp(std::round(v * ROTATION_COMPONENT_MAX),
+					0.0f, static_cast<float>(ROTATION_COMPONENT_MAX)));
+				packed |= c << shift;
+				shift -= ROTATION_COMPONENT_BITS;
+			}
+		}
+		return packed;
+	}
+
+	Quaternion UnpackQuaternion(uint32_t packed)
+	{
+		uint32_t const largest = packed >> (3 * ROTATION_COMPONENT_BITS);
+
+		Quaternion q;
+		float sum_sq = 0;
+		uint32_t index = 0;
+		for (uint32_t i = 0; i < 4; ++ i)
+		{
+			if (i != largest)
+			{
+				float const v = static_cast<float>(RotationComponent(packed, index)) / ROTATION_COMPONENT_MAX;
+				q[i] = (v * 2 - 1) / SQRT2;
+				sum_sq += q[i] * q[i];
+				++ index;
+			}
+		}
+		q[largest] = std::sqrt(std::max(1 - sum_sq, 0.0f));
+		return MathLib::normalize(q);
+	}
+
+	QuantizedTransform QuantizeTransform(float3 const & pos, Quaternion const & rot, float3 const & scale,
+		float position_precision)
+	{
+		QuantizedTransform qt;
+		for (uint32_t i = 0; i < 3; ++ i)
+		{
+			qt.pos[i] = ClampSigned(pos[i] / position_precision, POSITION_BITS);
+			qt.scale[i] = ClampSigned(scale[i] / SCALE_PRECISION, SCALE_BITS);
+		}
+		qt.rot = PackQuaternion(rot);
+		return qt;
+	}
+
+	void DequantizeTransform(float3& pos, Quaternion& rot, float3& scale, QuantizedTransform const & qt,
+		float position_precision)
+	{
+		for (uint32_t i = 0; i < 3; ++ i)
+		{
+			pos[i] = qt.pos[i] * position_precision;
+			scale[i] = qt.scale[i] * SCALE_PRECISION;
+		}
+		rot = UnpackQuaternion(qt.rot);
+	}
+
+
+	ReplicationServer::ReplicationServer(float position_precision)
+		: position_precision_(position_precision), relevance_radius_(50)
+	{
+	}
+
+	uint32_t ReplicationServer::Register(SceneObjectPtr const & so, uint32_t fields, float priority)
+	{
+		BOOST_ASSERT(so);
+
+		uint32_t id;
+		if (free_ids_.empty())
+		{
+			id = static_cast<uint32_t>(objects_.size());
+			objects_.emplace_back();
+			for (auto& client : clients_)
+			{
+				client.objects.emplace_back();
+			}
+		}
+		else
+		{
+			id = free_ids_.back();
+			free_ids_.pop_back();
+		}
+
+		Object& obj = objects_[id];
+		obj.so = so;
+		obj.fields = fields;
+		obj.priority = priority;
+		obj.pos = float3(0, 0, 0);
+		obj.state = IdentityTransform(position_precision_);
+		for (auto& client : clients_)
+		{
+			this->ResetClientObject(client.objects[id]);
+		}
+
+		return id;
+	}
+
+	void ReplicationServer::Unregister(uint32_t id)
+	{
+		BOOST_ASSERT((id < objects_.size()) && objects_[id].so);
+
+		objects_[id].so.reset();
+		free_ids_.push_back(id);
+
+		// Acks still to come mustn't make baselines for the next object with this ID
+		for (auto& client : clients_)
+		{
+			for (auto& sent : client.sent)
+			{
+				sent.entries.erase(std::remove_if(sent.entries.begin(), sent.entries.end(),
+					[id](std::pair<uint32_t, QuantizedTransform> const & entry)
+					{
+						return entry.first == id;
+					}), sent.entries.end());
+			}
+		}
+	}
+
+	uint32_t ReplicationServer::AddClient(uint32_t bytes_per_second)
+	{
+		uint32_t index = 0;
+		while ((index < clients_.size()) && clients_[index].valid)
+		{
+			++ index;
+		}
+		if (index == clients_.size())
+		{
+			clients_.emplace_back();
+		}
+
+		Client& client = clients_[index];
+		client.valid = true;
+		client.bytes_per_second = bytes_per_second;
+		client.credit = 0;
+		client.view_point = float3(0, 0, 0);
+		client.seq = 0;
+		client.objects.resize(objects_.size());
+		for (auto& co : client.objects)
+		{
+			this->ResetClientObject(co);
+		}
+		for (auto& sent : client.sent)
+		{
+			sent.valid = false;
+			sent.entries.clear();
+		}
+
+		return index;
+	}
+
+	void ReplicationServer::RemoveClient(uint32_t client)
+	{
+		BOOST_ASSERT(client < clients_.size());
+
+		clients_[client].valid = false;
+		clients_[client].objects.clear();
+	}
+
+	void ReplicationServer::ClientViewPoint(uint32_t client, float3 const & pos)
+	{
+		BOOST_ASSERT((client < clients_.size()) && clients_[client].valid);
+		clients_[client].view_point = pos;
+	}
+
+	void ReplicationServer::ClientBandwidth(uint32_t client, uint32_t bytes_per_second)
+	{
+		BOOST_ASSERT((client < clients_.size()) && clients_[client].valid);
+		clients_[client].bytes_per_second = bytes_per_second;
+	}
+
+	void ReplicationServer::RelevanceRadius(float radius)
+	{
+		relevance_radius_ = radius;
+	}
+
+	void ReplicationServer::Capture()
+	{
+		QuantizedTransform const identity = IdentityTransform(position_precision_);
+		for (auto& obj : objects_)
+		{
+			if (obj.so)
+			{
+				float3 scale;
+				Quaternion rot;
+				MathLib::decompose(scale, rot, obj.pos, obj.so->ModelMatrix());
+
+				// Fields not replicated stay at identity, so they never count as changes
+				obj.state = QuantizeTransform(obj.pos, rot, scale, position_precision_);
+				if (!(obj.fields & RF_Position))
+				{
+					std::memcpy(obj.state.pos, identity.pos, sizeof(obj.state.pos));
+				}
+				if (!(obj.fields & RF_Rotation))
+				{
+					obj.state.rot = identity.rot;
+				}
+				if (!(obj.fields & RF_Scale))
+				{
+					std::memcpy(obj.state.scale, identity.scale, sizeof(obj.state.scale));
+				}
+			}
+		}
+	}
+
+	void ReplicationServer::WriteSnapshot(uint32_t client_index, float elapsed_time, uint32_t max_size,
+		std::vector<uint8_t>& snapshot)
+	{
+		BOOST_ASSERT((client_index < clients_.size()) && clients_[client_index].valid);
+
+		Client& client = clients_[client_index];
+		client.credit = std::min(client.credit + client.bytes_per_second * elapsed_time, static_cast<float>(max_size));
+
+		++ client.seq;
+		uint16_t const seq = client.seq;
+		SentSnapshot& record = client.sent[seq % SENT_RING_SIZE];
+		record.valid = true;
+		record.seq = seq;
+		record.entries.clear();
+
+		float const r2 = relevance_radius_ * relevance_radius_;
+		candidates_.clear();
+		for (uint32_t id = 0; id < objects_.size(); ++ id)
+		{
+			Object const & obj = objects_[id];
+			if (!obj.so)
+			{
+				continue;
+			}
+
+			ClientObject& co = client.objects[id];
+			if (co.acked_valid && (static_cast<uint16_t>(seq - co.acked_seq) >= BASELINE_WINDOW))
+			{
+				// Checked every snapshot, so the age can't wrap around to look recent again
+				co.baseline_valid = false;
+			}
+
+			// Skips unchanged objects. What was sent last has to be that state too, or the client can be showing
+			//   a newer one, still to be acked.
+			if (co.acked_valid && (co.acked == obj.state) && (co.sent == obj.state))
+			{
+				continue;
+			}
+
+			float const dist_sq = MathLib::length_sq(obj.pos - client.view_point);
+			co.accum_priority += obj.priority * r2 / (r2 + dist_sq) * std::max(elapsed_time, 1e-3f);
+			candidates_.emplace_back(co.accum_priority, id);
+		}
+
+		uint32_t const id_bits = this->IDBits();
+		writer_.Reset();
+		writer_.Write(seq, SEQ_BITS);
+		writer_.Write(id_bits, ID_BITS_BITS);
+
+		// Leaves room for the end mark
+		int32_t const budget_bits = static_cast<int32_t>(std::max(client.credit, 0.0f) * 8) - 1;
+		uint32_t const min_entry_bits = 1 + id_bits + AGE_BITS + 3 + 2;
+		size_t const max_entries = std::min(candidates_.size(),
+			static_cast<size_t>(std::max(budget_bits, 0) / min_entry_bits + 1));
+		std::partial_sort(candidates_.begin(), candidates_.begin() + max_entries, candidates_.end(),
+			std::greater<std::pair<float, uint32_t>>());
+
+		for (size_t i = 0; i < max_entries; ++ i)
+		{
+			uint32_t const id = candidates_[i].second;
+			Object const & obj = objects_[id];
+			ClientObject& co = client.objects[id];
+			QuantizedTransform const & cur = obj.state;
+
+			uint32_t const mark = writer_.NumBits();
+
+			writer_.Write(1, 1);
+			writer_.Write(id, id_bits);
+			uint32_t const age = co.baseline_valid ? static_cast<uint16_t>(seq - co.acked_seq) : 0;
+			writer_.Write(age, AGE_BITS);
+			if (0 == age)
+			{
+				writer_.Write((obj.fields & RF_Position) ? 1 : 0, 1);
+				if (obj.fields & RF_Position)
+				{
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						WriteSigned(writer_, cur.pos[j], POSITION_BITS);
+					}
+				}
+				writer_.Write((obj.fields & RF_Rotation) ? 1 : 0, 1);
+				if (obj.fields & RF_Rotation)
+				{
+					writer_.Write(cur.rot, 32);
+				}
+				writer_.Write((obj.fields & RF_Scale) ? 1 : 0, 1);
+				if (obj.fields & RF_Scale)
+				{
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						WriteSigned(writer_, cur.scale[j], SCALE_BITS);
+					}
+				}
+			}
+			else
+			{
+				QuantizedTransform const & base = co.acked;
+
+				bool const pos_changed = (cur.pos[0] != base.pos[0]) || (cur.pos[1] != base.pos[1])
+					|| (cur.pos[2] != base.pos[2]);
+				writer_.Write(pos_changed ? 1 : 0, 1);
+				if (pos_changed)
+				{
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						WriteDelta(writer_, cur.pos[j] - base.pos[j]);
+					}
+				}
+
+				bool const rot_changed = (cur.rot != base.rot);
+				writer_.Write(rot_changed ? 1 : 0, 1);
+				if (rot_changed)
+				{
+					// The components only line up if the largest one is the same
+					bool const same_largest = (cur.rot >> (3 * ROTATION_COMPONENT_BITS))
+						== (base.rot >> (3 * ROTATION_COMPONENT_BITS));
+					writer_.Write(same_largest ? 1 : 0, 1);
+					if (same_largest)
+					{
+						for (uint32_t j = 0; j < 3; ++ j)
+						{
+							WriteDelta(writer_, static_cast<int32_t>(RotationComponent(cur.rot, j))
+								- static_cast<int32_t>(RotationComponent(base.rot, j)));
+						}
+					}
+					else
+					{
+						writer_.Write(cur.rot, 32);
+					}
+				}
+
+				bool const scale_changed = (cur.scale[0] != base.scale[0]) || (cur.scale[1] != base.scale[1])
+					|| (cur.scale[2] != base.scale[2]);
+				writer_.Write(scale_changed ? 1 : 0, 1);
+				if (scale_changed)
+				{
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						WriteDelta(writer_, cur.scale[j] - base.scale[j]);
+					}
+				}
+			}
+
+			if (static_cast<int32_t>(writer_.NumBits()) > budget_bits)
+			{
+				writer_.Rewind(mark);
+				break;
+			}
+
+			co.accum_priority = 0;
+			co.sent = cur;
+			record.entries.emplace_back(id, cur);
+		}
+
+		writer_.Write(0, 1);
+
+		snapshot = writer_.Bytes();
+		client.credit -= snapshot.size();
+	}
+
+	void ReplicationServer::OnAck(uint32_t client_index, uint16_t seq)
+	{
+		BOOST_ASSERT((client_index < clients_.size()) && clients_[client_index].valid);
+
+		Client& client = clients_[client_index];
+		SentSnapshot& record = client.sent[seq % SENT_RING_SIZE];
+		if (!record.valid || (record.seq != seq))
+		{
+			return;
+		}
+
+		for (auto const & entry : record.entries)
+		{
+			ClientObject& co = client.objects[entry.first];
+			if (!co.acked_valid || SeqNewer(seq, co.acked_seq))
+			{
+				co.acked = entry.second;
+				co.acked_seq = seq;
+				co.acked_valid = true;
+				co.baseline_valid = (static_cast<uint16_t>(client.seq - seq) < BASELINE_WINDOW);
+			}
+		}
+		record.valid = false;
+	}
+
+	void ReplicationServer::ResetClientObject(ClientObject& co)
+	{
+		co.acked_seq = 0;
+		co.acked_valid = false;
+		co.baseline_valid = false;
+		co.accum_priority = 0;
+	}
+
+	uint32_t ReplicationServer::IDBits() const
+	{
+		uint32_t bits = 1;
+		while ((1UL << bits) < objects_.size())
+		{
+			++ bits;
+		}
+		return bits;
+	}
+
+
+	ReplicationClient::ReplicationClient(uint32_t max_objects, float position_precision)
+		: max_objects_(max_objects), position_precision_(position_precision)
+	{
+	}
+
+	ReplicationClient::Object& ReplicationClient::GetObject(uint32_t id)
+	{
+		BOOST_ASSERT(id < max_objects_);
+
+		if (id >= objects_.size())
+		{
+			size_t const old_size = objects_.size();
+			objects_.resize(id + 1);
+			for (size_t i = old_size; i < objects_.size(); ++ i)
+			{
+				Object& obj = objects_[i];
+				obj.valid = false;
+				obj.seq = 0;
+				obj.state = IdentityTransform(position_precision_);
+				for (auto& baseline : obj.baselines)
+				{
+					baseline.valid = false;
+				}
+			}
+		}
+		return objects_[id];
+	}
+
+	void ReplicationClient::Bind(uint32_t id, SceneObjectPtr const & so)
+	{
+		this->GetObject(id).so = so;
+	}
+
+	void ReplicationClient::Unbind(uint32_t id)
+	{
+		if (id < objects_.size())
+		{
+			objects_[id].so.reset();
+		}
+	}
+
+	bool ReplicationClient::ReadSnapshot(void const * data, uint32_t size, uint16_t& seq)
+	{
+		BitReader reader(data, size);
+		uint16_t const snapshot_seq = static_cast<uint16_t>(reader.Read(SEQ_BITS));
+		uint32_t const id_bits = reader.Read(ID_BITS_BITS);
+		if ((id_bits == 0) || (id_bits > 24))
+		{
+			return false;
+		}
+
+		// Decodes everything first. A snapshot is applied whole or not at all, so a failed one isn't acked.
+		entries_.clear();
+		while (reader.Read(1) && !reader.Overflow())
+		{
+			Entry entry;
+			entry.id = reader.Read(id_bits);
+			if (entry.id >= max_objects_)
+			{
+				return false;
+			}
+
+			uint32_t const age = reader.Read(AGE_BITS);
+			QuantizedTransform const * base = nullptr;
+			if (age != 0)
+			{
+				if (entry.id < objects_.size())
+				{
+					uint16_t const base_seq = static_cast<uint16_t>(snapshot_seq - age);
+					for (auto const & baseline : objects_[entry.id].baselines)
+					{
+						if (baseline.valid && (baseline.seq == base_seq))
+						{
+							base = &baseline.state;
+							break;
+						}
+					}
+				}
+				if (nullptr == base)
+				{
+					return false;
+				}
+				entry.state = *base;
+			}
+			else
+			{
+				entry.state = IdentityTransform(position_precision_);
+			}
+
+			QuantizedTransform& qt = entry.state;
+			if (reader.Read(1))
+			{
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					qt.pos[j] = base ? qt.pos[j] + ReadDelta(reader) : ReadSigned(reader, POSITION_BITS);
+				}
+			}
+			if (reader.Read(1))
+			{
+				if (base && reader.Read(1))
+				{
+					uint32_t rot = qt.rot & ~((1UL << (3 * ROTATION_COMPONENT_BITS)) - 1);
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						uint32_t const c = (RotationComponent(qt.rot, j) + ReadDelta(reader)) & ROTATION_COMPONENT_MAX;
+						rot |= c << ((2 - j) * ROTATION_COMPONENT_BITS);
+					}
+					qt.rot = rot;
+				}
+				else
+				{
+					qt.rot = reader.Read(32);
+				}
+			}
+			if (reader.Read(1))
+			{
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					qt.scale[j] = base ? qt.scale[j] + ReadDelta(reader) : ReadSigned(reader, SCALE_BITS);
+				}
+			}
+
+			entries_.push_back(entry);
+		}
+		if (reader.Overflow())
+		{
+			return false;
+		}
+
+		for (auto const & entry : entries_)
+		{
+			Object& obj = this->GetObject(entry.id);
+
+			// Keeps it as a baseline, in place of the oldest one
+			Baseline* slot = &obj.baselines[0];
+			for (auto& baseline : obj.baselines)
+			{
+				if (!baseline.valid || (baseline.seq == snapshot_seq))
+				{
+					slot = &baseline;
+					break;
+				}
+				if (SeqNewer(slot->seq, baseline.seq))
+				{
+					slot = &baseline;
+				}
+			}
+			slot->valid = true;
+			slot->seq = snapshot_seq;
+			slot->state = entry.state;
+
+			// Snapshots can come out of order
+			if (!obj.valid || SeqNewer(snapshot_seq, obj.seq))
+			{
+				obj.valid = true;
+				obj.seq = snapshot_seq;
+				obj.state = entry.state;
+
+				if (obj.so)
+				{
+					float3 pos;
+					Quaternion rot;
+					float3 scale;
+					DequantizeTransform(pos, rot, scale, obj.state, position_precision_);
+					obj.so->ModelMatrix(MathLib::transformation<float>(nullptr, nullptr, &scale, nullptr, &rot, &pos));
+				}
+			}
+		}
+
+		seq = snapshot_seq;
+		return true;
+	}
+
+	bool ReplicationClient::Transform(uint32_t id, float3& pos, Quaternion& rot, float3& scale) const
+	{
+		QuantizedTransform qt;
+		if (this->Transform(id, qt))
+		{
+			DequantizeTransform(pos, rot, scale, qt, position_precision_);
+			return true;
+		}
+		return false;
+	}
+
+	bool ReplicationClient::Transform(uint32_t id, QuantizedTransform& qt) const
+	{
+		if ((id < objects_.size()) && objects_[id].valid)
+		{
+			qt = objects_[id].state;
+			return true;
+		}
+		return false;
+	}
+}
@@ -17,8 +17,9 @@
 #include <KlayGE/Lobby.hpp>
 
 #include <algorithm>
-#include <ctime>
+#include <chrono>
 #include <cstring>
+#include <thread>
 
 #include <KlayGE/NetMsg.hpp>
 #include <KlayGE/Player.hpp>
@@ -40,6 +41,8 @@ namespace
 	private:
 		KlayGE::Player* player_;
 	};
+
+	uint32_t const QUIT_TIMEOUT_MS = 1000;
 }
 
 namespace KlayGE
@@ -47,6 +50,7 @@ namespace KlayGE
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	Player::Player()
+		: playerID_(0), receiveLoop_(false)
 	{
 	}
 
@@ -61,55 +65,21 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void Player::ReceiveFunc()
 	{
-		static time_t lastTime = std::time(nullptr);
+		// Blocks on the socket for at most a tick, instead of spinning. Retransmits and acks go out every tick.
+		socket_.TimeOut(Net_Tick_Time);
 
-		for (;;)
+		std::vector<uint8_t> packet(NetChannel::DEFAULT_MTU);
+		while (receiveLoop_)
 		{
-			if (std::time(nullptr) - lastTime >= 10 * 1000)
-			{
-				char msg(MSG_NOP);
-				socket_.Send(&msg, sizeof(msg));
-				lastTime = std::time(nullptr);
-			}
-
-			if (!sendQueue_.empty())
-			{
-				// ͶϢ
-				for (auto const & msg : sendQueue_)
-				{
-					socket_.Send(&msg[0], static_cast<int>(msg.size()));
-				}
-			}
+			int const size = socket_.Receive(packet.data(), static_cast<int>(packet.size()));
 
-			char revBuf[Max_Buffer];
-			memset(revBuf, 0, sizeof(revBuf));
-			if (socket_.Receive(revBuf, sizeof(revBuf)) != -1)
+			std::lock_guard<std::mutex> lock(channelMutex_);
+			double const now = timer_.elapsed();
+			if (size > 0)
 			{
-				uint32_t ID;
-				std::memcpy(&ID, &revBuf[1], 4);
-
-				// ɾѷ͵Ϣ
-				for (auto iter = sendQueue_.begin(); iter != sendQueue_.end();)
-				{
-					std::vector<char>& msg = *iter;
-
-					uint32_t sendID;
-					std::memcpy(&sendID, &msg[1], 4);
-					if (sendID == ID)
-					{
-						iter = sendQueue_.erase(iter);
-					}
-					else
-					{
-						++ iter;
-					}
-				}
-
-				if (MSG_QUIT == revBuf[0])
-				{
-					break;
-				}
+				channel_->ReceivePacket(packet.data(), size, now);
 			}
+			channel_->Update(now);
 		}
 	}
 
@@ -131,11 +101,33 @@ namespace KlayGE
 
 		socket_.Send(buf, sizeof(buf));
 
-		socket_.Receive(&playerID_, sizeof(playerID_));
-		if (0 == playerID_)
+		// ظʽ:
+		//			MSG_JOIN		1 ֽ
+		//			Player ID		1 ֽ, 0 for a full lobby
+		//			Full player ID	4 ֽ, only from LobbyServer
+		char reply[6] = { 0, 0, 0, 0, 0, 0 };
+		int const reply_size = socket_.Receive(reply, sizeof(reply));
+		if (((reply_size != 2) && (reply_size != sizeof(reply))) || (reply[0] != MSG_JOIN) || (0 == reply[1]))
 		{
 			return false;
 		}
+		if (reply_size == sizeof(reply))
+		{
+			uint32_t id;
+			std::memcpy(&id, &reply[2], sizeof(id));
+			playerID_ = LE2Native(id);
+		}
+		else
+		{
+			playerID_ = static_cast<uint8_t>(reply[1]);
+		}
+
+		lobbyAddr_ = lobbyAddr;
+		timer_.restart();
+		channel_ = MakeUniquePtr<NetChannel>([this](void const * packet, uint32_t size)
+			{
+				socket_.Send(packet, static_cast<int>(size));
+			});
 
 		receiveLoop_ = true;
 		receiveThread_ = Context::Instance().ThreadPool()(ReceiveThreadFunc(this));
@@ -150,7 +142,20 @@ namespace KlayGE
 		if (receiveLoop_)
 		{
 			char msg(MSG_QUIT);
-			socket_.Send(&msg, sizeof(msg));
+			this->Send(&msg, sizeof(msg));
+
+			// Gives the quit message some time to be acked
+			for (uint32_t i = 0; i < QUIT_TIMEOUT_MS / Net_Tick_Time; ++ i)
+			{
+				{
+					std::lock_guard<std::mutex> lock(channelMutex_);
+					if (0 == channel_->NumUnacked())
+					{
+						break;
+					}
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(Net_Tick_Time));
+			}
 
 			receiveLoop_ = false;
 			receiveThread_();
@@ -209,14 +214,31 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	int Player::Receive(void* buf, int maxSize, sockaddr_in& from)
 	{
-		return socket_.ReceiveFrom(buf, maxSize, from);
+		std::vector<uint8_t> msg;
+		{
+			std::lock_guard<std::mutex> lock(channelMutex_);
+			if (!channel_ || !channel_->Receive(msg))
+			{
+				return -1;
+			}
+		}
+
+		int const size = std::min(static_cast<int>(msg.size()), maxSize);
+		std::memcpy(buf, msg.data(), size);
+		from = lobbyAddr_;
+		return size;
 	}
 
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
-	int Player::Send(void const * buf, int size)
+	int Player::Send(void const * buf, int size, bool reliable)
 	{
-		return socket_.Send(buf, size);
+		std::lock_guard<std::mutex> lock(channelMutex_);
+		if (!channel_ || !channel_->Send(buf, static_cast<uint32_t>(size), reliable))
+		{
+			return -1;
+		}
+		return size;
 	}
 }
 
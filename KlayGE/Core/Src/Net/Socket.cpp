@@ -310,7 +310,7 @@ namespace KlayGE
 		timeval timeOut;
 
 		timeOut.tv_sec = MicroSecs / 1000;
-		timeOut.tv_usec = MicroSecs % 1000;
+		timeOut.tv_usec = MicroSecs % 1000 * 1000;
 
 		SetSockOpt(SO_RCVTIMEO, &timeOut, sizeof(timeOut));
 		SetSockOpt(SO_SNDTIMEO, &timeOut, sizeof(timeOut));
@@ -325,7 +325,7 @@ namespace KlayGE
 
 		this->GetSockOpt(SO_RCVTIMEO, &timeOut, len);
 
-		return timeOut.tv_sec * 1000 + timeOut.tv_usec;
+		return static_cast<uint32_t>(timeOut.tv_sec * 1000 + timeOut.tv_usec / 1000);
 	}
 }
 
@@ -31,9 +31,11 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ErrorHandling.hpp>
 #include <KlayGE/ResLoader.hpp>
+#include <KlayGE/Context.hpp>
 #include <KFL/DllLoader.hpp>
 #include <KFL/Thread.hpp>
 
+#include <algorithm>
 #include <cstring>
 
 #include <C/LzmaLib.h>
@@ -113,6 +115,51 @@ namespace
 		static std::unique_ptr<LZMALoader> instance_;
 	};
 	std::unique_ptr<LZMALoader> LZMALoader::instance_;
+
+
+	// Payloads up to one block are a single LZMA stream, the same as older data and what kfont decodes.
+	// Bigger ones are split into blocks compressed independently, so they can be encoded and decoded in parallel:
+	//   uint8_t marker, uint8_t[3] padding, uint32_t block_size, uint32_t num_blocks, uint32_t comed_len[num_blocks], blocks
+	uint32_t const BLOCK_SIZE = 1UL << 20;
+	uint32_t const FRAMED_HEADER_SIZE = 12;
+	// The first byte of a LZMA stream is (pb * 5 + lp) * 9 + lc, it's always less than 225
+	uint8_t const FRAMED_MARKER = 0xFF;
+
+	void EncodeBlock(std::vector<uint8_t>& output, uint8_t const * input, uint64_t len)
+	{
+		SizeT out_len = static_cast<SizeT>(std::max(len * 11 / 10, static_cast<uint64_t>(32)));
+		output.resize(LZMA_PROPS_SIZE + out_len);
+		SizeT out_props_size = LZMA_PROPS_SIZE;
+		LZMALoader::Instance().LzmaCompress(&output[LZMA_PROPS_SIZE], &out_len, input, static_cast<SizeT>(len),
+			&output[0], &out_props_size, 5, std::min<uint32_t>(static_cast<uint32_t>(len), 1UL << 24), 3, 0, 2, 32, 1);
+
+		output.resize(LZMA_PROPS_SIZE + out_len);
+	}
+
+	void DecodeBlock(uint8_t* output, uint8_t const * input, uint64_t len, uint64_t original_len)
+	{
+		Verify(len >= LZMA_PROPS_SIZE);
+
+		SizeT s_out_len = static_cast<SizeT>(original_len);
+
+		SizeT s_src_len = static_cast<SizeT>(len - LZMA_PROPS_SIZE);
+		int res = LZMALoader::Instance().LzmaUncompress(output, &s_out_len, input + LZMA_PROPS_SIZE, &s_src_len,
+			input, LZMA_PROPS_SIZE);
+		Verify(0 == res);
+	}
+
+	uint32_t ReadUInt32(uint8_t const * p)
+	{
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return LE2Native(v);
+	}
+
+	void WriteUInt32(uint8_t* p, uint32_t v)
+	{
+		v = Native2LE(v);
+		std::memcpy(p, &v, sizeof(v));
+	}
 }
 
 namespace KlayGE
@@ -155,26 +202,124 @@ namespace KlayGE
 
 	void LZMACodec::Encode(std::vector<uint8_t>& output, void const * input, uint64_t len)
 	{
-		SizeT out_len = static_cast<SizeT>(std::max(len * 11 / 10, static_cast<uint64_t>(32)));
-		output.resize(LZMA_PROPS_SIZE + out_len);
-		SizeT out_props_size = LZMA_PROPS_SIZE;
-		LZMALoader::Instance().LzmaCompress(&output[LZMA_PROPS_SIZE], &out_len, static_cast<Byte const *>(input), static_cast<SizeT>(len),
-			&output[0], &out_props_size, 5, std::min<uint32_t>(static_cast<uint32_t>(len), 1UL << 24), 3, 0, 2, 32, 1);
+		uint8_t const * p = static_cast<uint8_t const *>(input);
+		if (len <= BLOCK_SIZE)
+		{
+			EncodeBlock(output, p, len);
+			return;
+		}
 
-		output.resize(LZMA_PROPS_SIZE + out_len);
+		uint32_t const num_blocks = static_cast<uint32_t>((len + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		std::vector<std::vector<uint8_t>> blocks(num_blocks);
+		Context::Instance().ThreadPool().parallel_for(num_blocks, [&blocks, p, len](uint32_t i)
+			{
+				uint64_t const offset = static_cast<uint64_t>(i) * BLOCK_SIZE;
+				EncodeBlock(blocks[i], p + offset, std::min<uint64_t>(BLOCK_SIZE, len - offset));
+			});
+
+		size_t total_len = FRAMED_HEADER_SIZE + num_blocks * sizeof(uint32_t);
+		for (auto const & block : blocks)
+		{
+			total_len += block.size();
+		}
+
+		output.resize(total_len);
+		output[0] = FRAMED_MARKER;
+		output[1] = output[2] = output[3] = 0;
+		WriteUInt32(&output[4], BLOCK_SIZE);
+		WriteUInt32(&output[8], num_blocks);
+		uint8_t* dst = &output[FRAMED_HEADER_SIZE + num_blocks * sizeof(uint32_t)];
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			WriteUInt32(&output[FRAMED_HEADER_SIZE + i * sizeof(uint32_t)], static_cast<uint32_t>(blocks[i].size()));
+			std::memcpy(dst, &blocks[i][0], blocks[i].size());
+			dst += blocks[i].size();
+		}
 	}
 
 	uint64_t LZMACodec::Decode(std::ostream& os, ResIdentifierPtr const & is, uint64_t len, uint64_t original_len)
 	{
-		std::vector<uint8_t> in_data(static_cast<size_t>(len));
-		is->read(&in_data[0], static_cast<size_t>(len));
+		// Nothing past len is read. Anything shorter than a framed header can only be a single LZMA stream.
+		if (len < FRAMED_HEADER_SIZE)
+		{
+			std::vector<uint8_t> output;
+			this->Decode(output, is, len, original_len);
+			if (!output.empty())
+			{
+				os.write(reinterpret_cast<char*>(&output[0]), static_cast<std::streamsize>(output.size()));
+			}
+
+			return output.size();
+		}
+
+		uint8_t header[FRAMED_HEADER_SIZE];
+		is->read(&header[0], 1);
+		Verify(is->gcount() == 1);
+		if (header[0] != FRAMED_MARKER)
+		{
+			std::vector<uint8_t> in_data(static_cast<size_t>(len));
+			in_data[0] = header[0];
+			is->read(&in_data[1], static_cast<size_t>(len - 1));
+			Verify(static_cast<uint64_t>(is->gcount()) == len - 1);
+
+			std::vector<uint8_t> output;
+			this->Decode(output, &in_data[0], len, original_len);
+
+			os.write(reinterpret_cast<char*>(&output[0]), static_cast<std::streamsize>(output.size()));
+
+			return output.size();
+		}
+
+		// Streams a group of blocks at a time, so only a few blocks of input and output are in memory
+
+		is->read(&header[1], FRAMED_HEADER_SIZE - 1);
+		Verify(is->gcount() == FRAMED_HEADER_SIZE - 1);
+		uint32_t const block_size = ReadUInt32(&header[4]);
+		uint32_t const num_blocks = ReadUInt32(&header[8]);
+		Verify(static_cast<uint64_t>(num_blocks) * block_size >= original_len);
+		Verify(FRAMED_HEADER_SIZE + static_cast<uint64_t>(num_blocks) * sizeof(uint32_t) <= len);
+
+		std::vector<uint32_t> comed_lens(num_blocks);
+		is->read(comed_lens.data(), num_blocks * sizeof(comed_lens[0]));
+		Verify(static_cast<uint64_t>(is->gcount()) == num_blocks * sizeof(comed_lens[0]));
+		uint64_t total_comed_len = FRAMED_HEADER_SIZE + num_blocks * sizeof(uint32_t);
+		for (auto& comed_len : comed_lens)
+		{
+			comed_len = LE2Native(comed_len);
+			total_comed_len += comed_len;
+		}
+		Verify(total_comed_len <= len);
 
+		uint32_t const group_size = std::max(std::thread::hardware_concurrency(), 1U);
+		std::vector<uint8_t> in_data;
 		std::vector<uint8_t> output;
-		this->Decode(output, &in_data[0], len, original_len);
+		std::vector<uint64_t> in_offsets(group_size + 1);
+		for (uint32_t first = 0; first < num_blocks; first += group_size)
+		{
+			uint32_t const count = std::min(group_size, num_blocks - first);
+			in_offsets[0] = 0;
+			for (uint32_t i = 0; i < count; ++ i)
+			{
+				in_offsets[i + 1] = in_offsets[i] + comed_lens[first + i];
+			}
+			in_data.resize(static_cast<size_t>(in_offsets[count]));
+			is->read(in_data.data(), in_data.size());
+			Verify(static_cast<uint64_t>(is->gcount()) == in_data.size());
+
+			uint64_t const out_offset = static_cast<uint64_t>(first) * block_size;
+			uint64_t const out_len = std::min<uint64_t>(static_cast<uint64_t>(count) * block_size, original_len - out_offset);
+			output.resize(static_cast<size_t>(out_len));
+			Context::Instance().ThreadPool().parallel_for(count, [&in_data, &in_offsets, &output, block_size, out_len](uint32_t i)
+				{
+					uint64_t const offset = static_cast<uint64_t>(i) * block_size;
+					DecodeBlock(&output[static_cast<size_t>(offset)], &in_data[static_cast<size_t>(in_offsets[i])],
+						in_offsets[i + 1] - in_offsets[i], std::min<uint64_t>(block_size, out_len - offset));
+				});
 
-		os.write(reinterpret_cast<char*>(&output[0]), static_cast<std::streamsize>(output.size()));
+			os.write(reinterpret_cast<char*>(&output[0]), static_cast<std::streamsize>(output.size()));
+		}
 
-		return output.size();
+		return original_len;
 	}
 
 	uint64_t LZMACodec::Decode(std::ostream& os, void const * input, uint64_t len, uint64_t original_len)
@@ -190,29 +335,46 @@ namespace KlayGE
 	void LZMACodec::Decode(std::vector<uint8_t>& output, ResIdentifierPtr const & is, uint64_t len, uint64_t original_len)
 	{
 		std::vector<uint8_t> in_data(static_cast<size_t>(len));
-		is->read(&in_data[0], static_cast<size_t>(len));
+		is->read(in_data.data(), static_cast<size_t>(len));
+		Verify(static_cast<uint64_t>(is->gcount()) == len);
 
-		this->Decode(output, &in_data[0], len, original_len);
+		this->Decode(output, in_data.data(), len, original_len);
 	}
 
 	void LZMACodec::Decode(std::vector<uint8_t>& output, void const * input, uint64_t len, uint64_t original_len)
 	{
 		output.resize(static_cast<uint32_t>(original_len));
-		this->Decode(&output[0], input, len, original_len);
+		this->Decode(output.data(), input, len, original_len);
 	}
 
 	void LZMACodec::Decode(void* output, void const * input, uint64_t len, uint64_t original_len)
 	{
 		uint8_t const * p = static_cast<uint8_t const *>(input);
+		uint8_t* out = static_cast<uint8_t*>(output);
+		if ((len < FRAMED_HEADER_SIZE) || (p[0] != FRAMED_MARKER))
+		{
+			DecodeBlock(out, p, len, original_len);
+			return;
+		}
 
-		std::vector<uint8_t> in_data(static_cast<size_t>(len));
-		std::memcpy(&in_data[0], p, static_cast<std::streamsize>(in_data.size()));
+		uint32_t const block_size = ReadUInt32(p + 4);
+		uint32_t const num_blocks = ReadUInt32(p + 8);
+		Verify(static_cast<uint64_t>(num_blocks) * block_size >= original_len);
+		Verify(FRAMED_HEADER_SIZE + static_cast<uint64_t>(num_blocks) * sizeof(uint32_t) <= len);
 
-		SizeT s_out_len = static_cast<SizeT>(original_len);
+		std::vector<uint64_t> in_offsets(num_blocks + 1);
+		in_offsets[0] = FRAMED_HEADER_SIZE + num_blocks * sizeof(uint32_t);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			in_offsets[i + 1] = in_offsets[i] + ReadUInt32(p + FRAMED_HEADER_SIZE + i * sizeof(uint32_t));
+		}
+		Verify(in_offsets[num_blocks] <= len);
 
-		SizeT s_src_len = static_cast<SizeT>(len - LZMA_PROPS_SIZE);
-		int res = LZMALoader::Instance().LzmaUncompress(static_cast<Byte*>(output), &s_out_len, &in_data[LZMA_PROPS_SIZE], &s_src_len,
-			&in_data[0], LZMA_PROPS_SIZE);
-		Verify(0 == res);
+		Context::Instance().ThreadPool().parallel_for(num_blocks, [p, out, &in_offsets, block_size, original_len](uint32_t i)
+			{
+				uint64_t const offset = static_cast<uint64_t>(i) * block_size;
+				DecodeBlock(out + offset, p + in_offsets[i], in_offsets[i + 1] - in_offsets[i],
+					std::min<uint64_t>(block_size, original_len - offset));
+			});
 	}
 }
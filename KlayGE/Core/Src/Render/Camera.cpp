@@ -19,6 +19,7 @@
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/SceneManager.hpp>
 
@@ -197,8 +198,8 @@ namespace KlayGE
 	{
 		if (view_proj_mat_dirty_)
 		{
-			view_proj_mat_ = view_mat_ * proj_mat_;
-			inv_view_proj_mat_ = inv_proj_mat_ * inv_view_mat_;
+			view_proj_mat_ = SIMDMathLib::Multiply(view_mat_, proj_mat_);
+			inv_view_proj_mat_ = SIMDMathLib::Multiply(inv_proj_mat_, inv_view_mat_);
 			view_proj_mat_dirty_ = false;
 		}
 		return view_proj_mat_;
@@ -208,8 +209,8 @@ namespace KlayGE
 	{
 		if (view_proj_mat_wo_adjust_dirty_)
 		{
-			view_proj_mat_wo_adjust_ = view_mat_ * proj_mat_wo_adjust_;
-			inv_view_proj_mat_wo_adjust_ = inv_proj_mat_wo_adjust_ * inv_view_mat_;
+			view_proj_mat_wo_adjust_ = SIMDMathLib::Multiply(view_mat_, proj_mat_wo_adjust_);
+			inv_view_proj_mat_wo_adjust_ = SIMDMathLib::Multiply(inv_proj_mat_wo_adjust_, inv_view_mat_);
 			view_proj_mat_wo_adjust_dirty_ = false;
 		}
 		return view_proj_mat_wo_adjust_;
@@ -234,8 +235,8 @@ namespace KlayGE
 	{
 		if (view_proj_mat_dirty_)
 		{
-			view_proj_mat_ = view_mat_ * proj_mat_;
-			inv_view_proj_mat_ = inv_proj_mat_ * inv_view_mat_;
+			view_proj_mat_ = SIMDMathLib::Multiply(view_mat_, proj_mat_);
+			inv_view_proj_mat_ = SIMDMathLib::Multiply(inv_proj_mat_, inv_view_mat_);
 			view_proj_mat_dirty_ = false;
 		}
 		return inv_view_proj_mat_;
@@ -245,8 +246,8 @@ namespace KlayGE
 	{
 		if (view_proj_mat_wo_adjust_dirty_)
 		{
-			view_proj_mat_wo_adjust_ = view_mat_ * proj_mat_wo_adjust_;
-			inv_view_proj_mat_wo_adjust_ = inv_proj_mat_wo_adjust_ * inv_view_mat_;
+			view_proj_mat_wo_adjust_ = SIMDMathLib::Multiply(view_mat_, proj_mat_wo_adjust_);
+			inv_view_proj_mat_wo_adjust_ = SIMDMathLib::Multiply(inv_proj_mat_wo_adjust_, inv_view_mat_);
 			view_proj_mat_wo_adjust_dirty_ = false;
 		}
 		return inv_view_proj_mat_wo_adjust_;
@@ -267,11 +268,18 @@ namespace KlayGE
 		if (frustum_dirty_)
 		{
 			frustum_.ClipMatrix(this->ViewProjMatrixWOAdjust(), this->InverseViewProjMatrixWOAdjust());
+			simd_frustum_.Planes(frustum_);
 			frustum_dirty_ = false;
 		}
 		return frustum_;
 	}
 
+	SIMDFrustum const & Camera::ViewFrustumSIMD() const
+	{
+		this->ViewFrustum();
+		return simd_frustum_;
+	}
+
 	bool Camera::OmniDirectionalMode() const
 	{
 		return (mode_ & CM_Omni) > 0;
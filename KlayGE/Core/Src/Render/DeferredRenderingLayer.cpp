@@ -523,6 +523,7 @@ namespace KlayGE
 
 		g_buffer_effect_ = SyncLoadRenderEffect("GBufferNoSkinning.fxml");
 		g_buffer_skinning_effect_ = SyncLoadRenderEffect("GBufferSkinning128.fxml");
+		g_buffer_instancing_effect_ = SyncLoadRenderEffect("GBufferInstancing.fxml");
 #if DEFAULT_DEFERRED == TRIDITIONAL_DEFERRED
 		dr_effect_ = SyncLoadRenderEffect("DeferredRendering.fxml");
 #elif DEFAULT_DEFERRED == LIGHT_INDEXED_DEFERRED
@@ -29,162 +29,385 @@
  */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+
 #include <KlayGE/DistanceField.hpp>
 
 namespace KlayGE
 {
-	float EdgeDistance(float2 const & grad, float val)
+	// Plain scalar math on purpose. This is called for most candidates of every pixel, and the vector helpers in
+	// MathLib are not inlined.
+	float EdgeDistance(float gx, float gy, float val)
 	{
 		float df;
-		if ((0 == grad.x()) || (0 == grad.y()))
+		if ((0 == gx) || (0 == gy))
 		{
 			df = 0.5f - val;
 		}
 		else
 		{
-			float2 n_grad = MathLib::abs(MathLib::normalize(grad));
-			if (n_grad.x() < n_grad.y())
+			float const inv_len = 1 / std::sqrt(gx * gx + gy * gy);
+			float nx = std::abs(gx) * inv_len;
+			float ny = std::abs(gy) * inv_len;
+			if (nx < ny)
 			{
-				std::swap(n_grad.x(), n_grad.y());
+				std::swap(nx, ny);
 			}
 
-			float v1 = 0.5f * n_grad.y() / n_grad.x();
+			float v1 = 0.5f * ny / nx;
 			if (val < v1)
 			{
-				df = 0.5f * (n_grad.x() + n_grad.y()) - MathLib::sqrt(2 * n_grad.x() * n_grad.y() * val);
+				df = 0.5f * (nx + ny) - std::sqrt(2 * nx * ny * val);
 			}
 			else if (val < 1 - v1)
 			{
-				df = (0.5f - val) * n_grad.x();
+				df = (0.5f - val) * nx;
 			}
 			else
 			{
-				df = -0.5f * (n_grad.x() + n_grad.y()) + MathLib::sqrt(2 * n_grad.x() * n_grad.y() * (1 - val));
+				df = -0.5f * (nx + ny) + std::sqrt(2 * nx * ny * (1 - val));
 			}
 		}
 		return df;
 	}
 
-	float AADist(std::vector<float> const & img, std::vector<float2> const & grad,
-		int width, int offset_addr, int2 const & offset_dist_xy, float2 const & new_dist)
+	float EdgeDistance(float2 const & grad, float val)
 	{
-		int closest = offset_addr - offset_dist_xy.y() * width - offset_dist_xy.x(); // Index to the edge pixel pointed to from c
-		float val = MathLib::clamp(img[closest], 0.0f, 1.0f);
+		return EdgeDistance(grad.x(), grad.y(), val);
+	}
+
+	// Distance from a pixel to the edge inside the pixel pointed by offset. The edge distance in a pixel is at least
+	// -sqrt(2)/2, so any candidate with offset length >= old_dist + MAX_EDGE_OFFSET can be rejected without evaluating it.
+	float const MAX_EDGE_OFFSET = 0.7072f;
+
+	float AADist(float const * img, float2 const * grad, int closest, int offset_x, int offset_y)
+	{
+		float val = std::min(std::max(img[closest], 0.0f), 1.0f);
 		if (0 == val)
 		{
 			return 1e10f;
 		}
 
-		float di = MathLib::length(new_dist);
-		float df;
-		if (0 == di)
+		if ((0 == offset_x) && (0 == offset_y))
 		{
-			df = EdgeDistance(grad[closest], val);
+			return EdgeDistance(grad[closest], val);
 		}
 		else
 		{
-			df = EdgeDistance(new_dist, val);
+			float const fx = static_cast<float>(offset_x);
+			float const fy = static_cast<float>(offset_y);
+			return std::sqrt(fx * fx + fy * fy) + EdgeDistance(fx, fy, val);
+		}
+	}
+
+	// Rows are processed in bands of at least this many pixels
+	int const MIN_PIXELS_PER_BAND = 64 * 1024;
+
+	// Separable exact Euclidean distance transform (Felzenszwalb & Huttenlocher), tracking the closest site
+	// of every pixel instead of the distance. Sites are all pixels with coverage > 0.
+	void ClosestSites(float const * img, int width, int height, std::vector<int>& closest)
+	{
+		// Column pass. Sweeping whole rows keeps the inner loop over contiguous columns, which vectorizes.
+		std::vector<int> col_site(width * height);
+		for (int x = 0; x < width; ++ x)
+		{
+			col_site[x] = (img[x] > 0) ? 0 : -1;
+		}
+		for (int y = 1; y < height; ++ y)
+		{
+			int const * prev = &col_site[(y - 1) * width];
+			int* cur = &col_site[y * width];
+			float const * src = &img[y * width];
+			for (int x = 0; x < width; ++ x)
+			{
+				cur[x] = (src[x] > 0) ? y : prev[x];
+			}
+		}
+		for (int y = height - 2; y >= 0; -- y)
+		{
+			int const * next = &col_site[(y + 1) * width];
+			int* cur = &col_site[y * width];
+			for (int x = 0; x < width; ++ x)
+			{
+				bool const take_next = (next[x] >= 0) && ((cur[x] < 0) || (next[x] - y < y - cur[x]));
+				cur[x] = take_next ? next[x] : cur[x];
+			}
 		}
-		return di + df;
+
+		// Row pass. Lower envelope of the parabolas rooted at each column's closest site.
+		closest.resize(width * height);
+		Context::Instance().ThreadPool().parallel_for_bands(static_cast<uint32_t>(height), static_cast<uint32_t>(MIN_PIXELS_PER_BAND / width),
+			[&col_site, &closest, width](int begin_y, int end_y)
+			{
+				float const INF = 1e20f;
+
+				std::vector<float> f(width);
+				std::vector<int> v(width);
+				std::vector<float> z(width + 1);
+				for (int y = begin_y; y < end_y; ++ y)
+				{
+					int const * sites = &col_site[y * width];
+					int* out = &closest[y * width];
+
+					int first = 0;
+					while ((first < width) && (sites[first] < 0))
+					{
+						++ first;
+					}
+					if (first == width)
+					{
+						std::fill(out, out + width, -1);
+						continue;
+					}
+
+					for (int q = 0; q < width; ++ q)
+					{
+						float const dy = static_cast<float>(sites[q] - y);
+						f[q] = (sites[q] >= 0) ? dy * dy : INF;
+					}
+
+					int k = 0;
+					v[0] = first;
+					z[0] = -INF;
+					z[1] = +INF;
+					for (int q = first + 1; q < width; ++ q)
+					{
+						if (sites[q] < 0)
+						{
+							continue;
+						}
+
+						float s;
+						for (;;)
+						{
+							int const p = v[k];
+							s = ((f[q] + q * q) - (f[p] + p * p)) / (2.0f * (q - p));
+							if ((s <= z[k]) && (k > 0))
+							{
+								-- k;
+							}
+							else
+							{
+								break;
+							}
+						}
+						if (s <= z[k])
+						{
+							v[k] = q;
+						}
+						else
+						{
+							++ k;
+							v[k] = q;
+							z[k] = s;
+						}
+						z[k + 1] = +INF;
+					}
+
+					k = 0;
+					for (int x = 0; x < width; ++ x)
+					{
+						while (z[k + 1] < x)
+						{
+							++ k;
+						}
+						out[x] = sites[v[k]] * width + v[k];
+					}
+				}
+			});
 	}
 
-	bool UpdateDistance(int x, int y, int dx, int dy, std::vector<float> const & img, int width,
-		std::vector<float2> const & grad, std::vector<int2>& dist_xy, std::vector<float>& dist)
+	struct AADistState
+	{
+		float const * img;
+		float2 const * grad;
+		int width;
+		int* offset_x;
+		int* offset_y;
+		float* dist;
+	};
+
+	bool UpdateDistance(AADistState const & state, int addr, int dx, int dy)
 	{
 		float const EPSILON = 1e-3f;
 
-		bool changed = false;
-		int addr = y * width + x;
-		float old_dist = dist[addr];
+		float const old_dist = state.dist[addr];
 		if (old_dist > 0)
 		{
-			int offset_addr = (y + dy) * width + (x + dx);
-			int2 new_dist_xy = dist_xy[offset_addr] - int2(dx, dy);
-			float new_dist = AADist(img, grad, width, offset_addr, dist_xy[offset_addr], new_dist_xy);
-			if (new_dist < old_dist - EPSILON)
+			int const offset_addr = addr + dy * state.width + dx;
+			int const new_offset_x = state.offset_x[offset_addr] - dx;
+			int const new_offset_y = state.offset_y[offset_addr] - dy;
+
+			float const bound = old_dist + MAX_EDGE_OFFSET;
+			if (static_cast<float>(new_offset_x * new_offset_x + new_offset_y * new_offset_y) < bound * bound)
 			{
-				dist_xy[addr] = new_dist_xy;
-				dist[addr] = new_dist;
-				changed = true;
+				int const closest = offset_addr - state.offset_y[offset_addr] * state.width - state.offset_x[offset_addr];
+				float const new_dist = AADist(state.img, state.grad, closest, new_offset_x, new_offset_y);
+				if (new_dist < old_dist - EPSILON)
+				{
+					state.offset_x[addr] = new_offset_x;
+					state.offset_y[addr] = new_offset_y;
+					state.dist[addr] = new_dist;
+					return true;
+				}
 			}
 		}
 
-		return changed;
+		return false;
 	}
 
 	void AAEuclideanDistance(std::vector<float> const & img, std::vector<float2> const & grad,
 		int width, int height, std::vector<float>& dist)
 	{
-		std::vector<int2> dist_xy(img.size(), int2(0, 0));
+		// Seed every pixel with its exact Euclidean closest site. The anti-aliased metric only differs from it by
+		// the sub-pixel edge position, so the propagation below converges in one round instead of rippling
+		// distances across the whole image.
+		std::vector<int> closest;
+		ClosestSites(&img[0], width, height, closest);
 
-		for (size_t i = 0; i < img.size(); ++ i)
-		{
-			if (img[i] <= 0)
-			{
-				dist[i] = 1e10f;
-			}
-			else if (img[i] < 1)
+		std::vector<int> offset_x(img.size());
+		std::vector<int> offset_y(img.size());
+		Context::Instance().ThreadPool().parallel_for_bands(static_cast<uint32_t>(height), static_cast<uint32_t>(MIN_PIXELS_PER_BAND / width),
+			[&](int begin_y, int end_y)
 			{
-				dist[i] = EdgeDistance(grad[i], img[i]);
-			}
-			else
+				for (int y = begin_y; y < end_y; ++ y)
+				{
+					for (int x = 0; x < width; ++ x)
+					{
+						int const addr = y * width + x;
+						int const site = closest[addr];
+						if (img[addr] >= 1)
+						{
+							dist[addr] = 0;
+							offset_x[addr] = 0;
+							offset_y[addr] = 0;
+						}
+						else if (site < 0)
+						{
+							dist[addr] = 1e10f;
+							offset_x[addr] = 0;
+							offset_y[addr] = 0;
+						}
+						else
+						{
+							offset_x[addr] = x - site % width;
+							offset_y[addr] = y - site / width;
+							dist[addr] = AADist(&img[0], &grad[0], site, offset_x[addr], offset_y[addr]);
+							if (img[addr] > 0)
+							{
+								dist[addr] = std::min(dist[addr], EdgeDistance(grad[addr], img[addr]));
+							}
+						}
+					}
+				}
+			});
+
+		AADistState state;
+		state.img = &img[0];
+		state.grad = &grad[0];
+		state.width = width;
+		state.offset_x = &offset_x[0];
+		state.offset_y = &offset_y[0];
+		state.dist = &dist[0];
+
+		// A row only needs another sweep if it or one of its neighbors changed since it was last swept. After the
+		// seeding almost all rows settle in the first round, so the convergence check costs nearly nothing.
+		std::vector<uint8_t> last_changed(height, 1);
+		std::vector<uint8_t> changed_rows(height);
+		auto need_sweep = [&last_changed, &changed_rows, height](int y)
+		{
+			int const y0 = std::max(y - 1, 0);
+			int const y1 = std::min(y + 1, height - 1);
+			for (int i = y0; i <= y1; ++ i)
 			{
-				dist[i] = 0;
+				if (last_changed[i] || changed_rows[i])
+				{
+					return true;
+				}
 			}
-		}
+			return false;
+		};
 
 		bool changed;
 		do
 		{
 			changed = false;
+			std::fill(changed_rows.begin(), changed_rows.end(), 0);
 
 			for (int y = 1; y < height; ++ y)
 			{
+				if (!need_sweep(y))
+				{
+					continue;
+				}
+
+				int const row = y * width;
+				bool row_changed = false;
+
 				// Scan right, propagate distances from above & left
 				for (int x = 0; x < width; ++ x)
 				{
 					if (x > 0)
 					{
-						changed |= UpdateDistance(x, y, -1, +0, img, width, grad, dist_xy, dist);
-						changed |= UpdateDistance(x, y, -1, -1, img, width, grad, dist_xy, dist);
+						row_changed |= UpdateDistance(state, row + x, -1, +0);
+						row_changed |= UpdateDistance(state, row + x, -1, -1);
 					}
-					changed |= UpdateDistance(x, y, +0, -1, img, width, grad, dist_xy, dist);
+					row_changed |= UpdateDistance(state, row + x, +0, -1);
 					if (x < width - 1)
 					{
-						changed |= UpdateDistance(x, y, +1, -1, img, width, grad, dist_xy, dist);
+						row_changed |= UpdateDistance(state, row + x, +1, -1);
 					}
 				}
 
 				// Scan left, propagate distance from right
 				for (int x = width - 2; x >= 0; -- x)
 				{
-					changed |= UpdateDistance(x, y, +1, +0, img, width, grad, dist_xy, dist);
+					row_changed |= UpdateDistance(state, row + x, +1, +0);
 				}
+
+				changed_rows[y] |= row_changed;
+				changed |= row_changed;
 			}
 
 			for (int y = height - 2; y >= 0; -- y)
 			{
+				if (!need_sweep(y))
+				{
+					continue;
+				}
+
+				int const row = y * width;
+				bool row_changed = false;
+
 				// Scan left, propagate distances from below & right
 				for (int x = width - 1; x >= 0; -- x)
 				{
 					if (x < width - 1)
 					{
-						changed |= UpdateDistance(x, y, +1, +0, img, width, grad, dist_xy, dist);
-						changed |= UpdateDistance(x, y, +1, +1, img, width, grad, dist_xy, dist);
+						row_changed |= UpdateDistance(state, row + x, +1, +0);
+						row_changed |= UpdateDistance(state, row + x, +1, +1);
 					}
-					changed |= UpdateDistance(x, y, +0, +1, img, width, grad, dist_xy, dist);
+					row_changed |= UpdateDistance(state, row + x, +0, +1);
 					if (x > 0)
 					{
-						changed |= UpdateDistance(x, y, -1, +1, img, width, grad, dist_xy, dist);
+						row_changed |= UpdateDistance(state, row + x, -1, +1);
 					}
 				}
 
 				// Scan right, propagate distance from left
 				for (int x = 1; x < width; ++ x)
 				{
-					changed |= UpdateDistance(x, y, -1, +0, img, width, grad, dist_xy, dist);
+					row_changed |= UpdateDistance(state, row + x, -1, +0);
 				}
+
+				changed_rows[y] |= row_changed;
+				changed |= row_changed;
 			}
+
+			last_changed.swap(changed_rows);
 		} while (changed);
 	}
 
@@ -251,17 +474,35 @@ namespace KlayGE
 		std::vector<float2> grad_data(aa_data.size());
 		Downsample2x(grad_2x_data, input_width, input_height, grad_data);
 
-		std::vector<float> outside(grad_data.size());
-		AAEuclideanDistance(aa_data, grad_data, input_width / 2, input_height / 2, outside);
-
+		std::vector<float> inv_aa_data(aa_data.size());
+		std::vector<float2> inv_grad_data(grad_data.size());
 		for (size_t i = 0; i < grad_data.size(); ++ i)
 		{
-			aa_data[i] = 1 - aa_data[i];
-			grad_data[i] = -grad_data[i];
+			inv_aa_data[i] = 1 - aa_data[i];
+			inv_grad_data[i] = -grad_data[i];
 		}
 
+		int const width = input_width / 2;
+		int const height = input_height / 2;
+
+		// The inside and outside distances are independent. Large images compute them concurrently, while small
+		// ones, like glyphs, are usually already distributed over threads by the caller.
+		std::vector<float> outside(grad_data.size());
 		std::vector<float> inside(grad_data.size());
-		AAEuclideanDistance(aa_data, grad_data, input_width / 2, input_height / 2, inside);
+		if (width * height >= 64 * 1024)
+		{
+			joiner<void> outside_joiner = Context::Instance().ThreadPool()([&aa_data, &grad_data, &outside, width, height]
+				{
+					AAEuclideanDistance(aa_data, grad_data, width, height, outside);
+				});
+			AAEuclideanDistance(inv_aa_data, inv_grad_data, width, height, inside);
+			outside_joiner();
+		}
+		else
+		{
+			AAEuclideanDistance(aa_data, grad_data, width, height, outside);
+			AAEuclideanDistance(inv_aa_data, inv_grad_data, width, height, inside);
+		}
 
 		dist_data.resize(outside.size());
 		for (uint32_t i = 0; i < outside.size(); ++ i)
@@ -0,0 +1,675 @@
+/**
+* @file HeightfieldCache.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include <KlayGE/HeightfieldCache.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Levels of the min-max quadtree, for tiles up to 2^15 cells on an edge
+	uint32_t const MAX_TILE_LEVELS = 16;
+
+	float const MIN_DIR = 1e-20f;
+	float const MIN_DET = 1e-20f;
+
+	uint64_t TileKey(int32_t tx, int32_t tz)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(tx)) << 32) | static_cast<uint32_t>(tz);
+	}
+
+	int32_t FloorToInt(float x)
+	{
+		return static_cast<int32_t>(std::floor(x));
+	}
+
+	int32_t FloorDiv(int32_t a, int32_t b)
+	{
+		return (a >= 0) ? a / b : -((-a - 1) / b) - 1;
+	}
+
+	float SafeRcp(float x)
+	{
+		if (MathLib::abs(x) < MIN_DIR)
+		{
+			x = (x < 0) ? -MIN_DIR : MIN_DIR;
+		}
+		return 1 / x;
+	}
+
+	bool IntersectBox(float3 const & bb_min, float3 const & bb_max, float3 const & orig, float3 const & inv_dir,
+		float t_max)
+	{
+		float t0 = 0;
+		float t1 = t_max;
+		for (int i = 0; i < 3; ++ i)
+		{
+			float const ta = (bb_min[i] - orig[i]) * inv_dir[i];
+			float const tb = (bb_max[i] - orig[i]) * inv_dir[i];
+			t0 = std::max(t0, std::min(ta, tb));
+			t1 = std::min(t1, std::max(ta, tb));
+		}
+		return t0 <= t1;
+	}
+
+	// Moller-Trumbore, only hits closer than t
+	bool IntersectTriangle(float3 const & v0, float3 const & v1, float3 const & v2, float3 const & orig,
+		float3 const & dir, float& t)
+	{
+		float3 const e1 = v1 - v0;
+		float3 const e2 = v2 - v0;
+		float3 const p = MathLib::cross(dir, e2);
+		float const det = MathLib::dot(e1, p);
+		if (MathLib::abs(det) < MIN_DET)
+		{
+			return false;
+		}
+
+		float const inv_det = 1 / det;
+		float3 const s = orig - v0;
+		float const u = MathLib::dot(s, p) * inv_det;
+		if ((u < 0) || (u > 1))
+		{
+			return false;
+		}
+		float3 const q = MathLib::cross(s, e1);
+		float const v = MathLib::dot(dir, q) * inv_det;
+		if ((v < 0) || (u + v > 1))
+		{
+			return false;
+		}
+
+		float const d = MathLib::dot(e2, q) * inv_det;
+		if ((d >= 0) && (d < t))
+		{
+			t = d;
+			return true;
+		}
+		return false;
+	}
+}
+
+namespace KlayGE
+{
+	HeightfieldCache::HeightfieldCache(HeightFuncType const & height_func, float spacing, uint32_t tile_size,
+			uint32_t max_tiles)
+		: height_func_(height_func), spacing_(spacing), tile_size_(tile_size), max_tiles_(std::max(max_tiles, 1U)),
+			tick_(0), num_workers_(0), num_generated_(0)
+	{
+		BOOST_ASSERT(height_func_);
+		BOOST_ASSERT(spacing_ > 0);
+		BOOST_ASSERT((tile_size_ > 0) && (0 == (tile_size_ & (tile_size_ - 1))));
+
+		tile_levels_ = 1;
+		while ((1U << (tile_levels_ - 1)) < tile_size_)
+		{
+			++ tile_levels_;
+		}
+		BOOST_ASSERT(tile_levels_ <= MAX_TILE_LEVELS);
+
+		uint32_t offset = 0;
+		for (uint32_t level = 0; level < tile_levels_; ++ level)
+		{
+			level_offsets_.push_back(offset);
+			uint32_t const level_size = tile_size_ >> level;
+			offset += level_size * level_size;
+		}
+		level_offsets_.push_back(offset);
+
+		max_workers_ = std::max(std::thread::hardware_concurrency(), 2U) - 1;
+	}
+
+	HeightfieldCache::~HeightfieldCache()
+	{
+		std::vector<joiner<void>> workers;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.clear();
+			workers.swap(workers_);
+		}
+		for (auto& worker : workers)
+		{
+			worker();
+		}
+	}
+
+	void HeightfieldCache::Prefetch(float min_x, float min_z, float max_x, float max_z)
+	{
+		int32_t const n = static_cast<int32_t>(tile_size_);
+		int32_t const tx0 = FloorDiv(FloorToInt(std::min(min_x, max_x) / spacing_), n);
+		int32_t const tz0 = FloorDiv(FloorToInt(std::min(min_z, max_z) / spacing_), n);
+		int32_t const tx1 = FloorDiv(FloorToInt(std::max(min_x, max_x) / spacing_), n);
+		int32_t const tz1 = FloorDiv(FloorToInt(std::max(min_z, max_z) / spacing_), n);
+
+		std::vector<joiner<void>> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			for (int32_t tz = tz0; tz <= tz1; ++ tz)
+			{
+				for (int32_t tx = tx0; tx <= tx1; ++ tx)
+				{
+					uint64_t const key = TileKey(tx, tz);
+					if (tiles_.find(key) == tiles_.end())
+					{
+						auto tile = MakeSharedPtr<Tile>();
+						tile->tx = tx;
+						tile->tz = tz;
+						tile->state = TS_Queued;
+						tile->last_used = ++ tick_;
+						tiles_.emplace(key, tile);
+						queue_.push_back(tile);
+					}
+				}
+			}
+			this->EvictLocked();
+
+			// Joiners of the workers that already quit
+			if (0 == num_workers_)
+			{
+				finished.swap(workers_);
+			}
+
+			while ((num_workers_ < max_workers_) && (num_workers_ < queue_.size()))
+			{
+				++ num_workers_;
+				workers_.push_back(Context::Instance().ThreadPool()(
+					[this]
+					{
+						this->WorkerFunc();
+					}));
+			}
+		}
+
+		for (auto& worker : finished)
+		{
+			worker();
+		}
+	}
+
+	void HeightfieldCache::WaitForPrefetch()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		ready_cond_.wait(lock,
+			[this]
+			{
+				return queue_.empty() && (0 == num_workers_);
+			});
+	}
+
+	void HeightfieldCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		queue_.clear();
+		for (auto iter = tiles_.begin(); iter != tiles_.end();)
+		{
+			// Someone is waiting for it
+			if (TS_Generating == iter->second->state)
+			{
+				++ iter;
+			}
+			else
+			{
+				iter = tiles_.erase(iter);
+			}
+		}
+	}
+
+	uint32_t HeightfieldCache::NumTiles() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return static_cast<uint32_t>(tiles_.size());
+	}
+
+	float HeightfieldCache::Height(float x, float z)
+	{
+		TilePtr cursor;
+		return this->SampleHeight(cursor, x, z);
+	}
+
+	float3 HeightfieldCache::Normal(float x, float z)
+	{
+		TilePtr cursor;
+		return this->SampleNormal(cursor, x, z);
+	}
+
+	bool HeightfieldCache::RayCast(float3 const & orig, float3 const & dir, float max_dist, float& dist)
+	{
+		TilePtr cursor;
+		return this->TraceRay(cursor, orig, dir, max_dist, dist);
+	}
+
+	void HeightfieldCache::Height(ArrayRef<float2> xz, float* heights)
+	{
+		TilePtr cursor;
+		for (size_t i = 0; i < xz.size(); ++ i)
+		{
+			heights[i] = this->SampleHeight(cursor, xz[i].x(), xz[i].y());
+		}
+	}
+
+	void HeightfieldCache::Normal(ArrayRef<float2> xz, float3* normals)
+	{
+		TilePtr cursor;
+		for (size_t i = 0; i < xz.size(); ++ i)
+		{
+			normals[i] = this->SampleNormal(cursor, xz[i].x(), xz[i].y());
+		}
+	}
+
+	uint32_t HeightfieldCache::RayCast(ArrayRef<SceneRay> rays, float* dists)
+	{
+		TilePtr cursor;
+		uint32_t num_hits = 0;
+		for (size_t i = 0; i < rays.size(); ++ i)
+		{
+			if (this->TraceRay(cursor, rays[i].orig, rays[i].dir, rays[i].max_dist, dists[i]))
+			{
+				++ num_hits;
+			}
+			else
+			{
+				dists[i] = -1;
+			}
+		}
+		return num_hits;
+	}
+
+	HeightfieldCache::Tile const & HeightfieldCache::AcquireTile(TilePtr& cursor, int32_t tx, int32_t tz)
+	{
+		if (cursor && (cursor->tx == tx) && (cursor->tz == tz))
+		{
+			return *cursor;
+		}
+
+		TilePtr tile;
+		bool generate = false;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+
+			uint64_t const key = TileKey(tx, tz);
+			auto iter = tiles_.find(key);
+			if (iter == tiles_.end())
+			{
+				tile = MakeSharedPtr<Tile>();
+				tile->tx = tx;
+				tile->tz = tz;
+				tile->state = TS_Generating;
+				tiles_.emplace(key, tile);
+				generate = true;
+
+				this->EvictLocked();
+			}
+			else
+			{
+				tile = iter->second;
+				if (TS_Queued == tile->state)
+				{
+					// Not picked up by a worker yet. Faster to do it here than to wait.
+					tile->state = TS_Generating;
+					generate = true;
+				}
+				else if (TS_Generating == tile->state)
+				{
+					ready_cond_.wait(lock,
+						[&tile]
+						{
+							return TS_Ready == tile->state;
+						});
+				}
+			}
+			tile->last_used = ++ tick_;
+		}
+
+		if (generate)
+		{
+			this->GenerateTile(*tile);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				tile->state = TS_Ready;
+			}
+			ready_cond_.notify_all();
+		}
+
+		cursor = tile;
+		return *cursor;
+	}
+
+	void HeightfieldCache::GenerateTile(Tile& tile)
+	{
+		uint32_t const n = tile_size_;
+		uint32_t const stride = n + 1;
+
+		tile.heights.resize(stride * stride);
+		int32_t const base_x = tile.tx * static_cast<int32_t>(n);
+		int32_t const base_z = tile.tz * static_cast<int32_t>(n);
+		for (uint32_t z = 0; z < stride; ++ z)
+		{
+			float const wz = static_cast<float>(base_z + static_cast<int32_t>(z)) * spacing_;
+			for (uint32_t x = 0; x < stride; ++ x)
+			{
+				float const wx = static_cast<float>(base_x + static_cast<int32_t>(x)) * spacing_;
+				tile.heights[z * stride + x] = height_func_(wx, wz);
+			}
+		}
+
+		tile.min_max.resize(level_offsets_.back());
+		for (uint32_t z = 0; z < n; ++ z)
+		{
+			for (uint32_t x = 0; x < n; ++ x)
+			{
+				float const h00 = tile.heights[(z + 0) * stride + (x + 0)];
+				float const h10 = tile.heights[(z + 0) * stride + (x + 1)];
+				float const h01 = tile.heights[(z + 1) * stride + (x + 0)];
+				float const h11 = tile.heights[(z + 1) * stride + (x + 1)];
+				tile.min_max[z * n + x] = float2(std::min(std::min(h00, h10), std::min(h01, h11)),
+					std::max(std::max(h00, h10), std::max(h01, h11)));
+			}
+		}
+		for (uint32_t level = 1; level < tile_levels_; ++ level)
+		{
+			uint32_t const size = n >> level;
+			float2 const * src = &tile.min_max[level_offsets_[level - 1]];
+			float2* dst = &tile.min_max[level_offsets_[level]];
+			for (uint32_t z = 0; z < size; ++ z)
+			{
+				for (uint32_t x = 0; x < size; ++ x)
+				{
+					float2 const & c00 = src[(z * 2 + 0) * size * 2 + (x * 2 + 0)];
+					float2 const & c10 = src[(z * 2 + 0) * size * 2 + (x * 2 + 1)];
+					float2 const & c01 = src[(z * 2 + 1) * size * 2 + (x * 2 + 0)];
+					float2 const & c11 = src[(z * 2 + 1) * size * 2 + (x * 2 + 1)];
+					dst[z * size + x] = float2(std::min(std::min(c00.x(), c10.x()), std::min(c01.x(), c11.x())),
+						std::max(std::max(c00.y(), c10.y()), std::max(c01.y(), c11.y())));
+				}
+			}
+		}
+
+		++ num_generated_;
+	}
+
+	void HeightfieldCache::EvictLocked()
+	{
+		if (tiles_.size() <= max_tiles_)
+		{
+			return;
+		}
+
+		// Drop 1/8 more than needed, so the scan doesn't run on every new tile
+		size_t const target = max_tiles_ - max_tiles_ / 8;
+
+		std::vector<std::pair<uint64_t, uint64_t>> candidates;
+		for (auto const & tile : tiles_)
+		{
+			if (TS_Ready == tile.second->state)
+			{
+				candidates.emplace_back(tile.second->last_used, tile.first);
+			}
+		}
+
+		size_t const num_evicts = std::min(tiles_.size() - target, candidates.size());
+		std::nth_element(candidates.begin(), candidates.begin() + num_evicts, candidates.end());
+		for (size_t i = 0; i < num_evicts; ++ i)
+		{
+			tiles_.erase(candidates[i].second);
+		}
+	}
+
+	void HeightfieldCache::WorkerFunc()
+	{
+		for (;;)
+		{
+			TilePtr tile;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				while (!queue_.empty() && !tile)
+				{
+					// Skips the ones taken by queries, or dropped by Clear
+					if (TS_Queued == queue_.front()->state)
+					{
+						tile = queue_.front();
+						tile->state = TS_Generating;
+					}
+					queue_.pop_front();
+				}
+				if (!tile)
+				{
+					-- num_workers_;
+				}
+			}
+
+			if (!tile)
+			{
+				ready_cond_.notify_all();
+				break;
+			}
+
+			this->GenerateTile(*tile);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				tile->state = TS_Ready;
+			}
+			ready_cond_.notify_all();
+		}
+	}
+
+	HeightfieldCache::Tile const & HeightfieldCache::LocateCell(TilePtr& cursor, float x, float z,
+		uint32_t& cx, uint32_t& cz, float& fx, float& fz)
+	{
+		int32_t const n = static_cast<int32_t>(tile_size_);
+
+		float const gx = std::floor(x / spacing_);
+		float const gz = std::floor(z / spacing_);
+		fx = x / spacing_ - gx;
+		fz = z / spacing_ - gz;
+
+		int32_t const ix = static_cast<int32_t>(gx);
+		int32_t const iz = static_cast<int32_t>(gz);
+		int32_t const tx = FloorDiv(ix, n);
+		int32_t const tz = FloorDiv(iz, n);
+		cx = static_cast<uint32_t>(ix - tx * n);
+		cz = static_cast<uint32_t>(iz - tz * n);
+
+		return this->AcquireTile(cursor, tx, tz);
+	}
+
+	float HeightfieldCache::SampleHeight(TilePtr& cursor, float x, float z)
+	{
+		uint32_t cx, cz;
+		float fx, fz;
+		Tile const & tile = this->LocateCell(cursor, x, z, cx, cz, fx, fz);
+
+		uint32_t const stride = tile_size_ + 1;
+		float const h00 = tile.heights[(cz + 0) * stride + (cx + 0)];
+		float const h10 = tile.heights[(cz + 0) * stride + (cx + 1)];
+		float const h01 = tile.heights[(cz + 1) * stride + (cx + 0)];
+		float const h11 = tile.heights[(cz + 1) * stride + (cx + 1)];
+		if (fz >= fx)
+		{
+			return h00 + fz * (h01 - h00) + fx * (h11 - h01);
+		}
+		else
+		{
+			return h00 + fx * (h10 - h00) + fz * (h11 - h10);
+		}
+	}
+
+	float3 HeightfieldCache::SampleNormal(TilePtr& cursor, float x, float z)
+	{
+		uint32_t cx, cz;
+		float fx, fz;
+		Tile const & tile = this->LocateCell(cursor, x, z, cx, cz, fx, fz);
+
+		uint32_t const stride = tile_size_ + 1;
+		float const h00 = tile.heights[(cz + 0) * stride + (cx + 0)];
+		float const h10 = tile.heights[(cz + 0) * stride + (cx + 1)];
+		float const h01 = tile.heights[(cz + 1) * stride + (cx + 0)];
+		float const h11 = tile.heights[(cz + 1) * stride + (cx + 1)];
+		float dx, dz;
+		if (fz >= fx)
+		{
+			dx = h11 - h01;
+			dz = h01 - h00;
+		}
+		else
+		{
+			dx = h10 - h00;
+			dz = h11 - h10;
+		}
+		return MathLib::normalize(float3(-dx, spacing_, -dz));
+	}
+
+	bool HeightfieldCache::TraceRay(TilePtr& cursor, float3 const & orig, float3 const & dir, float max_dist,
+		float& dist)
+	{
+		BOOST_ASSERT(max_dist < std::numeric_limits<float>::max());
+
+		// In units of cells on x and z, so t is the same as in world space
+		float3 const o(orig.x() / spacing_, orig.y(), orig.z() / spacing_);
+		float3 const d(dir.x() / spacing_, dir.y(), dir.z() / spacing_);
+		float3 const inv_d(SafeRcp(d.x()), SafeRcp(d.y()), SafeRcp(d.z()));
+
+		// Walks the tiles along the ray in order, so the first hit is the closest one
+		float const n = static_cast<float>(tile_size_);
+		int32_t tx = FloorToInt(o.x() / n);
+		int32_t tz = FloorToInt(o.z() / n);
+		int32_t const step_x = (d.x() < 0) ? -1 : 1;
+		int32_t const step_z = (d.z() < 0) ? -1 : 1;
+		float const inf = std::numeric_limits<float>::max();
+		float t_next_x = (d.x() != 0) ? ((tx + (step_x > 0)) * n - o.x()) / d.x() : inf;
+		float t_next_z = (d.z() != 0) ? ((tz + (step_z > 0)) * n - o.z()) / d.z() : inf;
+		float const t_delta_x = (d.x() != 0) ? n / MathLib::abs(d.x()) : inf;
+		float const t_delta_z = (d.z() != 0) ? n / MathLib::abs(d.z()) : inf;
+
+		for (;;)
+		{
+			Tile const & tile = this->AcquireTile(cursor, tx, tz);
+			float3 const local_o(o.x() - tx * n, o.y(), o.z() - tz * n);
+			if (this->TraceTile(tile, local_o, d, inv_d, max_dist, dist))
+			{
+				return true;
+			}
+
+			if (t_next_x < t_next_z)
+			{
+				if (t_next_x >= max_dist)
+				{
+					break;
+				}
+				tx += step_x;
+				t_next_x += t_delta_x;
+			}
+			else
+			{
+				if (t_next_z >= max_dist)
+				{
+					break;
+				}
+				tz += step_z;
+				t_next_z += t_delta_z;
+			}
+		}
+
+		return false;
+	}
+
+	bool HeightfieldCache::TraceTile(Tile const & tile, float3 const & orig, float3 const & dir,
+		float3 const & inv_dir, float t_max, float& dist) const
+	{
+		struct Node
+		{
+			uint32_t level;
+			uint32_t x;
+			uint32_t z;
+		};
+
+		uint32_t const flip_x = (dir.x() < 0) ? 1 : 0;
+		uint32_t const flip_z = (dir.z() < 0) ? 1 : 0;
+		uint32_t const stride = tile_size_ + 1;
+
+		Node stack[MAX_TILE_LEVELS * 3 + 1];
+		uint32_t stack_size = 0;
+		stack[stack_size ++] = { tile_levels_ - 1, 0, 0 };
+
+		bool hit = false;
+		float closest = t_max;
+		while (stack_size > 0)
+		{
+			Node const node = stack[-- stack_size];
+
+			uint32_t const level_size = tile_size_ >> node.level;
+			float2 const & min_max = tile.min_max[level_offsets_[node.level] + node.z * level_size + node.x];
+			float const node_size = static_cast<float>(1U << node.level);
+			float3 const bb_min(node.x * node_size, min_max.x(), node.z * node_size);
+			float3 const bb_max(bb_min.x() + node_size, min_max.y(), bb_min.z() + node_size);
+			if (!IntersectBox(bb_min, bb_max, orig, inv_dir, closest))
+			{
+				continue;
+			}
+
+			if (0 == node.level)
+			{
+				float const fx = static_cast<float>(node.x);
+				float const fz = static_cast<float>(node.z);
+				float3 const v00(fx + 0, tile.heights[(node.z + 0) * stride + (node.x + 0)], fz + 0);
+				float3 const v10(fx + 1, tile.heights[(node.z + 0) * stride + (node.x + 1)], fz + 0);
+				float3 const v01(fx + 0, tile.heights[(node.z + 1) * stride + (node.x + 0)], fz + 1);
+				float3 const v11(fx + 1, tile.heights[(node.z + 1) * stride + (node.x + 1)], fz + 1);
+				hit |= IntersectTriangle(v00, v01, v11, orig, dir, closest);
+				hit |= IntersectTriangle(v00, v11, v10, orig, dir, closest);
+			}
+			else
+			{
+				// Pushed far to near, so the children closer to the origin are popped first
+				for (int i = 3; i >= 0; -- i)
+				{
+					uint32_t const cx = (i & 1) ^ flip_x;
+					uint32_t const cz = (i >> 1) ^ flip_z;
+					stack[stack_size ++] = { node.level - 1, node.x * 2 + cx, node.z * 2 + cz };
+				}
+			}
+		}
+
+		if (hit)
+		{
+			dist = closest;
+		}
+		return hit;
+	}
+}
@@ -20,6 +20,7 @@
 #include <KlayGE/PostProcess.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 #include <KFL/Half.hpp>
+#include <KlayGE/HeightfieldCache.hpp>
 
 #include <KlayGE/InfTerrain.hpp>
 
@@ -692,6 +693,11 @@ namespace KlayGE
 
 	float HQTerrainRenderable::GetHeight(float x, float z)
 	{
+		if (height_cache_)
+		{
+			return height_cache_->Height(x, z);
+		}
+
 		uint32_t const width = height_map_cpu_tex_->Width(0);
 		uint32_t const height = height_map_cpu_tex_->Height(0);
 
@@ -794,6 +800,16 @@ namespace KlayGE
 		checked_pointer_cast<HQTerrainRenderable>(renderable_)->TextureScale(layer, scale);
 	}
 
+	void HQTerrainSceneObject::HeightCache(HeightfieldCachePtr const & cache)
+	{
+		checked_pointer_cast<HQTerrainRenderable>(renderable_)->HeightCache(cache);
+	}
+
+	HeightfieldCachePtr const & HQTerrainSceneObject::HeightCache() const
+	{
+		return checked_pointer_cast<HQTerrainRenderable>(renderable_)->HeightCache();
+	}
+
 	float HQTerrainSceneObject::GetHeight(float x, float z)
 	{
 		return checked_pointer_cast<HQTerrainRenderable>(renderable_)->GetHeight(x, z);
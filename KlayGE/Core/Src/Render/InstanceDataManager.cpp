@@ -0,0 +1,196 @@
+/**
+ * @file InstanceDataManager.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/Hash.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/RenderDeviceCaps.hpp>
+#include <KlayGE/GraphicsBuffer.hpp>
+#include <KlayGE/SceneObject.hpp>
+#include <KlayGE/PerfProfiler.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <KlayGE/InstanceDataManager.hpp>
+
+namespace
+{
+	uint32_t const INIT_BUFFER_SIZE = 64 * 1024;
+	uint32_t const WORLD_MATRIX_SIZE = 3 * sizeof(KlayGE::float4);
+}
+
+namespace KlayGE
+{
+	InstanceDataManager::InstanceDataManager()
+		: use_no_overwrite_(false), committed_size_(0), num_bytes_uploaded_(0)
+	{
+	}
+
+	void InstanceDataManager::BeginFrame()
+	{
+		staging_.resize(0);
+		committed_size_ = 0;
+		packed_objs_.resize(0);
+		ranges_.clear();
+		num_bytes_uploaded_ = 0;
+	}
+
+	uint32_t InstanceDataManager::Allocate(ArrayRef<SceneObject const *> instances, uint32_t instance_size)
+	{
+		return this->DoAllocate(instances, instance_size, false);
+	}
+
+	uint32_t InstanceDataManager::AllocateWorldMatrices(ArrayRef<SceneObject const *> instances)
+	{
+		return this->DoAllocate(instances, WORLD_MATRIX_SIZE, true);
+	}
+
+	std::vector<VertexElement> const & InstanceDataManager::WorldMatrixFormat()
+	{
+		static std::vector<VertexElement> const vet =
+		{
+			VertexElement(VEU_TextureCoord, 5, EF_ABGR32F),
+			VertexElement(VEU_TextureCoord, 6, EF_ABGR32F),
+			VertexElement(VEU_TextureCoord, 7, EF_ABGR32F)
+		};
+		return vet;
+	}
+
+	uint32_t InstanceDataManager::DoAllocate(ArrayRef<SceneObject const *> instances, uint32_t instance_size, bool world)
+	{
+		BOOST_ASSERT(!instances.empty());
+		BOOST_ASSERT(instance_size > 0);
+
+		size_t seed = 0;
+		HashRange(seed, instances.begin(), instances.end());
+		HashCombine(seed, instance_size);
+		HashCombine(seed, world);
+
+		auto const range = ranges_.equal_range(seed);
+		for (auto iter = range.first; iter != range.second; ++ iter)
+		{
+			InstanceRange const & ir = iter->second;
+			if ((ir.world == world) && (ir.instance_size == instance_size) && (ir.num_objs == instances.size())
+				&& std::equal(instances.begin(), instances.end(), packed_objs_.begin() + ir.first_obj))
+			{
+				return ir.start_location;
+			}
+		}
+
+		uint32_t const start_location = static_cast<uint32_t>((staging_.size() + instance_size - 1) / instance_size);
+		uint32_t const offset = start_location * instance_size;
+		staging_.resize(offset + instances.size() * instance_size);
+		uint8_t* dst = &staging_[offset];
+		for (auto const & obj : instances)
+		{
+			if (world)
+			{
+				float4x4 const & mat = obj->AbsModelMatrix();
+				float4 const cols[] = { mat.Col(0), mat.Col(1), mat.Col(2) };
+				std::memcpy(dst, cols, sizeof(cols));
+			}
+			else
+			{
+				BOOST_ASSERT(obj->InstanceFormat() == instances[0]->InstanceFormat());
+
+				std::memcpy(dst, obj->InstanceData(), instance_size);
+			}
+			dst += instance_size;
+		}
+
+		InstanceRange ir;
+		ir.first_obj = static_cast<uint32_t>(packed_objs_.size());
+		ir.num_objs = static_cast<uint32_t>(instances.size());
+		ir.instance_size = instance_size;
+		ir.start_location = start_location;
+		ir.world = world;
+		ranges_.emplace(seed, ir);
+		packed_objs_.insert(packed_objs_.end(), instances.begin(), instances.end());
+
+		return start_location;
+	}
+
+	void InstanceDataManager::Commit()
+	{
+		uint32_t const size = static_cast<uint32_t>(staging_.size());
+		if (size == committed_size_)
+		{
+			return;
+		}
+
+		if (!buffer_ || (buffer_->Size() < size))
+		{
+			// Grow geometrically, so a growing scene doesn't reallocate every frame
+			uint32_t new_size = buffer_ ? buffer_->Size() : INIT_BUFFER_SIZE;
+			while (new_size < size)
+			{
+				new_size *= 2;
+			}
+
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			use_no_overwrite_ = rf.RenderEngineInstance().DeviceCaps().no_overwrite_support;
+			buffer_ = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, new_size, nullptr);
+
+			// Layouts bound to the old buffer are rebound when they render next, so the new one needs the whole frame
+			committed_size_ = 0;
+		}
+
+		if (0 == committed_size_)
+		{
+			GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_Only);
+			std::memcpy(mapper.Pointer<uint8_t>(), &staging_[0], size);
+		}
+		else if (use_no_overwrite_)
+		{
+			GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_No_Overwrite);
+			std::memcpy(mapper.Pointer<uint8_t>() + committed_size_, &staging_[committed_size_], size - committed_size_);
+		}
+		else
+		{
+			buffer_->UpdateSubresource(committed_size_, size - committed_size_, &staging_[committed_size_]);
+		}
+
+		uint32_t const num_bytes = size - committed_size_;
+		num_bytes_uploaded_ += num_bytes;
+#ifndef KLAYGE_SHIP
+		if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+		{
+			profiler->IncCounter(PCT_InstanceUploadBytes, num_bytes);
+		}
+#endif
+
+		committed_size_ = size;
+	}
+}
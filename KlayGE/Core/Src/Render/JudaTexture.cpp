@@ -30,6 +30,10 @@ namespace
 
 	uint32_t const JUDA_TEX_VERSION = 2;
 
+	uint32_t const DEFAULT_DECODE_BUDGET = 16;
+
+	uint32_t const NUM_BITS[] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
 	void u8_copy_1(uint8_t* output, uint8_t const * rhs)
 	{
 		*output = *rhs;
@@ -114,10 +118,11 @@ namespace KlayGE
 	int const THRESHOLD_BIAS = 10;
 
 	JudaTexture::JudaTexture(uint32_t num_tiles, uint32_t tile_size, ElementFormat format)
-		: root_(MakeSharedPtr<quadtree_node>()),
+		: nodes_(1),
 			num_tiles_(num_tiles), tile_size_(tile_size), format_(format),
 			texel_size_(NumFormatBytes(format)),
-			decode_tick_(0), tile_tick_(0)
+			decode_tick_(0), tile_tick_(0),
+			decode_budget_(DEFAULT_DECODE_BUDGET), decode_finished_(false)
 	{
 		BOOST_ASSERT(num_tiles_ <= MAX_NUM_TILES);
 		BOOST_ASSERT(tile_size_ <= MAX_TILE_SIZE);
@@ -178,6 +183,11 @@ namespace KlayGE
 		}
 	}
 
+	JudaTexture::~JudaTexture()
+	{
+		this->WaitForCacheTiles();
+	}
+
 	uint32_t JudaTexture::EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const
 	{
 		BOOST_ASSERT(level <= MAX_TREE_LEVEL);
@@ -196,7 +206,7 @@ namespace KlayGE
 
 	uint32_t JudaTexture::NumNonEmptyNodes() const
 	{
-		return this->NumNonEmptySubNodes(root_);
+		return this->NumNonEmptySubNodes(0);
 	}
 
 	uint32_t JudaTexture::NumTiles() const
@@ -226,20 +236,25 @@ namespace KlayGE
 			return;
 		}
 
-		quadtree_node_ptr const & node = this->GetNode(shuff);
-		for (int i = 0; i < 4; ++ i)
+		uint32_t const node = this->GetNode(shuff);
+		for (uint32_t i = 0; i < 4; ++ i)
 		{
-			if (node->children[i])
+			uint32_t const child = this->ChildNode(node, i);
+			if (child != EMPTY_NODE_INDEX)
 			{
 				this->CompactNode(this->GetChildShuff(shuff, i));
 
-				if ((EMPTY_DATA_INDEX == node->children[i]->data_index)
-					&& !node->children[i]->children[0]
-					&& !node->children[i]->children[1]
-					&& !node->children[i]->children[2]
-					&& !node->children[i]->children[3])
+				if ((EMPTY_DATA_INDEX == nodes_[child].data_index) && (0 == (nodes_[child].children & 0xF)))
 				{
-					node->children[i].reset();
+					// Close the gap, so the remaining children stay contiguous
+					uint32_t const first = nodes_[node].children >> 4;
+					uint32_t const mask = nodes_[node].children & 0xF;
+					uint32_t const num_children = NUM_BITS[mask];
+					for (uint32_t j = child; j < first + num_children - 1; ++ j)
+					{
+						nodes_[j] = nodes_[j + 1];
+					}
+					nodes_[node].children = (first << 4) | (mask & ~(1UL << i));
 				}
 			}
 		}
@@ -260,13 +275,17 @@ namespace KlayGE
 
 	void JudaTexture::CommitTiles(std::vector<std::vector<uint8_t>> const & data, std::vector<uint32_t> const & tile_ids, std::vector<uint32_t> const & tile_attrs)
 	{
+		// The decode job reads the tree. What it decoded is out of date after the commit.
+		this->DiscardCacheTiles();
+		decoded_block_cache_.clear();
+
 		uint32_t const full_tile_bytes = tile_size_ * tile_size_ * texel_size_;
 
-		if (EMPTY_DATA_INDEX == root_->data_index)
+		if (EMPTY_DATA_INDEX == nodes_[0].data_index)
 		{
-			root_->data_index = this->AllocateDataBlock();
-			root_->attr = 0xFFFFFFFF;
-			data_blocks_[root_->data_index].resize(full_tile_bytes, 0);
+			nodes_[0].data_index = this->AllocateDataBlock();
+			nodes_[0].attr = 0xFFFFFFFF;
+			data_blocks_[nodes_[0].data_index].resize(full_tile_bytes, 0);
 		}
 
 		std::vector<uint32_t> shuffs(tile_ids.size());
@@ -276,13 +295,13 @@ namespace KlayGE
 			this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
 			shuffs[i] = this->Pos2Shuff(level, tile_x, tile_y);
 
-			quadtree_node_ptr node = this->AddNode(shuffs[i]);
-			if (EMPTY_DATA_INDEX == node->data_index)
+			quadtree_node& node = nodes_[this->AddNode(shuffs[i])];
+			if (EMPTY_DATA_INDEX == node.data_index)
 			{
-				node->data_index = this->AllocateDataBlock();
+				node.data_index = this->AllocateDataBlock();
 			}
-			node->attr = tile_attrs[i];
-			data_blocks_[node->data_index] = data[i];
+			node.attr = tile_attrs[i];
+			data_blocks_[node.data_index] = data[i];
 		}
 		
 		for (uint32_t ll = 0; ll < tree_levels_ - 1; ll += lower_levels_)
@@ -303,27 +322,25 @@ namespace KlayGE
 			for (size_t i = 0; i < upper_shuffs.size(); ++ i)
 			{
 				uint32_t shuff = upper_shuffs[i];
-				quadtree_node_ptr node = this->GetNode(shuff);
-				if (EMPTY_DATA_INDEX == node->data_index)
+				quadtree_node& node = nodes_[this->GetNode(shuff)];
+				if (EMPTY_DATA_INDEX == node.data_index)
 				{
-					node->data_index = this->AllocateDataBlock();
+					node.data_index = this->AllocateDataBlock();
 				}
-				node->attr = 0xFFFFFFFF;
-				data_blocks_[node->data_index].resize(full_tile_bytes);
-				this->DecodeATile(&data_blocks_[node->data_index], shuff, 1);
+				node.attr = 0xFFFFFFFF;
+				data_blocks_[node.data_index].resize(full_tile_bytes);
+				this->DecodeATile(&data_blocks_[node.data_index], shuff, 1);
 			}
 
 			for (size_t i = 0; i < shuffs.size(); ++ i)
 			{
 				uint32_t shuff = shuffs[i];
-				quadtree_node_ptr node = this->GetNode(shuff);
-
 				int offset_x = 0;
 				int offset_y = 0;
-				std::vector<uint8_t> up_data = data_blocks_[node->data_index];
+				std::vector<uint8_t> up_data = data_blocks_[nodes_[this->GetNode(shuff)].data_index];
 				for (int level = tree_levels_ - 1 - ll; level > std::max(0, static_cast<int>(tree_levels_ - 1 - ll - lower_levels_)); -- level)
 				{
-					node = this->GetNode(shuff);
+					quadtree_node& node = nodes_[this->GetNode(shuff)];
 
 					uint32_t level_tile_size = tile_size_ >> (tree_levels_ - 1 - ll - level);
 
@@ -333,20 +350,20 @@ namespace KlayGE
 					std::vector<uint8_t> temp_down(level_tile_size * level_tile_size * texel_size_);
 					this->Upsample(&temp_down[0], &temp_up[0], level_tile_size / 2, level_tile_size / 2, level_tile_size / 2 * texel_size_);
 
-					if (EMPTY_DATA_INDEX == node->data_index)
+					if (EMPTY_DATA_INDEX == node.data_index)
 					{
-						node->data_index = this->AllocateDataBlock();
+						node.data_index = this->AllocateDataBlock();
 					}
 					if (level != static_cast<int>(tree_levels_) - 1)
 					{
-						node->attr = 0xFFFFFFFF;
+						node.attr = 0xFFFFFFFF;
 					}
-					data_blocks_[node->data_index].resize(full_tile_bytes);
+					data_blocks_[node.data_index].resize(full_tile_bytes);
 					for (size_t y = 0; y < level_tile_size; ++ y)
 					{
 						for (size_t x = 0; x < level_tile_size; ++ x)
 						{
-							texel_op_.sub(&data_blocks_[node->data_index][((offset_y + y) * tile_size_ + (offset_x + x)) * texel_size_],
+							texel_op_.sub(&data_blocks_[node.data_index][((offset_y + y) * tile_size_ + (offset_x + x)) * texel_size_],
 								&up_data[(y * level_tile_size + x) * texel_size_], &temp_down[(y * level_tile_size + x) * texel_size_]);
 						}
 					}
@@ -356,16 +373,16 @@ namespace KlayGE
 					{
 						for (uint32_t x = 0; x < tile_size_; ++ x)
 						{
-							mse += texel_op_.mse(&data_blocks_[node->data_index][(y * tile_size_ + x) * texel_size_]);
-							bias = texel_op_.bias(bias, &data_blocks_[node->data_index][(y * tile_size_ + x) * texel_size_]);
+							mse += texel_op_.mse(&data_blocks_[node.data_index][(y * tile_size_ + x) * texel_size_]);
+							bias = texel_op_.bias(bias, &data_blocks_[node.data_index][(y * tile_size_ + x) * texel_size_]);
 						}
 					}
 					mse /= MathLib::sqr(tile_size_ * 255);
 					if ((mse < THRESHOLD_MSE) && (bias < THRESHOLD_BIAS))
 					{
-						this->DeallocateDataBlock(node->data_index);
-						node->data_index = EMPTY_DATA_INDEX;
-						node->attr = 0xFFFFFFFF;
+						this->DeallocateDataBlock(node.data_index);
+						node.data_index = EMPTY_DATA_INDEX;
+						node.attr = 0xFFFFFFFF;
 					}
 
 					uint32_t branch = this->GetLevelBranch(shuff, level);
@@ -380,7 +397,7 @@ namespace KlayGE
 				{
 					int level = std::max(0, static_cast<int>(tree_levels_ - 1 - ll - lower_levels_));
 
-					uint32_t data_index = this->GetNode(shuff)->data_index;
+					uint32_t data_index = nodes_[this->GetNode(shuff)].data_index;
 					uint32_t level_tile_size = tile_size_ >> (tree_levels_ - 1 - ll - level);
 
 					for (uint32_t y = 0; y < level_tile_size; ++ y)
@@ -398,12 +415,16 @@ namespace KlayGE
 
 			shuffs.swap(upper_shuffs);
 		}
+
+		this->LayoutNodes();
 	}
 
 	void JudaTexture::DecodeTiles(std::vector<std::vector<uint8_t>>& data, std::vector<uint32_t> const & tile_ids, uint32_t mipmaps)
 	{
 		BOOST_ASSERT(mipmaps - 1 <= lower_levels_);
 
+		std::lock_guard<std::mutex> lock(decode_mutex_);
+
 		data.resize(tile_ids.size() * mipmaps);
 		std::vector<std::pair<uint32_t, uint32_t>> shuffs(tile_ids.size());
 		for (size_t i = 0; i < tile_ids.size(); ++ i)
@@ -452,10 +473,10 @@ namespace KlayGE
 		uint32_t const full_tile_bytes = cache_tile_size_ * cache_tile_size_ * texel_size_;
 		uint32_t target_level = this->ShuffLevel(shuff);
 
-		quadtree_node_ptr node = root_;
+		uint32_t node = 0;
 		if (0 == target_level)
 		{
-			std::memcpy(&data[0][0], this->RetriveATile(root_->data_index), full_tile_bytes);
+			std::memcpy(&data[0][0], this->RetriveATile(nodes_[0].data_index), full_tile_bytes);
 		}
 		else
 		{
@@ -508,7 +529,7 @@ namespace KlayGE
 						uint8_t const * src;
 						if (1 == ll_b)
 						{
-							src = this->RetriveATile(root_->data_index);
+							src = this->RetriveATile(nodes_[0].data_index);
 						}
 						else
 						{
@@ -524,15 +545,15 @@ namespace KlayGE
 					start_sub_tile_x &= ~(1UL << (tree_levels_ - 1 - i));
 					start_sub_tile_y &= ~(1UL << (tree_levels_ - 1 - i));
 
-					if (node)
+					if (node != EMPTY_NODE_INDEX)
 					{
-						node = node->children[branches[i]];
+						node = this->ChildNode(node, branches[i]);
 				
-						if (node && (node->data_index != EMPTY_DATA_INDEX))
+						if ((node != EMPTY_NODE_INDEX) && (nodes_[node].data_index != EMPTY_DATA_INDEX))
 						{
 							uint32_t start_x = (start_sub_tile_x >> shift) * used_w * 2;
 							uint32_t start_y = (start_sub_tile_y >> shift) * used_h * 2;
-							uint8_t const * start_src = this->RetriveATile(node->data_index) + (start_y * tile_size_ + start_x) * texel_size_;
+							uint8_t const * start_src = this->RetriveATile(nodes_[node].data_index) + (start_y * tile_size_ + start_x) * texel_size_;
 							uint8_t* dst = &temp[0];
 							for (size_t y = 0; y < used_h * 2; ++ y)
 							{
@@ -558,15 +579,15 @@ namespace KlayGE
 		}
 	}
 
-	uint32_t JudaTexture::DecodeAAttr(uint32_t shuff)
+	uint32_t JudaTexture::DecodeAAttr(uint32_t shuff) const
 	{
 		uint32_t target_level = this->ShuffLevel(shuff);
 
 		uint32_t ret_attr = 0xFFFFFFFF;
-		quadtree_node_ptr node = root_;
+		uint32_t node = 0;
 		if (0 == target_level)
 		{
-			ret_attr = root_->attr;
+			ret_attr = nodes_[0].attr;
 		}
 		else
 		{
@@ -593,13 +614,13 @@ namespace KlayGE
 
 				for (uint32_t i = ll_b, i_end = std::min(target_level + 1, ll_e); i < i_end; ++ i)
 				{
-					if (node)
+					if (node != EMPTY_NODE_INDEX)
 					{
-						node = node->children[branches[i]];
+						node = this->ChildNode(node, branches[i]);
 				
-						if (node)
+						if (node != EMPTY_NODE_INDEX)
 						{
-							ret_attr = node->attr;
+							ret_attr = nodes_[node].attr;
 						}
 					}
 				}
@@ -677,59 +698,113 @@ namespace KlayGE
 		}
 	}
 
-	uint32_t JudaTexture::NumNonEmptySubNodes(quadtree_node_ptr const & node) const
+	uint32_t JudaTexture::NumNonEmptySubNodes(uint32_t node) const
 	{
 		uint32_t n = 0;
-		if (node->data_index != EMPTY_DATA_INDEX)
+		if (nodes_[node].data_index != EMPTY_DATA_INDEX)
 		{
 			++ n;
 		}
-		for (size_t i = 0; i < 4; ++ i)
+		uint32_t const first = nodes_[node].children >> 4;
+		for (uint32_t i = 0, num_children = NUM_BITS[nodes_[node].children & 0xF]; i < num_children; ++ i)
 		{
-			if (node->children[i])
-			{
-				n += this->NumNonEmptySubNodes(node->children[i]);
-			}
+			n += this->NumNonEmptySubNodes(first + i);
 		}
 		return n;
 	}
 
-	JudaTexture::quadtree_node_ptr const & JudaTexture::GetNode(uint32_t shuff)
+	uint32_t JudaTexture::ChildNode(uint32_t node, uint32_t branch) const
+	{
+		uint32_t const children = nodes_[node].children;
+		uint32_t const mask = children & 0xF;
+		if (mask & (1UL << branch))
+		{
+			return (children >> 4) + NUM_BITS[mask & ((1UL << branch) - 1)];
+		}
+		else
+		{
+			return EMPTY_NODE_INDEX;
+		}
+	}
+
+	uint32_t JudaTexture::GetNode(uint32_t shuff) const
 	{
 		uint32_t target_level = this->ShuffLevel(shuff);
-		quadtree_node_ptr* node = &root_;
-		for (uint32_t level = 1; level <= target_level; ++ level)
+		uint32_t node = 0;
+		for (uint32_t level = 1; (level <= target_level) && (node != EMPTY_NODE_INDEX); ++ level)
 		{
-			uint32_t branch = this->GetLevelBranch(shuff, level);
-			if (*node)
-			{
-				node = &((*node)->children[branch]);
-			}
-			else
+			node = this->ChildNode(node, this->GetLevelBranch(shuff, level));
+		}
+
+		return node;
+	}
+
+	void JudaTexture::LayoutNodes()
+	{
+		// Breadth first. Children are kept in branch order, so every level ends up in Morton order.
+		//   It also drops the blocks left unused by AddNode and CompactNode.
+		std::vector<quadtree_node> nodes;
+		std::vector<uint32_t> old_indices;
+		nodes.reserve(nodes_.size());
+		old_indices.reserve(nodes_.size());
+		nodes.push_back(nodes_[0]);
+		old_indices.push_back(0);
+		for (size_t i = 0; i < nodes.size(); ++ i)
+		{
+			uint32_t const old_first = nodes_[old_indices[i]].children >> 4;
+			uint32_t const mask = nodes_[old_indices[i]].children & 0xF;
+			uint32_t const new_first = static_cast<uint32_t>(nodes.size());
+			for (uint32_t j = 0; j < NUM_BITS[mask]; ++ j)
 			{
-				break;
+				nodes.push_back(nodes_[old_first + j]);
+				old_indices.push_back(old_first + j);
 			}
+			nodes[i].children = (new_first << 4) | mask;
 		}
-
-		return *node;
+		nodes_.swap(nodes);
 	}
 
-	JudaTexture::quadtree_node_ptr const & JudaTexture::AddNode(uint32_t shuff)
+	uint32_t JudaTexture::AddNode(uint32_t shuff)
 	{
 		uint32_t target_level = this->ShuffLevel(shuff);
-		quadtree_node_ptr* node = &root_;
+		uint32_t node = 0;
 		for (uint32_t level = 1; level <= target_level; ++ level)
 		{
 			uint32_t branch = this->GetLevelBranch(shuff, level);
-			if (!(*node)->children[branch])
+			uint32_t child = this->ChildNode(node, branch);
+			if (EMPTY_NODE_INDEX == child)
 			{
-				(*node)->children[branch] = MakeSharedPtr<quadtree_node>();
+				// Move the siblings to the end of the array, next to the new child. The old block is left unused.
+				uint32_t const old_first = nodes_[node].children >> 4;
+				uint32_t const old_mask = nodes_[node].children & 0xF;
+				uint32_t const new_first = static_cast<uint32_t>(nodes_.size());
+				BOOST_ASSERT(new_first <= 0x0FFFFFFF);
+
+				nodes_.resize(nodes_.size() + NUM_BITS[old_mask] + 1);
+				uint32_t old_index = old_first;
+				uint32_t new_index = new_first;
+				for (uint32_t i = 0; i < 4; ++ i)
+				{
+					if (i == branch)
+					{
+						child = new_index;
+						++ new_index;
+					}
+					else if (old_mask & (1UL << i))
+					{
+						nodes_[new_index] = nodes_[old_index];
+						++ old_index;
+						++ new_index;
+					}
+				}
+
+				nodes_[node].children = (new_first << 4) | old_mask | (1UL << branch);
 			}
-			
-			node = &((*node)->children[branch]);
+
+			node = child;
 		}
 
-		return *node;
+		return node;
 	}
 
 	uint32_t JudaTexture::ShuffLevel(uint32_t shuff) const
@@ -925,25 +1000,36 @@ namespace KlayGE
 
 		uint32_t data_index = 0;
 
-		std::vector<JudaTexture::quadtree_node_ptr> last_level;
-		std::vector<uint32_t> last_start_index_levels;
+		// Levels are stored one after another, so a node's children index into the next level
+		std::vector<JudaTexture::quadtree_node>& nodes = ret->nodes_;
+		nodes.clear();
+		uint32_t level_start = 0;
 		for (size_t i = 0; i < tree_levels; ++ i)
 		{
 			uint32_t size;
 			file->read(&size, sizeof(size));
 
-			std::vector<JudaTexture::quadtree_node_ptr> this_level(size);
+			uint32_t const next_level_start = level_start + size;
+			nodes.resize(next_level_start);
+
 			std::vector<uint32_t> this_start_index_levels(size);
 			file->read(&this_start_index_levels[0], size * sizeof(this_start_index_levels[0]));
 			for (size_t j = 0; j < size; ++ j)
 			{
-				this_level[j] = MakeSharedPtr<JudaTexture::quadtree_node>();
+				JudaTexture::quadtree_node& node = nodes[level_start + j];
 
 				if (!(this_start_index_levels[j] >> 31))
 				{
-					this_level[j]->data_index = data_index;
+					node.data_index = data_index;
 					++ data_index;
 				}
+
+				if ((this_start_index_levels[j] & 0x7FFFFFF0) != 0x7FFFFFF0)
+				{
+					uint32_t start_index = (this_start_index_levels[j] & 0x7FFFFFFF) >> 4;
+					uint32_t mask = this_start_index_levels[j] & 0xF;
+					node.children = ((next_level_start + start_index) << 4) | mask;
+				}
 			}
 			if (i == tree_levels - 1)
 			{
@@ -951,45 +1037,11 @@ namespace KlayGE
 				file->read(&this_attr_levels[0], size * sizeof(this_attr_levels[0]));
 				for (size_t j = 0; j < size; ++ j)
 				{
-					this_level[j]->attr = this_attr_levels[j];
-				}
-			}
-			else
-			{
-				for (size_t j = 0; j < size; ++ j)
-				{
-					this_level[j]->attr = 0xFFFFFFFF;
+					nodes[level_start + j].attr = this_attr_levels[j];
 				}
 			}
 
-			if (i > 0)
-			{
-				for (size_t j = 0; j < last_start_index_levels.size(); ++ j)
-				{
-					if ((last_start_index_levels[j] & 0x7FFFFFF0) != 0x7FFFFFF0)
-					{
-						uint32_t start_index = (last_start_index_levels[j] & 0x7FFFFFFF) >> 4;
-						uint32_t mask = last_start_index_levels[j] & 0xF;
-
-						int l = 0;
-						for (size_t k = 0; k < 4; ++ k)
-						{
-							if (mask & (1UL << k))
-							{
-								last_level[j]->children[k] = this_level[start_index + l];
-								++ l;
-							}
-						}
-					}
-				}
-			}
-			else
-			{
-				ret->root_ = this_level[0];
-			}
-
-			last_level.swap(this_level);
-			last_start_index_levels.swap(this_start_index_levels);
+			level_start = next_level_start;
 		}
 
 		ret->input_file_ = file;
@@ -1003,8 +1055,9 @@ namespace KlayGE
 	{
 		LZMACodec lzma_enc;
 
-		std::vector<JudaTexture::quadtree_node_ptr> this_level;
-		std::vector<JudaTexture::quadtree_node_ptr> next_level;
+		std::vector<JudaTexture::quadtree_node> const & nodes = juda_tex->nodes_;
+		std::vector<uint32_t> this_level;
+		std::vector<uint32_t> next_level;
 
 		std::shared_ptr<std::ostream> ofs = MakeSharedPtr<std::ofstream>(file_name.c_str(), std::ios_base::out | std::ios_base::binary);
 		
@@ -1047,7 +1100,7 @@ namespace KlayGE
 		std::vector<uint32_t> non_empty_block_data_index;
 		non_empty_block_data_index.reserve(non_empty_nodes);
 
-		this_level.push_back(juda_tex->root_);
+		this_level.push_back(0);
 		for (size_t i = 0; i < juda_tex->TreeLevels(); ++ i)
 		{
 			uint32_t size = static_cast<uint32_t>(this_level.size());
@@ -1057,11 +1110,11 @@ namespace KlayGE
 			next_level.reserve(this_level.size() * 4);
 			for (size_t j = 0; j < this_level.size(); ++ j)
 			{
+				JudaTexture::quadtree_node const & node = nodes[this_level[j]];
+
 				uint32_t index;
-				if (!this_level[j]->children[0]
-					&& !this_level[j]->children[1]
-					&& !this_level[j]->children[2]
-					&& !this_level[j]->children[3])
+				uint32_t const mask = node.children & 0xF;
+				if (0 == mask)
 				{
 					index = 0x7FFFFFFF;
 				}
@@ -1069,25 +1122,22 @@ namespace KlayGE
 				{
 					BOOST_ASSERT(num_nodes <= 0x07FFFFFF);
 
-					index = num_nodes << 4;
+					index = (num_nodes << 4) | mask;
 
-					for (size_t k = 0; k < 4; ++ k)
+					uint32_t const first = node.children >> 4;
+					for (uint32_t k = 0, num_children = NUM_BITS[mask]; k < num_children; ++ k)
 					{
-						if (this_level[j]->children[k])
-						{
-							next_level.push_back(this_level[j]->children[k]);
-							index |= (1UL << k);
-							++ num_nodes;
-						}
+						next_level.push_back(first + k);
+						++ num_nodes;
 					}
 				}
-				if (JudaTexture::EMPTY_DATA_INDEX == this_level[j]->data_index)
+				if (JudaTexture::EMPTY_DATA_INDEX == node.data_index)
 				{
 					index |= 1UL << 31;
 				}
 				else
 				{
-					non_empty_block_data_index.push_back(this_level[j]->data_index);
+					non_empty_block_data_index.push_back(node.data_index);
 				}
 				ofs->write(reinterpret_cast<char const *>(&index), sizeof(index));
 			}
@@ -1096,7 +1146,7 @@ namespace KlayGE
 			{
 				for (size_t j = 0; j < this_level.size(); ++ j)
 				{
-					ofs->write(reinterpret_cast<char const *>(&this_level[j]->attr), sizeof(this_level[j]->attr));
+					ofs->write(reinterpret_cast<char const *>(&nodes[this_level[j]].attr), sizeof(nodes[this_level[j]].attr));
 				}
 			}
 
@@ -1133,6 +1183,8 @@ namespace KlayGE
 
 	void JudaTexture::CacheProperty(uint32_t pages, ElementFormat format, uint32_t border_size, uint32_t cache_tile_size)
 	{
+		this->DiscardCacheTiles();
+
 		if (!tex_cache_ && tex_cache_array_.empty())
 		{
 			pages = std::min<uint32_t>(pages, 1024U);
@@ -1203,7 +1255,13 @@ namespace KlayGE
 
 			tex_indirect_ = rf.MakeTexture2D(num_tiles_, num_tiles_, 1, 1, EF_ABGR8, 1, 0, EAH_GPU_Read);
 
-			tile_free_list_.emplace_back(0, pages);
+			uint32_t const num_layers = tex_cache_ ? tex_cache_->ArraySize() : array_size;
+			TileInfo empty_slot;
+			empty_slot.tile_id = 0xFFFFFFFF;
+			empty_slot.attr = 0xFFFFFFFF;
+			empty_slot.tick = 0;
+			cache_slots_.assign(std::min(pages, s * s * num_layers), empty_slot);
+			tile_slots_.assign(((1UL << (2 * tree_levels_)) - 1) / 3, 0xFFFFFFFF);
 		}
 	}
 
@@ -1253,138 +1311,220 @@ namespace KlayGE
 
 		++ tile_tick_;
 
-		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
-		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
-		uint32_t const tex_layer = tex_cache_ ? tex_cache_->ArraySize() : static_cast<uint32_t>(tex_cache_array_.size());
-		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+		tile_requests_.clear();
+		for (auto const tile_id : tile_ids)
+		{
+			uint32_t const slot = tile_slots_[this->TileSlotIndex(tile_id)];
+			if ((slot != 0xFFFFFFFF) && (cache_slots_[slot].tile_id == tile_id))
+			{
+				// Exists in cache
 
-		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
-		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
-		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+				cache_slots_[slot].tick = tile_tick_;
+			}
+			else if (std::find(decoding_tile_ids_.begin(), decoding_tile_ids_.end(), tile_id) == decoding_tile_ids_.end())
+			{
+				tile_requests_.push_back(tile_id);
+			}
+		}
+
+		if (decode_thread_ && decode_finished_)
+		{
+			this->WaitForCacheTiles();
+			this->UploadCacheTiles(decoded_tiles_);
+			decoded_tiles_.clear();
+			decoding_tile_ids_.clear();
+		}
+
+		if (!decode_thread_ && !tile_requests_.empty())
+		{
+			// Coarser tiles first, they cover more of the screen. Requests of a level keep their order.
+			std::stable_sort(tile_requests_.begin(), tile_requests_.end(),
+				[](uint32_t lhs, uint32_t rhs)
+				{
+					return (lhs >> LEVEL_SHIFT) < (rhs >> LEVEL_SHIFT);
+				});
+			for (size_t i = 0; (i < tile_requests_.size()) && (decoding_tile_ids_.size() < decode_budget_); ++ i)
+			{
+				if (std::find(decoding_tile_ids_.begin(), decoding_tile_ids_.end(), tile_requests_[i]) == decoding_tile_ids_.end())
+				{
+					decoding_tile_ids_.push_back(tile_requests_[i]);
+				}
+			}
+
+			decode_finished_ = false;
+			decode_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+				[this]
+				{
+					this->BuildCacheTiles(decoded_tiles_, decoding_tile_ids_);
+					decode_finished_ = true;
+				}));
+		}
+	}
+
+	uint32_t JudaTexture::DecodeBudget() const
+	{
+		return decode_budget_;
+	}
+
+	void JudaTexture::DecodeBudget(uint32_t num_tiles)
+	{
+		BOOST_ASSERT(num_tiles > 0);
+		decode_budget_ = num_tiles;
+	}
+
+	void JudaTexture::WaitForCacheTiles()
+	{
+		if (decode_thread_)
+		{
+			(*decode_thread_)();
+			decode_thread_.reset();
+		}
+	}
+
+	void JudaTexture::DiscardCacheTiles()
+	{
+		this->WaitForCacheTiles();
+		decoded_tiles_.clear();
+		decoding_tile_ids_.clear();
+	}
+
+	uint32_t JudaTexture::TileSlotIndex(uint32_t tile_id) const
+	{
+		uint32_t level, tile_x, tile_y;
+		this->DecodeTileID(level, tile_x, tile_y, tile_id);
+		BOOST_ASSERT(level < tree_levels_);
+		BOOST_ASSERT((tile_x < (1UL << level)) && (tile_y < (1UL << level)));
+
+		// Levels are stored from coarse to fine, tiles of a level in Morton order
+		uint32_t index = ((1UL << (2 * level)) - 1) / 3;
+		for (uint32_t l = 0; l < level; ++ l)
+		{
+			index += (((tile_x >> l) & 1UL) << (2 * l)) | (((tile_y >> l) & 1UL) << (2 * l + 1));
+		}
+		return index;
+	}
+
+	void JudaTexture::BuildCacheTiles(std::vector<CacheTileData>& tiles, std::vector<uint32_t> const & tile_ids)
+	{
+		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
 
 		std::unordered_map<uint32_t, uint32_t> neighbor_id_map;
 		std::vector<uint32_t> all_neighbor_ids;
 		std::vector<uint32_t> neighbor_ids;
 		std::vector<uint32_t> tile_attrs;
 		std::vector<bool> in_same_image;
-		auto& tim = tile_info_map_;
 		for (size_t i = 0; i < tile_ids.size(); ++ i)
 		{
-			auto tmiter = tim.find(tile_ids[i]);
-			if (tmiter != tim.end())
-			{
-				// Exists in cache
-
-				tmiter->second.tick = tile_tick_;
-			}
-			else
-			{
-				uint32_t level, tile_x, tile_y;
-				this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
 
-				std::array<uint32_t, 9> new_tile_id_with_neighbors;
-				new_tile_id_with_neighbors.fill(0xFFFFFFFF);
-				new_tile_id_with_neighbors[0] = tile_ids[i];
+			std::array<uint32_t, 9> new_tile_id_with_neighbors;
+			new_tile_id_with_neighbors.fill(0xFFFFFFFF);
+			new_tile_id_with_neighbors[0] = tile_ids[i];
 
-				std::array<bool, 9> new_in_same_image;
-				new_in_same_image.fill(false);
-				new_in_same_image[0] = true;
+			std::array<bool, 9> new_in_same_image;
+			new_in_same_image.fill(false);
+			new_in_same_image[0] = true;
 
-				uint32_t attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
-				tile_attrs.push_back(attr);
-				if (attr != 0xFFFFFFFF)
-				{
-					std::array<int32_t, 9> new_tile_id_x;
-					std::array<int32_t, 9> new_tile_id_y;
+			uint32_t attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
+			tile_attrs.push_back(attr);
+			if (attr != 0xFFFFFFFF)
+			{
+				std::array<int32_t, 9> new_tile_id_x;
+				std::array<int32_t, 9> new_tile_id_y;
 
-					int32_t left = tile_x - 1;
-					int32_t right = tile_x + 1;
-					int32_t up = tile_y - 1;
-					int32_t down = tile_y + 1;
+				int32_t left = tile_x - 1;
+				int32_t right = tile_x + 1;
+				int32_t up = tile_y - 1;
+				int32_t down = tile_y + 1;
 
-					ImageEntry const & entry = image_entries_[attr];
-					if (TAM_Wrap == (entry.addr_u_v & 0xF))
-					{
-						left = entry.x + (left - entry.x + entry.w) % entry.w;
-						right = entry.x + (right - entry.x + entry.w) % entry.w;
-					}
-					if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
-					{
-						up = entry.y + (up - entry.y + entry.h) % entry.h;
-						down = entry.y + (down - entry.y + entry.h) % entry.h;
-					}
+				ImageEntry const & entry = image_entries_[attr];
+				if (TAM_Wrap == (entry.addr_u_v & 0xF))
+				{
+					left = entry.x + (left - entry.x + entry.w) % entry.w;
+					right = entry.x + (right - entry.x + entry.w) % entry.w;
+				}
+				if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
+				{
+					up = entry.y + (up - entry.y + entry.h) % entry.h;
+					down = entry.y + (down - entry.y + entry.h) % entry.h;
+				}
 
-					new_tile_id_x[1] = left;
-					new_tile_id_y[1] = up;
-					new_tile_id_x[2] = tile_x;
-					new_tile_id_y[2] = up;
-					new_tile_id_x[3] = right;
-					new_tile_id_y[3] = up;
-
-					new_tile_id_x[4] = left;
-					new_tile_id_y[4] = tile_y;
-					new_tile_id_x[5] = right;
-					new_tile_id_y[5] = tile_y;
-
-					new_tile_id_x[6] = left;
-					new_tile_id_y[6] = down;
-					new_tile_id_x[7] = tile_x;
-					new_tile_id_y[7] = down;
-					new_tile_id_x[8] = right;
-					new_tile_id_y[8] = down;
-
-					for (int j = 1; j < 9; ++ j)
+				new_tile_id_x[1] = left;
+				new_tile_id_y[1] = up;
+				new_tile_id_x[2] = tile_x;
+				new_tile_id_y[2] = up;
+				new_tile_id_x[3] = right;
+				new_tile_id_y[3] = up;
+
+				new_tile_id_x[4] = left;
+				new_tile_id_y[4] = tile_y;
+				new_tile_id_x[5] = right;
+				new_tile_id_y[5] = tile_y;
+
+				new_tile_id_x[6] = left;
+				new_tile_id_y[6] = down;
+				new_tile_id_x[7] = tile_x;
+				new_tile_id_y[7] = down;
+				new_tile_id_x[8] = right;
+				new_tile_id_y[8] = down;
+
+				for (int j = 1; j < 9; ++ j)
+				{
+					if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
+						&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
+						&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
 					{
-						if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
-							&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
-							&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
+						new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
+						if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
 						{
-							new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
-							if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
+							if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
 							{
-								if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
-								{
-									new_in_same_image[j] = true;
-								}
+								new_in_same_image[j] = true;
 							}
 						}
-						else
-						{
-							new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
-						}
+					}
+					else
+					{
+						new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
 					}
 				}
+			}
 
-				for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+			for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+			{
+				if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
 				{
-					if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
+					if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
 					{
-						if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
-						{
-							neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
-							neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-						}
+						neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
+						neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
 					}
-					all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-					in_same_image.push_back(new_in_same_image[j]);
 				}
+				all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
+				in_same_image.push_back(new_in_same_image[j]);
 			}
 		}
 
-		uint32_t mipmaps = tex_cache_->NumMipMaps();
+		uint32_t const mipmaps = tex_cache_ ? tex_cache_->NumMipMaps() : tex_cache_array_[0]->NumMipMaps();
+		ElementFormat const format = tex_cache_ ? tex_cache_->Format() : tex_cache_array_[0]->Format();
 		std::vector<std::vector<uint8_t>> neighbor_data;
 		this->DecodeTiles(neighbor_data, neighbor_ids, mipmaps);
 
-		TileInfo tile_info;
-		tile_info.tick = tile_tick_;
+		tiles.resize(tile_ids.size());
 		for (size_t i = 0; i < all_neighbor_ids.size(); i += 9)
 		{
-			tile_info.attr = tile_attrs[i / 9];
+			CacheTileData& tile = tiles[i / 9];
+			tile.tile_id = all_neighbor_ids[i];
+			tile.attr = tile_attrs[i / 9];
+			tile.mip_data.resize(mipmaps);
+			tile.mip_row_pitches.resize(mipmaps);
+
 			uint8_t border_clr[4];
 			TexAddressingMode addr_u, addr_v;
-			if (tile_info.attr != 0xFFFFFFFF)
+			if (tile.attr != 0xFFFFFFFF)
 			{
-				ImageEntry const & entry = image_entries_[tile_info.attr];
+				ImageEntry const & entry = image_entries_[tile.attr];
 				addr_u = static_cast<TexAddressingMode>(entry.addr_u_v & 0xF);
 				addr_v = static_cast<TexAddressingMode>((entry.addr_u_v >> 4) & 0xF);
 				texel_op_.from_float4(border_clr, &entry.border_clr.r());
@@ -1396,77 +1536,6 @@ namespace KlayGE
 				border_clr[0] = border_clr[1] = border_clr[2] = border_clr[3] = 0;
 			}
 
-			if (tile_info_map_.size() < num_cache_total_tiles)
-			{
-				// Still has space in cache
-
-				uint32_t const s = tile_free_list_.front().first;
-				tile_info.z = s / num_cache_tiles_a_layer;
-				tile_info.y = (s - tile_info.z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
-				tile_info.x = s - tile_info.z * num_cache_tiles_a_layer - tile_info.y * num_cache_tiles_a_row;
-
-				++ tile_free_list_.front().first;
-				if (tile_free_list_.front().first == tile_free_list_.front().second)
-				{
-					tile_free_list_.pop_front();
-				}
-			}
-			else
-			{
-				// Find tiles that are not used for the longest time
-
-				uint64_t min_tick = tim.begin()->second.tick;
-				auto min_tileiter = tim.begin();
-				for (auto tileiter = tim.begin(); tileiter != tim.end(); ++ tileiter)
-				{
-					if (tileiter->second.tick < min_tick)
-					{
-						min_tick = tileiter->second.tick;
-						min_tileiter = tileiter;
-					}
-				}
-
-				tile_info.x = min_tileiter->second.x;
-				tile_info.y = min_tileiter->second.y;
-				tile_info.z = min_tileiter->second.z;
-
-				for (auto tileiter = tim.begin(); tileiter != tim.end();)
-				{
-					if (tileiter->second.tick == min_tick)
-					{
-						uint32_t const id = tileiter->second.z * num_cache_tiles_a_layer + tileiter->second.y * num_cache_tiles_a_row + tileiter->second.x;
-						auto freeiter = tile_free_list_.begin();
-						while ((freeiter != tile_free_list_.end()) && (freeiter->second <= id))
-						{
-							++ freeiter;
-						}
-						tile_free_list_.emplace(freeiter, id, id + 1);
-
-						tileiter = tim.erase(tileiter);
-					}
-					else
-					{
-						 ++ tileiter;
-					}
-				}
-				for (auto freeiter = tile_free_list_.begin(); freeiter != tile_free_list_.end() - 1;)
-				{
-					auto nextiter = freeiter;
-					++ nextiter;
-
-					if (freeiter->second == nextiter->first)
-					{
-						freeiter->second = nextiter->second;
-						freeiter = tile_free_list_.erase(nextiter);
-						-- freeiter;
-					}
-					else
-					{
-						++ freeiter;
-					}
-				}
-			}
-
 			std::array<uint32_t, 9> index_with_neighbors = { { 0 } };
 			for (size_t j = 0; j < index_with_neighbors.size(); ++ j)
 			{
@@ -1527,7 +1596,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1640,7 +1709,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -1750,7 +1819,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1864,7 +1933,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -1977,7 +2046,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -2091,7 +2160,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2204,7 +2273,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -2314,7 +2383,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2419,29 +2488,6 @@ namespace KlayGE
 					}
 				}
 
-				ElementFormat format;
-				if (tex_cache_)
-				{
-					format = tex_cache_->Format();
-				}
-				else
-				{
-					format = tex_cache_array_[tile_info.z]->Format();
-				}
-
-				TexturePtr target_tex;
-				uint32_t target_array_index;
-				if (tex_cache_)
-				{
-					target_tex = tex_cache_;
-					target_array_index = tile_info.z;
-				}
-				else
-				{
-					target_tex = tex_cache_array_[tile_info.z];
-					target_array_index = 0;
-				}
-
 				if (IsCompressedFormat(format))
 				{
 					uint32_t const block_width = tex_codec_->BlockWidth();
@@ -2528,36 +2574,103 @@ namespace KlayGE
 							&bc[0], bc_row_pitch, bc_slice_pitch, p_argb, row_pitch, slice_pitch, TCM_Quality);
 					}
 
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&bc[0], bc_row_pitch);
+					tile.mip_data[l].swap(bc);
+					tile.mip_row_pitches[l] = bc_row_pitch;
 				}
 				else
 				{
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&tex_a_tile_data[0], mip_tile_with_border_size * texel_size_);
+					tile.mip_data[l].swap(tex_a_tile_data);
+					tile.mip_row_pitches[l] = mip_tile_with_border_size * texel_size_;
 				}
 
 				mip_tile_size /= 2;
 				mip_tile_with_border_size /= 2;
 				mip_border_size /= 2;
 			}
+		}
+	}
+
+	void JudaTexture::UploadCacheTiles(std::vector<CacheTileData> const & tiles)
+	{
+		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
+		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
+		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+
+		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
+		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
+
+		for (auto const & tile : tiles)
+		{
+			// Find the tile that is not used for the longest time. Free slots have a tick of 0.
+
+			uint32_t slot = 0;
+			for (uint32_t i = 1; i < cache_slots_.size(); ++ i)
+			{
+				if (cache_slots_[i].tick < cache_slots_[slot].tick)
+				{
+					slot = i;
+				}
+			}
+			if (cache_slots_[slot].tick == tile_tick_)
+			{
+				// Every tile in cache is used in this frame. The rest are requested again in next frames.
+				break;
+			}
+
+			TileInfo& tile_info = cache_slots_[slot];
+			if (tile_info.tile_id != 0xFFFFFFFF)
+			{
+				uint32_t& old_slot = tile_slots_[this->TileSlotIndex(tile_info.tile_id)];
+				if (old_slot == slot)
+				{
+					old_slot = 0xFFFFFFFF;
+				}
+			}
+
+			tile_info.tile_id = tile.tile_id;
+			tile_info.attr = tile.attr;
+			tile_info.tick = tile_tick_;
+
+			uint32_t const z = slot / num_cache_tiles_a_layer;
+			uint32_t const y = (slot - z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
+			uint32_t const x = slot - z * num_cache_tiles_a_layer - y * num_cache_tiles_a_row;
+
+			TexturePtr target_tex;
+			uint32_t target_array_index;
+			if (tex_cache_)
+			{
+				target_tex = tex_cache_;
+				target_array_index = z;
+			}
+			else
+			{
+				target_tex = tex_cache_array_[z];
+				target_array_index = 0;
+			}
+
+			uint32_t mip_tile_with_border_size = tile_with_border_size;
+			for (uint32_t l = 0; l < tile.mip_data.size(); ++ l)
+			{
+				target_tex->UpdateSubresource2D(target_array_index, l,
+					x * mip_tile_with_border_size, y * mip_tile_with_border_size,
+					mip_tile_with_border_size, mip_tile_with_border_size,
+					&tile.mip_data[l][0], tile.mip_row_pitches[l]);
+
+				mip_tile_with_border_size /= 2;
+			}
 
 			uint8_t const a_tile_indirect[] =
 			{
-				static_cast<uint8_t>(tile_info.x),
-				static_cast<uint8_t>(tile_info.y),
-				static_cast<uint8_t>(tile_info.z),
+				static_cast<uint8_t>(x),
+				static_cast<uint8_t>(y),
+				static_cast<uint8_t>(z),
 				0
 			};
 			uint32_t level, tile_x, tile_y;
-			this->DecodeTileID(level, tile_x, tile_y, all_neighbor_ids[i]);
+			this->DecodeTileID(level, tile_x, tile_y, tile.tile_id);
 			tex_indirect_->UpdateSubresource2D(0, 0, tile_x, tile_y, 1, 1, a_tile_indirect, sizeof(a_tile_indirect));
 
-			tim.emplace(all_neighbor_ids[i], tile_info);
+			tile_slots_[this->TileSlotIndex(tile.tile_id)] = slot;
 		}
 	}
 }
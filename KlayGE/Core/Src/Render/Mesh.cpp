@@ -21,6 +21,7 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Texture.hpp>
@@ -33,6 +34,8 @@
 #include <KlayGE/Light.hpp>
 #include <KlayGE/RenderMaterial.hpp>
 #include <KFL/Hash.hpp>
+#include <KlayGE/PerfProfiler.hpp>
+#include <KlayGE/SceneQuery.hpp>
 
 #include <algorithm>
 #include <fstream>
@@ -47,7 +50,7 @@ namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const MODEL_BIN_VERSION = 14;
+	uint32_t const MODEL_BIN_VERSION = 16;
 
 	class RenderModelLoadingDesc : public ResLoadingDesc
 	{
@@ -76,6 +79,10 @@ namespace
 				std::vector<uint32_t> mesh_base_vertices;
 				std::vector<uint32_t> mesh_num_indices;
 				std::vector<uint32_t> mesh_start_indices;
+				std::vector<std::vector<uint32_t>> mesh_lod_num_indices;
+				std::vector<std::vector<uint32_t>> mesh_lod_start_indices;
+				std::vector<std::vector<MeshCluster>> mesh_clusters;
+				std::vector<TriangleBVHPtr> mesh_ray_cast_bvhs;
 				std::vector<Joint> joints;
 				std::shared_ptr<AnimationActionsType> actions;
 				std::shared_ptr<KeyFramesType> kfs;
@@ -136,10 +143,17 @@ namespace
 				model_desc_.model_data->pos_bbs, model_desc_.model_data->tc_bbs,
 				model_desc_.model_data->mesh_num_vertices, model_desc_.model_data->mesh_base_vertices,
 				model_desc_.model_data->mesh_num_indices, model_desc_.model_data->mesh_start_indices,
+				model_desc_.model_data->mesh_lod_num_indices, model_desc_.model_data->mesh_lod_start_indices,
+				model_desc_.model_data->mesh_clusters,
 				model_desc_.model_data->joints, model_desc_.model_data->actions, model_desc_.model_data->kfs,
 				model_desc_.model_data->num_frames, model_desc_.model_data->frame_rate,
 				model_desc_.model_data->frame_pos_bbs);
 
+			if (model_desc_.access_hint & EAH_CPU_RayCast)
+			{
+				this->BuildRayCastBVHs();
+			}
+
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 			RenderDeviceCaps const & caps = rf.RenderEngineInstance().DeviceCaps();
 			if (caps.multithread_res_creating_support)
@@ -218,9 +232,16 @@ namespace
 					mesh->AddIndexStream(rhs_rl.GetIndexStream(), rhs_rl.IndexStreamFormat());
 
 					mesh->NumVertices(rhs_mesh->NumVertices());
-					mesh->NumIndices(rhs_mesh->NumIndices());
+					mesh->NumIndices(rhs_mesh->LodNumIndices(0));
 					mesh->StartVertexLocation(rhs_mesh->StartVertexLocation());
-					mesh->StartIndexLocation(rhs_mesh->StartIndexLocation());
+					mesh->StartIndexLocation(rhs_mesh->LodStartIndexLocation(0));
+					mesh->NumLods(rhs_mesh->NumLods());
+					for (uint32_t lod = 1; lod < rhs_mesh->NumLods(); ++ lod)
+					{
+						mesh->LodIndexRange(lod, rhs_mesh->LodStartIndexLocation(lod), rhs_mesh->LodNumIndices(lod));
+					}
+					mesh->Clusters(rhs_mesh->Clusters());
+					mesh->RayCastBVH(rhs_mesh->RayCastBVH());
 				}
 
 				BOOST_ASSERT(model->IsSkinned() == rhs_model->IsSkinned());
@@ -281,13 +302,14 @@ namespace
 
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
+			uint32_t const buff_access_hint = model_desc_.access_hint & ~EAH_CPU_RayCast;
 			model_desc_.model_data->merged_vbs.resize(model_desc_.model_data->merged_buff.size());
 			for (size_t i = 0; i < model_desc_.model_data->merged_buff.size(); ++ i)
 			{
-				model_desc_.model_data->merged_vbs[i] = rf.MakeDelayCreationVertexBuffer(BU_Static, model_desc_.access_hint,
+				model_desc_.model_data->merged_vbs[i] = rf.MakeDelayCreationVertexBuffer(BU_Static, buff_access_hint,
 					static_cast<uint32_t>(model_desc_.model_data->merged_buff[i].size()));
 			}
-			model_desc_.model_data->merged_ib = rf.MakeDelayCreationIndexBuffer(BU_Static, model_desc_.access_hint,
+			model_desc_.model_data->merged_ib = rf.MakeDelayCreationIndexBuffer(BU_Static, buff_access_hint,
 				static_cast<uint32_t>(model_desc_.model_data->merged_indices.size()));
 
 			std::vector<StaticMeshPtr> meshes(model_desc_.model_data->mesh_names.size());
@@ -313,6 +335,19 @@ namespace
 				mesh->NumIndices(model_desc_.model_data->mesh_num_indices[mesh_index]);
 				mesh->StartVertexLocation(model_desc_.model_data->mesh_base_vertices[mesh_index]);
 				mesh->StartIndexLocation(model_desc_.model_data->mesh_start_indices[mesh_index]);
+
+				auto const & lod_num_indices = model_desc_.model_data->mesh_lod_num_indices[mesh_index];
+				auto const & lod_start_indices = model_desc_.model_data->mesh_lod_start_indices[mesh_index];
+				mesh->NumLods(static_cast<uint32_t>(lod_num_indices.size()) + 1);
+				for (uint32_t lod = 1; lod <= lod_num_indices.size(); ++ lod)
+				{
+					mesh->LodIndexRange(lod, lod_start_indices[lod - 1], lod_num_indices[lod - 1]);
+				}
+				mesh->Clusters(model_desc_.model_data->mesh_clusters[mesh_index]);
+				if (!model_desc_.model_data->mesh_ray_cast_bvhs.empty())
+				{
+					mesh->RayCastBVH(model_desc_.model_data->mesh_ray_cast_bvhs[mesh_index]);
+				}
 			}
 
 			if (model_desc_.model_data->kfs && !model_desc_.model_data->kfs->empty())
@@ -338,6 +373,92 @@ namespace
 			model->AssignSubrenderables(meshes.begin(), meshes.end());
 		}
 
+		// From the LOD 0 triangles. Skinned meshes are left to their bounds, their triangles move.
+		void BuildRayCastBVHs()
+		{
+			auto& model_data = *model_desc_.model_data;
+			if (!model_data.joints.empty())
+			{
+				return;
+			}
+
+			uint32_t pos_stream = static_cast<uint32_t>(model_data.merged_ves.size());
+			for (uint32_t i = 0; i < model_data.merged_ves.size(); ++ i)
+			{
+				if (VEU_Position == model_data.merged_ves[i].usage)
+				{
+					pos_stream = i;
+					break;
+				}
+			}
+			if (pos_stream == model_data.merged_ves.size())
+			{
+				return;
+			}
+			ElementFormat const pos_fmt = model_data.merged_ves[pos_stream].format;
+			if ((pos_fmt != EF_SIGNED_ABGR16) && (pos_fmt != EF_BGR32F) && (pos_fmt != EF_ABGR32F))
+			{
+				return;
+			}
+			uint32_t const pos_stride = model_data.merged_ves[pos_stream].element_size();
+			uint32_t const index_size = model_data.all_is_index_16_bit ? 2 : 4;
+
+			std::vector<float3> positions;
+			std::vector<uint32_t> indices;
+			model_data.mesh_ray_cast_bvhs.resize(model_data.mesh_names.size());
+			for (size_t mesh_index = 0; mesh_index < model_data.mesh_names.size(); ++ mesh_index)
+			{
+				AABBox const & pos_bb = model_data.pos_bbs[mesh_index];
+				float3 const pos_center = pos_bb.Center();
+				float3 const pos_extent = pos_bb.HalfSize();
+
+				uint8_t const * src = &model_data.merged_buff[pos_stream][model_data.mesh_base_vertices[mesh_index] * pos_stride];
+				positions.resize(model_data.mesh_num_vertices[mesh_index]);
+				for (auto& pos : positions)
+				{
+					if (EF_SIGNED_ABGR16 == pos_fmt)
+					{
+						// The same decoding as the shaders
+						int16_t s_pos[3];
+						std::memcpy(s_pos, src, sizeof(s_pos));
+						for (int i = 0; i < 3; ++ i)
+						{
+							float const snorm = std::max(LE2Native(s_pos[i]) / 32767.0f, -1.0f);
+							pos[i] = snorm * pos_extent[i] + pos_center[i];
+						}
+					}
+					else
+					{
+						float f_pos[3];
+						std::memcpy(f_pos, src, sizeof(f_pos));
+						pos = float3(f_pos[0], f_pos[1], f_pos[2]);
+					}
+					src += pos_stride;
+				}
+
+				uint8_t const * index_src = &model_data.merged_indices[model_data.mesh_start_indices[mesh_index] * index_size];
+				indices.resize(model_data.mesh_num_indices[mesh_index]);
+				for (auto& index : indices)
+				{
+					if (model_data.all_is_index_16_bit)
+					{
+						uint16_t ind16;
+						std::memcpy(&ind16, index_src, sizeof(ind16));
+						index = LE2Native(ind16);
+					}
+					else
+					{
+						uint32_t ind32;
+						std::memcpy(&ind32, index_src, sizeof(ind32));
+						index = LE2Native(ind32);
+					}
+					index_src += index_size;
+				}
+
+				model_data.mesh_ray_cast_bvhs[mesh_index] = MakeSharedPtr<TriangleBVH>(positions, indices);
+			}
+		}
+
 		void AddsSubPath()
 		{
 			std::string sub_path;
@@ -365,6 +486,13 @@ namespace
 				}
 				model_desc_.model_data->merged_ib->CreateHWResource(&model_desc_.model_data->merged_indices[0]);
 
+#ifndef KLAYGE_SHIP
+				if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+				{
+					profiler->IncCounter(PCT_GPUAllocations, static_cast<uint32_t>(model_desc_.model_data->merged_buff.size() + 1));
+				}
+#endif
+
 				this->AddsSubPath();
 
 				model->BuildModelInfo();
@@ -399,6 +527,25 @@ namespace KlayGE
 		}
 	}
 
+	uint32_t RenderModel::NumLods() const
+	{
+		uint32_t lods = 1;
+		for (auto const & mesh : subrenderables_)
+		{
+			lods = std::max(lods, mesh->NumLods());
+		}
+		return lods;
+	}
+
+	void RenderModel::ActiveLod(int32_t lod)
+	{
+		Renderable::ActiveLod(lod);
+		for (auto const & mesh : subrenderables_)
+		{
+			mesh->ActiveLod(lod);
+		}
+	}
+
 	void RenderModel::OnRenderBegin()
 	{
 		for (auto const & mesh : subrenderables_)
@@ -514,7 +661,7 @@ namespace KlayGE
 
 
 	StaticMesh::StaticMesh(RenderModelPtr const & model, std::wstring const & name)
-		: name_(name), model_(model),
+		: name_(name), lod_start_indices_(1, 0), lod_num_indices_(1, 0), clusters_culled_(false), model_(model),
 			hw_res_ready_(false)
 	{
 		rl_ = Context::Instance().RenderFactoryInstance().MakeRenderLayout();
@@ -525,6 +672,137 @@ namespace KlayGE
 	{
 	}
 
+	void StaticMesh::NumLods(uint32_t lods)
+	{
+		BOOST_ASSERT(lods >= 1);
+
+		lod_start_indices_.resize(lods, lod_start_indices_[0]);
+		lod_num_indices_.resize(lods, lod_num_indices_[0]);
+		if (active_lod_ >= static_cast<int32_t>(lods))
+		{
+			this->ActiveLod(lods - 1);
+		}
+	}
+
+	void StaticMesh::LodIndexRange(uint32_t lod, uint32_t start_index, uint32_t num_indices)
+	{
+		lod_start_indices_[lod] = start_index;
+		lod_num_indices_[lod] = num_indices;
+		if (static_cast<int32_t>(lod) == active_lod_)
+		{
+			rl_->StartIndexLocation(start_index);
+			rl_->NumIndices(num_indices);
+		}
+	}
+
+	void StaticMesh::ActiveLod(int32_t lod)
+	{
+		Renderable::ActiveLod(lod);
+
+		rl_->StartIndexLocation(lod_start_indices_[active_lod_]);
+		rl_->NumIndices(lod_num_indices_[active_lod_]);
+	}
+
+	void StaticMesh::CullClusters(Frustum const & frustum, float3 const & eye_pos, float proj_scale, float small_cluster_threshold)
+	{
+		visible_cluster_ranges_.clear();
+		clusters_culled_ = false;
+
+		// Clusters only cover LOD 0, and instances would need one list each
+		if ((active_lod_ != 0) || (instances_.size() > 1) || clusters_.empty())
+		{
+			return;
+		}
+
+		float4x4 const & model_mat = instances_.empty() ? model_mat_ : instances_[0]->AbsModelMatrix();
+		float const scale = std::sqrt(std::max(std::max(MathLib::length_sq(float3(&model_mat.Row(0)[0])),
+			MathLib::length_sq(float3(&model_mat.Row(1)[0]))), MathLib::length_sq(float3(&model_mat.Row(2)[0]))));
+
+		// Cones are built for back face culling of the default winding. Other cull modes, or a mirroring
+		// transform, only cull by the bounding spheres.
+		bool backface_cull = (MathLib::determinant(model_mat) > 0);
+		RenderTechnique const & tech = *this->GetRenderTechnique();
+		for (uint32_t i = 0; (i < tech.NumPasses()) && backface_cull; ++ i)
+		{
+			RasterizerStateDesc const & rs_desc = tech.Pass(i).GetRenderStateObject()->GetRasterizerStateDesc();
+			backface_cull = (CM_Back == rs_desc.cull_mode) && !rs_desc.front_face_ccw;
+		}
+
+		// Normals go through the inverse transpose, otherwise a non-uniform scale bends the cone axes
+		float4x4 const normal_mat = backface_cull ? MathLib::transpose(MathLib::inverse(model_mat)) : float4x4::Identity();
+
+		uint32_t num_visible = 0;
+		for (auto const & cluster : clusters_)
+		{
+			float3 const center = MathLib::transform_coord(cluster.center, model_mat);
+			float const radius = cluster.radius * scale;
+
+			bool visible = (frustum.Intersect(Sphere(center, radius)) != BO_No);
+			if (visible)
+			{
+				float3 const view_vec = center - eye_pos;
+				float const dist = MathLib::length(view_vec);
+				if (dist > radius)
+				{
+					if (backface_cull)
+					{
+						float3 const axis = MathLib::normalize(MathLib::transform_normal(cluster.cone_axis, normal_mat));
+						visible = (MathLib::dot(view_vec, axis) < cluster.cone_cutoff * dist + radius);
+					}
+					if (visible && (small_cluster_threshold > 0))
+					{
+						// Fraction of the [-1, 1]^2 screen covered by the projected sphere
+						float const proj_radius = radius * proj_scale / dist;
+						visible = (PI / 4 * proj_radius * proj_radius >= small_cluster_threshold);
+					}
+				}
+			}
+
+			if (visible)
+			{
+				if (!visible_cluster_ranges_.empty()
+					&& (visible_cluster_ranges_.back().first + visible_cluster_ranges_.back().second == cluster.start_index))
+				{
+					visible_cluster_ranges_.back().second += cluster.num_indices;
+				}
+				else
+				{
+					visible_cluster_ranges_.emplace_back(cluster.start_index, cluster.num_indices);
+				}
+				++ num_visible;
+			}
+		}
+
+		clusters_culled_ = (num_visible < clusters_.size());
+	}
+
+	void StaticMesh::Render()
+	{
+		if (clusters_culled_)
+		{
+			if (!visible_cluster_ranges_.empty())
+			{
+				// Visible ranges are drawn inside one pass loop. NumIndices only counts the drawn ones for the stats.
+				uint32_t num_indices = 0;
+				for (auto const & range : visible_cluster_ranges_)
+				{
+					num_indices += range.second;
+				}
+				rl_->NumIndices(num_indices);
+				rl_->IndexRanges(visible_cluster_ranges_);
+				Renderable::Render();
+				rl_->IndexRanges(ArrayRef<std::pair<uint32_t, uint32_t>>());
+				rl_->NumIndices(lod_num_indices_[active_lod_]);
+			}
+
+			clusters_culled_ = false;
+		}
+		else
+		{
+			Renderable::Render();
+		}
+	}
+
 	void StaticMesh::DoBuildMeshInfo()
 	{
 		RenderModelPtr model = model_.lock();
@@ -758,9 +1036,13 @@ namespace KlayGE
 			float bind_scale;
 			if ((MathLib::SignBit(joint.inverse_origin_scale) > 0) && (MathLib::SignBit(joint.bind_scale) > 0))
 			{
-				bind_real = MathLib::mul_real(joint.inverse_origin_real, joint.bind_real);
-				bind_dual = MathLib::mul_dual(joint.inverse_origin_real, joint.inverse_origin_dual,
-					joint.bind_real, joint.bind_dual);
+				// mul_real and mul_dual, on SIMD registers
+				SIMDVectorF4 const inv_origin_real = SIMDMathLib::LoadQuaternion(joint.inverse_origin_real);
+				SIMDVectorF4 const joint_bind_real = SIMDMathLib::LoadQuaternion(joint.bind_real);
+				SIMDMathLib::StoreQuaternion(bind_real, SIMDMathLib::MultiplyQuat(inv_origin_real, joint_bind_real));
+				SIMDMathLib::StoreQuaternion(bind_dual,
+					SIMDMathLib::MultiplyQuat(inv_origin_real, SIMDMathLib::LoadQuaternion(joint.bind_dual))
+					+ SIMDMathLib::MultiplyQuat(SIMDMathLib::LoadQuaternion(joint.inverse_origin_dual), joint_bind_real));
 				bind_scale = joint.inverse_origin_scale * joint.bind_scale;
 
 				if (MathLib::SignBit(bind_real.w()) < 0)
@@ -1005,6 +1287,8 @@ namespace KlayGE
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs,
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
 		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_base_indices,
+		std::vector<std::vector<uint32_t>>& mesh_lod_num_indices, std::vector<std::vector<uint32_t>>& mesh_lod_base_indices,
+		std::vector<std::vector<MeshCluster>>& mesh_clusters,
 		std::vector<Joint>& joints, std::shared_ptr<AnimationActionsType>& actions,
 		std::shared_ptr<KeyFramesType>& kfs, uint32_t& num_frames, uint32_t& frame_rate,
 		std::vector<std::shared_ptr<AABBKeyFrames>>& frame_pos_bbs)
@@ -1230,6 +1514,9 @@ namespace KlayGE
 		mesh_base_vertices.resize(num_meshes);
 		mesh_num_indices.resize(num_meshes);
 		mesh_base_indices.resize(num_meshes);
+		mesh_lod_num_indices.resize(num_meshes);
+		mesh_lod_base_indices.resize(num_meshes);
+		mesh_clusters.resize(num_meshes);
 		for (uint32_t mesh_index = 0; mesh_index < num_meshes; ++ mesh_index)
 		{
 			mesh_names[mesh_index] = ReadShortString(decoded);
@@ -1268,6 +1555,41 @@ namespace KlayGE
 			mesh_num_indices[mesh_index] = LE2Native(mesh_num_indices[mesh_index]);
 			decoded->read(&mesh_base_indices[mesh_index], sizeof(mesh_base_indices[mesh_index]));
 			mesh_base_indices[mesh_index] = LE2Native(mesh_base_indices[mesh_index]);
+
+			uint32_t num_lods;
+			decoded->read(&num_lods, sizeof(num_lods));
+			num_lods = LE2Native(num_lods);
+			BOOST_ASSERT(num_lods >= 1);
+			mesh_lod_num_indices[mesh_index].resize(num_lods - 1);
+			mesh_lod_base_indices[mesh_index].resize(num_lods - 1);
+			for (uint32_t lod = 1; lod < num_lods; ++ lod)
+			{
+				uint32_t& ni = mesh_lod_num_indices[mesh_index][lod - 1];
+				decoded->read(&ni, sizeof(ni));
+				ni = LE2Native(ni);
+				uint32_t& bi = mesh_lod_base_indices[mesh_index][lod - 1];
+				decoded->read(&bi, sizeof(bi));
+				bi = LE2Native(bi);
+			}
+
+			uint32_t num_clusters;
+			decoded->read(&num_clusters, sizeof(num_clusters));
+			num_clusters = LE2Native(num_clusters);
+			mesh_clusters[mesh_index].resize(num_clusters);
+			for (auto& cluster : mesh_clusters[mesh_index])
+			{
+				decoded->read(&cluster, sizeof(cluster));
+				cluster.start_index = LE2Native(cluster.start_index);
+				cluster.num_indices = LE2Native(cluster.num_indices);
+				cluster.center.x() = LE2Native(cluster.center.x());
+				cluster.center.y() = LE2Native(cluster.center.y());
+				cluster.center.z() = LE2Native(cluster.center.z());
+				cluster.radius = LE2Native(cluster.radius);
+				cluster.cone_axis.x() = LE2Native(cluster.cone_axis.x());
+				cluster.cone_axis.y() = LE2Native(cluster.cone_axis.y());
+				cluster.cone_axis.z() = LE2Native(cluster.cone_axis.z());
+				cluster.cone_cutoff = LE2Native(cluster.cone_cutoff);
+			}
 		}
 
 		joints.resize(num_joints);
@@ -1854,8 +2176,8 @@ namespace KlayGE
 
 				mesh_num_vertices[mesh_index] = mesh.NumVertices();
 				mesh_base_vertices[mesh_index] = mesh.StartVertexLocation();
-				mesh_num_indices[mesh_index] = mesh.NumIndices();
-				mesh_base_indices[mesh_index] =  mesh.StartIndexLocation();
+				mesh_num_indices[mesh_index] = mesh.LodNumIndices(0);
+				mesh_base_indices[mesh_index] =  mesh.LodStartIndexLocation(0);
 			}
 		}
 
@@ -729,7 +729,7 @@ namespace KlayGE
 		uint32_t new_particle = (*emitter_iter)->Update(elapsed_time);
 
 		float4x4 const & view_mat = Context::Instance().AppInstance().ActiveCamera().ViewMatrix();
-		std::vector<std::pair<uint32_t, float>> active_particles;
+		active_particles_.clear();
 
 		float3 min_bb(+1e10f, +1e10f, +1e10f);
 		float3 max_bb(-1e10f, -1e10f, -1e10f);
@@ -775,22 +775,27 @@ namespace KlayGE
 				float p_to_v = (pos.x() * view_mat(0, 2) + pos.y() * view_mat(1, 2) + pos.z() * view_mat(2, 2) + view_mat(3, 2))
 					/ (pos.x() * view_mat(0, 3) + pos.y() * view_mat(1, 3) + pos.z() * view_mat(2, 3) + view_mat(3, 3));
 
-				active_particles.emplace_back(i, p_to_v);
+				active_particles_.emplace_back(i, p_to_v);
 
 				min_bb = MathLib::minimize(min_bb, pos);
 				max_bb = MathLib::maximize(min_bb, pos);
 			}
 		}
 
-		if (!active_particles.empty())
+		// The particles keep changing in the next updates, so rendering gets copies of them
+		ActiveParticles& published = active_particle_slots_[active_particle_index_.write_index()];
+		published.particles.clear();
+		if (!active_particles_.empty())
 		{
-			std::sort(active_particles.begin(), active_particles.end(), ParticleCmp());
+			std::sort(active_particles_.begin(), active_particles_.end(), ParticleCmp());
 
-			checked_pointer_cast<RenderParticles>(renderable_)->PosBound(AABBox(min_bb, max_bb));
+			for (auto const & ap : active_particles_)
+			{
+				published.particles.push_back(particles_[ap.first]);
+			}
+			published.bound = AABBox(min_bb, max_bb);
 		}
-
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		active_particles_ = active_particles;
+		active_particle_index_.publish();
 	}
 
 	bool ParticleSystem::MainThreadUpdate(float app_time, float elapsed_time)
@@ -798,13 +803,20 @@ namespace KlayGE
 		KFL_UNUSED(app_time);
 		KFL_UNUSED(elapsed_time);
 
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		// Without a new sub thread update, the instances uploaded last time are still there
+		if (!active_particle_index_.acquire())
+		{
+			return false;
+		}
 
-		uint32_t const num_active_particles = static_cast<uint32_t>(active_particles_.size());
+		ActiveParticles const & active_particles = active_particle_slots_[active_particle_index_.read_index()];
+		uint32_t const num_active_particles = static_cast<uint32_t>(active_particles.particles.size());
 
 		RenderLayout& rl = renderable_->GetRenderLayout();
-		if (!active_particles_.empty())
+		if (num_active_particles > 0)
 		{
+			checked_pointer_cast<RenderParticles>(renderable_)->PosBound(active_particles.bound);
+
 			GraphicsBufferPtr instance_gb;
 			if (gs_support_)
 			{
@@ -849,7 +861,7 @@ namespace KlayGE
 				ParticleInstance* instance_data = mapper.Pointer<ParticleInstance>();
 				for (uint32_t i = 0; i < num_active_particles; ++ i, ++ instance_data)
 				{
-					Particle const & par = particles_[active_particles_[i].first];
+					Particle const & par = active_particles.particles[i];
 					instance_data->pos = par.pos;
 					instance_data->life = par.life;
 					instance_data->spin = par.spin;
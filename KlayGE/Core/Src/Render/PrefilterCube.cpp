@@ -0,0 +1,581 @@
+/**
+ * @file PrefilterCube.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
+#include <KlayGE/PrefilterCube.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Keeps a job around 4K texels of 1024 samples, small enough to balance faces and levels of very different sizes
+	uint32_t const MIN_TEXELS_PER_JOB = 4 * 1024;
+
+	void RunJobs(std::vector<std::function<void()>> const & jobs)
+	{
+		Context::Instance().ThreadPool().parallel_for(static_cast<uint32_t>(jobs.size()), [&jobs](uint32_t i)
+			{
+				jobs[i]();
+			});
+	}
+
+	// Adds jobs covering every row of the 6 faces of a width * width cube
+	void AddFaceRowJobs(std::vector<std::function<void()>>& jobs, uint32_t width,
+		std::function<void(uint32_t face, uint32_t begin_y, uint32_t end_y)> const & func)
+	{
+		uint32_t const rows_per_job = std::max(MIN_TEXELS_PER_JOB / width, 1U);
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			for (uint32_t y = 0; y < width; y += rows_per_job)
+			{
+				uint32_t const end_y = std::min(y + rows_per_job, width);
+				jobs.push_back([func, face, y, end_y]
+					{
+						func(face, y, end_y);
+					});
+			}
+		}
+	}
+
+	// Same as ToDir in PrefilterCube.fxml, xy in [0, 1]
+	float3 CubeMapDirection(uint32_t face, float x, float y)
+	{
+		float3 dir;
+		switch (face)
+		{
+		case Texture::CF_Positive_X:
+			dir = float3(+1, 1 - y * 2, 1 - x * 2);
+			break;
+
+		case Texture::CF_Negative_X:
+			dir = float3(-1, 1 - y * 2, x * 2 - 1);
+			break;
+
+		case Texture::CF_Positive_Y:
+			dir = float3(x * 2 - 1, +1, y * 2 - 1);
+			break;
+
+		case Texture::CF_Negative_Y:
+			dir = float3(x * 2 - 1, -1, 1 - y * 2);
+			break;
+
+		case Texture::CF_Positive_Z:
+			dir = float3(x * 2 - 1, 1 - y * 2, +1);
+			break;
+
+		case Texture::CF_Negative_Z:
+		default:
+			dir = float3(1 - x * 2, 1 - y * 2, -1);
+			break;
+		}
+		return MathLib::normalize(dir);
+	}
+
+	float3 CubeMapTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t width)
+	{
+		float const inv_width = 1.0f / width;
+		return CubeMapDirection(face, (x + 0.5f) * inv_width, (y + 0.5f) * inv_width);
+	}
+
+	// Bilinear filtered, clamped at the face edges
+	void SampleCubeMap(std::vector<float3> const & cube, uint32_t width, float dx, float dy, float dz,
+		float& r, float& g, float& b)
+	{
+		float const ax = std::abs(dx);
+		float const ay = std::abs(dy);
+		float const az = std::abs(dz);
+
+		uint32_t face;
+		float u, v, ma;
+		if ((ax >= ay) && (ax >= az))
+		{
+			ma = ax;
+			if (dx > 0)
+			{
+				face = Texture::CF_Positive_X;
+				u = -dz;
+			}
+			else
+			{
+				face = Texture::CF_Negative_X;
+				u = dz;
+			}
+			v = -dy;
+		}
+		else if (ay >= az)
+		{
+			ma = ay;
+			u = dx;
+			if (dy > 0)
+			{
+				face = Texture::CF_Positive_Y;
+				v = dz;
+			}
+			else
+			{
+				face = Texture::CF_Negative_Y;
+				v = -dz;
+			}
+		}
+		else
+		{
+			ma = az;
+			v = -dy;
+			if (dz > 0)
+			{
+				face = Texture::CF_Positive_Z;
+				u = dx;
+			}
+			else
+			{
+				face = Texture::CF_Negative_Z;
+				u = -dx;
+			}
+		}
+
+		float const half_scale = 0.5f * width / ma;
+		float const fx = MathLib::clamp(u * half_scale + 0.5f * width - 0.5f, 0.0f, width - 1.0f);
+		float const fy = MathLib::clamp(v * half_scale + 0.5f * width - 0.5f, 0.0f, width - 1.0f);
+		uint32_t const x0 = static_cast<uint32_t>(fx);
+		uint32_t const y0 = static_cast<uint32_t>(fy);
+		uint32_t const x1 = std::min(x0 + 1, width - 1);
+		uint32_t const y1 = std::min(y0 + 1, width - 1);
+		float const wx = fx - x0;
+		float const wy = fy - y0;
+
+		float3 const * texels = &cube[face * width * width];
+		float3 const & t00 = texels[y0 * width + x0];
+		float3 const & t01 = texels[y0 * width + x1];
+		float3 const & t10 = texels[y1 * width + x0];
+		float3 const & t11 = texels[y1 * width + x1];
+		float const w00 = (1 - wx) * (1 - wy);
+		float const w01 = wx * (1 - wy);
+		float const w10 = (1 - wx) * wy;
+		float const w11 = wx * wy;
+		r = t00.x() * w00 + t01.x() * w01 + t10.x() * w10 + t11.x() * w11;
+		g = t00.y() * w00 + t01.y() * w01 + t10.y() * w10 + t11.y() * w11;
+		b = t00.z() * w00 + t01.z() * w01 + t10.z() * w10 + t11.z() * w11;
+	}
+
+	float RadicalInverseVdC(uint32_t bits)
+	{
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555) << 1) | ((bits & 0xAAAAAAAA) >> 1);
+		bits = ((bits & 0x33333333) << 2) | ((bits & 0xCCCCCCCC) >> 2);
+		bits = ((bits & 0x0F0F0F0F) << 4) | ((bits & 0xF0F0F0F0) >> 4);
+		bits = ((bits & 0x00FF00FF) << 8) | ((bits & 0xFF00FF00) >> 8);
+		return bits * 2.3283064365386963e-10f;
+	}
+
+	// The light directions of the Blinn-Phong lobe in tangent space, SoA and padded to 4 with zero weights.
+	// With normal = view = r, n.h is h.z, so l = 2 * h.z * h - n and n.l = 2 * h.z^2 - 1 are the same for every texel.
+	struct SpecularSamples
+	{
+		std::vector<float> lx;
+		std::vector<float> ly;
+		std::vector<float> lz;
+		std::vector<float> weight;
+		float inv_total_weight;
+	};
+
+	void BuildSpecularSamples(SpecularSamples& samples, float shininess)
+	{
+		float const PI_F = 3.1415926f;
+
+		samples.lx.clear();
+		samples.ly.clear();
+		samples.lz.clear();
+		samples.weight.clear();
+
+		float total_weight = 0;
+		for (uint32_t i = 0; i < PREFILTER_CUBE_NUM_SAMPLES; ++ i)
+		{
+			float const xi_x = static_cast<float>(i) / PREFILTER_CUBE_NUM_SAMPLES;
+			float const xi_y = RadicalInverseVdC(i);
+
+			float const phi = 2 * PI_F * xi_x;
+			float const cos_theta = std::pow(1 - xi_y * (shininess + 1) / (shininess + 2), 1 / (shininess + 1));
+			float const sin_theta = std::sqrt(std::max(1 - cos_theta * cos_theta, 0.0f));
+
+			float const n_dot_l = 2 * cos_theta * cos_theta - 1;
+			if (n_dot_l > 0)
+			{
+				samples.lx.push_back(2 * cos_theta * sin_theta * std::cos(phi));
+				samples.ly.push_back(2 * cos_theta * sin_theta * std::sin(phi));
+				samples.lz.push_back(n_dot_l);
+				samples.weight.push_back(n_dot_l);
+				total_weight += n_dot_l;
+			}
+		}
+		while (samples.weight.size() & 3)
+		{
+			samples.lx.push_back(0);
+			samples.ly.push_back(0);
+			samples.lz.push_back(1);
+			samples.weight.push_back(0);
+		}
+
+		samples.inv_total_weight = 1 / std::max(1e-6f, total_weight);
+	}
+
+	float3 PrefilterSpecularTexel(std::vector<float3> const & cube, uint32_t width, SpecularSamples const & samples,
+		float3 const & normal)
+	{
+		float3 const up_vec = (std::abs(normal.z()) < 0.999f) ? float3(0, 0, 1) : float3(1, 0, 0);
+		float3 const tangent = MathLib::normalize(MathLib::cross(up_vec, normal));
+		float3 const binormal = MathLib::cross(normal, tangent);
+
+		float r = 0;
+		float g = 0;
+		float b = 0;
+		size_t const num_samples = samples.weight.size();
+#if defined(KLAYGE_SSE_SUPPORT)
+		__m128 const tx = _mm_set1_ps(tangent.x());
+		__m128 const ty = _mm_set1_ps(tangent.y());
+		__m128 const tz = _mm_set1_ps(tangent.z());
+		__m128 const bx = _mm_set1_ps(binormal.x());
+		__m128 const by = _mm_set1_ps(binormal.y());
+		__m128 const bz = _mm_set1_ps(binormal.z());
+		__m128 const nx = _mm_set1_ps(normal.x());
+		__m128 const ny = _mm_set1_ps(normal.y());
+		__m128 const nz = _mm_set1_ps(normal.z());
+		for (size_t i = 0; i < num_samples; i += 4)
+		{
+			__m128 const lx = _mm_loadu_ps(&samples.lx[i]);
+			__m128 const ly = _mm_loadu_ps(&samples.ly[i]);
+			__m128 const lz = _mm_loadu_ps(&samples.lz[i]);
+
+			float dx[4];
+			float dy[4];
+			float dz[4];
+			_mm_storeu_ps(dx, _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, lx), _mm_mul_ps(bx, ly)), _mm_mul_ps(nx, lz)));
+			_mm_storeu_ps(dy, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ty, lx), _mm_mul_ps(by, ly)), _mm_mul_ps(ny, lz)));
+			_mm_storeu_ps(dz, _mm_add_ps(_mm_add_ps(_mm_mul_ps(tz, lx), _mm_mul_ps(bz, ly)), _mm_mul_ps(nz, lz)));
+
+			for (size_t j = 0; j < 4; ++ j)
+			{
+				float const w = samples.weight[i + j];
+				if (w > 0)
+				{
+					float sr, sg, sb;
+					SampleCubeMap(cube, width, dx[j], dy[j], dz[j], sr, sg, sb);
+					r += sr * w;
+					g += sg * w;
+					b += sb * w;
+				}
+			}
+		}
+#else
+		for (size_t i = 0; i < num_samples; ++ i)
+		{
+			float const w = samples.weight[i];
+			if (w > 0)
+			{
+				float const lx = samples.lx[i];
+				float const ly = samples.ly[i];
+				float const lz = samples.lz[i];
+				float sr, sg, sb;
+				SampleCubeMap(cube, width,
+					tangent.x() * lx + binormal.x() * ly + normal.x() * lz,
+					tangent.y() * lx + binormal.y() * ly + normal.y() * lz,
+					tangent.z() * lx + binormal.z() * ly + normal.z() * lz,
+					sr, sg, sb);
+				r += sr * w;
+				g += sg * w;
+				b += sb * w;
+			}
+		}
+#endif
+
+		return float3(r, g, b) * samples.inv_total_weight;
+	}
+
+	void AddSpecularJobs(std::vector<std::function<void()>>& jobs, std::vector<float3> const & cube, uint32_t width,
+		std::shared_ptr<SpecularSamples> const & samples, std::vector<float3>& out_cube, uint32_t out_width)
+	{
+		AddFaceRowJobs(jobs, out_width, [&cube, width, samples, &out_cube, out_width](uint32_t face, uint32_t begin_y, uint32_t end_y)
+			{
+				for (uint32_t y = begin_y; y < end_y; ++ y)
+				{
+					for (uint32_t x = 0; x < out_width; ++ x)
+					{
+						out_cube[(face * out_width + y) * out_width + x] = PrefilterSpecularTexel(cube, width, *samples,
+							CubeMapTexelDirection(face, x, y, out_width));
+					}
+				}
+			});
+	}
+
+	void AddDiffuseJobs(std::vector<std::function<void()>>& jobs, std::shared_ptr<std::array<float3, 9>> const & sh,
+		std::vector<float3>& out_cube, uint32_t out_width)
+	{
+		AddFaceRowJobs(jobs, out_width, [sh, &out_cube, out_width](uint32_t face, uint32_t begin_y, uint32_t end_y)
+			{
+				for (uint32_t y = begin_y; y < end_y; ++ y)
+				{
+					for (uint32_t x = 0; x < out_width; ++ x)
+					{
+						out_cube[(face * out_width + y) * out_width + x] = SH9Irradiance(*sh,
+							CubeMapTexelDirection(face, x, y, out_width));
+					}
+				}
+			});
+	}
+
+	float AreaElement(float x, float y)
+	{
+		return std::atan2(x * y, std::sqrt(x * x + y * y + 1));
+	}
+}
+
+namespace KlayGE
+{
+	float3 SampleCubeMap(std::vector<float3> const & cube, uint32_t width, float3 const & dir)
+	{
+		float3 ret;
+		::SampleCubeMap(cube, width, dir.x(), dir.y(), dir.z(), ret.x(), ret.y(), ret.z());
+		return ret;
+	}
+
+	void ProjectCubeMapToSH9(std::vector<float3> const & cube, uint32_t width, std::array<float3, 9>& sh)
+	{
+		// Per face partial sums, so the faces can run in parallel without sharing accumulators
+		std::array<std::array<float3, 9>, 6> face_sh;
+		std::vector<std::function<void()>> jobs;
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			jobs.push_back([&cube, &face_sh, width, face]
+				{
+					float const inv_width = 1.0f / width;
+					std::array<float3, 9>& fsh = face_sh[face];
+					fsh.fill(float3::Zero());
+					for (uint32_t y = 0; y < width; ++ y)
+					{
+						float const y0 = y * 2 * inv_width - 1;
+						float const y1 = (y + 1) * 2 * inv_width - 1;
+						for (uint32_t x = 0; x < width; ++ x)
+						{
+							float const x0 = x * 2 * inv_width - 1;
+							float const x1 = (x + 1) * 2 * inv_width - 1;
+							float const solid_angle = AreaElement(x0, y0) - AreaElement(x0, y1) - AreaElement(x1, y0)
+								+ AreaElement(x1, y1);
+
+							float3 const dir = CubeMapTexelDirection(face, x, y, width);
+							float3 const radiance = cube[(face * width + y) * width + x] * solid_angle;
+							float const dx = dir.x();
+							float const dy = dir.y();
+							float const dz = dir.z();
+
+							fsh[0] += radiance * 0.282095f;
+							fsh[1] += radiance * (0.488603f * dy);
+							fsh[2] += radiance * (0.488603f * dz);
+							fsh[3] += radiance * (0.488603f * dx);
+							fsh[4] += radiance * (1.092548f * dx * dy);
+							fsh[5] += radiance * (1.092548f * dy * dz);
+							fsh[6] += radiance * (0.315392f * (3 * dz * dz - 1));
+							fsh[7] += radiance * (1.092548f * dx * dz);
+							fsh[8] += radiance * (0.546274f * (dx * dx - dy * dy));
+						}
+					}
+				});
+		}
+		RunJobs(jobs);
+
+		sh.fill(float3::Zero());
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			for (size_t i = 0; i < sh.size(); ++ i)
+			{
+				sh[i] += face_sh[face][i];
+			}
+		}
+	}
+
+	float3 SH9Irradiance(std::array<float3, 9> const & sh, float3 const & normal)
+	{
+		// Clamped cosine convolution (PI, 2PI/3, PI/4 per band), divided by PI
+		float const A0 = 1.0f;
+		float const A1 = 2.0f / 3;
+		float const A2 = 1.0f / 4;
+
+		float const x = normal.x();
+		float const y = normal.y();
+		float const z = normal.z();
+		float3 ret = sh[0] * (A0 * 0.282095f)
+			+ (sh[1] * y + sh[2] * z + sh[3] * x) * (A1 * 0.488603f)
+			+ (sh[4] * (x * y) + sh[5] * (y * z) + sh[7] * (x * z)) * (A2 * 1.092548f)
+			+ sh[6] * (A2 * 0.315392f * (3 * z * z - 1))
+			+ sh[8] * (A2 * 0.546274f * (x * x - y * y));
+		return MathLib::maximize(ret, float3::Zero());
+	}
+
+	void PrefilterCubeMapSpecular(std::vector<float3> const & cube, uint32_t width, float shininess,
+		std::vector<float3>& out_cube, uint32_t out_width)
+	{
+		auto samples = MakeSharedPtr<SpecularSamples>();
+		BuildSpecularSamples(*samples, shininess);
+
+		out_cube.resize(6 * out_width * out_width);
+		std::vector<std::function<void()>> jobs;
+		AddSpecularJobs(jobs, cube, width, samples, out_cube, out_width);
+		RunJobs(jobs);
+	}
+
+	void PrefilterCubeMapDiffuse(std::vector<float3> const & cube, uint32_t width,
+		std::vector<float3>& out_cube, uint32_t out_width)
+	{
+		auto sh = MakeSharedPtr<std::array<float3, 9>>();
+		ProjectCubeMapToSH9(cube, width, *sh);
+
+		out_cube.resize(6 * out_width * out_width);
+		std::vector<std::function<void()>> jobs;
+		AddDiffuseJobs(jobs, sh, out_cube, out_width);
+		RunJobs(jobs);
+	}
+
+	void PrefilterCubeMap(uint32_t width, uint32_t num_mipmaps, ElementFormat format, ArrayRef<ElementInitData> init_data,
+		uint32_t& out_num_mipmaps, std::vector<ElementInitData>& out_init_data, std::vector<uint8_t>& out_data_block)
+	{
+		BOOST_ASSERT(init_data.size() >= 6 * num_mipmaps);
+
+		out_num_mipmaps = 1;
+		for (uint32_t w = width; w > 8; w = std::max(w / 2, 1U))
+		{
+			++ out_num_mipmaps;
+		}
+
+		// The output is linear ABGR16F, so sRGB inputs are linearized before any filtering. They are loaded as non-sRGB and
+		// converted here, on RGB only, because ConvertToABGR32F only decodes a few sRGB formats and also touches alpha.
+		bool const srgb = IsSRGB(format);
+		ElementFormat const load_format = MakeNonSRGB(format);
+		std::vector<float3> cube(6 * width * width);
+		{
+			std::vector<Color> face_32f(width * width);
+			for (uint32_t face = 0; face < 6; ++ face)
+			{
+				ElementInitData const & src = init_data[face * num_mipmaps];
+				ResizeTexture(face_32f.data(), width * sizeof(Color), width * width * sizeof(Color), EF_ABGR32F,
+					width, width, 1,
+					src.data, src.row_pitch, src.slice_pitch, load_format,
+					width, width, 1,
+					false);
+				for (uint32_t i = 0; i < width * width; ++ i)
+				{
+					float3& texel = cube[face * width * width + i];
+					texel = float3(face_32f[i].r(), face_32f[i].g(), face_32f[i].b());
+					if (srgb)
+					{
+						texel = float3(MathLib::srgb_to_linear(texel.x()), MathLib::srgb_to_linear(texel.y()),
+							MathLib::srgb_to_linear(texel.z()));
+					}
+				}
+			}
+		}
+
+		// Every specular level and the diffuse level go into one job list, so faces and levels all run in parallel
+		std::vector<std::vector<float3>> levels(out_num_mipmaps);
+		levels[0] = cube;
+		std::vector<std::function<void()>> jobs;
+		for (uint32_t level = 1; level < out_num_mipmaps - 1; ++ level)
+		{
+			float const shininess = Glossiness2Shininess(static_cast<float>(out_num_mipmaps - 2 - level) / (out_num_mipmaps - 2));
+			auto samples = MakeSharedPtr<SpecularSamples>();
+			BuildSpecularSamples(*samples, shininess);
+
+			uint32_t const level_width = std::max(width >> level, 1U);
+			levels[level].resize(6 * level_width * level_width);
+			AddSpecularJobs(jobs, cube, width, samples, levels[level], level_width);
+		}
+		{
+			auto sh = MakeSharedPtr<std::array<float3, 9>>();
+			ProjectCubeMapToSH9(cube, width, *sh);
+
+			uint32_t const level = out_num_mipmaps - 1;
+			uint32_t const level_width = std::max(width >> level, 1U);
+			levels[level].resize(6 * level_width * level_width);
+			AddDiffuseJobs(jobs, sh, levels[level], level_width);
+		}
+		RunJobs(jobs);
+
+		uint32_t const elem_size = NumFormatBytes(EF_ABGR16F);
+		out_init_data.resize(6 * out_num_mipmaps);
+		std::vector<size_t> base(out_init_data.size());
+		size_t total_size = 0;
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			for (uint32_t level = 0; level < out_num_mipmaps; ++ level)
+			{
+				uint32_t const level_width = std::max(width >> level, 1U);
+				ElementInitData& data = out_init_data[face * out_num_mipmaps + level];
+				data.row_pitch = level_width * elem_size;
+				data.slice_pitch = data.row_pitch * level_width;
+				base[face * out_num_mipmaps + level] = total_size;
+				total_size += data.slice_pitch;
+			}
+		}
+		out_data_block.resize(total_size);
+
+		std::vector<Color> row;
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			for (uint32_t level = 0; level < out_num_mipmaps; ++ level)
+			{
+				uint32_t const level_width = std::max(width >> level, 1U);
+				uint32_t const index = face * out_num_mipmaps + level;
+				ElementInitData& data = out_init_data[index];
+				data.data = &out_data_block[base[index]];
+
+				row.resize(level_width);
+				for (uint32_t y = 0; y < level_width; ++ y)
+				{
+					for (uint32_t x = 0; x < level_width; ++ x)
+					{
+						float3 const & clr = levels[level][(face * level_width + y) * level_width + x];
+						row[x] = Color(clr.x(), clr.y(), clr.z(), 1);
+					}
+					ConvertFromABGR32F(EF_ABGR16F, row.data(), level_width, &out_data_block[base[index] + y * data.row_pitch]);
+				}
+			}
+		}
+	}
+}
@@ -681,17 +681,38 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void RenderEngine::Render(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl)
 	{
+#ifndef KLAYGE_SHIP
+		if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+		{
+			profiler->IncCounter(PCT_DrawCalls);
+		}
+#endif
+
 		this->DoRender(effect, tech, rl);
 	}
 
 	void RenderEngine::Dispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz)
 	{
+#ifndef KLAYGE_SHIP
+		if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+		{
+			profiler->IncCounter(PCT_Dispatches);
+		}
+#endif
+
 		this->DoDispatch(effect, tech, tgx, tgy, tgz);
 	}
 
 	void RenderEngine::DispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
 		GraphicsBufferPtr const & buff_args, uint32_t offset)
 	{
+#ifndef KLAYGE_SHIP
+		if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+		{
+			profiler->IncCounter(PCT_Dispatches);
+		}
+#endif
+
 		this->DoDispatchIndirect(effect, tech, buff_args, offset);
 	}
 
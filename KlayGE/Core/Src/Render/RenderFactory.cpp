@@ -28,9 +28,28 @@
 #include <KlayGE/RenderLayout.hpp>
 #include <KlayGE/Fence.hpp>
 #include <KFL/Hash.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 
 #include <KlayGE/RenderFactory.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	// Counted where the hardware resource is created. Delay creation objects may never get one.
+	void CountGPUAllocations(uint32_t n)
+	{
+#ifndef KLAYGE_SHIP
+		if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+		{
+			profiler->IncCounter(PCT_GPUAllocations, n);
+		}
+#else
+		KFL_UNUSED(n);
+#endif
+	}
+}
+
 namespace KlayGE
 {
 	RenderFactory::~RenderFactory()
@@ -81,6 +100,7 @@ namespace KlayGE
 	{
 		TexturePtr ret = this->MakeDelayCreationTexture1D(width, num_mip_maps, array_size, format, sample_count, sample_quality, access_hint);
 		ret->CreateHWResource(init_data);
+		CountGPUAllocations(1);
 		return ret;
 	}
 
@@ -90,6 +110,7 @@ namespace KlayGE
 	{
 		TexturePtr ret = this->MakeDelayCreationTexture2D(width, height, num_mip_maps, array_size, format, sample_count, sample_quality, access_hint);
 		ret->CreateHWResource(init_data);
+		CountGPUAllocations(1);
 		return ret;
 	}
 
@@ -99,6 +120,7 @@ namespace KlayGE
 	{
 		TexturePtr ret = this->MakeDelayCreationTexture3D(width, height, depth, num_mip_maps, array_size, format, sample_count, sample_quality, access_hint);
 		ret->CreateHWResource(init_data);
+		CountGPUAllocations(1);
 		return ret;
 	}
 
@@ -108,6 +130,7 @@ namespace KlayGE
 	{
 		TexturePtr ret = this->MakeDelayCreationTextureCube(size, num_mip_maps, array_size, format, sample_count, sample_quality, access_hint);
 		ret->CreateHWResource(init_data);
+		CountGPUAllocations(1);
 		return ret;
 	}
 
@@ -115,6 +138,7 @@ namespace KlayGE
 	{
 		GraphicsBufferPtr ret = this->MakeDelayCreationVertexBuffer(usage, access_hint, size_in_byte, fmt);
 		ret->CreateHWResource(init_data);
+		CountGPUAllocations(1);
 		return ret;
 	}
 
@@ -122,6 +146,7 @@ namespace KlayGE
 	{
 		GraphicsBufferPtr ret = this->MakeDelayCreationIndexBuffer(usage, access_hint, size_in_byte, fmt);
 		ret->CreateHWResource(init_data);
+		CountGPUAllocations(1);
 		return ret;
 	}
 
@@ -129,6 +154,7 @@ namespace KlayGE
 	{
 		GraphicsBufferPtr ret = this->MakeDelayCreationConstantBuffer(usage, access_hint, size_in_byte, fmt);
 		ret->CreateHWResource(init_data);
+		CountGPUAllocations(1);
 		return ret;
 	}
 
@@ -210,6 +210,16 @@ namespace KlayGE
 		return start_index_location_;
 	}
 
+	void RenderLayout::IndexRanges(ArrayRef<std::pair<uint32_t, uint32_t>> ranges)
+	{
+		index_ranges_.assign(ranges.begin(), ranges.end());
+	}
+
+	ArrayRef<std::pair<uint32_t, uint32_t>> RenderLayout::IndexRanges() const
+	{
+		return index_ranges_;
+	}
+
 	void RenderLayout::StartInstanceLocation(uint32_t location)
 	{
 		start_instance_location_ = location;
@@ -23,12 +23,16 @@
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderLayout.hpp>
 #include <KlayGE/SceneObject.hpp>
 #include <KlayGE/RenderEffect.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/Camera.hpp>
 #include <KlayGE/RenderMaterial.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/InstanceDataManager.hpp>
+
+#include <typeinfo>
 
 #include <KlayGE/Renderable.hpp>
 
@@ -36,7 +40,7 @@ namespace KlayGE
 {
 	Renderable::Renderable()
 		: select_mode_on_(false),
-			model_mat_(float4x4::Identity()), effect_attrs_(0)
+			model_mat_(float4x4::Identity()), active_lod_(0), effect_attrs_(0), instanced_world_(false)
 	{
 		auto drl = Context::Instance().DeferredRenderingLayerInstance();
 		if (drl)
@@ -55,8 +59,9 @@ namespace KlayGE
 		Camera const & camera = *re.CurFrameBuffer()->GetViewport()->camera;
 		float4x4 const & view = camera.ViewMatrix();
 		float4x4 const & proj = camera.ProjMatrix();
+		float4x4 view_proj = view * proj;
 		float4x4 mv = model_mat_ * view;
-		float4x4 mvp = mv * proj;
+		float4x4 mvp = model_mat_ * view_proj;
 		AABBox const & pos_bb = this->PosBound();
 		AABBox const & tc_bb = this->TexcoordBound();
 
@@ -67,10 +72,18 @@ namespace KlayGE
 			int32_t cas_index = drl->CurrCascadeIndex();
 			if (cas_index >= 0)
 			{
-				mvp *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
+				float4x4 const & crop = drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
+				mvp *= crop;
+				view_proj *= crop;
 			}
 		}
 
+		if (instanced_world_)
+		{
+			*view_param_ = view;
+			*view_proj_param_ = view_proj;
+		}
+
 		if (select_mode_on_)
 		{
 			*mvp_param_ = mvp;
@@ -236,58 +249,215 @@ namespace KlayGE
 		instances_.resize(0);
 	}
 
-	void Renderable::UpdateInstanceStream()
+	uint32_t Renderable::AllocateInstances()
 	{
-		if (!instances_.empty() && !instances_[0]->InstanceFormat().empty())
+		if (!instances_.empty())
 		{
+			InstanceDataManager& inst_data = Context::Instance().SceneManagerInstance().InstanceData();
 			auto const & vet = instances_[0]->InstanceFormat();
-			uint32_t size = 0;
-			for (size_t i = 0; i < vet.size(); ++ i)
+			if (!vet.empty())
+			{
+				uint32_t size = 0;
+				for (size_t i = 0; i < vet.size(); ++ i)
+				{
+					size += vet[i].element_size();
+				}
+
+				return inst_data.Allocate(instances_, size);
+			}
+			else if (instanced_world_)
 			{
-				size += vet[i].element_size();
+				return inst_data.AllocateWorldMatrices(instances_);
 			}
+		}
 
-			uint32_t const inst_size = static_cast<uint32_t>(size * instances_.size());
+		return static_cast<uint32_t>(-1);
+	}
 
-			RenderLayout& rl = this->GetRenderLayout();
+	bool Renderable::CanMergeInstances(Renderable const & rhs) const
+	{
+		if ((typeid(*this) != typeid(rhs)) || select_mode_on_ || rhs.select_mode_on_
+			|| instances_.empty() || rhs.instances_.empty()
+			|| (instances_[0]->InstanceFormat() != rhs.instances_[0]->InstanceFormat()))
+		{
+			return false;
+		}
 
-			GraphicsBufferPtr inst_stream = rl.InstanceStream();
-			if (inst_stream && (inst_stream->Size() >= inst_size))
+		if (instances_[0]->InstanceFormat().empty())
+		{
+			// The world matrices go through the instance stream. Only the instancing variant of the G-buffer effect
+			// reads them, and it has no tessellation, reflection, or forward techniques.
+			auto drl = Context::Instance().DeferredRenderingLayerInstance();
+			auto world_instancable = [drl](Renderable const & renderable)
 			{
-				for (size_t i = 0; i < instances_.size(); ++ i)
+				if (!drl || (renderable.GetRenderEffect() != renderable.deferred_effect_)
+					|| ((renderable.deferred_effect_ != drl->GBufferEffect())
+						&& (renderable.deferred_effect_ != drl->GBufferInstancingEffect()))
+					|| (renderable.mtl_ && (renderable.mtl_->detail_mode != RenderMaterial::SDM_Parallax))
+					|| (renderable.effect_attrs_ & (EA_Reflection | EA_SimpleForward | EA_VDM)))
+				{
+					return false;
+				}
+
+				switch (renderable.type_)
 				{
-					BOOST_ASSERT(rl.InstanceStreamFormat() == instances_[i]->InstanceFormat());
+				case PT_OpaqueGBufferMRT:
+				case PT_GenReflectiveShadowMap:
+				case PT_GenShadowMap:
+				case PT_GenCascadedShadowMap:
+				case PT_OpaqueSpecialShading:
+					break;
+
+				default:
+					return false;
 				}
+
+				// Skinned meshes are posed by their own joints
+				RenderLayout const & rl = renderable.GetRenderLayout();
+				for (uint32_t i = 0; i < rl.NumVertexStreams(); ++ i)
+				{
+					for (auto const & ve : rl.VertexStreamFormat(i))
+					{
+						if ((VEU_BlendWeight == ve.usage) || (VEU_BlendIndex == ve.usage))
+						{
+							return false;
+						}
+					}
+				}
+
+				return true;
+			};
+
+			// Once a leader switches to the instancing effect, its technique is a different object with the same name
+			if ((type_ != rhs.type_) || !world_instancable(*this) || !world_instancable(rhs)
+				|| (this->GetRenderTechnique()->NameHash() != rhs.GetRenderTechnique()->NameHash()))
+			{
+				return false;
 			}
-			else
+		}
+		else if ((this->GetRenderEffect() != rhs.GetRenderEffect()) || (this->GetRenderTechnique() != rhs.GetRenderTechnique()))
+		{
+			return false;
+		}
+
+		// The model matrices differ per instance, everything else OnRenderBegin reads from the renderable has to match
+		if (textures_ != rhs.textures_)
+		{
+			return false;
+		}
+		if (mtl_ != rhs.mtl_)
+		{
+			if (!mtl_ || !rhs.mtl_)
 			{
-				RenderFactory& rf(Context::Instance().RenderFactoryInstance());
-				inst_stream = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, inst_size, nullptr);
-				rl.BindVertexStream(inst_stream, vet, RenderLayout::ST_Instance, 1);
-				rl.InstanceStream(inst_stream);
+				return false;
 			}
 
+			RenderMaterial const & lm = *mtl_;
+			RenderMaterial const & rm = *rhs.mtl_;
+			if ((lm.albedo != rm.albedo) || (lm.metalness != rm.metalness) || (lm.glossiness != rm.glossiness)
+				|| (lm.emissive != rm.emissive) || (lm.alpha_test != rm.alpha_test) || (lm.detail_mode != rm.detail_mode)
+				|| (lm.height_offset_scale != rm.height_offset_scale) || (lm.tess_factors != rm.tess_factors))
 			{
-				GraphicsBuffer::Mapper mapper(*inst_stream, BA_Write_Only);
-				for (size_t i = 0; i < instances_.size(); ++ i)
+				return false;
+			}
+		}
+
+		// Clones of a model have their own layouts, but share the vertex and index buffers
+		RenderLayout const & lrl = this->GetRenderLayout();
+		RenderLayout const & rrl = rhs.GetRenderLayout();
+		if (&lrl != &rrl)
+		{
+			if ((lrl.TopologyType() != rrl.TopologyType()) || (lrl.NumVertexStreams() != rrl.NumVertexStreams())
+				|| (lrl.NumVertices() != rrl.NumVertices()) || (lrl.StartVertexLocation() != rrl.StartVertexLocation())
+				|| (lrl.UseIndices() != rrl.UseIndices()) || lrl.GetIndirectArgs() || rrl.GetIndirectArgs())
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i < lrl.NumVertexStreams(); ++ i)
+			{
+				if ((lrl.GetVertexStream(i) != rrl.GetVertexStream(i)) || (lrl.VertexStreamFormat(i) != rrl.VertexStreamFormat(i)))
 				{
-					uint8_t const * src = static_cast<uint8_t const *>(instances_[i]->InstanceData());
-					std::copy(src, src + size, mapper.Pointer<uint8_t>() + i * size);
+					return false;
 				}
 			}
+			if (lrl.UseIndices())
+			{
+				if ((lrl.GetIndexStream() != rrl.GetIndexStream()) || (lrl.IndexStreamFormat() != rrl.IndexStreamFormat())
+					|| (lrl.NumIndices() != rrl.NumIndices()) || (lrl.StartIndexLocation() != rrl.StartIndexLocation()))
+				{
+					return false;
+				}
+			}
+		}
 
+		return true;
+	}
+
+	void Renderable::UpdateInstanceStream()
+	{
+		uint32_t const start_location = this->AllocateInstances();
+		if (start_location != static_cast<uint32_t>(-1))
+		{
+			InstanceDataManager& inst_data = Context::Instance().SceneManagerInstance().InstanceData();
+			inst_data.Commit();
+
+			auto const & vet = instances_[0]->InstanceFormat().empty() ? InstanceDataManager::WorldMatrixFormat()
+				: instances_[0]->InstanceFormat();
+			GraphicsBufferPtr const & inst_stream = inst_data.Buffer();
+
+			RenderLayout& rl = this->GetRenderLayout();
+			if ((rl.InstanceStream() != inst_stream) || (rl.InstanceStreamFormat() != vet))
+			{
+				rl.BindVertexStream(inst_stream, vet, RenderLayout::ST_Instance, 1);
+				rl.InstanceStream(inst_stream);
+			}
+			if (rl.StartInstanceLocation() != start_location)
+			{
+				rl.StartInstanceLocation(start_location);
+			}
+
+			uint32_t const num_instances = static_cast<uint32_t>(instances_.size());
 			for (uint32_t i = 0; i < rl.NumVertexStreams(); ++ i)
 			{
-				rl.VertexStreamFrequencyDivider(i, RenderLayout::ST_Geometry, static_cast<uint32_t>(instances_.size()));
+				if ((rl.VertexStreamType(i) != RenderLayout::ST_Geometry) || (rl.VertexStreamFrequency(i) != num_instances))
+				{
+					rl.VertexStreamFrequencyDivider(i, RenderLayout::ST_Geometry, num_instances);
+				}
 			}
 		}
 	}
 
+	void Renderable::UseInstancedWorld()
+	{
+		if (!instanced_world_)
+		{
+			auto drl = Context::Instance().DeferredRenderingLayerInstance();
+			BOOST_ASSERT(drl);
+
+			this->BindDeferredEffect(drl->GBufferInstancingEffect());
+			this->Pass(type_);
+			instanced_world_ = true;
+		}
+	}
+
 	void Renderable::ModelMatrix(float4x4 const & mat)
 	{
 		model_mat_ = mat;
 	}
 
+	void Renderable::ActiveLod(int32_t lod)
+	{
+		active_lod_ = std::min(std::max(lod, 0), static_cast<int32_t>(this->NumLods()) - 1);
+	}
+
+	void Renderable::CullClusters(Frustum const & frustum, float3 const & eye_pos, float proj_scale, float small_cluster_threshold)
+	{
+		KFL_UNUSED(frustum);
+		KFL_UNUSED(eye_pos);
+		KFL_UNUSED(proj_scale);
+		KFL_UNUSED(small_cluster_threshold);
+	}
+
 	void Renderable::UpdateBoundBox()
 	{
 	}
@@ -335,6 +505,8 @@ namespace KlayGE
 
 		mvp_param_ = deferred_effect_->ParameterByName("mvp");
 		model_view_param_ = deferred_effect_->ParameterByName("model_view");
+		view_param_ = deferred_effect_->ParameterByName("view");
+		view_proj_param_ = deferred_effect_->ParameterByName("view_proj");
 		forward_vec_param_ = deferred_effect_->ParameterByName("forward_vec");
 		frame_size_param_ = deferred_effect_->ParameterByName("frame_size");
 		height_offset_scale_param_ = deferred_effect_->ParameterByName("height_offset_scale");
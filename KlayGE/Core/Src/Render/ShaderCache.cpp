@@ -0,0 +1,293 @@
+/**
+* @file ShaderCache.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/Log.hpp>
+
+#include <cstring>
+#include <fstream>
+
+#include <KlayGE/ShaderCache.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint64_t constexpr FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+	uint64_t constexpr FNV_PRIME = 0x100000001B3ULL;
+
+	// Entry header:
+	//			FourCC			4 bytes
+	//			Version			4 bytes
+	//			Key				8 bytes
+	//			Size			8 bytes
+	//			Checksum		8 bytes
+	// Followed by the data
+	uint32_t constexpr ENTRY_FOURCC = MakeFourCC<'K', 'S', 'C', 'E'>::value;
+	uint32_t constexpr ENTRY_HEADER_SIZE = 32;
+	char const ENTRY_EXT[] = ".ksc";
+
+	uint64_t Checksum(uint8_t const * data, size_t size)
+	{
+		return ShaderCacheKey().Append(data, size).Value();
+	}
+
+	template <typename T>
+	void WriteLE(uint8_t*& p, T value)
+	{
+		value = Native2LE(value);
+		std::memcpy(p, &value, sizeof(value));
+		p += sizeof(value);
+	}
+
+	template <typename T>
+	T ReadLE(uint8_t const *& p)
+	{
+		T value;
+		std::memcpy(&value, p, sizeof(value));
+		p += sizeof(value);
+		return LE2Native(value);
+	}
+}
+
+namespace KlayGE
+{
+	ShaderCacheKey::ShaderCacheKey()
+		: hash_(FNV_OFFSET_BASIS)
+	{
+	}
+
+	ShaderCacheKey& ShaderCacheKey::Append(void const * data, size_t size)
+	{
+		uint8_t const * p = static_cast<uint8_t const *>(data);
+		uint64_t hash = hash_;
+		for (size_t i = 0; i < size; ++ i)
+		{
+			hash ^= p[i];
+			hash *= FNV_PRIME;
+		}
+		hash_ = hash;
+		return *this;
+	}
+
+	ShaderCacheKey& ShaderCacheKey::Append(std::string_view str)
+	{
+		this->Append(static_cast<uint64_t>(str.size()));
+		return this->Append(str.data(), str.size());
+	}
+
+	ShaderCache::ShaderCache(std::string const & folder)
+		: folder_(folder),
+			num_hits_(0), num_misses_(0), num_stores_(0), tmp_index_(0)
+	{
+		if (!folder_.empty() && (folder_.back() != '/') && (folder_.back() != '\\'))
+		{
+			folder_.push_back('/');
+		}
+
+		try
+		{
+			std::filesystem::create_directories(folder_);
+		}
+		catch (std::exception& ex)
+		{
+			LogWarn("Could NOT create the shader cache folder %s: %s", folder_.c_str(), ex.what());
+		}
+	}
+
+	bool ShaderCache::Load(uint64_t key, std::vector<uint8_t>& data)
+	{
+		std::string const path = this->EntryPath(key);
+
+		bool valid = false;
+		bool exists = false;
+		{
+			std::ifstream ifs(path.c_str(), std::ios_base::binary);
+			if (ifs)
+			{
+				exists = true;
+
+				uint8_t header[ENTRY_HEADER_SIZE];
+				if (ifs.read(reinterpret_cast<char*>(header), sizeof(header)))
+				{
+					uint8_t const * p = header;
+					uint32_t const fourcc = ReadLE<uint32_t>(p);
+					uint32_t const ver = ReadLE<uint32_t>(p);
+					uint64_t const entry_key = ReadLE<uint64_t>(p);
+					uint64_t const size = ReadLE<uint64_t>(p);
+					uint64_t const checksum = ReadLE<uint64_t>(p);
+
+					if ((ENTRY_FOURCC == fourcc) && (VERSION == ver) && (key == entry_key))
+					{
+						ifs.seekg(0, std::ios_base::end);
+						uint64_t const file_size = static_cast<uint64_t>(ifs.tellg());
+						if (file_size == ENTRY_HEADER_SIZE + size)
+						{
+							ifs.seekg(ENTRY_HEADER_SIZE, std::ios_base::beg);
+							data.resize(static_cast<size_t>(size));
+							if ((0 == size) || ifs.read(reinterpret_cast<char*>(data.data()), size))
+							{
+								valid = (Checksum(data.data(), data.size()) == checksum);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (valid)
+		{
+			++ num_hits_;
+		}
+		else
+		{
+			data.clear();
+			++ num_misses_;
+
+			if (exists)
+			{
+				LogWarn("Shader cache entry %s is corrupt. Removed.", path.c_str());
+				this->Remove(key);
+			}
+		}
+
+		return valid;
+	}
+
+	bool ShaderCache::Store(uint64_t key, ArrayRef<uint8_t> data)
+	{
+		uint8_t header[ENTRY_HEADER_SIZE];
+		{
+			uint8_t* p = header;
+			WriteLE<uint32_t>(p, ENTRY_FOURCC);
+			WriteLE<uint32_t>(p, VERSION);
+			WriteLE<uint64_t>(p, key);
+			WriteLE<uint64_t>(p, data.size());
+			WriteLE<uint64_t>(p, Checksum(data.data(), data.size()));
+		}
+
+		std::string const path = this->EntryPath(key);
+		std::string const tmp_path = path + '.' + std::to_string(tmp_index_ ++) + ".tmp";
+
+		bool written = false;
+		{
+			std::ofstream ofs(tmp_path.c_str(), std::ios_base::binary);
+			if (ofs)
+			{
+				ofs.write(reinterpret_cast<char const *>(header), sizeof(header));
+				if (!data.empty())
+				{
+					ofs.write(reinterpret_cast<char const *>(data.data()), data.size());
+				}
+				ofs.close();
+				written = !ofs.fail();
+			}
+		}
+
+		bool stored = false;
+		try
+		{
+			if (written)
+			{
+				std::filesystem::rename(tmp_path, path);
+				stored = true;
+			}
+			else
+			{
+				std::filesystem::remove(tmp_path);
+			}
+		}
+		catch (std::exception& ex)
+		{
+			LogWarn("Could NOT store shader cache entry %s: %s", path.c_str(), ex.what());
+		}
+
+		if (stored)
+		{
+			++ num_stores_;
+		}
+
+		return stored;
+	}
+
+	void ShaderCache::Remove(uint64_t key)
+	{
+		try
+		{
+			std::filesystem::remove(this->EntryPath(key));
+		}
+		catch (std::exception& ex)
+		{
+			LogWarn("Could NOT remove shader cache entry: %s", ex.what());
+		}
+	}
+
+	void ShaderCache::Clear()
+	{
+		try
+		{
+			std::vector<std::filesystem::path> entries;
+			for (std::filesystem::directory_iterator iter(folder_), end; iter != end; ++ iter)
+			{
+				auto const ext = iter->path().extension();
+				if ((ext == ENTRY_EXT) || (ext == ".tmp"))
+				{
+					entries.push_back(iter->path());
+				}
+			}
+			for (auto const & entry : entries)
+			{
+				std::filesystem::remove(entry);
+			}
+		}
+		catch (std::exception& ex)
+		{
+			LogWarn("Could NOT clear the shader cache folder %s: %s", folder_.c_str(), ex.what());
+		}
+	}
+
+	std::string ShaderCache::EntryPath(uint64_t key) const
+	{
+		static char const HEX_DIGITS[] = "0123456789abcdef";
+
+		char name[16];
+		for (int i = 15; i >= 0; -- i)
+		{
+			name[i] = HEX_DIGITS[key & 0xF];
+			key >>= 4;
+		}
+
+		std::string path = folder_;
+		path.append(name, sizeof(name));
+		path.append(ENTRY_EXT);
+		return path;
+	}
+}
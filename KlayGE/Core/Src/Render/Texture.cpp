@@ -35,16 +35,23 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderView.hpp>
 #include <KlayGE/ResLoader.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 #include <KFL/Util.hpp>
 #include <KlayGE/TexCompressionBC.hpp>
 #include <KlayGE/TexCompressionETC.hpp>
 #include <KFL/Half.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Thread.hpp>
 
+#include <cmath>
 #include <cstring>
 #include <fstream>
 #include <system_error>
 
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
 #include <KlayGE/Texture.hpp>
 
 namespace
@@ -1075,6 +1082,497 @@ namespace
 		}
 	}
 
+	ElementFormat UncompressedFormat(ElementFormat format)
+	{
+		switch (format)
+		{
+		case EF_BC1:
+		case EF_BC2:
+		case EF_BC3:
+		case EF_BC7:
+		case EF_ETC1:
+		case EF_ETC2_BGR8:
+		case EF_ETC2_A1BGR8:
+		case EF_ETC2_ABGR8:
+			return EF_ARGB8;
+
+		case EF_BC4:
+		case EF_ETC2_R11:
+			return EF_R8;
+
+		case EF_BC5:
+		case EF_ETC2_GR11:
+			return EF_GR8;
+
+		case EF_SIGNED_BC1:
+		case EF_SIGNED_BC2:
+		case EF_SIGNED_BC3:
+			return EF_SIGNED_ABGR8;
+
+		case EF_SIGNED_BC4:
+		case EF_SIGNED_ETC2_R11:
+			return EF_SIGNED_R8;
+
+		case EF_SIGNED_BC5:
+			return EF_SIGNED_GR8;
+
+		case EF_BC1_SRGB:
+		case EF_BC2_SRGB:
+		case EF_BC3_SRGB:
+		case EF_BC4_SRGB:
+		case EF_BC5_SRGB:
+		case EF_BC7_SRGB:
+		case EF_ETC2_BGR8_SRGB:
+		case EF_ETC2_A1BGR8_SRGB:
+		case EF_ETC2_ABGR8_SRGB:
+			return EF_ARGB8_SRGB;
+
+		case EF_BC6:
+		case EF_SIGNED_BC6:
+			return EF_ABGR16F;
+
+		default:
+			KFL_UNREACHABLE("Invalid compressed format");
+		}
+	}
+
+
+	uint32_t const MIN_PIXELS_PER_MIP_BAND = 64 * 1024;
+
+	float const MIP_KAISER_WIDTH = 3.0f;
+	float const MIP_KAISER_ALPHA = 4.0f;
+	float const MIP_LANCZOS_WIDTH = 3.0f;
+
+	float Sinc(float x)
+	{
+		if (MathLib::abs(x) < 1e-4f)
+		{
+			return 1.0f;
+		}
+		else
+		{
+			x *= PI;
+			return MathLib::sin(x) / x;
+		}
+	}
+
+	float BesselI0(float x)
+	{
+		float const quarter_x2 = x * x / 4;
+		float sum = 1;
+		float term = 1;
+		for (int k = 1; term > sum * 1e-8f; ++ k)
+		{
+			term *= quarter_x2 / (k * k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	// x is in destination pixels
+	float MipFilterWeight(MipmapFilter filter, float x)
+	{
+		switch (filter)
+		{
+		case MF_Kaiser:
+			{
+				float const t = x / MIP_KAISER_WIDTH;
+				float const s = 1 - t * t;
+				return (s > 0) ? Sinc(x) * BesselI0(MIP_KAISER_ALPHA * MathLib::sqrt(s)) / BesselI0(MIP_KAISER_ALPHA) : 0.0f;
+			}
+
+		case MF_Lanczos:
+			return (MathLib::abs(x) < MIP_LANCZOS_WIDTH) ? Sinc(x) * Sinc(x / MIP_LANCZOS_WIDTH) : 0.0f;
+
+		default:
+			KFL_UNREACHABLE("Invalid mipmap filter");
+		}
+	}
+
+	// Polyphase weights of a 1D downsampling, num_taps per destination pixel. Out-of-range source pixels are clamped to the edge.
+	struct MipFilterTaps
+	{
+		uint32_t num_taps;
+		std::vector<uint32_t> indices;
+		std::vector<float> weights;
+	};
+
+	void BuildMipFilterTaps(MipFilterTaps& taps, MipmapFilter filter, uint32_t src_size, uint32_t dst_size)
+	{
+		float const scale = static_cast<float>(src_size) / dst_size;
+		float radius;
+		switch (filter)
+		{
+		case MF_Box:
+			radius = 0.5f;
+			break;
+
+		case MF_Kaiser:
+			radius = MIP_KAISER_WIDTH;
+			break;
+
+		case MF_Lanczos:
+			radius = MIP_LANCZOS_WIDTH;
+			break;
+
+		default:
+			KFL_UNREACHABLE("Invalid mipmap filter");
+		}
+		float const support = radius * scale;
+
+		taps.num_taps = static_cast<uint32_t>(std::ceil(support * 2)) + 1;
+		taps.indices.assign(dst_size * taps.num_taps, 0);
+		taps.weights.assign(dst_size * taps.num_taps, 0.0f);
+		for (uint32_t i = 0; i < dst_size; ++ i)
+		{
+			uint32_t* indices = &taps.indices[i * taps.num_taps];
+			float* weights = &taps.weights[i * taps.num_taps];
+
+			float const center = (i + 0.5f) * scale;
+			int const first = static_cast<int>(MathLib::floor(center - support));
+			float sum = 0;
+			for (uint32_t k = 0; k < taps.num_taps; ++ k)
+			{
+				int const j = first + static_cast<int>(k);
+				float weight;
+				if (MF_Box == filter)
+				{
+					// Exact area coverage, so non-power-of-two levels are still box filtered correctly
+					weight = std::max(std::min(j + 1.0f, center + support) - std::max(static_cast<float>(j), center - support), 0.0f);
+				}
+				else
+				{
+					weight = MipFilterWeight(filter, (j + 0.5f - center) / scale);
+				}
+
+				indices[k] = static_cast<uint32_t>(MathLib::clamp(j, 0, static_cast<int>(src_size) - 1));
+				weights[k] = weight;
+				sum += weight;
+			}
+
+			if (sum != 0)
+			{
+				float const inv_sum = 1 / sum;
+				for (uint32_t k = 0; k < taps.num_taps; ++ k)
+				{
+					weights[k] *= inv_sum;
+				}
+			}
+		}
+	}
+
+	// dst[x] = sum(weights[x][k] * src[indices[x][k]])
+	void FilterMipRow(Color* dst, Color const * src, uint32_t dst_width, MipFilterTaps const & taps)
+	{
+		uint32_t const num_taps = taps.num_taps;
+		for (uint32_t x = 0; x < dst_width; ++ x)
+		{
+			uint32_t const * indices = &taps.indices[x * num_taps];
+			float const * weights = &taps.weights[x * num_taps];
+#if defined(KLAYGE_SSE_SUPPORT)
+			__m128 acc = _mm_setzero_ps();
+			for (uint32_t k = 0; k < num_taps; ++ k)
+			{
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&src[indices[k]].r()), _mm_set1_ps(weights[k])));
+			}
+			_mm_storeu_ps(&dst[x].r(), acc);
+#else
+			Color acc(0, 0, 0, 0);
+			for (uint32_t k = 0; k < num_taps; ++ k)
+			{
+				acc += src[indices[k]] * weights[k];
+			}
+			dst[x] = acc;
+#endif
+		}
+	}
+
+	// dst[x] = sum(weights[k] * src[indices[k] * src_stride + x]). Works on whole rows (or slices) so the inner loop is contiguous.
+	void FilterMipColumns(Color* dst, Color const * src, size_t src_stride, uint32_t width,
+		uint32_t const * indices, float const * weights, uint32_t num_taps)
+	{
+		bool first = true;
+		for (uint32_t k = 0; k < num_taps; ++ k)
+		{
+			if (!first && (0 == weights[k]))
+			{
+				continue;
+			}
+
+			Color const * src_row = src + indices[k] * src_stride;
+#if defined(KLAYGE_SSE_SUPPORT)
+			__m128 const w = _mm_set1_ps(weights[k]);
+			if (first)
+			{
+				for (uint32_t x = 0; x < width; ++ x)
+				{
+					_mm_storeu_ps(&dst[x].r(), _mm_mul_ps(_mm_loadu_ps(&src_row[x].r()), w));
+				}
+			}
+			else
+			{
+				for (uint32_t x = 0; x < width; ++ x)
+				{
+					_mm_storeu_ps(&dst[x].r(), _mm_add_ps(_mm_loadu_ps(&dst[x].r()), _mm_mul_ps(_mm_loadu_ps(&src_row[x].r()), w)));
+				}
+			}
+#else
+			float const w = weights[k];
+			if (first)
+			{
+				for (uint32_t x = 0; x < width; ++ x)
+				{
+					dst[x] = src_row[x] * w;
+				}
+			}
+			else
+			{
+				for (uint32_t x = 0; x < width; ++ x)
+				{
+					dst[x] += src_row[x] * w;
+				}
+			}
+#endif
+			first = false;
+		}
+	}
+
+	// Separable resampling, x then y then z, each pass on the already reduced data of the previous one
+	void ResampleMipLevel(std::vector<Color>& dst, uint32_t dst_width, uint32_t dst_height, uint32_t dst_depth,
+		std::vector<Color> const & src, uint32_t src_width, uint32_t src_height, uint32_t src_depth,
+		MipmapFilter filter, bool parallel)
+	{
+		std::vector<Color> tmp_x;
+		std::vector<Color> tmp_y;
+		std::vector<Color> const * cur = &src;
+
+		if (dst_width != src_width)
+		{
+			MipFilterTaps taps;
+			BuildMipFilterTaps(taps, filter, src_width, dst_width);
+
+			tmp_x.resize(dst_width * src_height * src_depth);
+			Color const * src_data = cur->data();
+			Context::Instance().ThreadPool().parallel_for_bands(src_height * src_depth, MIN_PIXELS_PER_MIP_BAND / dst_width,
+				[&tmp_x, &taps, src_data, src_width, dst_width](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t row = begin; row < end; ++ row)
+					{
+						FilterMipRow(&tmp_x[row * dst_width], src_data + row * src_width, dst_width, taps);
+					}
+				}, parallel ? 0 : 1);
+			cur = &tmp_x;
+		}
+
+		if (dst_height != src_height)
+		{
+			MipFilterTaps taps;
+			BuildMipFilterTaps(taps, filter, src_height, dst_height);
+
+			tmp_y.resize(dst_width * dst_height * src_depth);
+			Color const * src_data = cur->data();
+			Context::Instance().ThreadPool().parallel_for_bands(dst_height * src_depth, MIN_PIXELS_PER_MIP_BAND / dst_width,
+				[&tmp_y, &taps, src_data, src_height, dst_width, dst_height](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t row = begin; row < end; ++ row)
+					{
+						uint32_t const z = row / dst_height;
+						uint32_t const y = row - z * dst_height;
+						FilterMipColumns(&tmp_y[row * dst_width], src_data + z * src_height * dst_width, dst_width, dst_width,
+							&taps.indices[y * taps.num_taps], &taps.weights[y * taps.num_taps], taps.num_taps);
+					}
+				}, parallel ? 0 : 1);
+			cur = &tmp_y;
+		}
+
+		if (dst_depth != src_depth)
+		{
+			MipFilterTaps taps;
+			BuildMipFilterTaps(taps, filter, src_depth, dst_depth);
+
+			uint32_t const slice_size = dst_width * dst_height;
+			dst.resize(slice_size * dst_depth);
+			Color const * src_data = cur->data();
+			Context::Instance().ThreadPool().parallel_for_bands(dst_depth, MIN_PIXELS_PER_MIP_BAND / slice_size,
+				[&dst, &taps, src_data, slice_size](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t z = begin; z < end; ++ z)
+					{
+						FilterMipColumns(&dst[z * slice_size], src_data, slice_size, slice_size,
+							&taps.indices[z * taps.num_taps], &taps.weights[z * taps.num_taps], taps.num_taps);
+					}
+				}, parallel ? 0 : 1);
+		}
+		else if (cur == &tmp_y)
+		{
+			dst.swap(tmp_y);
+		}
+		else if (cur == &tmp_x)
+		{
+			dst.swap(tmp_x);
+		}
+		else
+		{
+			dst = src;
+		}
+	}
+
+	// Converts the top level to linear floats. sRGB is decoded on RGB only, alpha is always linear.
+	void DecodeMipLevel(std::vector<Color>& dst, ElementInitData const & src, ElementFormat src_format,
+		uint32_t width, uint32_t height, uint32_t depth)
+	{
+		std::vector<uint8_t> cpu_data_block;
+		uint8_t const * cpu_data;
+		uint32_t cpu_row_pitch;
+		uint32_t cpu_slice_pitch;
+		ElementFormat cpu_format;
+		if (IsCompressedFormat(src_format))
+		{
+			DecodeTexture(cpu_data_block, cpu_row_pitch, cpu_slice_pitch, cpu_format,
+				src.data, src.row_pitch, src.slice_pitch, src_format, width, height, depth);
+			cpu_data = cpu_data_block.data();
+		}
+		else
+		{
+			cpu_data = static_cast<uint8_t const *>(src.data);
+			cpu_row_pitch = src.row_pitch;
+			cpu_slice_pitch = src.slice_pitch;
+			cpu_format = src_format;
+		}
+
+		ElementFormat const load_format = MakeNonSRGB(cpu_format);
+		dst.resize(width * height * depth);
+		for (uint32_t z = 0; z < depth; ++ z)
+		{
+			for (uint32_t y = 0; y < height; ++ y)
+			{
+				ConvertToABGR32F(load_format, cpu_data + z * cpu_slice_pitch + y * cpu_row_pitch, width,
+					&dst[(z * height + y) * width]);
+			}
+		}
+
+		if (IsSRGB(src_format))
+		{
+			for (auto& clr : dst)
+			{
+				clr.r() = MathLib::srgb_to_linear(clr.r());
+				clr.g() = MathLib::srgb_to_linear(clr.g());
+				clr.b() = MathLib::srgb_to_linear(clr.b());
+			}
+		}
+	}
+
+	float MipAlphaCoverage(std::vector<Color> const & pixels, float alpha_ref, float alpha_scale)
+	{
+		size_t count = 0;
+		for (auto const & clr : pixels)
+		{
+			if (clr.a() * alpha_scale > alpha_ref)
+			{
+				++ count;
+			}
+		}
+		return static_cast<float>(count) / pixels.size();
+	}
+
+	// Bisection on the alpha scale, the coverage is monotonic in it
+	float AlphaCoverageScale(std::vector<Color> const & pixels, float alpha_ref, float coverage)
+	{
+		float min_scale = 0;
+		float max_scale = 4;
+		float scale = 1;
+		for (int i = 0; i < 10; ++ i)
+		{
+			float const cur_coverage = MipAlphaCoverage(pixels, alpha_ref, scale);
+			if (MathLib::abs(cur_coverage - coverage) < 0.001f)
+			{
+				break;
+			}
+
+			if (cur_coverage < coverage)
+			{
+				min_scale = scale;
+			}
+			else
+			{
+				max_scale = scale;
+			}
+			scale = (min_scale + max_scale) / 2;
+		}
+		return scale;
+	}
+
+	// Converts a float level to dst_format, block compressing if needed. Bands are aligned to block rows.
+	void EncodeMipLevel(uint8_t* dst, uint32_t dst_row_pitch, uint32_t dst_slice_pitch, ElementFormat dst_format,
+		Color const * src, uint32_t width, uint32_t height, uint32_t depth, float alpha_scale, bool parallel)
+	{
+		bool const compressed = IsCompressedFormat(dst_format);
+		ElementFormat const cpu_format = compressed ? UncompressedFormat(dst_format) : dst_format;
+		ElementFormat const store_format = MakeNonSRGB(cpu_format);
+		bool const srgb = IsSRGB(dst_format);
+		bool const direct = !srgb && (1 == alpha_scale);
+		uint32_t const cpu_row_pitch = width * NumFormatBytes(cpu_format);
+		uint32_t const rows_per_group = compressed ? 4 : 1;
+		uint32_t const num_row_groups = (height + rows_per_group - 1) / rows_per_group;
+
+		for (uint32_t z = 0; z < depth; ++ z)
+		{
+			uint8_t* dst_slice = dst + z * dst_slice_pitch;
+			Color const * src_slice = src + z * width * height;
+			Context::Instance().ThreadPool().parallel_for_bands(num_row_groups, MIN_PIXELS_PER_MIP_BAND / (width * rows_per_group),
+				[=](uint32_t begin, uint32_t end)
+				{
+					uint32_t const begin_y = begin * rows_per_group;
+					uint32_t const end_y = std::min(end * rows_per_group, height);
+
+					std::vector<uint8_t> cpu_data_block;
+					uint8_t* cpu_data;
+					uint32_t row_pitch;
+					if (compressed)
+					{
+						cpu_data_block.resize(cpu_row_pitch * (end_y - begin_y));
+						cpu_data = cpu_data_block.data();
+						row_pitch = cpu_row_pitch;
+					}
+					else
+					{
+						cpu_data = dst_slice + begin_y * dst_row_pitch;
+						row_pitch = dst_row_pitch;
+					}
+
+					std::vector<Color> row(direct ? 0 : width);
+					for (uint32_t y = begin_y; y < end_y; ++ y)
+					{
+						Color const * src_row = src_slice + y * width;
+						if (!direct)
+						{
+							for (uint32_t x = 0; x < width; ++ x)
+							{
+								Color clr = src_row[x];
+								if (srgb)
+								{
+									clr.r() = MathLib::linear_to_srgb(clr.r());
+									clr.g() = MathLib::linear_to_srgb(clr.g());
+									clr.b() = MathLib::linear_to_srgb(clr.b());
+								}
+								clr.a() = std::min(clr.a() * alpha_scale, 1.0f);
+								row[x] = clr;
+							}
+							src_row = row.data();
+						}
+						ConvertFromABGR32F(store_format, src_row, width, cpu_data + (y - begin_y) * row_pitch);
+					}
+
+					if (compressed)
+					{
+						EncodeTexture(dst_slice + begin * dst_row_pitch, dst_row_pitch, dst_slice_pitch, dst_format,
+							cpu_data, row_pitch, row_pitch * (end_y - begin_y), cpu_format,
+							width, end_y - begin_y, 1);
+					}
+				}, parallel ? 0 : 1);
+		}
+	}
+
 
 	class TextureLoadingDesc : public ResLoadingDesc
 	{
@@ -1558,6 +2056,13 @@ namespace
 			{
 				tex->CreateHWResource(tex_desc_.tex_data->init_data);
 				tex_desc_.tex_data.reset();
+
+#ifndef KLAYGE_SHIP
+				if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+				{
+					profiler->IncCounter(PCT_GPUAllocations);
+				}
+#endif
 			}
 		}
 
@@ -3324,6 +3829,24 @@ namespace KlayGE
 		uint32_t src_width, uint32_t src_height, uint32_t src_depth,
 		bool linear)
 	{
+		if (linear && (dst_width <= src_width) && (dst_height <= src_height) && (dst_depth <= src_depth))
+		{
+			// Downsampling, which is how the runtime builds mip levels on CPU. Goes through the box filter of GenerateMipmaps,
+			// in linear space, instead of bilinear taps that skip source pixels.
+			ElementInitData src_init_data;
+			src_init_data.data = src_data;
+			src_init_data.row_pitch = src_row_pitch;
+			src_init_data.slice_pitch = src_slice_pitch;
+
+			std::vector<Color> src_32f;
+			std::vector<Color> dst_32f;
+			DecodeMipLevel(src_32f, src_init_data, src_format, src_width, src_height, src_depth);
+			ResampleMipLevel(dst_32f, dst_width, dst_height, dst_depth, src_32f, src_width, src_height, src_depth, MF_Box, true);
+			EncodeMipLevel(static_cast<uint8_t*>(dst_data), dst_row_pitch, dst_slice_pitch, dst_format,
+				dst_32f.data(), dst_width, dst_height, dst_depth, 1, true);
+			return;
+		}
+
 		std::vector<uint8_t> src_cpu_data_block;
 		void* src_cpu_data;
 		uint32_t src_cpu_row_pitch;
@@ -3350,64 +3873,7 @@ namespace KlayGE
 		ElementFormat dst_cpu_format;
 		if (IsCompressedFormat(dst_format))
 		{
-			switch (dst_format)
-			{				
-			case EF_BC1:
-			case EF_BC2:
-			case EF_BC3:
-			case EF_BC7:
-			case EF_ETC1:
-			case EF_ETC2_BGR8:
-			case EF_ETC2_A1BGR8:
-			case EF_ETC2_ABGR8:
-				dst_cpu_format = EF_ARGB8;
-				break;
-				
-			case EF_BC4:
-			case EF_ETC2_R11:
-				dst_cpu_format = EF_R8;
-				break;
-
-			case EF_BC5:
-			case EF_ETC2_GR11:
-				dst_cpu_format = EF_GR8;
-				break;
-
-			case EF_SIGNED_BC1:
-			case EF_SIGNED_BC2:
-			case EF_SIGNED_BC3:
-				dst_cpu_format = EF_SIGNED_ABGR8;
-				break;
-
-			case EF_SIGNED_BC4:
-			case EF_SIGNED_ETC2_R11:
-				dst_cpu_format = EF_SIGNED_R8;
-				break;
-
-			case EF_SIGNED_BC5:
-				dst_cpu_format = EF_SIGNED_GR8;
-				break;
-
-			case EF_BC1_SRGB:
-			case EF_BC2_SRGB:
-			case EF_BC3_SRGB:
-			case EF_BC4_SRGB:
-			case EF_BC5_SRGB:
-			case EF_BC7_SRGB:
-			case EF_ETC2_BGR8_SRGB:
-			case EF_ETC2_A1BGR8_SRGB:
-			case EF_ETC2_ABGR8_SRGB:
-				dst_cpu_format = EF_ARGB8_SRGB;
-				break;
-
-			case EF_BC6:
-			case EF_SIGNED_BC6:
-				dst_cpu_format = EF_ABGR16F;
-				break;
-
-			default:
-				KFL_UNREACHABLE("Invalid destination format");
-			}
+			dst_cpu_format = UncompressedFormat(dst_format);
 
 			dst_cpu_row_pitch = dst_width * NumFormatBytes(src_cpu_format);
 			dst_cpu_slice_pitch = dst_cpu_row_pitch * dst_height;
@@ -3552,6 +4018,145 @@ namespace KlayGE
 	}
 
 
+	void GenerateMipmaps(Texture::TextureType type, uint32_t width, uint32_t height, uint32_t depth,
+		uint32_t src_num_mipmaps, uint32_t array_size, ElementFormat src_format, ArrayRef<ElementInitData> src_init_data,
+		uint32_t& num_mipmaps, ElementFormat dst_format, MipmapFilter filter, float alpha_coverage_ref,
+		std::vector<ElementInitData>& dst_init_data, std::vector<uint8_t>& dst_data_block)
+	{
+		switch (type)
+		{
+		case Texture::TT_1D:
+			height = 1;
+			depth = 1;
+			break;
+
+		case Texture::TT_2D:
+			depth = 1;
+			break;
+
+		case Texture::TT_3D:
+			break;
+
+		case Texture::TT_Cube:
+			height = width;
+			depth = 1;
+			break;
+
+		default:
+			KFL_UNREACHABLE("Invalid texture type");
+		}
+
+		uint32_t num_full_mipmaps = 1;
+		for (uint32_t size = std::max({ width, height, depth }); size > 1; size /= 2)
+		{
+			++ num_full_mipmaps;
+		}
+		num_mipmaps = (0 == num_mipmaps) ? num_full_mipmaps : std::min(num_mipmaps, num_full_mipmaps);
+
+		uint32_t const num_sub_res = array_size * ((Texture::TT_Cube == type) ? 6 : 1);
+		BOOST_ASSERT(src_init_data.size() >= num_sub_res * src_num_mipmaps);
+
+		std::vector<uint32_t> widths(num_mipmaps);
+		std::vector<uint32_t> heights(num_mipmaps);
+		std::vector<uint32_t> depths(num_mipmaps);
+		for (uint32_t level = 0; level < num_mipmaps; ++ level)
+		{
+			widths[level] = std::max(width >> level, 1U);
+			heights[level] = std::max(height >> level, 1U);
+			depths[level] = std::max(depth >> level, 1U);
+		}
+
+		bool const dst_compressed = IsCompressedFormat(dst_format);
+		uint32_t const dst_elem_size = NumFormatBytes(dst_format);
+		dst_init_data.resize(num_sub_res * num_mipmaps);
+		std::vector<size_t> base(dst_init_data.size());
+		size_t total_size = 0;
+		for (uint32_t sub_res = 0; sub_res < num_sub_res; ++ sub_res)
+		{
+			for (uint32_t level = 0; level < num_mipmaps; ++ level)
+			{
+				uint32_t const index = sub_res * num_mipmaps + level;
+				if (dst_compressed)
+				{
+					uint32_t const block_size = dst_elem_size * 4;
+					dst_init_data[index].row_pitch = (widths[level] + 3) / 4 * block_size;
+					dst_init_data[index].slice_pitch = (heights[level] + 3) / 4 * dst_init_data[index].row_pitch;
+				}
+				else
+				{
+					dst_init_data[index].row_pitch = widths[level] * dst_elem_size;
+					dst_init_data[index].slice_pitch = dst_init_data[index].row_pitch * heights[level];
+				}
+
+				base[index] = total_size;
+				total_size += dst_init_data[index].slice_pitch * depths[level];
+			}
+		}
+		dst_data_block.resize(total_size);
+		for (size_t i = 0; i < dst_init_data.size(); ++ i)
+		{
+			dst_init_data[i].data = &dst_data_block[base[i]];
+		}
+
+		// Each chain is sequential, every level is filtered from the previous one. Chains run in parallel, or a single chain
+		// splits its rows when there is nothing else to run.
+		bool const parallel_rows = (1 == num_sub_res);
+		std::vector<std::vector<Color>> levels(num_sub_res * num_mipmaps);
+		std::vector<float> coverages(num_sub_res, 0.0f);
+		thread_pool& tp = Context::Instance().ThreadPool();
+		tp.parallel_for(num_sub_res, [&](uint32_t sub_res)
+			{
+				uint32_t const first = sub_res * num_mipmaps;
+				DecodeMipLevel(levels[first], src_init_data[sub_res * src_num_mipmaps], src_format, width, height, depth);
+				if (alpha_coverage_ref > 0)
+				{
+					coverages[sub_res] = MipAlphaCoverage(levels[first], alpha_coverage_ref, 1);
+				}
+
+				for (uint32_t level = 1; level < num_mipmaps; ++ level)
+				{
+					ResampleMipLevel(levels[first + level], widths[level], heights[level], depths[level],
+						levels[first + level - 1], widths[level - 1], heights[level - 1], depths[level - 1],
+						filter, parallel_rows);
+				}
+			});
+
+		// Conversion and block compression are independent per level. Items are level major, so the largest ones start first.
+		// Only this outer loop is parallel, the rows of a level are encoded on the thread that took it.
+		tp.parallel_for(num_sub_res * num_mipmaps, [&](uint32_t item)
+			{
+				uint32_t const level = item / num_sub_res;
+				uint32_t const sub_res = item - level * num_sub_res;
+				uint32_t const index = sub_res * num_mipmaps + level;
+				ElementInitData const & dst = dst_init_data[index];
+
+				if ((0 == level) && (src_format == dst_format))
+				{
+					ElementInitData const & src = src_init_data[sub_res * src_num_mipmaps];
+					uint32_t const num_rows = dst_compressed ? (height + 3) / 4 : height;
+					for (uint32_t z = 0; z < depth; ++ z)
+					{
+						for (uint32_t y = 0; y < num_rows; ++ y)
+						{
+							std::memcpy(static_cast<uint8_t*>(const_cast<void*>(dst.data)) + z * dst.slice_pitch + y * dst.row_pitch,
+								static_cast<uint8_t const *>(src.data) + z * src.slice_pitch + y * src.row_pitch, dst.row_pitch);
+						}
+					}
+				}
+				else
+				{
+					float alpha_scale = 1;
+					if ((alpha_coverage_ref > 0) && (level > 0))
+					{
+						alpha_scale = AlphaCoverageScale(levels[index], alpha_coverage_ref, coverages[sub_res]);
+					}
+
+					EncodeMipLevel(static_cast<uint8_t*>(const_cast<void*>(dst.data)), dst.row_pitch, dst.slice_pitch, dst_format,
+						levels[index].data(), widths[level], heights[level], depths[level], alpha_scale, false);
+				}
+			});
+	}
+
 	template KLAYGE_CORE_API std::pair<float3, float3> CubeMapViewVector(Texture::CubeFaces face);
 
 	template <typename T>
@@ -45,6 +45,7 @@
 #include <KlayGE/Camera.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderLayout.hpp>
 #include <KlayGE/Renderable.hpp>
 #include <KlayGE/RenderEffect.hpp>
 #include <KlayGE/Light.hpp>
@@ -53,25 +54,69 @@
 #include <KlayGE/InputFactory.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Thread.hpp>
 
 #include <map>
 #include <algorithm>
+#include <cmath>
 
 #include <KlayGE/SceneManager.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	// Objects of a sweep taken at a time by a worker
+	uint32_t const SWEEP_BATCH_SIZE = 32;
+
+	// A lock_guard counting the times it has to wait for another thread
+	class CountedLockGuard : boost::noncopyable
+	{
+	public:
+		CountedLockGuard(std::mutex& mutex, std::atomic<uint32_t>& num_waits)
+			: mutex_(mutex)
+		{
+			if (!mutex_.try_lock())
+			{
+				num_waits.fetch_add(1, std::memory_order_relaxed);
+#ifndef KLAYGE_SHIP
+				if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+				{
+					profiler->IncCounter(PCT_SceneLockWaits);
+				}
+#endif
+				mutex_.lock();
+			}
+		}
+
+		~CountedLockGuard()
+		{
+			mutex_.unlock();
+		}
+
+	private:
+		std::mutex& mutex_;
+	};
+}
+
 namespace KlayGE
 {
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	SceneManager::SceneManager()
-		: frustum_(nullptr),
-			small_obj_threshold_(0),
+		: frustum_(nullptr), simd_frustum_(nullptr),
+			small_obj_threshold_(0), lod_threshold_(0.1f),
 			update_elapse_(1.0f / 60),
 			num_objects_rendered_(0), num_renderables_rendered_(0),
 			num_primitives_rendered_(0), num_vertices_rendered_(0),
-			num_draw_calls_(0), num_dispatch_calls_(0),
-			quit_(false), deferred_mode_(false)
+			num_draw_calls_(0), num_dispatch_calls_(0), num_instance_bytes_uploaded_(0),
+			scene_bvh_dirty_(true), scene_bvh_refit_(false),
+			quit_(false), sweep_elapse_(1.0f / 60),
+			scene_objs_version_(0), sweep_objs_version_(0), sub_thread_workers_(0), sub_thread_frame_(0),
+			num_lock_waits_(0), num_dropped_sub_thread_frames_(0),
+			deferred_mode_(false)
 	{
 	}
 
@@ -102,11 +147,21 @@ namespace KlayGE
 		small_obj_threshold_ = area;
 	}
 
+	void SceneManager::LodThreshold(float area)
+	{
+		lod_threshold_ = area;
+	}
+
 	void SceneManager::SceneUpdateElapse(float elapse)
 	{
 		update_elapse_ = elapse;
 	}
 
+	void SceneManager::SubThreadUpdateWorkers(uint32_t num_workers)
+	{
+		sub_thread_workers_ = num_workers;
+	}
+
 	// ü
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::ClipScene()
@@ -187,7 +242,7 @@ namespace KlayGE
 
 	std::vector<CameraPtr>::iterator SceneManager::DelCamera(std::vector<CameraPtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		CountedLockGuard lock(update_mutex_, num_lock_waits_);
 		return cameras_.erase(iter);
 	}
 
@@ -219,7 +274,7 @@ namespace KlayGE
 
 	std::vector<LightSourcePtr>::iterator SceneManager::DelLight(std::vector<LightSourcePtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		CountedLockGuard lock(update_mutex_, num_lock_waits_);
 		return lights_.erase(iter);
 	}
 
@@ -242,7 +297,7 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::AddSceneObject(SceneObjectPtr const & obj)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		CountedLockGuard lock(update_mutex_, num_lock_waits_);
 		this->AddSceneObjectLocked(obj);
 	}
 
@@ -268,6 +323,8 @@ namespace KlayGE
 
 			scene_objs_.push_back(obj);
 			this->OnAddSceneObject(obj);
+			scene_bvh_dirty_ = true;
+			scene_objs_version_.fetch_add(1, std::memory_order_release);
 		}
 	}
 
@@ -275,8 +332,13 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::DelSceneObject(SceneObjectPtr const & obj)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		this->DelSceneObjectLocked(obj);
+		{
+			CountedLockGuard lock(update_mutex_, num_lock_waits_);
+			this->DelSceneObjectLocked(obj);
+		}
+
+		// The sweep running now could still have the object. The next one won't.
+		CountedLockGuard sweep_lock(sweep_mutex_, num_lock_waits_);
 	}
 
 	void SceneManager::DelSceneObjectLocked(SceneObjectPtr const & obj)
@@ -293,13 +355,23 @@ namespace KlayGE
 
 	std::vector<SceneObjectPtr>::iterator SceneManager::DelSceneObject(std::vector<SceneObjectPtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		return this->DelSceneObjectLocked(iter);
+		std::vector<SceneObjectPtr>::iterator ret;
+		{
+			CountedLockGuard lock(update_mutex_, num_lock_waits_);
+			ret = this->DelSceneObjectLocked(iter);
+		}
+
+		CountedLockGuard sweep_lock(sweep_mutex_, num_lock_waits_);
+		return ret;
 	}
 
+	// Doesn't wait for the sweep, because the caller has update_mutex_ the sweep could be waiting for. The object
+	// can get one more sub thread update.
 	std::vector<SceneObjectPtr>::iterator SceneManager::DelSceneObjectLocked(std::vector<SceneObjectPtr>::iterator iter)
 	{
 		this->OnDelSceneObject(iter);
+		scene_bvh_dirty_ = true;
+		scene_objs_version_.fetch_add(1, std::memory_order_release);
 		return scene_objs_.erase(iter);
 	}
 
@@ -379,7 +451,7 @@ namespace KlayGE
 	{
 		if (frustum_)
 		{
-			return frustum_->Intersect(aabb);
+			return simd_frustum_->Intersect(aabb);
 		}
 		else
 		{
@@ -423,6 +495,96 @@ namespace KlayGE
 		}
 	}
 
+	bool SceneManager::RayCast(SceneRay const & ray, SceneRayHit& hit)
+	{
+		CountedLockGuard lock(update_mutex_, num_lock_waits_);
+		this->UpdateSceneBVH();
+		return scene_bvh_.RayCast(ray, hit);
+	}
+
+	void SceneManager::RayCast(ArrayRef<SceneRay> rays, SceneRayHit* hits)
+	{
+		CountedLockGuard lock(update_mutex_, num_lock_waits_);
+		this->UpdateSceneBVH();
+		scene_bvh_.RayCast(rays, hits);
+	}
+
+	void SceneManager::OverlapQuery(AABBox const & aabb, std::vector<SceneObject*>& objs)
+	{
+		CountedLockGuard lock(update_mutex_, num_lock_waits_);
+		this->UpdateSceneBVH();
+		scene_bvh_.Overlap(aabb, overlap_instances_);
+
+		objs.clear();
+		for (auto index : overlap_instances_)
+		{
+			objs.push_back(scene_bvh_.Object(index));
+		}
+	}
+
+	// Rebuilt when objects are added or removed, refit once a frame for the moving ones
+	void SceneManager::UpdateSceneBVH()
+	{
+		if (scene_bvh_dirty_)
+		{
+			scene_bvh_.Clear();
+
+			std::vector<TriangleBVHPtr> meshes;
+			for (auto const & obj : scene_objs_)
+			{
+				auto so = obj.get();
+				uint32_t const attr = so->Attrib();
+				RenderablePtr const & renderable = so->GetRenderable();
+				// Only the cullable and moveable ones have world bounds
+				if (!(attr & (SceneObject::SOA_Cullable | SceneObject::SOA_Moveable))
+					|| !renderable || !renderable->HWResourceReady())
+				{
+					continue;
+				}
+
+				meshes.clear();
+				if (renderable->NumSubrenderables() > 0)
+				{
+					for (uint32_t i = 0; i < renderable->NumSubrenderables(); ++ i)
+					{
+						meshes.push_back(renderable->Subrenderable(i)->RayCastBVH());
+					}
+				}
+				else
+				{
+					meshes.push_back(renderable->RayCastBVH());
+				}
+
+				if (attr & SceneObject::SOA_Moveable)
+				{
+					so->UpdateAbsModelMatrix();
+				}
+				uint32_t const index = scene_bvh_.AddInstance(so, so->PosBoundWS(), so->AbsModelMatrix(), meshes);
+				scene_bvh_.EnableInstance(index, so->Visible());
+			}
+
+			scene_bvh_.Build();
+			scene_bvh_dirty_ = false;
+			scene_bvh_refit_ = false;
+		}
+		else if (scene_bvh_refit_)
+		{
+			for (uint32_t i = 0; i < scene_bvh_.NumInstances(); ++ i)
+			{
+				SceneObject* so = scene_bvh_.Object(i);
+				if (so->Attrib() & SceneObject::SOA_Moveable)
+				{
+					so->UpdateAbsModelMatrix();
+					scene_bvh_.UpdateInstance(i, so->PosBoundWS(), so->AbsModelMatrix());
+				}
+				scene_bvh_.EnableInstance(i, so->Visible());
+			}
+
+			scene_bvh_.Refit();
+			scene_bvh_refit_ = false;
+		}
+	}
+
 	uint32_t SceneManager::NumSceneObjects() const
 	{
 		return static_cast<uint32_t>(scene_objs_.size());
@@ -450,9 +612,15 @@ namespace KlayGE
 
 	void SceneManager::ClearObject()
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		scene_objs_.resize(0);
-		overlay_scene_objs_.resize(0);
+		{
+			CountedLockGuard lock(update_mutex_, num_lock_waits_);
+			scene_objs_.resize(0);
+			overlay_scene_objs_.resize(0);
+			scene_bvh_dirty_ = true;
+			scene_objs_version_.fetch_add(1, std::memory_order_release);
+		}
+
+		CountedLockGuard sweep_lock(sweep_mutex_, num_lock_waits_);
 	}
 
 	// ³
@@ -465,10 +633,17 @@ namespace KlayGE
 		float const app_time = app.AppTime();
 		float const frame_time = app.FrameTime();
 
+		// The sub thread updates follow the simulation's fixed step, so they move at the same pace
+		float const sim_step = app.Scheduler().SimStep();
+		sweep_elapse_.store((sim_step > 0) ? sim_step : update_elapse_, std::memory_order_relaxed);
+
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 		re.BeginFrame();
 
-		this->FlushScene();
+		{
+			KLAYGE_PERF_SCOPE("SceneManager::FlushScene");
+			this->FlushScene();
+		}
 
 		if (!update_thread_ && !quit_)
 		{
@@ -478,10 +653,13 @@ namespace KlayGE
 
 		std::vector<SceneObjectPtr> added_scene_objs;
 		{
-			std::lock_guard<std::mutex> lock(update_mutex_);
+			CountedLockGuard lock(update_mutex_, num_lock_waits_);
 
+			// The newest finished sweep, if there's one. Otherwise the objects keep their states.
+			sub_thread_slots_.acquire();
 			for (auto const & scene_obj : scene_objs_)
 			{
+				scene_obj->AcquireSubThreadState(sub_thread_slots_.read_index());
 				if (scene_obj->MainThreadUpdate(app_time, frame_time))
 				{
 					added_scene_objs.push_back(scene_obj);
@@ -506,6 +684,10 @@ namespace KlayGE
 				scene_obj->OnAttachRenderable(true);
 				this->OnAddSceneObject(scene_obj);
 			}
+
+			// Objects with their renderables just loaded join the query BVH. The moving ones are refit by the next query.
+			scene_bvh_dirty_ |= !added_scene_objs.empty();
+			scene_bvh_refit_ = true;
 		}
 
 		FrameBuffer& fb = *re.ScreenFrameBuffer();
@@ -536,7 +718,9 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Flush(uint32_t urt)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		KLAYGE_PERF_SCOPE("SceneManager::Flush");
+
+		CountedLockGuard lock(update_mutex_, num_lock_waits_);
 
 		urt_ = urt;
 
@@ -560,6 +744,7 @@ namespace KlayGE
 		if (urt & App3DFramework::URV_NeedFlush)
 		{
 			frustum_ = &camera.ViewFrustum();
+			simd_frustum_ = &camera.ViewFrustumSIMD();
 
 			std::vector<uint32_t> visible_list((scene_objs.size() + 31) / 32, 0);
 			for (size_t i = 0; i < scene_objs.size(); ++ i)
@@ -599,6 +784,8 @@ namespace KlayGE
 		{
 			for (auto const & scene_obj : scene_objs)
 			{
+				// Overlays are added again every frame, too short for the sweep, so they have both updates here
+				scene_obj->SubThreadUpdate(app_time, frame_time);
 				scene_obj->MainThreadUpdate(app_time, frame_time);
 				scene_obj->VisibleMark(scene_obj->Visible() ? BO_Yes : BO_No);
 			}
@@ -625,16 +812,30 @@ namespace KlayGE
 				auto renderable = so->GetRenderable().get();
 				if (renderable)
 				{
+					// Instances share one LOD, the finest any of them needs. The LOD comes from the main camera
+					// in every pass, so a shadow map matches what it shadows.
+					int32_t const lod = so->Lod();
 					if (0 == renderable->NumInstances())
 					{
+						renderable->ActiveLod(lod);
 						renderable->AddToRenderQueue();
 					}
+					else if (lod < renderable->ActiveLod())
+					{
+						renderable->ActiveLod(lod);
+					}
 					renderable->AddInstance(so);
 					++ num_objects_rendered_;
 				}
 			}
 		}
 
+		this->MergeInstances();
+		if (!(urt & App3DFramework::URV_Overlay) && !camera.OmniDirectionalMode())
+		{
+			this->CullClusters(camera);
+		}
+
 		std::sort(render_queue_.begin(), render_queue_.end(),
 			[](std::pair<RenderTechnique const *, std::vector<Renderable*>> const & lhs,
 				std::pair<RenderTechnique const *, std::vector<Renderable*>> const & rhs)
@@ -735,11 +936,129 @@ namespace KlayGE
 		return num_dispatch_calls_;
 	}
 
+	uint32_t SceneManager::NumInstanceBytesUploaded() const
+	{
+		return num_instance_bytes_uploaded_;
+	}
+
+	uint32_t SceneManager::NumLockWaits() const
+	{
+		return num_lock_waits_.load(std::memory_order_relaxed);
+	}
+
+	uint32_t SceneManager::NumDroppedSubThreadFrames() const
+	{
+		return num_dropped_sub_thread_frames_.load(std::memory_order_relaxed);
+	}
+
+	// Folds renderables sharing geometry, material, and technique into one instanced draw, and packs the instance data
+	// of the whole pass into the frame's instance buffer with one upload. A leader switched to the instancing effect
+	// is queued under a different technique than its clones, so leaders are shared by the whole queue.
+	void SceneManager::MergeInstances()
+	{
+		std::unordered_multimap<size_t, Renderable*> leaders;
+		for (auto& items : render_queue_)
+		{
+			auto& renderables = items.second;
+			size_t num_leaders = 0;
+			for (size_t i = 0; i < renderables.size(); ++ i)
+			{
+				Renderable* renderable = renderables[i];
+				bool merged = false;
+				if (renderable->NumInstances() > 0)
+				{
+					// Only renderables drawing the same part of the same vertex buffer can be merged
+					RenderLayout const & rl = renderable->GetRenderLayout();
+					size_t seed = 0;
+					HashCombine(seed, rl.NumVertexStreams() > 0 ? rl.GetVertexStream(0).get() : nullptr);
+					HashCombine(seed, rl.StartVertexLocation());
+					HashCombine(seed, rl.UseIndices() ? rl.StartIndexLocation() : 0);
+
+					auto const range = leaders.equal_range(seed);
+					for (auto iter = range.first; iter != range.second; ++ iter)
+					{
+						Renderable* leader = iter->second;
+						if (leader->CanMergeInstances(*renderable))
+						{
+							for (uint32_t k = 0; k < renderable->NumInstances(); ++ k)
+							{
+								leader->AddInstance(renderable->GetInstance(k));
+							}
+							renderable->ClearInstances();
+							if (leader->GetInstance(0)->InstanceFormat().empty())
+							{
+								leader->UseInstancedWorld();
+							}
+							merged = true;
+							break;
+						}
+					}
+					if (!merged)
+					{
+						leaders.emplace(seed, renderable);
+					}
+				}
+				if (!merged)
+				{
+					renderables[num_leaders] = renderable;
+					++ num_leaders;
+				}
+			}
+			renderables.resize(num_leaders);
+		}
+
+		for (auto& items : render_queue_)
+		{
+			for (auto const & renderable : items.second)
+			{
+				renderable->AllocateInstances();
+			}
+		}
+
+		instance_data_.Commit();
+	}
+
+	// Splits the clustered renderables of the pass across the thread pool. The caller culls too.
+	void SceneManager::CullClusters(Camera const & camera)
+	{
+		std::vector<Renderable*> clustered;
+		uint32_t num_clusters = 0;
+		for (auto const & items : render_queue_)
+		{
+			for (auto const & renderable : items.second)
+			{
+				if (renderable->NumClusters() > 0)
+				{
+					clustered.push_back(renderable);
+					num_clusters += renderable->NumClusters();
+				}
+			}
+		}
+		if (clustered.empty())
+		{
+			return;
+		}
+
+		Frustum const & frustum = camera.ViewFrustum();
+		float3 const & eye_pos = camera.EyePos();
+		float const proj_scale = camera.ProjMatrix()(1, 1);
+		float const threshold = small_obj_threshold_;
+		uint32_t const MIN_CLUSTERS_PER_WORKER = 256;
+		Context::Instance().ThreadPool().parallel_for(static_cast<uint32_t>(clustered.size()),
+			[&](uint32_t i)
+			{
+				clustered[i]->CullClusters(frustum, eye_pos, proj_scale, threshold);
+			},
+			std::max(num_clusters / MIN_CLUSTERS_PER_WORKER, 1U));
+	}
+
 	void SceneManager::FlushScene()
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
 		visible_marks_map_.clear();
+		instance_data_.BeginFrame();
+		this->SelectLods();
 
 		uint32_t urt;
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -775,16 +1094,20 @@ namespace KlayGE
 
 		num_draw_calls_ = re.NumDrawsJustCalled();
 		num_dispatch_calls_ = re.NumDispatchesJustCalled();
+		num_instance_bytes_uploaded_ = instance_data_.NumBytesUploaded();
 	}
 
 	void SceneManager::UpdateThreadFunc()
 	{
 		Timer timer;
 		float app_time = 0;
+		double last_time = 0;
+		double next_sweep = 0;
 		while (!quit_)
 		{
-			float const frame_time = static_cast<float>(timer.elapsed());
-			timer.restart();
+			double const now = timer.elapsed();
+			float const frame_time = static_cast<float>(now - last_time);
+			last_time = now;
 			app_time += frame_time;
 
 			if (Context::Instance().AppValid())
@@ -792,24 +1115,103 @@ namespace KlayGE
 				WindowPtr const & win = Context::Instance().AppInstance().MainWnd();
 				if (win && win->Active())
 				{
-					std::lock_guard<std::mutex> lock(update_mutex_);
+					KLAYGE_PERF_SCOPE("SceneManager::SubThreadUpdate");
+					this->SweepSubThreadUpdates(app_time, frame_time);
+				}
 
-					for (auto const & scene_obj : scene_objs_)
-					{
-						scene_obj->SubThreadUpdate(app_time, frame_time);
-					}
-					for (auto const & scene_obj : overlay_scene_objs_)
-					{
-						scene_obj->SubThreadUpdate(app_time, frame_time);
-					}
+				// Sweeps are due every sweep_elapse_ from the last one, so the sleeps rounded to milliseconds
+				// don't drift. Falling behind starts over from now, instead of catching up in a burst.
+				next_sweep = std::max(next_sweep + sweep_elapse_.load(std::memory_order_relaxed), now);
+				double const wait = next_sweep - timer.elapsed();
+				if (wait > 0)
+				{
+					Sleep(static_cast<uint32_t>(wait * 1000));
 				}
+			}
+		}
+	}
+
+	// Runs on the update thread, at the same time as Update and Flush on the main thread. Each sweep writes
+	// to the write slot of the triple buffer, and publishes it as a whole.
+	void SceneManager::SweepSubThreadUpdates(float app_time, float frame_time)
+	{
+		CountedLockGuard sweep_lock(sweep_mutex_, num_lock_waits_);
+
+		if (scene_objs_version_.load(std::memory_order_acquire) != sweep_objs_version_)
+		{
+			CountedLockGuard lock(update_mutex_, num_lock_waits_);
+
+			sweep_objs_.assign(scene_objs_.begin(), scene_objs_.end());
+			sweep_objs_version_ = scene_objs_version_.load(std::memory_order_relaxed);
+		}
 
-				if (frame_time < update_elapse_)
+		++ sub_thread_frame_;
+		uint32_t const frame = sub_thread_frame_;
+		uint32_t const slot = sub_thread_slots_.write_index();
+		uint32_t const num_objs = static_cast<uint32_t>(sweep_objs_.size());
+		Context::Instance().ThreadPool().parallel_for((num_objs + SWEEP_BATCH_SIZE - 1) / SWEEP_BATCH_SIZE,
+			[this, frame, slot, app_time, frame_time, num_objs](uint32_t batch)
+			{
+				uint32_t const end = std::min((batch + 1) * SWEEP_BATCH_SIZE, num_objs);
+				for (uint32_t i = batch * SWEEP_BATCH_SIZE; i < end; ++ i)
 				{
-					Sleep(static_cast<uint32_t>((update_elapse_ - frame_time) * 1000));
+					sweep_objs_[i]->SubThreadUpdateAndPublish(frame, slot, app_time, frame_time);
 				}
+			}, sub_thread_workers_);
+
+		if (sub_thread_slots_.publish())
+		{
+			num_dropped_sub_thread_frames_.fetch_add(1, std::memory_order_relaxed);
+#ifndef KLAYGE_SHIP
+			if (PerfProfiler* profiler = PerfProfiler::ExistingInstance())
+			{
+				profiler->IncCounter(PCT_DroppedSubThreadFrames);
+			}
+#endif
+		}
+	}
+
+	void SceneManager::SelectLods()
+	{
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		CameraPtr const & camera = re.DefaultFrameBuffer()->GetViewport()->camera;
+		bool const select_lod = camera && (lod_threshold_ > 0);
+
+		for (auto const & obj : scene_objs_)
+		{
+			auto so = obj.get();
+			int32_t lod = 0;
+			uint32_t const attr = so->Attrib();
+			if (select_lod && (0 == so->NumChildren()) && (attr & SceneObject::SOA_Cullable))
+			{
+				auto const & renderable = so->GetRenderable();
+				if (renderable && (renderable->NumLods() > 1))
+				{
+					if (attr & SceneObject::SOA_Moveable)
+					{
+						so->UpdateAbsModelMatrix();
+					}
+					lod = this->SelectLod(so, renderable->NumLods(), camera->EyePos(), camera->ViewProjMatrix());
+				}
+			}
+			so->Lod(lod);
+		}
+	}
+
+	int32_t SceneManager::SelectLod(SceneObject* obj, uint32_t num_lods, float3 const & eye_pos,
+		float4x4 const & view_proj) const
+	{
+		float const area = MathLib::perspective_area(eye_pos, view_proj, obj->PosBoundWS());
+		int32_t lod = 0;
+		if (area < lod_threshold_)
+		{
+			lod = static_cast<int32_t>(num_lods) - 1;
+			if (area > 0)
+			{
+				lod = std::min(lod, static_cast<int32_t>(std::log2(lod_threshold_ / area)));
 			}
 		}
+		return lod;
 	}
 
 	BoundOverlap SceneManager::VisibleTestFromParent(SceneObject* obj, float3 const & view_dir, float3 const & eye_pos,
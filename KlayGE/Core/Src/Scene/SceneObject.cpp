@@ -18,19 +18,35 @@
 #include <KlayGE/SceneManager.hpp>
 #include <KlayGE/Context.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDBatch.hpp>
 #include <KlayGE/Renderable.hpp>
 
 #include <boost/assert.hpp>
 
 #include <KlayGE/SceneObject.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	// The object in SubThreadUpdateAndPublish on this thread, and the index of its sweep
+	thread_local SceneObject const * sub_thread_obj = nullptr;
+	thread_local uint32_t sub_thread_frame = 0;
+}
+
 namespace KlayGE
 {
 	SceneObject::SceneObject(uint32_t attrib)
 		: attrib_(attrib), parent_(nullptr), renderable_hw_res_ready_(false),
 			model_(float4x4::Identity()), abs_model_(float4x4::Identity()),
-			visible_mark_(BO_No)
+			visible_mark_(BO_No), lod_(0),
+			sub_model_(float4x4::Identity()), sub_model_frame_(0), sub_model_version_(0),
+			acquired_model_frame_(0), main_model_version_(0)
 	{
+		published_model_frames_.fill(0);
+		published_model_versions_.fill(0);
+		main_model_versions_.fill(0);
+
 		if (!(attrib & SOA_Overlay) && (attrib & (SOA_Cullable | SOA_Moveable)))
 		{
 			pos_aabb_ws_ = MakeUniquePtr<AABBox>();
@@ -69,12 +85,26 @@ namespace KlayGE
 
 	void SceneObject::ModelMatrix(float4x4 const & mat)
 	{
-		model_ = mat;
+		if (sub_thread_obj == this)
+		{
+			sub_model_ = mat;
+			sub_model_frame_ = sub_thread_frame;
+		}
+		else
+		{
+			model_ = mat;
+
+			++ main_model_version_;
+			uint32_t const slot = main_model_index_.write_index();
+			main_models_[slot] = mat;
+			main_model_versions_[slot] = main_model_version_;
+			main_model_index_.publish();
+		}
 	}
 
 	float4x4 const & SceneObject::ModelMatrix() const
 	{
-		return model_;
+		return (sub_thread_obj == this) ? sub_model_ : model_;
 	}
 
 	float4x4 const & SceneObject::AbsModelMatrix() const
@@ -91,7 +121,7 @@ namespace KlayGE
 	{
 		if (parent_)
 		{
-			abs_model_ = parent_->ModelMatrix() * model_;
+			abs_model_ = SIMDMathLib::Multiply(parent_->ModelMatrix(), model_);
 		}
 		else
 		{
@@ -102,7 +132,7 @@ namespace KlayGE
 		{
 			if (pos_aabb_ws_)
 			{
-				*pos_aabb_ws_ = MathLib::transform_aabb(renderable_->PosBound(), abs_model_);
+				SIMDMathLib::TransformAABBs(pos_aabb_ws_.get(), renderable_->PosBound(), abs_model_);
 			}
 
 			renderable_->ModelMatrix(abs_model_);
@@ -119,6 +149,16 @@ namespace KlayGE
 		return visible_mark_;
 	}
 
+	void SceneObject::Lod(int32_t lod)
+	{
+		lod_ = lod;
+	}
+
+	int32_t SceneObject::Lod() const
+	{
+		return lod_;
+	}
+
 	void SceneObject::BindSubThreadUpdateFunc(std::function<void(SceneObject&, float, float)> const & update_func)
 	{
 		sub_thread_update_func_ = update_func;
@@ -137,6 +177,43 @@ namespace KlayGE
 		}
 	}
 
+	void SceneObject::SubThreadUpdateAndPublish(uint32_t frame, uint32_t slot, float app_time, float elapsed_time)
+	{
+		BOOST_ASSERT(frame != 0);
+
+		if (main_model_index_.acquire())
+		{
+			uint32_t const main_slot = main_model_index_.read_index();
+			sub_model_ = main_models_[main_slot];
+			sub_model_version_ = main_model_versions_[main_slot];
+		}
+
+		sub_thread_obj = this;
+		sub_thread_frame = frame;
+		this->SubThreadUpdate(app_time, elapsed_time);
+		sub_thread_obj = nullptr;
+
+		// Republished every sweep, the slots left behind by skipped sweeps would lose it otherwise
+		if (sub_model_frame_ != 0)
+		{
+			published_models_[slot] = sub_model_;
+			published_model_frames_[slot] = sub_model_frame_;
+			published_model_versions_[slot] = sub_model_version_;
+		}
+	}
+
+	void SceneObject::AcquireSubThreadState(uint32_t slot)
+	{
+		// Only newer than the last one taken, and built on the last ModelMatrix from the main thread. The ones
+		// from before it are dropped.
+		if ((published_model_frames_[slot] > acquired_model_frame_)
+			&& (published_model_versions_[slot] == main_model_version_))
+		{
+			model_ = published_models_[slot];
+			acquired_model_frame_ = published_model_frames_[slot];
+		}
+	}
+
 	bool SceneObject::MainThreadUpdate(float app_time, float elapsed_time)
 	{
 		bool refreshed = false;
@@ -0,0 +1,1001 @@
+/**
+* @file SceneQuery.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/SIMDBatch.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include <KlayGE/SceneQuery.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	typedef SIMDBatchF<4> Batch4;
+
+	uint32_t const NUM_BINS = 16;
+	uint32_t const MAX_LEAF_SIZE = 4;
+	// Deeper nodes are not split, so this is also the size of the traversal stacks
+	uint32_t const MAX_DEPTH = 64;
+
+	float const MIN_DIR = 1e-20f;
+	float const MIN_DET = 1e-20f;
+
+	struct PrimBound
+	{
+		float bb_min[3];
+		float bb_max[3];
+		float centroid[3];
+	};
+
+	struct PacketSoA
+	{
+		Batch4 orig[3];
+		Batch4 inv_dir[3];
+	};
+
+	void ResetBound(float* bb_min, float* bb_max)
+	{
+		for (int i = 0; i < 3; ++ i)
+		{
+			bb_min[i] = +std::numeric_limits<float>::max();
+			bb_max[i] = -std::numeric_limits<float>::max();
+		}
+	}
+
+	void GrowBound(float* bb_min, float* bb_max, float const * p_min, float const * p_max)
+	{
+		for (int i = 0; i < 3; ++ i)
+		{
+			bb_min[i] = std::min(bb_min[i], p_min[i]);
+			bb_max[i] = std::max(bb_max[i], p_max[i]);
+		}
+	}
+
+	float HalfArea(float const * bb_min, float const * bb_max)
+	{
+		float const dx = bb_max[0] - bb_min[0];
+		float const dy = bb_max[1] - bb_min[1];
+		float const dz = bb_max[2] - bb_min[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	float SafeRcp(float x)
+	{
+		if (MathLib::abs(x) < MIN_DIR)
+		{
+			x = (x < 0) ? -MIN_DIR : MIN_DIR;
+		}
+		return 1 / x;
+	}
+
+	float3 SafeRcp(float3 const & v)
+	{
+		return float3(SafeRcp(v.x()), SafeRcp(v.y()), SafeRcp(v.z()));
+	}
+
+	bool IntersectBox(float const * bb_min, float const * bb_max, float3 const & orig, float3 const & inv_dir,
+		float t_max, float& t_near)
+	{
+		float t0 = 0;
+		float t1 = t_max;
+		for (int i = 0; i < 3; ++ i)
+		{
+			float const ta = (bb_min[i] - orig[i]) * inv_dir[i];
+			float const tb = (bb_max[i] - orig[i]) * inv_dir[i];
+			t0 = std::max(t0, std::min(ta, tb));
+			t1 = std::min(t1, std::max(ta, tb));
+		}
+		t_near = t0;
+		return t0 <= t1;
+	}
+
+	// Returns the mask of lanes hitting the box
+	uint32_t IntersectBox(float const * bb_min, float const * bb_max, PacketSoA const & rays, Batch4 const & t_max)
+	{
+		Batch4 t_near = Batch4::Set(0);
+		Batch4 t_far = t_max;
+		for (int i = 0; i < 3; ++ i)
+		{
+			Batch4 const t0 = (Batch4::Set(bb_min[i]) - rays.orig[i]) * rays.inv_dir[i];
+			Batch4 const t1 = (Batch4::Set(bb_max[i]) - rays.orig[i]) * rays.inv_dir[i];
+			t_near = SIMDMathLib::Maximize(t_near, SIMDMathLib::Minimize(t0, t1));
+			t_far = SIMDMathLib::Minimize(t_far, SIMDMathLib::Maximize(t0, t1));
+		}
+		return ~SIMDMathLib::LessMask(t_far, t_near) & 0xF;
+	}
+
+	// Top down binned SAH. Nodes are written depth first, so the left child of a node is always the next one.
+	class BVHBuilder
+	{
+	public:
+		BVHBuilder(std::vector<PrimBound> const & prims, uint32_t max_leaf_size,
+				std::vector<BVHNode>& nodes, std::vector<uint32_t>& order)
+			: prims_(prims), max_leaf_size_(max_leaf_size), nodes_(nodes), order_(order)
+		{
+		}
+
+		void Build()
+		{
+			nodes_.clear();
+			order_.resize(prims_.size());
+			std::iota(order_.begin(), order_.end(), 0U);
+
+			if (!prims_.empty())
+			{
+				nodes_.reserve(prims_.size() * 2 / max_leaf_size_ + 1);
+				nodes_.emplace_back();
+				this->BuildNode(0, 0, static_cast<uint32_t>(prims_.size()), 0);
+			}
+		}
+
+	private:
+		void BuildNode(uint32_t node_index, uint32_t begin, uint32_t end, uint32_t depth)
+		{
+			BVHNode node;
+			float c_min[3];
+			float c_max[3];
+			ResetBound(node.bb_min, node.bb_max);
+			ResetBound(c_min, c_max);
+			for (uint32_t i = begin; i < end; ++ i)
+			{
+				PrimBound const & prim = prims_[order_[i]];
+				GrowBound(node.bb_min, node.bb_max, prim.bb_min, prim.bb_max);
+				GrowBound(c_min, c_max, prim.centroid, prim.centroid);
+			}
+
+			uint32_t const count = end - begin;
+			if ((count <= max_leaf_size_) || (depth + 1 >= MAX_DEPTH))
+			{
+				node.first = begin;
+				node.count = count;
+				nodes_[node_index] = node;
+				return;
+			}
+
+			uint32_t const mid = this->Split(begin, end, c_min, c_max);
+
+			node.first = 0;
+			node.count = 0;
+			nodes_[node_index] = node;
+
+			uint32_t const left = static_cast<uint32_t>(nodes_.size());
+			BOOST_ASSERT(left == node_index + 1);
+			nodes_.emplace_back();
+			this->BuildNode(left, begin, mid, depth + 1);
+
+			uint32_t const right = static_cast<uint32_t>(nodes_.size());
+			nodes_.emplace_back();
+			nodes_[node_index].first = right;
+			this->BuildNode(right, mid, end, depth + 1);
+		}
+
+		uint32_t Split(uint32_t begin, uint32_t end, float const * c_min, float const * c_max)
+		{
+			float best_cost = std::numeric_limits<float>::max();
+			int best_axis = -1;
+			uint32_t best_bin = 0;
+
+			for (int axis = 0; axis < 3; ++ axis)
+			{
+				float const extent = c_max[axis] - c_min[axis];
+				if (extent <= 0)
+				{
+					continue;
+				}
+				float const scale = NUM_BINS / extent;
+
+				uint32_t bin_counts[NUM_BINS] = {};
+				float bin_min[NUM_BINS][3];
+				float bin_max[NUM_BINS][3];
+				for (uint32_t b = 0; b < NUM_BINS; ++ b)
+				{
+					ResetBound(bin_min[b], bin_max[b]);
+				}
+				for (uint32_t i = begin; i < end; ++ i)
+				{
+					PrimBound const & prim = prims_[order_[i]];
+					uint32_t const b = this->Bin(prim, axis, c_min[axis], scale);
+					++ bin_counts[b];
+					GrowBound(bin_min[b], bin_max[b], prim.bb_min, prim.bb_max);
+				}
+
+				// right_costs[b] is the cost of the bins from b to the end
+				float right_costs[NUM_BINS];
+				{
+					float bb_min[3];
+					float bb_max[3];
+					ResetBound(bb_min, bb_max);
+					uint32_t right_count = 0;
+					for (uint32_t b = NUM_BINS - 1; b > 0; -- b)
+					{
+						right_count += bin_counts[b];
+						GrowBound(bb_min, bb_max, bin_min[b], bin_max[b]);
+						right_costs[b] = (right_count > 0) ? HalfArea(bb_min, bb_max) * right_count : 0;
+					}
+				}
+
+				float bb_min[3];
+				float bb_max[3];
+				ResetBound(bb_min, bb_max);
+				uint32_t left_count = 0;
+				for (uint32_t b = 1; b < NUM_BINS; ++ b)
+				{
+					left_count += bin_counts[b - 1];
+					GrowBound(bb_min, bb_max, bin_min[b - 1], bin_max[b - 1]);
+					if ((left_count > 0) && (left_count < end - begin))
+					{
+						float const cost = HalfArea(bb_min, bb_max) * left_count + right_costs[b];
+						if (cost < best_cost)
+						{
+							best_cost = cost;
+							best_axis = axis;
+							best_bin = b;
+						}
+					}
+				}
+			}
+
+			uint32_t mid = begin + (end - begin) / 2;
+			if (best_axis >= 0)
+			{
+				float const c_min_axis = c_min[best_axis];
+				float const scale = NUM_BINS / (c_max[best_axis] - c_min[best_axis]);
+				auto const iter = std::partition(order_.begin() + begin, order_.begin() + end,
+					[this, best_axis, best_bin, c_min_axis, scale](uint32_t index)
+					{
+						return this->Bin(prims_[index], best_axis, c_min_axis, scale) < best_bin;
+					});
+				uint32_t const split = static_cast<uint32_t>(iter - order_.begin());
+				if ((split > begin) && (split < end))
+				{
+					mid = split;
+				}
+			}
+			// Otherwise all the centroids are at one point, any split is as good
+			return mid;
+		}
+
+		uint32_t Bin(PrimBound const & prim, int axis, float c_min, float scale) const
+		{
+			float const b = (prim.centroid[axis] - c_min) * scale;
+			return std::min(static_cast<uint32_t>(std::max(b, 0.0f)), NUM_BINS - 1);
+		}
+
+	private:
+		std::vector<PrimBound> const & prims_;
+		uint32_t max_leaf_size_;
+		std::vector<BVHNode>& nodes_;
+		std::vector<uint32_t>& order_;
+	};
+}
+
+namespace KlayGE
+{
+	uint32_t const SceneRayHit::INVALID_INDEX;
+
+
+	TriangleBVH::TriangleBVH(ArrayRef<float3> positions, ArrayRef<uint32_t> indices)
+		: num_triangles_(static_cast<uint32_t>(indices.size() / 3))
+	{
+		std::vector<PrimBound> prims(num_triangles_);
+		for (uint32_t i = 0; i < num_triangles_; ++ i)
+		{
+			PrimBound& prim = prims[i];
+			ResetBound(prim.bb_min, prim.bb_max);
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				BOOST_ASSERT(indices[i * 3 + j] < positions.size());
+				float3 const & pos = positions[indices[i * 3 + j]];
+				GrowBound(prim.bb_min, prim.bb_max, &pos[0], &pos[0]);
+			}
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				prim.centroid[j] = (prim.bb_min[j] + prim.bb_max[j]) * 0.5f;
+			}
+		}
+
+		std::vector<uint32_t> order;
+		BVHBuilder(prims, MAX_LEAF_SIZE, nodes_, order).Build();
+
+		// Leaves point to their quads instead of the triangles. A leaf deeper than MAX_DEPTH can have more than one.
+		for (auto& node : nodes_)
+		{
+			if (node.count > 0)
+			{
+				uint32_t const first_quad = static_cast<uint32_t>(quads_.size());
+				for (uint32_t i = 0; i < node.count; i += 4)
+				{
+					TriangleQuad quad;
+					std::memset(&quad, 0, sizeof(quad));
+					for (uint32_t lane = 0; lane < 4; ++ lane)
+					{
+						if (i + lane < node.count)
+						{
+							uint32_t const tri = order[node.first + i + lane];
+							float3 const & v0 = positions[indices[tri * 3 + 0]];
+							float3 const & v1 = positions[indices[tri * 3 + 1]];
+							float3 const & v2 = positions[indices[tri * 3 + 2]];
+							for (int c = 0; c < 3; ++ c)
+							{
+								quad.v0[c][lane] = v0[c];
+								quad.e1[c][lane] = v1[c] - v0[c];
+								quad.e2[c][lane] = v2[c] - v0[c];
+							}
+							quad.triangles[lane] = tri;
+						}
+						else
+						{
+							// Degenerated, never hit
+							quad.triangles[lane] = SceneRayHit::INVALID_INDEX;
+						}
+					}
+					quads_.push_back(quad);
+				}
+				node.first = first_quad;
+			}
+		}
+	}
+
+	AABBox TriangleBVH::Bound() const
+	{
+		if (nodes_.empty())
+		{
+			return AABBox(float3(0, 0, 0), float3(0, 0, 0));
+		}
+		else
+		{
+			BVHNode const & root = nodes_[0];
+			return AABBox(float3(root.bb_min), float3(root.bb_max));
+		}
+	}
+
+	bool TriangleBVH::RayCast(float3 const & orig, float3 const & dir, Hit& hit) const
+	{
+		return this->RayCast(orig, dir, SafeRcp(dir), hit);
+	}
+
+	bool TriangleBVH::RayCast(float3 const & orig, float3 const & dir, float3 const & inv_dir, Hit& hit) const
+	{
+		float t_near;
+		if (nodes_.empty() || !IntersectBox(nodes_[0].bb_min, nodes_[0].bb_max, orig, inv_dir, hit.dist, t_near))
+		{
+			return false;
+		}
+
+		bool found = false;
+		uint32_t stack[MAX_DEPTH];
+		uint32_t stack_size = 0;
+		uint32_t node_index = 0;
+		for (;;)
+		{
+			BVHNode const & node = nodes_[node_index];
+			if (node.count > 0)
+			{
+				uint32_t const num_quads = (node.count + 3) / 4;
+				for (uint32_t i = 0; i < num_quads; ++ i)
+				{
+					found |= IntersectQuad(quads_[node.first + i], orig, dir, hit);
+				}
+			}
+			else
+			{
+				uint32_t left = node_index + 1;
+				uint32_t right = node.first;
+				float t_left;
+				float t_right;
+				bool const hit_left = IntersectBox(nodes_[left].bb_min, nodes_[left].bb_max, orig, inv_dir, hit.dist, t_left);
+				bool const hit_right = IntersectBox(nodes_[right].bb_min, nodes_[right].bb_max, orig, inv_dir, hit.dist, t_right);
+				if (hit_left && hit_right)
+				{
+					if (t_right < t_left)
+					{
+						std::swap(left, right);
+					}
+					BOOST_ASSERT(stack_size < MAX_DEPTH);
+					stack[stack_size] = right;
+					++ stack_size;
+					node_index = left;
+					continue;
+				}
+				else if (hit_left || hit_right)
+				{
+					node_index = hit_left ? left : right;
+					continue;
+				}
+			}
+
+			if (0 == stack_size)
+			{
+				break;
+			}
+			-- stack_size;
+			node_index = stack[stack_size];
+		}
+
+		return found;
+	}
+
+	uint32_t TriangleBVH::RayCast(RayPacket const & packet, uint32_t active_mask, Hit* hits) const
+	{
+		if (nodes_.empty() || (0 == active_mask))
+		{
+			return 0;
+		}
+
+		PacketSoA rays;
+		for (int i = 0; i < 3; ++ i)
+		{
+			rays.orig[i] = Batch4::Load(packet.orig[i]);
+			rays.inv_dir[i] = Batch4::Load(packet.inv_dir[i]);
+		}
+		float t_max[4];
+		for (uint32_t lane = 0; lane < 4; ++ lane)
+		{
+			t_max[lane] = hits[lane].dist;
+		}
+		Batch4 t_max_batch = Batch4::Load(t_max);
+
+		uint32_t hit_mask = 0;
+		uint32_t stack_nodes[MAX_DEPTH];
+		uint32_t stack_masks[MAX_DEPTH];
+		uint32_t stack_size = 1;
+		stack_nodes[0] = 0;
+		stack_masks[0] = active_mask;
+		while (stack_size > 0)
+		{
+			-- stack_size;
+			uint32_t node_index = stack_nodes[stack_size];
+			uint32_t mask = stack_masks[stack_size]
+				& IntersectBox(nodes_[node_index].bb_min, nodes_[node_index].bb_max, rays, t_max_batch);
+			while (mask != 0)
+			{
+				BVHNode const & node = nodes_[node_index];
+				if (node.count > 0)
+				{
+					uint32_t const num_quads = (node.count + 3) / 4;
+					for (uint32_t lane = 0; lane < 4; ++ lane)
+					{
+						if (mask & (1UL << lane))
+						{
+							float3 const orig(packet.orig[0][lane], packet.orig[1][lane], packet.orig[2][lane]);
+							float3 const dir(packet.dir[0][lane], packet.dir[1][lane], packet.dir[2][lane]);
+							for (uint32_t i = 0; i < num_quads; ++ i)
+							{
+								if (IntersectQuad(quads_[node.first + i], orig, dir, hits[lane]))
+								{
+									hit_mask |= 1UL << lane;
+									t_max[lane] = hits[lane].dist;
+								}
+							}
+						}
+					}
+					t_max_batch = Batch4::Load(t_max);
+					break;
+				}
+
+				uint32_t const left = node_index + 1;
+				uint32_t const right = node.first;
+				uint32_t const left_mask = mask & IntersectBox(nodes_[left].bb_min, nodes_[left].bb_max, rays, t_max_batch);
+				uint32_t const right_mask = mask & IntersectBox(nodes_[right].bb_min, nodes_[right].bb_max, rays, t_max_batch);
+				if (left_mask && right_mask)
+				{
+					BOOST_ASSERT(stack_size < MAX_DEPTH);
+					stack_nodes[stack_size] = right;
+					stack_masks[stack_size] = right_mask;
+					++ stack_size;
+				}
+				node_index = left_mask ? left : right;
+				mask = left_mask ? left_mask : right_mask;
+			}
+		}
+
+		return hit_mask;
+	}
+
+	// Moller-Trumbore on 4 triangles at once
+	bool TriangleBVH::IntersectQuad(TriangleQuad const & quad, float3 const & orig, float3 const & dir, Hit& hit)
+	{
+		Batch4 const dx = Batch4::Set(dir.x());
+		Batch4 const dy = Batch4::Set(dir.y());
+		Batch4 const dz = Batch4::Set(dir.z());
+		Batch4 const e1x = Batch4::Load(quad.e1[0]);
+		Batch4 const e1y = Batch4::Load(quad.e1[1]);
+		Batch4 const e1z = Batch4::Load(quad.e1[2]);
+		Batch4 const e2x = Batch4::Load(quad.e2[0]);
+		Batch4 const e2y = Batch4::Load(quad.e2[1]);
+		Batch4 const e2z = Batch4::Load(quad.e2[2]);
+
+		Batch4 const px = dy * e2z - dz * e2y;
+		Batch4 const py = dz * e2x - dx * e2z;
+		Batch4 const pz = dx * e2y - dy * e2x;
+		Batch4 const det = e1x * px + e1y * py + e1z * pz;
+		Batch4 const inv_det = Batch4::Set(1) / det;
+
+		Batch4 const tx = Batch4::Set(orig.x()) - Batch4::Load(quad.v0[0]);
+		Batch4 const ty = Batch4::Set(orig.y()) - Batch4::Load(quad.v0[1]);
+		Batch4 const tz = Batch4::Set(orig.z()) - Batch4::Load(quad.v0[2]);
+		Batch4 const u = (tx * px + ty * py + tz * pz) * inv_det;
+
+		Batch4 const qx = ty * e1z - tz * e1y;
+		Batch4 const qy = tz * e1x - tx * e1z;
+		Batch4 const qz = tx * e1y - ty * e1x;
+		Batch4 const v = (dx * qx + dy * qy + dz * qz) * inv_det;
+		Batch4 const t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+		// Degenerated triangles have NaNs after the division, they are taken out by the det test
+		Batch4 const zero = Batch4::Set(0);
+		uint32_t mask = SIMDMathLib::LessMask(Batch4::Set(MIN_DET), SIMDMathLib::Abs(det));
+		mask &= ~SIMDMathLib::LessMask(u, zero) & ~SIMDMathLib::LessMask(v, zero);
+		mask &= ~SIMDMathLib::LessMask(Batch4::Set(1), u + v);
+		mask &= ~SIMDMathLib::LessMask(t, zero) & SIMDMathLib::LessMask(t, Batch4::Set(hit.dist));
+		if (0 == mask)
+		{
+			return false;
+		}
+
+		float ts[4];
+		float us[4];
+		float vs[4];
+		t.Store(ts);
+		u.Store(us);
+		v.Store(vs);
+		bool found = false;
+		for (uint32_t lane = 0; lane < 4; ++ lane)
+		{
+			if ((mask & (1UL << lane)) && (ts[lane] < hit.dist))
+			{
+				hit.dist = ts[lane];
+				hit.triangle = quad.triangles[lane];
+				hit.u = us[lane];
+				hit.v = vs[lane];
+				found = true;
+			}
+		}
+		return found;
+	}
+
+
+	SceneBVH::SceneBVH()
+	{
+	}
+
+	void SceneBVH::Clear()
+	{
+		instances_.clear();
+		meshes_.clear();
+		nodes_.clear();
+		leaf_instances_.clear();
+	}
+
+	uint32_t SceneBVH::AddInstance(SceneObject* obj, AABBox const & bound_ws, float4x4 const & model,
+		ArrayRef<TriangleBVHPtr> meshes)
+	{
+		Instance inst;
+		inst.obj = obj;
+		inst.bound_ws = bound_ws;
+		inst.inv_model = MathLib::inverse(model);
+		inst.first_mesh = static_cast<uint32_t>(meshes_.size());
+		inst.num_meshes = static_cast<uint32_t>(meshes.size());
+		inst.has_triangles = std::any_of(meshes.begin(), meshes.end(),
+			[](TriangleBVHPtr const & mesh)
+			{
+				return !!mesh;
+			});
+		inst.enabled = true;
+
+		meshes_.insert(meshes_.end(), meshes.begin(), meshes.end());
+		instances_.push_back(inst);
+		return static_cast<uint32_t>(instances_.size() - 1);
+	}
+
+	void SceneBVH::UpdateInstance(uint32_t index, AABBox const & bound_ws, float4x4 const & model)
+	{
+		Instance& inst = instances_[index];
+		inst.bound_ws = bound_ws;
+		inst.inv_model = MathLib::inverse(model);
+	}
+
+	void SceneBVH::EnableInstance(uint32_t index, bool enable)
+	{
+		instances_[index].enabled = enable;
+	}
+
+	void SceneBVH::Build()
+	{
+		std::vector<PrimBound> prims(instances_.size());
+		for (size_t i = 0; i < instances_.size(); ++ i)
+		{
+			AABBox const & bound = instances_[i].bound_ws;
+			for (int j = 0; j < 3; ++ j)
+			{
+				prims[i].bb_min[j] = bound.Min()[j];
+				prims[i].bb_max[j] = bound.Max()[j];
+				prims[i].centroid[j] = (bound.Min()[j] + bound.Max()[j]) * 0.5f;
+			}
+		}
+
+		BVHBuilder(prims, MAX_LEAF_SIZE, nodes_, leaf_instances_).Build();
+	}
+
+	void SceneBVH::Refit()
+	{
+		// Children are always after their parent
+		for (size_t i = nodes_.size(); i > 0; -- i)
+		{
+			BVHNode& node = nodes_[i - 1];
+			ResetBound(node.bb_min, node.bb_max);
+			if (node.count > 0)
+			{
+				for (uint32_t j = 0; j < node.count; ++ j)
+				{
+					AABBox const & bound = instances_[leaf_instances_[node.first + j]].bound_ws;
+					GrowBound(node.bb_min, node.bb_max, &bound.Min()[0], &bound.Max()[0]);
+				}
+			}
+			else
+			{
+				BVHNode const & left = nodes_[i];
+				BVHNode const & right = nodes_[node.first];
+				GrowBound(node.bb_min, node.bb_max, left.bb_min, left.bb_max);
+				GrowBound(node.bb_min, node.bb_max, right.bb_min, right.bb_max);
+			}
+		}
+	}
+
+	void SceneBVH::IntersectInstance(uint32_t index, SceneRay const & ray, float3 const & inv_dir, SceneRayHit& hit) const
+	{
+		Instance const & inst = instances_[index];
+		float t_near;
+		if (!inst.enabled
+			|| !IntersectBox(&inst.bound_ws.Min()[0], &inst.bound_ws.Max()[0], ray.orig, inv_dir, hit.dist, t_near))
+		{
+			return;
+		}
+
+		if (inst.has_triangles)
+		{
+			float3 const orig = MathLib::transform_coord(ray.orig, inst.inv_model);
+			float3 const dir = MathLib::transform_normal(ray.dir, inst.inv_model);
+			float3 const inv_dir_ms = SafeRcp(dir);
+
+			TriangleBVH::Hit tri_hit = { hit.dist, SceneRayHit::INVALID_INDEX, 0, 0 };
+			for (uint32_t i = 0; i < inst.num_meshes; ++ i)
+			{
+				TriangleBVHPtr const & mesh = meshes_[inst.first_mesh + i];
+				if (mesh && mesh->RayCast(orig, dir, inv_dir_ms, tri_hit))
+				{
+					hit.obj = inst.obj;
+					hit.instance = index;
+					hit.mesh = i;
+					hit.triangle = tri_hit.triangle;
+					hit.dist = tri_hit.dist;
+					hit.u = tri_hit.u;
+					hit.v = tri_hit.v;
+				}
+			}
+		}
+		else if (t_near < hit.dist)
+		{
+			hit.obj = inst.obj;
+			hit.instance = index;
+			hit.mesh = SceneRayHit::INVALID_INDEX;
+			hit.triangle = SceneRayHit::INVALID_INDEX;
+			hit.dist = t_near;
+			hit.u = 0;
+			hit.v = 0;
+		}
+	}
+
+	bool SceneBVH::RayCast(SceneRay const & ray, SceneRayHit& hit) const
+	{
+		hit.obj = nullptr;
+		hit.instance = SceneRayHit::INVALID_INDEX;
+		hit.mesh = SceneRayHit::INVALID_INDEX;
+		hit.triangle = SceneRayHit::INVALID_INDEX;
+		hit.dist = ray.max_dist;
+		hit.u = 0;
+		hit.v = 0;
+
+		float3 const inv_dir = SafeRcp(ray.dir);
+		float t_near;
+		if (nodes_.empty() || !IntersectBox(nodes_[0].bb_min, nodes_[0].bb_max, ray.orig, inv_dir, hit.dist, t_near))
+		{
+			return false;
+		}
+
+		uint32_t stack[MAX_DEPTH];
+		uint32_t stack_size = 0;
+		uint32_t node_index = 0;
+		for (;;)
+		{
+			BVHNode const & node = nodes_[node_index];
+			if (node.count > 0)
+			{
+				for (uint32_t i = 0; i < node.count; ++ i)
+				{
+					this->IntersectInstance(leaf_instances_[node.first + i], ray, inv_dir, hit);
+				}
+			}
+			else
+			{
+				uint32_t left = node_index + 1;
+				uint32_t right = node.first;
+				float t_left;
+				float t_right;
+				bool const hit_left = IntersectBox(nodes_[left].bb_min, nodes_[left].bb_max, ray.orig, inv_dir, hit.dist, t_left);
+				bool const hit_right = IntersectBox(nodes_[right].bb_min, nodes_[right].bb_max, ray.orig, inv_dir, hit.dist, t_right);
+				if (hit_left && hit_right)
+				{
+					if (t_right < t_left)
+					{
+						std::swap(left, right);
+					}
+					BOOST_ASSERT(stack_size < MAX_DEPTH);
+					stack[stack_size] = right;
+					++ stack_size;
+					node_index = left;
+					continue;
+				}
+				else if (hit_left || hit_right)
+				{
+					node_index = hit_left ? left : right;
+					continue;
+				}
+			}
+
+			if (0 == stack_size)
+			{
+				break;
+			}
+			-- stack_size;
+			node_index = stack[stack_size];
+		}
+
+		return hit.instance != SceneRayHit::INVALID_INDEX;
+	}
+
+	void SceneBVH::RayCast(ArrayRef<SceneRay> rays, SceneRayHit* hits) const
+	{
+		for (size_t base = 0; base < rays.size(); base += 4)
+		{
+			uint32_t const num_lanes = static_cast<uint32_t>(std::min<size_t>(4, rays.size() - base));
+			uint32_t const active_mask = (1UL << num_lanes) - 1;
+
+			// Missing lanes repeat the first ray. They are never active.
+			float orig[3][4];
+			float inv_dir[3][4];
+			float t_max[4];
+			for (uint32_t lane = 0; lane < 4; ++ lane)
+			{
+				SceneRay const & ray = rays[base + ((lane < num_lanes) ? lane : 0)];
+				float3 const rcp = SafeRcp(ray.dir);
+				for (int c = 0; c < 3; ++ c)
+				{
+					orig[c][lane] = ray.orig[c];
+					inv_dir[c][lane] = rcp[c];
+				}
+				t_max[lane] = ray.max_dist;
+
+				if (lane < num_lanes)
+				{
+					SceneRayHit& hit = hits[base + lane];
+					hit.obj = nullptr;
+					hit.instance = SceneRayHit::INVALID_INDEX;
+					hit.mesh = SceneRayHit::INVALID_INDEX;
+					hit.triangle = SceneRayHit::INVALID_INDEX;
+					hit.dist = ray.max_dist;
+					hit.u = 0;
+					hit.v = 0;
+				}
+			}
+
+			if (nodes_.empty())
+			{
+				continue;
+			}
+
+			PacketSoA packet;
+			for (int c = 0; c < 3; ++ c)
+			{
+				packet.orig[c] = Batch4::Load(orig[c]);
+				packet.inv_dir[c] = Batch4::Load(inv_dir[c]);
+			}
+			Batch4 t_max_batch = Batch4::Load(t_max);
+
+			uint32_t stack_nodes[MAX_DEPTH];
+			uint32_t stack_masks[MAX_DEPTH];
+			uint32_t stack_size = 1;
+			stack_nodes[0] = 0;
+			stack_masks[0] = active_mask;
+			while (stack_size > 0)
+			{
+				-- stack_size;
+				uint32_t node_index = stack_nodes[stack_size];
+				uint32_t mask = stack_masks[stack_size]
+					& IntersectBox(nodes_[node_index].bb_min, nodes_[node_index].bb_max, packet, t_max_batch);
+				while (mask != 0)
+				{
+					BVHNode const & node = nodes_[node_index];
+					if (node.count > 0)
+					{
+						for (uint32_t i = 0; i < node.count; ++ i)
+						{
+							uint32_t const index = leaf_instances_[node.first + i];
+							Instance const & inst = instances_[index];
+							uint32_t const inst_mask = inst.enabled
+								? (mask & IntersectBox(&inst.bound_ws.Min()[0], &inst.bound_ws.Max()[0], packet, t_max_batch)) : 0;
+							if (0 == inst_mask)
+							{
+								continue;
+							}
+
+							if (inst.has_triangles)
+							{
+								TriangleBVH::RayPacket packet_ms;
+								TriangleBVH::Hit tri_hits[4];
+								for (uint32_t lane = 0; lane < 4; ++ lane)
+								{
+									SceneRay const & ray = rays[base + ((lane < num_lanes) ? lane : 0)];
+									float3 const orig_ms = MathLib::transform_coord(ray.orig, inst.inv_model);
+									float3 const dir_ms = MathLib::transform_normal(ray.dir, inst.inv_model);
+									float3 const inv_dir_ms = SafeRcp(dir_ms);
+									for (int c = 0; c < 3; ++ c)
+									{
+										packet_ms.orig[c][lane] = orig_ms[c];
+										packet_ms.dir[c][lane] = dir_ms[c];
+										packet_ms.inv_dir[c][lane] = inv_dir_ms[c];
+									}
+									tri_hits[lane].dist = t_max[lane];
+									tri_hits[lane].triangle = SceneRayHit::INVALID_INDEX;
+									tri_hits[lane].u = 0;
+									tri_hits[lane].v = 0;
+								}
+
+								for (uint32_t m = 0; m < inst.num_meshes; ++ m)
+								{
+									TriangleBVHPtr const & mesh = meshes_[inst.first_mesh + m];
+									uint32_t const hit_mask = mesh ? mesh->RayCast(packet_ms, inst_mask, tri_hits) : 0;
+									for (uint32_t lane = 0; lane < 4; ++ lane)
+									{
+										if (hit_mask & (1UL << lane))
+										{
+											SceneRayHit& hit = hits[base + lane];
+											hit.obj = inst.obj;
+											hit.instance = index;
+											hit.mesh = m;
+											hit.triangle = tri_hits[lane].triangle;
+											hit.dist = tri_hits[lane].dist;
+											hit.u = tri_hits[lane].u;
+											hit.v = tri_hits[lane].v;
+											t_max[lane] = hit.dist;
+										}
+									}
+								}
+							}
+							else
+							{
+								for (uint32_t lane = 0; lane < 4; ++ lane)
+								{
+									float t_near;
+									if ((inst_mask & (1UL << lane))
+										&& IntersectBox(&inst.bound_ws.Min()[0], &inst.bound_ws.Max()[0], rays[base + lane].orig,
+											float3(inv_dir[0][lane], inv_dir[1][lane], inv_dir[2][lane]), t_max[lane], t_near)
+										&& (t_near < t_max[lane]))
+									{
+										SceneRayHit& hit = hits[base + lane];
+										hit.obj = inst.obj;
+										hit.instance = index;
+										hit.mesh = SceneRayHit::INVALID_INDEX;
+										hit.triangle = SceneRayHit::INVALID_INDEX;
+										hit.dist = t_near;
+										hit.u = 0;
+										hit.v = 0;
+										t_max[lane] = t_near;
+									}
+								}
+							}
+
+							t_max_batch = Batch4::Load(t_max);
+						}
+						break;
+					}
+
+					uint32_t const left = node_index + 1;
+					uint32_t const right = node.first;
+					uint32_t const left_mask = mask & IntersectBox(nodes_[left].bb_min, nodes_[left].bb_max, packet, t_max_batch);
+					uint32_t const right_mask = mask & IntersectBox(nodes_[right].bb_min, nodes_[right].bb_max, packet, t_max_batch);
+					if (left_mask && right_mask)
+					{
+						BOOST_ASSERT(stack_size < MAX_DEPTH);
+						stack_nodes[stack_size] = right;
+						stack_masks[stack_size] = right_mask;
+						++ stack_size;
+					}
+					node_index = left_mask ? left : right;
+					mask = left_mask ? left_mask : right_mask;
+				}
+			}
+		}
+	}
+
+	void SceneBVH::Overlap(AABBox const & aabb, std::vector<uint32_t>& instances) const
+	{
+		instances.clear();
+		if (nodes_.empty())
+		{
+			return;
+		}
+
+		// Both children are pushed, one more slot than the depth
+		uint32_t stack[MAX_DEPTH + 1];
+		uint32_t stack_size = 1;
+		stack[0] = 0;
+		while (stack_size > 0)
+		{
+			-- stack_size;
+			uint32_t const node_index = stack[stack_size];
+			BVHNode const & node = nodes_[node_index];
+			bool overlap = true;
+			for (int i = 0; i < 3; ++ i)
+			{
+				overlap &= (node.bb_min[i] <= aabb.Max()[i]) && (node.bb_max[i] >= aabb.Min()[i]);
+			}
+			if (!overlap)
+			{
+				continue;
+			}
+
+			if (node.count > 0)
+			{
+				for (uint32_t i = 0; i < node.count; ++ i)
+				{
+					uint32_t const index = leaf_instances_[node.first + i];
+					Instance const & inst = instances_[index];
+					if (inst.enabled && MathLib::intersect_aabb_aabb(inst.bound_ws, aabb))
+					{
+						instances.push_back(index);
+					}
+				}
+			}
+			else
+			{
+				BOOST_ASSERT(stack_size + 2 <= MAX_DEPTH + 1);
+				stack[stack_size] = node.first;
+				stack[stack_size + 1] = node_index + 1;
+				stack_size += 2;
+			}
+		}
+	}
+}
@@ -32,11 +32,11 @@
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/Font.hpp>
 #include <KFL/Thread.hpp>
-#include <KlayGE/TransientBuffer.hpp>
 #include <KFL/Hash.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Window.hpp>
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 
@@ -76,6 +76,9 @@ namespace
 		Click,
 		Touch
 	};
+
+	uint32_t const ATLAS_SIZE = 2048;
+	uint32_t const ATLAS_PADDING = 4;
 }
 
 namespace KlayGE
@@ -88,30 +91,12 @@ namespace KlayGE
 	public:
 		UIRectRenderable(TexturePtr const & texture, RenderEffectPtr const & effect)
 			: RenderableHelper(L"UIRect"),
-				texture_(texture)
+				texture_(texture), num_quads_(0)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
-			restart_ = rf.RenderEngineInstance().DeviceCaps().primitive_restart_support;
-
 			rl_ = rf.MakeRenderLayout();
-			if (restart_)
-			{
-				rl_->TopologyType(RenderLayout::TT_TriangleStrip);
-			}
-			else
-			{
-				rl_->TopologyType(RenderLayout::TT_TriangleList);
-			}
-
-			uint32_t const INDEX_PER_QUAD = restart_ ? 5 : 6;
-			uint32_t const INIT_NUM_QUAD = 1024;
-			tb_vb_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * 4 * sizeof(UIManager::VertexFormat)), TransientBuffer::BF_Vertex);
-			tb_ib_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * INDEX_PER_QUAD * sizeof(uint16_t)), TransientBuffer::BF_Index);
-
-			rl_->BindVertexStream(tb_vb_->GetBuffer(), { VertexElement(VEU_Position, 0, EF_BGR32F),
-				VertexElement(VEU_Diffuse, 0, EF_ABGR32F), VertexElement(VEU_TextureCoord, 0, EF_GR32F) });
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
+			rl_->TopologyType(RenderLayout::TT_TriangleList);
 
 			effect_ = effect;
 			if (texture)
@@ -130,117 +115,102 @@ namespace KlayGE
 
 		bool Empty() const
 		{
-			return tb_ib_sub_allocs_.empty();
-		}
-
-		void OnRenderBegin()
-		{
-			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
-
-			*ui_tex_ep_ = texture_;
-
-			RenderEngine& re = rf.RenderEngineInstance();
-			float const half_width = re.CurFrameBuffer()->Width() / 2.0f;
-			float const half_height = re.CurFrameBuffer()->Height() / 2.0f;
-
-			*half_width_height_ep_ = float2(half_width, half_height);
-			*dpi_scale_ep_ = Context::Instance().AppInstance().MainWnd()->DPIScale();
-
-			tb_vb_->EnsureDataReady();
-			tb_ib_->EnsureDataReady();
-
-			rl_->SetVertexStream(0, tb_vb_->GetBuffer());
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
-		}
-		
-		void OnRenderEnd()
-		{
-			tb_vb_->OnPresent();
-			tb_ib_->OnPresent();
-
-			tb_vb_sub_allocs_.clear();
-			tb_ib_sub_allocs_.clear();
+			return 0 == num_quads_;
 		}
 
-		void Render()
+		// Only the range between the first and the last changed vertices is uploaded.
+		void UpdateQuads(std::vector<UIManager::VertexFormat> const & vertices,
+			std::vector<UIManager::VertexFormat> const & prev_vertices)
 		{
-			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+			BOOST_ASSERT(0 == (vertices.size() & 3));
+			BOOST_ASSERT(vertices.size() <= 0x10000);
 
-			this->OnRenderBegin();
+			uint32_t const vert_size = sizeof(UIManager::VertexFormat);
+			uint32_t const num_verts = static_cast<uint32_t>(vertices.size());
+			num_quads_ = num_verts / 4;
+			if (0 == num_quads_)
+			{
+				return;
+			}
 
-			BOOST_ASSERT(tb_vb_sub_allocs_.size() == tb_ib_sub_allocs_.size());
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+			uint32_t first = 0;
+			uint32_t last = num_verts;
+			if (!vb_ || (vb_->Size() < num_verts * vert_size))
 			{
-				uint32_t vert_length = tb_vb_sub_allocs_[i].length_;
-				uint32_t const ind_offset = tb_ib_sub_allocs_[i].offset_;
-				uint32_t ind_length = tb_ib_sub_allocs_[i].length_;
-
-				while ((i + 1 < tb_vb_sub_allocs_.size())
-					&& (tb_vb_sub_allocs_[i].offset_ + tb_vb_sub_allocs_[i].length_ == tb_vb_sub_allocs_[i + 1].offset_)
-					&& (tb_ib_sub_allocs_[i].offset_ + tb_ib_sub_allocs_[i].length_ == tb_ib_sub_allocs_[i + 1].offset_))
+				uint32_t const num_alloc_verts = std::max(std::max(num_verts, 256U),
+					vb_ ? vb_->Size() / vert_size * 2 : 0);
+				vb_ = rf.MakeVertexBuffer(BU_Static, EAH_GPU_Read, num_alloc_verts * vert_size, nullptr);
+				rl_->BindVertexStream(vb_, { VertexElement(VEU_Position, 0, EF_BGR32F),
+					VertexElement(VEU_Diffuse, 0, EF_ABGR32F), VertexElement(VEU_TextureCoord, 0, EF_GR32F) });
+			}
+			else
+			{
+				uint32_t const num_common = static_cast<uint32_t>(std::min(vertices.size(), prev_vertices.size()));
+				while ((first < num_common) && (0 == std::memcmp(&vertices[first], &prev_vertices[first], vert_size)))
 				{
-					vert_length += tb_vb_sub_allocs_[i + 1].length_;
-					ind_length += tb_ib_sub_allocs_[i + 1].length_;
-					++ i;
+					++ first;
 				}
-
-				rl_->NumVertices(vert_length / sizeof(UIManager::VertexFormat));
-				rl_->StartIndexLocation(ind_offset / sizeof(uint16_t));
-				rl_->NumIndices(ind_length / sizeof(uint16_t));
-
-				re.Render(*this->GetRenderEffect(), *this->GetRenderTechnique(), *rl_);
+				if (num_verts == prev_vertices.size())
+				{
+					while ((last > first) && (0 == std::memcmp(&vertices[last - 1], &prev_vertices[last - 1], vert_size)))
+					{
+						-- last;
+					}
+				}
+			}
+			if (last > first)
+			{
+				vb_->UpdateSubresource(first * vert_size, (last - first) * vert_size, &vertices[first]);
 			}
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+			uint32_t const num_indices = num_quads_ * 6;
+			if (!ib_ || (ib_->Size() < num_indices * sizeof(uint16_t)))
 			{
-				tb_vb_->Dealloc(tb_vb_sub_allocs_[i]);
-				tb_ib_->Dealloc(tb_ib_sub_allocs_[i]);
+				uint32_t const num_alloc_quads = std::min(std::max(num_quads_ * 2, 64U), 0x10000U / 4);
+				std::vector<uint16_t> indices(num_alloc_quads * 6);
+				for (uint32_t i = 0; i < num_alloc_quads; ++ i)
+				{
+					uint16_t const base = static_cast<uint16_t>(i * 4);
+					indices[i * 6 + 0] = base + 0;
+					indices[i * 6 + 1] = base + 1;
+					indices[i * 6 + 2] = base + 2;
+					indices[i * 6 + 3] = base + 2;
+					indices[i * 6 + 4] = base + 3;
+					indices[i * 6 + 5] = base + 0;
+				}
+				ib_ = rf.MakeIndexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable,
+					static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]);
+				rl_->BindIndexStream(ib_, EF_R16UI);
 			}
 
-			this->OnRenderEnd();
+			rl_->NumVertices(num_verts);
+			rl_->NumIndices(num_indices);
 		}
 
-		void AddQuad(std::vector<UIManager::VertexFormat> const & vertices)
+		void OnRenderBegin()
 		{
-			tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
-			
-			uint16_t const last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(UIManager::VertexFormat));
-			std::vector<uint16_t> indices;
-			indices.resize(restart_ ? 5 : 6);
-			indices[0] = last_index + 0;
-			indices[1] = last_index + 1;
-			if (restart_)
-			{
-				indices[2] = last_index + 3;
-				indices[3] = last_index + 2;
-				indices[4] = 0xFFFF;
-			}
-			else
-			{
-				indices[2] = last_index + 2;
-				indices[3] = last_index + 2;
-				indices[4] = last_index + 3;
-				indices[5] = last_index + 0;
-			}
-			BOOST_ASSERT(last_index + 3 <= 0xFFFF);
+			*ui_tex_ep_ = texture_;
 
-			tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
+			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+			float const half_width = re.CurFrameBuffer()->Width() / 2.0f;
+			float const half_height = re.CurFrameBuffer()->Height() / 2.0f;
+
+			*half_width_height_ep_ = float2(half_width, half_height);
+			*dpi_scale_ep_ = Context::Instance().AppInstance().MainWnd()->DPIScale();
 		}
 
 	private:
-		bool restart_;
-
 		RenderEffectParameter* dpi_scale_ep_;
 		RenderEffectParameter* ui_tex_ep_;
 		RenderEffectParameter* half_width_height_ep_;
 
 		TexturePtr texture_;
 
-		std::unique_ptr<TransientBuffer> tb_vb_;
-		std::unique_ptr<TransientBuffer> tb_ib_;
-		std::vector<SubAlloc> tb_vb_sub_allocs_;
-		std::vector<SubAlloc> tb_ib_sub_allocs_;
+		GraphicsBufferPtr vb_;
+		GraphicsBufferPtr ib_;
+		uint32_t num_quads_;
 	};
 
 
@@ -296,7 +266,9 @@ namespace KlayGE
 
 
 	UIManager::UIManager()
-		: mouse_on_ui_(false),
+		: atlas_x_(0), atlas_y_(0), atlas_shelf_height_(0),
+			curr_cache_(&loose_cache_),
+			mouse_on_ui_(false),
 			inited_(false)
 	{
 	}
@@ -778,10 +750,67 @@ namespace KlayGE
 
 	size_t UIManager::AddTexture(TexturePtr const & texture)
 	{
+		if (texture)
+		{
+			this->AddToAtlas(texture);
+		}
+
+		// Texture coordinates in the atlas batch may have moved
+		for (auto const & dialog : dialogs_)
+		{
+			dialog->SetDirty();
+		}
+
 		texture_cache_.push_back(texture);
 		return texture_cache_.size() - 1;
 	}
 
+	void UIManager::AddToAtlas(TexturePtr const & texture)
+	{
+		if (atlas_offsets_.find(texture.get()) != atlas_offsets_.end())
+		{
+			return;
+		}
+
+		// Big, mipmapped, or not yet loaded textures keep their own batches. So do the ones can be changed later,
+		// the copy in the atlas would go stale.
+		if ((texture->Type() != Texture::TT_2D) || (texture->ArraySize() != 1) || !texture->HWResourceReady()
+			|| !(texture->AccessHint() & EAH_Immutable) || (texture->AccessHint() & (EAH_CPU_Write | EAH_GPU_Write))
+			|| (texture->Width(0) > ATLAS_SIZE / 2) || (texture->Height(0) > ATLAS_SIZE / 2)
+			|| (atlas_tex_ && (atlas_tex_->Format() != texture->Format())))
+		{
+			return;
+		}
+
+		// Shelf packing. Sizes are kept in multiples of 4 for compressed formats.
+		uint32_t const width = (texture->Width(0) + ATLAS_PADDING + 3) & ~3U;
+		uint32_t const height = (texture->Height(0) + ATLAS_PADDING + 3) & ~3U;
+		if (atlas_x_ + width > ATLAS_SIZE)
+		{
+			atlas_x_ = 0;
+			atlas_y_ += atlas_shelf_height_;
+			atlas_shelf_height_ = 0;
+		}
+		if (atlas_y_ + height > ATLAS_SIZE)
+		{
+			return;
+		}
+
+		if (!atlas_tex_)
+		{
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			atlas_tex_ = rf.MakeTexture2D(ATLAS_SIZE, ATLAS_SIZE, 1, 1, texture->Format(), 1, 0, EAH_GPU_Read);
+		}
+
+		texture->CopyToSubTexture2D(*atlas_tex_,
+			0, 0, atlas_x_, atlas_y_, texture->Width(0), texture->Height(0),
+			0, 0, 0, 0, texture->Width(0), texture->Height(0));
+		atlas_offsets_.emplace(texture.get(), int2(atlas_x_, atlas_y_));
+
+		atlas_x_ += width;
+		atlas_shelf_height_ = std::max(atlas_shelf_height_, height);
+	}
+
 	size_t UIManager::AddFont(FontPtr const & font, float font_size)
 	{
 		font_cache_.emplace_back(font, font_size);
@@ -850,6 +879,7 @@ namespace KlayGE
 			if (dialogs_[i] == dialog)
 			{
 				dialogs_.erase(dialogs_.begin() + i);
+				dialog_caches_.erase(dialog.get());
 				return;
 			}
 		}
@@ -924,40 +954,183 @@ namespace KlayGE
 
 	void UIManager::Render()
 	{
-		for (auto& str : strings_)
+		for (auto const & dialog : dialogs_)
 		{
-			str.second.clear();
+			// A dialog without changes keeps what it drew last time
+			if (dialog->NeedsRender())
+			{
+				DrawCache& cache = dialog_caches_[dialog.get()];
+				this->BeginDrawCache(cache);
+				curr_cache_ = &cache;
+				dialog->Render();
+				this->EndDrawCache(cache);
+			}
 		}
+		curr_cache_ = &loose_cache_;
+		this->EndDrawCache(loose_cache_);
 
 		for (auto const & dialog : dialogs_)
 		{
-			dialog->Render();
+			this->SubmitDrawCache(dialog_caches_[dialog.get()]);
+		}
+		this->SubmitDrawCache(loose_cache_);
+
+		this->BeginDrawCache(loose_cache_);
+	}
+
+	void UIManager::BeginDrawCache(DrawCache& cache)
+	{
+		for (auto& batch : cache.batches)
+		{
+			batch.recorded.clear();
+		}
+		cache.prev_strings.swap(cache.strings);
+		cache.strings.clear();
+		cache.prev_controls.swap(cache.controls);
+		cache.controls.clear();
+	}
+
+	void UIManager::EndDrawCache(DrawCache& cache)
+	{
+		for (auto& batch : cache.batches)
+		{
+			if ((batch.recorded.size() != batch.vertices.size())
+				|| (!batch.recorded.empty()
+					&& std::memcmp(&batch.recorded[0], &batch.vertices[0], batch.recorded.size() * sizeof(VertexFormat))))
+			{
+				if (!batch.renderable)
+				{
+					batch.renderable = MakeSharedPtr<UIRectRenderable>(batch.texture, effect_);
+				}
+				checked_pointer_cast<UIRectRenderable>(batch.renderable)->UpdateQuads(batch.recorded, batch.vertices);
+				batch.vertices.swap(batch.recorded);
+			}
 		}
+	}
 
-		for (auto const & rect : rects_)
+	void UIManager::SubmitDrawCache(DrawCache const & cache)
+	{
+		for (auto const & batch : cache.batches)
 		{
-			if (!checked_pointer_cast<UIRectRenderable>(rect.second)->Empty())
+			if (batch.renderable && !checked_pointer_cast<UIRectRenderable>(batch.renderable)->Empty())
 			{
 				SceneObjectHelperPtr ui_rect_obj
-					= MakeSharedPtr<SceneObjectHelper>(rect.second, SceneObject::SOA_Overlay);
+					= MakeSharedPtr<SceneObjectHelper>(batch.renderable, SceneObject::SOA_Overlay);
 				ui_rect_obj->AddToSceneManager();
 			}
 		}
-		for (auto const & str : strings_)
+		for (auto const & s : cache.strings)
+		{
+			auto const & font = font_cache_[s.font_index];
+			font.first->RenderText(s.rc, s.depth, 1, 1, s.clr, s.text, font.second, s.align);
+		}
+	}
+
+	void UIManager::BeginControl()
+	{
+		control_begin_.quads.resize(curr_cache_->batches.size());
+		for (size_t i = 0; i < curr_cache_->batches.size(); ++ i)
+		{
+			control_begin_.quads[i].first = curr_cache_->batches[i].recorded.size();
+		}
+		control_begin_.strings.first = curr_cache_->strings.size();
+	}
+
+	void UIManager::EndControl(UIControl& control, float depth_base)
+	{
+		ControlRecord& record = curr_cache_->controls[&control];
+		record.quads.resize(curr_cache_->batches.size());
+		for (size_t i = 0; i < curr_cache_->batches.size(); ++ i)
+		{
+			// Batches created inside the control start from empty
+			record.quads[i].first = (i < control_begin_.quads.size()) ? control_begin_.quads[i].first : 0;
+			record.quads[i].second = curr_cache_->batches[i].recorded.size();
+		}
+		record.strings.first = control_begin_.strings.first;
+		record.strings.second = curr_cache_->strings.size();
+		record.depth_base = depth_base;
+
+		control.ClearDirty();
+	}
+
+	bool UIManager::ReplayControl(UIControl const & control, float depth_base)
+	{
+		auto iter = curr_cache_->prev_controls.find(&control);
+		if ((iter == curr_cache_->prev_controls.end()) || (iter->second.depth_base != depth_base))
+		{
+			return false;
+		}
+
+		// Vertices of last frame are still in batch.vertices until EndDrawCache
+		ControlRecord const & prev = iter->second;
+		ControlRecord& record = curr_cache_->controls[&control];
+		record.quads.resize(prev.quads.size());
+		for (size_t i = 0; i < prev.quads.size(); ++ i)
+		{
+			auto& batch = curr_cache_->batches[i];
+			record.quads[i].first = batch.recorded.size();
+			batch.recorded.insert(batch.recorded.end(),
+				batch.vertices.begin() + prev.quads[i].first, batch.vertices.begin() + prev.quads[i].second);
+			record.quads[i].second = batch.recorded.size();
+		}
+		record.strings.first = curr_cache_->strings.size();
+		curr_cache_->strings.insert(curr_cache_->strings.end(),
+			curr_cache_->prev_strings.begin() + prev.strings.first, curr_cache_->prev_strings.begin() + prev.strings.second);
+		record.strings.second = curr_cache_->strings.size();
+		record.depth_base = depth_base;
+
+		return true;
+	}
+
+	std::vector<UIManager::VertexFormat>& UIManager::QuadBatch(TexturePtr const & texture, int2& atlas_offset)
+	{
+		TexturePtr const * batch_tex = &texture;
+		atlas_offset = int2(-1, -1);
+		if (atlas_tex_)
+		{
+			if (!texture)
+			{
+				batch_tex = &atlas_tex_;
+			}
+			else
+			{
+				auto iter = atlas_offsets_.find(texture.get());
+				if (iter != atlas_offsets_.end())
+				{
+					batch_tex = &atlas_tex_;
+					atlas_offset = iter->second;
+				}
+			}
+		}
+
+		for (auto& batch : curr_cache_->batches)
 		{
-			auto const & font = font_cache_[str.first];
-			for (auto const & s : str.second)
+			if (batch.texture == *batch_tex)
 			{
-				font.first->RenderText(s.rc, s.depth, 1, 1, s.clr, s.text, font.second, s.align);
+				return batch.recorded;
 			}
 		}
+
+		curr_cache_->batches.emplace_back();
+		curr_cache_->batches.back().texture = *batch_tex;
+		return curr_cache_->batches.back().recorded;
 	}
 
 	void UIManager::DrawRect(float3 const & pos, float width, float height, Color const * clrs,
 				IRect const & rcTexture, TexturePtr const & texture)
 	{
+		int2 atlas_offset;
+		std::vector<VertexFormat>& vertices = this->QuadBatch(texture, atlas_offset);
+
 		Rect texcoord;
-		if (texture)
+		if (texture && (atlas_offset.x() >= 0))
+		{
+			texcoord = Rect((atlas_offset.x() + rcTexture.left() + 0.5f) / ATLAS_SIZE,
+				(atlas_offset.y() + rcTexture.top() + 0.5f) / ATLAS_SIZE,
+				(atlas_offset.x() + rcTexture.right() + 0.5f) / ATLAS_SIZE,
+				(atlas_offset.y() + rcTexture.bottom() + 0.5f) / ATLAS_SIZE);
+		}
+		else if (texture)
 		{
 			texcoord = Rect((rcTexture.left() + 0.5f) / texture->Width(0),
 				(rcTexture.top() + 0.5f) / texture->Height(0),
@@ -966,66 +1139,52 @@ namespace KlayGE
 		}
 		else
 		{
-			texcoord = Rect(0, 0, 0, 0);
-		}
-
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
-		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
-		}
-		else
-		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
+			// Negative texcoords mark untextured quads in the atlas batch
+			texcoord = Rect(-1, -1, -1, -1);
 		}
-		BOOST_ASSERT(renderable);
 
-		std::vector<VertexFormat> vertices(4);
-		vertices[0] = VertexFormat(pos + float3(0, 0, 0),
+		vertices.emplace_back(pos + float3(0, 0, 0),
 			clrs[0], float2(texcoord.left(), texcoord.top()));
-		vertices[1] = VertexFormat(pos + float3(width, 0, 0),
+		vertices.emplace_back(pos + float3(width, 0, 0),
 			clrs[1], float2(texcoord.right(), texcoord.top()));
-		vertices[2] = VertexFormat(pos + float3(width, height, 0),
+		vertices.emplace_back(pos + float3(width, height, 0),
 			clrs[2], float2(texcoord.right(), texcoord.bottom()));
-		vertices[3] = VertexFormat(pos + float3(0, height, 0),
+		vertices.emplace_back(pos + float3(0, height, 0),
 			clrs[3], float2(texcoord.left(), texcoord.bottom()));
-
-		renderable->AddQuad(vertices);
 	}
 
 	void UIManager::DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture)
 	{
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
-		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
-		}
-		else
-		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
-		}
-		BOOST_ASSERT(renderable);
+		int2 atlas_offset;
+		std::vector<VertexFormat>& verts = this->QuadBatch(texture, atlas_offset);
 
-		std::vector<VertexFormat> verts(4);
-		verts[0] = VertexFormat(offset + vertices[0].pos,
-			vertices[0].clr, vertices[0].tex);
-		verts[1] = VertexFormat(offset + vertices[1].pos,
-			vertices[1].clr, vertices[1].tex);
-		verts[2] = VertexFormat(offset + vertices[2].pos,
-			vertices[2].clr, vertices[2].tex);
-		verts[3] = VertexFormat(offset + vertices[3].pos,
-			vertices[3].clr, vertices[3].tex);
+		for (int i = 0; i < 4; ++ i)
+		{
+			float2 tex;
+			if (texture && (atlas_offset.x() >= 0))
+			{
+				tex = float2((atlas_offset.x() + vertices[i].tex.x() * texture->Width(0)) / ATLAS_SIZE,
+					(atlas_offset.y() + vertices[i].tex.y() * texture->Height(0)) / ATLAS_SIZE);
+			}
+			else if (texture)
+			{
+				tex = vertices[i].tex;
+			}
+			else
+			{
+				tex = float2(-1, -1);
+			}
 
-		renderable->AddQuad(verts);
+			verts.emplace_back(offset + vertices[i].pos, vertices[i].clr, tex);
+		}
 	}
 
 	void UIManager::DrawString(std::wstring const & strText, uint32_t font_index,
 		IRect const & rc, float depth, Color const & clr, uint32_t align)
 	{
-		strings_[font_index].push_back(string_cache());
-		string_cache& sc = strings_[font_index].back();
+		curr_cache_->strings.emplace_back();
+		string_cache& sc = curr_cache_->strings.back();
+		sc.font_index = font_index;
 		sc.rc = rc;
 		sc.depth = depth;
 		sc.clr = clr;
@@ -1237,7 +1396,8 @@ namespace KlayGE
 					caption_height_(18),
 					top_left_clr_(0, 0, 0, 0), top_right_clr_(0, 0, 0, 0),
 					bottom_left_clr_(0, 0, 0, 0), bottom_right_clr_(0, 0, 0, 0),
-					opacity_(0.5f)
+					opacity_(0.5f),
+					dirty_(true), rendered_opacity_(0.5f)
 	{
 		TexturePtr ct;
 		if (control_tex)
@@ -1264,6 +1424,7 @@ namespace KlayGE
 
 		// Add to the list
 		controls_.push_back(control);
+		this->SetDirty();
 	}
 
 	void UIDialog::InitControl(UIControl& control)
@@ -1349,6 +1510,43 @@ namespace KlayGE
 		control->SetEnabled(enabled);
 	}
 
+	bool UIDialog::NeedsRender()
+	{
+		if (dirty_ || (opacity_ != rendered_opacity_))
+		{
+			// Everything drawn depends on the dialog's states
+			for (auto const & control : controls_)
+			{
+				control->SetDirty();
+			}
+			dirty_ = false;
+			rendered_opacity_ = opacity_;
+			return true;
+		}
+
+		// Controls of an invisible dialog are never rendered, they don't count
+		if (!visible_ || minimized_)
+		{
+			return false;
+		}
+		return std::any_of(controls_.begin(), controls_.end(),
+			[](UIControlPtr const & control)
+			{
+				return control->Dirty();
+			});
+	}
+
+	void UIDialog::RenderControl(UIControl& control)
+	{
+		UIManager& ui_mgr = UIManager::Instance();
+		if (control.Dirty() || !ui_mgr.ReplayControl(control, depth_base_))
+		{
+			ui_mgr.BeginControl();
+			control.Render();
+			ui_mgr.EndControl(control, depth_base_);
+		}
+	}
+
 	void UIDialog::Render()
 	{
 		// For invisible dialog, out now.
@@ -1475,7 +1673,7 @@ namespace KlayGE
 				auto iter = std::lower_bound(intersected_controls.begin(), intersected_controls.end(), i);
 				if ((iter == intersected_controls.end()) || (*iter != i))
 				{
-					controls_[i]->Render();
+					this->RenderControl(*controls_[i]);
 				}
 			}
 
@@ -1484,7 +1682,7 @@ namespace KlayGE
 				depth_base_ = 0.5f;
 				for (size_t j = 0; j < intersected_groups[i].size(); ++ j)
 				{
-					controls_[intersected_groups[i][j]]->Render();
+					this->RenderControl(*controls_[intersected_groups[i][j]]);
 					depth_base_ -= 0.05f;
 				}
 			}
@@ -1517,6 +1715,7 @@ namespace KlayGE
 		top_right_clr_ = colorTopRight;
 		bottom_left_clr_ = colorBottomLeft;
 		bottom_right_clr_ = colorBottomRight;
+		this->SetDirty();
 	}
 
 	bool UIDialog::ContainsPoint(int2 const & pt) const
@@ -1633,6 +1832,7 @@ namespace KlayGE
 				}
 
 				controls_.erase(controls_.begin() + i);
+				this->SetDirty();
 
 				return;
 			}
@@ -1648,6 +1848,7 @@ namespace KlayGE
 		control_mouse_over_.reset();
 
 		controls_.clear();
+		this->SetDirty();
 	}
 
 	// Device state notification
@@ -1684,6 +1885,7 @@ namespace KlayGE
 			fonts_.resize(index + 1, -1);
 		}
 		fonts_[index] = static_cast<int>(UIManager::Instance().AddFont(font, font_size));
+		this->SetDirty();
 	}
 
 	FontPtr const & UIDialog::GetFont(size_t index) const
@@ -1974,6 +2176,7 @@ namespace KlayGE
 		if (control_focus_.lock() && control_focus_.lock()->GetEnabled())
 		{
 			control_focus_.lock()->KeyDownHandler(*this, key);
+			control_focus_.lock()->SetDirty();
 		}
 		else
 		{
@@ -1988,6 +2191,7 @@ namespace KlayGE
 					if (control->GetHotkey() == static_cast<uint8_t>(key & 0xFF))
 					{
 						control->OnHotkey();
+						control->SetDirty();
 						handled = true;
 						break;
 					}
@@ -2036,6 +2240,7 @@ namespace KlayGE
 		if (control_focus_.lock() && control_focus_.lock()->GetEnabled())
 		{
 			control_focus_.lock()->KeyUpHandler(*this, key);
+			control_focus_.lock()->SetDirty();
 		}
 
 		if (control_focus_.lock() || control_mouse_over_.lock())
@@ -2067,6 +2272,7 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseDownHandler(*this, buttons, local_pt);
+			control->SetDirty();
 		}
 		else
 		{
@@ -2106,6 +2312,7 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseUpHandler(*this, buttons, local_pt);
+			control->SetDirty();
 		}
 		else
 		{
@@ -2145,6 +2352,7 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseWheelHandler(*this, buttons, local_pt, z_delta);
+			control->SetDirty();
 		}
 		else
 		{
@@ -2200,6 +2408,7 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseOverHandler(*this, buttons, local_pt);
+			control->SetDirty();
 		}
 
 		if (this->ContainsPoint(pt) || control_focus_.lock() || control_mouse_over_.lock())
@@ -191,6 +191,7 @@ namespace KlayGE
 	void UIButton::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		this->SetDirty();
 	}
 
 	void UIButton::OnHotkey()
@@ -128,6 +128,7 @@ namespace KlayGE
 		checked_ = bChecked;
 
 		this->OnChangedEvent()(*this);
+		this->SetDirty();
 	}
 
 	void UICheckBox::UpdateRects()
@@ -137,6 +138,7 @@ namespace KlayGE
 		text_rc_.left() += static_cast<int32_t>(1.25f * button_rc_.Width());
 
 		bounding_box_ = button_rc_ | text_rc_;
+		this->SetDirty();
 	}
 
 	void UICheckBox::Render()
@@ -197,6 +199,7 @@ namespace KlayGE
 	void UICheckBox::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		this->SetDirty();
 	}
 
 	void UICheckBox::OnHotkey()
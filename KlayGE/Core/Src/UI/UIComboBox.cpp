@@ -127,6 +127,7 @@ namespace KlayGE
 		{
 			dropdown_element->FontColor().States[UICS_Normal] = color;
 		}
+		this->SetDirty();
 	}
 
 	void UIComboBox::OnFocusOut()
@@ -564,6 +565,8 @@ namespace KlayGE
 
 	int UIComboBox::AddItem(std::wstring const & strText)
 	{
+		this->SetDirty();
+
 		BOOST_ASSERT(!strText.empty());
 
 		// Create a new item and set the data
@@ -597,6 +600,8 @@ namespace KlayGE
 
 	int UIComboBox::AddItem(std::wstring const & strText, std::any const & data)
 	{
+		this->SetDirty();
+
 		BOOST_ASSERT(!strText.empty());
 
 		// Create a new item and set the data
@@ -632,6 +637,7 @@ namespace KlayGE
 		{
 			selected_ = static_cast<int>(items_.size() - 1);
 		}
+		this->SetDirty();
 	}
 
 	void UIComboBox::RemoveAllItems()
@@ -639,6 +645,7 @@ namespace KlayGE
 		items_.clear();
 		scroll_bar_.SetTrackRange(0, 1);
 		focused_ = selected_ = -1;
+		this->SetDirty();
 	}
 
 	bool UIComboBox::ContainsItem(std::wstring const & strText, uint32_t iStart) const
@@ -719,6 +726,7 @@ namespace KlayGE
 
 		focused_ = selected_ = index;
 		this->OnSelectionChangedEvent()(*this);
+		this->SetDirty();
 	}
 
 	void UIComboBox::SetSelectedByText(std::wstring const & strText)
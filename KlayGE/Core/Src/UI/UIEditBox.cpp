@@ -402,6 +402,7 @@ namespace KlayGE
 				first_visible_ = nCPNew1st;
 			}
 		}
+		this->SetDirty();
 	}
 
 	void UIEditBox::ClearText()
@@ -410,6 +411,7 @@ namespace KlayGE
 		first_visible_ = 0;
 		this->PlaceCaret(0);
 		sel_start_ = 0;
+		this->SetDirty();
 	}
 
 	void UIEditBox::SetText(std::wstring const & wszText, bool bSelected)
@@ -419,6 +421,7 @@ namespace KlayGE
 		// Move the caret to the end of the text
 		this->PlaceCaret(buffer_.GetTextSize());
 		sel_start_ = bSelected ? 0 : caret_pos_;
+		this->SetDirty();
 	}
 
 	void UIEditBox::DeleteSelectionText()
@@ -433,6 +436,7 @@ namespace KlayGE
 		{
 			buffer_.RemoveChar(nFirst);
 		}
+		this->SetDirty();
 	}
 
 	void UIEditBox::UpdateRects()
@@ -793,6 +797,7 @@ namespace KlayGE
 	{
 		caret_on_ = true;
 		last_blink_time_ = timer_.current_time();
+		this->SetDirty();
 	}
 
 	void UIEditBox::Render()
@@ -122,6 +122,8 @@ namespace KlayGE
 
 	int UIListBox::AddItem(std::wstring const & strText)
 	{
+		this->SetDirty();
+
 		std::shared_ptr<UIListBoxItem> pNewItem = MakeSharedPtr<UIListBoxItem>();
 		pNewItem->strText = strText;
 		pNewItem->rcActive = IRect(0, 0, 0, 0);
@@ -142,6 +144,8 @@ namespace KlayGE
 
 	int UIListBox::AddItem(std::wstring const & strText, std::any const & data)
 	{
+		this->SetDirty();
+
 		std::shared_ptr<UIListBoxItem> pNewItem = MakeSharedPtr<UIListBoxItem>();
 		pNewItem->strText = strText;
 		pNewItem->data = data;
@@ -166,6 +170,7 @@ namespace KlayGE
 
 		items_.insert(items_.begin() + nIndex, pNewItem);
 		scroll_bar_.SetTrackRange(0, items_.size());
+		this->SetDirty();
 	}
 
 	void UIListBox::RemoveItem(int nIndex)
@@ -180,12 +185,14 @@ namespace KlayGE
 		}
 
 		this->OnSelectionEvent()(*this);
+		this->SetDirty();
 	}
 
 	void UIListBox::RemoveAllItems()
 	{
 		items_.clear();
 		scroll_bar_.SetTrackRange(0, 1);
+		this->SetDirty();
 	}
 
 	std::shared_ptr<UIListBoxItem> UIListBox::GetItem(int nIndex) const
@@ -230,6 +237,8 @@ namespace KlayGE
 
 	void UIListBox::SelectItem(int nNewIndex)
 	{
+		this->SetDirty();
+
 		// If no item exists, do nothing.
 		if (items_.empty())
 		{
@@ -93,6 +93,7 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(index < static_cast<int>(ctrl_points_.size()));
 		active_pt_ = index;
+		this->SetDirty();
 	}
 	
 	int UIPolylineEditBox::ActivePoint() const
@@ -105,10 +106,13 @@ namespace KlayGE
 		active_pt_ = -1;
 		ctrl_points_.clear();
 		move_point_ = false;
+		this->SetDirty();
 	}
 
 	int UIPolylineEditBox::AddCtrlPoint(float pos, float value)
 	{
+		this->SetDirty();
+
 		pos = MathLib::clamp(pos, 0.0f, 1.0f);
 		value = MathLib::clamp(pos, 0.0f, 1.0f);
 
@@ -138,6 +142,8 @@ namespace KlayGE
 
 	int UIPolylineEditBox::AddCtrlPoint(float pos)
 	{
+		this->SetDirty();
+
 		pos = MathLib::clamp(pos, 0.0f, 1.0f);
 		float value = this->GetValue(pos);
 
@@ -152,21 +158,25 @@ namespace KlayGE
 		}
 
 		ctrl_points_.erase(ctrl_points_.begin() + index);
+		this->SetDirty();
 	}
 
 	void UIPolylineEditBox::SetCtrlPoint(int index, float pos, float value)
 	{
 		ctrl_points_[index] = float2(pos, value);
+		this->SetDirty();
 	}
 
 	void UIPolylineEditBox::SetCtrlPoints(std::vector<float2> const & ctrl_points)
 	{
 		ctrl_points_ = ctrl_points;
+		this->SetDirty();
 	}
 
 	void UIPolylineEditBox::SetColor(Color const & clr)
 	{
 		elements_[POLYLINE_INDEX]->TextureColor().States[UICS_Normal] = clr;
+		this->SetDirty();
 	}
 
 	size_t UIPolylineEditBox::NumCtrlPoints() const
@@ -139,6 +139,7 @@ namespace KlayGE
 
 		checked_ = bChecked;
 		this->OnChangedEvent()(*this);
+		this->SetDirty();
 	}
 
 	void UIRadioButton::UpdateRects()
@@ -212,6 +213,7 @@ namespace KlayGE
 	void UIRadioButton::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		this->SetDirty();
 	}
 
 	void UIRadioButton::OnHotkey()
@@ -160,6 +160,7 @@ namespace KlayGE
 			thumb_rc_.bottom() = thumb_rc_.top();
 			show_thumb_ = false;
 		}
+		this->SetDirty();
 	}
 
 	// Scroll() scrolls by nDelta items.  A positive value scrolls down, while a negative
@@ -175,6 +176,7 @@ namespace KlayGE
 
 		// Update thumb position
 		this->UpdateThumbRect();
+		this->SetDirty();
 	}
 
 	void UIScrollBar::ShowItem(size_t nIndex)
@@ -201,6 +203,7 @@ namespace KlayGE
 		}
 
 		this->UpdateThumbRect();
+		this->SetDirty();
 	}
 
 	void UIScrollBar::MouseOverHandler(UIDialog const & /*sender*/, uint32_t /*buttons*/, int2 const & pt)
@@ -422,6 +425,7 @@ namespace KlayGE
 		end_ = nEnd;
 		this->Cap();
 		this->UpdateThumbRect();
+		this->SetDirty();
 	}
 
 	void UIScrollBar::Cap()  // Clips position at boundaries. Ensures it stays within legal range.
@@ -206,6 +206,7 @@ namespace KlayGE
 		max_ = nMax;
 
 		this->SetValueInternal(value_);
+		this->SetDirty();
 	}
 
 	void UISlider::SetValueInternal(int nValue)
@@ -218,6 +219,7 @@ namespace KlayGE
 		this->UpdateRects();
 
 		this->OnValueChangedEvent()(*this);
+		this->SetDirty();
 	}
 
 	void UISlider::Render()
@@ -78,5 +78,6 @@ namespace KlayGE
 	void UIStatic::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		this->SetDirty();
 	}
 }
@@ -107,13 +107,12 @@ namespace KlayGE
 		void Direction(float3 const & v) override;
 
 	private:
-		void LoopUpdateBuffer();
-
 		void DoReset() override;
 		void DoPlay(bool loop) override;
 		void DoStop() override;
+		bool RefillBuffers() override;
 
-		bool FillData(uint32_t size);
+		bool FillData();
 
 	private:
 		IDSBufferPtr buffer_;
@@ -123,12 +122,6 @@ namespace KlayGE
 		std::shared_ptr<IDirectSound3DBuffer> ds_3d_buffer_;
 
 		bool loop_;
-
-		bool played_;
-		bool stopped_;
-		std::condition_variable play_cond_;
-		std::mutex play_mutex_;
-		joiner<void> play_thread_;
 	};
 
 	class DSAudioEngine : public AudioEngine
@@ -0,0 +1,222 @@
+/**
+ * @file NullAudio.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_PLUGINS_NULL_AUDIO_HPP
+#define _KLAYGE_PLUGINS_NULL_AUDIO_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Thread.hpp>
+
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <KlayGE/Audio.hpp>
+
+namespace KlayGE
+{
+	class NullAudioEngine;
+
+	uint32_t NumChannels(AudioFormat format);
+	// Converts PCM to interleaved float samples in [-1, 1]
+	void PCMToFloat(std::vector<float>& samples, uint8_t const * data, size_t size, AudioFormat format);
+
+	// A voice of the software mixer. Everything in it is guarded by NullAudioEngine::VoiceMutex.
+	struct NullAudioVoice
+	{
+		uint32_t channels = 1;
+		uint32_t freq = 0;
+
+		// Interleaved samples, played one after another
+		std::deque<std::shared_ptr<std::vector<float> const>> chunks;
+		// Position in the front chunk, in 32.32 fixed point frames
+		uint64_t pos = 0;
+
+		bool playing = false;
+		// A consumed chunk goes back to the end of the queue
+		bool loop = false;
+		// The music buffer still streaming chunks in. The voice doesn't stop when it runs dry.
+		MusicBuffer* stream = nullptr;
+
+		float volume = 1;
+		// Mono voices are positioned in 3D. Others are mixed as they are.
+		float3 position = float3::Zero();
+	};
+
+	class NullSoundBuffer : public SoundBuffer
+	{
+	public:
+		NullSoundBuffer(AudioDataSourcePtr const & data_source, uint32_t num_sources, float volume);
+		~NullSoundBuffer() override;
+
+		void Play(bool loop = false) override;
+		void Stop() override;
+
+		void Volume(float vol) override;
+
+		bool IsPlaying() const override;
+
+		float3 Position() const override;
+		void Position(float3 const & v) override;
+		float3 Velocity() const override;
+		void Velocity(float3 const & v) override;
+		float3 Direction() const override;
+		void Direction(float3 const & v) override;
+
+	private:
+		void DoReset() override;
+		NullAudioVoice& FreeVoice();
+
+	private:
+		NullAudioEngine* engine_;
+
+		std::shared_ptr<std::vector<float> const> samples_;
+		std::vector<NullAudioVoice> voices_;
+
+		float3 pos_;
+		float3 vel_;
+		float3 dir_;
+	};
+
+	class NullMusicBuffer : public MusicBuffer
+	{
+	public:
+		NullMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume);
+		~NullMusicBuffer() override;
+
+		void Volume(float vol) override;
+
+		bool IsPlaying() const override;
+
+		float3 Position() const override;
+		void Position(float3 const & v) override;
+		float3 Velocity() const override;
+		void Velocity(float3 const & v) override;
+		float3 Direction() const override;
+		void Direction(float3 const & v) override;
+
+	private:
+		void DoReset() override;
+		void DoPlay(bool loop) override;
+		void DoStop() override;
+		bool RefillBuffers() override;
+
+		std::shared_ptr<std::vector<float>> FreeChunk();
+
+	private:
+		NullAudioEngine* engine_;
+
+		NullAudioVoice voice_;
+		uint32_t buffer_count_;
+		// Chunks are reused once the mixer has dropped them
+		std::vector<std::shared_ptr<std::vector<float>>> chunk_pool_;
+
+		bool loop_;
+
+		float3 vel_;
+		float3 dir_;
+	};
+
+	// A software mixer. The mix goes to a WAV file, or nowhere. Useful on machines without an audio device,
+	//   for servers, and for rendering the sound of a replay faster than real time.
+	class NullAudioEngine : public AudioEngine
+	{
+	public:
+		static uint32_t constexpr MIX_FREQ = 44100;
+
+	public:
+		NullAudioEngine();
+		~NullAudioEngine() override;
+
+		std::wstring const & Name() const override;
+
+		float3 GetListenerPos() const override;
+		void SetListenerPos(float3 const & v) override;
+		float3 GetListenerVel() const override;
+		void SetListenerVel(float3 const & v) override;
+		void GetListenerOri(float3& face, float3& up) const override;
+		void SetListenerOri(float3 const & face, float3 const & up) override;
+
+		// 16-bit stereo WAV at MIX_FREQ. An empty name discards the mix.
+		void OutputFile(std::string const & name);
+		// In real time, a thread mixes as the time goes, which is the default. Otherwise nothing is mixed
+		//   until Mix is called. Music is still streamed asynchronously, so give it enough buffer seconds
+		//   when mixing faster than real time.
+		void RealTime(bool rt);
+		bool RealTime() const;
+		void Mix(uint32_t num_frames);
+		uint64_t MixedFrames() const;
+
+		void AddVoice(NullAudioVoice& voice);
+		void RemoveVoice(NullAudioVoice& voice);
+		std::mutex& VoiceMutex() const;
+
+	private:
+		void DoSuspend() override;
+		void DoResume() override;
+
+		void StartMixThread();
+		void StopMixThread();
+		void MixThreadFunc();
+
+		void MixSlice(uint32_t num_frames);
+		void MixVoice(NullAudioVoice& voice, uint32_t num_frames);
+		void CloseOutput();
+
+	private:
+		mutable std::mutex voice_mutex_;
+		std::vector<NullAudioVoice*> voices_;
+
+		float3 listener_pos_;
+		float3 listener_vel_;
+		float3 listener_face_;
+		float3 listener_up_;
+		float3 listener_right_;
+
+		// Stereo frames, rounded up to 2 frames so they are always whole batches of 4 floats
+		std::vector<float> mix_buff_;
+		std::vector<float> voice_buff_;
+		std::vector<int16_t> out_buff_;
+
+		std::ofstream output_;
+		uint64_t output_frames_;
+		std::atomic<uint64_t> mixed_frames_;
+
+		bool real_time_;
+		std::atomic<bool> quit_mixing_;
+		std::unique_ptr<joiner<void>> mix_thread_;
+	};
+}
+
+#endif		// _KLAYGE_PLUGINS_NULL_AUDIO_HPP
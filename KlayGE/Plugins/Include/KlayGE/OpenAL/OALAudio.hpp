@@ -107,24 +107,17 @@ namespace KlayGE
 		float3 Direction() const override;
 		void Direction(float3 const & v) override;
 
-		void LoopUpdateBuffer();
-
 	private:
 		void DoReset() override;
 		void DoPlay(bool loop) override;
 		void DoStop() override;
+		bool RefillBuffers() override;
 
 	private:
 		ALuint source_;
 		std::vector<ALuint> buffer_queue_;
 
 		bool loop_;
-
-		bool played_;
-		bool stopped_;
-		std::condition_variable play_cond_;
-		std::mutex play_mutex_;
-		joiner<void> play_thread_;
 	};
 
 	class OALAudioEngine : public AudioEngine
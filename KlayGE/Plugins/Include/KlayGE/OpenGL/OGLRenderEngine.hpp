@@ -137,6 +137,17 @@ namespace KlayGE
 			return hack_for_intel_;
 		}
 
+		// Translated shaders and program binaries. Null if the shader_cache option turns it off.
+		ShaderCachePtr const & NativeShaderCache() const
+		{
+			return shader_cache_;
+		}
+		// GL_VENDOR, GL_RENDERER and GL_VERSION. Program binaries are only good for the same one.
+		std::string const & DeviceSignature() const
+		{
+			return device_signature_;
+		}
+
 #if defined KLAYGE_PLATFORM_WINDOWS
 		HGLRC wglCreateContext(HDC hdc);
 		BOOL wglDeleteContext(HGLRC hglrc);
@@ -222,6 +233,9 @@ namespace KlayGE
 		bool hack_for_nv_;
 		bool hack_for_amd_;
 		bool hack_for_intel_;
+
+		ShaderCachePtr shader_cache_;
+		std::string device_signature_;
 	};
 }
 
@@ -99,6 +99,11 @@ namespace KlayGE
 		explicit OGLShaderObject(std::shared_ptr<OGLShaderObjectTemplate> const & so_template);
 
 	private:
+		void ReadNativeShaderBlock(ShaderType type, RenderEffect const & effect, uint8_t const * nsbp);
+		std::vector<uint8_t> GenNativeShaderBlock(ShaderType type) const;
+		bool LoadProgramBinary(ShaderCache& cache, uint64_t key);
+		uint64_t ProgramCacheKey(std::string const & device_signature) const;
+
 		void AttachGLSL(uint32_t type);
 		void LinkGLSL();
 		void AttachUBOs(RenderEffect const & effect);
@@ -93,8 +93,12 @@ namespace KlayGE
 		float3 dir_;
 	};
 
+	class MusicVoiceContext;
+
 	class XAMusicBuffer : public MusicBuffer
 	{
+		friend class MusicVoiceContext;
+
 	public:
 		XAMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume);
 		~XAMusicBuffer() override;
@@ -111,13 +115,12 @@ namespace KlayGE
 		void Direction(float3 const & v) override;
 
 	private:
-		void LoopUpdateBuffer();
-
 		void DoReset() override;
 		void DoPlay(bool loop) override;
-		void DoStop();
+		void DoStop() override;
+		bool RefillBuffers() override;
 
-		bool FillData(uint32_t size);
+		bool FillData();
 
 	private:
 		IXAudio2SourceVoicePtr source_voice_;
@@ -129,12 +132,6 @@ namespace KlayGE
 
 		bool loop_;
 
-		bool played_;
-		bool stopped_;
-		std::condition_variable play_cond_;
-		std::mutex play_mutex_;
-		joiner<void> play_thread_;
-
 		X3DAUDIO_EMITTER emitter_;
 		X3DAUDIO_DSP_SETTINGS dsp_settings_;
 		std::vector<float> output_matrix_;
@@ -147,6 +147,7 @@ namespace KlayGE
 
 	DSAudioEngine::~DSAudioEngine()
 	{
+		this->ShutdownStreaming();
 		audio_buffs_.clear();
 		ds_3d_listener_.reset();
 		dsound_.reset();
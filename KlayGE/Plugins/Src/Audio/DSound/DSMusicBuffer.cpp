@@ -45,7 +45,7 @@ namespace KlayGE
 {
 	DSMusicBuffer::DSMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume)
 					: MusicBuffer(data_source),
-						played_(false), stopped_(true)
+						loop_(false)
 	{
 		WAVEFORMATEX wfx = WaveFormatEx(data_source);
 		fill_size_ = wfx.nAvgBytesPerSec / BUFFERS_PER_SECOND;
@@ -90,120 +90,78 @@ namespace KlayGE
 		this->Stop();
 	}
 
-	void DSMusicBuffer::LoopUpdateBuffer()
+	bool DSMusicBuffer::RefillBuffers()
 	{
-		std::unique_lock<std::mutex> lock(play_mutex_);
-		while (!played_)
-		{
-			play_cond_.wait(lock);
-		}
-		played_ = false;
+		DWORD play_cursor, write_cursor;
+		buffer_->GetCurrentPosition(&play_cursor, &write_cursor);
 
-		while (!stopped_)
+		uint32_t const next_cursor = play_cursor + fill_size_;
+		if (next_cursor >= write_cursor)
 		{
-			DWORD play_cursor, write_cursor;
-			buffer_->GetCurrentPosition(&play_cursor, &write_cursor);
-
-			uint32_t const next_cursor = play_cursor + fill_size_;
-			if (next_cursor >= write_cursor)
+			if (this->FillData())
 			{
-				if (this->FillData(fill_size_))
+				if (loop_)
 				{
-					if (loop_)
-					{
-						stopped_ = false;
-						this->DoReset();
-					}
-					else
-					{
-						stopped_ = true;
-						buffer_->Stop();
-					}
+					this->DoReset();
+				}
+				else
+				{
+					buffer_->Stop();
+					return false;
 				}
 			}
-
-			Sleep(1000 / BUFFERS_PER_SECOND);
 		}
+
+		return true;
 	}
 
 	void DSMusicBuffer::DoReset()
 	{
-		data_source_->Reset();
+		this->RewindData();
 
 		buffer_->SetCurrentPosition(0);
 	}
 
 	void DSMusicBuffer::DoPlay(bool loop)
 	{
-		play_thread_ = Context::Instance().ThreadPool()(std::bind(&DSMusicBuffer::LoopUpdateBuffer, this));
-
 		loop_ = loop;
 
-		stopped_ = false;
-		{
-			std::lock_guard<std::mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
-
 		buffer_->Play(0, 0, DSBPLAY_LOOPING);
+
+		this->StartStreaming();
 	}
 
 	void DSMusicBuffer::DoStop()
 	{
-		if (!stopped_)
-		{
-			stopped_ = true;
-			play_thread_();
-		}
+		this->StopStreaming();
 
 		buffer_->Stop();
 	}
 
-	bool DSMusicBuffer::FillData(uint32_t size)
+	bool DSMusicBuffer::FillData()
 	{
-		std::vector<uint8_t> data(size);
-		data.resize(data_source_->Read(data.data(), size));
+		std::vector<uint8_t> const & data = this->ReadBlock();
 
 		uint8_t* locked_buff[2];
 		DWORD locked_buff_size[2];
-		TIFHR(buffer_->Lock(0, size,
+		TIFHR(buffer_->Lock(0, fill_size_,
 			reinterpret_cast<void**>(&locked_buff[0]), &locked_buff_size[0],
 			reinterpret_cast<void**>(&locked_buff[1]), &locked_buff_size[1],
 			DSBLOCK_FROMWRITECURSOR));
 
-		bool ret;
-		if (data.empty())
+		// The tail of the last block is filled with silence
+		size_t const size0 = std::min<size_t>(data.size(), locked_buff_size[0]);
+		memcpy(locked_buff[0], data.data(), size0);
+		memset(locked_buff[0] + size0, 0, locked_buff_size[0] - size0);
+		if (locked_buff[1] != nullptr)
 		{
-			memset(locked_buff[0], 0, locked_buff_size[0]);
-			if (locked_buff[1] != nullptr)
-			{
-				memset(locked_buff[1], 0, locked_buff_size[1]);
-			}
-
-			ret = true;
-		}
-		else
-		{
-			memcpy(locked_buff[0], &data[0], locked_buff_size[0]);
-			if (locked_buff_size[0] > data.size())
-			{
-				memset(locked_buff[0], 0, locked_buff_size[0] - data.size());
-			}
-			if (locked_buff[1] != nullptr)
-			{
-				memcpy(locked_buff[1], &data[locked_buff_size[0]], locked_buff_size[1]);
-				if (locked_buff_size[1] > data.size() - locked_buff_size[0])
-				{
-					memset(locked_buff[1], 0, locked_buff_size[1] - data.size() + locked_buff_size[0]);
-				}
-			}
-
-			ret = false;
+			size_t const size1 = std::min<size_t>(data.size() - size0, locked_buff_size[1]);
+			memcpy(locked_buff[1], data.data() + size0, size1);
+			memset(locked_buff[1] + size1, 0, locked_buff_size[1] - size1);
 		}
 
 		buffer_->Unlock(locked_buff[0], locked_buff_size[0], locked_buff[1], locked_buff_size[1]);
-		return ret;
+		return data.empty();
 	}
 
 	bool DSMusicBuffer::IsPlaying() const
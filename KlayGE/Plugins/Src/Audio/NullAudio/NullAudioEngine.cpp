@@ -0,0 +1,462 @@
+/**
+ * @file NullAudioEngine.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDBatch.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <KlayGE/NullAudio/NullAudio.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// The longest run mixed with the voice mutex held
+	uint32_t constexpr MAX_SLICE_FRAMES = 1024;
+	uint32_t constexpr MIX_THREAD_PERIOD = 10;
+
+	void WriteWAVHeader(std::ostream& os, uint32_t data_size)
+	{
+		uint16_t const num_channels = 2;
+		uint16_t const bits_per_sample = 16;
+		uint16_t const block_align = num_channels * bits_per_sample / 8;
+
+		uint32_t const riff_size = Native2LE(data_size + 36);
+		uint32_t const fmt_size = Native2LE(16U);
+		uint16_t const format_tag = Native2LE(static_cast<uint16_t>(1));
+		uint16_t const channels = Native2LE(num_channels);
+		uint32_t const sample_rate = Native2LE(NullAudioEngine::MIX_FREQ);
+		uint32_t const byte_rate = Native2LE(NullAudioEngine::MIX_FREQ * block_align);
+		uint16_t const le_block_align = Native2LE(block_align);
+		uint16_t const le_bits_per_sample = Native2LE(bits_per_sample);
+		uint32_t const le_data_size = Native2LE(data_size);
+
+		os.write("RIFF", 4);
+		os.write(reinterpret_cast<char const *>(&riff_size), sizeof(riff_size));
+		os.write("WAVEfmt ", 8);
+		os.write(reinterpret_cast<char const *>(&fmt_size), sizeof(fmt_size));
+		os.write(reinterpret_cast<char const *>(&format_tag), sizeof(format_tag));
+		os.write(reinterpret_cast<char const *>(&channels), sizeof(channels));
+		os.write(reinterpret_cast<char const *>(&sample_rate), sizeof(sample_rate));
+		os.write(reinterpret_cast<char const *>(&byte_rate), sizeof(byte_rate));
+		os.write(reinterpret_cast<char const *>(&le_block_align), sizeof(le_block_align));
+		os.write(reinterpret_cast<char const *>(&le_bits_per_sample), sizeof(le_bits_per_sample));
+		os.write("data", 4);
+		os.write(reinterpret_cast<char const *>(&le_data_size), sizeof(le_data_size));
+	}
+}
+
+namespace KlayGE
+{
+	uint32_t NumChannels(AudioFormat format)
+	{
+		switch (format)
+		{
+		case AF_Mono8:
+		case AF_Mono16:
+			return 1;
+
+		case AF_Stereo8:
+		case AF_Stereo16:
+			return 2;
+
+		default:
+			KFL_UNREACHABLE("Invalid audio format");
+		}
+	}
+
+	void PCMToFloat(std::vector<float>& samples, uint8_t const * data, size_t size, AudioFormat format)
+	{
+		switch (format)
+		{
+		case AF_Mono8:
+		case AF_Stereo8:
+			samples.resize(size);
+			for (size_t i = 0; i < size; ++ i)
+			{
+				samples[i] = (data[i] - 128) * (1.0f / 128);
+			}
+			break;
+
+		case AF_Mono16:
+		case AF_Stereo16:
+			samples.resize(size / sizeof(int16_t));
+			for (size_t i = 0; i < samples.size(); ++ i)
+			{
+				int16_t s;
+				memcpy(&s, data + i * sizeof(s), sizeof(s));
+				samples[i] = LE2Native(s) * (1.0f / 32768);
+			}
+			break;
+
+		default:
+			KFL_UNREACHABLE("Invalid audio format");
+		}
+	}
+
+	NullAudioEngine::NullAudioEngine()
+		: output_frames_(0), mixed_frames_(0),
+			real_time_(true), quit_mixing_(false)
+	{
+		this->SetListenerPos(float3(0, 0, 0));
+		this->SetListenerVel(float3(0, 0, 0));
+		this->SetListenerOri(float3(0, 0, 1), float3(0, 1, 0));
+
+		this->StartMixThread();
+	}
+
+	NullAudioEngine::~NullAudioEngine()
+	{
+		this->StopMixThread();
+		this->ShutdownStreaming();
+		audio_buffs_.clear();
+
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		this->CloseOutput();
+	}
+
+	std::wstring const & NullAudioEngine::Name() const
+	{
+		static std::wstring const name(L"Null Audio Engine");
+		return name;
+	}
+
+	void NullAudioEngine::DoSuspend()
+	{
+		this->StopMixThread();
+	}
+
+	void NullAudioEngine::DoResume()
+	{
+		if (real_time_)
+		{
+			this->StartMixThread();
+		}
+	}
+
+	void NullAudioEngine::OutputFile(std::string const & name)
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+
+		this->CloseOutput();
+
+		if (!name.empty())
+		{
+			output_.open(name, std::ios_base::binary);
+			if (!output_)
+			{
+				TERRC(std::errc::no_such_file_or_directory);
+			}
+
+			WriteWAVHeader(output_, 0);
+			output_frames_ = 0;
+		}
+	}
+
+	void NullAudioEngine::CloseOutput()
+	{
+		if (output_.is_open())
+		{
+			// The sizes are only known now
+			output_.seekp(0);
+			WriteWAVHeader(output_, static_cast<uint32_t>(output_frames_ * 2 * sizeof(int16_t)));
+			output_.close();
+		}
+	}
+
+	void NullAudioEngine::RealTime(bool rt)
+	{
+		if (real_time_ != rt)
+		{
+			real_time_ = rt;
+			if (rt)
+			{
+				this->StartMixThread();
+			}
+			else
+			{
+				this->StopMixThread();
+			}
+		}
+	}
+
+	bool NullAudioEngine::RealTime() const
+	{
+		return real_time_;
+	}
+
+	uint64_t NullAudioEngine::MixedFrames() const
+	{
+		return mixed_frames_;
+	}
+
+	void NullAudioEngine::StartMixThread()
+	{
+		if (!mix_thread_)
+		{
+			quit_mixing_ = false;
+			mix_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+				[this] { this->MixThreadFunc(); }));
+		}
+	}
+
+	void NullAudioEngine::StopMixThread()
+	{
+		if (mix_thread_)
+		{
+			quit_mixing_ = true;
+			(*mix_thread_)();
+			mix_thread_.reset();
+		}
+	}
+
+	void NullAudioEngine::MixThreadFunc()
+	{
+		auto const start = std::chrono::steady_clock::now();
+		uint64_t frames = 0;
+		while (!quit_mixing_)
+		{
+			Sleep(MIX_THREAD_PERIOD);
+
+			double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			uint64_t const due = static_cast<uint64_t>(elapsed * MIX_FREQ);
+			if (due > frames)
+			{
+				this->Mix(static_cast<uint32_t>(due - frames));
+				frames = due;
+			}
+		}
+	}
+
+	void NullAudioEngine::Mix(uint32_t num_frames)
+	{
+		while (num_frames > 0)
+		{
+			uint32_t const slice = std::min(num_frames, MAX_SLICE_FRAMES);
+			{
+				std::lock_guard<std::mutex> lock(voice_mutex_);
+				this->MixSlice(slice);
+			}
+			num_frames -= slice;
+		}
+	}
+
+	void NullAudioEngine::MixSlice(uint32_t num_frames)
+	{
+		size_t const size = ((num_frames + 1) & ~1U) * 2;
+		mix_buff_.assign(size, 0.0f);
+		voice_buff_.resize(size);
+
+		for (auto voice : voices_)
+		{
+			if (voice->playing)
+			{
+				this->MixVoice(*voice, num_frames);
+			}
+		}
+
+		if (output_.is_open())
+		{
+			SIMDBatchF<4> const lower = SIMDBatchF<4>::Set(-1);
+			SIMDBatchF<4> const upper = SIMDBatchF<4>::Set(+1);
+			SIMDBatchF<4> const scale = SIMDBatchF<4>::Set(32767);
+			for (size_t i = 0; i < size; i += SIMDBatchF<4>::width)
+			{
+				SIMDBatchF<4> const s = SIMDMathLib::Maximize(SIMDMathLib::Minimize(SIMDBatchF<4>::Load(&mix_buff_[i]), upper), lower);
+				(s * scale).Store(&mix_buff_[i]);
+			}
+
+			out_buff_.resize(num_frames * 2);
+			for (size_t i = 0; i < out_buff_.size(); ++ i)
+			{
+				out_buff_[i] = Native2LE(static_cast<int16_t>(mix_buff_[i]));
+			}
+			output_.write(reinterpret_cast<char const *>(out_buff_.data()), out_buff_.size() * sizeof(out_buff_[0]));
+			output_frames_ += num_frames;
+		}
+
+		mixed_frames_ += num_frames;
+	}
+
+	void NullAudioEngine::MixVoice(NullAudioVoice& voice, uint32_t num_frames)
+	{
+		BOOST_ASSERT((voice.channels == 1) || (voice.channels == 2));
+
+		// Resamples to stereo at MIX_FREQ, with linear interpolation inside a chunk
+		uint64_t const step = (static_cast<uint64_t>(voice.freq) << 32) / MIX_FREQ;
+		float* dst = voice_buff_.data();
+		uint32_t frame = 0;
+		while (frame < num_frames)
+		{
+			if (voice.chunks.empty())
+			{
+				if (voice.stream == nullptr)
+				{
+					voice.playing = false;
+				}
+				break;
+			}
+
+			std::vector<float> const & chunk = *voice.chunks.front();
+			uint32_t const chunk_frames = static_cast<uint32_t>(chunk.size() / voice.channels);
+			uint32_t index = static_cast<uint32_t>(voice.pos >> 32);
+			if (index >= chunk_frames)
+			{
+				voice.pos -= static_cast<uint64_t>(chunk_frames) << 32;
+				auto consumed = voice.chunks.front();
+				voice.chunks.pop_front();
+				if (voice.loop && (chunk_frames > 0))
+				{
+					voice.chunks.push_back(consumed);
+				}
+				if (voice.stream != nullptr)
+				{
+					this->NotifyStreaming(*voice.stream);
+				}
+				continue;
+			}
+
+			float const * src = chunk.data();
+			for (; (frame < num_frames) && (index < chunk_frames); ++ frame)
+			{
+				uint32_t const next = std::min(index + 1, chunk_frames - 1);
+				float const t = static_cast<uint32_t>(voice.pos) * (1.0f / 4294967296.0f);
+				if (voice.channels == 1)
+				{
+					float const s = src[index] + (src[next] - src[index]) * t;
+					dst[frame * 2 + 0] = s;
+					dst[frame * 2 + 1] = s;
+				}
+				else
+				{
+					for (uint32_t c = 0; c < 2; ++ c)
+					{
+						dst[frame * 2 + c] = src[index * 2 + c] + (src[next * 2 + c] - src[index * 2 + c]) * t;
+					}
+				}
+
+				voice.pos += step;
+				index = static_cast<uint32_t>(voice.pos >> 32);
+			}
+		}
+		std::fill(dst + frame * 2, dst + voice_buff_.size(), 0.0f);
+
+		float gain_l;
+		float gain_r;
+		if (voice.channels == 1)
+		{
+			// Inverse distance attenuation clamped at 1 unit, and equal power panning
+			float3 const to_voice = voice.position - listener_pos_;
+			float const dist = MathLib::length(to_voice);
+			float const atten = 1 / std::max(dist, 1.0f);
+			float const pan = (dist > 1e-6f) ? MathLib::clamp(MathLib::dot(to_voice, listener_right_) / dist, -1.0f, 1.0f) : 0.0f;
+			float const angle = (pan + 1) * (PI / 4);
+			gain_l = voice.volume * atten * MathLib::cos(angle);
+			gain_r = voice.volume * atten * MathLib::sin(angle);
+		}
+		else
+		{
+			gain_l = voice.volume;
+			gain_r = voice.volume;
+		}
+
+		float const gains[] = { gain_l, gain_r, gain_l, gain_r };
+		SIMDBatchF<4> const gain = SIMDBatchF<4>::Load(gains);
+		for (size_t i = 0; i < mix_buff_.size(); i += SIMDBatchF<4>::width)
+		{
+			SIMDBatchF<4> const mixed = SIMDBatchF<4>::Load(&mix_buff_[i]) + SIMDBatchF<4>::Load(&voice_buff_[i]) * gain;
+			mixed.Store(&mix_buff_[i]);
+		}
+	}
+
+	void NullAudioEngine::AddVoice(NullAudioVoice& voice)
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		voices_.push_back(&voice);
+	}
+
+	void NullAudioEngine::RemoveVoice(NullAudioVoice& voice)
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		voices_.erase(std::remove(voices_.begin(), voices_.end(), &voice), voices_.end());
+	}
+
+	std::mutex& NullAudioEngine::VoiceMutex() const
+	{
+		return voice_mutex_;
+	}
+
+	float3 NullAudioEngine::GetListenerPos() const
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		return listener_pos_;
+	}
+
+	void NullAudioEngine::SetListenerPos(float3 const & v)
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		listener_pos_ = v;
+	}
+
+	float3 NullAudioEngine::GetListenerVel() const
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		return listener_vel_;
+	}
+
+	void NullAudioEngine::SetListenerVel(float3 const & v)
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		listener_vel_ = v;
+	}
+
+	void NullAudioEngine::GetListenerOri(float3& face, float3& up) const
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		face = listener_face_;
+		up = listener_up_;
+	}
+
+	void NullAudioEngine::SetListenerOri(float3 const & face, float3 const & up)
+	{
+		std::lock_guard<std::mutex> lock(voice_mutex_);
+		listener_face_ = face;
+		listener_up_ = up;
+		listener_right_ = MathLib::normalize(MathLib::cross(up, face));
+	}
+}
@@ -0,0 +1,198 @@
+/**
+ * @file NullMusicBuffer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioFactory.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+
+#include <KlayGE/NullAudio/NullAudio.hpp>
+
+namespace KlayGE
+{
+	NullMusicBuffer::NullMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume)
+					: MusicBuffer(data_source),
+						engine_(checked_cast<NullAudioEngine*>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance())),
+						buffer_count_(buffer_seconds * BUFFERS_PER_SECOND),
+						loop_(false)
+	{
+		voice_.channels = NumChannels(format_);
+		voice_.freq = freq_;
+		engine_->AddVoice(voice_);
+
+		this->Position(float3(0, 0, 0.1f));
+		this->Velocity(float3(0, 0, 0));
+		this->Direction(float3(0, 0, 0));
+
+		this->Volume(volume);
+
+		this->Reset();
+	}
+
+	NullMusicBuffer::~NullMusicBuffer()
+	{
+		this->Stop();
+
+		engine_->RemoveVoice(voice_);
+	}
+
+	std::shared_ptr<std::vector<float>> NullMusicBuffer::FreeChunk()
+	{
+		for (auto const & chunk : chunk_pool_)
+		{
+			if (chunk.use_count() == 1)
+			{
+				return chunk;
+			}
+		}
+
+		chunk_pool_.push_back(MakeSharedPtr<std::vector<float>>());
+		return chunk_pool_.back();
+	}
+
+	bool NullMusicBuffer::RefillBuffers()
+	{
+		bool rewound = false;
+		for (;;)
+		{
+			std::shared_ptr<std::vector<float>> chunk;
+			{
+				std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+				if (voice_.chunks.size() >= buffer_count_)
+				{
+					return true;
+				}
+
+				// The mixer only drops its references with the lock held
+				chunk = this->FreeChunk();
+			}
+
+			std::vector<uint8_t> const & data = this->ReadBlock();
+			if (data.empty())
+			{
+				// Loops seamlessly, the next chunk starts from the beginning. Empty data ends anyway.
+				if (loop_ && !rewound)
+				{
+					this->RewindData();
+					rewound = true;
+					continue;
+				}
+
+				std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+				voice_.stream = nullptr;
+				return false;
+			}
+
+			rewound = false;
+			PCMToFloat(*chunk, data.data(), data.size(), format_);
+
+			std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+			voice_.chunks.push_back(chunk);
+		}
+	}
+
+	void NullMusicBuffer::DoReset()
+	{
+		{
+			std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+			voice_.chunks.clear();
+			voice_.pos = 0;
+		}
+
+		this->RewindData();
+	}
+
+	void NullMusicBuffer::DoPlay(bool loop)
+	{
+		loop_ = loop;
+
+		{
+			std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+			voice_.stream = this;
+			voice_.playing = true;
+		}
+
+		this->StartStreaming();
+	}
+
+	void NullMusicBuffer::DoStop()
+	{
+		this->StopStreaming();
+
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+		voice_.stream = nullptr;
+		voice_.playing = false;
+	}
+
+	bool NullMusicBuffer::IsPlaying() const
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+		return voice_.playing;
+	}
+
+	void NullMusicBuffer::Volume(float vol)
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+		voice_.volume = vol;
+	}
+
+	float3 NullMusicBuffer::Position() const
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+		return voice_.position;
+	}
+
+	void NullMusicBuffer::Position(float3 const & v)
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+		voice_.position = v;
+	}
+
+	float3 NullMusicBuffer::Velocity() const
+	{
+		return vel_;
+	}
+
+	void NullMusicBuffer::Velocity(float3 const & v)
+	{
+		vel_ = v;
+	}
+
+	float3 NullMusicBuffer::Direction() const
+	{
+		return dir_;
+	}
+
+	void NullMusicBuffer::Direction(float3 const & v)
+	{
+		dir_ = v;
+	}
+}
@@ -0,0 +1,202 @@
+/**
+ * @file NullSoundBuffer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioFactory.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+
+#include <algorithm>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/NullAudio/NullAudio.hpp>
+
+namespace KlayGE
+{
+	NullSoundBuffer::NullSoundBuffer(AudioDataSourcePtr const & data_source, uint32_t num_sources, float volume)
+						: SoundBuffer(data_source),
+							engine_(checked_cast<NullAudioEngine*>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance())),
+							voices_(num_sources)
+	{
+		// Decoded once, and shared by all the voices
+		std::vector<uint8_t> data(data_source_->Size());
+		data.resize(data_source_->Read(data.data(), data.size()));
+
+		auto samples = MakeSharedPtr<std::vector<float>>();
+		PCMToFloat(*samples, data.data(), data.size(), format_);
+		samples_ = samples;
+
+		for (auto& voice : voices_)
+		{
+			voice.channels = NumChannels(format_);
+			voice.freq = freq_;
+			voice.volume = volume;
+			engine_->AddVoice(voice);
+		}
+
+		this->Position(float3(0, 0, 0.1f));
+		this->Velocity(float3(0, 0, 0));
+		this->Direction(float3(0, 0, 0));
+
+		this->Reset();
+	}
+
+	NullSoundBuffer::~NullSoundBuffer()
+	{
+		this->Stop();
+
+		for (auto& voice : voices_)
+		{
+			engine_->RemoveVoice(voice);
+		}
+	}
+
+	NullAudioVoice& NullSoundBuffer::FreeVoice()
+	{
+		BOOST_ASSERT(!voices_.empty());
+
+		for (auto& voice : voices_)
+		{
+			if (!voice.playing)
+			{
+				return voice;
+			}
+		}
+
+		// All busy, restart the one played the longest
+		auto iter = std::max_element(voices_.begin(), voices_.end(),
+			[](NullAudioVoice const & lhs, NullAudioVoice const & rhs)
+			{
+				return lhs.pos < rhs.pos;
+			});
+		return *iter;
+	}
+
+	void NullSoundBuffer::Play(bool loop)
+	{
+		if (samples_->empty())
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+
+		NullAudioVoice& voice = this->FreeVoice();
+		voice.chunks.assign(1, samples_);
+		voice.pos = 0;
+		voice.loop = loop;
+		voice.position = pos_;
+		voice.playing = true;
+	}
+
+	void NullSoundBuffer::Stop()
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+
+		for (auto& voice : voices_)
+		{
+			voice.playing = false;
+			voice.chunks.clear();
+		}
+	}
+
+	void NullSoundBuffer::DoReset()
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+
+		for (auto& voice : voices_)
+		{
+			voice.pos = 0;
+		}
+	}
+
+	bool NullSoundBuffer::IsPlaying() const
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+
+		for (auto const & voice : voices_)
+		{
+			if (voice.playing)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void NullSoundBuffer::Volume(float vol)
+	{
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+
+		for (auto& voice : voices_)
+		{
+			voice.volume = vol;
+		}
+	}
+
+	float3 NullSoundBuffer::Position() const
+	{
+		return pos_;
+	}
+
+	void NullSoundBuffer::Position(float3 const & v)
+	{
+		pos_ = v;
+
+		std::lock_guard<std::mutex> lock(engine_->VoiceMutex());
+
+		for (auto& voice : voices_)
+		{
+			voice.position = v;
+		}
+	}
+
+	float3 NullSoundBuffer::Velocity() const
+	{
+		return vel_;
+	}
+
+	void NullSoundBuffer::Velocity(float3 const & v)
+	{
+		vel_ = v;
+	}
+
+	float3 NullSoundBuffer::Direction() const
+	{
+		return dir_;
+	}
+
+	void NullSoundBuffer::Direction(float3 const & v)
+	{
+		dir_ = v;
+	}
+}
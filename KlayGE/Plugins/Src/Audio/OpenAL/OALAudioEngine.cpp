@@ -96,6 +96,7 @@ namespace KlayGE
 
 	OALAudioEngine::~OALAudioEngine()
 	{
+		this->ShutdownStreaming();
 		audio_buffs_.clear();
 
 		ALCcontext* context = alcGetCurrentContext();
@@ -34,14 +34,12 @@
 
 #include <KlayGE/OpenAL/OALAudio.hpp>
 
-size_t constexpr READ_SIZE = 88200;
-
 namespace KlayGE
 {
 	OALMusicBuffer::OALMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume)
 							: MusicBuffer(data_source),
 								buffer_queue_(buffer_seconds * BUFFERS_PER_SECOND),
-								played_(false), stopped_(true)
+								loop_(false)
 	{
 		alGenBuffers(static_cast<ALsizei>(buffer_queue_.size()), buffer_queue_.data());
 
@@ -65,56 +63,38 @@ namespace KlayGE
 		alDeleteSources(1, &source_);
 	}
 
-	void OALMusicBuffer::LoopUpdateBuffer()
+	bool OALMusicBuffer::RefillBuffers()
 	{
-		std::unique_lock<std::mutex> lock(play_mutex_);
-		while (!played_)
+		ALint processed;
+		alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
+		while (processed > 0)
 		{
-			play_cond_.wait(lock);
-		}
-		played_ = false;
+			-- processed;
 
-		while (!stopped_)
-		{
-			ALint processed;
-			alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
-			if (processed > 0)
+			ALuint buf;
+			alSourceUnqueueBuffers(source_, 1, &buf);
+
+			std::vector<uint8_t> const & data = this->ReadBlock();
+			if (data.empty())
 			{
-				while (processed > 0)
+				if (loop_)
 				{
-					-- processed;
-
-					ALuint buf;
-					alSourceUnqueueBuffers(source_, 1, &buf);
-
-					std::vector<uint8_t> data(READ_SIZE);
-					data.resize(data_source_->Read(data.data(), data.size()));
-					if (data.empty())
-					{
-						if (loop_)
-						{
-							stopped_ = false;
-							alSourceStopv(1, &source_);
-							this->DoReset();
-							alSourcePlay(source_);
-						}
-						else
-						{
-							stopped_ = true;
-						}
-					}
-					else
-					{
-						alBufferData(buf, Convert(format_), data.data(), static_cast<ALsizei>(data.size()), freq_);
-						alSourceQueueBuffers(source_, 1, &buf);
-					}
+					alSourceStopv(1, &source_);
+					this->DoReset();
+					alSourcePlay(source_);
+					return true;
+				}
+				else
+				{
+					return false;
 				}
 			}
-			else
-			{
-				Sleep(1000 / BUFFERS_PER_SECOND);
-			}
+
+			alBufferData(buf, Convert(format_), data.data(), static_cast<ALsizei>(data.size()), freq_);
+			alSourceQueueBuffers(source_, 1, &buf);
 		}
+
+		return true;
 	}
 
 	void OALMusicBuffer::DoReset()
@@ -128,15 +108,14 @@ namespace KlayGE
 		}
 
 		ALenum const format(Convert(format_));
-		std::vector<uint8_t> data(READ_SIZE);
 
-		data_source_->Reset();
+		this->RewindData();
 
 		ALsizei non_empty_buf = 0;
 		// Load 1 / BUFFERS_PER_SECOND second data to each buffer
 		for (auto const & buf : buffer_queue_)
 		{
-			data.resize(data_source_->Read(data.data(), data.size()));
+			std::vector<uint8_t> const & data = this->ReadBlock();
 			if (data.empty())
 			{
 				break;
@@ -156,28 +135,17 @@ namespace KlayGE
 
 	void OALMusicBuffer::DoPlay(bool loop)
 	{
-		play_thread_ = Context::Instance().ThreadPool()(std::bind(&OALMusicBuffer::LoopUpdateBuffer, this));
-
 		loop_ = loop;
 
-		stopped_ = false;
-		{
-			std::lock_guard<std::mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
-
 		alSourcei(source_, AL_LOOPING, false);
 		alSourcePlay(source_);
+
+		this->StartStreaming();
 	}
 
 	void OALMusicBuffer::DoStop()
 	{
-		if (!stopped_)
-		{
-			stopped_ = true;
-			play_thread_();
-		}
+		this->StopStreaming();
 
 		alSourceStopv(1, &source_);
 	}
@@ -124,6 +124,7 @@ namespace KlayGE
 
 	XAAudioEngine::~XAAudioEngine()
 	{
+		this->ShutdownStreaming();
 		audio_buffs_.clear();
 		mastering_voice_.reset();
 		xaudio_.reset();
@@ -36,6 +36,8 @@
 #include <KlayGE/AudioFactory.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
+#include <cstring>
+
 #include <boost/assert.hpp>
 
 #include <KlayGE/XAudio/XAAudio.hpp>
@@ -45,18 +47,12 @@ namespace KlayGE
 	class MusicVoiceContext : public IXAudio2VoiceCallback
 	{
 	public:
-		MusicVoiceContext()
-			: buffer_end_event_(::CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS))
+		explicit MusicVoiceContext(XAMusicBuffer& buffer)
+			: buffer_(buffer)
 		{
 		}
 		virtual ~MusicVoiceContext()
 		{
-			::CloseHandle(buffer_end_event_);
-		}
-
-		HANDLE GetBufferEndEvent() const
-		{
-			return buffer_end_event_;
 		}
 
 		STDMETHOD_(void, OnVoiceProcessingPassStart)(UINT32)
@@ -73,7 +69,7 @@ namespace KlayGE
 		}
 		STDMETHOD_(void, OnBufferEnd)(void*)
 		{
-			::SetEvent(buffer_end_event_);
+			buffer_.NotifyStreaming();
 		}
 		STDMETHOD_(void, OnLoopEnd)(void*)
 		{
@@ -83,14 +79,14 @@ namespace KlayGE
 		}
 
 	private:
-		HANDLE buffer_end_event_;
+		XAMusicBuffer& buffer_;
 	};
 
 	XAMusicBuffer::XAMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume)
 					: MusicBuffer(data_source),
-						voice_call_back_(MakeUniquePtr<MusicVoiceContext>()),
+						voice_call_back_(MakeUniquePtr<MusicVoiceContext>(*this)),
 						buffer_count_(buffer_seconds * BUFFERS_PER_SECOND), curr_buffer_index_(0),
-						played_(false), stopped_(true),
+						loop_(false),
 						emitter_{}, dsp_settings_{}
 	{
 		WAVEFORMATEX wfx = WaveFormatEx(data_source);
@@ -128,54 +124,32 @@ namespace KlayGE
 		this->Stop();
 	}
 
-	void XAMusicBuffer::LoopUpdateBuffer()
+	bool XAMusicBuffer::RefillBuffers()
 	{
-		std::unique_lock<std::mutex> lock(play_mutex_);
-		while (!played_)
-		{
-			play_cond_.wait(lock);
-		}
-		played_ = false;
-
-		while (!stopped_)
+		XAUDIO2_VOICE_STATE state;
+		source_voice_->GetState(&state);
+		// One buffer of the ring is always left alone, it could still be read by the voice
+		for (uint32_t queued = state.BuffersQueued; queued < buffer_count_ - 1; ++ queued)
 		{
-			XAUDIO2_VOICE_STATE state;
-			for (;;)
-			{
-				source_voice_->GetState(&state);
-				if (state.BuffersQueued < buffer_count_ - 1)
-				{
-					break;
-				}
-
-				::WaitForSingleObjectEx(checked_cast<MusicVoiceContext*>(voice_call_back_.get())->GetBufferEndEvent(),
-					INFINITE, FALSE);
-			}
-
-			if (this->FillData(buffer_size_))
+			if (this->FillData())
 			{
 				if (loop_)
 				{
-					stopped_ = false;
 					this->DoReset();
 				}
 				else
 				{
-					stopped_ = true;
-
-					HRESULT hr = source_voice_->Stop();
-					if (SUCCEEDED(hr))
-					{
-						source_voice_->FlushSourceBuffers();
-					}
+					return false;
 				}
 			}
 		}
+
+		return true;
 	}
 
 	void XAMusicBuffer::DoReset()
 	{
-		data_source_->Reset();
+		this->RewindData();
 	}
 
 	void XAMusicBuffer::DoPlay(bool loop)
@@ -190,26 +164,14 @@ namespace KlayGE
 		curr_buffer_index_ = 0;
 		loop_ = loop;
 
-		play_thread_ = Context::Instance().ThreadPool()(std::bind(&XAMusicBuffer::LoopUpdateBuffer, this));
-
-		stopped_ = false;
-		{
-			std::lock_guard<std::mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
-
 		source_voice_->Start(0, 0);
+
+		this->StartStreaming();
 	}
 
 	void XAMusicBuffer::DoStop()
 	{
-		if (!stopped_)
-		{
-			stopped_ = true;
-			::SetEvent(checked_cast<MusicVoiceContext*>(voice_call_back_.get())->GetBufferEndEvent());
-			play_thread_();
-		}
+		this->StopStreaming();
 
 		HRESULT hr = source_voice_->Stop();
 		if (SUCCEEDED(hr))
@@ -218,24 +180,31 @@ namespace KlayGE
 		}
 	}
 
-	bool XAMusicBuffer::FillData(uint32_t size)
+	bool XAMusicBuffer::FillData()
 	{
-		bool ret = false;
+		std::vector<uint8_t> const & data = this->ReadBlock();
+		if (data.empty())
+		{
+			return true;
+		}
+
+		uint8_t* dst = &audio_data_[curr_buffer_index_ * buffer_size_];
+		memcpy(dst, data.data(), data.size());
+
+		bool const end = (data.size() < buffer_size_);
 
-		size_t read_size = data_source_->Read(&audio_data_[curr_buffer_index_ * buffer_size_], size);
 		XAUDIO2_BUFFER buf{};
-		buf.AudioBytes = static_cast<uint32_t>(read_size);
-		buf.pAudioData = &audio_data_[curr_buffer_index_ * buffer_size_];
-		if (curr_buffer_index_ * buffer_size_ + read_size >= data_source_->Size())
+		buf.AudioBytes = static_cast<uint32_t>(data.size());
+		buf.pAudioData = dst;
+		if (end && !loop_)
 		{
 			buf.Flags = XAUDIO2_END_OF_STREAM;
-			ret = true;
 		}
 
 		source_voice_->SubmitSourceBuffer(&buf);
 		curr_buffer_index_ = (curr_buffer_index_ + 1) % buffer_count_;
 
-		return ret;
+		return end;
 	}
 
 	bool XAMusicBuffer::IsPlaying() const
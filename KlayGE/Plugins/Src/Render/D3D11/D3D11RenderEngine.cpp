@@ -727,12 +727,24 @@ namespace KlayGE
 			if (rl.UseIndices())
 			{
 				uint32_t const num_indices = rl.NumIndices();
+				auto const index_ranges = rl.IndexRanges();
 				for (uint32_t i = 0; i < num_passes; ++ i)
 				{
 					auto& pass = tech.Pass(i);
 
 					pass.Bind(effect);
-					d3d_imm_ctx_->DrawIndexedInstanced(num_indices, num_instances, rl.StartIndexLocation(), rl.StartVertexLocation(), rl.StartInstanceLocation());
+					if (index_ranges.empty())
+					{
+						d3d_imm_ctx_->DrawIndexedInstanced(num_indices, num_instances, rl.StartIndexLocation(), rl.StartVertexLocation(), rl.StartInstanceLocation());
+					}
+					else
+					{
+						for (auto const & range : index_ranges)
+						{
+							d3d_imm_ctx_->DrawIndexedInstanced(range.second, num_instances, range.first, rl.StartVertexLocation(), rl.StartInstanceLocation());
+						}
+						num_draws_just_called_ += static_cast<uint32_t>(index_ranges.size()) - 1;
+					}
 					pass.Unbind(effect);
 				}
 			}
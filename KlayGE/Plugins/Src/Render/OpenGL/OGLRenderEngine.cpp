@@ -50,6 +50,8 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/PostProcess.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/ShaderCache.hpp>
 #include <KFL/Hash.hpp>
 
 #include <glloader/glloader.h>
@@ -265,6 +267,29 @@ namespace KlayGE
 		this->FillRenderDeviceCaps();
 		this->InitRenderStates();
 
+		// shader_cache:0 turns the shader cache off, shader_cache:<folder> moves it
+		std::string shader_cache_folder = ResLoader::Instance().LocalFolder() + "ShaderCache/";
+		for (size_t index = 0; index < settings.options.size(); ++ index)
+		{
+			std::string_view opt_name = settings.options[index].first;
+			std::string_view opt_val = settings.options[index].second;
+			if ("shader_cache" == opt_name)
+			{
+				if (("0" == opt_val) || ("off" == opt_val))
+				{
+					shader_cache_folder.clear();
+				}
+				else
+				{
+					shader_cache_folder = std::string(opt_val);
+				}
+			}
+		}
+		if (!shader_cache_folder.empty())
+		{
+			shader_cache_ = MakeSharedPtr<ShaderCache>(shader_cache_folder);
+		}
+
 #ifdef KLAYGE_PLATFORM_DARWIN
 		Context::Instance().AppInstance().MainWnd()->BindListeners();
 #endif
@@ -1206,6 +1231,7 @@ namespace KlayGE
 		{
 			if (rl.UseIndices())
 			{
+				auto const index_ranges = rl.IndexRanges();
 				for (uint32_t i = 0; i < num_passes; ++ i)
 				{
 					auto& pass = tech.Pass(i);
@@ -1223,7 +1249,20 @@ namespace KlayGE
 						glBeginTransformFeedback(so_primitive_mode_);
 					}
 
-					glDrawElementsInstanced(mode, static_cast<GLsizei>(rl.NumIndices()), index_type, index_offset, num_instances);
+					if (index_ranges.empty())
+					{
+						glDrawElementsInstanced(mode, static_cast<GLsizei>(rl.NumIndices()), index_type, index_offset, num_instances);
+					}
+					else
+					{
+						uint32_t const index_size = (GL_UNSIGNED_SHORT == index_type) ? 2 : 4;
+						for (auto const & range : index_ranges)
+						{
+							glDrawElementsInstanced(mode, static_cast<GLsizei>(range.second), index_type,
+								index_offset + (static_cast<ptrdiff_t>(range.first) - rl.StartIndexLocation()) * index_size, num_instances);
+						}
+						num_draws_just_called_ += static_cast<uint32_t>(index_ranges.size()) - 1;
+					}
 
 					if (so_rl_)
 					{
@@ -1387,6 +1426,7 @@ namespace KlayGE
 		}
 
 		so_rl_.reset();
+		shader_cache_.reset();
 
 		glloader_uninit();
 
@@ -1523,6 +1563,11 @@ namespace KlayGE
 		caps_.tess_method = TM_Hardware;
 
 		std::string vendor(reinterpret_cast<char const *>(glGetString(GL_VENDOR)));
+		{
+			char const * renderer = reinterpret_cast<char const *>(glGetString(GL_RENDERER));
+			char const * version = reinterpret_cast<char const *>(glGetString(GL_VERSION));
+			device_signature_ = vendor + '|' + (renderer ? renderer : "") + '|' + (version ? version : "");
+		}
 		if (vendor.find("NVIDIA", 0) != std::string::npos)
 		{
 			hack_for_nv_ = true;
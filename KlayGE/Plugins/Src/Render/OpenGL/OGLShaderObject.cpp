@@ -30,6 +30,7 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
 #include <KFL/Hash.hpp>
+#include <KlayGE/ShaderCache.hpp>
 
 #include <cstdio>
 #include <string>
@@ -66,6 +67,9 @@ namespace
 {
 	using namespace KlayGE;
 
+	// Goes into the keys of translated shaders in the shader cache. Bump it when DXBC2GLSL changes its output.
+	uint32_t const DXBC2GLSL_CACHE_VERSION = 1;
+
 	template <typename SrcType>
 	class SetOGLShaderParameter
 	{
@@ -215,150 +219,151 @@ namespace KlayGE
 		is_shader_validate_[type] = false;
 		if (native_shader_block.size() >= 24)
 		{
-			uint8_t const * nsbp = &native_shader_block[0];
-			
 			is_shader_validate_[type] = true;
 
-			uint32_t len32;
-			std::memcpy(&len32, nsbp, sizeof(len32));
-			nsbp += sizeof(len32);
-			len32 = LE2Native(len32);
-			(*so_template_->glsl_srcs_)[type] = MakeSharedPtr<std::string>(len32, '\0');
-			std::memcpy(&(*(*so_template_->glsl_srcs_)[type])[0], nsbp, len32);
-			nsbp += len32;
-
-			uint16_t num16;
-			std::memcpy(&num16, nsbp, sizeof(num16));
-			nsbp += sizeof(num16);
-			num16 = LE2Native(num16);
-			(*so_template_->pnames_)[type] = MakeSharedPtr<std::vector<std::string>>(num16);
-			for (size_t i = 0; i < num16; ++ i)
-			{
-				uint8_t len8;
-				std::memcpy(&len8, nsbp, sizeof(len8));
-				nsbp += sizeof(len8);
+			this->ReadNativeShaderBlock(type, effect, &native_shader_block[0]);
+			this->FillTFBVaryings(sd);
 
-				(*(*so_template_->pnames_)[type])[i].resize(len8);
-				std::memcpy(&(*(*so_template_->pnames_)[type])[i][0], nsbp, len8);
-				nsbp += len8;
-			}
+			ret = is_shader_validate_[type];
+		}
 
-			std::memcpy(&num16, nsbp, sizeof(num16));
-			nsbp += sizeof(num16);
-			num16 = LE2Native(num16);
-			(*so_template_->glsl_res_names_)[type] = MakeSharedPtr<std::vector<std::string>>(num16);
-			for (size_t i = 0; i < num16; ++ i)
-			{
-				uint8_t len8;
-				std::memcpy(&len8, nsbp, sizeof(len8));
-				nsbp += sizeof(len8);
+		return ret;
+	}
 
-				(*(*so_template_->glsl_res_names_)[type])[i].resize(len8);
-				std::memcpy(&(*(*so_template_->glsl_res_names_)[type])[i][0], nsbp, len8);
-				nsbp += len8;
-			}
+	void OGLShaderObject::ReadNativeShaderBlock(ShaderType type, RenderEffect const & effect, uint8_t const * nsbp)
+	{
+		uint32_t len32;
+		std::memcpy(&len32, nsbp, sizeof(len32));
+		nsbp += sizeof(len32);
+		len32 = LE2Native(len32);
+		(*so_template_->glsl_srcs_)[type] = MakeSharedPtr<std::string>(len32, '\0');
+		std::memcpy(&(*(*so_template_->glsl_srcs_)[type])[0], nsbp, len32);
+		nsbp += len32;
+
+		uint16_t num16;
+		std::memcpy(&num16, nsbp, sizeof(num16));
+		nsbp += sizeof(num16);
+		num16 = LE2Native(num16);
+		(*so_template_->pnames_)[type] = MakeSharedPtr<std::vector<std::string>>(num16);
+		for (size_t i = 0; i < num16; ++ i)
+		{
+			uint8_t len8;
+			std::memcpy(&len8, nsbp, sizeof(len8));
+			nsbp += sizeof(len8);
 
-			std::memcpy(&num16, nsbp, sizeof(num16));
-			nsbp += sizeof(num16);
-			num16 = LE2Native(num16);
-			for (size_t i = 0; i < num16; ++ i)
-			{
-				uint8_t len8;
-				std::memcpy(&len8, nsbp, sizeof(len8));
-				nsbp += sizeof(len8);
+			(*(*so_template_->pnames_)[type])[i].resize(len8);
+			std::memcpy(&(*(*so_template_->pnames_)[type])[i][0], nsbp, len8);
+			nsbp += len8;
+		}
 
-				std::string tex_name;
-				tex_name.resize(len8);
-				std::memcpy(&tex_name[0], nsbp, len8);
-				nsbp += len8;
+		std::memcpy(&num16, nsbp, sizeof(num16));
+		nsbp += sizeof(num16);
+		num16 = LE2Native(num16);
+		(*so_template_->glsl_res_names_)[type] = MakeSharedPtr<std::vector<std::string>>(num16);
+		for (size_t i = 0; i < num16; ++ i)
+		{
+			uint8_t len8;
+			std::memcpy(&len8, nsbp, sizeof(len8));
+			nsbp += sizeof(len8);
 
-				std::memcpy(&len8, nsbp, sizeof(len8));
-				nsbp += sizeof(len8);
+			(*(*so_template_->glsl_res_names_)[type])[i].resize(len8);
+			std::memcpy(&(*(*so_template_->glsl_res_names_)[type])[i][0], nsbp, len8);
+			nsbp += len8;
+		}
 
-				std::string sampler_name;
-				sampler_name.resize(len8);
-				std::memcpy(&sampler_name[0], nsbp, len8);
-				nsbp += len8;
+		std::memcpy(&num16, nsbp, sizeof(num16));
+		nsbp += sizeof(num16);
+		num16 = LE2Native(num16);
+		for (size_t i = 0; i < num16; ++ i)
+		{
+			uint8_t len8;
+			std::memcpy(&len8, nsbp, sizeof(len8));
+			nsbp += sizeof(len8);
 
-				std::string combined_sampler_name = tex_name + "_" + sampler_name;
+			std::string tex_name;
+			tex_name.resize(len8);
+			std::memcpy(&tex_name[0], nsbp, len8);
+			nsbp += len8;
 
-				bool found = false;
-				for (uint32_t k = 0; k < tex_sampler_binds_.size(); ++ k)
-				{
-					if (std::get<0>(tex_sampler_binds_[k]) == combined_sampler_name)
-					{
-						std::get<3>(tex_sampler_binds_[k]) |= 1UL << type;
-						found = true;
-						break;
-					}
-				}
-				if (!found)
-				{
-					tex_sampler_binds_.push_back(std::make_tuple(combined_sampler_name,
-						effect.ParameterByName(tex_name), effect.ParameterByName(sampler_name), 1UL << type));
-				}
-			}
+			std::memcpy(&len8, nsbp, sizeof(len8));
+			nsbp += sizeof(len8);
 
-			if (ST_VertexShader == type)
-			{
-				uint8_t num8;
-				std::memcpy(&num8, nsbp, sizeof(num8));
-				nsbp += sizeof(num8);
-				so_template_->vs_usages_->resize(num8);
-				for (size_t i = 0; i < num8; ++ i)
-				{
-					uint8_t veu;
-					std::memcpy(&veu, nsbp, sizeof(veu));
-					nsbp += sizeof(veu);
+			std::string sampler_name;
+			sampler_name.resize(len8);
+			std::memcpy(&sampler_name[0], nsbp, len8);
+			nsbp += len8;
 
-					(*so_template_->vs_usages_)[i] = static_cast<VertexElementUsage>(veu);
-				}
+			std::string combined_sampler_name = tex_name + "_" + sampler_name;
 
-				std::memcpy(&num8, nsbp, sizeof(num8));
-				nsbp += sizeof(num8);
-				if (num8 > 0)
+			bool found = false;
+			for (uint32_t k = 0; k < tex_sampler_binds_.size(); ++ k)
+			{
+				if (std::get<0>(tex_sampler_binds_[k]) == combined_sampler_name)
 				{
-					so_template_->vs_usage_indices_->resize(num8);
-					std::memcpy(&(*so_template_->vs_usage_indices_)[0], nsbp, num8 * sizeof((*so_template_->vs_usage_indices_)[0]));
-					nsbp += num8 * sizeof((*so_template_->vs_usage_indices_)[0]);
+					std::get<3>(tex_sampler_binds_[k]) |= 1UL << type;
+					found = true;
+					break;
 				}
+			}
+			if (!found)
+			{
+				tex_sampler_binds_.push_back(std::make_tuple(combined_sampler_name,
+					effect.ParameterByName(tex_name), effect.ParameterByName(sampler_name), 1UL << type));
+			}
+		}
 
-				std::memcpy(&num8, nsbp, sizeof(num8));
-				nsbp += sizeof(num8);
-				so_template_->glsl_vs_attrib_names_->resize(num8);
-				for (size_t i = 0; i < num8; ++ i)
-				{
-					uint8_t len8;
-					std::memcpy(&len8, nsbp, sizeof(len8));
-					nsbp += sizeof(len8);
+		if (ST_VertexShader == type)
+		{
+			uint8_t num8;
+			std::memcpy(&num8, nsbp, sizeof(num8));
+			nsbp += sizeof(num8);
+			so_template_->vs_usages_->resize(num8);
+			for (size_t i = 0; i < num8; ++ i)
+			{
+				uint8_t veu;
+				std::memcpy(&veu, nsbp, sizeof(veu));
+				nsbp += sizeof(veu);
 
-					(*so_template_->glsl_vs_attrib_names_)[i].resize(len8);
-					std::memcpy(&(*so_template_->glsl_vs_attrib_names_)[i][0], nsbp, len8);
-					nsbp += len8;
-				}
+				(*so_template_->vs_usages_)[i] = static_cast<VertexElementUsage>(veu);
 			}
-			else if (ST_GeometryShader == type)
+
+			std::memcpy(&num8, nsbp, sizeof(num8));
+			nsbp += sizeof(num8);
+			if (num8 > 0)
 			{
-				std::memcpy(&so_template_->gs_input_type_, nsbp, sizeof(so_template_->gs_input_type_));
-				nsbp += sizeof(so_template_->gs_input_type_);
-				so_template_->gs_input_type_ = LE2Native(so_template_->gs_input_type_);
+				so_template_->vs_usage_indices_->resize(num8);
+				std::memcpy(&(*so_template_->vs_usage_indices_)[0], nsbp, num8 * sizeof((*so_template_->vs_usage_indices_)[0]));
+				nsbp += num8 * sizeof((*so_template_->vs_usage_indices_)[0]);
+			}
 
-				std::memcpy(&so_template_->gs_output_type_, nsbp, sizeof(so_template_->gs_output_type_));
-				nsbp += sizeof(so_template_->gs_output_type_);
-				so_template_->gs_output_type_ = LE2Native(so_template_->gs_output_type_);
+			std::memcpy(&num8, nsbp, sizeof(num8));
+			nsbp += sizeof(num8);
+			so_template_->glsl_vs_attrib_names_->resize(num8);
+			for (size_t i = 0; i < num8; ++ i)
+			{
+				uint8_t len8;
+				std::memcpy(&len8, nsbp, sizeof(len8));
+				nsbp += sizeof(len8);
 
-				std::memcpy(&so_template_->gs_max_output_vertex_, nsbp, sizeof(so_template_->gs_max_output_vertex_));
-				nsbp += sizeof(so_template_->gs_max_output_vertex_);
-				so_template_->gs_max_output_vertex_ = LE2Native(so_template_->gs_max_output_vertex_);
+				(*so_template_->glsl_vs_attrib_names_)[i].resize(len8);
+				std::memcpy(&(*so_template_->glsl_vs_attrib_names_)[i][0], nsbp, len8);
+				nsbp += len8;
 			}
+		}
+		else if (ST_GeometryShader == type)
+		{
+			std::memcpy(&so_template_->gs_input_type_, nsbp, sizeof(so_template_->gs_input_type_));
+			nsbp += sizeof(so_template_->gs_input_type_);
+			so_template_->gs_input_type_ = LE2Native(so_template_->gs_input_type_);
 
-			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
+			std::memcpy(&so_template_->gs_output_type_, nsbp, sizeof(so_template_->gs_output_type_));
+			nsbp += sizeof(so_template_->gs_output_type_);
+			so_template_->gs_output_type_ = LE2Native(so_template_->gs_output_type_);
 
-			ret = is_shader_validate_[type];
+			std::memcpy(&so_template_->gs_max_output_vertex_, nsbp, sizeof(so_template_->gs_max_output_vertex_));
+			nsbp += sizeof(so_template_->gs_max_output_vertex_);
+			so_template_->gs_max_output_vertex_ = LE2Native(so_template_->gs_max_output_vertex_);
 		}
-
-		return ret;
 	}
 
 	bool OGLShaderObject::StreamIn(ResIdentifierPtr const & res, ShaderType type, RenderEffect const & effect,
@@ -376,7 +381,7 @@ namespace KlayGE
 		return this->AttachNativeShader(type, effect, shader_desc_ids, native_shader_block);
 	}
 
-	void OGLShaderObject::StreamOut(std::ostream& os, ShaderType type)
+	std::vector<uint8_t> OGLShaderObject::GenNativeShaderBlock(ShaderType type) const
 	{
 		std::vector<uint8_t> native_shader_block;
 
@@ -409,7 +414,7 @@ namespace KlayGE
 			std::vector<std::pair<std::string, std::string>> tex_sampler_pairs;
 			for (size_t i = 0; i < tex_sampler_binds_.size(); ++ i)
 			{
-				if (std::get<3>(tex_sampler_binds_[i]) | (1UL << type))
+				if (std::get<3>(tex_sampler_binds_[i]) & (1UL << type))
 				{
 					tex_sampler_pairs.emplace_back(std::get<1>(tex_sampler_binds_[i])->Name(),
 						std::get<2>(tex_sampler_binds_[i])->Name());
@@ -473,6 +478,13 @@ namespace KlayGE
 			std::memcpy(&native_shader_block[0], &out_str[0], out_str.size());
 		}
 
+		return native_shader_block;
+	}
+
+	void OGLShaderObject::StreamOut(std::ostream& os, ShaderType type)
+	{
+		std::vector<uint8_t> const native_shader_block = this->GenNativeShaderBlock(type);
+
 		uint32_t len = static_cast<uint32_t>(native_shader_block.size());
 		{
 			uint32_t tmp = Native2LE(len);
@@ -632,245 +644,290 @@ namespace KlayGE
 				}
 				else
 				{
-					try
+					GLSLVersion gsv;
+					if (glloader_GL_VERSION_4_5())
 					{
-						GLSLVersion gsv;
-						if (glloader_GL_VERSION_4_5())
-						{
-							gsv = GSV_450;
-						}
-						else if (glloader_GL_VERSION_4_4())
-						{
-							gsv = GSV_440;
-						}
-						else if (glloader_GL_VERSION_4_3())
-						{
-							gsv = GSV_430;
-						}
-						else if (glloader_GL_VERSION_4_2())
-						{
-							gsv = GSV_420;
-						}
-						else //if (glloader_GL_VERSION_4_1())
+						gsv = GSV_450;
+					}
+					else if (glloader_GL_VERSION_4_4())
+					{
+						gsv = GSV_440;
+					}
+					else if (glloader_GL_VERSION_4_3())
+					{
+						gsv = GSV_430;
+					}
+					else if (glloader_GL_VERSION_4_2())
+					{
+						gsv = GSV_420;
+					}
+					else //if (glloader_GL_VERSION_4_1())
+					{
+						gsv = GSV_410;
+					}
+
+					uint32_t rules = DXBC2GLSL::DXBC2GLSL::DefaultRules(gsv);
+					rules &= ~GSR_UniformBlockBinding;
+
+					// An entry holds the native shader block. HS ones also have the tessellator state DS needs, in
+					// the last 8 bytes.
+					ShaderCache* shader_cache = re.NativeShaderCache().get();
+					uint64_t cache_key = 0;
+					bool cached = false;
+					if (shader_cache)
+					{
+						cache_key = ShaderCacheKey().Append(DXBC2GLSL_CACHE_VERSION).Append(static_cast<uint32_t>(type))
+							.Append(&code[0], code.size()).Append(static_cast<uint32_t>(gsv)).Append(rules)
+							.Append(has_gs).Append(has_ps)
+							.Append(so_template_->ds_partitioning_).Append(so_template_->ds_output_primitive_).Value();
+
+						std::vector<uint8_t> native_shader_block;
+						if (shader_cache->Load(cache_key, native_shader_block) && (native_shader_block.size() >= 24))
 						{
-							gsv = GSV_410;
+							this->ReadNativeShaderBlock(type, effect, &native_shader_block[0]);
+							if (ST_HullShader == type)
+							{
+								uint32_t ds_state[2];
+								std::memcpy(ds_state, &native_shader_block[native_shader_block.size() - sizeof(ds_state)],
+									sizeof(ds_state));
+								so_template_->ds_partitioning_ = LE2Native(ds_state[0]);
+								so_template_->ds_output_primitive_ = LE2Native(ds_state[1]);
+							}
+							cached = true;
 						}
+					}
 
-						DXBC2GLSL::DXBC2GLSL dxbc2glsl;
-						uint32_t rules = DXBC2GLSL::DXBC2GLSL::DefaultRules(gsv);
-						rules &= ~GSR_UniformBlockBinding;
-						dxbc2glsl.FeedDXBC(&code[0],
-							has_gs, has_ps, static_cast<ShaderTessellatorPartitioning>(so_template_->ds_partitioning_),
-							static_cast<ShaderTessellatorOutputPrimitive>(so_template_->ds_output_primitive_),
-							gsv, rules);
-						(*so_template_->glsl_srcs_)[type] = MakeSharedPtr<std::string>(dxbc2glsl.GLSLString());
-						(*so_template_->pnames_)[type] = MakeSharedPtr<std::vector<std::string>>();
-						(*so_template_->glsl_res_names_)[type] = MakeSharedPtr<std::vector<std::string>>();
-
-						for (uint32_t i = 0; i < dxbc2glsl.NumCBuffers(); ++ i)
+					if (!cached)
+					{
+						try
 						{
-							for (uint32_t j = 0; j < dxbc2glsl.NumVariables(i); ++ j)
+							DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+							dxbc2glsl.FeedDXBC(&code[0],
+								has_gs, has_ps, static_cast<ShaderTessellatorPartitioning>(so_template_->ds_partitioning_),
+								static_cast<ShaderTessellatorOutputPrimitive>(so_template_->ds_output_primitive_),
+								gsv, rules);
+							(*so_template_->glsl_srcs_)[type] = MakeSharedPtr<std::string>(dxbc2glsl.GLSLString());
+							(*so_template_->pnames_)[type] = MakeSharedPtr<std::vector<std::string>>();
+							(*so_template_->glsl_res_names_)[type] = MakeSharedPtr<std::vector<std::string>>();
+
+							for (uint32_t i = 0; i < dxbc2glsl.NumCBuffers(); ++ i)
 							{
-								if (dxbc2glsl.VariableUsed(i, j))
+								for (uint32_t j = 0; j < dxbc2glsl.NumVariables(i); ++ j)
 								{
-									(*so_template_->pnames_)[type]->push_back(dxbc2glsl.VariableName(i, j));
-									(*so_template_->glsl_res_names_)[type]->push_back(dxbc2glsl.VariableName(i, j));
+									if (dxbc2glsl.VariableUsed(i, j))
+									{
+										(*so_template_->pnames_)[type]->push_back(dxbc2glsl.VariableName(i, j));
+										(*so_template_->glsl_res_names_)[type]->push_back(dxbc2glsl.VariableName(i, j));
+									}
 								}
 							}
-						}
 
-						std::vector<char const *> tex_names;
-						std::vector<char const *> sampler_names;
-						for (uint32_t i = 0; i < dxbc2glsl.NumResources(); ++ i)
-						{
-							if (dxbc2glsl.ResourceUsed(i))
+							std::vector<char const *> tex_names;
+							std::vector<char const *> sampler_names;
+							for (uint32_t i = 0; i < dxbc2glsl.NumResources(); ++ i)
 							{
-								char const * res_name = dxbc2glsl.ResourceName(i);
-
-								if (SIT_TEXTURE == dxbc2glsl.ResourceType(i))
+								if (dxbc2glsl.ResourceUsed(i))
 								{
-									if (SSD_BUFFER == dxbc2glsl.ResourceDimension(i))
+									char const * res_name = dxbc2glsl.ResourceName(i);
+
+									if (SIT_TEXTURE == dxbc2glsl.ResourceType(i))
 									{
-										(*so_template_->pnames_)[type]->push_back(res_name);
-										(*so_template_->glsl_res_names_)[type]->push_back(res_name);
+										if (SSD_BUFFER == dxbc2glsl.ResourceDimension(i))
+										{
+											(*so_template_->pnames_)[type]->push_back(res_name);
+											(*so_template_->glsl_res_names_)[type]->push_back(res_name);
+										}
+										else
+										{
+											tex_names.push_back(res_name);
+										}
 									}
-									else
+									else if (SIT_SAMPLER == dxbc2glsl.ResourceType(i))
 									{
-										tex_names.push_back(res_name);
+										sampler_names.push_back(res_name);
 									}
 								}
-								else if (SIT_SAMPLER == dxbc2glsl.ResourceType(i))
-								{
-									sampler_names.push_back(res_name);
-								}
 							}
-						}
 
-						for (size_t i = 0; i < tex_names.size(); ++ i)
-						{
-							RenderEffectParameter* param = effect.ParameterByName(tex_names[i]);
-							for (size_t j = 0; j < sampler_names.size(); ++ j)
+							for (size_t i = 0; i < tex_names.size(); ++ i)
 							{
-								std::string combined_sampler_name = std::string(tex_names[i]) + "_" + sampler_names[j];
-								bool found = false;
-								for (uint32_t k = 0; k < tex_sampler_binds_.size(); ++ k)
+								RenderEffectParameter* param = effect.ParameterByName(tex_names[i]);
+								for (size_t j = 0; j < sampler_names.size(); ++ j)
 								{
-									if (std::get<0>(tex_sampler_binds_[k]) == combined_sampler_name)
+									std::string combined_sampler_name = std::string(tex_names[i]) + "_" + sampler_names[j];
+									bool found = false;
+									for (uint32_t k = 0; k < tex_sampler_binds_.size(); ++ k)
 									{
-										std::get<3>(tex_sampler_binds_[k]) |= 1UL << type;
-										found = true;
-										break;
+										if (std::get<0>(tex_sampler_binds_[k]) == combined_sampler_name)
+										{
+											std::get<3>(tex_sampler_binds_[k]) |= 1UL << type;
+											found = true;
+											break;
+										}
+									}
+									if (!found)
+									{
+										tex_sampler_binds_.push_back(std::make_tuple(combined_sampler_name,
+											param, effect.ParameterByName(sampler_names[j]), 1UL << type));
 									}
-								}
-								if (!found)
-								{
-									tex_sampler_binds_.push_back(std::make_tuple(combined_sampler_name,
-										param, effect.ParameterByName(sampler_names[j]), 1UL << type));
-								}
 
-								(*so_template_->pnames_)[type]->push_back(combined_sampler_name);
-								(*so_template_->glsl_res_names_)[type]->push_back(combined_sampler_name);
+									(*so_template_->pnames_)[type]->push_back(combined_sampler_name);
+									(*so_template_->glsl_res_names_)[type]->push_back(combined_sampler_name);
+								}
 							}
-						}
 
-						if (ST_VertexShader == type)
-						{
-							for (uint32_t i = 0; i < dxbc2glsl.NumInputParams(); ++ i)
+							if (ST_VertexShader == type)
 							{
-								if (dxbc2glsl.InputParam(i).mask != 0)
+								for (uint32_t i = 0; i < dxbc2glsl.NumInputParams(); ++ i)
 								{
-									std::string semantic = dxbc2glsl.InputParam(i).semantic_name;
-									uint32_t semantic_index = dxbc2glsl.InputParam(i).semantic_index;
-									std::string glsl_param_name = semantic;
-									size_t const semantic_hash = RT_HASH(semantic.c_str());
-
-									if ((CT_HASH("SV_VertexID") != semantic_hash)
-										&& (CT_HASH("SV_InstanceID") != semantic_hash))
+									if (dxbc2glsl.InputParam(i).mask != 0)
 									{
-										VertexElementUsage usage = VEU_Position;
-										uint8_t usage_index = 0;
-										if (CT_HASH("POSITION") == semantic_hash)
-										{
-											usage = VEU_Position;
-											glsl_param_name = "POSITION0";
-										}
-										else if (CT_HASH("NORMAL") == semantic_hash)
-										{
-											usage = VEU_Normal;
-											glsl_param_name = "NORMAL0";
-										}
-										else if (CT_HASH("COLOR") == semantic_hash)
+										std::string semantic = dxbc2glsl.InputParam(i).semantic_name;
+										uint32_t semantic_index = dxbc2glsl.InputParam(i).semantic_index;
+										std::string glsl_param_name = semantic;
+										size_t const semantic_hash = RT_HASH(semantic.c_str());
+
+										if ((CT_HASH("SV_VertexID") != semantic_hash)
+											&& (CT_HASH("SV_InstanceID") != semantic_hash))
 										{
-											if (0 == semantic_index)
+											VertexElementUsage usage = VEU_Position;
+											uint8_t usage_index = 0;
+											if (CT_HASH("POSITION") == semantic_hash)
 											{
-												usage = VEU_Diffuse;
-												glsl_param_name = "COLOR0";
+												usage = VEU_Position;
+												glsl_param_name = "POSITION0";
+											}
+											else if (CT_HASH("NORMAL") == semantic_hash)
+											{
+												usage = VEU_Normal;
+												glsl_param_name = "NORMAL0";
+											}
+											else if (CT_HASH("COLOR") == semantic_hash)
+											{
+												if (0 == semantic_index)
+												{
+													usage = VEU_Diffuse;
+													glsl_param_name = "COLOR0";
+												}
+												else
+												{
+													usage = VEU_Specular;
+													glsl_param_name = "COLOR1";
+												}
+											}
+											else if (CT_HASH("BLENDWEIGHT") == semantic_hash)
+											{
+												usage = VEU_BlendWeight;
+												glsl_param_name = "BLENDWEIGHT0";
+											}
+											else if (CT_HASH("BLENDINDICES") == semantic_hash)
+											{
+												usage = VEU_BlendIndex;
+												glsl_param_name = "BLENDINDICES0";
+											}
+											else if (0 == semantic.find("TEXCOORD"))
+											{
+												usage = VEU_TextureCoord;
+												usage_index = static_cast<uint8_t>(semantic_index);
+												glsl_param_name = "TEXCOORD" + boost::lexical_cast<std::string>(semantic_index);
+											}
+											else if (CT_HASH("TANGENT") == semantic_hash)
+											{
+												usage = VEU_Tangent;
+												glsl_param_name = "TANGENT0";
+											}
+											else if (CT_HASH("BINORMAL") == semantic_hash)
+											{
+												usage = VEU_Binormal;
+												glsl_param_name = "BINORMAL0";
 											}
 											else
 											{
-												usage = VEU_Specular;
-												glsl_param_name = "COLOR1";
+												KFL_UNREACHABLE("Invalid sementic");
 											}
-										}
-										else if (CT_HASH("BLENDWEIGHT") == semantic_hash)
-										{
-											usage = VEU_BlendWeight;
-											glsl_param_name = "BLENDWEIGHT0";
-										}
-										else if (CT_HASH("BLENDINDICES") == semantic_hash)
-										{
-											usage = VEU_BlendIndex;
-											glsl_param_name = "BLENDINDICES0";
-										}
-										else if (0 == semantic.find("TEXCOORD"))
-										{
-											usage = VEU_TextureCoord;
-											usage_index = static_cast<uint8_t>(semantic_index);
-											glsl_param_name = "TEXCOORD" + boost::lexical_cast<std::string>(semantic_index);
-										}
-										else if (CT_HASH("TANGENT") == semantic_hash)
-										{
-											usage = VEU_Tangent;
-											glsl_param_name = "TANGENT0";
-										}
-										else if (CT_HASH("BINORMAL") == semantic_hash)
-										{
-											usage = VEU_Binormal;
-											glsl_param_name = "BINORMAL0";
-										}
-										else
-										{
-											KFL_UNREACHABLE("Invalid sementic");
-										}
 
-										so_template_->vs_usages_->push_back(usage);
-										so_template_->vs_usage_indices_->push_back(usage_index);
-										so_template_->glsl_vs_attrib_names_->push_back(glsl_param_name);
+											so_template_->vs_usages_->push_back(usage);
+											so_template_->vs_usage_indices_->push_back(usage_index);
+											so_template_->glsl_vs_attrib_names_->push_back(glsl_param_name);
+										}
 									}
 								}
 							}
-						}
-						else if (ST_GeometryShader == type)
-						{
-							switch (dxbc2glsl.GSInputPrimitive())
+							else if (ST_GeometryShader == type)
 							{
-							case SP_Point:
-								so_template_->gs_input_type_ = GL_POINTS;
-								break;
+								switch (dxbc2glsl.GSInputPrimitive())
+								{
+								case SP_Point:
+									so_template_->gs_input_type_ = GL_POINTS;
+									break;
 
-							case SP_Line:
-								so_template_->gs_input_type_ = GL_LINES;
-								break;
+								case SP_Line:
+									so_template_->gs_input_type_ = GL_LINES;
+									break;
 
-							case SP_LineAdj:
-								so_template_->gs_input_type_ = GL_LINES_ADJACENCY;
-								break;
+								case SP_LineAdj:
+									so_template_->gs_input_type_ = GL_LINES_ADJACENCY;
+									break;
 
-							case SP_Triangle:
-								so_template_->gs_input_type_ = GL_TRIANGLES;
-								break;
+								case SP_Triangle:
+									so_template_->gs_input_type_ = GL_TRIANGLES;
+									break;
 
-							case SP_TriangleAdj:
-								so_template_->gs_input_type_ = GL_TRIANGLES_ADJACENCY;
-								break;
+								case SP_TriangleAdj:
+									so_template_->gs_input_type_ = GL_TRIANGLES_ADJACENCY;
+									break;
 
-							default:
-								KFL_UNREACHABLE("Invalid GS input type");
-							}
+								default:
+									KFL_UNREACHABLE("Invalid GS input type");
+								}
 
-							switch (dxbc2glsl.GSOutputTopology(0))
-							{
-							case SPT_PointList:
-								so_template_->gs_output_type_ = GL_POINTS;
-								break;
+								switch (dxbc2glsl.GSOutputTopology(0))
+								{
+								case SPT_PointList:
+									so_template_->gs_output_type_ = GL_POINTS;
+									break;
+
+								case SPT_LineStrip:
+									so_template_->gs_output_type_ = GL_LINE_STRIP;
+									break;
 
-							case SPT_LineStrip:
-								so_template_->gs_output_type_ = GL_LINE_STRIP;
-								break;
+								case SPT_TriangleStrip:
+									so_template_->gs_output_type_ = GL_TRIANGLE_STRIP;
+									break;
 
-							case SPT_TriangleStrip:
-								so_template_->gs_output_type_ = GL_TRIANGLE_STRIP;
-								break;
+								default:
+									KFL_UNREACHABLE("Invalid GS output topology");
+								}
 
-							default:
-								KFL_UNREACHABLE("Invalid GS output topology");
+								so_template_->gs_max_output_vertex_ = dxbc2glsl.MaxGSOutputVertex();
+							}
+							else if (ST_HullShader == type)
+							{
+								so_template_->ds_partitioning_ = dxbc2glsl.DSPartitioning();
+								so_template_->ds_output_primitive_ = dxbc2glsl.DSOutputPrimitive();
 							}
 
-							so_template_->gs_max_output_vertex_ = dxbc2glsl.MaxGSOutputVertex();
+							if (shader_cache)
+							{
+								std::vector<uint8_t> native_shader_block = this->GenNativeShaderBlock(type);
+								if (ST_HullShader == type)
+								{
+									uint32_t const ds_state[] = { Native2LE(so_template_->ds_partitioning_),
+										Native2LE(so_template_->ds_output_primitive_) };
+									uint8_t const * p = reinterpret_cast<uint8_t const *>(ds_state);
+									native_shader_block.insert(native_shader_block.end(), p, p + sizeof(ds_state));
+								}
+								shader_cache->Store(cache_key, native_shader_block);
+							}
 						}
-						else if (ST_HullShader == type)
+						catch (std::exception& ex)
 						{
-							so_template_->ds_partitioning_ = dxbc2glsl.DSPartitioning();
-							so_template_->ds_output_primitive_ = dxbc2glsl.DSOutputPrimitive();
-						}
-					}
-					catch (std::exception& ex)
-					{
-						is_shader_validate_[type] = false;
+							is_shader_validate_[type] = false;
 
-						LogError("Error(s) in conversion: %s/%s/%s", tech.Name().c_str(), pass.Name().c_str(), sd.func_name.c_str());
-						LogError(ex.what());
-						LogError("Please send this information and your shader to webmaster at klayge.org. We'll fix this ASAP.");
+							LogError("Error(s) in conversion: %s/%s/%s", tech.Name().c_str(), pass.Name().c_str(), sd.func_name.c_str());
+							LogError(ex.what());
+							LogError("Please send this information and your shader to webmaster at klayge.org. We'll fix this ASAP.");
+						}
 					}
 				}
 			}
@@ -879,7 +936,6 @@ namespace KlayGE
 		if (is_shader_validate_[type])
 		{
 			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -943,8 +999,6 @@ namespace KlayGE
 					}
 				}
 			}
-
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -961,22 +1015,62 @@ namespace KlayGE
 
 		if (is_validate_)
 		{
-			glProgramParameteri(glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			auto const & re = *checked_cast<OGLRenderEngine const *>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+
+			GLint num_bin_formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_bin_formats);
+
+			ShaderCache* shader_cache = (num_bin_formats > 0) ? re.NativeShaderCache().get() : nullptr;
+			uint64_t program_key = 0;
+			bool cached = false;
+			if (shader_cache)
+			{
+				program_key = this->ProgramCacheKey(re.DeviceSignature());
+				cached = this->LoadProgramBinary(*shader_cache, program_key);
+			}
+
+			if (!cached)
+			{
+				for (size_t type = 0; type < ST_NumShaderTypes; ++ type)
+				{
+					if (is_shader_validate_[type])
+					{
+						if ((*so_template_->glsl_srcs_)[type] && !(*so_template_->glsl_srcs_)[type]->empty())
+						{
+							this->AttachGLSL(static_cast<uint32_t>(type));
+							is_validate_ &= is_shader_validate_[type];
+						}
+					}
+				}
+
+				if (is_validate_)
+				{
+					glProgramParameteri(glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+					this->LinkGLSL();
+				}
+			}
 
-			this->LinkGLSL();
 			this->AttachUBOs(effect);
 
-			if (is_validate_)
+			if (is_validate_ && !cached && (num_bin_formats > 0))
 			{
-				GLint num = 0;
-				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num);
-				if (num > 0)
+				GLint len = 0;
+				glGetProgramiv(glsl_program_, GL_PROGRAM_BINARY_LENGTH, &len);
+				so_template_->glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t>>(len);
+				glGetProgramBinary(glsl_program_, len, nullptr, &so_template_->glsl_bin_format_,
+					&(*so_template_->glsl_bin_program_)[0]);
+
+				if (shader_cache)
 				{
-					GLint len = 0;
-					glGetProgramiv(glsl_program_, GL_PROGRAM_BINARY_LENGTH, &len);
-					so_template_->glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t>>(len);
-					glGetProgramBinary(glsl_program_, len, nullptr, &so_template_->glsl_bin_format_,
-						&(*so_template_->glsl_bin_program_)[0]);
+					// Program binary entry:
+					//			Format		4 bytes
+					//			Binary
+					std::vector<uint8_t> entry(sizeof(uint32_t) + so_template_->glsl_bin_program_->size());
+					uint32_t const format = Native2LE(static_cast<uint32_t>(so_template_->glsl_bin_format_));
+					std::memcpy(&entry[0], &format, sizeof(format));
+					std::memcpy(&entry[sizeof(format)], so_template_->glsl_bin_program_->data(),
+						so_template_->glsl_bin_program_->size());
+					shader_cache->Store(program_key, entry);
 				}
 			}
 
@@ -1174,6 +1268,68 @@ namespace KlayGE
 		return ret;
 	}
 
+	bool OGLShaderObject::LoadProgramBinary(ShaderCache& cache, uint64_t key)
+	{
+		std::vector<uint8_t> entry;
+		if (!cache.Load(key, entry) || (entry.size() <= sizeof(uint32_t)))
+		{
+			return false;
+		}
+
+		uint32_t format;
+		std::memcpy(&format, &entry[0], sizeof(format));
+		format = LE2Native(format);
+
+		glProgramParameteri(glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glProgramBinary(glsl_program_, format, &entry[sizeof(format)], static_cast<GLsizei>(entry.size() - sizeof(format)));
+
+		// A binary from another driver version, or one the driver just doesn't like any more, fails here. The
+		// entry is dropped, and the program goes through the normal compile and link.
+		GLint linked = false;
+		glGetProgramiv(glsl_program_, GL_LINK_STATUS, &linked);
+		if (!linked)
+		{
+			cache.Remove(key);
+			return false;
+		}
+
+		so_template_->glsl_bin_format_ = format;
+		so_template_->glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t>>(entry.begin() + sizeof(format), entry.end());
+		return true;
+	}
+
+	uint64_t OGLShaderObject::ProgramCacheKey(std::string const & device_signature) const
+	{
+		ShaderCacheKey key;
+		key.Append(device_signature);
+		for (uint32_t type = 0; type < ST_NumShaderTypes; ++ type)
+		{
+			key.Append(type);
+			if ((*so_template_->glsl_srcs_)[type])
+			{
+				key.Append(*(*so_template_->glsl_srcs_)[type]);
+			}
+			else
+			{
+				key.Append(std::string_view());
+			}
+		}
+		if (so_template_->glsl_tfb_varyings_)
+		{
+			key.Append(static_cast<uint32_t>(so_template_->glsl_tfb_varyings_->size()));
+			for (auto const & varying : *so_template_->glsl_tfb_varyings_)
+			{
+				key.Append(varying);
+			}
+		}
+		else
+		{
+			key.Append(0U);
+		}
+		key.Append(so_template_->tfb_separate_attribs_);
+		return key.Value();
+	}
+
 	GLint OGLShaderObject::GetAttribLocation(VertexElementUsage usage, uint8_t usage_index)
 	{
 		auto iter = attrib_locs_.find(std::make_pair(usage, usage_index));
@@ -1125,6 +1125,7 @@ namespace KlayGE
 		{
 			if (rl.UseIndices())
 			{
+				auto const index_ranges = rl.IndexRanges();
 				for (uint32_t i = 0; i < num_passes; ++ i)
 				{
 					auto& pass = tech.Pass(i);
@@ -1142,7 +1143,20 @@ namespace KlayGE
 						glBeginTransformFeedback(so_primitive_mode_);
 					}
 
-					glDrawElementsInstanced(mode, static_cast<GLsizei>(rl.NumIndices()), index_type, index_offset, num_instances);
+					if (index_ranges.empty())
+					{
+						glDrawElementsInstanced(mode, static_cast<GLsizei>(rl.NumIndices()), index_type, index_offset, num_instances);
+					}
+					else
+					{
+						uint32_t const index_size = (GL_UNSIGNED_SHORT == index_type) ? 2 : 4;
+						for (auto const & range : index_ranges)
+						{
+							glDrawElementsInstanced(mode, static_cast<GLsizei>(range.second), index_type,
+								index_offset + (static_cast<ptrdiff_t>(range.first) - rl.StartIndexLocation()) * index_size, num_instances);
+						}
+						num_draws_just_called_ += static_cast<uint32_t>(index_ranges.size()) - 1;
+					}
 
 					if (so_rl_)
 					{
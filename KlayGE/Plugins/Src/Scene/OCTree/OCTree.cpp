@@ -471,7 +471,7 @@ namespace KlayGE
 			if (frustum_)
 			{
 				// Frustum VS AABB
-				visible = frustum_->Intersect(aabb);
+				visible = simd_frustum_->Intersect(aabb);
 			}
 			else
 			{
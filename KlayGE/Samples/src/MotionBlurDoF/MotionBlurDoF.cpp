@@ -206,7 +206,7 @@ namespace
 
 		void Instance(float4x4 const & mat, Color const & clr)
 		{
-			model_ = mat;
+			this->ModelMatrix(mat);
 			inst_.clr = clr.ABGR();
 		}
 
@@ -221,6 +221,14 @@ namespace
 		}
 
 		virtual void SubThreadUpdate(float /*app_time*/, float elapsed_time) override
+		{
+			float4x4 const & model = this->ModelMatrix();
+			float e = elapsed_time * 0.3f * -model(3, 1);
+			this->ModelMatrix(model * MathLib::rotation_y(e));
+		}
+
+		// The instance data is read by rendering, so it's built from the model matrix of the main thread
+		virtual bool MainThreadUpdate(float app_time, float elapsed_time) override
 		{
 			last_mats_.push_back(model_);
 
@@ -229,13 +237,12 @@ namespace
 			inst_.last_mat[1] = matT.Row(1);
 			inst_.last_mat[2] = matT.Row(2);
 
-			float e = elapsed_time * 0.3f * -model_(3, 1);
-			model_ *= MathLib::rotation_y(e);
-
 			matT = MathLib::transpose(model_);
 			inst_.mat[0] = matT.Row(0);
 			inst_.mat[1] = matT.Row(1);
 			inst_.mat[2] = matT.Row(2);
+
+			return SceneObjectHelper::MainThreadUpdate(app_time, elapsed_time);
 		}
 
 		void MotionVecPass(bool motion_vec)
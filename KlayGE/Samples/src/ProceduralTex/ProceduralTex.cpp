@@ -145,13 +145,16 @@ namespace
 			}
 		}
 
-		virtual void SubThreadUpdate(float app_time, float /*elapsed_time*/) override
+		// Effect parameters are read by rendering, so they're set from the main thread
+		virtual bool MainThreadUpdate(float app_time, float elapsed_time) override
 		{
 			RenderModelPtr model = checked_pointer_cast<RenderModel>(renderable_);
 			for (uint32_t i = 0; i < model->NumSubrenderables(); ++ i)
 			{
 				checked_pointer_cast<RenderPolygon>(model->Subrenderable(i))->AppTime(app_time);
 			}
+
+			return SceneObjectHelper::MainThreadUpdate(app_time, elapsed_time);
 		}
 	};
 
@@ -735,6 +735,8 @@ void ScenePlayerApp::LoadScene(std::string const & name)
 
 void ScenePlayerApp::OnCreate()
 {
+	// The update scripts share one Python interpreter
+	Context::Instance().SceneManagerInstance().SubThreadUpdateWorkers(1);
 	this->LoadScene("DeferredRendering.kges");
 
 	font_ = SyncLoadFont("gkai00mp.kfont");
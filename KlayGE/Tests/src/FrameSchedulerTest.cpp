@@ -0,0 +1,172 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/FrameScheduler.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+TEST(FrameSchedulerTest, FixedStep)
+{
+	FrameScheduler scheduler;
+	scheduler.SimStep(0.01f);
+	scheduler.MaxSimSteps(4);
+
+	scheduler.Advance(0.025f);
+	EXPECT_EQ(2U, scheduler.NumSimSteps());
+	EXPECT_FLOAT_EQ(0.01f, scheduler.StepTime());
+	EXPECT_NEAR(0.5f, scheduler.SimAlpha(), 1e-4f);
+
+	// The carried 5 ms and these 5 ms make another step
+	scheduler.Advance(0.005f);
+	EXPECT_EQ(1U, scheduler.NumSimSteps());
+	EXPECT_NEAR(0.0f, scheduler.SimAlpha(), 1e-4f);
+
+	scheduler.Advance(0.004f);
+	EXPECT_EQ(0U, scheduler.NumSimSteps());
+	EXPECT_NEAR(0.4f, scheduler.SimAlpha(), 1e-4f);
+
+	// Over the long run, the steps match the real time
+	double total_time = 0.029 + 0.005 + 0.004;
+	uint32_t total_steps = 3;
+	for (uint32_t i = 0; i < 1000; ++ i)
+	{
+		float const t = 0.001f + (i % 7) * 0.0017f;
+		scheduler.Advance(t);
+		total_time += t;
+		total_steps += scheduler.NumSimSteps();
+	}
+	double const sim_time = total_steps * 0.01 + scheduler.SimAlpha() * 0.01;
+	EXPECT_NEAR(total_time, sim_time + 0.004, 1e-3);
+	EXPECT_FLOAT_EQ(0.0f, scheduler.DroppedTime());
+}
+
+TEST(FrameSchedulerTest, MaxSimSteps)
+{
+	FrameScheduler scheduler;
+	scheduler.SimStep(0.01f);
+	scheduler.MaxSimSteps(4);
+
+	// A hitch of 103 ms only takes 4 steps, and drops the whole steps beyond them
+	scheduler.Advance(0.103f);
+	EXPECT_EQ(4U, scheduler.NumSimSteps());
+	EXPECT_NEAR(0.06f, scheduler.DroppedTime(), 1e-4f);
+	EXPECT_NEAR(0.3f, scheduler.SimAlpha(), 1e-3f);
+
+	// The next frame isn't affected by the hitch
+	scheduler.Advance(0.01f);
+	EXPECT_EQ(1U, scheduler.NumSimSteps());
+	EXPECT_NEAR(0.3f, scheduler.SimAlpha(), 1e-3f);
+
+	scheduler.ResetStats();
+	EXPECT_FLOAT_EQ(0.0f, scheduler.DroppedTime());
+}
+
+TEST(FrameSchedulerTest, VariableStep)
+{
+	FrameScheduler scheduler;
+	EXPECT_FLOAT_EQ(0.0f, scheduler.SimStep());
+
+	scheduler.Advance(0.0123f);
+	EXPECT_EQ(1U, scheduler.NumSimSteps());
+	EXPECT_FLOAT_EQ(0.0123f, scheduler.StepTime());
+	EXPECT_FLOAT_EQ(0.0f, scheduler.SimAlpha());
+
+	scheduler.Advance(0.5f);
+	EXPECT_EQ(1U, scheduler.NumSimSteps());
+	EXPECT_FLOAT_EQ(0.5f, scheduler.StepTime());
+	EXPECT_FLOAT_EQ(0.0f, scheduler.DroppedTime());
+}
+
+TEST(FrameSchedulerTest, Histogram)
+{
+	FrameTimeHistogram hist;
+	EXPECT_EQ(0U, hist.NumSamples());
+	EXPECT_FLOAT_EQ(0.0f, hist.Percentile(0.5f));
+
+	// 1 ms to 100 ms
+	for (uint32_t i = 1; i <= 100; ++ i)
+	{
+		hist.Add(i * 0.001f - 0.00005f);
+	}
+	hist.Add(0.25f);
+
+	EXPECT_EQ(101U, hist.NumSamples());
+	EXPECT_FLOAT_EQ(0.25f, hist.Max());
+	EXPECT_NEAR((5050 * 0.001 - 100 * 0.00005 + 0.25) / 101, hist.Mean(), 1e-6);
+	EXPECT_NEAR(0.051f, hist.Percentile(0.5f), 1e-4f);
+	EXPECT_NEAR(0.096f, hist.Percentile(0.95f), 1e-4f);
+	EXPECT_FLOAT_EQ(0.25f, hist.Percentile(1.0f));
+	EXPECT_EQ(1U, hist.BinCount(FrameTimeHistogram::NUM_BINS - 1));
+
+	hist.Reset();
+	EXPECT_EQ(0U, hist.NumSamples());
+	EXPECT_FLOAT_EQ(0.0f, hist.Max());
+}
+
+TEST(FrameSchedulerTest, SimStateBuffer)
+{
+	SimStateBuffer<int> state(0);
+
+	// Nothing to render before the first publish
+	state.Publish();
+	EXPECT_EQ(0, state.RenderPrevious());
+	EXPECT_EQ(0, state.RenderCurrent());
+
+	for (int i = 1; i <= 3; ++ i)
+	{
+		state.BeginStep();
+		state.SimState() = i;
+	}
+	state.Publish();
+	EXPECT_EQ(2, state.RenderPrevious());
+	EXPECT_EQ(3, state.RenderCurrent());
+
+	// The simulation goes on from the published state, without touching what rendering reads
+	EXPECT_EQ(3, state.SimState());
+	state.BeginStep();
+	state.SimState() = 4;
+	EXPECT_EQ(2, state.RenderPrevious());
+	EXPECT_EQ(3, state.RenderCurrent());
+	state.Publish();
+	EXPECT_EQ(3, state.RenderPrevious());
+	EXPECT_EQ(4, state.RenderCurrent());
+
+	// A frame without steps keeps the rendering states
+	state.Publish();
+	EXPECT_EQ(3, state.RenderPrevious());
+	EXPECT_EQ(4, state.RenderCurrent());
+	EXPECT_EQ(4, state.SimState());
+}
+
+TEST(FrameSchedulerTest, FrameCap)
+{
+	float const max_fps = 200;
+	uint32_t const num_frames = 100;
+
+	FrameScheduler scheduler;
+	scheduler.MaxFPS(max_fps);
+
+	Timer timer;
+	EXPECT_FLOAT_EQ(0.0f, scheduler.BeginFrame());
+	vector<float> frame_times;
+	for (uint32_t i = 0; i < num_frames; ++ i)
+	{
+		frame_times.push_back(scheduler.BeginFrame());
+	}
+	double const elapsed = timer.elapsed();
+
+	EXPECT_GE(elapsed, num_frames / max_fps * 0.999);
+	EXPECT_EQ(num_frames, scheduler.FrameTimes().NumSamples());
+	EXPECT_GE(*min_element(frame_times.begin(), frame_times.end()), 1 / max_fps * 0.999f);
+
+	FrameTimeHistogram const & hist = scheduler.FrameTimes();
+	testing::Test::RecordProperty("FrameCapMeanUs", static_cast<int>(hist.Mean() * 1e6f));
+	testing::Test::RecordProperty("FrameCapP99Us", static_cast<int>(hist.Percentile(0.99f) * 1e6f));
+	testing::Test::RecordProperty("FrameCapMaxUs", static_cast<int>(hist.Max() * 1e6f));
+}
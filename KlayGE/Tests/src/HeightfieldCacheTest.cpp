@@ -0,0 +1,347 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Noise.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/HeightfieldCache.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include <iostream>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	float const SPACING = 2.0f;
+
+	float TestHeight(float x, float z)
+	{
+		return MathLib::SimplexNoise<float>::Instance().fBm(x * 0.004f, z * 0.004f, 5) * 60;
+	}
+
+	// Moller-Trumbore, written again so the test doesn't share the bugs of the cache
+	bool BruteForceTriangle(float3 const & v0, float3 const & v1, float3 const & v2, float3 const & orig,
+		float3 const & dir, float& t)
+	{
+		float3 const e1 = v1 - v0;
+		float3 const e2 = v2 - v0;
+		float3 const p = MathLib::cross(dir, e2);
+		float const det = MathLib::dot(e1, p);
+		if (std::abs(det) < 1e-20f)
+		{
+			return false;
+		}
+		float3 const s = orig - v0;
+		float const u = MathLib::dot(s, p) / det;
+		float3 const q = MathLib::cross(s, e1);
+		float const v = MathLib::dot(dir, q) / det;
+		float const d = MathLib::dot(e2, q) / det;
+		if ((u >= 0) && (v >= 0) && (u + v <= 1) && (d >= 0) && (d < t))
+		{
+			t = d;
+			return true;
+		}
+		return false;
+	}
+
+	// Tests every cell under the ray
+	bool BruteForceRayCast(float3 const & orig, float3 const & dir, float max_dist, float& dist)
+	{
+		float3 const end = orig + dir * max_dist;
+		int32_t const x0 = static_cast<int32_t>(std::floor(std::min(orig.x(), end.x()) / SPACING)) - 1;
+		int32_t const z0 = static_cast<int32_t>(std::floor(std::min(orig.z(), end.z()) / SPACING)) - 1;
+		int32_t const x1 = static_cast<int32_t>(std::floor(std::max(orig.x(), end.x()) / SPACING)) + 1;
+		int32_t const z1 = static_cast<int32_t>(std::floor(std::max(orig.z(), end.z()) / SPACING)) + 1;
+
+		bool hit = false;
+		float closest = max_dist;
+		for (int32_t z = z0; z <= z1; ++ z)
+		{
+			for (int32_t x = x0; x <= x1; ++ x)
+			{
+				float const wx0 = x * SPACING;
+				float const wz0 = z * SPACING;
+				float const wx1 = (x + 1) * SPACING;
+				float const wz1 = (z + 1) * SPACING;
+				float3 const v00(wx0, TestHeight(wx0, wz0), wz0);
+				float3 const v10(wx1, TestHeight(wx1, wz0), wz0);
+				float3 const v01(wx0, TestHeight(wx0, wz1), wz1);
+				float3 const v11(wx1, TestHeight(wx1, wz1), wz1);
+				hit |= BruteForceTriangle(v00, v01, v11, orig, dir, closest);
+				hit |= BruteForceTriangle(v00, v11, v10, orig, dir, closest);
+			}
+		}
+		if (hit)
+		{
+			dist = closest;
+		}
+		return hit;
+	}
+
+	void TestRays(std::vector<SceneRay>& rays, uint32_t num, float range)
+	{
+		std::mt19937 gen(7);
+		std::uniform_real_distribution<float> pos(-range, range);
+		std::uniform_real_distribution<float> angle(0, 2 * PI);
+		std::uniform_real_distribution<float> pitch(-0.8f, 0.1f);
+		rays.resize(num);
+		for (auto& ray : rays)
+		{
+			float const a = angle(gen);
+			float const p = pitch(gen);
+			ray.orig = float3(pos(gen), 80, pos(gen));
+			ray.dir = float3(std::cos(a) * std::cos(p), std::sin(p), std::sin(a) * std::cos(p));
+			ray.max_dist = 300;
+		}
+	}
+}
+
+TEST(HeightfieldCacheTest, HeightAndNormalMatchTriangles)
+{
+	HeightfieldCache cache(TestHeight, SPACING, 16);
+
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> pos(-200, 200);
+	std::uniform_real_distribution<float> frac(0, 1);
+	for (uint32_t i = 0; i < 500; ++ i)
+	{
+		float const cx = std::floor(pos(gen) / SPACING);
+		float const cz = std::floor(pos(gen) / SPACING);
+		float const fx = frac(gen);
+		float const fz = frac(gen);
+		float const x = (cx + fx) * SPACING;
+		float const z = (cz + fz) * SPACING;
+
+		float3 const v00(cx * SPACING, TestHeight(cx * SPACING, cz * SPACING), cz * SPACING);
+		float3 const v10((cx + 1) * SPACING, TestHeight((cx + 1) * SPACING, cz * SPACING), cz * SPACING);
+		float3 const v01(cx * SPACING, TestHeight(cx * SPACING, (cz + 1) * SPACING), (cz + 1) * SPACING);
+		float3 const v11((cx + 1) * SPACING, TestHeight((cx + 1) * SPACING, (cz + 1) * SPACING), (cz + 1) * SPACING);
+
+		float3 normal;
+		float height;
+		if (fz >= fx)
+		{
+			normal = MathLib::normalize(MathLib::cross(v01 - v00, v11 - v00));
+			height = v00.y() + fz * (v01.y() - v00.y()) + fx * (v11.y() - v01.y());
+		}
+		else
+		{
+			normal = MathLib::normalize(MathLib::cross(v11 - v00, v10 - v00));
+			height = v00.y() + fx * (v10.y() - v00.y()) + fz * (v11.y() - v10.y());
+		}
+
+		EXPECT_NEAR(cache.Height(x, z), height, 1e-3f);
+		float3 const n = cache.Normal(x, z);
+		EXPECT_NEAR(n.x(), normal.x(), 1e-3f);
+		EXPECT_NEAR(n.y(), normal.y(), 1e-3f);
+		EXPECT_NEAR(n.z(), normal.z(), 1e-3f);
+	}
+
+	// On the samples, and across tile borders on the negative side
+	for (int32_t i = -40; i <= 40; ++ i)
+	{
+		float const x = i * SPACING;
+		float const z = -i * 3 * SPACING;
+		EXPECT_FLOAT_EQ(cache.Height(x, z), TestHeight(x, z));
+	}
+}
+
+TEST(HeightfieldCacheTest, BatchMatchesSingle)
+{
+	HeightfieldCache cache(TestHeight, SPACING, 32);
+
+	std::mt19937 gen(2);
+	std::uniform_real_distribution<float> pos(-300, 300);
+	std::vector<float2> xz(1000);
+	for (auto& p : xz)
+	{
+		p = float2(pos(gen), pos(gen));
+	}
+
+	std::vector<float> heights(xz.size());
+	std::vector<float3> normals(xz.size());
+	cache.Height(xz, &heights[0]);
+	cache.Normal(xz, &normals[0]);
+	for (size_t i = 0; i < xz.size(); ++ i)
+	{
+		EXPECT_EQ(heights[i], cache.Height(xz[i].x(), xz[i].y()));
+		EXPECT_EQ(normals[i], cache.Normal(xz[i].x(), xz[i].y()));
+	}
+
+	std::vector<SceneRay> rays;
+	TestRays(rays, 200, 300);
+	std::vector<float> dists(rays.size());
+	uint32_t const num_hits = cache.RayCast(rays, &dists[0]);
+	uint32_t expected_hits = 0;
+	for (size_t i = 0; i < rays.size(); ++ i)
+	{
+		float dist;
+		if (cache.RayCast(rays[i].orig, rays[i].dir, rays[i].max_dist, dist))
+		{
+			EXPECT_EQ(dists[i], dist);
+			++ expected_hits;
+		}
+		else
+		{
+			EXPECT_LT(dists[i], 0);
+		}
+	}
+	EXPECT_EQ(num_hits, expected_hits);
+}
+
+TEST(HeightfieldCacheTest, RayCastMatchesBruteForce)
+{
+	HeightfieldCache cache(TestHeight, SPACING, 16);
+
+	std::vector<SceneRay> rays;
+	TestRays(rays, 300, 200);
+
+	// Straight down, and flat along the axes
+	rays.push_back({ float3(13.3f, 100, -7.9f), float3(0, -1, 0), 300.0f });
+	rays.push_back({ float3(-50, 0, 21.7f), float3(1, 0, 0), 300.0f });
+	rays.push_back({ float3(9.1f, 0, 50), float3(0, 0, -1), 300.0f });
+
+	uint32_t num_hits = 0;
+	for (auto const & ray : rays)
+	{
+		float dist = -1;
+		float expected_dist = -1;
+		bool const hit = cache.RayCast(ray.orig, ray.dir, ray.max_dist, dist);
+		bool const expected_hit = BruteForceRayCast(ray.orig, ray.dir, ray.max_dist, expected_dist);
+		EXPECT_EQ(hit, expected_hit);
+		if (hit && expected_hit)
+		{
+			EXPECT_NEAR(dist, expected_dist, 1e-3f);
+			float3 const p = ray.orig + ray.dir * dist;
+			EXPECT_NEAR(p.y(), cache.Height(p.x(), p.z()), 1e-2f);
+			++ num_hits;
+		}
+	}
+	EXPECT_GT(num_hits, rays.size() / 4);
+}
+
+TEST(HeightfieldCacheTest, PrefetchAndEvict)
+{
+	{
+		HeightfieldCache cache(TestHeight, SPACING, 16);
+		float const tile_extent = 16 * SPACING;
+
+		// 3x3 tiles
+		cache.Prefetch(-tile_extent, -tile_extent, tile_extent * 2 - 1, tile_extent * 2 - 1);
+		cache.WaitForPrefetch();
+		EXPECT_EQ(cache.NumTiles(), 9U);
+		EXPECT_EQ(cache.NumGeneratedTiles(), 9U);
+
+		for (float z = -tile_extent; z < tile_extent * 2; z += 3.7f)
+		{
+			for (float x = -tile_extent; x < tile_extent * 2; x += 3.7f)
+			{
+				cache.Height(x, z);
+			}
+		}
+		EXPECT_EQ(cache.NumGeneratedTiles(), 9U);
+
+		cache.Height(tile_extent * 5, 0);
+		EXPECT_EQ(cache.NumGeneratedTiles(), 10U);
+
+		cache.Clear();
+		EXPECT_EQ(cache.NumTiles(), 0U);
+	}
+	{
+		HeightfieldCache cache(TestHeight, SPACING, 8, 16);
+		float const tile_extent = 8 * SPACING;
+		for (int i = 0; i < 40; ++ i)
+		{
+			cache.Height(i * tile_extent, 0);
+			EXPECT_LE(cache.NumTiles(), 16U);
+		}
+		EXPECT_EQ(cache.NumGeneratedTiles(), 40U);
+
+		// The latest tiles are kept
+		cache.Height(39 * tile_extent, 0);
+		EXPECT_EQ(cache.NumGeneratedTiles(), 40U);
+
+		// Queries during a prefetch wait for or take over the queued tiles, none is generated twice
+		cache.Prefetch(-tile_extent * 2, -tile_extent * 2, tile_extent * 2 - 1, tile_extent * 2 - 1);
+		for (float x = -tile_extent * 2; x < tile_extent * 2; x += 1.3f)
+		{
+			cache.Height(x, x);
+		}
+		cache.WaitForPrefetch();
+		EXPECT_EQ(cache.NumGeneratedTiles(), 56U);
+	}
+}
+
+TEST(HeightfieldCacheTest, QueryThroughput)
+{
+	HeightfieldCache cache(TestHeight, SPACING, 64);
+
+	// Covers all rays, so only the queries are timed
+	Timer timer;
+	cache.Prefetch(-640, -640, 639, 639);
+	cache.WaitForPrefetch();
+	double const prefetch_time = timer.elapsed();
+
+	uint32_t const NUM_QUERIES = 1U << 18;
+	std::mt19937 gen(3);
+	std::uniform_real_distribution<float> pos(-512, 511);
+	std::vector<float2> xz(NUM_QUERIES);
+	for (auto& p : xz)
+	{
+		p = float2(pos(gen), pos(gen));
+	}
+	// Sorted by area, the way a batch of gameplay queries should be
+	std::sort(xz.begin(), xz.end(),
+		[](float2 const & lhs, float2 const & rhs)
+		{
+			int32_t const lz = static_cast<int32_t>(std::floor(lhs.y() / 128));
+			int32_t const rz = static_cast<int32_t>(std::floor(rhs.y() / 128));
+			return (lz < rz) || ((lz == rz) && (lhs.x() < rhs.x()));
+		});
+
+	std::vector<float> heights(NUM_QUERIES);
+	timer.restart();
+	for (uint32_t i = 0; i < NUM_QUERIES; ++ i)
+	{
+		heights[i] = cache.Height(xz[i].x(), xz[i].y());
+	}
+	double const single_height_time = timer.elapsed();
+
+	timer.restart();
+	cache.Height(xz, &heights[0]);
+	double const batch_height_time = timer.elapsed();
+
+	std::vector<float3> normals(NUM_QUERIES);
+	timer.restart();
+	cache.Normal(xz, &normals[0]);
+	double const batch_normal_time = timer.elapsed();
+
+	uint32_t const NUM_RAYS = 1U << 14;
+	std::vector<SceneRay> rays;
+	TestRays(rays, NUM_RAYS, 300);
+	std::vector<float> dists(NUM_RAYS);
+	timer.restart();
+	uint32_t const num_hits = cache.RayCast(rays, &dists[0]);
+	double const ray_time = timer.elapsed();
+	EXPECT_GT(num_hits, 0U);
+
+	double const single_heights_per_second = NUM_QUERIES / std::max(single_height_time, 1e-6);
+	double const batch_heights_per_second = NUM_QUERIES / std::max(batch_height_time, 1e-6);
+	double const normals_per_second = NUM_QUERIES / std::max(batch_normal_time, 1e-6);
+	double const rays_per_second = NUM_RAYS / std::max(ray_time, 1e-6);
+	testing::Test::RecordProperty("prefetch_ms", static_cast<int>(prefetch_time * 1000));
+	testing::Test::RecordProperty("single_heights_per_second", static_cast<int>(single_heights_per_second));
+	testing::Test::RecordProperty("batch_heights_per_second", static_cast<int>(batch_heights_per_second));
+	testing::Test::RecordProperty("normals_per_second", static_cast<int>(normals_per_second));
+	testing::Test::RecordProperty("rays_per_second", static_cast<int>(rays_per_second));
+	std::cout << "Heightfield: " << cache.NumTiles() << " tiles prefetched in " << prefetch_time * 1000 << " ms, "
+		<< single_heights_per_second / 1e6 << " M heights/s single, "
+		<< batch_heights_per_second / 1e6 << " M heights/s batched, "
+		<< normals_per_second / 1e6 << " M normals/s batched, "
+		<< rays_per_second / 1e6 << " M rays/s" << std::endl;
+}
@@ -0,0 +1,106 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderLayout.hpp>
+#include <KlayGE/GraphicsBuffer.hpp>
+#include <KlayGE/Renderable.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KlayGE/DeferredRenderingLayer.hpp>
+
+#include <string>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// A clone of a model has its own renderable and layout, but shares the vertex buffer
+	class CloneRenderable : public Renderable
+	{
+	public:
+		explicit CloneRenderable(GraphicsBufferPtr const & vb)
+			: pos_aabb_(float3(-1, -1, 0), float3(1, 1, 0)), tc_aabb_(float3(0, 0, 0), float3(1, 1, 0))
+		{
+			rl_ = Context::Instance().RenderFactoryInstance().MakeRenderLayout();
+			rl_->TopologyType(RenderLayout::TT_TriangleList);
+			rl_->BindVertexStream(vb, VertexElement(VEU_Position, 0, EF_ABGR32F));
+
+			this->Pass(PT_OpaqueGBufferMRT);
+		}
+
+		RenderLayout& GetRenderLayout() const override
+		{
+			return *rl_;
+		}
+
+		std::wstring const & Name() const override
+		{
+			static std::wstring const name(L"CloneRenderable");
+			return name;
+		}
+
+		AABBox const & PosBound() const override
+		{
+			return pos_aabb_;
+		}
+
+		AABBox const & TexcoordBound() const override
+		{
+			return tc_aabb_;
+		}
+
+	private:
+		RenderLayoutPtr rl_;
+		AABBox pos_aabb_;
+		AABBox tc_aabb_;
+	};
+}
+
+// Two clones with different model matrices have to end up in one instanced draw, with one world matrix per instance
+TEST_F(KlayGETest, MergeInstancesOfClones)
+{
+	ContextCfg cfg = Context::Instance().Config();
+	bool const deferred_rendering = cfg.deferred_rendering;
+	cfg.deferred_rendering = true;
+	Context::Instance().Config(cfg);
+	ASSERT_TRUE(Context::Instance().DeferredRenderingLayerInstance() != nullptr);
+
+	float4 const positions[] =
+	{
+		float4(-1, -1, 0, 1),
+		float4(+1, -1, 0, 1),
+		float4(+0, +1, 0, 1)
+	};
+	GraphicsBufferPtr vb = Context::Instance().RenderFactoryInstance().MakeVertexBuffer(BU_Static,
+		EAH_GPU_Read | EAH_Immutable, sizeof(positions), positions);
+
+	auto clone0 = MakeSharedPtr<CloneRenderable>(vb);
+	auto clone1 = MakeSharedPtr<CloneRenderable>(vb);
+	EXPECT_FALSE(clone0->InstancedWorld());
+	EXPECT_FALSE(clone1->InstancedWorld());
+
+	auto so0 = MakeSharedPtr<SceneObjectHelper>(clone0, 0);
+	so0->ModelMatrix(MathLib::translation(-2.0f, 0.0f, 5.0f));
+	so0->AddToSceneManager();
+	auto so1 = MakeSharedPtr<SceneObjectHelper>(clone1, 0);
+	so1->ModelMatrix(MathLib::translation(+2.0f, 0.0f, 5.0f));
+	so1->AddToSceneManager();
+
+	SceneManager& sm = Context::Instance().SceneManagerInstance();
+	sm.Update();
+
+	EXPECT_EQ(clone0->NumInstances() + clone1->NumInstances(), 2U);
+	Renderable const & leader = (clone0->NumInstances() > 0) ? *clone0 : *clone1;
+	EXPECT_EQ(leader.NumInstances(), 2U);
+	EXPECT_TRUE(leader.InstancedWorld());
+	EXPECT_EQ(leader.GetRenderLayout().NumInstances(), 2U);
+	EXPECT_EQ(sm.NumInstanceBytesUploaded(), static_cast<uint32_t>(2 * 3 * sizeof(float4)));
+
+	sm.ClearObject();
+	cfg.deferred_rendering = deferred_rendering;
+	Context::Instance().Config(cfg);
+}
@@ -22,7 +22,7 @@ namespace KlayGE
 		virtual uint32_t DoUpdate(uint32_t pass) override
 		{
 			KFL_UNUSED(pass);
-			return URV_Finished;
+			return URV_NeedFlush | URV_Finished;
 		}
 	};
 
@@ -0,0 +1,107 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KlayGE/LZMACodec.hpp>
+
+#include <sstream>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	std::vector<uint8_t> MakeTestData(size_t size)
+	{
+		std::vector<uint8_t> data(size);
+		uint32_t seed = 1;
+		for (size_t i = 0; i < size; ++ i)
+		{
+			seed = seed * 1103515245 + 12345;
+			data[i] = static_cast<uint8_t>((i / 7) ^ ((seed >> 16) & 0x3));
+		}
+		return data;
+	}
+}
+
+TEST(LZMACodecTest, SmallPayload)
+{
+	std::vector<uint8_t> const data = MakeTestData(1024);
+
+	LZMACodec lzma;
+	std::vector<uint8_t> comed;
+	lzma.Encode(comed, &data[0], data.size());
+	// Small payloads stay a plain LZMA stream, the first byte is the properties
+	EXPECT_NE(comed[0], 0xFF);
+
+	std::vector<uint8_t> decoded;
+	lzma.Decode(decoded, &comed[0], comed.size(), data.size());
+	EXPECT_EQ(data, decoded);
+}
+
+TEST(LZMACodecTest, BlockPayload)
+{
+	std::vector<uint8_t> const data = MakeTestData(3 * 1024 * 1024 + 12345);
+
+	LZMACodec lzma;
+	std::vector<uint8_t> comed;
+	lzma.Encode(comed, &data[0], data.size());
+	EXPECT_EQ(comed[0], 0xFF);
+
+	std::vector<uint8_t> decoded;
+	lzma.Decode(decoded, &comed[0], comed.size(), data.size());
+	EXPECT_EQ(data, decoded);
+
+	std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
+	ss->write(reinterpret_cast<char const *>(&comed[0]), comed.size());
+	ResIdentifierPtr res = MakeSharedPtr<ResIdentifier>("test", 0, ss);
+
+	std::ostringstream os;
+	EXPECT_EQ(lzma.Decode(os, res, comed.size(), data.size()), data.size());
+	std::string const streamed = os.str();
+	ASSERT_EQ(streamed.size(), data.size());
+	EXPECT_TRUE(std::equal(data.begin(), data.end(), reinterpret_cast<uint8_t const *>(streamed.data())));
+}
+
+// Truncated data has to fail, without reading past what it's given
+TEST(LZMACodecTest, TruncatedInput)
+{
+	std::vector<uint8_t> const data = MakeTestData(3 * 1024 * 1024 + 12345);
+
+	LZMACodec lzma;
+	std::vector<uint8_t> comed;
+	lzma.Encode(comed, &data[0], data.size());
+	ASSERT_EQ(comed[0], 0xFF);
+
+	std::vector<uint8_t> small_comed;
+	lzma.Encode(small_comed, &data[0], 1024);
+
+	std::vector<uint8_t> decoded;
+	for (uint64_t len : { 0, 3, 11, 12 + 4 })
+	{
+		std::vector<uint8_t> const truncated(comed.begin(), comed.begin() + static_cast<size_t>(len));
+		EXPECT_ANY_THROW(lzma.Decode(decoded, truncated.data(), len, data.size())) << len;
+
+		std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
+		ss->write(reinterpret_cast<char const *>(truncated.data()), truncated.size());
+		ResIdentifierPtr res = MakeSharedPtr<ResIdentifier>("test", 0, ss);
+		std::ostringstream os;
+		EXPECT_ANY_THROW(lzma.Decode(os, res, len, data.size())) << len;
+	}
+
+	std::vector<uint8_t> const small_truncated(small_comed.begin(), small_comed.begin() + 3);
+	EXPECT_ANY_THROW(lzma.Decode(decoded, small_truncated.data(), small_truncated.size(), 1024));
+
+	// The stream ends before the len it's said to have
+	{
+		std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
+		ss->write(reinterpret_cast<char const *>(&comed[0]), comed.size() / 2);
+		ResIdentifierPtr res = MakeSharedPtr<ResIdentifier>("test", 0, ss);
+		std::ostringstream os;
+		EXPECT_ANY_THROW(lzma.Decode(os, res, comed.size(), data.size()));
+	}
+
+	// The block table points past len
+	EXPECT_ANY_THROW(lzma.Decode(decoded, &comed[0], comed.size() / 2, data.size()));
+}
@@ -0,0 +1,241 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/NetChannel.hpp>
+#include <KlayGE/NetMsg.hpp>
+#include <KlayGE/Socket.hpp>
+#include <KlayGE/Player.hpp>
+#include <KlayGE/LobbyServer.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+#ifdef KLAYGE_PLATFORM_LINUX
+
+namespace
+{
+	char const MSG_ECHO = MSG_NOP + 1;
+
+	class EchoProcessor : public Processor
+	{
+	public:
+		void OnDefault(void* revBuf, int maxSize, void* sendBuf, int& numSend, sockaddr_in& from) const override
+		{
+			KFL_UNUSED(from);
+
+			std::memcpy(static_cast<char*>(sendBuf) + 1, static_cast<char*>(revBuf) + 1, maxSize - 1);
+			numSend = maxSize - 1;
+		}
+	};
+
+	class JoinProcessor : public Processor
+	{
+	public:
+		void OnJoin(uint32_t id) const override
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ids_.push_back(id);
+		}
+
+		std::vector<uint32_t> IDs() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return ids_;
+		}
+
+	private:
+		mutable std::mutex mutex_;
+		mutable std::vector<uint32_t> ids_;
+	};
+
+	// Polls the player for a message, for up to a second
+	bool ReceiveFromLobby(Player& player, std::vector<char>& msg)
+	{
+		msg.resize(Max_Buffer);
+		sockaddr_in from;
+		Timer timer;
+		while (timer.elapsed() < 1)
+		{
+			int const size = player.Receive(msg.data(), static_cast<int>(msg.size()), from);
+			if (size > 0)
+			{
+				msg.resize(size);
+				return true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+
+	struct Client
+	{
+		Socket socket;
+		std::unique_ptr<NetChannel> channel;
+		uint32_t id;
+		uint32_t num_in_flight;
+	};
+}
+
+// Load generator. Lots of clients keep a few echo messages in flight each. The packet rate of the server and
+//   the 99th percentile of the round trip go to the test report.
+TEST(LobbyServerTest, EchoUnderLoad)
+{
+	uint32_t const NUM_SHARDS = 2;
+	uint32_t const NUM_CLIENTS = 256;
+	uint32_t const IN_FLIGHT = 4;
+	double const DURATION = 2;
+
+	EchoProcessor pro;
+	LobbyServer server;
+	server.Create("LoadTest", NUM_CLIENTS, 0, NUM_SHARDS, pro);
+	sockaddr_in const server_addr = TransAddr("127.0.0.1", server.Port());
+
+	std::vector<Client> clients(NUM_CLIENTS);
+	for (auto& client : clients)
+	{
+		client.socket.Create(SOCK_DGRAM);
+		client.socket.Connect(server_addr);
+		client.socket.TimeOut(2000);
+
+		char join[Max_Buffer];
+		std::memset(join, 0, sizeof(join));
+		join[0] = MSG_JOIN;
+		client.socket.Send(join, sizeof(join));
+
+		char reply[6] = { 0, 0, 0, 0, 0, 0 };
+		ASSERT_EQ(client.socket.Receive(reply, sizeof(reply)), static_cast<int>(sizeof(reply)));
+		ASSERT_EQ(reply[0], MSG_JOIN);
+		ASSERT_EQ(reply[1], 1);
+		std::memcpy(&client.id, &reply[2], sizeof(client.id));
+		client.id = LE2Native(client.id);
+
+		client.socket.NonBlock(true);
+		Socket* socket = &client.socket;
+		client.channel = MakeUniquePtr<NetChannel>([socket](void const * packet, uint32_t size)
+			{
+				socket->Send(packet, static_cast<int>(size));
+			});
+		client.num_in_flight = 0;
+	}
+	EXPECT_EQ(server.NumPlayer(), NUM_CLIENTS);
+
+	// Every ID is unique
+	std::vector<uint32_t> ids;
+	for (auto const & client : clients)
+	{
+		ids.push_back(client.id);
+	}
+	std::sort(ids.begin(), ids.end());
+	EXPECT_EQ(std::unique(ids.begin(), ids.end()), ids.end());
+
+	uint64_t const start_packets = server.NumPacketsReceived();
+	std::vector<double> latencies;
+	std::vector<uint8_t> packet(NetChannel::DEFAULT_MTU);
+	std::vector<uint8_t> msg;
+	Timer timer;
+	while (timer.elapsed() < DURATION)
+	{
+		for (auto& client : clients)
+		{
+			double const now = timer.elapsed();
+			while (client.num_in_flight < IN_FLIGHT)
+			{
+				char echo[Max_Buffer];
+				std::memset(echo, 0, sizeof(echo));
+				echo[0] = MSG_ECHO;
+				std::memcpy(&echo[1], &now, sizeof(now));
+				if (!client.channel->Send(echo, sizeof(echo), true))
+				{
+					break;
+				}
+				++ client.num_in_flight;
+			}
+			client.channel->Update(now);
+
+			int size;
+			while ((size = client.socket.Receive(packet.data(), static_cast<int>(packet.size()))) > 0)
+			{
+				client.channel->ReceivePacket(packet.data(), size, timer.elapsed());
+			}
+			while (client.channel->Receive(msg))
+			{
+				if ((msg.size() == Max_Buffer) && (MSG_ECHO == static_cast<char>(msg[0])))
+				{
+					double send_time;
+					std::memcpy(&send_time, &msg[1], sizeof(send_time));
+					latencies.push_back(timer.elapsed() - send_time);
+					-- client.num_in_flight;
+				}
+			}
+		}
+	}
+	double const elapsed = timer.elapsed();
+	uint64_t const num_packets = server.NumPacketsReceived() - start_packets;
+
+	server.Close();
+
+	ASSERT_FALSE(latencies.empty());
+	std::sort(latencies.begin(), latencies.end());
+	double const p99 = latencies[latencies.size() * 99 / 100];
+
+	testing::Test::RecordProperty("echoes_per_second", static_cast<int>(latencies.size() / elapsed));
+	testing::Test::RecordProperty("server_packets_per_second", static_cast<int>(num_packets / elapsed));
+	testing::Test::RecordProperty("p99_latency_us", static_cast<int>(p99 * 1e6));
+}
+
+TEST(LobbyServerTest, PlayerJoinAndSend)
+{
+	JoinProcessor pro;
+	LobbyServer server;
+	server.Create("JoinTest", 4, 0, 2, pro);
+	sockaddr_in const server_addr = TransAddr("127.0.0.1", server.Port());
+
+	Player players[2];
+	for (auto& player : players)
+	{
+		ASSERT_TRUE(player.Join(server_addr));
+	}
+
+	// The players get the IDs the processor sees, not the joined flag
+	std::vector<uint32_t> ids = pro.IDs();
+	ASSERT_EQ(2U, ids.size());
+	EXPECT_NE(players[0].PlayerID(), players[1].PlayerID());
+	for (auto const & player : players)
+	{
+		EXPECT_NE(std::find(ids.begin(), ids.end(), player.PlayerID()), ids.end());
+	}
+
+	std::vector<char> msg;
+	char const hello[] = { MSG_NOP + 1, 'h', 'i' };
+	EXPECT_TRUE(server.Send(players[1].PlayerID(), hello, sizeof(hello)));
+	ASSERT_TRUE(ReceiveFromLobby(players[1], msg));
+	EXPECT_EQ(std::vector<char>(hello, hello + sizeof(hello)), msg);
+	EXPECT_FALSE(ReceiveFromLobby(players[0], msg));
+
+	EXPECT_FALSE(server.Send(0, hello, sizeof(hello)));
+	EXPECT_FALSE(server.Send(2U << 24 | 1, hello, sizeof(hello)));
+
+	char const all[] = { MSG_NOP + 2, 'a', 'l', 'l' };
+	server.Broadcast(all, sizeof(all));
+	for (auto& player : players)
+	{
+		ASSERT_TRUE(ReceiveFromLobby(player, msg));
+		EXPECT_EQ(std::vector<char>(all, all + sizeof(all)), msg);
+	}
+
+	for (auto& player : players)
+	{
+		player.Destroy();
+	}
+	server.Close();
+}
+
+#endif
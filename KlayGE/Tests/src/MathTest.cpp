@@ -1,5 +1,6 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/Noise.hpp>
 
 #include <gtest/gtest.h>
 
@@ -30,3 +31,64 @@ TEST(MathTest, NormalizeFloat4)
 	v = MathLib::normalize(v);
 	EXPECT_LT(MathLib::abs(MathLib::length(v) - 1.0f), 1e-5f);
 }
+
+TEST(MathTest, TransformAABB)
+{
+	AABBox const aabb(float3(-1, -2, -3), float3(4, 5, 6));
+	float4x4 const mat = MathLib::scaling(2.0f, -1.0f, 0.5f) * MathLib::rotation_y(0.7f) * MathLib::rotation_x(-1.2f)
+		* MathLib::translation(10.0f, -20.0f, 30.0f);
+
+	float3 min_pt = MathLib::transform_coord(aabb.Corner(0), mat);
+	float3 max_pt = min_pt;
+	for (int i = 1; i < 8; ++ i)
+	{
+		float3 const corner = MathLib::transform_coord(aabb.Corner(i), mat);
+		min_pt = MathLib::minimize(min_pt, corner);
+		max_pt = MathLib::maximize(max_pt, corner);
+	}
+
+	AABBox const transformed = MathLib::transform_aabb(aabb, mat);
+	for (int i = 0; i < 3; ++ i)
+	{
+		EXPECT_NEAR(transformed.Min()[i], min_pt[i], 1e-4f);
+		EXPECT_NEAR(transformed.Max()[i], max_pt[i], 1e-4f);
+	}
+}
+
+TEST(MathTest, SimplexNoiseBatch)
+{
+	auto& noiser = MathLib::SimplexNoise<float>::Instance();
+
+	uint32_t const NUM = 103;
+	std::vector<float> x(NUM);
+	std::vector<float> y(NUM);
+	std::vector<float> z(NUM);
+	for (uint32_t i = 0; i < NUM; ++ i)
+	{
+		x[i] = i * 0.37f - 20;
+		y[i] = i * -0.61f + 13;
+		z[i] = (i % 7) * 1.3f - 4;
+	}
+
+	std::vector<float> ret(NUM);
+	noiser.fBm(&x[0], &y[0], &ret[0], NUM, 5);
+	for (uint32_t i = 0; i < NUM; ++ i)
+	{
+		EXPECT_EQ(ret[i], noiser.fBm(x[i], y[i], 5));
+	}
+	noiser.turbulence(&x[0], &y[0], &z[0], &ret[0], NUM, 4);
+	for (uint32_t i = 0; i < NUM; ++ i)
+	{
+		EXPECT_EQ(ret[i], noiser.turbulence(x[i], y[i], z[i], 4));
+	}
+	noiser.tileable_fBm(&x[0], &y[0], 8.0f, 8.0f, &ret[0], NUM, 5);
+	for (uint32_t i = 0; i < NUM; ++ i)
+	{
+		EXPECT_EQ(ret[i], noiser.tileable_fBm(x[i], y[i], 8.0f, 8.0f, 5));
+	}
+	noiser.tileable_noise(&x[0], &y[0], &z[0], 8.0f, 8.0f, 8.0f, &ret[0], NUM);
+	for (uint32_t i = 0; i < NUM; ++ i)
+	{
+		EXPECT_EQ(ret[i], noiser.tileable_noise(x[i], y[i], z[i], 8.0f, 8.0f, 8.0f));
+	}
+}
@@ -0,0 +1,172 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/ElementFormat.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	void MakeInitData(std::vector<ElementInitData>& init_data, void const * data, uint32_t row_pitch, uint32_t height)
+	{
+		init_data.resize(1);
+		init_data[0].data = data;
+		init_data[0].row_pitch = row_pitch;
+		init_data[0].slice_pitch = row_pitch * height;
+	}
+}
+
+TEST(MipmapTest, BoxChainAverages)
+{
+	uint32_t const WIDTH = 4;
+	std::vector<Color> texels(WIDTH * WIDTH);
+	for (uint32_t i = 0; i < texels.size(); ++ i)
+	{
+		texels[i] = Color(static_cast<float>(i), static_cast<float>(i * i), 1, 0.5f);
+	}
+	std::vector<ElementInitData> init_data;
+	MakeInitData(init_data, texels.data(), WIDTH * sizeof(Color), WIDTH);
+
+	uint32_t num_mipmaps = 0;
+	std::vector<ElementInitData> mip_data;
+	std::vector<uint8_t> mip_data_block;
+	GenerateMipmaps(Texture::TT_2D, WIDTH, WIDTH, 1,
+		1, 1, EF_ABGR32F, init_data,
+		num_mipmaps, EF_ABGR32F, MF_Box, 0,
+		mip_data, mip_data_block);
+
+	ASSERT_EQ(num_mipmaps, 3U);
+	ASSERT_EQ(mip_data.size(), 3U);
+
+	for (uint32_t y = 0; y < WIDTH; ++ y)
+	{
+		Color const * level0 = reinterpret_cast<Color const *>(static_cast<uint8_t const *>(mip_data[0].data) + y * mip_data[0].row_pitch);
+		for (uint32_t x = 0; x < WIDTH; ++ x)
+		{
+			EXPECT_EQ(level0[x], texels[y * WIDTH + x]);
+		}
+	}
+
+	Color total(0, 0, 0, 0);
+	for (uint32_t y = 0; y < WIDTH / 2; ++ y)
+	{
+		Color const * level1 = reinterpret_cast<Color const *>(static_cast<uint8_t const *>(mip_data[1].data) + y * mip_data[1].row_pitch);
+		for (uint32_t x = 0; x < WIDTH / 2; ++ x)
+		{
+			Color expected(0, 0, 0, 0);
+			for (uint32_t dy = 0; dy < 2; ++ dy)
+			{
+				for (uint32_t dx = 0; dx < 2; ++ dx)
+				{
+					expected += texels[(y * 2 + dy) * WIDTH + x * 2 + dx];
+				}
+			}
+			expected /= 4;
+			total += expected;
+
+			EXPECT_NEAR(level1[x].r(), expected.r(), 1e-4f);
+			EXPECT_NEAR(level1[x].g(), expected.g(), 1e-4f);
+			EXPECT_NEAR(level1[x].b(), expected.b(), 1e-4f);
+			EXPECT_NEAR(level1[x].a(), expected.a(), 1e-4f);
+		}
+	}
+
+	total /= 4;
+	Color const & level2 = *static_cast<Color const *>(mip_data[2].data);
+	EXPECT_NEAR(level2.r(), total.r(), 1e-4f);
+	EXPECT_NEAR(level2.g(), total.g(), 1e-4f);
+	EXPECT_NEAR(level2.b(), total.b(), 1e-4f);
+	EXPECT_NEAR(level2.a(), total.a(), 1e-4f);
+}
+
+// A 3x3 level reduces to 1x1, every source texel has to be covered
+TEST(MipmapTest, BoxOddSize)
+{
+	uint32_t const WIDTH = 3;
+	std::vector<Color> texels(WIDTH * WIDTH);
+	float sum = 0;
+	for (uint32_t i = 0; i < texels.size(); ++ i)
+	{
+		texels[i] = Color(static_cast<float>(i), 0, 0, 1);
+		sum += i;
+	}
+	std::vector<ElementInitData> init_data;
+	MakeInitData(init_data, texels.data(), WIDTH * sizeof(Color), WIDTH);
+
+	uint32_t num_mipmaps = 0;
+	std::vector<ElementInitData> mip_data;
+	std::vector<uint8_t> mip_data_block;
+	GenerateMipmaps(Texture::TT_2D, WIDTH, WIDTH, 1,
+		1, 1, EF_ABGR32F, init_data,
+		num_mipmaps, EF_ABGR32F, MF_Box, 0,
+		mip_data, mip_data_block);
+
+	ASSERT_EQ(num_mipmaps, 2U);
+	EXPECT_NEAR(static_cast<Color const *>(mip_data[1].data)->r(), sum / texels.size(), 1e-4f);
+}
+
+// Black and white average to linear 0.5, which is 188 in sRGB, not 128
+TEST(MipmapTest, SRGBFilteredInLinearSpace)
+{
+	uint32_t const texels[] = { 0xFF000000, 0xFFFFFFFF, 0xFF000000, 0xFFFFFFFF };
+	std::vector<ElementInitData> init_data;
+	MakeInitData(init_data, texels, 2 * sizeof(texels[0]), 2);
+
+	uint32_t num_mipmaps = 0;
+	std::vector<ElementInitData> mip_data;
+	std::vector<uint8_t> mip_data_block;
+	GenerateMipmaps(Texture::TT_2D, 2, 2, 1,
+		1, 1, EF_ABGR8_SRGB, init_data,
+		num_mipmaps, EF_ABGR8_SRGB, MF_Box, 0,
+		mip_data, mip_data_block);
+
+	ASSERT_EQ(num_mipmaps, 2U);
+	uint8_t const * level1 = static_cast<uint8_t const *>(mip_data[1].data);
+	for (uint32_t ch = 0; ch < 3; ++ ch)
+	{
+		EXPECT_NEAR(level1[ch], 188, 1);
+	}
+	EXPECT_EQ(level1[3], 255);
+}
+
+// The runtime mip path downsamples with ResizeTexture, it has to produce the same levels as GenerateMipmaps
+TEST(MipmapTest, ResizeTextureMatchesGenerateMipmaps)
+{
+	uint32_t const WIDTH = 8;
+	std::vector<uint32_t> texels(WIDTH * WIDTH);
+	for (uint32_t i = 0; i < texels.size(); ++ i)
+	{
+		texels[i] = 0xFF000000 | ((i * 37) & 0xFF) | (((i * 91) & 0xFF) << 8) | (((i * 13) & 0xFF) << 16);
+	}
+	std::vector<ElementInitData> init_data;
+	MakeInitData(init_data, texels.data(), WIDTH * sizeof(texels[0]), WIDTH);
+
+	uint32_t num_mipmaps = 2;
+	std::vector<ElementInitData> mip_data;
+	std::vector<uint8_t> mip_data_block;
+	GenerateMipmaps(Texture::TT_2D, WIDTH, WIDTH, 1,
+		1, 1, EF_ABGR8_SRGB, init_data,
+		num_mipmaps, EF_ABGR8_SRGB, MF_Box, 0,
+		mip_data, mip_data_block);
+
+	std::vector<uint32_t> resized(WIDTH / 2 * WIDTH / 2);
+	ResizeTexture(resized.data(), WIDTH / 2 * sizeof(resized[0]), static_cast<uint32_t>(resized.size() * sizeof(resized[0])), EF_ABGR8_SRGB,
+		WIDTH / 2, WIDTH / 2, 1,
+		texels.data(), WIDTH * sizeof(texels[0]), WIDTH * WIDTH * sizeof(texels[0]), EF_ABGR8_SRGB,
+		WIDTH, WIDTH, 1,
+		true);
+
+	ASSERT_EQ(num_mipmaps, 2U);
+	for (uint32_t y = 0; y < WIDTH / 2; ++ y)
+	{
+		uint32_t const * level1 = reinterpret_cast<uint32_t const *>(static_cast<uint8_t const *>(mip_data[1].data) + y * mip_data[1].row_pitch);
+		for (uint32_t x = 0; x < WIDTH / 2; ++ x)
+		{
+			EXPECT_EQ(resized[y * WIDTH / 2 + x], level1[x]);
+		}
+	}
+}
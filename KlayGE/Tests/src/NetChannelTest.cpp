@@ -0,0 +1,258 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/NetChannel.hpp>
+#include <KlayGE/Socket.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Two channels over an in-memory link. Every drop_period-th packet is dropped, and packets in flight are
+	//   delivered in reverse order every other pump.
+	class LossyLink
+	{
+	public:
+		explicit LossyLink(uint32_t drop_period)
+			: a([this](void const * packet, uint32_t size) { this->Enqueue(a_to_b_, packet, size); }),
+				b([this](void const * packet, uint32_t size) { this->Enqueue(b_to_a_, packet, size); }),
+				drop_period_(drop_period), num_packets_(0), num_pumps_(0)
+		{
+		}
+
+		void Pump(double now)
+		{
+			a.Update(now);
+			b.Update(now);
+
+			++ num_pumps_;
+			this->Deliver(a_to_b_, b, now);
+			this->Deliver(b_to_a_, a, now);
+		}
+
+	private:
+		void Enqueue(std::vector<std::vector<uint8_t>>& queue, void const * packet, uint32_t size)
+		{
+			++ num_packets_;
+			if ((drop_period_ == 0) || (num_packets_ % drop_period_ != 0))
+			{
+				uint8_t const * p = static_cast<uint8_t const *>(packet);
+				queue.emplace_back(p, p + size);
+			}
+		}
+
+		void Deliver(std::vector<std::vector<uint8_t>>& queue, NetChannel& to, double now)
+		{
+			if (num_pumps_ & 1)
+			{
+				std::reverse(queue.begin(), queue.end());
+			}
+			for (auto const & packet : queue)
+			{
+				EXPECT_TRUE(to.ReceivePacket(packet.data(), static_cast<uint32_t>(packet.size()), now));
+			}
+			queue.clear();
+		}
+
+	public:
+		NetChannel a;
+		NetChannel b;
+
+	private:
+		std::vector<std::vector<uint8_t>> a_to_b_;
+		std::vector<std::vector<uint8_t>> b_to_a_;
+		uint32_t drop_period_;
+		uint32_t num_packets_;
+		uint32_t num_pumps_;
+	};
+
+	std::vector<uint8_t> MakeMessage(uint32_t index)
+	{
+		// Up to 3 fragments
+		std::vector<uint8_t> msg(index * 7 % 3000 + sizeof(index));
+		std::memcpy(msg.data(), &index, sizeof(index));
+		for (size_t i = sizeof(index); i < msg.size(); ++ i)
+		{
+			msg[i] = static_cast<uint8_t>(index + i);
+		}
+		return msg;
+	}
+}
+
+TEST(NetChannelTest, ReliableInOrderUnderLoss)
+{
+	LossyLink link(4);
+
+	uint32_t const NUM_MESSAGES = 2000;
+	uint32_t num_sent = 0;
+	uint32_t num_received = 0;
+	std::vector<uint8_t> msg;
+	double now = 0;
+	for (uint32_t step = 0; (step < 100000) && (num_received < NUM_MESSAGES); ++ step)
+	{
+		while (num_sent < NUM_MESSAGES)
+		{
+			std::vector<uint8_t> const sent = MakeMessage(num_sent);
+			if (!link.a.Send(sent.data(), static_cast<uint32_t>(sent.size()), true))
+			{
+				break;
+			}
+			++ num_sent;
+		}
+
+		link.Pump(now);
+		now += 0.01;
+
+		while (link.b.Receive(msg))
+		{
+			ASSERT_EQ(msg, MakeMessage(num_received));
+			++ num_received;
+		}
+	}
+
+	EXPECT_EQ(num_received, NUM_MESSAGES);
+	EXPECT_GT(link.a.NumResent(), 0U);
+
+	// The last acks can be lost too
+	for (uint32_t step = 0; (step < 1000) && (link.a.NumUnacked() > 0); ++ step)
+	{
+		link.Pump(now);
+		now += 0.01;
+	}
+	EXPECT_EQ(link.a.NumUnacked(), 0U);
+}
+
+TEST(NetChannelTest, CoalesceMessages)
+{
+	LossyLink link(0);
+
+	uint8_t const data[20] = { 0 };
+	for (uint32_t i = 0; i < 10; ++ i)
+	{
+		EXPECT_TRUE(link.a.Send(data, sizeof(data), false));
+		EXPECT_TRUE(link.a.Send(data, sizeof(data), true));
+	}
+	link.Pump(0);
+
+	EXPECT_EQ(link.a.NumPacketsSent(), 1U);
+	EXPECT_EQ(link.b.NumDelivered(), 20U);
+}
+
+TEST(NetChannelTest, Backpressure)
+{
+	LossyLink link(0);
+
+	uint8_t const data[20] = { 0 };
+	uint32_t num_sent = 0;
+	while (link.a.Send(data, sizeof(data), true))
+	{
+		++ num_sent;
+	}
+	EXPECT_EQ(num_sent, NetChannel::SEND_WINDOW);
+
+	std::vector<uint8_t> too_big(link.a.Mtu());
+	EXPECT_FALSE(link.a.Send(too_big.data(), static_cast<uint32_t>(too_big.size()), false));
+
+	// Acks come back with the next packet from b
+	link.Pump(0);
+	link.Pump(0.01);
+	EXPECT_EQ(link.a.NumUnacked(), 0U);
+	EXPECT_TRUE(link.a.Send(data, sizeof(data), true));
+}
+
+TEST(NetChannelTest, RejectMalformedPackets)
+{
+	NetChannel channel([](void const * packet, uint32_t size)
+		{
+			KFL_UNUSED(packet);
+			KFL_UNUSED(size);
+		});
+
+	uint8_t const garbage[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+	EXPECT_FALSE(channel.ReceivePacket(garbage, sizeof(garbage), 0));
+	EXPECT_EQ(channel.NumPacketsReceived(), 0U);
+}
+
+// Loopback benchmark over real UDP sockets. The throughput and the mean latency go to the test report.
+TEST(NetChannelTest, LoopbackThroughput)
+{
+	Socket sockets[2];
+	sockaddr_in addrs[2];
+	for (uint32_t i = 0; i < 2; ++ i)
+	{
+		sockets[i].Create(SOCK_DGRAM);
+		sockets[i].Bind(TransAddr("127.0.0.1", 0));
+		socklen_t len = sizeof(addrs[i]);
+		sockets[i].SockName(addrs[i], len);
+		sockets[i].NonBlock(true);
+	}
+
+	NetChannel sender([&sockets, &addrs](void const * packet, uint32_t size)
+		{
+			sockets[0].SendTo(packet, static_cast<int>(size), addrs[1]);
+		});
+	NetChannel receiver([&sockets, &addrs](void const * packet, uint32_t size)
+		{
+			sockets[1].SendTo(packet, static_cast<int>(size), addrs[0]);
+		});
+
+	uint32_t const NUM_MESSAGES = 20000;
+	uint32_t const MESSAGE_SIZE = 100;
+
+	Timer timer;
+	uint32_t num_sent = 0;
+	uint32_t num_received = 0;
+	double total_latency = 0;
+	std::vector<uint8_t> msg(MESSAGE_SIZE);
+	std::vector<uint8_t> packet(NetChannel::DEFAULT_MTU);
+	sockaddr_in from;
+	while ((num_received < NUM_MESSAGES) && (timer.elapsed() < 10))
+	{
+		double const now = timer.elapsed();
+		while (num_sent < NUM_MESSAGES)
+		{
+			msg.resize(MESSAGE_SIZE);
+			std::memcpy(msg.data(), &now, sizeof(now));
+			if (!sender.Send(msg.data(), MESSAGE_SIZE, true))
+			{
+				break;
+			}
+			++ num_sent;
+		}
+		sender.Update(now);
+
+		int size;
+		while ((size = sockets[1].ReceiveFrom(packet.data(), static_cast<int>(packet.size()), from)) > 0)
+		{
+			receiver.ReceivePacket(packet.data(), size, timer.elapsed());
+		}
+		while (receiver.Receive(msg))
+		{
+			double send_time;
+			std::memcpy(&send_time, msg.data(), sizeof(send_time));
+			total_latency += timer.elapsed() - send_time;
+			++ num_received;
+		}
+		receiver.Update(timer.elapsed());
+
+		while ((size = sockets[0].ReceiveFrom(packet.data(), static_cast<int>(packet.size()), from)) > 0)
+		{
+			sender.ReceivePacket(packet.data(), size, timer.elapsed());
+		}
+	}
+	double const elapsed = timer.elapsed();
+
+	EXPECT_EQ(num_received, NUM_MESSAGES);
+	if (num_received > 0)
+	{
+		testing::Test::RecordProperty("messages_per_second", static_cast<int>(num_received / elapsed));
+		testing::Test::RecordProperty("mean_latency_us", static_cast<int>(total_latency / num_received * 1e6));
+		testing::Test::RecordProperty("packets_sent", static_cast<int>(sender.NumPacketsSent()));
+	}
+}
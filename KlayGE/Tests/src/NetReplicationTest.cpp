@@ -0,0 +1,264 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/SceneObject.hpp>
+#include <KlayGE/NetReplication.hpp>
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// A server and clients over an in-memory link, which loses snapshots and acks
+	class ReplicationLink
+	{
+	public:
+		ReplicationLink(uint32_t num_objects, uint32_t num_clients, uint32_t bytes_per_second, uint32_t loss_percent)
+			: clients_(num_clients), loss_percent_(loss_percent), rng_(1), num_bytes_(0)
+		{
+			for (uint32_t i = 0; i < num_objects; ++ i)
+			{
+				objects.push_back(MakeSharedPtr<SceneObject>(SceneObject::SOA_Moveable));
+				ids.push_back(server.Register(objects.back()));
+			}
+			for (auto& client : clients_)
+			{
+				client.index = server.AddClient(bytes_per_second);
+				client.replica = MakeUniquePtr<ReplicationClient>();
+				for (uint32_t i = 0; i < num_objects; ++ i)
+				{
+					client.objects.push_back(MakeSharedPtr<SceneObject>(SceneObject::SOA_Moveable));
+					client.replica->Bind(ids[i], client.objects.back());
+				}
+			}
+		}
+
+		// Returns the seconds spent encoding
+		double Tick(float elapsed_time)
+		{
+			Timer timer;
+			server.Capture();
+			for (auto& client : clients_)
+			{
+				server.WriteSnapshot(client.index, elapsed_time, 1200, client.snapshot);
+			}
+			double const encode_time = timer.elapsed();
+
+			for (auto& client : clients_)
+			{
+				num_bytes_ += client.snapshot.size();
+
+				// Acks of the last tick arrive now
+				for (auto const seq : client.acks)
+				{
+					server.OnAck(client.index, seq);
+				}
+				client.acks.clear();
+
+				uint16_t seq;
+				if (!this->Lost())
+				{
+					EXPECT_TRUE(client.replica->ReadSnapshot(client.snapshot.data(),
+						static_cast<uint32_t>(client.snapshot.size()), seq));
+					if (!this->Lost())
+					{
+						client.acks.push_back(seq);
+					}
+				}
+			}
+
+			return encode_time;
+		}
+
+		bool InSync(uint32_t client) const
+		{
+			for (uint32_t i = 0; i < objects.size(); ++ i)
+			{
+				float3 scale;
+				Quaternion rot;
+				float3 trans;
+				MathLib::decompose(scale, rot, trans, objects[i]->ModelMatrix());
+				QuantizedTransform const expected = QuantizeTransform(trans, rot, scale, 1.0f / 512);
+
+				QuantizedTransform received;
+				if (!clients_[client].replica->Transform(ids[i], received) || (received != expected))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		SceneObjectPtr const & ClientObject(uint32_t client, uint32_t index) const
+		{
+			return clients_[client].objects[index];
+		}
+
+		uint64_t NumBytes() const
+		{
+			return num_bytes_;
+		}
+
+	private:
+		bool Lost()
+		{
+			return std::uniform_int_distribution<uint32_t>(0, 99)(rng_) < loss_percent_;
+		}
+
+	public:
+		ReplicationServer server;
+		std::vector<SceneObjectPtr> objects;
+		std::vector<uint32_t> ids;
+
+	private:
+		struct Client
+		{
+			uint32_t index;
+			std::unique_ptr<ReplicationClient> replica;
+			std::vector<SceneObjectPtr> objects;
+			std::vector<uint8_t> snapshot;
+			std::vector<uint16_t> acks;
+		};
+		std::vector<Client> clients_;
+
+		uint32_t loss_percent_;
+		std::ranlux24_base rng_;
+		uint64_t num_bytes_;
+	};
+
+	void Move(SceneObject& so, std::ranlux24_base& rng)
+	{
+		std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+		float4x4 mat = so.ModelMatrix();
+		mat *= MathLib::rotation_y(step(rng));
+		mat *= MathLib::translation(step(rng), step(rng), step(rng));
+		so.ModelMatrix(mat);
+	}
+}
+
+TEST(NetReplicationTest, BitStreamRoundTrip)
+{
+	std::ranlux24_base rng(2);
+	std::vector<std::pair<uint32_t, uint32_t>> values;
+	BitWriter writer;
+	for (uint32_t i = 0; i < 1000; ++ i)
+	{
+		uint32_t const bits = std::uniform_int_distribution<uint32_t>(1, 32)(rng);
+		uint32_t const value = static_cast<uint32_t>((static_cast<uint64_t>(rng()) << 24 | rng()) & ((1ULL << bits) - 1));
+		values.emplace_back(value, bits);
+		writer.Write(value, bits);
+	}
+
+	// Written and rewound, it must leave no trace
+	uint32_t const mark = writer.NumBits();
+	writer.Write(0xFFFFFFFF, 29);
+	writer.Rewind(mark);
+	writer.Write(0, 3);
+
+	BitReader reader(writer.Bytes().data(), static_cast<uint32_t>(writer.Bytes().size()));
+	for (auto const & value : values)
+	{
+		EXPECT_EQ(reader.Read(value.second), value.first);
+	}
+	EXPECT_EQ(reader.Read(3), 0U);
+	EXPECT_FALSE(reader.Overflow());
+	reader.Read(32);
+	EXPECT_TRUE(reader.Overflow());
+}
+
+TEST(NetReplicationTest, SmallestThreeQuaternion)
+{
+	std::ranlux24_base rng(3);
+	std::uniform_real_distribution<float> dist(-1, 1);
+	for (uint32_t i = 0; i < 1000; ++ i)
+	{
+		Quaternion const q = MathLib::normalize(Quaternion(dist(rng), dist(rng), dist(rng), dist(rng)));
+		Quaternion const r = UnpackQuaternion(PackQuaternion(q));
+
+		// 10 bits per component is well under a degree
+		EXPECT_GT(std::abs(MathLib::dot(q, r)), 0.9999f);
+	}
+}
+
+TEST(NetReplicationTest, ConvergesUnderLoss)
+{
+	ReplicationLink link(500, 2, 8000, 20);
+
+	std::ranlux24_base rng(4);
+	for (uint32_t tick = 0; tick < 100; ++ tick)
+	{
+		for (auto& so : link.objects)
+		{
+			Move(*so, rng);
+		}
+		link.Tick(0.05f);
+	}
+	// Everything stops, the clients catch up
+	for (uint32_t tick = 0; (tick < 500) && !(link.InSync(0) && link.InSync(1)); ++ tick)
+	{
+		link.Tick(0.05f);
+	}
+	EXPECT_TRUE(link.InSync(0));
+	EXPECT_TRUE(link.InSync(1));
+
+	float3 const server_pos = MathLib::transform_coord(float3(0, 0, 0), link.objects[7]->ModelMatrix());
+	float3 const client_pos = MathLib::transform_coord(float3(0, 0, 0), link.ClientObject(1, 7)->ModelMatrix());
+	EXPECT_LT(MathLib::length(server_pos - client_pos), 1.0f / 512);
+
+	// Once the last acks are through, nothing but headers is sent
+	uint64_t bytes_per_tick = 0;
+	for (uint32_t tick = 0; tick < 100; ++ tick)
+	{
+		uint64_t const bytes = link.NumBytes();
+		link.Tick(0.05f);
+		bytes_per_tick = link.NumBytes() - bytes;
+		if (bytes_per_tick <= 2 * 3U)
+		{
+			break;
+		}
+	}
+	EXPECT_LE(bytes_per_tick, 2 * 3U);
+}
+
+// Benchmark. 10k objects, a tenth of them moving every tick, 4 clients with a 16KB/s budget each at 20Hz.
+//   The bandwidth per client and the encoding time go to the test report.
+TEST(NetReplicationTest, Replicate10kObjects)
+{
+	uint32_t const NUM_OBJECTS = 10000;
+	uint32_t const NUM_CLIENTS = 4;
+	uint32_t const NUM_TICKS = 200;
+	float const TICK_TIME = 0.05f;
+
+	ReplicationLink link(NUM_OBJECTS, NUM_CLIENTS, 16 * 1024, 5);
+
+	std::ranlux24_base rng(5);
+	for (uint32_t i = 0; i < NUM_OBJECTS; ++ i)
+	{
+		std::uniform_real_distribution<float> dist(-500, 500);
+		link.objects[i]->ModelMatrix(MathLib::translation(dist(rng), 0.0f, dist(rng)));
+	}
+
+	double encode_time = 0;
+	for (uint32_t tick = 0; tick < NUM_TICKS; ++ tick)
+	{
+		for (uint32_t i = tick % 10; i < NUM_OBJECTS; i += 10)
+		{
+			Move(*link.objects[i], rng);
+		}
+		encode_time += link.Tick(TICK_TIME);
+	}
+
+	double const seconds = NUM_TICKS * TICK_TIME;
+	double const bytes_per_client_per_second = link.NumBytes() / seconds / NUM_CLIENTS;
+	EXPECT_LE(bytes_per_client_per_second, 16 * 1024 * 1.05);
+
+	testing::Test::RecordProperty("bytes_per_client_per_second", static_cast<int>(bytes_per_client_per_second));
+	testing::Test::RecordProperty("encode_us_per_tick", static_cast<int>(encode_time / NUM_TICKS * 1e6));
+	// For comparison, 40 bytes per object for full transforms every tick
+	testing::Test::RecordProperty("full_bytes_per_client_per_second", static_cast<int>(NUM_OBJECTS * 40 / TICK_TIME));
+}
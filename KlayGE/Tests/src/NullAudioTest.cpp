@@ -0,0 +1,151 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/Audio.hpp>
+#include <KlayGE/AudioFactory.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// 16-bit mono sine wave, generated on the fly. Reads can be slowed down to stand in for a decoder.
+	class SineDataSource : public AudioDataSource
+	{
+	public:
+		SineDataSource(uint32_t freq, size_t size, std::chrono::milliseconds read_delay)
+			: size_(size), read_delay_(read_delay), pos_(0), num_reads_(0)
+		{
+			format_ = AF_Mono16;
+			freq_ = freq;
+		}
+
+		void Open(ResIdentifierPtr const & file) override
+		{
+			KFL_UNUSED(file);
+		}
+		void Close() override
+		{
+		}
+
+		size_t Size() override
+		{
+			return size_;
+		}
+
+		size_t Read(void* data, size_t size) override
+		{
+			if (read_delay_.count() > 0)
+			{
+				std::this_thread::sleep_for(read_delay_);
+			}
+			++ num_reads_;
+
+			size_t const pos = pos_;
+			size_t const n = std::min(size, size_ - pos) & ~static_cast<size_t>(1);
+			int16_t* samples = static_cast<int16_t*>(data);
+			for (size_t i = 0; i < n / 2; ++ i)
+			{
+				float const t = static_cast<float>(pos / 2 + i) / freq_;
+				samples[i] = static_cast<int16_t>(MathLib::sin(2 * PI * 440 * t) * 16000);
+			}
+			pos_ = pos + n;
+			return n;
+		}
+
+		void Reset() override
+		{
+			pos_ = 0;
+		}
+
+		size_t Pos() const
+		{
+			return pos_;
+		}
+		uint32_t NumReads() const
+		{
+			return num_reads_;
+		}
+
+	private:
+		size_t size_;
+		std::chrono::milliseconds read_delay_;
+		std::atomic<size_t> pos_;
+		std::atomic<uint32_t> num_reads_;
+	};
+
+	AudioFactory& NullAudioFactory()
+	{
+		Context& context = Context::Instance();
+		if (!context.AudioFactoryValid() || (context.AudioFactoryInstance().Name() != L"Null Audio Factory"))
+		{
+			context.LoadAudioFactory("NullAudio");
+		}
+		return context.AudioFactoryInstance();
+	}
+}
+
+// Half a second of music is streamed and mixed in real time, the buffer stops by itself at the end of the data
+TEST(NullAudioTest, MusicPlaysToTheEnd)
+{
+	AudioFactory& af = NullAudioFactory();
+
+	uint32_t const FREQ = 8000;
+	auto source = MakeSharedPtr<SineDataSource>(FREQ, FREQ * sizeof(int16_t) / 2, std::chrono::milliseconds(0));
+	AudioBufferPtr music = af.MakeMusicBuffer(source, 1);
+
+	music->Play(false);
+	auto const start = std::chrono::high_resolution_clock::now();
+	while (music->IsPlaying() && (std::chrono::high_resolution_clock::now() - start < std::chrono::seconds(5)))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	EXPECT_FALSE(music->IsPlaying());
+	EXPECT_EQ(source->Pos(), source->Size());
+}
+
+// Many looping streams share the streaming thread. Once Stop returns, the thread never touches the buffer again,
+//   even when the buffer is destroyed right away.
+TEST(NullAudioTest, StopEndsRefills)
+{
+	AudioFactory& af = NullAudioFactory();
+
+	uint32_t const NUM_STREAMS = 16;
+	uint32_t const FREQ = 8000;
+	std::vector<std::shared_ptr<SineDataSource>> sources(NUM_STREAMS);
+	std::vector<AudioBufferPtr> musics(NUM_STREAMS);
+	for (uint32_t i = 0; i < NUM_STREAMS; ++ i)
+	{
+		sources[i] = MakeSharedPtr<SineDataSource>(FREQ, FREQ * sizeof(int16_t) * 4, std::chrono::milliseconds(2));
+		musics[i] = af.MakeMusicBuffer(sources[i], 1);
+		musics[i]->Play(true);
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	std::vector<uint32_t> num_reads(NUM_STREAMS);
+	for (uint32_t i = 0; i < NUM_STREAMS; ++ i)
+	{
+		EXPECT_GT(sources[i]->NumReads(), 0U);
+
+		musics[i]->Stop();
+		num_reads[i] = sources[i]->NumReads();
+		musics[i].reset();
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	for (uint32_t i = 0; i < NUM_STREAMS; ++ i)
+	{
+		EXPECT_EQ(sources[i]->NumReads(), num_reads[i]);
+	}
+}
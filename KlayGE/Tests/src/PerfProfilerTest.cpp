@@ -0,0 +1,150 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/PerfProfiler.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	char const * scope_names[] = { "Even", "Odd" };
+
+	void RecordScopes(PerfProfiler& profiler, uint32_t num_scopes)
+	{
+		for (uint32_t i = 0; i < num_scopes; ++ i)
+		{
+			profiler.BeginScope(scope_names[i & 1]);
+			profiler.EndScope();
+		}
+	}
+}
+
+TEST(PerfProfilerTest, ScopeRing)
+{
+	PerfProfiler profiler;
+
+	profiler.BeginScope("Outer");
+	RecordScopes(profiler, 100);
+	profiler.EndScope();
+
+	std::vector<std::pair<uint32_t, PerfScopeEvent>> events;
+	profiler.CollectScopeEvents(events, 0);
+	ASSERT_EQ(events.size(), 101U);
+	for (uint32_t i = 0; i < 100; ++ i)
+	{
+		EXPECT_EQ(events[i].second.name, scope_names[i & 1]);
+		EXPECT_EQ(events[i].second.depth, 1U);
+		EXPECT_EQ(events[i].first, events[0].first);
+	}
+	EXPECT_STREQ(events[100].second.name, "Outer");
+	EXPECT_EQ(events[100].second.depth, 0U);
+	EXPECT_LE(events[100].second.begin_time, events[0].second.begin_time);
+}
+
+TEST(PerfProfilerTest, ScopeRingWrapAround)
+{
+	uint32_t const num_overwritten = 101;
+
+	PerfProfiler profiler;
+	RecordScopes(profiler, PerfProfiler::SCOPE_EVENT_CAPACITY + num_overwritten);
+
+	std::vector<std::pair<uint32_t, PerfScopeEvent>> events;
+	profiler.CollectScopeEvents(events, 0);
+
+	// A full ring also drops its oldest event, the one the owner could be overwriting
+	ASSERT_EQ(events.size(), PerfProfiler::SCOPE_EVENT_CAPACITY - 1);
+	for (size_t i = 0; i < events.size(); ++ i)
+	{
+		EXPECT_EQ(events[i].second.name, scope_names[(i + num_overwritten + 1) & 1]);
+		if (i > 0)
+		{
+			EXPECT_LE(events[i - 1].second.begin_time, events[i].second.begin_time);
+		}
+	}
+}
+
+TEST(PerfProfilerTest, ScopeRingExactlyFull)
+{
+	PerfProfiler profiler;
+	RecordScopes(profiler, PerfProfiler::SCOPE_EVENT_CAPACITY - 1);
+
+	std::vector<std::pair<uint32_t, PerfScopeEvent>> events;
+	profiler.CollectScopeEvents(events, 0);
+	EXPECT_EQ(events.size(), PerfProfiler::SCOPE_EVENT_CAPACITY - 1);
+
+	RecordScopes(profiler, 1);
+	events.clear();
+	profiler.CollectScopeEvents(events, 0);
+	EXPECT_EQ(events.size(), PerfProfiler::SCOPE_EVENT_CAPACITY - 1);
+	EXPECT_EQ(events[0].second.name, scope_names[1]);
+}
+
+TEST(PerfProfilerTest, ChromeTraceExport)
+{
+	ContextCfg cfg = Context::Instance().Config();
+	bool const perf_profiler = cfg.perf_profiler;
+	cfg.perf_profiler = true;
+	Context::Instance().Config(cfg);
+
+	// Past one second the timestamps have more than 6 significant digits
+	PerfProfiler profiler;
+	RecordScopes(profiler, 1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	RecordScopes(profiler, 2);
+
+	std::vector<std::pair<uint32_t, PerfScopeEvent>> events;
+	profiler.CollectScopeEvents(events, 0);
+	ASSERT_EQ(events.size(), 3U);
+
+	std::string const file_name = "PerfProfilerTest.json";
+	profiler.ExportToChromeTrace(file_name);
+
+	cfg.perf_profiler = perf_profiler;
+	Context::Instance().Config(cfg);
+
+	std::stringstream ss;
+	{
+		std::ifstream ifs(file_name.c_str());
+		ASSERT_TRUE(ifs);
+		ss << ifs.rdbuf();
+	}
+	std::remove(file_name.c_str());
+	std::string const trace = ss.str();
+
+	// Every time is in plain microseconds, with 3 decimals
+	std::regex const time_regex("\"(ts|dur)\":([^,}]*)");
+	std::regex const fixed_regex("[0-9]+\\.[0-9]{3}");
+	std::vector<double> scope_begins;
+	uint32_t num_times = 0;
+	for (std::sregex_iterator iter(trace.begin(), trace.end(), time_regex), end; iter != end; ++ iter)
+	{
+		std::string const value = (*iter)[2].str();
+		EXPECT_TRUE(std::regex_match(value, fixed_regex)) << value;
+		if ((*iter)[1].str() == "ts")
+		{
+			scope_begins.push_back(std::stod(value));
+		}
+		++ num_times;
+	}
+	EXPECT_EQ(num_times, 6U);
+
+	ASSERT_EQ(scope_begins.size(), events.size());
+	for (size_t i = 0; i < events.size(); ++ i)
+	{
+		EXPECT_NEAR(events[i].second.begin_time * 1e6, scope_begins[i], 0.001);
+	}
+	EXPECT_GT(scope_begins[1], 1e6);
+	EXPECT_NE(trace.find("\"name\":\"Even\""), std::string::npos);
+	EXPECT_NE(trace.find("\"name\":\"Odd\""), std::string::npos);
+}
@@ -0,0 +1,208 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/ElementFormat.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KlayGE/PostProcess.hpp>
+#include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/PrefilterCube.hpp>
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	float3 TestEnvironment(float3 const & dir)
+	{
+		return float3(std::max(dir.y(), 0.0f) * 2 + 0.1f, 0.5f + 0.4f * dir.x(), exp(3 * (dir.z() - 1)));
+	}
+
+	void BuildTestCube(uint32_t width, std::vector<Color>& texels)
+	{
+		texels.resize(6 * width * width);
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			for (uint32_t y = 0; y < width; ++ y)
+			{
+				for (uint32_t x = 0; x < width; ++ x)
+				{
+					float2 const xy((x + 0.5f) / width * 2 - 1, (y + 0.5f) / width * 2 - 1);
+					float3 dir;
+					switch (face)
+					{
+					case Texture::CF_Positive_X:
+						dir = float3(+1, -xy.y(), -xy.x());
+						break;
+
+					case Texture::CF_Negative_X:
+						dir = float3(-1, -xy.y(), +xy.x());
+						break;
+
+					case Texture::CF_Positive_Y:
+						dir = float3(+xy.x(), +1, +xy.y());
+						break;
+
+					case Texture::CF_Negative_Y:
+						dir = float3(+xy.x(), -1, -xy.y());
+						break;
+
+					case Texture::CF_Positive_Z:
+						dir = float3(+xy.x(), -xy.y(), +1);
+						break;
+
+					default:
+						dir = float3(-xy.x(), -xy.y(), -1);
+						break;
+					}
+
+					float3 const clr = TestEnvironment(MathLib::normalize(dir));
+					texels[(face * width + y) * width + x] = Color(clr.x(), clr.y(), clr.z(), 1);
+				}
+			}
+		}
+	}
+}
+
+TEST(PrefilterCubeTest, ConstantEnvironment)
+{
+	uint32_t const WIDTH = 32;
+	std::vector<float3> cube(6 * WIDTH * WIDTH, float3(0.5f, 0.25f, 1.0f));
+
+	std::vector<float3> spec;
+	PrefilterCubeMapSpecular(cube, WIDTH, 16, spec, WIDTH / 2);
+	std::vector<float3> diff;
+	PrefilterCubeMapDiffuse(cube, WIDTH, diff, WIDTH / 4);
+
+	for (auto const & clr : spec)
+	{
+		EXPECT_NEAR(clr.x(), 0.5f, 1e-3f);
+		EXPECT_NEAR(clr.y(), 0.25f, 1e-3f);
+		EXPECT_NEAR(clr.z(), 1.0f, 1e-3f);
+	}
+	for (auto const & clr : diff)
+	{
+		EXPECT_NEAR(clr.x(), 0.5f, 1e-3f);
+		EXPECT_NEAR(clr.y(), 0.25f, 1e-3f);
+		EXPECT_NEAR(clr.z(), 1.0f, 1e-3f);
+	}
+}
+
+// sRGB 188 is linear 0.5. The whole chain is linear, so a constant sRGB cube has to stay 0.5 on every level.
+TEST(PrefilterCubeTest, SRGBInputLinearized)
+{
+	uint32_t const WIDTH = 16;
+	std::vector<uint32_t> texels(6 * WIDTH * WIDTH, 0xFFBCBCBC);
+	std::vector<ElementInitData> init_data(6);
+	for (uint32_t face = 0; face < 6; ++ face)
+	{
+		init_data[face].data = &texels[face * WIDTH * WIDTH];
+		init_data[face].row_pitch = WIDTH * sizeof(texels[0]);
+		init_data[face].slice_pitch = WIDTH * WIDTH * sizeof(texels[0]);
+	}
+
+	uint32_t num_mipmaps;
+	std::vector<ElementInitData> out_data;
+	std::vector<uint8_t> out_data_block;
+	PrefilterCubeMap(WIDTH, 1, EF_ABGR8_SRGB, init_data, num_mipmaps, out_data, out_data_block);
+
+	for (auto const & level : out_data)
+	{
+		Color clr;
+		ConvertToABGR32F(EF_ABGR16F, level.data, 1, &clr);
+		EXPECT_NEAR(clr.r(), 0.5f, 0.01f);
+		EXPECT_NEAR(clr.g(), 0.5f, 0.01f);
+		EXPECT_NEAR(clr.b(), 0.5f, 0.01f);
+	}
+}
+
+// Runs the GPU post processes of the PrefilterCube tool and the CPU path on the same cube, and compares every level
+TEST_F(KlayGETest, PrefilterCubeCPUMatchesGPU)
+{
+	ResLoader::Instance().AddPath("../../Tools/media/PrefilterCube");
+
+	uint32_t const WIDTH = 64;
+	std::vector<Color> texels;
+	BuildTestCube(WIDTH, texels);
+
+	std::vector<ElementInitData> init_data(6);
+	for (uint32_t face = 0; face < 6; ++ face)
+	{
+		init_data[face].data = &texels[face * WIDTH * WIDTH];
+		init_data[face].row_pitch = WIDTH * sizeof(Color);
+		init_data[face].slice_pitch = WIDTH * WIDTH * sizeof(Color);
+	}
+
+	uint32_t num_mipmaps;
+	std::vector<ElementInitData> cpu_data;
+	std::vector<uint8_t> cpu_data_block;
+	PrefilterCubeMap(WIDTH, 1, EF_ABGR32F, init_data, num_mipmaps, cpu_data, cpu_data_block);
+
+	RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+	TexturePtr in_tex = rf.MakeTextureCube(WIDTH, 1, 1, EF_ABGR32F, 1, 0, EAH_GPU_Read | EAH_Immutable, init_data);
+	TexturePtr gpu_tex = rf.MakeTextureCube(WIDTH, num_mipmaps, 1, EF_ABGR16F, 1, 0, EAH_GPU_Write);
+
+	PostProcessPtr diff_pp = SyncLoadPostProcess("PrefilterCube.ppml", "PrefilterCubeDiffuse");
+	PostProcessPtr spec_pp = SyncLoadPostProcess("PrefilterCube.ppml", "PrefilterCubeSpecular");
+	diff_pp->InputPin(0, in_tex);
+	spec_pp->InputPin(0, in_tex);
+	for (int face = 0; face < 6; ++ face)
+	{
+		for (uint32_t level = 1; level < num_mipmaps - 1; ++ level)
+		{
+			float shininess = Glossiness2Shininess(static_cast<float>(num_mipmaps - 2 - level) / (num_mipmaps - 2));
+
+			spec_pp->OutputPin(0, gpu_tex, level, 0, face);
+			spec_pp->SetParam(0, face);
+			spec_pp->SetParam(1, shininess);
+			spec_pp->Apply();
+		}
+
+		diff_pp->OutputPin(0, gpu_tex, num_mipmaps - 1, 0, face);
+		diff_pp->SetParam(0, face);
+		diff_pp->Apply();
+	}
+
+	TexturePtr gpu_cpu_tex = rf.MakeTextureCube(WIDTH, num_mipmaps, 1, EF_ABGR16F, 1, 0, EAH_CPU_Read);
+	gpu_tex->CopyToTexture(*gpu_cpu_tex);
+
+	// Edges differ a little, the GPU filters across cube faces. The diffuse level is SH9 on CPU and 1024 samples on GPU.
+	float const tolerance = 0.05f;
+	for (uint32_t face = 0; face < 6; ++ face)
+	{
+		for (uint32_t level = 1; level < num_mipmaps; ++ level)
+		{
+			uint32_t const level_width = gpu_cpu_tex->Width(level);
+			ElementInitData const & cpu_level = cpu_data[face * num_mipmaps + level];
+
+			Texture::Mapper mapper(*gpu_cpu_tex, 0, static_cast<Texture::CubeFaces>(face), level, TMA_Read_Only,
+				0, 0, level_width, level_width);
+			uint8_t const * gpu_p = mapper.Pointer<uint8_t>();
+
+			uint32_t num_mismatches = 0;
+			std::vector<Color> gpu_row(level_width);
+			std::vector<Color> cpu_row(level_width);
+			for (uint32_t y = 0; y < level_width; ++ y)
+			{
+				ConvertToABGR32F(EF_ABGR16F, gpu_p + y * mapper.RowPitch(), level_width, &gpu_row[0]);
+				ConvertToABGR32F(EF_ABGR16F, static_cast<uint8_t const *>(cpu_level.data) + y * cpu_level.row_pitch,
+					level_width, &cpu_row[0]);
+				for (uint32_t x = 0; x < level_width; ++ x)
+				{
+					if ((abs(gpu_row[x].r() - cpu_row[x].r()) > tolerance) || (abs(gpu_row[x].g() - cpu_row[x].g()) > tolerance)
+						|| (abs(gpu_row[x].b() - cpu_row[x].b()) > tolerance))
+					{
+						++ num_mismatches;
+					}
+				}
+			}
+
+			EXPECT_LE(num_mismatches, level_width) << "face " << face << ", level " << level;
+		}
+	}
+}
@@ -1,6 +1,8 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/SIMDMath.hpp>
+#include <KFL/SIMDBatch.hpp>
+#include <KFL/Timer.hpp>
 
 #include <gtest/gtest.h>
 
@@ -11,6 +13,31 @@
 using namespace std;
 using namespace KlayGE;
 
+namespace
+{
+	float RandomFloat(uint32_t& seed)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return static_cast<float>(seed >> 8) / (1 << 24) * 2 - 1;
+	}
+
+	float4x4 RandomMatrix(uint32_t& seed)
+	{
+		float4x4 ret;
+		for (size_t i = 0; i < ret.size(); ++ i)
+		{
+			ret[i] = RandomFloat(seed);
+		}
+		return ret;
+	}
+
+	void PrintTiming(char const * name, double scalar_time, double simd_time)
+	{
+		cout << name << ": scalar " << scalar_time * 1000 << " ms, SIMD " << simd_time * 1000 << " ms, "
+			<< scalar_time / simd_time << "x" << endl;
+	}
+}
+
 TEST(SIMDMathTest, NormalizeVector2)
 {
 	SIMDVectorF4 v = SIMDMathLib::SetVector(1, 2, 0, 0);
@@ -31,3 +58,217 @@ TEST(SIMDMathTest, NormalizeVector4)
 	v = SIMDMathLib::NormalizeVector4(v);
 	EXPECT_LT(MathLib::abs(SIMDMathLib::GetX(SIMDMathLib::LengthVector4(v)) - 1.0f), 1e-3f);
 }
+
+TEST(SIMDMathTest, MultiplyMatrix)
+{
+	uint32_t seed = 1;
+	std::vector<float4x4> mats(1024);
+	for (auto& mat : mats)
+	{
+		mat = RandomMatrix(seed);
+	}
+
+	std::vector<float4x4> scalar(mats.size() - 1);
+	std::vector<float4x4> simd(mats.size() - 1);
+
+	int const ITERATIONS = 200;
+	Timer timer;
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < scalar.size(); ++ i)
+		{
+			scalar[i] = mats[i] * mats[i + 1];
+		}
+	}
+	double const scalar_time = timer.elapsed();
+
+	timer.restart();
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < simd.size(); ++ i)
+		{
+			simd[i] = SIMDMathLib::Multiply(mats[i], mats[i + 1]);
+		}
+	}
+	double const simd_time = timer.elapsed();
+
+	for (size_t i = 0; i < scalar.size(); ++ i)
+	{
+		for (size_t j = 0; j < scalar[i].size(); ++ j)
+		{
+			EXPECT_NEAR(scalar[i][j], simd[i][j], 1e-5f * std::max(1.0f, MathLib::abs(scalar[i][j])));
+		}
+	}
+
+	PrintTiming("Matrix multiply", scalar_time, simd_time);
+}
+
+TEST(SIMDMathTest, TransformCoordBatch)
+{
+	uint32_t seed = 2;
+	float4x4 const mat = MathLib::look_at_lh(float3(1, 2, -50), float3(0, 0, 0)) * MathLib::perspective_fov_lh(1.0f, 1.5f, 0.1f, 100.0f);
+	std::vector<float3> pos(10003);
+	for (auto& p : pos)
+	{
+		p = float3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)) * 10.0f;
+	}
+
+	std::vector<float3> scalar(pos.size());
+	std::vector<float3> simd(pos.size());
+
+	int const ITERATIONS = 20;
+	Timer timer;
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < pos.size(); ++ i)
+		{
+			scalar[i] = MathLib::transform_coord(pos[i], mat);
+		}
+	}
+	double const scalar_time = timer.elapsed();
+
+	timer.restart();
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		SIMDMathLib::TransformCoordVector3(&simd[0], &pos[0], pos.size(), mat);
+	}
+	double const simd_time = timer.elapsed();
+
+	// The compiler may contract the scalar code to FMA, which changes the last bits
+	for (size_t i = 0; i < pos.size(); ++ i)
+	{
+		EXPECT_NEAR(scalar[i].x(), simd[i].x(), 1e-5f * std::max(1.0f, MathLib::abs(scalar[i].x())));
+		EXPECT_NEAR(scalar[i].y(), simd[i].y(), 1e-5f * std::max(1.0f, MathLib::abs(scalar[i].y())));
+		EXPECT_NEAR(scalar[i].z(), simd[i].z(), 1e-5f * std::max(1.0f, MathLib::abs(scalar[i].z())));
+	}
+
+	SIMDMathLib::TransformNormalVector3(&simd[0], &pos[0], pos.size(), mat);
+	for (size_t i = 0; i < pos.size(); ++ i)
+	{
+		float3 const n = MathLib::transform_normal(pos[i], mat);
+		EXPECT_NEAR(n.x(), simd[i].x(), 1e-5f * std::max(1.0f, MathLib::abs(n.x())));
+		EXPECT_NEAR(n.y(), simd[i].y(), 1e-5f * std::max(1.0f, MathLib::abs(n.y())));
+		EXPECT_NEAR(n.z(), simd[i].z(), 1e-5f * std::max(1.0f, MathLib::abs(n.z())));
+	}
+
+	PrintTiming("Batch transform_coord", scalar_time, simd_time);
+}
+
+TEST(SIMDMathTest, MultiplyQuat)
+{
+	uint32_t seed = 3;
+	for (int i = 0; i < 1000; ++ i)
+	{
+		Quaternion const lhs = MathLib::normalize(Quaternion(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)));
+		Quaternion const rhs = MathLib::normalize(Quaternion(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)));
+
+		Quaternion const scalar = lhs * rhs;
+		Quaternion simd;
+		SIMDMathLib::StoreQuaternion(simd, SIMDMathLib::MultiplyQuat(SIMDMathLib::LoadQuaternion(lhs), SIMDMathLib::LoadQuaternion(rhs)));
+		for (int j = 0; j < 4; ++ j)
+		{
+			EXPECT_NEAR(scalar[j], simd[j], 1e-6f);
+		}
+
+		Quaternion conj;
+		SIMDMathLib::StoreQuaternion(conj, SIMDMathLib::Conjugate(SIMDMathLib::LoadQuaternion(lhs)));
+		EXPECT_TRUE(conj == MathLib::conjugate(lhs));
+	}
+}
+
+TEST(SIMDMathTest, IntersectAABBFrustum)
+{
+	uint32_t seed = 4;
+	Frustum frustum;
+	float4x4 const view_proj = MathLib::look_at_lh(float3(0, 0, -10), float3(0, 0, 0)) * MathLib::perspective_fov_lh(0.8f, 1.3f, 1.0f, 50.0f);
+	frustum.ClipMatrix(view_proj, MathLib::inverse(view_proj));
+
+	std::vector<AABBox> boxes(10000);
+	for (auto& box : boxes)
+	{
+		float3 const center(RandomFloat(seed) * 40, RandomFloat(seed) * 40, RandomFloat(seed) * 40);
+		float3 const extent(MathLib::abs(RandomFloat(seed)) * 4, MathLib::abs(RandomFloat(seed)) * 4, MathLib::abs(RandomFloat(seed)) * 4);
+		box = AABBox(center - extent, center + extent);
+	}
+
+	std::vector<BoundOverlap> scalar(boxes.size());
+	std::vector<BoundOverlap> simd(boxes.size());
+
+	int const ITERATIONS = 20;
+	Timer timer;
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < boxes.size(); ++ i)
+		{
+			scalar[i] = MathLib::intersect_aabb_frustum(boxes[i], frustum);
+		}
+	}
+	double const scalar_time = timer.elapsed();
+
+	timer.restart();
+	SIMDFrustum const simd_frustum(frustum);
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < boxes.size(); ++ i)
+		{
+			simd[i] = simd_frustum.Intersect(boxes[i]);
+		}
+	}
+	double const simd_time = timer.elapsed();
+
+	for (size_t i = 0; i < boxes.size(); ++ i)
+	{
+		EXPECT_EQ(scalar[i], simd[i]);
+		EXPECT_EQ(scalar[i], SIMDMathLib::IntersectAABBFrustum(boxes[i], simd_frustum));
+	}
+
+	PrintTiming("AABB-frustum", scalar_time, simd_time);
+}
+
+TEST(SIMDMathTest, TransformAABBs)
+{
+	uint32_t seed = 5;
+	std::vector<AABBox> boxes(10000);
+	std::vector<float4x4> mats(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++ i)
+	{
+		float3 const center(RandomFloat(seed) * 40, RandomFloat(seed) * 40, RandomFloat(seed) * 40);
+		float3 const extent(MathLib::abs(RandomFloat(seed)) * 4, MathLib::abs(RandomFloat(seed)) * 4, MathLib::abs(RandomFloat(seed)) * 4);
+		boxes[i] = AABBox(center - extent, center + extent);
+		mats[i] = MathLib::scaling(1 + MathLib::abs(RandomFloat(seed)), 1 + MathLib::abs(RandomFloat(seed)), 1.0f)
+			* MathLib::rotation(RandomFloat(seed) * PI, RandomFloat(seed), RandomFloat(seed), 1.0f)
+			* MathLib::translation(RandomFloat(seed) * 100, RandomFloat(seed) * 100, RandomFloat(seed) * 100);
+	}
+
+	std::vector<AABBox> scalar(boxes.size());
+	std::vector<AABBox> simd(boxes.size());
+
+	int const ITERATIONS = 20;
+	Timer timer;
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < boxes.size(); ++ i)
+		{
+			scalar[i] = MathLib::transform_aabb(boxes[i], mats[i]);
+		}
+	}
+	double const scalar_time = timer.elapsed();
+
+	timer.restart();
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		SIMDMathLib::TransformAABBs(&simd[0], boxes, mats);
+	}
+	double const simd_time = timer.elapsed();
+
+	for (size_t i = 0; i < boxes.size(); ++ i)
+	{
+		for (int j = 0; j < 3; ++ j)
+		{
+			EXPECT_NEAR(scalar[i].Min()[j], simd[i].Min()[j], 1e-4f * std::max(1.0f, MathLib::abs(scalar[i].Min()[j])));
+			EXPECT_NEAR(scalar[i].Max()[j], simd[i].Max()[j], 1e-4f * std::max(1.0f, MathLib::abs(scalar[i].Max()[j])));
+		}
+	}
+
+	PrintTiming("transform_aabb", scalar_time, simd_time);
+}
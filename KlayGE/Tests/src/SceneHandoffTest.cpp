@@ -0,0 +1,194 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/SceneObject.hpp>
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+TEST(SceneHandoffTest, TripleBufferIndex)
+{
+	triple_buffer_index index;
+	EXPECT_NE(index.write_index(), index.read_index());
+
+	EXPECT_FALSE(index.acquire());
+	uint32_t const first_read = index.read_index();
+
+	uint32_t const slot_a = index.write_index();
+	EXPECT_FALSE(index.publish());
+	EXPECT_NE(slot_a, index.write_index());
+	EXPECT_NE(first_read, index.write_index());
+
+	EXPECT_TRUE(index.acquire());
+	EXPECT_EQ(slot_a, index.read_index());
+	EXPECT_FALSE(index.acquire());
+	EXPECT_EQ(slot_a, index.read_index());
+
+	// The second publication replaces the third before it's acquired
+	uint32_t const slot_b = index.write_index();
+	EXPECT_FALSE(index.publish());
+	uint32_t const slot_c = index.write_index();
+	EXPECT_TRUE(index.publish());
+	EXPECT_NE(slot_a, slot_c);
+	EXPECT_TRUE(index.acquire());
+	EXPECT_EQ(slot_c, index.read_index());
+	EXPECT_NE(slot_b, index.read_index());
+}
+
+TEST(SceneHandoffTest, TripleBufferIndexThreads)
+{
+	uint32_t const num_values = 200000;
+
+	// Every value fills its slot, so a slot shared by both sides shows up as a torn one
+	struct Slot
+	{
+		uint32_t seq;
+		std::array<uint32_t, 15> data;
+	};
+	std::array<Slot, 3> slots;
+	for (auto& slot : slots)
+	{
+		slot.seq = 0;
+		slot.data.fill(0);
+	}
+
+	triple_buffer_index index;
+	std::atomic<bool> done(false);
+	uint32_t num_dropped = 0;
+	std::thread producer([&]
+		{
+			for (uint32_t i = 1; i <= num_values; ++ i)
+			{
+				Slot& slot = slots[index.write_index()];
+				slot.seq = i;
+				slot.data.fill(i);
+				num_dropped += index.publish();
+			}
+			done = true;
+		});
+
+	uint32_t last_seq = 0;
+	uint32_t num_acquired = 0;
+	uint32_t num_torn = 0;
+	uint32_t num_backward = 0;
+	for (;;)
+	{
+		bool const finished = done;
+		if (index.acquire())
+		{
+			Slot const & slot = slots[index.read_index()];
+			for (auto d : slot.data)
+			{
+				num_torn += (d != slot.seq);
+			}
+			num_backward += (slot.seq <= last_seq);
+			last_seq = slot.seq;
+			++ num_acquired;
+		}
+		else if (finished)
+		{
+			break;
+		}
+	}
+	producer.join();
+
+	EXPECT_EQ(0U, num_torn);
+	EXPECT_EQ(0U, num_backward);
+	EXPECT_EQ(num_values, last_seq);
+	EXPECT_EQ(num_values, num_acquired + num_dropped);
+	testing::Test::RecordProperty("AcquiredValues", static_cast<int>(num_acquired));
+	testing::Test::RecordProperty("DroppedValues", static_cast<int>(num_dropped));
+}
+
+TEST(SceneHandoffTest, SceneObjectModelHandoff)
+{
+	SceneObject obj(SceneObject::SOA_Moveable);
+	obj.BindSubThreadUpdateFunc([](SceneObject& so, float app_time, float /*elapsed_time*/)
+		{
+			so.ModelMatrix(so.ModelMatrix() * MathLib::translation(app_time, 0.0f, 0.0f));
+		});
+
+	triple_buffer_index index;
+
+	// The sub thread builds on its own copy, the main thread doesn't see it until acquiring
+	obj.SubThreadUpdateAndPublish(1, index.write_index(), 1, 0);
+	index.publish();
+	obj.SubThreadUpdateAndPublish(2, index.write_index(), 2, 0);
+	EXPECT_EQ(float4x4::Identity(), obj.ModelMatrix());
+
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(1.0f, 0.0f, 0.0f), obj.ModelMatrix());
+
+	index.publish();
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(3.0f, 0.0f, 0.0f), obj.ModelMatrix());
+
+	// A matrix set by the main thread stays, until the sub thread writes a newer one
+	obj.ModelMatrix(MathLib::translation(0.0f, 5.0f, 0.0f));
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(0.0f, 5.0f, 0.0f), obj.ModelMatrix());
+
+	obj.BindSubThreadUpdateFunc(std::function<void(SceneObject&, float, float)>());
+	obj.SubThreadUpdateAndPublish(3, index.write_index(), 3, 0);
+	index.publish();
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(0.0f, 5.0f, 0.0f), obj.ModelMatrix());
+
+	obj.BindSubThreadUpdateFunc([](SceneObject& so, float /*app_time*/, float /*elapsed_time*/)
+		{
+			so.ModelMatrix(MathLib::translation(0.0f, 0.0f, 7.0f));
+		});
+	obj.SubThreadUpdateAndPublish(4, index.write_index(), 4, 0);
+	index.publish();
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(0.0f, 0.0f, 7.0f), obj.ModelMatrix());
+}
+
+TEST(SceneHandoffTest, MainThreadSetThenSubThreadRelativeUpdate)
+{
+	SceneObject obj(SceneObject::SOA_Moveable);
+	obj.BindSubThreadUpdateFunc([](SceneObject& so, float app_time, float /*elapsed_time*/)
+		{
+			so.ModelMatrix(so.ModelMatrix() * MathLib::translation(app_time, 0.0f, 0.0f));
+		});
+
+	triple_buffer_index index;
+
+	obj.SubThreadUpdateAndPublish(1, index.write_index(), 1, 0);
+	index.publish();
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(1.0f, 0.0f, 0.0f), obj.ModelMatrix());
+
+	// A sweep running while the main thread sets the matrix is built on the old one, and is dropped
+	obj.SubThreadUpdateAndPublish(2, index.write_index(), 2, 0);
+	obj.ModelMatrix(MathLib::translation(0.0f, 5.0f, 0.0f));
+	index.publish();
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(0.0f, 5.0f, 0.0f), obj.ModelMatrix());
+
+	// The next sweep moves on from what the main thread set
+	obj.SubThreadUpdateAndPublish(3, index.write_index(), 1, 0);
+	index.publish();
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(1.0f, 5.0f, 0.0f), obj.ModelMatrix());
+
+	obj.SubThreadUpdateAndPublish(4, index.write_index(), 2, 0);
+	index.publish();
+	index.acquire();
+	obj.AcquireSubThreadState(index.read_index());
+	EXPECT_EQ(MathLib::translation(3.0f, 5.0f, 0.0f), obj.ModelMatrix());
+}
@@ -0,0 +1,568 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderLayout.hpp>
+#include <KlayGE/Renderable.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KlayGE/SceneQuery.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <iostream>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	float RandomFloat(uint32_t& seed)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return static_cast<float>(seed >> 8) / (1 << 24) * 2 - 1;
+	}
+
+	float3 RandomFloat3(uint32_t& seed, float scale)
+	{
+		float const x = RandomFloat(seed) * scale;
+		float const y = RandomFloat(seed) * scale;
+		float const z = RandomFloat(seed) * scale;
+		return float3(x, y, z);
+	}
+
+	void MakeSphere(uint32_t rings, uint32_t segments, std::vector<float3>& positions, std::vector<uint32_t>& indices)
+	{
+		positions.clear();
+		indices.clear();
+		for (uint32_t r = 0; r <= rings; ++ r)
+		{
+			float const theta = PI * r / rings;
+			for (uint32_t s = 0; s <= segments; ++ s)
+			{
+				float const phi = 2 * PI * s / segments;
+				positions.push_back(float3(MathLib::sin(theta) * MathLib::cos(phi), MathLib::cos(theta),
+					MathLib::sin(theta) * MathLib::sin(phi)));
+			}
+		}
+		for (uint32_t r = 0; r < rings; ++ r)
+		{
+			for (uint32_t s = 0; s < segments; ++ s)
+			{
+				uint32_t const i0 = r * (segments + 1) + s;
+				uint32_t const i1 = i0 + segments + 1;
+				indices.insert(indices.end(), { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 });
+			}
+		}
+	}
+
+	// Moller-Trumbore, the same tests as TriangleBVH
+	bool RayTriangle(float3 const & orig, float3 const & dir, float3 const & v0, float3 const & v1, float3 const & v2,
+		float& t)
+	{
+		float3 const e1 = v1 - v0;
+		float3 const e2 = v2 - v0;
+		float3 const p = MathLib::cross(dir, e2);
+		float const det = MathLib::dot(e1, p);
+		if (MathLib::abs(det) <= 1e-20f)
+		{
+			return false;
+		}
+		float const inv_det = 1 / det;
+		float3 const tv = orig - v0;
+		float const u = MathLib::dot(tv, p) * inv_det;
+		float3 const q = MathLib::cross(tv, e1);
+		float const v = MathLib::dot(dir, q) * inv_det;
+		t = MathLib::dot(e2, q) * inv_det;
+		return (u >= 0) && (v >= 0) && (u + v <= 1) && (t >= 0);
+	}
+
+	float BruteForce(std::vector<float3> const & positions, std::vector<uint32_t> const & indices,
+		float3 const & orig, float3 const & dir, float max_dist)
+	{
+		float closest = max_dist;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			float t;
+			if (RayTriangle(orig, dir, positions[indices[i + 0]], positions[indices[i + 1]], positions[indices[i + 2]], t)
+				&& (t < closest))
+			{
+				closest = t;
+			}
+		}
+		return closest;
+	}
+
+	struct TestInstance
+	{
+		float4x4 model;
+		bool has_mesh;
+	};
+
+	float4x4 RandomTransform(uint32_t& seed, float range)
+	{
+		float const scale = 0.5f + MathLib::abs(RandomFloat(seed)) * 2;
+		float3 const pos = RandomFloat3(seed, range);
+		return MathLib::scaling(scale, scale, scale)
+			* MathLib::rotation(RandomFloat(seed) * PI, RandomFloat(seed), RandomFloat(seed), 1.0f)
+			* MathLib::translation(pos);
+	}
+
+	float BruteForceScene(std::vector<TestInstance> const & instances, std::vector<float3> const & positions,
+		std::vector<uint32_t> const & indices, AABBox const & mesh_bound, SceneRay const & ray, uint32_t& instance)
+	{
+		float closest = ray.max_dist;
+		instance = SceneRayHit::INVALID_INDEX;
+		for (uint32_t i = 0; i < instances.size(); ++ i)
+		{
+			AABBox const bound_ws = MathLib::transform_aabb(mesh_bound, instances[i].model);
+			float t;
+			if (instances[i].has_mesh)
+			{
+				float4x4 const inv_model = MathLib::inverse(instances[i].model);
+				t = BruteForce(positions, indices, MathLib::transform_coord(ray.orig, inv_model),
+					MathLib::transform_normal(ray.dir, inv_model), closest);
+			}
+			else
+			{
+				// The slab test, from the ray origin
+				float t0 = 0;
+				float t1 = closest;
+				for (int c = 0; c < 3; ++ c)
+				{
+					float const inv = 1 / ray.dir[c];
+					float const ta = (bound_ws.Min()[c] - ray.orig[c]) * inv;
+					float const tb = (bound_ws.Max()[c] - ray.orig[c]) * inv;
+					t0 = std::max(t0, std::min(ta, tb));
+					t1 = std::min(t1, std::max(ta, tb));
+				}
+				t = (t0 <= t1) ? t0 : closest;
+			}
+			if (t < closest)
+			{
+				closest = t;
+				instance = i;
+			}
+		}
+		return closest;
+	}
+
+	// A unit quad on z = 0, with or without the triangles for ray casts
+	class QuadRenderable : public Renderable
+	{
+	public:
+		explicit QuadRenderable(bool ray_cast_bvh)
+			: pos_aabb_(float3(-1, -1, 0), float3(1, 1, 0)), tc_aabb_(float3(0, 0, 0), float3(1, 1, 0))
+		{
+			rl_ = Context::Instance().RenderFactoryInstance().MakeRenderLayout();
+			rl_->TopologyType(RenderLayout::TT_TriangleList);
+
+			if (ray_cast_bvh)
+			{
+				float3 const positions[] = { float3(-1, -1, 0), float3(+1, -1, 0), float3(-1, +1, 0), float3(+1, +1, 0) };
+				uint32_t const indices[] = { 0, 2, 1, 1, 2, 3 };
+				bvh_ = MakeSharedPtr<TriangleBVH>(positions, indices);
+			}
+
+			this->Pass(PT_OpaqueGBufferMRT);
+		}
+
+		RenderLayout& GetRenderLayout() const override
+		{
+			return *rl_;
+		}
+
+		std::wstring const & Name() const override
+		{
+			static std::wstring const name(L"QuadRenderable");
+			return name;
+		}
+
+		AABBox const & PosBound() const override
+		{
+			return pos_aabb_;
+		}
+
+		AABBox const & TexcoordBound() const override
+		{
+			return tc_aabb_;
+		}
+
+		TriangleBVHPtr RayCastBVH() const override
+		{
+			return bvh_;
+		}
+
+		void Render() override
+		{
+		}
+
+	private:
+		RenderLayoutPtr rl_;
+		AABBox pos_aabb_;
+		AABBox tc_aabb_;
+		TriangleBVHPtr bvh_;
+	};
+}
+
+TEST(SceneQueryTest, TriangleBVHMatchesBruteForce)
+{
+	uint32_t seed = 1;
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	for (uint32_t i = 0; i < 2000; ++ i)
+	{
+		float3 const center = RandomFloat3(seed, 10);
+		for (uint32_t j = 0; j < 3; ++ j)
+		{
+			indices.push_back(static_cast<uint32_t>(positions.size()));
+			positions.push_back(center + RandomFloat3(seed, 1));
+		}
+	}
+
+	TriangleBVH bvh(positions, indices);
+	EXPECT_EQ(bvh.NumTriangles(), 2000U);
+	EXPECT_GT(bvh.NumNodes(), 2000U / 4);
+
+	for (uint32_t i = 0; i < 1000; i += 4)
+	{
+		TriangleBVH::RayPacket packet;
+		TriangleBVH::Hit hits[4];
+		float expected[4];
+		for (uint32_t lane = 0; lane < 4; ++ lane)
+		{
+			float3 const orig = RandomFloat3(seed, 20);
+			float3 const dir = RandomFloat3(seed, 10) - orig;
+
+			expected[lane] = BruteForce(positions, indices, orig, dir, 1e10f);
+
+			TriangleBVH::Hit hit = { 1e10f, SceneRayHit::INVALID_INDEX, 0, 0 };
+			bool const found = bvh.RayCast(orig, dir, hit);
+			EXPECT_EQ(expected[lane] < 1e10f, found);
+			EXPECT_NEAR(expected[lane], hit.dist, 1e-5f);
+			if (found)
+			{
+				float t;
+				EXPECT_TRUE(RayTriangle(orig, dir, positions[indices[hit.triangle * 3 + 0]],
+					positions[indices[hit.triangle * 3 + 1]], positions[indices[hit.triangle * 3 + 2]], t));
+				EXPECT_NEAR(hit.dist, t, 1e-5f);
+			}
+
+			for (int c = 0; c < 3; ++ c)
+			{
+				packet.orig[c][lane] = orig[c];
+				packet.dir[c][lane] = dir[c];
+				packet.inv_dir[c][lane] = 1 / dir[c];
+			}
+			hits[lane].dist = 1e10f;
+			hits[lane].triangle = SceneRayHit::INVALID_INDEX;
+		}
+
+		// Lane 2 is inactive
+		uint32_t const hit_mask = bvh.RayCast(packet, 0xB, hits);
+		for (uint32_t lane = 0; lane < 4; ++ lane)
+		{
+			if (2 == lane)
+			{
+				EXPECT_EQ(hits[lane].triangle, SceneRayHit::INVALID_INDEX);
+				EXPECT_EQ(hit_mask & (1UL << lane), 0U);
+			}
+			else
+			{
+				EXPECT_EQ(expected[lane] < 1e10f, (hit_mask & (1UL << lane)) != 0);
+				EXPECT_NEAR(expected[lane], hits[lane].dist, 1e-5f);
+			}
+		}
+	}
+}
+
+TEST(SceneQueryTest, EmptyAndDegenerated)
+{
+	std::vector<float3> positions(3, float3(1, 1, 1));
+	std::vector<uint32_t> indices = { 0, 1, 2 };
+
+	TriangleBVH empty(positions, ArrayRef<uint32_t>());
+	TriangleBVH::Hit hit = { 100.0f, SceneRayHit::INVALID_INDEX, 0, 0 };
+	EXPECT_FALSE(empty.RayCast(float3(0, 0, 0), float3(1, 1, 1), hit));
+
+	TriangleBVH degenerated(positions, indices);
+	EXPECT_FALSE(degenerated.RayCast(float3(0, 0, 0), float3(1, 1, 1), hit));
+	EXPECT_EQ(hit.dist, 100.0f);
+
+	SceneBVH scene;
+	scene.Build();
+	SceneRay const ray = { float3(0, 0, 0), float3(0, 0, 1), 100.0f };
+	SceneRayHit scene_hit;
+	EXPECT_FALSE(scene.RayCast(ray, scene_hit));
+	EXPECT_EQ(scene_hit.obj, nullptr);
+	EXPECT_EQ(scene_hit.instance, SceneRayHit::INVALID_INDEX);
+}
+
+TEST(SceneQueryTest, SceneBVHMatchesBruteForce)
+{
+	uint32_t seed = 2;
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	MakeSphere(8, 16, positions, indices);
+	auto mesh = MakeSharedPtr<TriangleBVH>(positions, indices);
+	AABBox const mesh_bound = mesh->Bound();
+
+	std::vector<TestInstance> instances(300);
+	SceneBVH scene;
+	for (auto& inst : instances)
+	{
+		inst.model = RandomTransform(seed, 50);
+		inst.has_mesh = (RandomFloat(seed) > -0.5f);
+		TriangleBVHPtr const meshes[] = { TriangleBVHPtr(), mesh };
+		scene.AddInstance(nullptr, MathLib::transform_aabb(mesh_bound, inst.model), inst.model,
+			inst.has_mesh ? ArrayRef<TriangleBVHPtr>(meshes) : ArrayRef<TriangleBVHPtr>());
+	}
+	scene.Build();
+
+	auto check = [&]()
+	{
+		std::vector<SceneRay> rays(256);
+		for (auto& ray : rays)
+		{
+			ray.orig = RandomFloat3(seed, 60);
+			ray.dir = RandomFloat3(seed, 50) - ray.orig;
+			ray.max_dist = 2;
+		}
+		std::vector<SceneRayHit> hits(rays.size() - 3);
+		scene.RayCast(ArrayRef<SceneRay>(rays).Slice(0, static_cast<uint32_t>(hits.size())), &hits[0]);
+
+		uint32_t num_hits = 0;
+		for (size_t i = 0; i < rays.size(); ++ i)
+		{
+			uint32_t expected_instance;
+			float const expected = BruteForceScene(instances, positions, indices, mesh_bound, rays[i], expected_instance);
+
+			SceneRayHit hit;
+			bool const found = scene.RayCast(rays[i], hit);
+			EXPECT_EQ(expected_instance != SceneRayHit::INVALID_INDEX, found);
+			EXPECT_NEAR(expected, hit.dist, 1e-4f);
+			if (found)
+			{
+				EXPECT_EQ(expected_instance, hit.instance);
+				EXPECT_EQ(instances[hit.instance].has_mesh ? 1U : SceneRayHit::INVALID_INDEX, hit.mesh);
+				++ num_hits;
+			}
+			else
+			{
+				EXPECT_EQ(SceneRayHit::INVALID_INDEX, hit.triangle);
+			}
+
+			if (i < hits.size())
+			{
+				EXPECT_EQ(hit.instance, hits[i].instance);
+				EXPECT_EQ(hit.mesh, hits[i].mesh);
+				EXPECT_EQ(hit.triangle, hits[i].triangle);
+				EXPECT_FLOAT_EQ(hit.dist, hits[i].dist);
+			}
+		}
+		EXPECT_GT(num_hits, rays.size() / 10);
+	};
+
+	check();
+
+	// Moving is a refit
+	for (uint32_t i = 0; i < instances.size(); i += 3)
+	{
+		instances[i].model = RandomTransform(seed, 50);
+		scene.UpdateInstance(i, MathLib::transform_aabb(mesh_bound, instances[i].model), instances[i].model);
+	}
+	scene.Refit();
+	check();
+
+	// Disabled ones are gone
+	for (uint32_t i = 0; i < instances.size(); ++ i)
+	{
+		scene.EnableInstance(i, false);
+	}
+	SceneRay const ray = { float3(0, 0, 0), float3(1, 0, 0), 1e10f };
+	SceneRayHit hit;
+	EXPECT_FALSE(scene.RayCast(ray, hit));
+}
+
+TEST(SceneQueryTest, OverlapMatchesBruteForce)
+{
+	uint32_t seed = 3;
+	std::vector<AABBox> bounds(1000);
+	SceneBVH scene;
+	for (auto& bound : bounds)
+	{
+		float3 const center = RandomFloat3(seed, 100);
+		float3 const extent(MathLib::abs(RandomFloat(seed)) * 4, MathLib::abs(RandomFloat(seed)) * 4, MathLib::abs(RandomFloat(seed)) * 4);
+		bound = AABBox(center - extent, center + extent);
+		scene.AddInstance(nullptr, bound, float4x4::Identity(), ArrayRef<TriangleBVHPtr>());
+	}
+	scene.Build();
+	scene.EnableInstance(0, false);
+
+	std::vector<uint32_t> result;
+	for (uint32_t i = 0; i < 100; ++ i)
+	{
+		float3 const center = RandomFloat3(seed, 100);
+		float3 const extent(MathLib::abs(RandomFloat(seed)) * 20, MathLib::abs(RandomFloat(seed)) * 20, MathLib::abs(RandomFloat(seed)) * 20);
+		AABBox const query(center - extent, center + extent);
+
+		std::vector<uint32_t> expected;
+		for (uint32_t j = 1; j < bounds.size(); ++ j)
+		{
+			if (MathLib::intersect_aabb_aabb(bounds[j], query))
+			{
+				expected.push_back(j);
+			}
+		}
+
+		scene.Overlap(query, result);
+		std::sort(result.begin(), result.end());
+		EXPECT_EQ(expected, result);
+	}
+}
+
+// Picking rays from a camera into a field of 2000 spheres, one ray at a time and in packets
+TEST(SceneQueryTest, RayCastThroughput)
+{
+	uint32_t seed = 4;
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	MakeSphere(16, 32, positions, indices);
+	auto mesh = MakeSharedPtr<TriangleBVH>(positions, indices);
+
+	SceneBVH scene;
+	for (uint32_t i = 0; i < 2000; ++ i)
+	{
+		float4x4 const model = RandomTransform(seed, 100);
+		scene.AddInstance(nullptr, MathLib::transform_aabb(mesh->Bound(), model), model, ArrayRef<TriangleBVHPtr>(mesh));
+	}
+
+	Timer timer;
+	scene.Build();
+	double const build_time = timer.elapsed();
+
+	uint32_t const WIDTH = 128;
+	uint32_t const HEIGHT = 128;
+	std::vector<SceneRay> rays(WIDTH * HEIGHT);
+	float3 const eye(0, 0, -150);
+	for (uint32_t y = 0; y < HEIGHT; ++ y)
+	{
+		for (uint32_t x = 0; x < WIDTH; ++ x)
+		{
+			SceneRay& ray = rays[y * WIDTH + x];
+			ray.orig = eye;
+			ray.dir = MathLib::normalize(float3((x + 0.5f) / WIDTH - 0.5f, (y + 0.5f) / HEIGHT - 0.5f, 1.0f));
+			ray.max_dist = 1000;
+		}
+	}
+
+	std::vector<SceneRayHit> single_hits(rays.size());
+	std::vector<SceneRayHit> packet_hits(rays.size());
+
+	int const ITERATIONS = 5;
+	timer.restart();
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < rays.size(); ++ i)
+		{
+			scene.RayCast(rays[i], single_hits[i]);
+		}
+	}
+	double const single_time = timer.elapsed();
+
+	timer.restart();
+	for (int it = 0; it < ITERATIONS; ++ it)
+	{
+		scene.RayCast(rays, &packet_hits[0]);
+	}
+	double const packet_time = timer.elapsed();
+
+	uint32_t num_hits = 0;
+	for (size_t i = 0; i < rays.size(); ++ i)
+	{
+		EXPECT_EQ(single_hits[i].instance, packet_hits[i].instance);
+		EXPECT_FLOAT_EQ(single_hits[i].dist, packet_hits[i].dist);
+		num_hits += (single_hits[i].instance != SceneRayHit::INVALID_INDEX);
+	}
+	EXPECT_GT(num_hits, 0U);
+
+	double const single_rays_per_second = rays.size() * ITERATIONS / single_time;
+	double const packet_rays_per_second = rays.size() * ITERATIONS / packet_time;
+	cout << "Scene BVH build " << build_time * 1000 << " ms, " << single_rays_per_second / 1e6 << " M rays/s single, "
+		<< packet_rays_per_second / 1e6 << " M rays/s in packets, " << num_hits << " hits" << endl;
+	testing::Test::RecordProperty("build_us", static_cast<int>(build_time * 1e6));
+	testing::Test::RecordProperty("single_rays_per_second", static_cast<int>(single_rays_per_second));
+	testing::Test::RecordProperty("packet_rays_per_second", static_cast<int>(packet_rays_per_second));
+}
+
+// Static objects hit at their triangles or bounds, and a moving one refit after Update
+TEST_F(KlayGETest, SceneManagerRayCast)
+{
+	ContextCfg cfg = Context::Instance().Config();
+	bool const deferred_rendering = cfg.deferred_rendering;
+	cfg.deferred_rendering = true;
+	Context::Instance().Config(cfg);
+
+	auto so_tri = MakeSharedPtr<SceneObjectHelper>(MakeSharedPtr<QuadRenderable>(true), SceneObject::SOA_Cullable);
+	so_tri->ModelMatrix(MathLib::translation(0.0f, 0.0f, 5.0f));
+	so_tri->AddToSceneManager();
+	auto so_bound = MakeSharedPtr<SceneObjectHelper>(MakeSharedPtr<QuadRenderable>(false), SceneObject::SOA_Cullable);
+	so_bound->ModelMatrix(MathLib::translation(3.0f, 0.0f, 5.0f));
+	so_bound->AddToSceneManager();
+	auto so_moving = MakeSharedPtr<SceneObjectHelper>(MakeSharedPtr<QuadRenderable>(true),
+		SceneObject::SOA_Cullable | SceneObject::SOA_Moveable);
+	so_moving->ModelMatrix(MathLib::translation(-3.0f, 0.0f, 5.0f));
+	so_moving->AddToSceneManager();
+
+	SceneManager& sm = Context::Instance().SceneManagerInstance();
+
+	SceneRay const rays[] =
+	{
+		{ float3(0.5f, 0.5f, 0), float3(0, 0, 1), 100.0f },
+		{ float3(3, 0, 0), float3(0, 0, 1), 100.0f },
+		{ float3(-3, 0, 0), float3(0, 0, 1), 100.0f },
+		{ float3(1.5f, 0, 0), float3(0, 0, 1), 100.0f }
+	};
+
+	SceneRayHit hit;
+	EXPECT_TRUE(sm.RayCast(rays[0], hit));
+	EXPECT_EQ(hit.obj, so_tri.get());
+	EXPECT_FLOAT_EQ(hit.dist, 5.0f);
+	EXPECT_EQ(hit.mesh, 0U);
+	EXPECT_EQ(hit.triangle, 1U);
+
+	EXPECT_TRUE(sm.RayCast(rays[1], hit));
+	EXPECT_EQ(hit.obj, so_bound.get());
+	EXPECT_FLOAT_EQ(hit.dist, 5.0f);
+	EXPECT_EQ(hit.mesh, SceneRayHit::INVALID_INDEX);
+
+	EXPECT_FALSE(sm.RayCast(rays[3], hit));
+	EXPECT_EQ(hit.obj, nullptr);
+
+	so_moving->ModelMatrix(MathLib::translation(-3.0f, 0.0f, 8.0f));
+	sm.Update();
+
+	SceneRayHit hits[4];
+	sm.RayCast(rays, hits);
+	EXPECT_EQ(hits[0].obj, so_tri.get());
+	EXPECT_EQ(hits[1].obj, so_bound.get());
+	EXPECT_EQ(hits[2].obj, so_moving.get());
+	EXPECT_FLOAT_EQ(hits[2].dist, 8.0f);
+	EXPECT_EQ(hits[3].obj, nullptr);
+
+	std::vector<SceneObject*> objs;
+	sm.OverlapQuery(AABBox(float3(-4, -1, 4), float3(0.5f, 1, 9)), objs);
+	std::sort(objs.begin(), objs.end());
+	std::vector<SceneObject*> expected = { so_tri.get(), so_moving.get() };
+	std::sort(expected.begin(), expected.end());
+	EXPECT_EQ(expected, objs);
+
+	sm.ClearObject();
+	EXPECT_FALSE(sm.RayCast(rays[0], hit));
+
+	cfg.deferred_rendering = deferred_rendering;
+	Context::Instance().Config(cfg);
+}
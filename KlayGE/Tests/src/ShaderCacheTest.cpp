@@ -0,0 +1,260 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/ShaderCache.hpp>
+
+#include <DXBC2GLSL/DXBC2GLSL.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	char const CACHE_FOLDER[] = "ShaderCacheTest/";
+
+	// A ps_5_0 with an immediate constant buffer, a loop and relative indexing
+	uint8_t const PS_DXBC[] =
+	{
+		0x44, 0x58, 0x42, 0x43, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0xB8, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x2C, 0x00, 0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0xB8, 0x00, 0x00, 0x00, 0x49, 0x53, 0x47, 0x4E,
+		0x50, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x0F, 0x00, 0x00, 0x00, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03, 0x03, 0x00, 0x00, 0x53, 0x56, 0x5F, 0x50,
+		0x4F, 0x53, 0x49, 0x54, 0x49, 0x4F, 0x4E, 0x00, 0x54, 0x45, 0x58, 0x43, 0x4F, 0x4F, 0x52, 0x44,
+		0x00, 0xAB, 0xAB, 0xAB, 0x4F, 0x53, 0x47, 0x4E, 0x2C, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+		0x08, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00,
+		0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x53, 0x56, 0x5F, 0x54,
+		0x61, 0x72, 0x67, 0x65, 0x74, 0x00, 0xAB, 0xAB, 0x53, 0x48, 0x44, 0x52, 0xF8, 0x00, 0x00, 0x00,
+		0x40, 0x00, 0x00, 0x00, 0x3E, 0x00, 0x00, 0x00, 0x35, 0x18, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0xC0, 0x3F, 0x00, 0x00, 0x00, 0xC0, 0xCD, 0xCC, 0xCC, 0x3D, 0x95, 0xBF, 0xD6, 0x33,
+		0x00, 0x20, 0xF1, 0x47, 0xD0, 0x0F, 0x49, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x7F,
+		0x62, 0x10, 0x00, 0x03, 0x32, 0x10, 0x10, 0x00, 0x01, 0x00, 0x00, 0x00, 0x65, 0x00, 0x00, 0x03,
+		0xF2, 0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x68, 0x00, 0x00, 0x02, 0x03, 0x00, 0x00, 0x00,
+		0x11, 0x00, 0x00, 0x07, 0x12, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46, 0x10, 0x10, 0x00,
+		0x01, 0x00, 0x00, 0x00, 0x46, 0x10, 0x10, 0x00, 0x01, 0x00, 0x00, 0x00, 0x31, 0x00, 0x00, 0x07,
+		0x12, 0x00, 0x10, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x1F, 0x08, 0x00, 0x03, 0x0A, 0x00, 0x10, 0x00,
+		0x01, 0x00, 0x00, 0x00, 0x4B, 0x00, 0x00, 0x05, 0x22, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x0A, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x15, 0x00, 0x00, 0x01, 0x1E, 0x00, 0x00, 0x07,
+		0x12, 0x00, 0x10, 0x00, 0x02, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x01, 0x40, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x36, 0x00, 0x00, 0x06, 0xF2, 0x20, 0x10, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x46, 0x9E, 0x90, 0x00, 0x0A, 0x00, 0x10, 0x00, 0x02, 0x00, 0x00, 0x00,
+		0x2B, 0x00, 0x00, 0x05, 0x82, 0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x10, 0x00,
+		0x02, 0x00, 0x00, 0x00, 0x3E, 0x00, 0x00, 0x01
+	};
+
+	std::vector<uint8_t> MakeBlob(uint32_t size, uint32_t seed)
+	{
+		std::vector<uint8_t> blob(size);
+		for (uint32_t i = 0; i < size; ++ i)
+		{
+			blob[i] = static_cast<uint8_t>((i * 31 + seed) ^ (i >> 8));
+		}
+		return blob;
+	}
+
+	std::string EntryPath(uint64_t key)
+	{
+		char name[32];
+		std::sprintf(name, "%016llx.ksc", static_cast<unsigned long long>(key));
+		return std::string(CACHE_FOLDER) + name;
+	}
+}
+
+TEST(ShaderCacheTest, KeyDependsOnEveryInput)
+{
+	uint64_t const key = ShaderCacheKey().Append(PS_DXBC, sizeof(PS_DXBC)).Append(450U).Append("gl_4_5").Value();
+	EXPECT_EQ(key, ShaderCacheKey().Append(PS_DXBC, sizeof(PS_DXBC)).Append(450U).Append("gl_4_5").Value());
+	EXPECT_NE(key, ShaderCacheKey().Append(PS_DXBC, sizeof(PS_DXBC) - 1).Append(450U).Append("gl_4_5").Value());
+	EXPECT_NE(key, ShaderCacheKey().Append(PS_DXBC, sizeof(PS_DXBC)).Append(440U).Append("gl_4_5").Value());
+	EXPECT_NE(key, ShaderCacheKey().Append(PS_DXBC, sizeof(PS_DXBC)).Append(450U).Append("gl_4_4").Value());
+
+	EXPECT_NE(ShaderCacheKey().Append("ab").Append("c").Value(), ShaderCacheKey().Append("a").Append("bc").Value());
+}
+
+TEST(ShaderCacheTest, StoreAndLoad)
+{
+	ShaderCache cache(CACHE_FOLDER);
+	cache.Clear();
+
+	std::vector<uint8_t> data;
+	EXPECT_FALSE(cache.Load(1, data));
+	EXPECT_TRUE(data.empty());
+
+	std::vector<uint8_t> const blob = MakeBlob(10000, 1);
+	EXPECT_TRUE(cache.Store(1, blob));
+	EXPECT_TRUE(cache.Store(2, std::vector<uint8_t>()));
+
+	EXPECT_TRUE(cache.Load(1, data));
+	EXPECT_EQ(blob, data);
+	EXPECT_TRUE(cache.Load(2, data));
+	EXPECT_TRUE(data.empty());
+
+	std::vector<uint8_t> const new_blob = MakeBlob(200, 2);
+	EXPECT_TRUE(cache.Store(1, new_blob));
+	EXPECT_TRUE(cache.Load(1, data));
+	EXPECT_EQ(new_blob, data);
+
+	cache.Remove(1);
+	EXPECT_FALSE(cache.Load(1, data));
+
+	EXPECT_EQ(cache.NumHits(), 3U);
+	EXPECT_EQ(cache.NumMisses(), 2U);
+	EXPECT_EQ(cache.NumStores(), 3U);
+
+	cache.Clear();
+}
+
+TEST(ShaderCacheTest, PersistsAcrossInstances)
+{
+	std::vector<uint8_t> const blob = MakeBlob(5000, 3);
+	{
+		ShaderCache cache(CACHE_FOLDER);
+		cache.Clear();
+		EXPECT_TRUE(cache.Store(42, blob));
+	}
+	{
+		ShaderCache cache(CACHE_FOLDER);
+		std::vector<uint8_t> data;
+		EXPECT_TRUE(cache.Load(42, data));
+		EXPECT_EQ(blob, data);
+		cache.Clear();
+	}
+}
+
+TEST(ShaderCacheTest, RejectsCorruptEntries)
+{
+	ShaderCache cache(CACHE_FOLDER);
+	cache.Clear();
+
+	std::vector<uint8_t> const blob = MakeBlob(1000, 4);
+	std::vector<uint8_t> data;
+
+	// A flipped byte in the data
+	EXPECT_TRUE(cache.Store(7, blob));
+	{
+		std::fstream file(EntryPath(7).c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		ASSERT_TRUE(file.good());
+		file.seekp(500);
+		char const c = 0x55;
+		file.write(&c, 1);
+	}
+	EXPECT_FALSE(cache.Load(7, data));
+	EXPECT_TRUE(data.empty());
+	// The corrupt entry is gone
+	EXPECT_FALSE(std::ifstream(EntryPath(7).c_str()).good());
+
+	// Truncated
+	EXPECT_TRUE(cache.Store(8, blob));
+	{
+		std::ifstream ifs(EntryPath(8).c_str(), std::ios_base::binary);
+		std::vector<char> file_data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+		ifs.close();
+
+		std::ofstream ofs(EntryPath(8).c_str(), std::ios_base::binary | std::ios_base::trunc);
+		ofs.write(file_data.data(), file_data.size() / 2);
+	}
+	EXPECT_FALSE(cache.Load(8, data));
+
+	// An entry under the wrong name
+	EXPECT_TRUE(cache.Store(9, blob));
+	std::rename(EntryPath(9).c_str(), EntryPath(10).c_str());
+	EXPECT_FALSE(cache.Load(10, data));
+
+	EXPECT_EQ(cache.NumHits(), 0U);
+
+	cache.Clear();
+}
+
+// Startup with a cold cache translates every shader and fills the cache. With a warm one, in a new cache
+// instance like a second run of the app, every shader is a hit.
+TEST(ShaderCacheTest, ColdVsWarmStartup)
+{
+	uint32_t const NUM_SHADERS = 256;
+
+	{
+		ShaderCache cache(CACHE_FOLDER);
+		cache.Clear();
+	}
+
+	std::string expected_glsl;
+	{
+		DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+		dxbc2glsl.FeedDXBC(PS_DXBC, false, true, STP_Undefined, STOP_Undefined, GSV_450);
+		expected_glsl = dxbc2glsl.GLSLString();
+	}
+	ASSERT_FALSE(expected_glsl.empty());
+
+	// Every shader has its own key, as if they were all different
+	std::vector<uint64_t> keys(NUM_SHADERS);
+	for (uint32_t i = 0; i < NUM_SHADERS; ++ i)
+	{
+		keys[i] = ShaderCacheKey().Append(PS_DXBC, sizeof(PS_DXBC)).Append(static_cast<uint32_t>(GSV_450)).Append(i).Value();
+	}
+
+	Timer timer;
+
+	double cold_time;
+	{
+		timer.restart();
+
+		ShaderCache cache(CACHE_FOLDER);
+		std::vector<uint8_t> data;
+		for (uint32_t i = 0; i < NUM_SHADERS; ++ i)
+		{
+			if (!cache.Load(keys[i], data))
+			{
+				DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+				dxbc2glsl.FeedDXBC(PS_DXBC, false, true, STP_Undefined, STOP_Undefined, GSV_450);
+				std::string const & glsl = dxbc2glsl.GLSLString();
+				cache.Store(keys[i], ArrayRef<uint8_t>(reinterpret_cast<uint8_t const *>(glsl.data()), glsl.size()));
+			}
+		}
+
+		cold_time = timer.elapsed();
+
+		EXPECT_EQ(cache.NumMisses(), NUM_SHADERS);
+		EXPECT_EQ(cache.NumStores(), NUM_SHADERS);
+	}
+
+	double warm_time;
+	{
+		timer.restart();
+
+		ShaderCache cache(CACHE_FOLDER);
+		std::vector<uint8_t> data;
+		uint32_t num_matched = 0;
+		for (uint32_t i = 0; i < NUM_SHADERS; ++ i)
+		{
+			if (cache.Load(keys[i], data))
+			{
+				if (std::string(data.begin(), data.end()) == expected_glsl)
+				{
+					++ num_matched;
+				}
+			}
+		}
+
+		warm_time = timer.elapsed();
+
+		EXPECT_EQ(cache.NumHits(), NUM_SHADERS);
+		EXPECT_EQ(num_matched, NUM_SHADERS);
+
+		cache.Clear();
+	}
+
+	testing::Test::RecordProperty("cold_startup_us", static_cast<int>(cold_time * 1e6));
+	testing::Test::RecordProperty("warm_startup_us", static_cast<int>(warm_time * 1e6));
+	if (warm_time > 0)
+	{
+		testing::Test::RecordProperty("speedup_x100", static_cast<int>(cold_time / warm_time * 100));
+	}
+}
@@ -9,6 +9,9 @@
 #include <KlayGE/Renderable.hpp>
 #include <KlayGE/Mesh.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/Context.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
 #include <iostream>
@@ -16,6 +19,9 @@
 #include <sstream>
 #include <vector>
 #include <cstring>
+#include <deque>
+#include <thread>
+#include <unordered_map>
 
 #if defined(KLAYGE_COMPILER_GCC)
 #pragma GCC diagnostic push
@@ -36,6 +42,9 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include "MeshMLReader.hpp"
+#include "MeshOptimizer.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -76,7 +85,11 @@ namespace
 	}
 
 	std::string const JIT_EXT_NAME = ".model_bin";
-	uint32_t const MODEL_BIN_VERSION = 14;
+	uint32_t const MODEL_BIN_VERSION = 16;
+
+	uint32_t const VERTEX_CACHE_SIZE = 16;
+	uint32_t const MAX_CLUSTER_VERTICES = 64;
+	uint32_t const MAX_CLUSTER_TRIANGLES = 124;
 
 	struct KeyFrames
 	{
@@ -111,25 +124,6 @@ namespace
 		}
 	}
 
-	template <int N>
-	void ExtractUIVector(std::string const & value_str, uint32_t* v)
-	{
-		std::vector<std::string> strs;
-		boost::algorithm::split(strs, value_str, boost::is_any_of(" "));
-		for (size_t i = 0; i < N; ++ i)
-		{
-			if (i < strs.size())
-			{
-				boost::algorithm::trim(strs[i]);
-				v[i] = static_cast<uint32_t>(atoi(strs[i].c_str()));
-			}
-			else
-			{
-				v[i] = 0;
-			}
-		}
-	}
-
 	void CompileMaterialsChunk(XMLNodePtr const & materials_chunk, std::vector<OfflineRenderMaterial>& mtls)
 	{
 		uint32_t mtl_index = 0;
@@ -480,361 +474,352 @@ namespace
 		}
 	}
 
-	void CompileMeshesVerticesChunk(XMLNodePtr const & vertices_chunk,
-		AABBox& pos_bb, AABBox& tc_bb, std::vector<VertexElement>& vertex_elements,
-		std::vector<int16_t>& positions, std::vector<uint32_t>& normals,
-		std::vector<uint32_t>& tangent_quats, 
-		std::vector<uint32_t>& diffuses, std::vector<uint32_t>& speculars,
-		std::vector<int16_t>& tex_coords, 
-		std::vector<uint32_t>& bone_indices, std::vector<uint32_t>& bone_weights)
+	// A mesh as it is in MeshML, before being packed
+	struct MeshMLMesh
 	{
-		std::vector<float3> mesh_positions;
-		std::vector<float3> mesh_normals;
-		std::vector<float4> mesh_tangents;
-		std::vector<float3> mesh_binormals;
-		std::vector<Quaternion> mesh_tangent_quats;
-		std::vector<float4> mesh_diffuses;
-		std::vector<float3> mesh_speculars;
-		std::vector<float2> mesh_tex_coords;
-		std::vector<uint32_t> mesh_bone_indices;
-		std::vector<uint32_t> mesh_bone_weights;
-
-		bool recompute_pos_bb;
-		XMLNodePtr pos_bb_node = vertices_chunk->FirstNode("pos_bb");
-		if (pos_bb_node)
+		std::string name;
+		int32_t mtl_id;
+
+		bool has_vertices;
+		bool has_triangles;
+
+		bool has_pos_bb;
+		bool has_tc_bb;
+		AABBox pos_bb;
+		AABBox tc_bb;
+
+		bool has_normal;
+		bool has_diffuse;
+		bool has_specular;
+		bool has_weight;
+		bool has_tex_coord;
+		bool has_tangent;
+		bool has_binormal;
+		bool has_tangent_quat;
+
+		std::vector<float3> positions;
+		std::vector<float3> normals;
+		std::vector<float4> tangents;
+		std::vector<float3> binormals;
+		std::vector<Quaternion> tangent_quats;
+		std::vector<float4> diffuses;
+		std::vector<float3> speculars;
+		std::vector<float2> tex_coords;
+		std::vector<uint32_t> bone_indices;
+		std::vector<uint32_t> bone_weights;
+
+		std::vector<uint32_t> indices;
+
+		MeshMLMesh()
+			: mtl_id(0),
+				has_vertices(false), has_triangles(false),
+				has_pos_bb(false), has_tc_bb(false),
+				has_normal(false), has_diffuse(false), has_specular(false), has_weight(false),
+				has_tex_coord(false), has_tangent(false), has_binormal(false), has_tangent_quat(false)
 		{
-			float3 pos_min_bb, pos_max_bb;
-			{
-				XMLAttributePtr attr = pos_bb_node->Attrib("min");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &pos_min_bb[0]);
-				}
-				else
-				{
-					XMLNodePtr pos_min_node = pos_bb_node->FirstNode("min");
-					pos_min_bb.x() = pos_min_node->Attrib("x")->ValueFloat();
-					pos_min_bb.y() = pos_min_node->Attrib("y")->ValueFloat();
-					pos_min_bb.z() = pos_min_node->Attrib("z")->ValueFloat();
-				}
-			}
-			{
-				XMLAttributePtr attr = pos_bb_node->Attrib("max");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &pos_max_bb[0]);
-				}
-				else
-				{
-					XMLNodePtr pos_max_node = pos_bb_node->FirstNode("max");
-					pos_max_bb.x() = pos_max_node->Attrib("x")->ValueFloat();
-					pos_max_bb.y() = pos_max_node->Attrib("y")->ValueFloat();
-					pos_max_bb.z() = pos_max_node->Attrib("z")->ValueFloat();
-				}
-			}
-			pos_bb = AABBox(pos_min_bb, pos_max_bb);
+		}
+	};
+
+	// A mesh in the formats of the model binary
+	struct CompiledMesh
+	{
+		bool has_vertices;
+		bool has_triangles;
+
+		AABBox pos_bb;
+		AABBox tc_bb;
+		std::vector<VertexElement> ves;
+		std::vector<int16_t> positions;
+		std::vector<uint32_t> normals;
+		std::vector<uint32_t> tangent_quats;
+		std::vector<uint32_t> diffuses;
+		std::vector<uint32_t> speculars;
+		std::vector<int16_t> tex_coords;
+		std::vector<uint32_t> bone_indices;
+		std::vector<uint32_t> bone_weights;
+
+		std::vector<uint8_t> triangle_indices;
+		char is_index_16;
+	};
 
-			recompute_pos_bb = false;
+	char const * const XYZW_NAMES[] = { "x", "y", "z", "w" };
+	char const * const RGBA_NAMES[] = { "r", "g", "b", "a" };
+
+	// Reads a vector from the "v" attribute, or from one attribute per component
+	void ReadFVector(MeshMLReader const & reader, char const * const * names, float* v, uint32_t n)
+	{
+		if (reader.HasAttrib("v"))
+		{
+			reader.AttribFloats("v", v, n);
 		}
 		else
 		{
-			recompute_pos_bb = true;
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				v[i] = reader.AttribFloat(names[i], 0);
+			}
 		}
+	}
 
-		bool recompute_tc_bb;
-		XMLNodePtr tc_bb_node = vertices_chunk->FirstNode("tc_bb");
-		if (tc_bb_node)
+	// The min and max are either attributes or child elements
+	AABBox ReadBoundingBox(MeshMLReader& reader, uint32_t n)
+	{
+		float3 min_bb(0, 0, 0);
+		float3 max_bb(0, 0, 0);
+		if (reader.HasAttrib("min"))
 		{
-			float3 tc_min_bb, tc_max_bb;
+			reader.AttribFloats("min", &min_bb[0], n);
+			reader.AttribFloats("max", &max_bb[0], n);
+			reader.Skip();
+		}
+		else
+		{
+			while (MeshMLReader::TT_StartElement == reader.Next())
 			{
-				XMLAttributePtr attr = tc_bb_node->Attrib("min");
-				if (attr)
+				if ("min" == reader.Name())
 				{
-					ExtractFVector<2>(attr->ValueString(), &tc_min_bb[0]);
+					ReadFVector(reader, XYZW_NAMES, &min_bb[0], n);
 				}
-				else
+				else if ("max" == reader.Name())
 				{
-					XMLNodePtr tc_min_node = tc_bb_node->FirstNode("min");
-					tc_min_bb.x() = tc_min_node->Attrib("x")->ValueFloat();
-					tc_min_bb.y() = tc_min_node->Attrib("y")->ValueFloat();
+					ReadFVector(reader, XYZW_NAMES, &max_bb[0], n);
 				}
+				reader.Skip();
 			}
+		}
+		return AABBox(min_bb, max_bb);
+	}
+
+	void ReadVertex(MeshMLReader& reader, MeshMLMesh& mesh)
+	{
+		{
+			float3 pos;
+			if (reader.HasAttrib("x"))
 			{
-				XMLAttributePtr attr = tc_bb_node->Attrib("max");
-				if (attr)
-				{
-					ExtractFVector<2>(attr->ValueString(), &tc_max_bb[0]);
-				}
-				else
+				pos.x() = reader.AttribFloat("x", 0);
+				pos.y() = reader.AttribFloat("y", 0);
+				pos.z() = reader.AttribFloat("z", 0);
+
+				if (reader.HasAttrib("u"))
 				{
-					XMLNodePtr tc_max_node = tc_bb_node->FirstNode("max");							
-					tc_max_bb.x() = tc_max_node->Attrib("x")->ValueFloat();
-					tc_max_bb.y() = tc_max_node->Attrib("y")->ValueFloat();
+					mesh.tex_coords.push_back(float2(reader.AttribFloat("u", 0), reader.AttribFloat("v", 0)));
 				}
 			}
-
-			tc_min_bb.z() = 0;
-			tc_max_bb.z() = 0;
-			tc_bb = AABBox(tc_min_bb, tc_max_bb);
-
-			recompute_tc_bb = false;
-		}
-		else
-		{
-			recompute_tc_bb = true;
+			else
+			{
+				reader.AttribFloats("v", &pos[0], 3);
+			}
+			mesh.positions.push_back(pos);
 		}
+		bool const tex_coord_in_vertex = reader.HasAttrib("u");
 
-		bool has_normal = false;
-		bool has_diffuse = false;
-		bool has_specular = false;
+		// Weights are either lists in one element, or one element per bone
+		uint32_t bone_index32[4] = { 0, 0, 0, 0 };
+		float bone_weight32[4] = { 0, 0, 0, 0 };
+		uint32_t num_blend = 0;
 		bool has_weight = false;
-		bool has_tex_coord = false;
-		bool has_tangent = false;
-		bool has_binormal = false;
-		bool has_tangent_quat = false;
 
-		for (XMLNodePtr vertex_node = vertices_chunk->FirstNode("vertex"); vertex_node; vertex_node = vertex_node->NextSibling("vertex"))
+		while (MeshMLReader::TT_StartElement == reader.Next())
 		{
+			std::string_view const name = reader.Name();
+			if ("diffuse" == name)
 			{
-				float3 pos;
-				XMLAttributePtr attr = vertex_node->Attrib("x");
-				if (attr)
-				{
-					pos.x() = vertex_node->Attrib("x")->ValueFloat();
-					pos.y() = vertex_node->Attrib("y")->ValueFloat();
-					pos.z() = vertex_node->Attrib("z")->ValueFloat();
+				mesh.has_diffuse = true;
 
-					attr = vertex_node->Attrib("u");
-					if (attr)
-					{
-						float2 tex_coord;
-						tex_coord.x() = vertex_node->Attrib("u")->ValueFloat();
-						tex_coord.y() = vertex_node->Attrib("v")->ValueFloat();
-						mesh_tex_coords.push_back(tex_coord);
-					}
-				}
-				else
-				{
-					ExtractFVector<3>(vertex_node->Attrib("v")->ValueString(), &pos[0]);
-				}
-				mesh_positions.push_back(pos);
+				float4 diffuse;
+				ReadFVector(reader, RGBA_NAMES, &diffuse[0], 4);
+				mesh.diffuses.push_back(diffuse);
 			}
+			else if ("specular" == name)
+			{
+				mesh.has_specular = true;
 
-			XMLNodePtr diffuse_node = vertex_node->FirstNode("diffuse");
-			if (diffuse_node)
+				float3 specular;
+				ReadFVector(reader, RGBA_NAMES, &specular[0], 3);
+				mesh.speculars.push_back(specular);
+			}
+			else if (("tex_coord" == name) && !tex_coord_in_vertex)
 			{
-				has_diffuse = true;
+				mesh.has_tex_coord = true;
 
-				float4 diffuse;
-				XMLAttributePtr attr = diffuse_node->Attrib("v");
-				if (attr)
+				float2 tex_coord;
+				if (reader.HasAttrib("u"))
 				{
-					ExtractFVector<4>(attr->ValueString(), &diffuse[0]);
+					tex_coord.x() = reader.AttribFloat("u", 0);
+					tex_coord.y() = reader.AttribFloat("v", 0);
 				}
 				else
 				{
-					diffuse.x() = diffuse_node->Attrib("r")->ValueFloat();
-					diffuse.y() = diffuse_node->Attrib("g")->ValueFloat();
-					diffuse.z() = diffuse_node->Attrib("b")->ValueFloat();
-					diffuse.w() = diffuse_node->Attrib("a")->ValueFloat();										
+					reader.AttribFloats("v", &tex_coord[0], 2);
 				}
-				mesh_diffuses.push_back(diffuse);
+				mesh.tex_coords.push_back(tex_coord);
 			}
-
-			XMLNodePtr specular_node = vertex_node->FirstNode("specular");
-			if (specular_node)
+			else if ("weight" == name)
 			{
-				has_specular = true;
+				has_weight = true;
 
-				float3 specular;
-				XMLAttributePtr attr = specular_node->Attrib("v");
-				if (attr)
+				std::string_view const index_name = reader.HasAttrib("joint") ? "joint" : "bone_index";
+				uint32_t indices[4];
+				float weights[4];
+				uint32_t const num = std::min(reader.AttribUInts(index_name, indices, 4 - num_blend),
+					reader.AttribFloats("weight", weights, 4 - num_blend));
+				for (uint32_t i = 0; i < num; ++ i)
 				{
-					ExtractFVector<3>(attr->ValueString(), &specular[0]);
+					bone_index32[num_blend] = indices[i];
+					bone_weight32[num_blend] = weights[i];
+					++ num_blend;
 				}
-				else
-				{
-					specular.x() = specular_node->Attrib("r")->ValueFloat();
-					specular.y() = specular_node->Attrib("g")->ValueFloat();
-					specular.z() = specular_node->Attrib("b")->ValueFloat();
-				}
-				mesh_speculars.push_back(specular);
 			}
+			else if ("normal" == name)
+			{
+				mesh.has_normal = true;
 
-			if (!vertex_node->Attrib("u"))
+				float3 normal;
+				ReadFVector(reader, XYZW_NAMES, &normal[0], 3);
+				mesh.normals.push_back(normal);
+			}
+			else if ("tangent" == name)
 			{
-				XMLNodePtr tex_coord_node = vertex_node->FirstNode("tex_coord");
-				if (tex_coord_node)
-				{
-					has_tex_coord = true;
+				mesh.has_tangent = true;
 
-					float2 tex_coord;
-					XMLAttributePtr attr = tex_coord_node->Attrib("u");
-					if (attr)
-					{
-						tex_coord.x() = tex_coord_node->Attrib("u")->ValueFloat();
-						tex_coord.y() = tex_coord_node->Attrib("v")->ValueFloat();
-					}
-					else
-					{
-						ExtractFVector<2>(tex_coord_node->Attrib("v")->ValueString(), &tex_coord[0]);
-					}
-					mesh_tex_coords.push_back(tex_coord);
+				float4 tangent;
+				ReadFVector(reader, XYZW_NAMES, &tangent[0], 4);
+				if (!reader.HasAttrib("v") && !reader.HasAttrib("w"))
+				{
+					tangent.w() = 1;
 				}
+				mesh.tangents.push_back(tangent);
 			}
+			else if ("binormal" == name)
+			{
+				mesh.has_binormal = true;
 
-			XMLNodePtr weight_node = vertex_node->FirstNode("weight");
-			if (weight_node)
+				float3 binormal;
+				ReadFVector(reader, XYZW_NAMES, &binormal[0], 3);
+				mesh.binormals.push_back(binormal);
+			}
+			else if ("tangent_quat" == name)
 			{
-				has_weight = true;
+				mesh.has_tangent_quat = true;
 
-				uint32_t bone_index32[4] = { 0, 0, 0, 0 };
-				float bone_weight32[4] = { 0, 0, 0, 0 };
+				Quaternion tangent_quat;
+				ReadFVector(reader, XYZW_NAMES, &tangent_quat[0], 4);
+				mesh.tangent_quats.push_back(tangent_quat);
+			}
 
-				uint32_t num_blend = 0;
-				XMLAttributePtr attr = weight_node->Attrib("joint");
-				if (!attr)
-				{
-					attr = weight_node->Attrib("bone_index");
-				}
-				if (attr)
-				{
-					XMLAttributePtr weight_attr = weight_node->Attrib("weight");
+			reader.Skip();
+		}
 
-					std::vector<std::string> index_strs;
-					std::vector<std::string> weight_strs;
-					boost::algorithm::split(index_strs, attr->ValueString(), boost::is_any_of(" "));
-					boost::algorithm::split(weight_strs, weight_attr->ValueString(), boost::is_any_of(" "));
-					
-					for (num_blend = 0; num_blend < 4; ++ num_blend)
-					{
-						if ((num_blend < index_strs.size()) && (num_blend < weight_strs.size()))
-						{
-							bone_index32[num_blend] = static_cast<uint32_t>(atoi(index_strs[num_blend].c_str()));
-							bone_weight32[num_blend] = static_cast<float>(atof(weight_strs[num_blend].c_str()));
-						}
-						else
-						{
-							break;
-						}
-					}
-				}
-				else
-				{
-					while (weight_node && (num_blend < 4))
-					{
-						bone_index32[num_blend] = weight_node->Attrib("bone_index")->ValueUInt();
-						bone_weight32[num_blend] = weight_node->Attrib("weight")->ValueFloat();
+		if (has_weight)
+		{
+			mesh.has_weight = true;
 
-						weight_node = weight_node->NextSibling("weight");
-						++ num_blend;
-					}
-				}
+			uint32_t index32 = 0;
+			uint32_t weight32 = 0;
+			for (size_t j = 0; j < 4; ++ j)
+			{
+				uint8_t bone_index = static_cast<uint8_t>(bone_index32[j]);
+				uint8_t bone_weight = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(bone_weight32[j] * 255), 0, 255));
 
-				uint32_t index32 = 0;
-				uint32_t weight32 = 0;
-				for (size_t j = 0; j < 4; ++ j)
-				{
-					uint8_t bone_index = static_cast<uint8_t>(bone_index32[j]);
-					uint8_t bone_weight = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(bone_weight32[j] * 255), 0, 255));
+				index32 |= (bone_index << (j * 8));
+				weight32 |= (bone_weight << (j * 8));
+			}
+			mesh.bone_indices.push_back(index32);
+			mesh.bone_weights.push_back(weight32);
+		}
+	}
 
-					index32 |= (bone_index << (j * 8));
-					weight32 |= (bone_weight << (j * 8));
-				}
-				mesh_bone_indices.push_back(index32);
-				mesh_bone_weights.push_back(weight32);
+	void ReadMeshVerticesChunk(MeshMLReader& reader, MeshMLMesh& mesh)
+	{
+		mesh.has_vertices = true;
+
+		while (MeshMLReader::TT_StartElement == reader.Next())
+		{
+			std::string_view const name = reader.Name();
+			if ("vertex" == name)
+			{
+				ReadVertex(reader, mesh);
 			}
-						
-			XMLNodePtr normal_node = vertex_node->FirstNode("normal");
-			if (normal_node)
+			else if ("pos_bb" == name)
 			{
-				has_normal = true;
-
-				float3 normal;
-				XMLAttributePtr attr = normal_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &normal[0]);
-				}
-				else
-				{
-					normal.x() = normal_node->Attrib("x")->ValueFloat();
-					normal.y() = normal_node->Attrib("y")->ValueFloat();
-					normal.z() = normal_node->Attrib("z")->ValueFloat();
-				}
-				mesh_normals.push_back(normal);
+				mesh.pos_bb = ReadBoundingBox(reader, 3);
+				mesh.has_pos_bb = true;
 			}
-
-			XMLNodePtr tangent_node = vertex_node->FirstNode("tangent");
-			if (tangent_node)
+			else if ("tc_bb" == name)
 			{
-				has_tangent = true;
-
-				float4 tangent;
-				XMLAttributePtr attr = tangent_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<4>(attr->ValueString(), &tangent[0]);
-				}
-				else
-				{
-					tangent.x() = tangent_node->Attrib("x")->ValueFloat();
-					tangent.y() = tangent_node->Attrib("y")->ValueFloat();
-					tangent.z() = tangent_node->Attrib("z")->ValueFloat();
-					attr = tangent_node->Attrib("w");
-					if (attr)
-					{
-						tangent.w() = attr->ValueFloat();
-					}
-					else
-					{
-						tangent.w() = 1;
-					}
-				}
-				mesh_tangents.push_back(tangent);
+				mesh.tc_bb = ReadBoundingBox(reader, 2);
+				mesh.has_tc_bb = true;
 			}
-
-			XMLNodePtr binormal_node = vertex_node->FirstNode("binormal");
-			if (binormal_node)
+			else
 			{
-				has_binormal = true;
+				reader.Skip();
+			}
+		}
+	}
 
-				float3 binormal;
-				XMLAttributePtr attr = binormal_node->Attrib("v");
-				if (attr)
+	void ReadMeshTrianglesChunk(MeshMLReader& reader, MeshMLMesh& mesh)
+	{
+		mesh.has_triangles = true;
+
+		while (MeshMLReader::TT_StartElement == reader.Next())
+		{
+			if ("triangle" == reader.Name())
+			{
+				uint32_t ind[3];
+				if (reader.HasAttrib("index"))
 				{
-					ExtractFVector<3>(attr->ValueString(), &binormal[0]);
+					reader.AttribUInts("index", ind, 3);
 				}
 				else
 				{
-					binormal.x() = binormal_node->Attrib("x")->ValueFloat();
-					binormal.y() = binormal_node->Attrib("y")->ValueFloat();
-					binormal.z() = binormal_node->Attrib("z")->ValueFloat();
+					ind[0] = reader.AttribUInt("a", 0);
+					ind[1] = reader.AttribUInt("b", 0);
+					ind[2] = reader.AttribUInt("c", 0);
 				}
-				mesh_binormals.push_back(binormal);
+				mesh.indices.push_back(ind[0]);
+				mesh.indices.push_back(ind[1]);
+				mesh.indices.push_back(ind[2]);
 			}
 
-			XMLNodePtr tangent_quat_node = vertex_node->FirstNode("tangent_quat");
-			if (tangent_quat_node)
-			{
-				has_tangent_quat = true;
+			reader.Skip();
+		}
+	}
 
-				Quaternion tangent_quat;
-				XMLAttributePtr const & attr = tangent_quat_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<4>(attr->ValueString(), &tangent_quat[0]);
-				}
-				else
-				{
-					tangent_quat.x() = tangent_quat_node->Attrib("x")->ValueFloat();
-					tangent_quat.y() = tangent_quat_node->Attrib("y")->ValueFloat();
-					tangent_quat.z() = tangent_quat_node->Attrib("z")->ValueFloat();
-					tangent_quat.w() = tangent_quat_node->Attrib("w")->ValueFloat();
-				}
-				mesh_tangent_quats.push_back(tangent_quat);
+	void ReadMesh(MeshMLReader& reader, MeshMLMesh& mesh)
+	{
+		mesh.name = reader.AttribString("name", "");
+		mesh.mtl_id = reader.AttribInt("mtl_id", 0);
+
+		while (MeshMLReader::TT_StartElement == reader.Next())
+		{
+			std::string_view const name = reader.Name();
+			if (("vertices_chunk" == name) && !mesh.has_vertices)
+			{
+				ReadMeshVerticesChunk(reader, mesh);
+			}
+			else if (("triangles_chunk" == name) && !mesh.has_triangles)
+			{
+				ReadMeshTrianglesChunk(reader, mesh);
+			}
+			else
+			{
+				reader.Skip();
 			}
 		}
+	}
+
+	void CompileMeshesVerticesChunk(MeshMLMesh& mesh,
+		AABBox& pos_bb, AABBox& tc_bb, std::vector<VertexElement>& vertex_elements,
+		std::vector<int16_t>& positions, std::vector<uint32_t>& normals,
+		std::vector<uint32_t>& tangent_quats, 
+		std::vector<uint32_t>& diffuses, std::vector<uint32_t>& speculars,
+		std::vector<int16_t>& tex_coords, 
+		std::vector<uint32_t>& bone_indices, std::vector<uint32_t>& bone_weights)
+	{
+		pos_bb = mesh.pos_bb;
+		tc_bb = mesh.tc_bb;
+		bool const recompute_pos_bb = !mesh.has_pos_bb;
+		bool const recompute_tc_bb = !mesh.has_tc_bb;
 
 		bool recompute_tangent_quat = false;
 
@@ -848,7 +833,7 @@ namespace
 				vertex_elements.push_back(ve);
 			}
 
-			if (has_diffuse)
+			if (mesh.has_diffuse)
 			{
 				ve.usage = VEU_Diffuse;
 				ve.usage_index = 0;
@@ -856,7 +841,7 @@ namespace
 				vertex_elements.push_back(ve);
 			}
 
-			if (has_specular)
+			if (mesh.has_specular)
 			{
 				ve.usage = VEU_Specular;
 				ve.usage_index = 0;
@@ -864,7 +849,7 @@ namespace
 				vertex_elements.push_back(ve);
 			}
 
-			if (has_weight)
+			if (mesh.has_weight)
 			{
 				ve.usage = VEU_BlendWeight;
 				ve.usage_index = 0;
@@ -877,7 +862,7 @@ namespace
 				vertex_elements.push_back(ve);
 			}
 
-			if (has_tex_coord)
+			if (mesh.has_tex_coord)
 			{
 				ve.usage = VEU_TextureCoord;
 				ve.usage_index = 0;
@@ -885,7 +870,7 @@ namespace
 				vertex_elements.push_back(ve);
 			}
 
-			if (has_tangent_quat)
+			if (mesh.has_tangent_quat)
 			{
 				ve.usage = VEU_Tangent;
 				ve.usage_index = 0;
@@ -894,7 +879,7 @@ namespace
 			}
 			else
 			{
-				if (has_normal && !has_tangent && !has_binormal)
+				if (mesh.has_normal && !mesh.has_tangent && !mesh.has_binormal)
 				{
 					ve.usage = VEU_Normal;
 					ve.usage_index = 0;
@@ -903,15 +888,15 @@ namespace
 				}
 				else
 				{
-					if ((has_normal && has_tangent) || (has_normal && has_binormal)
-						|| (has_tangent && has_binormal))
+					if ((mesh.has_normal && mesh.has_tangent) || (mesh.has_normal && mesh.has_binormal)
+						|| (mesh.has_tangent && mesh.has_binormal))
 					{
 						ve.usage = VEU_Tangent;
 						ve.usage_index = 0;
 						ve.format = EF_ABGR8;
 						vertex_elements.push_back(ve);
 
-						if (!has_tangent_quat)
+						if (!mesh.has_tangent_quat)
 						{
 							recompute_tangent_quat = true;
 						}
@@ -922,10 +907,10 @@ namespace
 
 		if (recompute_pos_bb)
 		{
-			for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
+			float3 pos_min_bb, pos_max_bb;
+			for (uint32_t index = 0; index < mesh.positions.size(); ++ index)
 			{
-				float3 pos_min_bb, pos_max_bb;
-				float3 const & pos = mesh_positions[index];
+				float3 const & pos = mesh.positions[index];
 				if (0 == index)
 				{
 					pos_min_bb = pos_max_bb = pos;
@@ -941,10 +926,10 @@ namespace
 		}
 		if (recompute_tc_bb)
 		{
-			for (uint32_t index = 0; index < mesh_tex_coords.size(); ++ index)
+			float3 tc_min_bb, tc_max_bb;
+			for (uint32_t index = 0; index < mesh.tex_coords.size(); ++ index)
 			{
-				float3 tc_min_bb, tc_max_bb;
-				float3 tex_coord = float3(mesh_tex_coords[index].x(), mesh_tex_coords[index].y(), 0.0f);
+				float3 tex_coord = float3(mesh.tex_coords[index].x(), mesh.tex_coords[index].y(), 0.0f);
 				if (0 == index)
 				{
 					tc_min_bb = tc_max_bb = tex_coord;
@@ -960,44 +945,44 @@ namespace
 		}
 		if (recompute_tangent_quat)
 		{
-			mesh_tangent_quats.resize(mesh_positions.size());
-			for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
+			mesh.tangent_quats.resize(mesh.positions.size());
+			for (uint32_t index = 0; index < mesh.positions.size(); ++ index)
 			{
 				float3 tangent, binormal, normal;
-				if (has_tangent)
+				if (mesh.has_tangent)
 				{
-					tangent = float3(mesh_tangents[index].x(), mesh_tangents[index].y(),
-						mesh_tangents[index].z());
+					tangent = float3(mesh.tangents[index].x(), mesh.tangents[index].y(),
+						mesh.tangents[index].z());
 				}
-				if (has_binormal)
+				if (mesh.has_binormal)
 				{
-					binormal = mesh_binormals[index];
+					binormal = mesh.binormals[index];
 				}
-				if (has_normal)
+				if (mesh.has_normal)
 				{
-					normal = mesh_normals[index];
+					normal = mesh.normals[index];
 				}
 
-				if (!has_tangent)
+				if (!mesh.has_tangent)
 				{
-					BOOST_ASSERT(has_binormal && has_normal);
+					BOOST_ASSERT(mesh.has_binormal && mesh.has_normal);
 
 					tangent = MathLib::cross(binormal, normal);
 				}
-				if (!has_binormal)
+				if (!mesh.has_binormal)
 				{
-					BOOST_ASSERT(has_tangent && has_normal);
+					BOOST_ASSERT(mesh.has_tangent && mesh.has_normal);
 
-					binormal = MathLib::cross(normal, tangent) * mesh_tangents[index].w();
+					binormal = MathLib::cross(normal, tangent) * mesh.tangents[index].w();
 				}
-				if (!has_normal)
+				if (!mesh.has_normal)
 				{
-					BOOST_ASSERT(has_tangent && has_binormal);
+					BOOST_ASSERT(mesh.has_tangent && mesh.has_binormal);
 
 					normal = MathLib::cross(tangent, binormal);
 				}
 
-				mesh_tangent_quats[index] = MathLib::to_quaternion(tangent, binormal, normal, 8);
+				mesh.tangent_quats[index] = MathLib::to_quaternion(tangent, binormal, normal, 8);
 			}
 		}
 
@@ -1006,9 +991,9 @@ namespace
 		float3 const tc_center = tc_bb.Center();
 		float3 const tc_extent = tc_bb.HalfSize();
 
-		for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
+		for (uint32_t index = 0; index < mesh.positions.size(); ++ index)
 		{
-			float3 pos = mesh_positions[index];
+			float3 pos = mesh.positions[index];
 			pos = (pos - pos_center) / pos_extent * 0.5f + 0.5f;
 			int16_t s_pos[4] = 
 			{
@@ -1023,27 +1008,27 @@ namespace
 			positions.push_back(s_pos[2]);
 			positions.push_back(s_pos[3]);
 		}
-		for (uint32_t index = 0; index < mesh_diffuses.size(); ++ index)
+		for (uint32_t index = 0; index < mesh.diffuses.size(); ++ index)
 		{
-			float4 const & diffuse = mesh_diffuses[index];
+			float4 const & diffuse = mesh.diffuses[index];
 			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.w() * 0.5f + 0.5f) * 255), 0, 255) << 24);
 			diffuses.push_back(compact);
 		}
-		for (uint32_t index = 0; index < mesh_speculars.size(); ++ index)
+		for (uint32_t index = 0; index < mesh.speculars.size(); ++ index)
 		{
-			float3 const & specular = mesh_speculars[index];
+			float3 const & specular = mesh.speculars[index];
 			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
 				| 0xFF000000;
 			speculars.push_back(compact);
 		}
-		for (uint32_t index = 0; index < mesh_tex_coords.size(); ++ index)
+		for (uint32_t index = 0; index < mesh.tex_coords.size(); ++ index)
 		{
-			float3 tex_coord = float3(mesh_tex_coords[index].x(), mesh_tex_coords[index].y(), 0.0f);
+			float3 tex_coord = float3(mesh.tex_coords[index].x(), mesh.tex_coords[index].y(), 0.0f);
 			tex_coord = (tex_coord - tc_center) / tc_extent * 0.5f + 0.5f;
 			int16_t s_tc[2] = 
 			{
@@ -1054,54 +1039,37 @@ namespace
 			tex_coords.push_back(s_tc[0]);
 			tex_coords.push_back(s_tc[1]);
 		}
-		for (uint32_t index = 0; index < mesh_tangent_quats.size(); ++ index)
+		for (uint32_t index = 0; index < mesh.tangent_quats.size(); ++ index)
 		{
-			Quaternion const & tangent_quat = mesh_tangent_quats[index];
+			Quaternion const & tangent_quat = mesh.tangent_quats[index];
 			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.w() * 0.5f + 0.5f) * 255), 0, 255) << 24);
 			tangent_quats.push_back(compact);
 		}
-		for (uint32_t index = 0; index < mesh_normals.size(); ++ index)
+		for (uint32_t index = 0; index < mesh.normals.size(); ++ index)
 		{
-			float3 const normal = MathLib::normalize(mesh_normals[index]) * 0.5f + 0.5f;
+			float3 const normal = MathLib::normalize(mesh.normals[index]) * 0.5f + 0.5f;
 			uint32_t compact = MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.x() * 255), 0, 255)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.y() * 255), 0, 255) << 8)
 				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.z() * 255), 0, 255) << 16);
 			normals.push_back(compact);					
 		}
-		bone_indices = mesh_bone_indices;
-		bone_weights = mesh_bone_weights;
+		bone_indices = mesh.bone_indices;
+		bone_weights = mesh.bone_weights;
 	}
 
-	void CompileMeshesTrianglesChunk(XMLNodePtr const & triangles_chunk,
+	void CompileMeshesTrianglesChunk(std::vector<uint32_t> const & mesh_triangle_indices,
 		std::vector<uint8_t>& triangle_indices, char& is_index_16)
 	{
-		std::vector<uint32_t> mesh_triangle_indices;
-
 		is_index_16 = true;
-		for (XMLNodePtr tri_node = triangles_chunk->FirstNode("triangle"); tri_node; tri_node = tri_node->NextSibling("triangle"))
+		for (auto const ind : mesh_triangle_indices)
 		{
-			uint32_t ind[3];
-			XMLAttributePtr attr = tri_node->Attrib("index");
-			if (attr)
-			{
-				ExtractUIVector<3>(attr->ValueString(), &ind[0]);
-			}
-			else
-			{
-				ind[0] = tri_node->Attrib("a")->ValueUInt();
-				ind[1] = tri_node->Attrib("b")->ValueUInt();
-				ind[2] = tri_node->Attrib("c")->ValueUInt();
-			}
-			mesh_triangle_indices.push_back(ind[0]);
-			mesh_triangle_indices.push_back(ind[1]);
-			mesh_triangle_indices.push_back(ind[2]);
-
-			if ((ind[0] > 0xFFFF) || (ind[1] > 0xFFFF) || (ind[2] > 0xFFFF))
+			if (ind > 0xFFFF)
 			{
 				is_index_16 = false;
+				break;
 			}
 		}
 
@@ -1117,7 +1085,7 @@ namespace
 		else
 		{
 			triangle_indices.resize(mesh_triangle_indices.size() * 4);
-			std::memcpy(&triangle_indices[0], &mesh_triangle_indices[0], triangle_indices.size());
+			std::memcpy(triangle_indices.data(), mesh_triangle_indices.data(), triangle_indices.size());
 		}
 	}
 
@@ -1328,7 +1296,30 @@ namespace
 		}
 	}
 
-	void CompileMeshesChunk(XMLNodePtr const & meshes_chunk,
+	void CompileMesh(MeshMLMesh& mesh, CompiledMesh& compiled)
+	{
+		compiled.has_vertices = mesh.has_vertices;
+		if (mesh.has_vertices)
+		{
+			CompileMeshesVerticesChunk(mesh,
+				compiled.pos_bb, compiled.tc_bb, compiled.ves,
+				compiled.positions, compiled.normals, compiled.tangent_quats,
+				compiled.diffuses, compiled.speculars, compiled.tex_coords,
+				compiled.bone_indices, compiled.bone_weights);
+		}
+
+		compiled.has_triangles = mesh.has_triangles;
+		compiled.is_index_16 = true;
+		if (mesh.has_triangles)
+		{
+			CompileMeshesTrianglesChunk(mesh.indices,
+				compiled.triangle_indices, compiled.is_index_16);
+		}
+	}
+
+	// Meshes are read one by one from the stream, and packed on the thread pool while the next one is being read.
+	//   The number of meshes in flight is limited, so the memory doesn't grow with the file size.
+	void CompileMeshesChunk(MeshMLReader& reader,
 		std::vector<std::string>& mesh_names, std::vector<int32_t>& mtl_ids,
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs, 
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
@@ -1338,6 +1329,8 @@ namespace
 	{
 		mesh_names.clear();
 		mtl_ids.clear();
+		pos_bbs.clear();
+		tc_bbs.clear();
 
 		mesh_num_vertices.clear();
 		mesh_num_indices.clear();
@@ -1348,64 +1341,65 @@ namespace
 		merged_indices.clear();
 		is_index_16_bit = true;
 
-		std::vector<VertexElement> ves;
-		std::vector<int16_t> positions;
-		std::vector<uint32_t> normals;
-		std::vector<uint32_t> tangent_quats;
-		std::vector<uint32_t> diffuses;
-		std::vector<uint32_t> speculars;
-		std::vector<int16_t> tex_coords;
-		std::vector<uint32_t> bone_indices;
-		std::vector<uint32_t> bone_weights;
-		std::vector<uint8_t> triangle_indices;
+		auto append_mesh = [&](CompiledMesh const & compiled)
+		{
+			pos_bbs.push_back(compiled.pos_bb);
+			tc_bbs.push_back(compiled.tc_bb);
 
-		uint32_t mesh_index = 0;
-		for (XMLNodePtr mesh_node = meshes_chunk->FirstNode("mesh"); mesh_node; mesh_node = mesh_node->NextSibling("mesh"), ++ mesh_index)
-		{
-			mesh_names.push_back(mesh_node->Attrib("name")->ValueString());
-			mtl_ids.push_back(mesh_node->Attrib("mtl_id")->ValueInt());
-
-			pos_bbs.resize(mesh_index + 1);
-			tc_bbs.resize(pos_bbs.size());
-
-			ves.clear();
-			positions.clear();
-			normals.clear();
-			tangent_quats.clear();
-			diffuses.clear();
-			speculars.clear();
-			tex_coords.clear();
-			bone_indices.clear();
-			bone_weights.clear();
-
-			XMLNodePtr vertices_chunk = mesh_node->FirstNode("vertices_chunk");
-			if (vertices_chunk)
-			{
-				CompileMeshesVerticesChunk(vertices_chunk,
-					pos_bbs[mesh_index], tc_bbs[mesh_index], ves,
-					positions, normals,	tangent_quats,
-					diffuses, speculars, tex_coords,
-					bone_indices, bone_weights);
-				AppendMeshVertices(ves,
-					positions, normals, tangent_quats, 
-					diffuses, speculars, tex_coords, 
-					bone_indices, bone_weights,
+			if (compiled.has_vertices)
+			{
+				AppendMeshVertices(compiled.ves,
+					compiled.positions, compiled.normals, compiled.tangent_quats, 
+					compiled.diffuses, compiled.speculars, compiled.tex_coords, 
+					compiled.bone_indices, compiled.bone_weights,
 					mesh_num_vertices, mesh_base_vertices,
 					merged_ves, merged_vertices);
 			}
-
-			triangle_indices.clear();
-
-			XMLNodePtr triangles_chunk = mesh_node->FirstNode("triangles_chunk");
-			if (triangles_chunk)
+			if (compiled.has_triangles)
 			{
-				char is_index_16s = true;
-				CompileMeshesTrianglesChunk(triangles_chunk,
-					triangle_indices, is_index_16s);
-				AppendMeshIndices(triangle_indices, is_index_16s,
+				AppendMeshIndices(compiled.triangle_indices, compiled.is_index_16,
 					mesh_num_indices, mesh_start_indices, merged_indices,
 					is_index_16_bit);
 			}
+		};
+
+		size_t const max_meshes_in_flight = std::max(std::thread::hardware_concurrency(), 1U);
+		std::deque<std::pair<std::shared_ptr<CompiledMesh>, joiner<void>>> meshes_in_flight;
+		while (MeshMLReader::TT_StartElement == reader.Next())
+		{
+			if ("mesh" == reader.Name())
+			{
+				auto mesh = MakeSharedPtr<MeshMLMesh>();
+				ReadMesh(reader, *mesh);
+
+				mesh_names.push_back(mesh->name);
+				mtl_ids.push_back(mesh->mtl_id);
+
+				if (meshes_in_flight.size() == max_meshes_in_flight)
+				{
+					meshes_in_flight.front().second();
+					append_mesh(*meshes_in_flight.front().first);
+					meshes_in_flight.pop_front();
+				}
+
+				auto compiled = MakeSharedPtr<CompiledMesh>();
+				meshes_in_flight.emplace_back(compiled, Context::Instance().ThreadPool()(
+					[mesh, compiled]
+					{
+						CompileMesh(*mesh, *compiled);
+						*mesh = MeshMLMesh();
+					}));
+			}
+			else
+			{
+				reader.Skip();
+			}
+		}
+
+		for (auto& mesh : meshes_in_flight)
+		{
+			mesh.second();
+			append_mesh(*mesh.first);
 		}
 
 		if (is_index_16_bit)
@@ -1421,6 +1415,383 @@ namespace
 		}
 	}
 
+	// Chunks other than meshes are small, they still go through XMLDocument
+	XMLNodePtr ParseChunk(MeshMLReader& reader, KlayGE::XMLDocument& doc)
+	{
+		std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>(reader.ReadElement());
+		return doc.Parse(MakeSharedPtr<ResIdentifier>(reader.Name(), 0, ss));
+	}
+
+	uint32_t FindPositionStream(std::vector<VertexElement> const & merged_ves)
+	{
+		for (uint32_t i = 0; i < merged_ves.size(); ++ i)
+		{
+			if ((VEU_Position == merged_ves[i].usage) && (EF_SIGNED_ABGR16 == merged_ves[i].format))
+			{
+				return i;
+			}
+		}
+		return static_cast<uint32_t>(merged_ves.size());
+	}
+
+	void ReadMergedIndices(std::vector<uint8_t> const & merged_indices, uint32_t start_index, uint32_t num_indices,
+		char is_index_16_bit, std::vector<uint32_t>& indices)
+	{
+		uint32_t const index_size = is_index_16_bit ? 2 : 4;
+		indices.resize(num_indices);
+		for (uint32_t i = 0; i < num_indices; ++ i)
+		{
+			uint8_t const * src = &merged_indices[(start_index + i) * index_size];
+			if (is_index_16_bit)
+			{
+				uint16_t ind16;
+				std::memcpy(&ind16, src, sizeof(ind16));
+				indices[i] = LE2Native(ind16);
+			}
+			else
+			{
+				uint32_t ind32;
+				std::memcpy(&ind32, src, sizeof(ind32));
+				indices[i] = ind32;
+			}
+		}
+	}
+
+	void AppendMergedIndices(std::vector<uint32_t> const & indices, char is_index_16_bit, std::vector<uint8_t>& merged_indices)
+	{
+		uint32_t const index_size = is_index_16_bit ? 2 : 4;
+		size_t const start = merged_indices.size();
+		merged_indices.resize(start + indices.size() * index_size);
+		for (uint32_t i = 0; i < indices.size(); ++ i)
+		{
+			if (is_index_16_bit)
+			{
+				uint16_t const ind16 = Native2LE(static_cast<uint16_t>(indices[i]));
+				std::memcpy(&merged_indices[start + i * index_size], &ind16, sizeof(ind16));
+			}
+			else
+			{
+				std::memcpy(&merged_indices[start + i * index_size], &indices[i], sizeof(indices[i]));
+			}
+		}
+	}
+
+	// The inverse of the quantization in CompileMeshesVerticesChunk
+	float3 DequantizePosition(uint8_t const * src, AABBox const & pos_bb)
+	{
+		float3 const pos_center = pos_bb.Center();
+		float3 const pos_extent = pos_bb.HalfSize();
+
+		int16_t s_pos[3];
+		std::memcpy(s_pos, src, sizeof(s_pos));
+		float3 pos;
+		for (int j = 0; j < 3; ++ j)
+		{
+			float const t = (LE2Native(s_pos[j]) + 32768) / 65535.0f;
+			pos[j] = (t - 0.5f) * 2 * pos_extent[j] + pos_center[j];
+		}
+		return pos;
+	}
+
+	void OptimizeMeshesChunk(std::vector<AABBox> const & pos_bbs,
+		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
+		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_start_indices,
+		std::vector<VertexElement> const & merged_ves, std::vector<std::vector<uint8_t>>& merged_vertices,
+		std::vector<uint8_t>& merged_indices, char is_index_16_bit, bool quiet)
+	{
+		uint32_t const num_meshes = static_cast<uint32_t>(pos_bbs.size());
+		if ((mesh_num_vertices.size() != num_meshes) || (mesh_num_indices.size() != num_meshes))
+		{
+			// Some meshes have no vertices or triangles
+			return;
+		}
+
+		uint32_t const pos_stream = FindPositionStream(merged_ves);
+		if (pos_stream == merged_ves.size())
+		{
+			return;
+		}
+
+		std::vector<std::vector<uint8_t>> new_vertices(merged_vertices.size());
+		std::vector<uint8_t> new_indices;
+		std::vector<uint32_t> new_num_vertices(num_meshes);
+		std::vector<uint32_t> new_num_indices(num_meshes);
+
+		std::vector<uint8_t const *> streams(merged_vertices.size());
+		std::vector<uint32_t> strides(merged_vertices.size());
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> weld_remap;
+		std::vector<uint32_t> fetch_remap;
+		std::vector<uint32_t> cluster_starts;
+		std::vector<float3> positions;
+
+		uint32_t total_triangles_before = 0;
+		uint32_t total_triangles_after = 0;
+		uint32_t total_vertices_before = 0;
+		uint32_t total_vertices_after = 0;
+		float total_misses_before = 0;
+		float total_misses_after = 0;
+		for (uint32_t mesh_index = 0; mesh_index < num_meshes; ++ mesh_index)
+		{
+			uint32_t const num_vertices = mesh_num_vertices[mesh_index];
+			uint32_t const base_vertex = mesh_base_vertices[mesh_index];
+
+			ReadMergedIndices(merged_indices, mesh_start_indices[mesh_index], mesh_num_indices[mesh_index],
+				is_index_16_bit, indices);
+
+			VertexCacheStats const stats_before = AnalyzeVertexCache(indices, num_vertices, VERTEX_CACHE_SIZE);
+			total_triangles_before += static_cast<uint32_t>(indices.size() / 3);
+			total_vertices_before += num_vertices;
+			total_misses_before += stats_before.acmr * (indices.size() / 3);
+
+			for (size_t s = 0; s < merged_vertices.size(); ++ s)
+			{
+				strides[s] = merged_ves[s].element_size();
+				streams[s] = &merged_vertices[s][base_vertex * strides[s]];
+			}
+			uint32_t const num_welded = WeldVertices(indices, weld_remap, streams, strides, num_vertices);
+
+			positions.resize(num_welded);
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				positions[weld_remap[v]] = DequantizePosition(streams[pos_stream] + v * strides[pos_stream], pos_bbs[mesh_index]);
+			}
+
+			OptimizeVertexCache(indices, cluster_starts, num_welded, VERTEX_CACHE_SIZE);
+			OptimizeOverdraw(indices, cluster_starts, positions);
+			uint32_t const num_used = OptimizeVertexFetch(indices, fetch_remap, num_welded);
+
+			VertexCacheStats const stats_after = AnalyzeVertexCache(indices, num_used, VERTEX_CACHE_SIZE);
+			total_triangles_after += static_cast<uint32_t>(indices.size() / 3);
+			total_vertices_after += num_used;
+			total_misses_after += stats_after.acmr * (indices.size() / 3);
+
+			for (size_t s = 0; s < merged_vertices.size(); ++ s)
+			{
+				uint32_t const stride = strides[s];
+				size_t const new_base = new_vertices[s].size();
+				new_vertices[s].resize(new_base + num_used * stride);
+				for (uint32_t v = 0; v < num_vertices; ++ v)
+				{
+					uint32_t const new_v = fetch_remap[weld_remap[v]];
+					if (new_v != 0xFFFFFFFF)
+					{
+						std::memcpy(&new_vertices[s][new_base + new_v * stride], streams[s] + v * stride, stride);
+					}
+				}
+			}
+
+			AppendMergedIndices(indices, is_index_16_bit, new_indices);
+
+			new_num_vertices[mesh_index] = num_used;
+			new_num_indices[mesh_index] = static_cast<uint32_t>(indices.size());
+		}
+
+		merged_vertices.swap(new_vertices);
+		merged_indices.swap(new_indices);
+		mesh_num_vertices.swap(new_num_vertices);
+		mesh_num_indices.swap(new_num_indices);
+		for (uint32_t mesh_index = 0; mesh_index < num_meshes; ++ mesh_index)
+		{
+			mesh_base_vertices[mesh_index + 1] = mesh_base_vertices[mesh_index] + mesh_num_vertices[mesh_index];
+			mesh_start_indices[mesh_index + 1] = mesh_start_indices[mesh_index] + mesh_num_indices[mesh_index];
+		}
+
+		if (!quiet)
+		{
+			float const acmr_before = total_triangles_before ? total_misses_before / total_triangles_before : 0;
+			float const acmr_after = total_triangles_after ? total_misses_after / total_triangles_after : 0;
+			float const atvr_before = total_vertices_before ? total_misses_before / total_vertices_before : 0;
+			float const atvr_after = total_vertices_after ? total_misses_after / total_vertices_after : 0;
+			cout << "Vertices: " << total_vertices_before << " -> " << total_vertices_after
+				<< ", triangles: " << total_triangles_before << " -> " << total_triangles_after << endl;
+			cout << "ACMR: " << acmr_before << " -> " << acmr_after
+				<< ", ATVR: " << atvr_before << " -> " << atvr_after
+				<< " (" << VERTEX_CACHE_SIZE << " entries FIFO cache)" << endl;
+		}
+	}
+
+	// Every LOD halves the triangles of the previous one. The LODs share the vertices of LOD 0, their indices are
+	// appended to merged_indices.
+	void GenerateLodsChunk(uint32_t num_lods, std::vector<AABBox> const & pos_bbs,
+		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
+		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
+		std::vector<VertexElement> const & merged_ves, std::vector<std::vector<uint8_t>> const & merged_vertices,
+		std::vector<uint8_t>& merged_indices, char is_index_16_bit,
+		std::vector<std::vector<uint32_t>>& mesh_lod_num_indices, std::vector<std::vector<uint32_t>>& mesh_lod_start_indices,
+		bool optimize, bool quiet)
+	{
+		uint32_t const num_meshes = static_cast<uint32_t>(pos_bbs.size());
+		mesh_lod_num_indices.assign(num_meshes, std::vector<uint32_t>());
+		mesh_lod_start_indices.assign(num_meshes, std::vector<uint32_t>());
+		if ((num_lods <= 1) || (mesh_num_vertices.size() != num_meshes) || (mesh_num_indices.size() != num_meshes))
+		{
+			return;
+		}
+
+		uint32_t const pos_stream = FindPositionStream(merged_ves);
+		if (pos_stream == merged_ves.size())
+		{
+			return;
+		}
+		uint32_t blend_index_stream = static_cast<uint32_t>(merged_ves.size());
+		for (uint32_t i = 0; i < merged_ves.size(); ++ i)
+		{
+			if (VEU_BlendIndex == merged_ves[i].usage)
+			{
+				blend_index_stream = i;
+				break;
+			}
+		}
+
+		uint32_t const index_size = is_index_16_bit ? 2 : 4;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> lod_indices;
+		std::vector<uint32_t> cluster_starts;
+		std::vector<float3> positions;
+		std::vector<uint32_t> collapse_groups;
+		std::vector<uint32_t> total_lod_indices(num_lods, 0);
+		for (uint32_t mesh_index = 0; mesh_index < num_meshes; ++ mesh_index)
+		{
+			uint32_t const num_vertices = mesh_num_vertices[mesh_index];
+			uint32_t const base_vertex = mesh_base_vertices[mesh_index];
+
+			ReadMergedIndices(merged_indices, mesh_start_indices[mesh_index], mesh_num_indices[mesh_index],
+				is_index_16_bit, indices);
+			total_lod_indices[0] += static_cast<uint32_t>(indices.size());
+
+			uint32_t const pos_stride = merged_ves[pos_stream].element_size();
+			positions.resize(num_vertices);
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				positions[v] = DequantizePosition(&merged_vertices[pos_stream][(base_vertex + v) * pos_stride],
+					pos_bbs[mesh_index]);
+			}
+
+			// A vertex only collapses onto one bound to the same joints
+			collapse_groups.clear();
+			if (blend_index_stream != merged_ves.size())
+			{
+				uint32_t const stride = merged_ves[blend_index_stream].element_size();
+				std::unordered_map<std::string, uint32_t> joint_sets;
+				collapse_groups.resize(num_vertices);
+				for (uint32_t v = 0; v < num_vertices; ++ v)
+				{
+					char const * src = reinterpret_cast<char const *>(&merged_vertices[blend_index_stream][(base_vertex + v) * stride]);
+					collapse_groups[v] = joint_sets.emplace(std::string(src, stride),
+						static_cast<uint32_t>(joint_sets.size())).first->second;
+				}
+			}
+
+			lod_indices = indices;
+			for (uint32_t lod = 1; lod < num_lods; ++ lod)
+			{
+				size_t const prev_num_indices = lod_indices.size();
+				SimplifyMesh(lod_indices, positions, collapse_groups, static_cast<uint32_t>(prev_num_indices / 6 * 3));
+				if (lod_indices.empty() || (lod_indices.size() * 5 > prev_num_indices * 4))
+				{
+					// Too few triangles could be removed. It's not worth another LOD.
+					break;
+				}
+
+				if (optimize)
+				{
+					OptimizeVertexCache(lod_indices, cluster_starts, num_vertices, VERTEX_CACHE_SIZE);
+				}
+
+				mesh_lod_num_indices[mesh_index].push_back(static_cast<uint32_t>(lod_indices.size()));
+				mesh_lod_start_indices[mesh_index].push_back(static_cast<uint32_t>(merged_indices.size() / index_size));
+				AppendMergedIndices(lod_indices, is_index_16_bit, merged_indices);
+				total_lod_indices[lod] += static_cast<uint32_t>(lod_indices.size());
+			}
+		}
+
+		if (!quiet)
+		{
+			cout << "LOD triangles:";
+			for (uint32_t lod = 0; lod < num_lods; ++ lod)
+			{
+				cout << ' ' << total_lod_indices[lod] / 3;
+			}
+			cout << endl;
+		}
+	}
+
+	// Clusters are runs of LOD 0 triangles in the order they are drawn, so a set of visible clusters is still a few
+	// index ranges. A mesh that fits in one cluster has none.
+	void BuildClustersChunk(std::vector<AABBox> const & pos_bbs,
+		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
+		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
+		std::vector<VertexElement> const & merged_ves, std::vector<std::vector<uint8_t>> const & merged_vertices,
+		std::vector<uint8_t> const & merged_indices, char is_index_16_bit,
+		std::vector<std::vector<MeshCluster>>& mesh_clusters, bool quiet)
+	{
+		uint32_t const num_meshes = static_cast<uint32_t>(pos_bbs.size());
+		mesh_clusters.assign(num_meshes, std::vector<MeshCluster>());
+		if ((mesh_num_vertices.size() != num_meshes) || (mesh_num_indices.size() != num_meshes))
+		{
+			return;
+		}
+
+		uint32_t const pos_stream = FindPositionStream(merged_ves);
+		if (pos_stream == merged_ves.size())
+		{
+			return;
+		}
+
+		// Skinned vertices move with their joints. Bounds and cones from the bind pose would cull visible triangles.
+		for (auto const & ve : merged_ves)
+		{
+			if ((VEU_BlendWeight == ve.usage) || (VEU_BlendIndex == ve.usage))
+			{
+				return;
+			}
+		}
+
+		std::vector<uint32_t> indices;
+		std::vector<float3> positions;
+		std::vector<Meshlet> meshlets;
+		uint32_t total_clusters = 0;
+		for (uint32_t mesh_index = 0; mesh_index < num_meshes; ++ mesh_index)
+		{
+			uint32_t const num_vertices = mesh_num_vertices[mesh_index];
+			uint32_t const base_vertex = mesh_base_vertices[mesh_index];
+
+			ReadMergedIndices(merged_indices, mesh_start_indices[mesh_index], mesh_num_indices[mesh_index],
+				is_index_16_bit, indices);
+
+			uint32_t const pos_stride = merged_ves[pos_stream].element_size();
+			positions.resize(num_vertices);
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				positions[v] = DequantizePosition(&merged_vertices[pos_stream][(base_vertex + v) * pos_stride],
+					pos_bbs[mesh_index]);
+			}
+
+			BuildMeshlets(meshlets, indices, positions, MAX_CLUSTER_VERTICES, MAX_CLUSTER_TRIANGLES);
+			if (meshlets.size() > 1)
+			{
+				auto& clusters = mesh_clusters[mesh_index];
+				clusters.resize(meshlets.size());
+				for (size_t i = 0; i < meshlets.size(); ++ i)
+				{
+					clusters[i].start_index = mesh_start_indices[mesh_index] + meshlets[i].first_triangle * 3;
+					clusters[i].num_indices = meshlets[i].num_triangles * 3;
+					clusters[i].center = meshlets[i].center;
+					clusters[i].radius = meshlets[i].radius;
+					clusters[i].cone_axis = meshlets[i].cone_axis;
+					clusters[i].cone_cutoff = meshlets[i].cone_cutoff;
+				}
+				total_clusters += static_cast<uint32_t>(clusters.size());
+			}
+		}
+
+		if (!quiet)
+		{
+			cout << "Clusters: " << total_clusters << endl;
+		}
+	}
+
 	void CompileBonesChunk(XMLNodePtr const & bones_chunk,
 		std::vector<Joint>& joints)
 	{
@@ -1801,6 +2172,9 @@ namespace
 		std::vector<AABBox> const & pos_bbs, std::vector<AABBox> const & tc_bbs,
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
+		std::vector<std::vector<uint32_t>> const & mesh_lod_num_indices,
+		std::vector<std::vector<uint32_t>> const & mesh_lod_start_indices,
+		std::vector<std::vector<MeshCluster>> const & mesh_clusters,
 		std::vector<VertexElement> const & merged_ves,
 		std::vector<std::vector<uint8_t>> const & merged_vertices, std::vector<uint8_t> const & merged_indices,
 		char is_index_16_bit, std::ostream& os)
@@ -1817,7 +2191,7 @@ namespace
 
 		uint32_t num_vertices = Native2LE(mesh_base_vertices.back());
 		os.write(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
-		uint32_t num_indices = Native2LE(mesh_start_indices.back());
+		uint32_t num_indices = Native2LE(static_cast<uint32_t>(merged_indices.size() / (is_index_16_bit ? 2 : 4)));
 		os.write(reinterpret_cast<char*>(&num_indices), sizeof(num_indices));
 		os.write(&is_index_16_bit, sizeof(is_index_16_bit));
 
@@ -1862,6 +2236,35 @@ namespace
 			os.write(reinterpret_cast<char*>(&ni), sizeof(ni));
 			uint32_t si = Native2LE(mesh_start_indices[mesh_index]);
 			os.write(reinterpret_cast<char*>(&si), sizeof(si));
+
+			uint32_t const num_lods = static_cast<uint32_t>(mesh_lod_num_indices[mesh_index].size()) + 1;
+			uint32_t nl = Native2LE(num_lods);
+			os.write(reinterpret_cast<char*>(&nl), sizeof(nl));
+			for (uint32_t lod = 1; lod < num_lods; ++ lod)
+			{
+				ni = Native2LE(mesh_lod_num_indices[mesh_index][lod - 1]);
+				os.write(reinterpret_cast<char*>(&ni), sizeof(ni));
+				si = Native2LE(mesh_lod_start_indices[mesh_index][lod - 1]);
+				os.write(reinterpret_cast<char*>(&si), sizeof(si));
+			}
+
+			uint32_t nc = Native2LE(static_cast<uint32_t>(mesh_clusters[mesh_index].size()));
+			os.write(reinterpret_cast<char*>(&nc), sizeof(nc));
+			for (auto const & cluster : mesh_clusters[mesh_index])
+			{
+				MeshCluster le_cluster;
+				le_cluster.start_index = Native2LE(cluster.start_index);
+				le_cluster.num_indices = Native2LE(cluster.num_indices);
+				le_cluster.center.x() = Native2LE(cluster.center.x());
+				le_cluster.center.y() = Native2LE(cluster.center.y());
+				le_cluster.center.z() = Native2LE(cluster.center.z());
+				le_cluster.radius = Native2LE(cluster.radius);
+				le_cluster.cone_axis.x() = Native2LE(cluster.cone_axis.x());
+				le_cluster.cone_axis.y() = Native2LE(cluster.cone_axis.y());
+				le_cluster.cone_axis.z() = Native2LE(cluster.cone_axis.z());
+				le_cluster.cone_cutoff = Native2LE(cluster.cone_cutoff);
+				os.write(reinterpret_cast<char*>(&le_cluster), sizeof(le_cluster));
+			}
 		}
 	}
 
@@ -2105,17 +2508,94 @@ namespace
 		return ret;
 	}
 
-	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform)
+	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform,
+		bool optimize, uint32_t num_lods, bool quiet)
 	{
 		std::ostringstream ss;
 
-		ResIdentifierPtr file = ResLoader::Instance().Open(meshml_name);
-		KlayGE::XMLDocument doc;
-		XMLNodePtr root = doc.Parse(file);
+		std::vector<std::string> mesh_names;
+		std::vector<int32_t> mtl_ids;
+		std::vector<AABBox> pos_bbs;
+		std::vector<AABBox> tc_bbs;
+		std::vector<uint32_t> mesh_num_vertices;
+		std::vector<uint32_t> mesh_base_vertices;
+		std::vector<uint32_t> mesh_num_indices;
+		std::vector<uint32_t> mesh_start_indices;
+		std::vector<std::vector<uint32_t>> mesh_lod_num_indices;
+		std::vector<std::vector<uint32_t>> mesh_lod_start_indices;
+		std::vector<std::vector<MeshCluster>> mesh_clusters;
+		std::vector<VertexElement> merged_ves;
+		std::vector<std::vector<uint8_t>> merged_vertices;
+		std::vector<uint8_t> merged_indices;
+		char is_index_16_bit = true;
+		bool has_meshes = false;
+
+		KlayGE::XMLDocument materials_doc;
+		KlayGE::XMLDocument bones_doc;
+		KlayGE::XMLDocument key_frames_doc;
+		KlayGE::XMLDocument bb_key_frames_doc;
+		KlayGE::XMLDocument actions_doc;
+		XMLNodePtr materials_chunk;
+		XMLNodePtr bones_chunk;
+		XMLNodePtr key_frames_chunk;
+		XMLNodePtr bb_kfs_chunk;
+		XMLNodePtr actions_chunk;
+
+		{
+			Timer timer;
+
+			ResIdentifierPtr file = ResLoader::Instance().Open(meshml_name);
+			MeshMLReader reader(file);
+
+			reader.Next();
+			BOOST_ASSERT((MeshMLReader::TT_StartElement == reader.Type()) && (reader.AttribInt("version", 0) >= 1));
+
+			while (MeshMLReader::TT_StartElement == reader.Next())
+			{
+				std::string_view const name = reader.Name();
+				if ("meshes_chunk" == name)
+				{
+					CompileMeshesChunk(reader, mesh_names, mtl_ids, pos_bbs, tc_bbs,
+						mesh_num_vertices, mesh_base_vertices,
+						mesh_num_indices, mesh_start_indices,
+						merged_ves, merged_vertices, merged_indices,
+						is_index_16_bit);
+					has_meshes = true;
+				}
+				else if ("materials_chunk" == name)
+				{
+					materials_chunk = ParseChunk(reader, materials_doc);
+				}
+				else if ("bones_chunk" == name)
+				{
+					bones_chunk = ParseChunk(reader, bones_doc);
+				}
+				else if ("key_frames_chunk" == name)
+				{
+					key_frames_chunk = ParseChunk(reader, key_frames_doc);
+				}
+				else if ("bb_key_frames_chunk" == name)
+				{
+					bb_kfs_chunk = ParseChunk(reader, bb_key_frames_doc);
+				}
+				else if ("actions_chunk" == name)
+				{
+					actions_chunk = ParseChunk(reader, actions_doc);
+				}
+				else
+				{
+					reader.Skip();
+				}
+			}
 
-		BOOST_ASSERT(root->Attrib("version") && (root->Attrib("version")->ValueInt() >= 1));
+			if (!quiet)
+			{
+				double const elapsed = timer.elapsed();
+				double const mb = reader.BytesRead() / (1024.0 * 1024.0);
+				cout << "Parsed " << mb << " MB in " << elapsed << " s, " << mb / std::max(elapsed, 1e-6) << " MB/s" << endl;
+			}
+		}
 
-		XMLNodePtr materials_chunk = root->FirstNode("materials_chunk");
 		std::vector<OfflineRenderMaterial> mtls;
 		if (materials_chunk)
 		{
@@ -2165,33 +2645,31 @@ namespace
 			ss.write(reinterpret_cast<char*>(&num_mtls), sizeof(num_mtls));
 		}
 
-		XMLNodePtr meshes_chunk = root->FirstNode("meshes_chunk");
-		std::vector<std::string> mesh_names;
-		std::vector<int32_t> mtl_ids;
-		std::vector<AABBox> pos_bbs;
-		std::vector<AABBox> tc_bbs;
-		std::vector<uint32_t> mesh_num_vertices;
-		std::vector<uint32_t> mesh_base_vertices;
-		std::vector<uint32_t> mesh_num_indices;
-		std::vector<uint32_t> mesh_start_indices;
-		std::vector<VertexElement> merged_ves;
-		std::vector<std::vector<uint8_t>> merged_vertices;
-		std::vector<uint8_t> merged_indices;
-		char is_index_16_bit = true;
-		if (meshes_chunk)
+		if (has_meshes)
 		{
-			CompileMeshesChunk(meshes_chunk, mesh_names, mtl_ids, pos_bbs, tc_bbs,
-				mesh_num_vertices, mesh_base_vertices,
+			if (optimize)
+			{
+				OptimizeMeshesChunk(pos_bbs, mesh_num_vertices, mesh_base_vertices,
+					mesh_num_indices, mesh_start_indices,
+					merged_ves, merged_vertices, merged_indices,
+					is_index_16_bit, quiet);
+			}
+
+			GenerateLodsChunk(num_lods, pos_bbs, mesh_num_vertices, mesh_base_vertices,
+				mesh_num_indices, mesh_start_indices,
+				merged_ves, merged_vertices, merged_indices, is_index_16_bit,
+				mesh_lod_num_indices, mesh_lod_start_indices, optimize, quiet);
+
+			BuildClustersChunk(pos_bbs, mesh_num_vertices, mesh_base_vertices,
 				mesh_num_indices, mesh_start_indices,
-				merged_ves, merged_vertices, merged_indices,
-				is_index_16_bit);
+				merged_ves, merged_vertices, merged_indices, is_index_16_bit,
+				mesh_clusters, quiet);
 		}
 		{
 			uint32_t num_meshes = Native2LE(static_cast<uint32_t>(pos_bbs.size()));
 			ss.write(reinterpret_cast<char*>(&num_meshes), sizeof(num_meshes));
 		}
 
-		XMLNodePtr bones_chunk = root->FirstNode("bones_chunk");
 		std::vector<Joint> joints;
 		if (bones_chunk)
 		{
@@ -2202,7 +2680,6 @@ namespace
 			ss.write(reinterpret_cast<char*>(&num_joints), sizeof(num_joints));
 		}
 
-		XMLNodePtr key_frames_chunk = root->FirstNode("key_frames_chunk");
 		uint32_t num_frames = 0;
 		uint32_t frame_rate = 0;
 		std::vector<KeyFrames> kfs(joints.size());
@@ -2239,7 +2716,6 @@ namespace
 				}
 			}
 
-			XMLNodePtr bb_kfs_chunk = root->FirstNode("bb_key_frames_chunk");
 			CompileBBKeyFramesChunk(bb_kfs_chunk, pos_bbs, num_frames, bb_kfs);
 		}
 		{
@@ -2247,7 +2723,6 @@ namespace
 			ss.write(reinterpret_cast<char*>(&num_kfs), sizeof(num_kfs));
 		}
 
-		XMLNodePtr actions_chunk = root->FirstNode("actions_chunk");
 		std::vector<AnimationAction> actions;
 		if (actions_chunk)
 		{
@@ -2263,10 +2738,11 @@ namespace
 			WriteMaterialsChunk(mtls, ss);
 		}
 
-		if (meshes_chunk)
+		if (has_meshes)
 		{
 			WriteMeshesChunk(mesh_names, mtl_ids, pos_bbs, tc_bbs,
 				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_start_indices,
+				mesh_lod_num_indices, mesh_lod_start_indices, mesh_clusters,
 				merged_ves, merged_vertices, merged_indices, is_index_16_bit, ss);
 		}
 
@@ -2311,6 +2787,8 @@ int main(int argc, char* argv[])
 	std::string input_name;
 	filesystem::path target_folder;
 	std::string platform;
+	bool optimize = true;
+	uint32_t num_lods = 3;
 	bool quiet = false;
 
 	boost::program_options::options_description desc("Allowed options");
@@ -2319,6 +2797,9 @@ int main(int argc, char* argv[])
 		("input-name,I", boost::program_options::value<std::string>(), "Input meshml name.")
 		("target-folder,T", boost::program_options::value<std::string>(), "Target folder.")
 		("platform,P", boost::program_options::value<std::string>()->implicit_value(""), "Platform name.")
+		("optimize,O", boost::program_options::value<bool>()->implicit_value(true),
+			"Weld vertices and reorder them for vertex cache, overdraw, and vertex fetch. Default is on.")
+		("lods,L", boost::program_options::value<uint32_t>(), "Max number of LODs, including the full detail one. Default is 3.")
 		("quiet,q", boost::program_options::value<bool>()->implicit_value(true), "Quiet mode.")
 		("version,v", "Version.");
 
@@ -2353,6 +2834,14 @@ int main(int argc, char* argv[])
 	{
 		platform = vm["platform"].as<std::string>();
 	}
+	if (vm.count("optimize") > 0)
+	{
+		optimize = vm["optimize"].as<bool>();
+	}
+	if (vm.count("lods") > 0)
+	{
+		num_lods = std::max(vm["lods"].as<uint32_t>(), 1U);
+	}
 	if (vm.count("quiet") > 0)
 	{
 		quiet = vm["quiet"].as<bool>();
@@ -2397,7 +2886,7 @@ int main(int argc, char* argv[])
 
 	std::string output_name = (target_folder / filesystem::path(file_name)).string() + JIT_EXT_NAME;
 
-	MeshMLJIT(meshml_name, output_name, platform);
+	MeshMLJIT(meshml_name, output_name, platform, optimize, num_lods, quiet);
 
 	if (!quiet)
 	{
@@ -0,0 +1,667 @@
+/**
+ * @file MeshMLReader.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/ResIdentifier.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "MeshMLReader.hpp"
+
+namespace
+{
+	using namespace KlayGE;
+
+	size_t const BLOCK_SIZE = 1024 * 1024;
+
+	// More digits than this don't fit in the mantissa, and don't change a float anyway
+	uint32_t const MAX_MANTISSA_DIGITS = 19;
+
+	// Powers of 10 that are exact in a double
+	double const POW10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	int32_t const MAX_EXACT_POW10 = 22;
+
+	bool IsSpace(char ch)
+	{
+		return (' ' == ch) || ('\t' == ch) || ('\n' == ch) || ('\r' == ch);
+	}
+
+	bool IsDigit(char ch)
+	{
+		return (ch >= '0') && (ch <= '9');
+	}
+
+	void SkipSpaces(char const *& p, char const * end)
+	{
+		while ((p < end) && IsSpace(*p))
+		{
+			++ p;
+		}
+	}
+
+	// Values are space separated, anything after the number in the same token is ignored
+	void SkipToken(char const *& p, char const * end)
+	{
+		while ((p < end) && !IsSpace(*p))
+		{
+			++ p;
+		}
+	}
+
+	void AppendDecoded(std::string& str, std::string_view value)
+	{
+		str.reserve(str.size() + value.size());
+		for (size_t i = 0; i < value.size(); ++ i)
+		{
+			if ('&' == value[i])
+			{
+				size_t const semicolon = value.find(';', i);
+				if (semicolon != std::string_view::npos)
+				{
+					std::string_view const entity = value.substr(i + 1, semicolon - i - 1);
+					uint32_t ch = 0;
+					if ("lt" == entity)
+					{
+						ch = '<';
+					}
+					else if ("gt" == entity)
+					{
+						ch = '>';
+					}
+					else if ("amp" == entity)
+					{
+						ch = '&';
+					}
+					else if ("quot" == entity)
+					{
+						ch = '"';
+					}
+					else if ("apos" == entity)
+					{
+						ch = '\'';
+					}
+					else if ((entity.size() > 1) && ('#' == entity[0]))
+					{
+						std::string const code(entity.substr(1));
+						bool const hex = ('x' == code[0]) || ('X' == code[0]);
+						char const * digits = code.c_str() + (hex ? 1 : 0);
+						char* digits_end;
+						unsigned long const value = std::strtoul(digits, &digits_end, hex ? 16 : 10);
+						if ((digits_end != digits) && ('\0' == *digits_end) && (value <= 0x10FFFF)
+							&& ((value < 0xD800) || (value > 0xDFFF)))
+						{
+							ch = static_cast<uint32_t>(value);
+						}
+					}
+
+					if (ch != 0)
+					{
+						// Character references are written out as UTF-8
+						if (ch < 0x80)
+						{
+							str.push_back(static_cast<char>(ch));
+						}
+						else if (ch < 0x800)
+						{
+							str.push_back(static_cast<char>(0xC0 | (ch >> 6)));
+							str.push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+						}
+						else if (ch < 0x10000)
+						{
+							str.push_back(static_cast<char>(0xE0 | (ch >> 12)));
+							str.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3F)));
+							str.push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+						}
+						else
+						{
+							str.push_back(static_cast<char>(0xF0 | (ch >> 18)));
+							str.push_back(static_cast<char>(0x80 | ((ch >> 12) & 0x3F)));
+							str.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3F)));
+							str.push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+						}
+						i = semicolon;
+						continue;
+					}
+				}
+			}
+
+			str.push_back(value[i]);
+		}
+	}
+}
+
+namespace KlayGE
+{
+	float ParseFloat(char const *& p, char const * end)
+	{
+		SkipSpaces(p, end);
+		char const * const token = p;
+
+		bool negative = false;
+		if ((p < end) && (('-' == *p) || ('+' == *p)))
+		{
+			negative = ('-' == *p);
+			++ p;
+		}
+
+		uint64_t mantissa = 0;
+		uint32_t num_digits = 0;
+		int32_t exponent = 0;
+		bool has_digits = false;
+		for (; (p < end) && IsDigit(*p); ++ p)
+		{
+			has_digits = true;
+			if (num_digits < MAX_MANTISSA_DIGITS)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0)
+				{
+					++ num_digits;
+				}
+			}
+			else
+			{
+				++ exponent;
+			}
+		}
+		if ((p < end) && ('.' == *p))
+		{
+			++ p;
+			for (; (p < end) && IsDigit(*p); ++ p)
+			{
+				has_digits = true;
+				if (num_digits < MAX_MANTISSA_DIGITS)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0)
+					{
+						++ num_digits;
+					}
+					-- exponent;
+				}
+			}
+		}
+
+		if (!has_digits)
+		{
+			// Things like inf and nan are rare enough to go through the CRT
+			SkipToken(p, end);
+			std::string const str(token, p);
+			return static_cast<float>(std::strtod(str.c_str(), nullptr));
+		}
+
+		if ((p < end) && (('e' == *p) || ('E' == *p)))
+		{
+			char const * q = p + 1;
+			bool negative_exp = false;
+			if ((q < end) && (('-' == *q) || ('+' == *q)))
+			{
+				negative_exp = ('-' == *q);
+				++ q;
+			}
+			if ((q < end) && IsDigit(*q))
+			{
+				int32_t exp = 0;
+				for (; (q < end) && IsDigit(*q); ++ q)
+				{
+					if (exp < 10000)
+					{
+						exp = exp * 10 + (*q - '0');
+					}
+				}
+				exponent += negative_exp ? -exp : exp;
+				p = q;
+			}
+		}
+
+		SkipToken(p, end);
+
+		double value = static_cast<double>(mantissa);
+		if ((mantissa != 0) && (exponent != 0))
+		{
+			if ((exponent < 0) && (exponent >= -MAX_EXACT_POW10))
+			{
+				value /= POW10[-exponent];
+			}
+			else if ((exponent > 0) && (exponent <= MAX_EXACT_POW10))
+			{
+				value *= POW10[exponent];
+			}
+			else
+			{
+				value *= std::pow(10.0, exponent);
+			}
+		}
+		return static_cast<float>(negative ? -value : value);
+	}
+
+	uint32_t ParseUInt(char const *& p, char const * end)
+	{
+		SkipSpaces(p, end);
+
+		bool negative = false;
+		if ((p < end) && (('-' == *p) || ('+' == *p)))
+		{
+			negative = ('-' == *p);
+			++ p;
+		}
+
+		uint32_t value = 0;
+		for (; (p < end) && IsDigit(*p); ++ p)
+		{
+			value = value * 10 + (*p - '0');
+		}
+
+		SkipToken(p, end);
+
+		return negative ? 0 - value : value;
+	}
+
+
+	MeshMLReader::MeshMLReader(ResIdentifierPtr const & source)
+		: source_(source),
+			buf_(BLOCK_SIZE), pos_(0), end_(0), eof_(false), bytes_read_(0),
+			type_(TT_EndOfDocument), depth_(0), open_elements_(0), pending_end_(false),
+			capture_(nullptr)
+	{
+	}
+
+	MeshMLReader::TokenType MeshMLReader::Next()
+	{
+		if (pending_end_)
+		{
+			pending_end_ = false;
+			type_ = TT_EndElement;
+			attrs_.clear();
+			depth_ = open_elements_;
+			-- open_elements_;
+			return type_;
+		}
+
+		for (;;)
+		{
+			char const * lt = static_cast<char const *>(std::memchr(buf_.data() + pos_, '<', end_ - pos_));
+			if (!lt)
+			{
+				this->Consume(end_ - pos_);
+				if (!this->Fill())
+				{
+					if (open_elements_ != 0)
+					{
+						TERRC(std::errc::illegal_byte_sequence);
+					}
+
+					type_ = TT_EndOfDocument;
+					tag_ = std::string_view();
+					name_ = std::string_view();
+					attrs_.clear();
+					depth_ = 0;
+					return type_;
+				}
+				continue;
+			}
+
+			this->Consume(lt - (buf_.data() + pos_));
+
+			size_t const tag_size = this->FindTagEnd() + 1;
+			char const ch = buf_[pos_ + 1];
+			if (('?' == ch) || ('!' == ch))
+			{
+				this->Consume(tag_size);
+				continue;
+			}
+
+			this->ParseTag(tag_size);
+			this->Consume(tag_size);
+			return type_;
+		}
+	}
+
+	bool MeshMLReader::HasAttrib(std::string_view name) const
+	{
+		for (auto const & attr : attrs_)
+		{
+			if (attr.first == name)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::string_view MeshMLReader::Attrib(std::string_view name) const
+	{
+		for (auto const & attr : attrs_)
+		{
+			if (attr.first == name)
+			{
+				return attr.second;
+			}
+		}
+		return std::string_view();
+	}
+
+	std::string MeshMLReader::AttribString(std::string_view name, std::string_view default_val) const
+	{
+		std::string ret;
+		if (this->HasAttrib(name))
+		{
+			AppendDecoded(ret, this->Attrib(name));
+		}
+		else
+		{
+			ret = std::string(default_val);
+		}
+		return ret;
+	}
+
+	int32_t MeshMLReader::AttribInt(std::string_view name, int32_t default_val) const
+	{
+		return this->HasAttrib(name) ? static_cast<int32_t>(this->AttribUInt(name, 0)) : default_val;
+	}
+
+	uint32_t MeshMLReader::AttribUInt(std::string_view name, uint32_t default_val) const
+	{
+		uint32_t ret = default_val;
+		std::string_view const value = this->Attrib(name);
+		if (!value.empty())
+		{
+			char const * p = value.data();
+			ret = ParseUInt(p, value.data() + value.size());
+		}
+		return ret;
+	}
+
+	float MeshMLReader::AttribFloat(std::string_view name, float default_val) const
+	{
+		float ret = default_val;
+		std::string_view const value = this->Attrib(name);
+		if (!value.empty())
+		{
+			char const * p = value.data();
+			ret = ParseFloat(p, value.data() + value.size());
+		}
+		return ret;
+	}
+
+	uint32_t MeshMLReader::AttribFloats(std::string_view name, float* v, uint32_t n) const
+	{
+		std::string_view const value = this->Attrib(name);
+		char const * p = value.data();
+		char const * const end = p + value.size();
+		uint32_t num = 0;
+		for (uint32_t i = 0; i < n; ++ i)
+		{
+			SkipSpaces(p, end);
+			if (p < end)
+			{
+				v[i] = ParseFloat(p, end);
+				++ num;
+			}
+			else
+			{
+				v[i] = 0;
+			}
+		}
+		return num;
+	}
+
+	uint32_t MeshMLReader::AttribUInts(std::string_view name, uint32_t* v, uint32_t n) const
+	{
+		std::string_view const value = this->Attrib(name);
+		char const * p = value.data();
+		char const * const end = p + value.size();
+		uint32_t num = 0;
+		for (uint32_t i = 0; i < n; ++ i)
+		{
+			SkipSpaces(p, end);
+			if (p < end)
+			{
+				v[i] = ParseUInt(p, end);
+				++ num;
+			}
+			else
+			{
+				v[i] = 0;
+			}
+		}
+		return num;
+	}
+
+	void MeshMLReader::Skip()
+	{
+		BOOST_ASSERT(TT_StartElement == type_);
+
+		uint32_t const depth = depth_;
+		do
+		{
+			if (TT_EndOfDocument == this->Next())
+			{
+				TERRC(std::errc::illegal_byte_sequence);
+			}
+		} while ((type_ != TT_EndElement) || (depth_ != depth));
+	}
+
+	std::string MeshMLReader::ReadElement()
+	{
+		BOOST_ASSERT(TT_StartElement == type_);
+
+		std::string xml(tag_);
+		capture_ = &xml;
+		this->Skip();
+		capture_ = nullptr;
+		return xml;
+	}
+
+	bool MeshMLReader::Fill()
+	{
+		if (eof_)
+		{
+			return false;
+		}
+
+		if (pos_ > 0)
+		{
+			std::memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+			end_ -= pos_;
+			pos_ = 0;
+		}
+		if (end_ == buf_.size())
+		{
+			// A single tag is bigger than the buffer
+			buf_.resize(buf_.size() * 2);
+		}
+
+		source_->read(buf_.data() + end_, buf_.size() - end_);
+		size_t const size = static_cast<size_t>(source_->gcount());
+		end_ += size;
+		if (0 == size)
+		{
+			eof_ = true;
+			return false;
+		}
+		return true;
+	}
+
+	void MeshMLReader::Consume(size_t n)
+	{
+		if (capture_)
+		{
+			capture_->append(buf_.data() + pos_, n);
+		}
+		pos_ += n;
+		bytes_read_ += n;
+	}
+
+	// Returns the offset of the last character of the tag at pos_
+	size_t MeshMLReader::FindTagEnd()
+	{
+		while ((end_ - pos_ < 9) && this->Fill())
+		{
+		}
+
+		std::string_view terminator = ">";
+		{
+			std::string_view const head(buf_.data() + pos_, std::min<size_t>(end_ - pos_, 9));
+			if (0 == head.compare(0, 4, "<!--"))
+			{
+				terminator = "-->";
+			}
+			else if (0 == head.compare(0, 9, "<![CDATA["))
+			{
+				terminator = "]]>";
+			}
+			else if (0 == head.compare(0, 2, "<?"))
+			{
+				terminator = "?>";
+			}
+		}
+		bool const in_tag = (1 == terminator.size());
+
+		size_t offset = 1;
+		char quote = 0;
+		for (;;)
+		{
+			char const * p = buf_.data() + pos_;
+			size_t const size = end_ - pos_;
+			for (; offset < size; ++ offset)
+			{
+				char const ch = p[offset];
+				if (quote != 0)
+				{
+					if (ch == quote)
+					{
+						quote = 0;
+					}
+				}
+				else if (in_tag && (('"' == ch) || ('\'' == ch)))
+				{
+					quote = ch;
+				}
+				else if ((ch == terminator.back()) && (offset + 1 >= terminator.size())
+					&& (0 == std::memcmp(p + offset + 1 - terminator.size(), terminator.data(), terminator.size())))
+				{
+					return offset;
+				}
+			}
+
+			if (!this->Fill())
+			{
+				TERRC(std::errc::illegal_byte_sequence);
+			}
+		}
+	}
+
+	void MeshMLReader::ParseTag(size_t tag_size)
+	{
+		char const * p = buf_.data() + pos_;
+		char const * const end = p + tag_size - 1;
+		tag_ = std::string_view(p, tag_size);
+		attrs_.clear();
+
+		++ p;
+		bool const closing = ('/' == *p);
+		if (closing)
+		{
+			++ p;
+		}
+
+		char const * name = p;
+		while ((p < end) && !IsSpace(*p) && (*p != '/'))
+		{
+			++ p;
+		}
+		name_ = std::string_view(name, p - name);
+
+		if (closing)
+		{
+			if (0 == open_elements_)
+			{
+				TERRC(std::errc::illegal_byte_sequence);
+			}
+
+			type_ = TT_EndElement;
+			depth_ = open_elements_;
+			-- open_elements_;
+			return;
+		}
+
+		for (;;)
+		{
+			SkipSpaces(p, end);
+			if ((p >= end) || ('/' == *p))
+			{
+				break;
+			}
+
+			char const * attr_name = p;
+			while ((p < end) && !IsSpace(*p) && (*p != '='))
+			{
+				++ p;
+			}
+			std::string_view const attr_name_view(attr_name, p - attr_name);
+
+			SkipSpaces(p, end);
+			if ((p >= end) || (*p != '='))
+			{
+				TERRC(std::errc::illegal_byte_sequence);
+			}
+			++ p;
+			SkipSpaces(p, end);
+			if ((p >= end) || (('"' != *p) && ('\'' != *p)))
+			{
+				TERRC(std::errc::illegal_byte_sequence);
+			}
+
+			char const quote = *p;
+			++ p;
+			char const * value = p;
+			p = static_cast<char const *>(std::memchr(p, quote, end - p));
+			if (!p)
+			{
+				TERRC(std::errc::illegal_byte_sequence);
+			}
+			attrs_.emplace_back(attr_name_view, std::string_view(value, p - value));
+			++ p;
+		}
+
+		type_ = TT_StartElement;
+		++ open_elements_;
+		depth_ = open_elements_;
+		pending_end_ = ('/' == end[-1]);
+	}
+}
@@ -0,0 +1,132 @@
+/**
+ * @file MeshMLReader.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _MESHMLREADER_HPP
+#define _MESHMLREADER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/CXX17/string_view.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace KlayGE
+{
+	// Parses a float in C locale format from [p, end), and moves p past it. Leading spaces are skipped.
+	float ParseFloat(char const *& p, char const * end);
+	// Parses an unsigned integer from [p, end), and moves p past it. Leading spaces are skipped.
+	uint32_t ParseUInt(char const *& p, char const * end);
+
+	// A pull parser for MeshML. Only a block of the source is kept in memory, so the size of the file doesn't matter.
+	//   Text content, comments, and declarations are skipped.
+	class MeshMLReader
+	{
+	public:
+		enum TokenType
+		{
+			TT_StartElement,
+			TT_EndElement,
+			TT_EndOfDocument
+		};
+
+	public:
+		explicit MeshMLReader(ResIdentifierPtr const & source);
+
+		// Moves to the next start or end tag. An empty element gives a start and an end.
+		//   The name and attributes are valid until the next call.
+		TokenType Next();
+
+		TokenType Type() const
+		{
+			return type_;
+		}
+		std::string_view Name() const
+		{
+			return name_;
+		}
+		// The root element is at depth 1.
+		uint32_t Depth() const
+		{
+			return depth_;
+		}
+
+		bool HasAttrib(std::string_view name) const;
+		// Raw value, without entities decoded. Empty if there is no such attribute.
+		std::string_view Attrib(std::string_view name) const;
+		std::string AttribString(std::string_view name, std::string_view default_val) const;
+		int32_t AttribInt(std::string_view name, int32_t default_val) const;
+		uint32_t AttribUInt(std::string_view name, uint32_t default_val) const;
+		float AttribFloat(std::string_view name, float default_val) const;
+		// Parses a space separated list. Missing values are 0. Returns the number of values in the attribute.
+		uint32_t AttribFloats(std::string_view name, float* v, uint32_t n) const;
+		uint32_t AttribUInts(std::string_view name, uint32_t* v, uint32_t n) const;
+
+		// Moves to the end tag of the current start element, skipping all its children.
+		void Skip();
+		// Same as Skip, but returns the XML text of the element, for parsing small chunks with XMLDocument.
+		std::string ReadElement();
+
+		// Source bytes consumed so far.
+		uint64_t BytesRead() const
+		{
+			return bytes_read_;
+		}
+
+	private:
+		bool Fill();
+		void Consume(size_t n);
+		size_t FindTagEnd();
+		void ParseTag(size_t tag_size);
+
+	private:
+		ResIdentifierPtr source_;
+
+		std::vector<char> buf_;
+		size_t pos_;
+		size_t end_;
+		bool eof_;
+		uint64_t bytes_read_;
+
+		TokenType type_;
+		std::string_view tag_;
+		std::string_view name_;
+		std::vector<std::pair<std::string_view, std::string_view>> attrs_;
+		uint32_t depth_;
+		uint32_t open_elements_;
+		bool pending_end_;
+
+		std::string* capture_;
+	};
+}
+
+#endif		// _MESHMLREADER_HPP
@@ -0,0 +1,779 @@
+/**
+ * @file MeshOptimizer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Hash.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "MeshOptimizer.hpp"
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const INVALID_INDEX = 0xFFFFFFFF;
+
+	// Symmetric 3x3 A, b, and c of the error p^T * A * p + 2 * b^T * p + c
+	struct Quadric
+	{
+		float a00, a01, a02, a11, a12, a22;
+		float b0, b1, b2;
+		float c;
+
+		Quadric()
+			: a00(0), a01(0), a02(0), a11(0), a12(0), a22(0),
+				b0(0), b1(0), b2(0),
+				c(0)
+		{
+		}
+
+		// Squared distance to the plane n.p + d = 0, n normalized, scaled by weight
+		Quadric(float3 const & n, float d, float weight)
+			: a00(n.x() * n.x() * weight), a01(n.x() * n.y() * weight), a02(n.x() * n.z() * weight),
+				a11(n.y() * n.y() * weight), a12(n.y() * n.z() * weight), a22(n.z() * n.z() * weight),
+				b0(n.x() * d * weight), b1(n.y() * d * weight), b2(n.z() * d * weight),
+				c(d * d * weight)
+		{
+		}
+
+		Quadric& operator+=(Quadric const & rhs)
+		{
+			a00 += rhs.a00;
+			a01 += rhs.a01;
+			a02 += rhs.a02;
+			a11 += rhs.a11;
+			a12 += rhs.a12;
+			a22 += rhs.a22;
+			b0 += rhs.b0;
+			b1 += rhs.b1;
+			b2 += rhs.b2;
+			c += rhs.c;
+			return *this;
+		}
+
+		float Error(float3 const & p) const
+		{
+			float const x = p.x();
+			float const y = p.y();
+			float const z = p.z();
+			float const error = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+			return std::max(error, 0.0f);
+		}
+	};
+
+	struct Collapse
+	{
+		float cost;
+		uint32_t from;
+		uint32_t to;
+	};
+}
+
+namespace KlayGE
+{
+	VertexCacheStats AnalyzeVertexCache(ArrayRef<uint32_t> indices, uint32_t num_vertices, uint32_t cache_size)
+	{
+		// A vertex is in cache if it was transformed within the last cache_size misses
+		std::vector<uint32_t> cache_time(num_vertices, 0);
+		uint32_t num_misses = 0;
+		uint32_t num_used = 0;
+		for (auto const index : indices)
+		{
+			if ((0 == cache_time[index]) || (num_misses + 1 - cache_time[index] > cache_size))
+			{
+				if (0 == cache_time[index])
+				{
+					++ num_used;
+				}
+
+				++ num_misses;
+				cache_time[index] = num_misses;
+			}
+		}
+
+		VertexCacheStats stats;
+		stats.acmr = indices.empty() ? 0 : static_cast<float>(num_misses) / (indices.size() / 3);
+		stats.atvr = (0 == num_used) ? 0 : static_cast<float>(num_misses) / num_used;
+		return stats;
+	}
+
+	uint32_t WeldVertices(std::vector<uint32_t>& indices, std::vector<uint32_t>& remap,
+		ArrayRef<uint8_t const *> streams, ArrayRef<uint32_t> strides, uint32_t num_vertices)
+	{
+		BOOST_ASSERT(streams.size() == strides.size());
+
+		auto vertex_equal = [&streams, &strides](uint32_t lhs, uint32_t rhs)
+			{
+				for (size_t s = 0; s < streams.size(); ++ s)
+				{
+					if (std::memcmp(streams[s] + lhs * strides[s], streams[s] + rhs * strides[s], strides[s]) != 0)
+					{
+						return false;
+					}
+				}
+				return true;
+			};
+
+		std::unordered_multimap<size_t, uint32_t> unique_vertices;
+		unique_vertices.reserve(num_vertices);
+
+		remap.resize(num_vertices);
+		uint32_t num_unique = 0;
+		for (uint32_t v = 0; v < num_vertices; ++ v)
+		{
+			size_t seed = 0;
+			for (size_t s = 0; s < streams.size(); ++ s)
+			{
+				HashRange(seed, streams[s] + v * strides[s], streams[s] + (v + 1) * strides[s]);
+			}
+
+			uint32_t found = INVALID_INDEX;
+			auto const range = unique_vertices.equal_range(seed);
+			for (auto iter = range.first; iter != range.second; ++ iter)
+			{
+				if (vertex_equal(iter->second, v))
+				{
+					found = remap[iter->second];
+					break;
+				}
+			}
+
+			if (INVALID_INDEX == found)
+			{
+				unique_vertices.emplace(seed, v);
+				remap[v] = num_unique;
+				++ num_unique;
+			}
+			else
+			{
+				remap[v] = found;
+			}
+		}
+
+		size_t num_indices = 0;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t const a = remap[indices[i + 0]];
+			uint32_t const b = remap[indices[i + 1]];
+			uint32_t const c = remap[indices[i + 2]];
+			if ((a != b) && (b != c) && (c != a))
+			{
+				indices[num_indices + 0] = a;
+				indices[num_indices + 1] = b;
+				indices[num_indices + 2] = c;
+				num_indices += 3;
+			}
+		}
+		indices.resize(num_indices);
+
+		return num_unique;
+	}
+
+	void OptimizeVertexCache(std::vector<uint32_t>& indices, std::vector<uint32_t>& cluster_starts,
+		uint32_t num_vertices, uint32_t cache_size)
+	{
+		uint32_t const num_triangles = static_cast<uint32_t>(indices.size() / 3);
+
+		// Triangles using each vertex, and how many of them are not emitted yet
+		std::vector<uint32_t> live(num_vertices, 0);
+		for (auto const index : indices)
+		{
+			++ live[index];
+		}
+		std::vector<uint32_t> adjacency_offsets(num_vertices + 1);
+		adjacency_offsets[0] = 0;
+		for (uint32_t v = 0; v < num_vertices; ++ v)
+		{
+			adjacency_offsets[v + 1] = adjacency_offsets[v] + live[v];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		{
+			std::vector<uint32_t> cursors(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+			for (uint32_t i = 0; i < indices.size(); ++ i)
+			{
+				adjacency[cursors[indices[i]]] = i / 3;
+				++ cursors[indices[i]];
+			}
+		}
+
+		std::vector<uint32_t> cache_time(num_vertices, 0);
+		uint32_t time_stamp = cache_size + 1;
+		auto in_cache = [&cache_time, &time_stamp, cache_size](uint32_t v)
+			{
+				return time_stamp - cache_time[v] <= cache_size;
+			};
+
+		std::vector<char> emitted(num_triangles, false);
+		std::vector<uint32_t> dead_end;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		cluster_starts.clear();
+
+		uint32_t cursor = 0;
+		uint32_t fanning = INVALID_INDEX;
+		while (cursor < num_vertices)
+		{
+			if (live[cursor] > 0)
+			{
+				fanning = cursor;
+				cluster_starts.push_back(0);
+				break;
+			}
+			++ cursor;
+		}
+
+		while (fanning != INVALID_INDEX)
+		{
+			candidates.clear();
+			for (uint32_t a = adjacency_offsets[fanning]; a < adjacency_offsets[fanning + 1]; ++ a)
+			{
+				uint32_t const tri = adjacency[a];
+				if (!emitted[tri])
+				{
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						uint32_t const v = indices[tri * 3 + j];
+						output.push_back(v);
+						dead_end.push_back(v);
+						candidates.push_back(v);
+						-- live[v];
+						if (!in_cache(v))
+						{
+							cache_time[v] = time_stamp;
+							++ time_stamp;
+						}
+					}
+					emitted[tri] = true;
+				}
+			}
+
+			// Prefer the candidate staying in cache for the longest time after its remaining triangles are emitted
+			uint32_t next = INVALID_INDEX;
+			int32_t best_priority = -1;
+			for (auto const v : candidates)
+			{
+				if (live[v] > 0)
+				{
+					int32_t priority = 0;
+					if (time_stamp - cache_time[v] + 2 * live[v] <= cache_size)
+					{
+						priority = time_stamp - cache_time[v];
+					}
+					if (priority > best_priority)
+					{
+						best_priority = priority;
+						next = v;
+					}
+				}
+			}
+
+			if (INVALID_INDEX == next)
+			{
+				while (!dead_end.empty())
+				{
+					uint32_t const v = dead_end.back();
+					dead_end.pop_back();
+					if (live[v] > 0)
+					{
+						next = v;
+						break;
+					}
+				}
+			}
+			if (INVALID_INDEX == next)
+			{
+				while (cursor < num_vertices)
+				{
+					if (live[cursor] > 0)
+					{
+						next = cursor;
+						break;
+					}
+					++ cursor;
+				}
+			}
+
+			if ((next != INVALID_INDEX) && !in_cache(next))
+			{
+				cluster_starts.push_back(static_cast<uint32_t>(output.size() / 3));
+			}
+
+			fanning = next;
+		}
+
+		BOOST_ASSERT(output.size() == indices.size());
+		indices.swap(output);
+	}
+
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, ArrayRef<uint32_t> cluster_starts, ArrayRef<float3> positions)
+	{
+		uint32_t const num_triangles = static_cast<uint32_t>(indices.size() / 3);
+		uint32_t const num_clusters = static_cast<uint32_t>(cluster_starts.size());
+		if (num_clusters <= 1)
+		{
+			return;
+		}
+
+		std::vector<float3> cluster_centroids(num_clusters, float3(0, 0, 0));
+		std::vector<float3> cluster_normals(num_clusters, float3(0, 0, 0));
+		float3 mesh_centroid(0, 0, 0);
+		float mesh_area = 0;
+		for (uint32_t c = 0; c < num_clusters; ++ c)
+		{
+			uint32_t const tri_end = (c + 1 < num_clusters) ? cluster_starts[c + 1] : num_triangles;
+
+			float cluster_area = 0;
+			for (uint32_t tri = cluster_starts[c]; tri < tri_end; ++ tri)
+			{
+				float3 const & p0 = positions[indices[tri * 3 + 0]];
+				float3 const & p1 = positions[indices[tri * 3 + 1]];
+				float3 const & p2 = positions[indices[tri * 3 + 2]];
+
+				float3 const normal = MathLib::cross(p1 - p0, p2 - p0);
+				float const area = MathLib::length(normal);
+
+				cluster_centroids[c] += (p0 + p1 + p2) * (area / 3);
+				cluster_normals[c] += normal;
+				cluster_area += area;
+			}
+
+			mesh_centroid += cluster_centroids[c];
+			mesh_area += cluster_area;
+			if (cluster_area > 0)
+			{
+				cluster_centroids[c] /= cluster_area;
+			}
+		}
+		if (mesh_area > 0)
+		{
+			mesh_centroid /= mesh_area;
+		}
+
+		std::vector<std::pair<float, uint32_t>> sort_keys(num_clusters);
+		for (uint32_t c = 0; c < num_clusters; ++ c)
+		{
+			float const normal_length = MathLib::length(cluster_normals[c]);
+			float occlusion = 0;
+			if (normal_length > 0)
+			{
+				occlusion = MathLib::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c] / normal_length);
+			}
+			sort_keys[c] = std::make_pair(-occlusion, c);
+		}
+		std::stable_sort(sort_keys.begin(), sort_keys.end(),
+			[](std::pair<float, uint32_t> const & lhs, std::pair<float, uint32_t> const & rhs)
+			{
+				return lhs.first < rhs.first;
+			});
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		for (auto const & key : sort_keys)
+		{
+			uint32_t const c = key.second;
+			uint32_t const tri_end = (c + 1 < num_clusters) ? cluster_starts[c + 1] : num_triangles;
+			output.insert(output.end(), indices.begin() + cluster_starts[c] * 3, indices.begin() + tri_end * 3);
+		}
+		indices.swap(output);
+	}
+
+	uint32_t OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<uint32_t>& remap, uint32_t num_vertices)
+	{
+		remap.assign(num_vertices, INVALID_INDEX);
+		uint32_t num_used = 0;
+		for (auto& index : indices)
+		{
+			if (INVALID_INDEX == remap[index])
+			{
+				remap[index] = num_used;
+				++ num_used;
+			}
+			index = remap[index];
+		}
+		return num_used;
+	}
+
+	void SimplifyMesh(std::vector<uint32_t>& indices, ArrayRef<float3> positions, ArrayRef<uint32_t> collapse_groups,
+		uint32_t target_num_indices)
+	{
+		BOOST_ASSERT(collapse_groups.empty() || (collapse_groups.size() == positions.size()));
+
+		uint32_t const num_vertices = static_cast<uint32_t>(positions.size());
+
+		// Vertices sharing a position are wedges of one corner, split by an attribute seam
+		std::vector<uint32_t> pos_ids(num_vertices);
+		std::vector<uint32_t> num_wedges(num_vertices, 0);
+		{
+			std::unordered_multimap<size_t, uint32_t> unique_positions;
+			unique_positions.reserve(num_vertices);
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				float3 const & pos = positions[v];
+				size_t seed = 0;
+				HashRange(seed, &pos[0], &pos[0] + 3);
+
+				uint32_t found = INVALID_INDEX;
+				auto const range = unique_positions.equal_range(seed);
+				for (auto iter = range.first; iter != range.second; ++ iter)
+				{
+					if (positions[iter->second] == pos)
+					{
+						found = iter->second;
+						break;
+					}
+				}
+
+				if (INVALID_INDEX == found)
+				{
+					unique_positions.emplace(seed, v);
+					found = v;
+				}
+				pos_ids[v] = found;
+				++ num_wedges[found];
+			}
+		}
+
+		// Edges not shared by exactly two triangles are on a border, or non-manifold
+		std::vector<char> locked(num_vertices, false);
+		{
+			std::unordered_map<uint64_t, uint32_t> edge_counts;
+			edge_counts.reserve(indices.size());
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					uint32_t const a = pos_ids[indices[i + j]];
+					uint32_t const b = pos_ids[indices[i + (j + 1) % 3]];
+					uint64_t const key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+					++ edge_counts[key];
+				}
+			}
+			for (auto const & edge : edge_counts)
+			{
+				if (edge.second != 2)
+				{
+					locked[edge.first >> 32] = true;
+					locked[edge.first & 0xFFFFFFFF] = true;
+				}
+			}
+		}
+		for (uint32_t v = 0; v < num_vertices; ++ v)
+		{
+			if (num_wedges[pos_ids[v]] > 1)
+			{
+				locked[pos_ids[v]] = true;
+			}
+		}
+		for (uint32_t v = 0; v < num_vertices; ++ v)
+		{
+			locked[v] = locked[pos_ids[v]];
+		}
+
+		std::vector<Quadric> quadrics(num_vertices);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			float3 const & p0 = positions[indices[i + 0]];
+			float3 const & p1 = positions[indices[i + 1]];
+			float3 const & p2 = positions[indices[i + 2]];
+
+			float3 normal = MathLib::cross(p1 - p0, p2 - p0);
+			float const area = MathLib::length(normal);
+			if (area > 0)
+			{
+				normal /= area;
+				Quadric const q(normal, -MathLib::dot(normal, p0), area);
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					quadrics[indices[i + j]] += q;
+				}
+			}
+		}
+
+		std::vector<uint32_t> adjacency_offsets(num_vertices + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> remap(num_vertices);
+		std::vector<char> touched(num_vertices);
+		while (indices.size() > target_num_indices)
+		{
+			// Triangles around each vertex
+			std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+			for (auto const index : indices)
+			{
+				++ adjacency_offsets[index + 1];
+			}
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				adjacency_offsets[v + 1] += adjacency_offsets[v];
+			}
+			adjacency.resize(indices.size());
+			{
+				std::vector<uint32_t> cursors(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+				for (uint32_t i = 0; i < indices.size(); ++ i)
+				{
+					adjacency[cursors[indices[i]]] = i / 3;
+					++ cursors[indices[i]];
+				}
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					uint32_t const a = indices[i + j];
+					uint32_t const b = indices[i + (j + 1) % 3];
+					if (!collapse_groups.empty() && (collapse_groups[a] != collapse_groups[b]))
+					{
+						continue;
+					}
+
+					Quadric q = quadrics[a];
+					q += quadrics[b];
+					if (!locked[a])
+					{
+						collapses.push_back({ q.Error(positions[b]), a, b });
+					}
+					if (!locked[b])
+					{
+						collapses.push_back({ q.Error(positions[a]), b, a });
+					}
+				}
+			}
+			if (collapses.empty())
+			{
+				break;
+			}
+
+			std::sort(collapses.begin(), collapses.end(),
+				[](Collapse const & lhs, Collapse const & rhs)
+				{
+					return lhs.cost < rhs.cost;
+				});
+
+			// A collapse removes about 2 triangles
+			uint32_t const max_collapses = static_cast<uint32_t>((indices.size() - target_num_indices) / 6 + 1);
+			uint32_t num_collapses = 0;
+			for (uint32_t v = 0; v < num_vertices; ++ v)
+			{
+				remap[v] = v;
+			}
+			std::fill(touched.begin(), touched.end(), false);
+			for (auto const & collapse : collapses)
+			{
+				if (num_collapses >= max_collapses)
+				{
+					break;
+				}
+
+				uint32_t const from = collapse.from;
+				uint32_t const to = collapse.to;
+				if (touched[from] || touched[to])
+				{
+					continue;
+				}
+
+				// Moving from onto to must not flip any remaining triangle
+				bool flipped = false;
+				for (uint32_t t = adjacency_offsets[from]; (t < adjacency_offsets[from + 1]) && !flipped; ++ t)
+				{
+					uint32_t const tri = adjacency[t];
+					uint32_t k = 0;
+					while (indices[tri * 3 + k] != from)
+					{
+						++ k;
+					}
+					uint32_t const b = indices[tri * 3 + (k + 1) % 3];
+					uint32_t const c = indices[tri * 3 + (k + 2) % 3];
+					if ((b != to) && (c != to))
+					{
+						float3 const n0 = MathLib::cross(positions[b] - positions[from], positions[c] - positions[from]);
+						float3 const n1 = MathLib::cross(positions[b] - positions[to], positions[c] - positions[to]);
+						flipped = MathLib::dot(n0, n1) <= 0;
+					}
+				}
+				if (flipped)
+				{
+					continue;
+				}
+
+				remap[from] = to;
+				quadrics[to] += quadrics[from];
+				for (uint32_t t = adjacency_offsets[from]; t < adjacency_offsets[from + 1]; ++ t)
+				{
+					uint32_t const tri = adjacency[t];
+					for (uint32_t k = 0; k < 3; ++ k)
+					{
+						touched[indices[tri * 3 + k]] = true;
+					}
+				}
+				++ num_collapses;
+			}
+			if (0 == num_collapses)
+			{
+				break;
+			}
+
+			size_t num_indices = 0;
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				uint32_t const a = remap[indices[i + 0]];
+				uint32_t const b = remap[indices[i + 1]];
+				uint32_t const c = remap[indices[i + 2]];
+				if ((a != b) && (b != c) && (c != a))
+				{
+					indices[num_indices + 0] = a;
+					indices[num_indices + 1] = b;
+					indices[num_indices + 2] = c;
+					num_indices += 3;
+				}
+			}
+			indices.resize(num_indices);
+		}
+	}
+
+	void BuildMeshlets(std::vector<Meshlet>& meshlets, ArrayRef<uint32_t> indices, ArrayRef<float3> positions,
+		uint32_t max_vertices, uint32_t max_triangles)
+	{
+		BOOST_ASSERT(max_vertices >= 3);
+
+		uint32_t const num_triangles = static_cast<uint32_t>(indices.size() / 3);
+
+		meshlets.clear();
+		std::vector<uint32_t> stamps(positions.size(), INVALID_INDEX);
+		Meshlet meshlet = {};
+		for (uint32_t tri = 0; tri < num_triangles; ++ tri)
+		{
+			uint32_t meshlet_index = static_cast<uint32_t>(meshlets.size());
+			uint32_t new_vertices = 0;
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				if (stamps[indices[tri * 3 + j]] != meshlet_index)
+				{
+					++ new_vertices;
+				}
+			}
+			if ((meshlet.num_triangles > 0)
+				&& ((meshlet.num_vertices + new_vertices > max_vertices) || (meshlet.num_triangles == max_triangles)))
+			{
+				meshlets.push_back(meshlet);
+				meshlet = Meshlet();
+				meshlet.first_triangle = tri;
+				++ meshlet_index;
+			}
+
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				uint32_t const v = indices[tri * 3 + j];
+				if (stamps[v] != meshlet_index)
+				{
+					stamps[v] = meshlet_index;
+					++ meshlet.num_vertices;
+				}
+			}
+			++ meshlet.num_triangles;
+		}
+		if (meshlet.num_triangles > 0)
+		{
+			meshlets.push_back(meshlet);
+		}
+
+		for (auto& ml : meshlets)
+		{
+			uint32_t const tri_end = ml.first_triangle + ml.num_triangles;
+
+			float3 bb_min = positions[indices[ml.first_triangle * 3]];
+			float3 bb_max = bb_min;
+			float3 axis(0, 0, 0);
+			for (uint32_t tri = ml.first_triangle; tri < tri_end; ++ tri)
+			{
+				float3 const & p0 = positions[indices[tri * 3 + 0]];
+				float3 const & p1 = positions[indices[tri * 3 + 1]];
+				float3 const & p2 = positions[indices[tri * 3 + 2]];
+				bb_min = MathLib::minimize(MathLib::minimize(bb_min, p0), MathLib::minimize(p1, p2));
+				bb_max = MathLib::maximize(MathLib::maximize(bb_max, p0), MathLib::maximize(p1, p2));
+
+				float3 const normal = MathLib::cross(p1 - p0, p2 - p0);
+				float const length = MathLib::length(normal);
+				if (length > 0)
+				{
+					axis += normal / length;
+				}
+			}
+
+			ml.center = (bb_min + bb_max) * 0.5f;
+			float radius_sq = 0;
+			for (uint32_t i = ml.first_triangle * 3; i < tri_end * 3; ++ i)
+			{
+				radius_sq = std::max(radius_sq, MathLib::length_sq(positions[indices[i]] - ml.center));
+			}
+			ml.radius = std::sqrt(radius_sq);
+
+			// The widest angle between the axis and a triangle normal decides the cone
+			float min_dot = -1;
+			float const axis_length = MathLib::length(axis);
+			if (axis_length > 0)
+			{
+				axis /= axis_length;
+				min_dot = 1;
+				for (uint32_t tri = ml.first_triangle; tri < tri_end; ++ tri)
+				{
+					float3 const & p0 = positions[indices[tri * 3 + 0]];
+					float3 const & p1 = positions[indices[tri * 3 + 1]];
+					float3 const & p2 = positions[indices[tri * 3 + 2]];
+					float3 const normal = MathLib::cross(p1 - p0, p2 - p0);
+					float const length = MathLib::length(normal);
+					if (length > 0)
+					{
+						min_dot = std::min(min_dot, MathLib::dot(normal / length, axis));
+					}
+				}
+			}
+			if (min_dot <= 0)
+			{
+				// Wider than a half space, never all back facing
+				ml.cone_axis = float3(0, 0, 0);
+				ml.cone_cutoff = 1;
+			}
+			else
+			{
+				ml.cone_axis = axis;
+				ml.cone_cutoff = std::sqrt(1 - min_dot * min_dot);
+			}
+		}
+	}
+}
@@ -0,0 +1,97 @@
+/**
+ * @file MeshOptimizer.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _MESHOPTIMIZER_HPP
+#define _MESHOPTIMIZER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
+#include <KFL/Vector.hpp>
+
+#include <vector>
+
+namespace KlayGE
+{
+	// All the functions work on one mesh, with indices relative to its first vertex.
+
+	struct VertexCacheStats
+	{
+		float acmr;		// Average cache miss ratio, transformed vertices per triangle
+		float atvr;		// Average transform to vertex ratio, transformed vertices per referenced vertex
+	};
+
+	// Simulates a FIFO post-transform vertex cache.
+	VertexCacheStats AnalyzeVertexCache(ArrayRef<uint32_t> indices, uint32_t num_vertices, uint32_t cache_size);
+
+	// Gives vertices with the same data in every stream the same index, and removes triangles that become degenerate.
+	//   remap maps each old vertex to its new one. Returns the number of unique vertices.
+	uint32_t WeldVertices(std::vector<uint32_t>& indices, std::vector<uint32_t>& remap,
+		ArrayRef<uint8_t const *> streams, ArrayRef<uint32_t> strides, uint32_t num_vertices);
+
+	// Reorders triangles for the post-transform cache with Tipsify [Sander et al. 2007].
+	//   cluster_starts gets the first triangle of every run that starts from a cold cache.
+	void OptimizeVertexCache(std::vector<uint32_t>& indices, std::vector<uint32_t>& cluster_starts,
+		uint32_t num_vertices, uint32_t cache_size);
+
+	// Reorders the clusters, the ones facing outward of the mesh first, so they tend to occlude the rest.
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, ArrayRef<uint32_t> cluster_starts, ArrayRef<float3> positions);
+
+	// Renumbers vertices in the order they are first used. Unused vertices are mapped to 0xFFFFFFFF.
+	//   Returns the number of used vertices.
+	uint32_t OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<uint32_t>& remap, uint32_t num_vertices);
+
+	// Reduces the triangles to about target_num_indices with quadric error metrics [Garland and Heckbert 1997].
+	//   Vertices are collapsed onto their neighbors, so the result still indexes the original vertices.
+	//   Vertices on borders and attribute seams never move, and a vertex only collapses onto one in the same
+	//   collapse group. An empty collapse_groups puts all vertices in one group.
+	void SimplifyMesh(std::vector<uint32_t>& indices, ArrayRef<float3> positions, ArrayRef<uint32_t> collapse_groups,
+		uint32_t target_num_indices);
+
+	struct Meshlet
+	{
+		uint32_t first_triangle;
+		uint32_t num_triangles;
+		uint32_t num_vertices;
+
+		float3 center;
+		float radius;
+		// The cluster faces away from every eye with dot(center - eye, cone_axis) >= cone_cutoff * |center - eye| + radius
+		float3 cone_axis;
+		float cone_cutoff;
+	};
+
+	// Splits the triangles, in their current order, into runs touching at most max_vertices vertices.
+	void BuildMeshlets(std::vector<Meshlet>& meshlets, ArrayRef<uint32_t> indices, ArrayRef<float3> positions,
+		uint32_t max_vertices, uint32_t max_triangles);
+}
+
+#endif		// _MESHOPTIMIZER_HPP
@@ -1,4 +1,6 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KFL/Noise.hpp>
 
@@ -218,25 +220,47 @@ void GenSimplexPerm()
 		256, 256, 1, 1, 1, EF_ABGR8, init_data);
 }
 
+// Rows are split into tiles, which are taken by the threads in the pool. Each row is evaluated with the batch fBm.
+void GenTileablefBm(uint32_t tex_size, float stride, float offset_x, float offset_y, std::vector<float>& fdata)
+{
+	uint32_t const TILE_ROWS = 16;
+	uint32_t const num_tiles = (tex_size + TILE_ROWS - 1) / TILE_ROWS;
+
+	fdata.resize(tex_size * tex_size);
+
+	std::vector<float> xs(tex_size);
+	for (uint32_t x = 0; x < tex_size; ++ x)
+	{
+		xs[x] = (x + offset_x + 0.5f) / tex_size * stride;
+	}
+
+	Context::Instance().ThreadPool().parallel_for(num_tiles, [tex_size, stride, offset_y, &xs, &fdata](uint32_t tile)
+		{
+			auto& noiser = MathLib::SimplexNoise<float>::Instance();
+
+			std::vector<float> ys(tex_size);
+			uint32_t const y_end = std::min((tile + 1) * TILE_ROWS, tex_size);
+			for (uint32_t y = tile * TILE_ROWS; y < y_end; ++ y)
+			{
+				std::fill(ys.begin(), ys.end(), (y + offset_y + 0.5f) / tex_size * stride);
+				noiser.tileable_fBm(&xs[0], &ys[0], stride, stride, &fdata[y * tex_size], tex_size, 5, 2, 0.5f);
+			}
+		});
+}
+
 void GenfBmTexs()
 {
 	uint32_t const TEX_SIZE = 512;
 	float const STRIDE = 8;
 
-	MathLib::SimplexNoise<float> noiser = MathLib::SimplexNoise<float>::Instance();
-
-	std::vector<float> fdata(TEX_SIZE * TEX_SIZE);
+	std::vector<float> fdata;
+	GenTileablefBm(TEX_SIZE, STRIDE, 0, 0, fdata);
 	float min_v = +1e10f;
 	float max_v = -1e10f;
-	for (uint32_t y = 0; y < TEX_SIZE; ++ y)
+	for (auto v : fdata)
 	{
-		for (uint32_t x = 0; x < TEX_SIZE; ++ x)
-		{
-			float v = noiser.tileable_fBm((x + 0.5f) / TEX_SIZE * STRIDE, (y + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			fdata[y * TEX_SIZE + x] = v;
-			min_v = std::min(min_v, v);
-			max_v = std::max(max_v, v);
-		}
+		min_v = std::min(min_v, v);
+		max_v = std::max(max_v, v);
 	}
 	float inv_range = 1 / (max_v - min_v);
 	std::vector<uint8_t> data(TEX_SIZE * TEX_SIZE);
@@ -255,17 +279,19 @@ void GenfBmTexs()
 	system("Mipmapper " OUTPUT_PATH "fBm5_tex.dds");
 	system("TexCompressor BC4 " OUTPUT_PATH "fBm5_tex.dds");
 
+	float const d = 2;
+	std::vector<float> fdata_dx;
+	GenTileablefBm(TEX_SIZE, STRIDE, d, 0, fdata_dx);
+	std::vector<float> fdata_dy;
+	GenTileablefBm(TEX_SIZE, STRIDE, 0, d, fdata_dy);
+
 	std::vector<float3> fdata3(TEX_SIZE * TEX_SIZE);
-	for (uint32_t y = 0; y < TEX_SIZE; ++ y)
+	for (uint32_t i = 0; i < fdata3.size(); ++ i)
 	{
-		for (uint32_t x = 0; x < TEX_SIZE; ++ x)
-		{
-			float f0 = fdata[y * TEX_SIZE + x];
-			float d = 2;
-			float fx = noiser.tileable_fBm((x + d + 0.5f) / TEX_SIZE * STRIDE, (y + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			float fy = noiser.tileable_fBm((x + 0.5f) / TEX_SIZE * STRIDE, (y + d + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			fdata3[y * TEX_SIZE + x] = MathLib::normalize(float3(fx - f0, fy - f0, STRIDE * 16 / TEX_SIZE)) * 0.5f + 0.5f;
-		}
+		float f0 = fdata[i];
+		float fx = fdata_dx[i];
+		float fy = fdata_dy[i];
+		fdata3[i] = MathLib::normalize(float3(fx - f0, fy - f0, STRIDE * 16 / TEX_SIZE)) * 0.5f + 0.5f;
 	}
 	std::vector<uint32_t> data3(TEX_SIZE * TEX_SIZE);
 	for (uint32_t i = 0; i < fdata3.size(); ++ i)
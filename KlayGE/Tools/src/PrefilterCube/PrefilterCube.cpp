@@ -9,6 +9,7 @@
 #include <KlayGE/PostProcess.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/PrefilterCube.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
 #include <iostream>
@@ -71,6 +72,31 @@ namespace
 
 		SaveTexture(out_tex, out_file);
 	}
+
+	bool PrefilterCubeCPU(std::string const & in_file, std::string const & out_file)
+	{
+		Texture::TextureType in_type;
+		uint32_t in_width, in_height, in_depth;
+		uint32_t in_num_mipmaps;
+		uint32_t in_array_size;
+		ElementFormat in_format;
+		std::vector<ElementInitData> in_data;
+		std::vector<uint8_t> in_data_block;
+		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
+		if ((Texture::TT_Cube != in_type) || (in_array_size != 1))
+		{
+			cout << "Error: " << in_file << " is not a cube map." << endl;
+			return false;
+		}
+
+		uint32_t out_num_mipmaps;
+		std::vector<ElementInitData> out_data;
+		std::vector<uint8_t> out_data_block;
+		PrefilterCubeMap(in_width, in_num_mipmaps, in_format, in_data, out_num_mipmaps, out_data, out_data_block);
+
+		SaveTexture(out_file, Texture::TT_Cube, in_width, in_width, 1, out_num_mipmaps, 1, EF_ABGR16F, out_data);
+		return true;
+	}
 }
 
 class PrefilterCubeApp : public KlayGE::App3DFramework
@@ -94,22 +120,11 @@ public:
 
 int main(int argc, char* argv[])
 {
-	Context::Instance().LoadCfg("KlayGE.cfg");
-	ContextCfg context_cfg = Context::Instance().Config();
-	context_cfg.graphics_cfg.hide_win = true;
-	context_cfg.graphics_cfg.hdr = false;
-	context_cfg.graphics_cfg.color_grading = false;
-	context_cfg.graphics_cfg.gamma = false;
-	Context::Instance().Config(context_cfg);
-
-	PrefilterCubeApp app;
-	app.Create();
-
 	using namespace KlayGE;
 
 	if (argc < 2)
 	{
-		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds]" << endl;
+		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds] [gpu|cpu]" << endl;
 		return 1;
 	}
 
@@ -125,9 +140,37 @@ int main(int argc, char* argv[])
 		output = output_path.stem().string() + "_filtered.dds";
 	}
 
+	// The CPU path doesn't need a render factory, so it runs on headless machines
+	bool const cpu = (argc >= 4) && (std::string("cpu") == argv[3]);
+
+	std::shared_ptr<PrefilterCubeApp> app;
+	if (!cpu)
+	{
+		Context::Instance().LoadCfg("KlayGE.cfg");
+		ContextCfg context_cfg = Context::Instance().Config();
+		context_cfg.graphics_cfg.hide_win = true;
+		context_cfg.graphics_cfg.hdr = false;
+		context_cfg.graphics_cfg.color_grading = false;
+		context_cfg.graphics_cfg.gamma = false;
+		Context::Instance().Config(context_cfg);
+
+		app = MakeSharedPtr<PrefilterCubeApp>();
+		app->Create();
+	}
+
 	Timer timer;
 
-	PrefilterCubeGPU(input, output);
+	if (cpu)
+	{
+		if (!PrefilterCubeCPU(input, output))
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		PrefilterCubeGPU(input, output);
+	}
 
 	cout << timer.elapsed() << " s" << endl;
 	cout << "Filtered cube map is saved into " << output << endl;